@@ -0,0 +1,191 @@
+/**
+ * bench_billing.c: Per reading cost of the billing engine
+ *
+ * Bills a synthetic fleet in an in-memory database: sensors parked over a
+ * grid of priced zones report in random order, one reading every
+ * BENCH_STEP_MS of simulated time; a reading leaves its spot with
+ * probability 1/BENCH_DEPARTURE and parks elsewhere with the next one, and
+ * one sensor in BENCH_SILENT goes silent and times out. Times, separately:
+ *   - billing_update() per reading,
+ *   - billing_flush() per written invoice, one transaction per batch of
+ *     BENCH_BATCH readings as in the inserter.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_billing [readings] [sensors]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "billing.h"
+#include "zone_map.h"
+#include "prk_db.h"
+#include "sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_DEFAULT_READINGS 5000000                               /* Readings applied */
+#define BENCH_DEFAULT_SENSORS  20000                                 /* Distinct sensors */
+#define BENCH_ZONE_SIDE        32                                    /* Zones per grid row */
+#define BENCH_ZONE_SIZE        (10 * COORD_SCALE)                    /* Zone edge, fixed point */
+#define BENCH_STEP_MS          2                                     /* Simulated time between readings */
+#define BENCH_DEPARTURE        50                                    /* One reading in this many departs */
+#define BENCH_SILENT           1000                                  /* One sensor in this many stops reporting */
+#define BENCH_BATCH            4096                                  /* Readings per transaction */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * create_fleet - Zones with prices and @sensors sensors in a fresh database.
+ */
+static int create_fleet(sqlite3 *db, long sensors)
+{
+    char sql[256];
+
+    if (prk_db_create_schema(db) != 0 || prk_db_exec(db, "BEGIN;") != 0)
+    {
+        return -1;
+    }
+    for (int i = 0; i < BENCH_ZONE_SIDE * BENCH_ZONE_SIDE; i++)
+    {
+        double x = (i % BENCH_ZONE_SIDE) * (BENCH_ZONE_SIZE / COORD_SCALE);
+        double y = (i / BENCH_ZONE_SIDE) * (BENCH_ZONE_SIZE / COORD_SCALE);
+        snprintf(sql, sizeof(sql),
+                 "INSERT INTO Zones VALUES (%d, 'Lot %d', %f, %f, %f, %f);"
+                 "INSERT INTO Prices (location, price) VALUES ('Lot %d', %f);",
+                 i + 1, i + 1, x, y, x + BENCH_ZONE_SIZE / COORD_SCALE, y + BENCH_ZONE_SIZE / COORD_SCALE,
+                 i + 1, 1.0 + i % 20);
+        if (prk_db_exec(db, sql) != 0)
+        {
+            return -1;
+        }
+    }
+    for (long id = 1; id <= sensors; id++)
+    {
+        snprintf(sql, sizeof(sql),
+                 "INSERT INTO Sensors (id, mac_address) VALUES (%ld, '02:00:%02lx:%02lx:%02lx:%02lx');", id, (id >> 24) & 0xff, (id >> 16) & 0xff, (id >> 8) & 0xff, id & 0xff);
+        if (prk_db_exec(db, sql) != 0)
+        {
+            return -1;
+        }
+    }
+    return prk_db_exec(db, "COMMIT;");
+}
+
+int main(int argc, char *argv[])
+{
+    long readings = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_READINGS;
+    long sensors  = argc > 2 ? atol(argv[2]) : BENCH_DEFAULT_SENSORS;
+    if (readings <= 0 || sensors <= 0)
+    {
+        fprintf(stderr, "Usage: %s [readings] [sensors]\n", argv[0]);
+        return 1;
+    }
+    srand(42);
+
+    sqlite3         *db = prk_db_open(":memory:");
+    ZoneMap         zones;
+    BillingEngine   billing;
+    if (!db || create_fleet(db, sensors) != 0 || zone_map_load(&zones, db) != 0)
+    {
+        return 1;
+    }
+    if (billing_init(&billing, db, &zones) != 0)
+    {
+        zone_map_free(&zones);
+        return 1;
+    }
+
+    /* Where each sensor is parked; a departed one parks again at a new spot */
+    int32_t *x = malloc((size_t)(sensors + 1) * sizeof(int32_t));
+    int32_t *y = malloc((size_t)(sensors + 1) * sizeof(int32_t));
+    if (!x || !y)
+    {
+        perror("malloc");
+        return 1;
+    }
+    for (long id = 1; id <= sensors; id++)
+    {
+        x[id] = rand() % (BENCH_ZONE_SIDE * BENCH_ZONE_SIZE);
+        y[id] = rand() % (BENCH_ZONE_SIDE * BENCH_ZONE_SIZE);
+    }
+
+    double  update_ns = 0, flush_ns = 0;
+    int64_t clock_ms  = 1000000000000LL;
+    long    applied   = 0;
+
+    while (applied < readings)
+    {
+        StoredReading batch[BENCH_BATCH];
+        int           count = 0;
+
+        for (; count < BENCH_BATCH && applied + count < readings; count++)
+        {
+            int64_t id;
+            do
+            {
+                id = 1 + rand() % sensors;
+            } while (id % BENCH_SILENT == 0 && clock_ms > 1000000000000LL + BILLING_SESSION_TIMEOUT_MS / 2);
+
+            clock_ms += BENCH_STEP_MS;
+            batch[count] = (StoredReading){ .sensor_id = id, .recv_time = clock_ms, .x = x[id], .y = y[id] };
+            batch[count].status = (rand() % BENCH_DEPARTURE == 0) ? 'D' : 'S';
+            if (batch[count].status == 'D')
+            {
+                x[id] = rand() % (BENCH_ZONE_SIDE * BENCH_ZONE_SIZE);
+                y[id] = rand() % (BENCH_ZONE_SIDE * BENCH_ZONE_SIZE);
+            }
+        }
+
+        double start = now_ns();
+        for (int i = 0; i < count; i++)
+        {
+            billing_update(&billing, &batch[i]);
+        }
+        update_ns += now_ns() - start;
+
+        start = now_ns();
+        prk_db_exec(db, "BEGIN;");
+        billing_flush(&billing, clock_ms);
+        prk_db_exec(db, "COMMIT;");
+        flush_ns += now_ns() - start;
+
+        applied += count;
+    }
+
+    printf("%ld readings from %ld sensors over %.0f s of simulated time\n", readings, sensors,
+           (double)(clock_ms - 1000000000000LL) / 1000.0);
+    printf("%-8s %10.1f ns/reading   %12.0f readings/s\n", "update", update_ns / (double)readings,
+           1e9 * (double)readings / update_ns);
+    printf("%-8s %10.1f ns/invoice   %12llu invoices (%llu timed out, %llu unpriced)\n", "flush",
+           billing.invoiced ? flush_ns / (double)billing.invoiced : 0.0, (unsigned long long)billing.invoiced,
+           (unsigned long long)billing.timeouts, (unsigned long long)billing.unpriced);
+    printf("%zu sessions open at the end\n", billing.open);
+
+    free(x);
+    free(y);
+    billing_free(&billing);
+    zone_map_free(&zones);
+    prk_db_close(db);
+    return 0;
+}
@@ -0,0 +1,195 @@
+/**
+ * bench_metrics.c: Cost of recording metrics, and of a scrape
+ *
+ * Times, per operation:
+ *   - prk_counter_inc(), prk_gauge_set() and prk_histogram_observe() from
+ *     one thread,
+ *   - prk_counter_inc() from [threads] threads at once, each on its own
+ *     shard, against the same threads sharing one atomic counter,
+ * then maps the page back read-only as out_metrics_exporter does and
+ * times prk_metrics_write_text(). The counter and histogram totals read
+ * back are checked against the number of operations.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_metrics [threads]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "prk_metrics.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_STAGE            "bench_metrics"                       /* Page name, removed at the end */
+#define BENCH_OPS              (1 << 25)                             /* Operations per thread and kind */
+#define BENCH_DEFAULT_THREADS  4
+#define BENCH_MAX_THREADS      64
+#define BENCH_SCRAPES          1000
+
+
+static PrkCounter       counter;
+static PrkCounter       threaded;
+static PrkGauge         gauge;
+static PrkHistogram     histogram;
+static _Atomic uint64_t shared_counter;                              /* One cache line for every thread */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * sharded_worker - BENCH_OPS increments of the sharded counter.
+ */
+static void *sharded_worker(void *arg)
+{
+    (void)arg;
+    for (uint32_t i = 0; i < BENCH_OPS; i++)
+    {
+        prk_counter_inc(threaded);
+    }
+    return NULL;
+}
+
+/**
+ * shared_worker - BENCH_OPS increments of one atomic counter.
+ */
+static void *shared_worker(void *arg)
+{
+    (void)arg;
+    for (uint32_t i = 0; i < BENCH_OPS; i++)
+    {
+        atomic_fetch_add_explicit(&shared_counter, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+/**
+ * run_threads - Seconds for @threads threads running @worker.
+ */
+static double run_threads(int threads, void *(*worker)(void *))
+{
+    pthread_t ids[BENCH_MAX_THREADS];
+
+    double start = now_ns();
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_create(&ids[t], NULL, worker, NULL);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(ids[t], NULL);
+    }
+    return (now_ns() - start) / 1e9;
+}
+
+/**
+ * find_value - Value of the sample @sample in exposition text, -1 if missing.
+ */
+static long long find_value(const char *text, const char *sample)
+{
+    const char *line = strstr(text, sample);
+    return line ? atoll(line + strlen(sample)) : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_THREADS;
+    if (threads < 1 || threads > BENCH_MAX_THREADS)
+    {
+        fprintf(stderr, "Usage: %s [threads], 1 to %d\n", argv[0], BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    if (prk_metrics_open(BENCH_STAGE) != 0)
+    {
+        return 1;
+    }
+    counter   = prk_counter("prk_bench_ops_total", "Single thread increments.");
+    threaded  = prk_counter("prk_bench_threaded_ops_total", "Increments from every thread.");
+    gauge     = prk_gauge("prk_bench_gauge", "Last value set.");
+    histogram = prk_histogram("prk_bench_seconds", "Observed values.", PRK_SCALE_NS);
+
+    /* One thread, each kind of metric */
+    double start = now_ns();
+    for (uint32_t i = 0; i < BENCH_OPS; i++)
+    {
+        prk_counter_inc(counter);
+    }
+    double inc = (now_ns() - start) / BENCH_OPS;
+
+    start = now_ns();
+    for (uint32_t i = 0; i < BENCH_OPS; i++)
+    {
+        prk_gauge_set(gauge, i);
+    }
+    double set = (now_ns() - start) / BENCH_OPS;
+
+    start = now_ns();
+    for (uint32_t i = 0; i < BENCH_OPS; i++)
+    {
+        prk_histogram_observe(histogram, (i * 2654435761u) & 0xfffff); /* Up to 1 ms, spread over the buckets */
+    }
+    double observe = (now_ns() - start) / BENCH_OPS;
+
+    printf("One thread, %d operations: counter %.2f ns, gauge %.2f ns, histogram %.2f ns\n",
+           BENCH_OPS, inc, set, observe);
+
+    double sharded = run_threads(threads, sharded_worker);
+    double shared  = run_threads(threads, shared_worker);
+    printf("%d threads, %d increments each: sharded counter %.2f ns, one atomic counter %.2f ns per increment "
+           "(%.1f vs %.1f M/s in total)\n", threads, BENCH_OPS, sharded * 1e9 / BENCH_OPS, shared * 1e9 / BENCH_OPS,
+           threads * (double)BENCH_OPS / sharded / 1e6, threads * (double)BENCH_OPS / shared / 1e6);
+
+    /* Read back as the exporter does */
+    const PrkMetricsPage *page = prk_metrics_map(BENCH_STAGE);
+    if (!page)
+    {
+        fprintf(stderr, "Cannot map the page back\n");
+        prk_metrics_close();
+        return 1;
+    }
+    char    *text = NULL;
+    size_t  size  = 0;
+    start = now_ns();
+    for (int s = 0; s < BENCH_SCRAPES; s++)
+    {
+        free(text);
+        FILE *out = open_memstream(&text, &size);
+        prk_metrics_write_text(page, out);
+        fclose(out);
+    }
+    double scrape = (now_ns() - start) / BENCH_SCRAPES / 1e3;
+    printf("Scrape: %.1f us for %zu bytes of exposition text, %u shards\n", scrape, size,
+           atomic_load(&page->shards));
+
+    long long ops       = find_value(text, "prk_bench_ops_total{stage=\"" BENCH_STAGE "\"} ");
+    long long total     = find_value(text, "prk_bench_threaded_ops_total{stage=\"" BENCH_STAGE "\"} ");
+    long long observed  = find_value(text, "prk_bench_seconds_count{stage=\"" BENCH_STAGE "\"} ");
+    int       rc        = ops == BENCH_OPS && total == (long long)threads * BENCH_OPS && observed == BENCH_OPS ? 0 : 1;
+    printf("Read back: %lld, %lld and %lld operations: %s\n", ops, total, observed, rc == 0 ? "OK" : "MISMATCH");
+
+    free(text);
+    prk_metrics_unmap(page);
+    prk_metrics_close();
+    return rc;
+}
@@ -0,0 +1,270 @@
+/**
+ * bench_price_history.c: Point-in-time price lookups over Price_History
+ *
+ * Fills Price_History of an in-memory database with BENCH_DEFAULT_ZONES
+ * zones, each repriced BENCH_CHANGES times at random moments of a year,
+ * some of them left without a price for a while, then times, separately:
+ *   - price_history_load(),
+ *   - price_history_find_zone() for BENCH_QUERIES random (zone, time)
+ *     lookups, one by one,
+ *   - the same lookups through price_history_find_batch(), BENCH_BATCH at
+ *     a time, first in random order, then with each batch sorted by zone
+ *     and time so that it steps through the intervals.
+ * Every answer is checked against a linear scan of the zone's intervals.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_price_history [zones]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "price_history.h"
+#include "prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_DEFAULT_ZONES    5000                                  /* Priced zones */
+#define BENCH_CHANGES          40                                    /* Prices per zone over the year */
+#define BENCH_GAP              8                                     /* One price in this many is followed by none */
+#define BENCH_QUERIES          (1 << 21)                             /* Lookups timed */
+#define BENCH_BATCH            4096                                  /* Lookups per batch */
+#define BENCH_ORIGIN_MS        ((int64_t)1735689600 * 1000)          /* 2025-01-01 */
+#define BENCH_SPAN_MS          ((int64_t)365 * 24 * 3600 * 1000)     /* One year */
+
+
+static uint64_t seed = 88172645463325252ULL;
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * next_random - xorshift64, below @bound.
+ */
+static uint64_t next_random(uint64_t bound)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed % bound;
+}
+
+/**
+ * compare_times - qsort() order of int64_t.
+ */
+static int compare_times(const void *a, const void *b)
+{
+    int64_t ta = *(const int64_t *)a, tb = *(const int64_t *)b;
+    return (ta > tb) - (ta < tb);
+}
+
+/**
+ * compare_queries - qsort() order of PriceHistoryQuery by zone, then time.
+ */
+static int compare_queries(const void *a, const void *b)
+{
+    const PriceHistoryQuery *qa = a, *qb = b;
+    if (qa->zone_id != qb->zone_id)
+    {
+        return (qa->zone_id > qb->zone_id) - (qa->zone_id < qb->zone_id);
+    }
+    return (qa->at_ms > qb->at_ms) - (qa->at_ms < qb->at_ms);
+}
+
+/**
+ * run_batches - price_history_find_batch() over @queries, BENCH_BATCH at a time.
+ */
+static void run_batches(const PriceHistory *history, const PriceHistoryQuery *queries, const PriceInterval **results)
+{
+    for (size_t i = 0; i < BENCH_QUERIES; i += BENCH_BATCH)
+    {
+        size_t count = BENCH_QUERIES - i < BENCH_BATCH ? BENCH_QUERIES - i : BENCH_BATCH;
+        price_history_find_batch(history, &queries[i], count, &results[i]);
+    }
+}
+
+/**
+ * fill_history - Zones and their price intervals, as out_update_prices writes them.
+ */
+static int fill_history(sqlite3 *db, long zones)
+{
+    sqlite3_stmt    *zone_stmt    = prk_db_prepare(db, "INSERT INTO Zones VALUES (?1, ?2, 0, 0, 1, 1);");
+    sqlite3_stmt    *history_stmt = prk_db_prepare(db,
+        "INSERT INTO Price_History (location, price, valid_from, valid_to) VALUES (?1, ?2, ?3, ?4);");
+    int64_t         times[BENCH_CHANGES];
+    char            name[32];
+    int             rc = zone_stmt && history_stmt && prk_db_exec(db, "BEGIN;") == 0 ? 0 : -1;
+
+    for (long z = 1; rc == 0 && z <= zones; z++)
+    {
+        snprintf(name, sizeof(name), "Lot %ld", z);
+        sqlite3_bind_int64(zone_stmt, 1, z);
+        sqlite3_bind_text(zone_stmt, 2, name, -1, SQLITE_TRANSIENT);
+        rc = sqlite3_step(zone_stmt) == SQLITE_DONE ? 0 : -1;
+        sqlite3_reset(zone_stmt);
+
+        for (int c = 0; c < BENCH_CHANGES; c++)
+        {
+            times[c] = BENCH_ORIGIN_MS + (int64_t)next_random(BENCH_SPAN_MS);
+        }
+        qsort(times, BENCH_CHANGES, sizeof(int64_t), compare_times);
+        for (int c = 0; rc == 0 && c < BENCH_CHANGES; c++)
+        {
+            /* The last price is current; a gapped one ends halfway to the next */
+            int64_t valid_to = c + 1 == BENCH_CHANGES ? 0 : times[c + 1];
+            if (valid_to && next_random(BENCH_GAP) == 0)
+            {
+                valid_to = times[c] + (valid_to - times[c]) / 2;
+            }
+            sqlite3_bind_text(history_stmt, 1, name, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_double(history_stmt, 2, (double)(100 + next_random(2000)) / 100.0);
+            sqlite3_bind_int64(history_stmt, 3, times[c]);
+            if (valid_to)
+            {
+                sqlite3_bind_int64(history_stmt, 4, valid_to);
+            }
+            else
+            {
+                sqlite3_bind_null(history_stmt, 4);
+            }
+            rc = sqlite3_step(history_stmt) == SQLITE_DONE ? 0 : -1;
+            sqlite3_reset(history_stmt);
+        }
+    }
+    sqlite3_finalize(zone_stmt);
+    sqlite3_finalize(history_stmt);
+    return rc == 0 ? prk_db_exec(db, "COMMIT;") : -1;
+}
+
+/**
+ * scan_zone - Interval of @zone_id holding @at_ms, by a linear scan.
+ */
+static const PriceInterval *scan_zone(const PriceHistory *history, int64_t zone_id, int64_t at_ms)
+{
+    for (size_t i = 0; i < history->location_count; i++)
+    {
+        const PriceHistoryLocation *loc = &history->locations[i];
+        if (loc->zone_id != zone_id)
+        {
+            continue;
+        }
+        for (size_t k = loc->first; k < loc->first + loc->count; k++)
+        {
+            if (history->intervals[k].valid_from <= at_ms && at_ms < history->intervals[k].valid_to)
+            {
+                return &history->intervals[k];
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    long zones = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_ZONES;
+    if (zones <= 0)
+    {
+        fprintf(stderr, "Usage: %s [zones]\n", argv[0]);
+        return 1;
+    }
+
+    sqlite3 *db = prk_db_open(":memory:");
+    if (!db || prk_db_create_schema(db) != 0 || fill_history(db, zones) != 0)
+    {
+        return 1;
+    }
+
+    PriceHistoryQuery       *queries = malloc(BENCH_QUERIES * sizeof(PriceHistoryQuery));
+    PriceHistoryQuery       *grouped = malloc(BENCH_QUERIES * sizeof(PriceHistoryQuery));
+    const PriceInterval     **single = malloc(BENCH_QUERIES * sizeof(PriceInterval *));
+    const PriceInterval     **batch  = malloc(BENCH_QUERIES * sizeof(PriceInterval *));
+    const PriceInterval     **sorted = malloc(BENCH_QUERIES * sizeof(PriceInterval *));
+    if (!queries || !grouped || !single || !batch || !sorted)
+    {
+        perror("malloc");
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_QUERIES; i++)
+    {
+        queries[i].zone_id = 1 + (int64_t)next_random((uint64_t)zones);
+        queries[i].at_ms   = BENCH_ORIGIN_MS + (int64_t)next_random(BENCH_SPAN_MS);
+    }
+    memcpy(grouped, queries, BENCH_QUERIES * sizeof(PriceHistoryQuery));
+    for (size_t i = 0; i < BENCH_QUERIES; i += BENCH_BATCH)
+    {
+        size_t count = BENCH_QUERIES - i < BENCH_BATCH ? BENCH_QUERIES - i : BENCH_BATCH;
+        qsort(&grouped[i], count, sizeof(PriceHistoryQuery), compare_queries);
+    }
+
+    PriceHistory history;
+    double start = now_ns();
+    if (price_history_load(db, &history) != 0)
+    {
+        return 1;
+    }
+    double loaded = now_ns();
+
+    for (size_t i = 0; i < BENCH_QUERIES; i++)
+    {
+        single[i] = price_history_find_zone(&history, queries[i].zone_id, queries[i].at_ms);
+    }
+    double found = now_ns();
+
+    run_batches(&history, queries, batch);
+    double batched = now_ns();
+
+    run_batches(&history, grouped, sorted);
+    double grouped_ns = now_ns();
+
+    /* The scan is slow: check a sample of the answers against it, and all against each other */
+    size_t wrong = 0, unpriced = 0;
+    for (size_t i = 0; i < BENCH_QUERIES; i++)
+    {
+        const PriceInterval *expected = i % 64 == 0 ? scan_zone(&history, queries[i].zone_id, queries[i].at_ms) :
+                                        single[i];
+        wrong    += single[i] != expected || batch[i] != expected;
+        unpriced += !single[i];
+
+        const PriceHistoryQuery *query = &grouped[i];
+        expected = i % 64 == 0 ? scan_zone(&history, query->zone_id, query->at_ms) :
+                   price_history_find_zone(&history, query->zone_id, query->at_ms);
+        wrong += sorted[i] != expected;
+    }
+
+    printf("%ld zones x %d prices: load %.1f ms (%zu intervals)\n", zones, BENCH_CHANGES, (loaded - start) / 1e6,
+           history.interval_count);
+    printf("%-10s %9.1f ns per lookup\n", "single", (found - loaded) / BENCH_QUERIES);
+    printf("%-10s %9.1f ns per lookup   (batches of %d, random order)\n", "batch", (batched - found) / BENCH_QUERIES,
+           BENCH_BATCH);
+    printf("%-10s %9.1f ns per lookup   (batches of %d, by zone and time)\n", "batch",
+           (grouped_ns - batched) / BENCH_QUERIES, BENCH_BATCH);
+    printf("%d lookups, %zu without a price, %zu wrong\n", BENCH_QUERIES, unpriced, wrong);
+
+    price_history_free(&history);
+    free(queries);
+    free(grouped);
+    free(single);
+    free(batch);
+    free(sorted);
+    prk_db_close(db);
+    return wrong != 0;
+}
@@ -0,0 +1,232 @@
+/**
+ * bench_price_schedule.c: Session costs from compiled price schedules
+ *
+ * Builds BENCH_DEFAULT_LOCATIONS locations with BENCH_RULES random
+ * time-of-day rules and BENCH_TIERS duration tiers each, then times,
+ * separately:
+ *   - compiling every location's schedule,
+ *   - price_schedule_cost() for BENCH_SESSIONS random sessions of up to
+ *     BENCH_MAX_HOURS hours,
+ *   - the same costs the way a rule walk does it, minute by minute,
+ *     looking up the rule and tier in force, for BENCH_CHECKED sessions.
+ * Sessions start and end on whole minutes, so both ways must agree; the
+ * largest difference is printed and a difference past BENCH_EPSILON fails.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_price_schedule [locations]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "price_schedule.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_DEFAULT_LOCATIONS 1000                                 /* Scheduled locations */
+#define BENCH_RULES            12                                    /* Rules per location */
+#define BENCH_TIERS            3                                     /* Duration tiers per location */
+#define BENCH_SESSIONS         (1 << 22)                             /* Sessions costed from the tables */
+#define BENCH_CHECKED          20000                                 /* Of which also costed by the rule walk */
+#define BENCH_MAX_HOURS        72                                    /* Longest session */
+#define BENCH_EPSILON          1e-6                                  /* Largest difference accepted */
+#define MINUTE_MS              ((int64_t)60 * 1000)
+#define DAY_MINUTES            (24 * 60)
+#define ORIGIN_MINUTES         ((int64_t)4 * DAY_MINUTES)            /* 1970-01-05, the first Monday */
+
+
+/* Source of one location's schedule, kept for the rule walk */
+typedef struct
+{
+    double          base_price;
+    ScheduleRule    rules[BENCH_RULES];
+    ScheduleTier    tiers[BENCH_TIERS];
+} LocationRules;
+
+
+/* One session to cost */
+typedef struct
+{
+    uint32_t  location;
+    int64_t   start_ms;
+    int64_t   end_ms;
+} Session;
+
+
+static uint64_t seed = 88172645463325252ULL;
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * next_random - xorshift64, below @bound.
+ */
+static uint64_t next_random(uint64_t bound)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed % bound;
+}
+
+/**
+ * make_location - Random rules and tiers of location @index.
+ */
+static void make_location(LocationRules *loc, long index)
+{
+    int utc_offset_min = ((int)next_random(25) - 12) * 60;
+
+    loc->base_price = 1.0 + (double)next_random(900) / 100.0;
+    for (int r = 0; r < BENCH_RULES; r++)
+    {
+        ScheduleRule *rule = &loc->rules[r];
+        snprintf(rule->location, sizeof(rule->location), "City %07ld", index);
+        rule->days           = (uint8_t)(1 + next_random(SCHEDULE_ALL_DAYS));
+        rule->start_min      = (uint16_t)(next_random(DAY_MINUTES / SCHEDULE_SLOT_MINUTES) * SCHEDULE_SLOT_MINUTES);
+        rule->end_min        = (uint16_t)((1 + next_random(DAY_MINUTES / SCHEDULE_SLOT_MINUTES)) * SCHEDULE_SLOT_MINUTES);
+        rule->utc_offset_min = (int16_t)utc_offset_min;
+        rule->price          = (double)next_random(2000) / 100.0;
+    }
+    for (int t = 0; t < BENCH_TIERS; t++)
+    {
+        ScheduleTier *tier = &loc->tiers[t];
+        snprintf(tier->location, sizeof(tier->location), "City %07ld", index);
+        tier->after_min = (uint32_t)(next_random(48) * 60);
+        tier->factor    = 0.5 + (double)next_random(150) / 100.0;
+    }
+}
+
+/**
+ * rule_applies - Whether @rule covers @minute of @day (0 Monday), local time.
+ */
+static int rule_applies(const ScheduleRule *rule, int day, int minute)
+{
+    int yesterday = (day + 6) % 7;
+    if (rule->start_min < rule->end_min)
+    {
+        return (rule->days >> day & 1) && minute >= rule->start_min && minute < rule->end_min;
+    }
+    return ((rule->days >> day & 1) && minute >= rule->start_min) ||
+           ((rule->days >> yesterday & 1) && minute < rule->end_min);
+}
+
+/**
+ * walk_cost - Cost of a session, minute by minute through the rules.
+ */
+static double walk_cost(const LocationRules *loc, const PriceSchedule *schedule, int64_t start_ms, int64_t end_ms)
+{
+    double cost = 0.0;
+
+    for (int64_t t = start_ms; t < end_ms; t += MINUTE_MS)
+    {
+        int64_t local  = t / MINUTE_MS + loc->rules[0].utc_offset_min - ORIGIN_MINUTES;
+        int64_t of_day = ((local % DAY_MINUTES) + DAY_MINUTES) % DAY_MINUTES;
+        int     day    = (int)((((local - of_day) / DAY_MINUTES) % 7 + 7) % 7);
+        double  rate   = loc->base_price;
+        for (int r = 0; r < BENCH_RULES; r++)
+        {
+            if (rule_applies(&loc->rules[r], day, (int)of_day))
+            {
+                rate = loc->rules[r].price;                          /* Later rules win */
+            }
+        }
+
+        double factor = 1.0;
+        for (uint32_t i = 0; i < schedule->tier_count; i++)
+        {
+            if (t - start_ms >= schedule->tiers[i].after_ms)
+            {
+                factor = schedule->tiers[i].factor;
+            }
+        }
+        cost += factor * rate / 60.0;
+    }
+    return cost;
+}
+
+int main(int argc, char *argv[])
+{
+    long count = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_LOCATIONS;
+    if (count <= 0)
+    {
+        fprintf(stderr, "Usage: %s [locations]\n", argv[0]);
+        return 1;
+    }
+
+    LocationRules   *locations = malloc((size_t)count * sizeof(LocationRules));
+    PriceSchedule   *schedules = malloc((size_t)count * sizeof(PriceSchedule));
+    Session         *sessions  = malloc(BENCH_SESSIONS * sizeof(Session));
+    if (!locations || !schedules || !sessions)
+    {
+        perror("malloc");
+        return 1;
+    }
+    for (long i = 0; i < count; i++)
+    {
+        make_location(&locations[i], i);
+    }
+    for (size_t i = 0; i < BENCH_SESSIONS; i++)
+    {
+        int64_t start_min      = 29000000 + (int64_t)next_random(525600);    /* Some minute of a year from 2025 */
+        sessions[i].location   = (uint32_t)next_random((uint64_t)count);
+        sessions[i].start_ms   = start_min * MINUTE_MS;
+        sessions[i].end_ms     = (start_min + 1 + (int64_t)next_random(BENCH_MAX_HOURS * 60)) * MINUTE_MS;
+    }
+
+    double start = now_ns();
+    for (long i = 0; i < count; i++)
+    {
+        price_schedule_compile(&schedules[i], locations[i].base_price, locations[i].rules, BENCH_RULES,
+                               locations[i].tiers, BENCH_TIERS);
+    }
+    double compiled = now_ns();
+
+    double sum = 0.0;
+    for (size_t i = 0; i < BENCH_SESSIONS; i++)
+    {
+        const Session *s = &sessions[i];
+        sum += price_schedule_cost(&schedules[s->location], s->start_ms, s->end_ms);
+    }
+    double costed = now_ns();
+
+    double worst = 0.0;
+    for (size_t i = 0; i < BENCH_CHECKED; i++)
+    {
+        const Session *s    = &sessions[i];
+        double        walk  = walk_cost(&locations[s->location], &schedules[s->location], s->start_ms, s->end_ms);
+        double        table = price_schedule_cost(&schedules[s->location], s->start_ms, s->end_ms);
+        worst = fmax(worst, fabs(walk - table));
+    }
+    double walked = now_ns();
+
+    printf("%ld locations x %d rules, %d tiers: compile %.1f us per location\n", count, BENCH_RULES, BENCH_TIERS,
+           (compiled - start) / 1e3 / count);
+    printf("%-20s %9.1f ns per session\n", "prefix tables", (costed - compiled) / BENCH_SESSIONS);
+    printf("%-20s %9.1f ns per session (incl. table cost)\n", "rule walk", (walked - costed) / BENCH_CHECKED);
+    printf("largest difference over %d sessions: %.3g (checksum %.2f)\n", BENCH_CHECKED, worst, sum);
+
+    free(locations);
+    free(schedules);
+    free(sessions);
+    return worst > BENCH_EPSILON;
+}
@@ -0,0 +1,218 @@
+/**
+ * bench_price_table.c: Lookups in the shared price table during reloads
+ *
+ * Publishes BENCH_DEFAULT_LOCATIONS prices, one location in BENCH_ZONED
+ * with a zone, under a private name and times, separately:
+ *   - publishing one generation,
+ *   - price_table_current() plus a lookup by location, per lookup,
+ *   - price_table_current() plus a lookup by zone, per lookup,
+ * then republishes BENCH_RELOADS generations while a reader thread keeps
+ * looking up prices. Every price of generation g is g, so a reader that
+ * ever sees a price from another generation than its table's, or a
+ * missing location, has seen a torn table.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_price_table [locations]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "price_table.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define BENCH_DEFAULT_LOCATIONS 1000000                              /* Prices published */
+#define BENCH_ZONED            2                                     /* One location in this many has a zone */
+#define BENCH_LOOKUPS          (1 << 22)                             /* Timed lookups of each kind */
+#define BENCH_RELOADS          20                                    /* Generations published under readers */
+
+
+/* State shared with the reader thread */
+typedef struct
+{
+    const char      *name;
+    PriceTableEntry *entries;
+    size_t          count;
+    volatile int    stop;
+    uint64_t        lookups;
+    uint64_t        torn;                                            /* Lookups that saw another generation */
+    uint64_t        reloads;
+} ReaderState;
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * set_generation_prices - Price every entry at @generation.
+ */
+static void set_generation_prices(PriceTableEntry *entries, size_t count, uint64_t generation)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        entries[i].price = (double)generation;
+    }
+}
+
+/**
+ * reader_thread - Look prices up until stopped, checking each against its table.
+ */
+static void *reader_thread(void *arg)
+{
+    ReaderState         *state = arg;
+    PriceTableReader    reader;
+    uint64_t            seed   = 88172645463325252ULL;
+
+    if (price_table_attach(&reader, state->name) != 0)
+    {
+        state->torn = UINT64_MAX;
+        return NULL;
+    }
+    while (!state->stop)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        const PriceTable        *table = price_table_current(&reader);
+        const PriceTableEntry   *entry = price_table_find(table, state->entries[seed % state->count].location);
+        state->torn += !entry || entry->price != (double)table->generation;
+        state->lookups++;
+    }
+    state->reloads = reader.reloads;
+    price_table_detach(&reader);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    long count = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_LOCATIONS;
+    if (count <= 0)
+    {
+        fprintf(stderr, "Usage: %s [locations]\n", argv[0]);
+        return 1;
+    }
+
+    char name[PRICE_TABLE_NAME_MAX];
+    snprintf(name, sizeof(name), "/prk_prices_bench.%d", (int)getpid());
+
+    PriceTableEntry *entries = calloc((size_t)count, sizeof(PriceTableEntry));
+    uint32_t        *picks   = malloc(BENCH_LOOKUPS * sizeof(uint32_t));
+    if (!entries || !picks)
+    {
+        perror("malloc");
+        return 1;
+    }
+    for (long i = 0; i < count; i++)
+    {
+        snprintf(entries[i].location, sizeof(entries[i].location), "City %07ld", i);
+        entries[i].zone_id = (i % BENCH_ZONED == 0) ? i / BENCH_ZONED + 1 : 0;
+    }
+    set_generation_prices(entries, (size_t)count, 1);
+
+    PriceTableSource source     = { .entries = entries, .count = (size_t)count };
+    double           start      = now_ns();
+    uint64_t         generation = price_table_publish(name, &source);
+    double   published  = now_ns();
+    if (generation != 1)
+    {
+        price_table_remove(name);
+        return 1;
+    }
+    printf("%ld locations, publish %.1f ms\n", count, (published - start) / 1e6);
+
+    PriceTableReader reader;
+    if (price_table_attach(&reader, name) != 0)
+    {
+        price_table_remove(name);
+        return 1;
+    }
+
+    srand(1);
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        picks[i] = (uint32_t)((((size_t)rand() << 16) ^ (size_t)rand()) % (size_t)count);
+    }
+
+    /* Each lookup loads the generation, as a reader between publications does */
+    double  sum   = 0.0;
+    size_t  found = 0;
+    start = now_ns();
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        const PriceTableEntry *entry = price_table_find(price_table_current(&reader), entries[picks[i]].location);
+        if (entry)
+        {
+            sum += entry->price;
+            found++;
+        }
+    }
+    double by_location = now_ns();
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        const PriceTableEntry *entry = price_table_find_zone(price_table_current(&reader), picks[i] / BENCH_ZONED + 1);
+        if (entry)
+        {
+            sum += entry->price;
+            found++;
+        }
+    }
+    double by_zone = now_ns();
+
+    printf("%-20s %7.1f ns per lookup\n", "by location", (by_location - start) / BENCH_LOOKUPS);
+    printf("%-20s %7.1f ns per lookup\n", "by zone", (by_zone - by_location) / BENCH_LOOKUPS);
+    printf("%zu of %d found (checksum %.0f)\n", found, 2 * BENCH_LOOKUPS, sum);
+    price_table_detach(&reader);
+
+    /* Republish under a reader */
+    ReaderState state = { .name = name, .entries = entries, .count = (size_t)count };
+    pthread_t   thread;
+    if (pthread_create(&thread, NULL, reader_thread, &state) != 0)
+    {
+        price_table_remove(name);
+        return 1;
+    }
+
+    double publish_ns = 0.0;
+    int    failed     = 0;
+    for (uint64_t g = 2; g < 2 + BENCH_RELOADS; g++)
+    {
+        set_generation_prices(entries, (size_t)count, g);
+        start = now_ns();
+        failed |= price_table_publish(name, &source) != g;
+        publish_ns += now_ns() - start;
+        usleep(10000);
+    }
+    state.stop = 1;
+    pthread_join(thread, NULL);
+
+    printf("%d reloads, %.1f ms per publish; reader: %llu lookups, %llu generations mapped, %llu torn\n",
+           BENCH_RELOADS, publish_ns / BENCH_RELOADS / 1e6, (unsigned long long)state.lookups,
+           (unsigned long long)state.reloads, (unsigned long long)state.torn);
+
+    price_table_remove(name);
+    free(entries);
+    free(picks);
+    return failed || state.torn != 0;
+}
@@ -0,0 +1,322 @@
+/**
+ * bench_query_service.c: Latency and throughput benchmark of the query service
+ *
+ * Fills a QueryService with BENCH_SENSORS synthetic sensors spread over a
+ * grid of BENCH_ZONES zones, serves it from a thread on a scratch unix
+ * socket and times, through query_client:
+ *   - round trips of single point, 64-key batch and zone lookups (p50/p99),
+ *   - pipelined point lookups, BENCH_PIPELINE requests in flight.
+ * The in-process query_service_answer() cost is reported as well, to
+ * separate the lookup from the socket round trip.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_query_service [requests]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "query_service.h"
+#include "query_client.h"
+#include "zone_map.h"
+#include "sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+#define BENCH_SENSORS          100000                                /* Distinct sensors */
+#define BENCH_ZONE_SIDE        32                                    /* Zones per grid row */
+#define BENCH_ZONES            (BENCH_ZONE_SIDE * BENCH_ZONE_SIDE)   /* Zones in the grid */
+#define BENCH_ZONE_SIZE        (10 * COORD_SCALE)                    /* Zone edge, fixed point */
+#define BENCH_DEFAULT_REQUESTS 100000                                /* Requests per measurement */
+#define BENCH_BATCH            64                                    /* Keys per batch request */
+#define BENCH_PIPELINE         32                                    /* Requests in flight when pipelining */
+
+
+/* Server thread arguments */
+typedef struct
+{
+    QueryService    *service;
+    int             listen_fd;
+} ServerArgs;
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * compare_double - qsort comparator for latencies.
+ */
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/**
+ * serve - Server thread: run the service until stopped.
+ */
+static void *serve(void *arg)
+{
+    ServerArgs *args = arg;
+    query_service_run(args->service, args->listen_fd, -1);
+    return NULL;
+}
+
+/**
+ * build_zones - Square grid of BENCH_ZONES zones with ids 1..BENCH_ZONES.
+ */
+static int build_zones(ZoneMap *zones)
+{
+    memset(zones, 0, sizeof(*zones));
+    zones->zones = calloc(BENCH_ZONES, sizeof(Zone));
+    if (!zones->zones)
+    {
+        perror("calloc");
+        return -1;
+    }
+    zones->count = BENCH_ZONES;
+    for (int i = 0; i < BENCH_ZONES; i++)
+    {
+        Zone *zone  = &zones->zones[i];
+        zone->id    = i + 1;
+        zone->x_min = (i % BENCH_ZONE_SIDE) * BENCH_ZONE_SIZE;
+        zone->y_min = (i / BENCH_ZONE_SIDE) * BENCH_ZONE_SIZE;
+        zone->x_max = zone->x_min + BENCH_ZONE_SIZE;
+        zone->y_max = zone->y_min + BENCH_ZONE_SIZE;
+    }
+    return zone_map_build(zones);
+}
+
+/**
+ * fill_service - Apply one reading per sensor at a random position.
+ */
+static int fill_service(QueryService *service)
+{
+    QueryFeedRecord record;
+    memset(&record, 0, sizeof(record));
+
+    for (int64_t id = 1; id <= BENCH_SENSORS; id++)
+    {
+        record.sensor_id = id;
+        record.mac       = 0x020000000000ULL + (uint64_t)id;
+        record.recv_time = 1000000 + id;
+        record.x         = rand() % (BENCH_ZONE_SIDE * BENCH_ZONE_SIZE);
+        record.y         = rand() % (BENCH_ZONE_SIDE * BENCH_ZONE_SIZE);
+        record.status    = (id % 3) ? 'S' : 'D';
+        if (query_service_apply(service, &record) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * report - Print count, mean, p50 and p99 of @count latencies in ns.
+ */
+static void report(const char *name, double *latencies, int count)
+{
+    double sum = 0;
+    for (int i = 0; i < count; i++)
+    {
+        sum += latencies[i];
+    }
+    qsort(latencies, (size_t)count, sizeof(double), compare_double);
+    printf("%-22s %8d requests   mean %8.2f us   p50 %8.2f us   p99 %8.2f us\n", name, count,
+           sum / count / 1e3, latencies[count / 2] / 1e3, latencies[(int)(count * 0.99)] / 1e3);
+}
+
+/**
+ * round_trips - Time @count request/response round trips of @op with @keys keys each.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+static int round_trips(const char *name, int fd, uint16_t op, uint32_t keys, int count, double *latencies,
+                       void *records)
+{
+    uint64_t    key_buffer[BENCH_BATCH];
+    QueryHeader header;
+
+    for (int i = 0; i < count; i++)
+    {
+        int64_t range = (op == QOP_ZONE) ? BENCH_ZONES : BENCH_SENSORS;
+        for (uint32_t k = 0; k < keys; k++)
+        {
+            key_buffer[k] = 1 + (uint64_t)(rand() % range);
+        }
+
+        double start = now_ns();
+        if (query_client_send(fd, op, (uint32_t)i, key_buffer, keys) != 0 ||
+            query_client_recv(fd, &header, records) != 0 || header.tag != (uint32_t)i || header.count != keys)
+        {
+            fprintf(stderr, "%s: request %d failed\n", name, i);
+            return -1;
+        }
+        latencies[i] = now_ns() - start;
+    }
+    report(name, latencies, count);
+    return 0;
+}
+
+/**
+ * pipelined - Point lookups with BENCH_PIPELINE requests in flight.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+static int pipelined(int fd, int count, void *records)
+{
+    QueryHeader header;
+    int         sent     = 0;
+    int         received = 0;
+    double      start    = now_ns();
+
+    while (received < count)
+    {
+        while (sent < count && sent - received < BENCH_PIPELINE)
+        {
+            uint64_t key = 1 + (uint64_t)(rand() % BENCH_SENSORS);
+            if (query_client_send(fd, QOP_SENSOR, (uint32_t)sent, &key, 1) != 0)
+            {
+                return -1;
+            }
+            sent++;
+        }
+        if (query_client_recv(fd, &header, records) != 0 || header.tag != (uint32_t)received)
+        {
+            fprintf(stderr, "pipelined: response %d out of order\n", received);
+            return -1;
+        }
+        received++;
+    }
+
+    double seconds = (now_ns() - start) / 1e9;
+    printf("%-22s %8d requests   %.0f requests/s\n", "pipelined point", count, count / seconds);
+    return 0;
+}
+
+/**
+ * in_process - Time query_service_answer() alone for single point lookups.
+ */
+static void in_process(QueryService *service, int count, double *latencies, uint8_t *out)
+{
+    struct
+    {
+        QueryHeader header;
+        uint64_t    key;
+    } request;
+
+    memset(&request, 0, sizeof(request));
+    request.header.len   = sizeof(request);
+    request.header.op    = QOP_SENSOR;
+    request.header.count = 1;
+
+    for (int i = 0; i < count; i++)
+    {
+        request.key = 1 + (uint64_t)(rand() % BENCH_SENSORS);
+        double start = now_ns();
+        query_service_answer(service, &request.header, &request.key, out);
+        latencies[i] = now_ns() - start;
+    }
+    report("answer (no socket)", latencies, count);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_REQUESTS;
+    if (count <= 0)
+    {
+        fprintf(stderr, "Usage: %s [requests]\n", argv[0]);
+        return 1;
+    }
+
+    ZoneMap      zones;
+    QueryService service;
+    srand(42);
+    if (build_zones(&zones) != 0 || query_service_init(&service, &zones) != 0)
+    {
+        return 1;
+    }
+    if (fill_service(&service) != 0)
+    {
+        query_service_free(&service);
+        zone_map_free(&zones);
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/bench_query_service.%d.sock", (int)getpid());
+    unlink(addr.sun_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 16) != 0)
+    {
+        perror("listen");
+        return 1;
+    }
+
+    ServerArgs  args = { &service, listen_fd };
+    pthread_t   server;
+    if (pthread_create(&server, NULL, serve, &args) != 0)
+    {
+        perror("pthread_create");
+        return 1;
+    }
+
+    double  *latencies = malloc((size_t)count * sizeof(double));
+    uint8_t *records   = malloc(QUERY_MAX_RESPONSE);
+    int     fd         = query_client_connect(addr.sun_path);
+    int     failed     = !latencies || !records || fd < 0;
+
+    printf("%d sensors in %d zones\n", BENCH_SENSORS, BENCH_ZONES);
+    if (!failed)
+    {
+        failed = round_trips("point", fd, QOP_SENSOR, 1, count, latencies, records) != 0 ||
+                 round_trips("batch of 64", fd, QOP_SENSOR, BENCH_BATCH, count, latencies, records) != 0 ||
+                 round_trips("zone", fd, QOP_ZONE, 1, count, latencies, records) != 0 ||
+                 pipelined(fd, count, records) != 0;
+    }
+
+    query_service_stop(&service);
+    pthread_join(server, NULL);
+    if (!failed)
+    {
+        in_process(&service, count, latencies, records);
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    close(listen_fd);
+    unlink(addr.sun_path);
+    free(latencies);
+    free(records);
+    query_service_free(&service);
+    zone_map_free(&zones);
+
+    return failed;
+}
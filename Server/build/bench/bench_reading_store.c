@@ -0,0 +1,206 @@
+/**
+ * bench_reading_store.c: Ingest and range-query benchmark of the reading stores
+ *
+ * Writes the same synthetic readings (BENCH_SENSORS sensors, one reading per
+ * sensor every BENCH_INTERVAL_MS, spanning several hour buckets in the past)
+ * through both ReadingStore backends, in batches the way the inserter commits
+ * them, and then times random per-sensor range queries:
+ *   - sqlite: Customer_Data in a scratch database,
+ *   - tsdb:   the native engine in a scratch directory, queried before and
+ *             after compaction.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_reading_store [readings_per_sensor] [queries]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#define _XOPEN_SOURCE 700                                            /* nftw */
+#include "reading_store.h"
+#include "prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ftw.h>
+#include <unistd.h>
+
+
+#define BENCH_SENSORS          100                                   /* Distinct sensors */
+#define BENCH_DEFAULT_READINGS 10000                                 /* Readings per sensor */
+#define BENCH_DEFAULT_QUERIES  2000                                  /* Range queries per run */
+#define BENCH_INTERVAL_MS      1000                                  /* Time between readings of a sensor */
+#define BENCH_BATCH            1024                                  /* Readings per commit */
+#define BENCH_WINDOW_MS        (10 * 60 * 1000)                      /* Range query width */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * compare_double - qsort comparator for latencies.
+ */
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/**
+ * remove_entry - nftw callback deleting one scratch file or directory.
+ */
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+/**
+ * ingest - Append every reading through @store, flushing per batch.
+ *
+ * Return: readings per second.
+ */
+static double ingest(ReadingStore *store, sqlite3 *db, int64_t base, long per_sensor)
+{
+    long    total = per_sensor * BENCH_SENSORS;
+    double  start = now_ns();
+
+    for (long i = 0; i < total; i++)
+    {
+        if (i % BENCH_BATCH == 0 && db)
+        {
+            prk_db_exec(db, "BEGIN;");
+        }
+
+        StoredReading reading =
+        {
+            .sensor_id = 1 + i % BENCH_SENSORS,
+            .recv_time = base + (i / BENCH_SENSORS) * BENCH_INTERVAL_MS,
+            .x         = (int32_t)(i * 7 % 100000),
+            .y         = (int32_t)(i * 13 % 100000),
+            .z         = (int32_t)(i % 1000),
+            .status    = (i % 3) ? 'R' : 'I',
+        };
+        reading_store_append(store, &reading);
+
+        if ((i + 1) % BENCH_BATCH == 0 || i + 1 == total)
+        {
+            reading_store_flush(store);
+            if (db)
+            {
+                prk_db_exec(db, "COMMIT;");
+            }
+        }
+    }
+
+    return total / ((now_ns() - start) / 1e9);
+}
+
+/**
+ * query_latency - Time @queries random range queries and print p50/p99.
+ */
+static void query_latency(const char *label, ReadingStore *store, int64_t base, long per_sensor, int queries)
+{
+    double  *latency = malloc(queries * sizeof(double));
+    long    rows     = 0;
+    int64_t span     = per_sensor * BENCH_INTERVAL_MS - BENCH_WINDOW_MS;
+
+    srand(42);
+    for (int q = 0; q < queries; q++)
+    {
+        int64_t sensor = 1 + rand() % BENCH_SENSORS;
+        int64_t from   = base + (span > 0 ? (int64_t)((double)rand() / RAND_MAX * span) : 0);
+
+        double start = now_ns();
+        rows += reading_store_query(store, sensor, from, from + BENCH_WINDOW_MS, NULL, NULL);
+        latency[q] = now_ns() - start;
+    }
+
+    qsort(latency, queries, sizeof(double), compare_double);
+    printf("  %-24s p50 %8.1f us   p99 %8.1f us   (%.0f rows/query)\n", label,
+           latency[queries / 2] / 1e3, latency[queries * 99 / 100] / 1e3, (double)rows / queries);
+    free(latency);
+}
+
+
+int main(int argc, char *argv[])
+{
+    long    per_sensor = (argc > 1) ? atol(argv[1]) : BENCH_DEFAULT_READINGS;
+    int     queries    = (argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_QUERIES;
+    char    scratch[]  = "/tmp/bench_reading_store.XXXXXX";
+    char    db_path[sizeof(scratch) + 16], tsdb_dir[sizeof(scratch) + 16];
+
+    if (per_sensor <= 0 || queries <= 0 || !mkdtemp(scratch))
+    {
+        fprintf(stderr, "Usage: %s [readings_per_sensor] [queries]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    snprintf(db_path, sizeof(db_path), "%s/bench.db", scratch);
+    snprintf(tsdb_dir, sizeof(tsdb_dir), "%s/tsdb", scratch);
+
+    /* Start far enough back that every bucket is closed and can be compacted */
+    int64_t base = ((int64_t)time(NULL) - 2 * per_sensor * BENCH_INTERVAL_MS / 1000 - 7200) * 1000;
+
+    printf("%d sensors x %ld readings, %d queries of %d min\n", BENCH_SENSORS, per_sensor, queries,
+           BENCH_WINDOW_MS / 60000);
+
+    /* SQLite backend */
+    sqlite3         *db = prk_db_open(db_path);
+    ReadingStore    store;
+    if (!db || prk_db_create_schema(db) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    prk_db_exec(db, "BEGIN;");
+    for (int s = 1; s <= BENCH_SENSORS; s++)
+    {
+        char sql[128];
+        snprintf(sql, sizeof(sql), "INSERT INTO Sensors (id, mac_address) VALUES (%d, 'bench-%d');", s, s);
+        prk_db_exec(db, sql);
+    }
+    prk_db_exec(db, "COMMIT;");
+
+    if (reading_store_open(STORE_BACKEND_SQLITE, db, NULL, &store) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("sqlite: ingest %10.0f readings/s\n", ingest(&store, db, base, per_sensor));
+    query_latency("range query", &store, base, per_sensor, queries);
+    reading_store_close(&store);
+    prk_db_close(db);
+
+    /* Native time-series backend */
+    if (reading_store_open(STORE_BACKEND_TSDB, NULL, tsdb_dir, &store) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("tsdb:   ingest %10.0f readings/s\n", ingest(&store, NULL, base, per_sensor));
+    query_latency("range query (chunks)", &store, base, per_sensor, queries);
+
+    double start = now_ns();
+    reading_store_compact(&store);
+    printf("  %-24s %8.1f ms\n", "compaction", (now_ns() - start) / 1e6);
+    query_latency("range query (segments)", &store, base, per_sensor, queries);
+    reading_store_close(&store);
+
+    nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
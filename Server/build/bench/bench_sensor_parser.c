@@ -0,0 +1,238 @@
+/**
+ * bench_sensor_parser.c: Microbenchmark of sensor_parser against sscanf
+ *
+ * Loads a sample data file (default: the shipped giis/gdfs.data), repeats it
+ * until the working set holds at least BENCH_TARGET_LINES lines and times
+ * three ways of parsing it:
+ *   - sscanf with the format process_line used before sensor_parser,
+ *   - parse_reading() per line,
+ *   - parse_reading_batch() over the whole buffer.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_sensor_parser [data_file] [rounds]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_DEFAULT_FILE     "giis/gdfs.data"                      /* Shipped sample, relative to make/ */
+#define BENCH_TARGET_LINES     200000                                /* Minimum lines per round */
+#define BENCH_DEFAULT_ROUNDS   5                                     /* Rounds per method */
+#define BENCH_BATCH_LINES      1024                                  /* Lines per parse_reading_batch() call */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * load_sample - Read @path and repeat its content until it holds enough lines.
+ *
+ * Return: malloc'ed buffer (caller frees), NULL on failure.
+ */
+static char *load_sample(const char *path, size_t *len, size_t *lines)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror("fopen");
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    if (size <= 0)
+    {
+        fprintf(stderr, "Sample file is empty: %s\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    char *sample = malloc((size_t)size + 1);
+    if (!sample || fread(sample, 1, (size_t)size, file) != (size_t)size)
+    {
+        perror("fread");
+        free(sample);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    if (sample[size - 1] != '\n')
+    {
+        sample[size++] = '\n';
+    }
+
+    size_t sample_lines = 0;
+    for (long i = 0; i < size; i++)
+    {
+        sample_lines += (sample[i] == '\n');
+    }
+
+    size_t copies = (BENCH_TARGET_LINES + sample_lines - 1) / sample_lines;
+    char   *buf   = malloc(copies * (size_t)size + 1);
+    if (!buf)
+    {
+        perror("malloc");
+        free(sample);
+        return NULL;
+    }
+    for (size_t i = 0; i < copies; i++)
+    {
+        memcpy(buf + i * (size_t)size, sample, (size_t)size);
+    }
+    buf[copies * (size_t)size] = '\0';
+    free(sample);
+
+    *len   = copies * (size_t)size;
+    *lines = copies * sample_lines;
+    return buf;
+}
+
+/**
+ * bench_sscanf - Parse every line with the former sscanf format.
+ */
+static size_t bench_sscanf(char *buf, size_t len)
+{
+    size_t  ok  = 0;
+    char    *p  = buf;
+    char    *end = buf + len;
+
+    while (p < end)
+    {
+        char *nl = memchr(p, '\n', (size_t)(end - p));
+        *nl = '\0';
+
+        char    mac_address[18];
+        char    status;
+        double  x, y, z;
+        if (sscanf(p, "%17s: %c: x %lf y %lf z %lf", mac_address, &status, &x, &y, &z) == 5)
+        {
+            ok++;
+        }
+
+        *nl = '\n';
+        p = nl + 1;
+    }
+    return ok;
+}
+
+/**
+ * bench_line - Parse every line with parse_reading().
+ */
+static size_t bench_line(const char *buf, size_t len)
+{
+    size_t      ok  = 0;
+    const char  *p  = buf;
+    const char  *end = buf + len;
+
+    while (p < end)
+    {
+        const char    *nl = memchr(p, '\n', (size_t)(end - p));
+        SensorReading reading;
+        ok += (parse_reading(p, (size_t)(nl - p), &reading) == PARSE_OK);
+        p = nl + 1;
+    }
+    return ok;
+}
+
+/**
+ * bench_batch - Parse the buffer with parse_reading_batch().
+ */
+static size_t bench_batch(const char *buf, size_t len)
+{
+    static SensorReading    readings[BENCH_BATCH_LINES];
+    static parse_status_t   status[BENCH_BATCH_LINES];
+    size_t                  ok = 0;
+    size_t                  offset = 0;
+
+    while (offset < len)
+    {
+        size_t consumed;
+        size_t n = parse_reading_batch(buf + offset, len - offset, readings, status, BENCH_BATCH_LINES, &consumed);
+        if (n == 0)
+        {
+            break;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            ok += (status[i] == PARSE_OK);
+        }
+        offset += consumed;
+    }
+    return ok;
+}
+
+/**
+ * report - Print the best round of a method.
+ */
+static void report(const char *name, double best_ns, size_t lines, size_t ok, double baseline_ns)
+{
+    printf("%-22s %10.1f ns/line %12.0f lines/s %10zu ok   x%.1f\n",
+           name, best_ns / lines, lines / (best_ns / 1e9), ok, baseline_ns / best_ns);
+}
+
+int main(int argc, char *argv[])
+{
+    const char  *path   = argc > 1 ? argv[1] : BENCH_DEFAULT_FILE;
+    int         rounds  = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_ROUNDS;
+    size_t      len, lines;
+
+    char *buf = load_sample(path, &len, &lines);
+    if (!buf)
+    {
+        return 1;
+    }
+    if (rounds < 1)
+    {
+        rounds = 1;
+    }
+
+    printf("Sample: %s, %zu lines (%zu bytes) per round, %d rounds, scanner: %s\n\n",
+           path, lines, len, rounds, scan_delimiter_impl());
+
+    double best[3] = { 1e30, 1e30, 1e30 };
+    size_t ok[3]   = { 0, 0, 0 };
+    for (int r = 0; r < rounds; r++)
+    {
+        double t0 = now_ns();
+        ok[0] = bench_sscanf(buf, len);
+        double t1 = now_ns();
+        ok[1] = bench_line(buf, len);
+        double t2 = now_ns();
+        ok[2] = bench_batch(buf, len);
+        double t3 = now_ns();
+
+        best[0] = (t1 - t0 < best[0]) ? t1 - t0 : best[0];
+        best[1] = (t2 - t1 < best[1]) ? t2 - t1 : best[1];
+        best[2] = (t3 - t2 < best[2]) ? t3 - t2 : best[2];
+    }
+
+    report("sscanf",                best[0], lines, ok[0], best[0]);
+    report("parse_reading",         best[1], lines, ok[1], best[0]);
+    report("parse_reading_batch",   best[2], lines, ok[2], best[0]);
+
+    free(buf);
+    return 0;
+}
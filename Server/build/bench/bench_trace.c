@@ -0,0 +1,166 @@
+/**
+ * bench_trace.c: Cost of tracing a record at each stage
+ *
+ * Builds a record as the gateway sends it, traced from the STM32 to
+ * tcp_client, and times, per record:
+ *   - prk_trace_find() on an untraced and on a traced record (what
+ *     out_server and out_giis pay for every record),
+ *   - prk_trace_format_stamp() (what they add for a traced one),
+ *   - parse_reading() of the untraced and the traced line,
+ *   - trace_sink_add() and trace_sink_commit() (the inserter's share).
+ * The end to end histogram read back is checked against the number of
+ * traces folded.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_trace [records]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "prk_trace.h"
+#include "sensor_parser.h"
+#include "trace_sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_STAGE            "bench_trace"                         /* Page name, removed at the end */
+#define BENCH_DEFAULT_RECORDS  1000000
+#define BENCH_LINE             "00:50:56:2b:d3:c1: D: x 91.37 y 72.45 z 0.70 seq 1729300000000001"
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+    long records = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_RECORDS;
+    if (records < 1)
+    {
+        fprintf(stderr, "Usage: %s [records]\n", argv[0]);
+        return 1;
+    }
+    if (prk_metrics_open(BENCH_STAGE) != 0)
+    {
+        return 1;
+    }
+
+    /* The record as out_server receives it: stamped by mcu, ctl, ipc and tcp */
+    PrkTrace trace;
+    char     traced[1024];
+    prk_trace_begin(&trace);
+    prk_trace_stamp_at(&trace, PRK_TRACE_MCU, 0);
+    prk_trace_stamp(&trace, PRK_TRACE_CTL);
+    prk_trace_stamp(&trace, PRK_TRACE_IPC);
+    prk_trace_stamp(&trace, PRK_TRACE_TCP);
+    int len = snprintf(traced, sizeof(traced), "%s", BENCH_LINE);
+    len += prk_trace_format(&trace, traced + len, sizeof(traced) - (size_t)len);
+    printf("Traced record, %d bytes: %s\n", len, traced);
+
+    size_t      plain_len = strlen(BENCH_LINE);
+    size_t      found     = 0;
+    double      start     = now_ns();
+    for (long i = 0; i < records; i++)
+    {
+        found += prk_trace_find(BENCH_LINE, plain_len) != NULL;
+    }
+    double find_plain = (now_ns() - start) / records;
+
+    start = now_ns();
+    for (long i = 0; i < records; i++)
+    {
+        found += prk_trace_find(traced, (size_t)len) != NULL;
+    }
+    double find_traced = (now_ns() - start) / records;
+
+    char stamp[PRK_TRACE_STAMP_MAX];
+    start = now_ns();
+    for (long i = 0; i < records; i++)
+    {
+        found += prk_trace_format_stamp(PRK_TRACE_SRV, stamp, sizeof(stamp)) > 0;
+    }
+    double format_stamp = (now_ns() - start) / records;
+    printf("Per record: find %.1f ns untraced, %.1f ns traced; stamp %.1f ns (%zu)\n", find_plain, find_traced,
+           format_stamp, found);
+
+    /* Server and giis stamps, then the inserter */
+    len += prk_trace_format_stamp(PRK_TRACE_SRV, traced + len, sizeof(traced) - (size_t)len);
+    len += prk_trace_format_stamp(PRK_TRACE_GIIS, traced + len, sizeof(traced) - (size_t)len);
+
+    SensorReading reading;
+    start = now_ns();
+    for (long i = 0; i < records; i++)
+    {
+        parse_reading(BENCH_LINE, plain_len, &reading);
+    }
+    double parse_plain = (now_ns() - start) / records;
+
+    start = now_ns();
+    for (long i = 0; i < records; i++)
+    {
+        parse_reading(traced, (size_t)len, &reading);
+    }
+    double parse_traced = (now_ns() - start) / records;
+
+    TraceSink sink;
+    if (reading.trace == 0 || trace_sink_init(&sink, 1) != 0)
+    {
+        fprintf(stderr, "Trace suffix not found\n");
+        prk_metrics_close();
+        return 1;
+    }
+    start = now_ns();
+    for (long i = 0; i < records; i++)
+    {
+        trace_sink_add(&sink, traced + reading.trace, (size_t)len - reading.trace);
+        if (sink.pending_count == TRACE_SINK_BATCH)
+        {
+            trace_sink_commit(&sink);
+        }
+    }
+    trace_sink_commit(&sink);
+    double fold = (now_ns() - start) / records;
+    printf("Per record: parse %.1f ns untraced, %.1f ns traced; sink %.1f ns (parse, stamp and fold)\n",
+           parse_plain, parse_traced, fold);
+
+    /* Read back as out_trace_report does */
+    const PrkMetricsPage *page = prk_metrics_map(BENCH_STAGE);
+    uint64_t             folded = 0;
+    for (uint32_t i = 0; page && i < atomic_load(&page->count); i++)
+    {
+        if (strcmp(page->metrics[i].name, "prk_trace_end_to_end_seconds") == 0)
+        {
+            uint64_t buckets[PRK_HISTOGRAM_BUCKETS];
+            folded = prk_histogram_read(page, &page->metrics[i], buckets, NULL);
+        }
+    }
+    int rc = folded == (uint64_t)records ? 0 : 1;
+    printf("Read back: %llu end to end times for %ld traces: %s\n", (unsigned long long)folded, records,
+           rc == 0 ? "OK" : "MISMATCH");
+
+    if (page)
+    {
+        prk_metrics_unmap(page);
+    }
+    trace_sink_free(&sink);
+    prk_metrics_close();
+    return rc;
+}
@@ -0,0 +1,176 @@
+/**
+ * bench_tracepoint.c: Cost of a tracepoint, and of copying a ring while it is written
+ *
+ * Built with -DPRK_TRACEPOINTS whatever TRACEPOINTS says. Times, per event:
+ *   - an empty loop, for reference,
+ *   - PRK_TP_INSTANT(),
+ *   - a PRK_TP_SCOPE() span (two events),
+ *   - PRK_TP_INSTANT() from [threads] threads at once, each on its own ring,
+ * then copies a ring with prk_tp_copy_ring() while a thread keeps writing
+ * it, as out_tp_dump does with a running stage, and checks that every
+ * copy holds consecutive events only.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_tracepoint [threads]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "prk_tracepoint.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_STAGE            "bench_tracepoint"                    /* Page name, removed at the end */
+#define BENCH_EVENTS           (1 << 24)                             /* Events per thread and kind */
+#define BENCH_DEFAULT_THREADS  4
+#define BENCH_MAX_THREADS      (PRK_TP_RINGS - 1)
+#define BENCH_COPIES           200
+
+
+static volatile uint64_t    sink;                                    /* Keeps the empty loop */
+static _Atomic int          writing;                                 /* Writer of the copy test runs */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * span - One PRK_TP_SCOPE() span around nothing.
+ */
+static __attribute__((noinline)) void span(uint64_t i)
+{
+    PRK_TP_SCOPE(PRK_TP_INS_LINE, i, 0);
+    sink = i;
+}
+
+/**
+ * emit_events - Thread writing BENCH_EVENTS instants.
+ */
+static void *emit_events(void *arg)
+{
+    (void)arg;
+    for (uint64_t i = 0; i < BENCH_EVENTS; i++)
+    {
+        PRK_TP_INSTANT(PRK_TP_SERVER_RECORD, i, 0);
+    }
+    return NULL;
+}
+
+/**
+ * write_forever - Writer of the copy test: instants numbered from 0.
+ */
+static void *write_forever(void *arg)
+{
+    PrkTpRing **ring = arg;
+
+    PRK_TP_INSTANT(PRK_TP_SERVER_RECORD, 0, 0);
+    *ring = prk_tp_ring;
+    for (uint64_t i = 1; atomic_load(&writing); i++)
+    {
+        PRK_TP_INSTANT(PRK_TP_SERVER_RECORD, i, 0);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_THREADS;
+    if (threads < 1 || threads > BENCH_MAX_THREADS)
+    {
+        fprintf(stderr, "Usage: %s [threads]    (1 to %d)\n", argv[0], BENCH_MAX_THREADS);
+        return 1;
+    }
+    if (prk_tp_open(BENCH_STAGE) != 0)
+    {
+        return 1;
+    }
+
+    double start = now_ns();
+    for (uint64_t i = 0; i < BENCH_EVENTS; i++)
+    {
+        sink = i;
+    }
+    double empty = (now_ns() - start) / BENCH_EVENTS;
+
+    start = now_ns();
+    for (uint64_t i = 0; i < BENCH_EVENTS; i++)
+    {
+        PRK_TP_INSTANT(PRK_TP_SERVER_RECORD, i, 0);
+    }
+    double instant = (now_ns() - start) / BENCH_EVENTS;
+
+    start = now_ns();
+    for (uint64_t i = 0; i < BENCH_EVENTS; i++)
+    {
+        span(i);
+    }
+    double scope = (now_ns() - start) / BENCH_EVENTS;
+    printf("Per event, 1 thread: empty loop %.1f ns, instant %.1f ns, scope (2 events) %.1f ns\n", empty, instant,
+           scope);
+
+    pthread_t workers[BENCH_MAX_THREADS];
+    start = now_ns();
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_create(&workers[t], NULL, emit_events, NULL);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    double threaded = (now_ns() - start) / BENCH_EVENTS / threads;
+    printf("Per event, %d threads at once: %.1f ns (wall time / events)\n", threads, threaded);
+
+    /* Copies of a ring being written hold consecutive events only */
+    static PrkTpEvent   events[PRK_TP_RING_EVENTS];
+    PrkTpRing           *volatile ring = NULL;
+    pthread_t           writer;
+    size_t              copied = 0;
+    int                 broken = 0;
+
+    atomic_store(&writing, 1);
+    pthread_create(&writer, NULL, write_forever, (void *)&ring);
+    while (!ring)
+    {
+        sched_yield();
+    }
+    start = now_ns();
+    for (int c = 0; c < BENCH_COPIES; c++)
+    {
+        size_t count = prk_tp_copy_ring(ring, events);
+        for (size_t e = 1; e < count; e++)
+        {
+            broken += events[e].args[0] != events[e - 1].args[0] + 1;
+        }
+        copied += count;
+    }
+    double copy = (now_ns() - start) / BENCH_COPIES;
+    atomic_store(&writing, 0);
+    pthread_join(writer, NULL);
+
+    printf("Ring copy under a writer: %.1f us for %zu events on average, %d out of order: %s\n", copy / 1e3,
+           copied / BENCH_COPIES, broken, broken == 0 ? "OK" : "TORN");
+
+    prk_tp_close();
+    return broken == 0 ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+/**
+ * bench_update_prices.c: Price file synchronisation with many locations
+ *
+ * Creates a scratch database holding BENCH_DEFAULT_LOCATIONS priced
+ * locations and a price file, in scrambled order, in which one location in
+ * BENCH_CHANGE_EVERY has a new price, one in BENCH_REMOVE_EVERY is gone and
+ * as many new ones are added, then times each step out_update_prices runs:
+ * importing the file (with one thread, then one per CPU), loading the
+ * table, the merge diff and the transaction applying it. A second diff
+ * after the apply checks the table now matches the file.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_update_prices [locations] [threads]    (threads: 0, the default, for one per CPU)
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            parallel import, scrambled file
+ *
+ */
+
+#include "price_import.h"
+#include "price_sync.h"
+#include "prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define BENCH_DEFAULT_LOCATIONS 1000000                              /* Locations in the table */
+#define BENCH_CHANGE_EVERY     10                                    /* One location in this many is repriced */
+#define BENCH_REMOVE_EVERY     20                                    /* One in this many leaves, as many arrive */
+#define BENCH_STRIDE           1000003                               /* Prime; file line i holds location i * this */
+#define OLD_ENTRY_SIZE         108                                   /* sizeof(CityPrice) with a 100-byte name */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * fill_table - Insert @count locations "City <n>" in one transaction.
+ */
+static int fill_table(sqlite3 *db, long count)
+{
+    sqlite3_stmt *stmt = prk_db_prepare(db, "INSERT INTO Prices (location, price) VALUES (?, ?);");
+    char         city[MAX_LINE_LENGTH];
+
+    if (!stmt || prk_db_exec(db, "BEGIN;") != 0)
+    {
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+    for (long i = 0; i < count; i++)
+    {
+        snprintf(city, sizeof(city), "City %07ld", i);
+        sqlite3_bind_text(stmt, 1, city, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 2, (double)(100 + i % 1000) / 100.0);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            sqlite3_finalize(stmt);
+            return -1;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return prk_db_exec(db, "COMMIT;");
+}
+
+/**
+ * write_price_file - The table's locations, some repriced, removed or new.
+ */
+static int write_price_file(const char *path, long count)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return -1;
+    }
+    long stride = count % BENCH_STRIDE ? BENCH_STRIDE % count : 1;
+    for (long line = 0; line < count; line++)
+    {
+        long   i     = (long)((unsigned long long)line * (unsigned long long)stride % (unsigned long long)count);
+        double price = (double)(100 + i % 1000) / 100.0;
+        if (i % BENCH_REMOVE_EVERY == 1)
+        {
+            fprintf(file, "City %07ld, %.2f\n", count + i, price);   /* Replaces a removed one */
+            continue;
+        }
+        fprintf(file, "City %07ld, %.2f\n", i, (i % BENCH_CHANGE_EVERY == 0) ? price + 0.5 : price);
+    }
+    return fclose(file);
+}
+
+int main(int argc, char *argv[])
+{
+    long count   = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_LOCATIONS;
+    int  threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (count <= 0 || threads < 0)
+    {
+        fprintf(stderr, "Usage: %s [locations] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    char db_path[64], file_path[64];
+    snprintf(db_path, sizeof(db_path), "/tmp/bench_update_prices.%d.db", (int)getpid());
+    snprintf(file_path, sizeof(file_path), "/tmp/bench_update_prices.%d.txt", (int)getpid());
+
+    sqlite3 *db = prk_db_open(db_path);
+    if (!db || prk_db_create_schema(db) != 0 || fill_table(db, count) != 0 || write_price_file(file_path, count) != 0)
+    {
+        return 1;
+    }
+
+    PriceList           file_data, table_data;
+    PriceImportStats    stats;
+    PriceDiff           diff;
+
+    double start = now_ns();
+    if (price_import_file(file_path, 1, &file_data, &stats) != 0)
+    {
+        return 1;
+    }
+    double imported_one = now_ns();
+    price_list_free(&file_data);
+
+    double imported_start = now_ns();
+    if (price_import_file(file_path, threads, &file_data, &stats) != 0)
+    {
+        return 1;
+    }
+    double loaded_file = now_ns();
+    if (load_price_table(db, &table_data) != 0)
+    {
+        return 1;
+    }
+    double loaded_table = now_ns();
+    if (diff_prices(&table_data, &file_data, &diff) != 0)
+    {
+        return 1;
+    }
+    double diffed = now_ns();
+    int failed = apply_price_diff(db, &diff, (int64_t)time(NULL) * 1000) != 0;
+    double applied = now_ns();
+
+    printf("%ld locations: %zu added, %zu changed, %zu removed, %zu unchanged\n", count, diff.insert_count,
+           diff.update_count, diff.delete_count, diff.unchanged);
+    printf("%-12s %9.1f ms   (1 thread)\n", "import file", (imported_one - start) / 1e6);
+    printf("%-12s %9.1f ms   (%d threads)\n", "import file", (loaded_file - imported_start) / 1e6, stats.threads);
+    printf("%-12s %9.1f ms\n", "load table", (loaded_table - loaded_file) / 1e6);
+    printf("%-12s %9.1f ms\n", "diff", (diffed - loaded_table) / 1e6);
+    printf("%-12s %9.1f ms   (%.2f us per change)\n", "apply", (applied - diffed) / 1e6,
+           (applied - diffed) / 1e3 / (double)(diff.insert_count + diff.update_count + diff.delete_count));
+    printf("%-12s %9.1f ms\n", "total", (applied - imported_start) / 1e6);
+    printf("file entries: %.1f MB (%.1f MB with fixed 100-byte names)\n",
+           (double)(file_data.count * sizeof(CityPrice) + file_data.names.bytes) / 1e6,
+           (double)(file_data.count * OLD_ENTRY_SIZE) / 1e6);
+    price_diff_free(&diff);
+    price_list_free(&table_data);
+
+    /* The table now matches the file */
+    if (!failed && (load_price_table(db, &table_data) != 0 || diff_prices(&table_data, &file_data, &diff) != 0))
+    {
+        failed = 1;
+    }
+    else if (!failed)
+    {
+        failed = diff.insert_count + diff.update_count + diff.delete_count != 0;
+        printf("Second diff: %zu change(s)\n", diff.insert_count + diff.update_count + diff.delete_count);
+        price_diff_free(&diff);
+        price_list_free(&table_data);
+    }
+
+    price_list_free(&file_data);
+    prk_db_close(db);
+    unlink(db_path);
+    unlink(file_path);
+    snprintf(db_path + strlen(db_path), sizeof(db_path) - strlen(db_path), "-wal");
+    unlink(db_path);
+    snprintf(db_path + strlen(db_path) - 4, sizeof(db_path) - strlen(db_path) + 4, "-shm");
+    unlink(db_path);
+    return failed;
+}
@@ -0,0 +1,202 @@
+/**
+ * bench_zone_map.c: Zone assignment benchmark of the grid index
+ *
+ * Builds BENCH_ZONES rectangular lots of random size laid out on a square
+ * pitch with aisles in between, and classifies random points (some in the
+ * aisles, some outside the map):
+ *   - linear:  the scan of every zone the index replaces, on a sample,
+ *              also used to check the index returns the same zones,
+ *   - lookup:  zone_map_lookup() one point at a time,
+ *   - batch:   zone_map_lookup_batch() over BENCH_BATCH points per call.
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_zone_map [points] [zones]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "zone_map.h"
+#include "sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+
+#define BENCH_DEFAULT_ZONES    100000                                /* Lots in the map */
+#define BENCH_DEFAULT_POINTS   1000000                               /* Points classified per run */
+#define BENCH_PITCH            (25 * COORD_SCALE)                    /* Lot spacing, fixed point */
+#define BENCH_MIN_EDGE         (5 * COORD_SCALE)                     /* Smallest lot edge */
+#define BENCH_BATCH            4096                                  /* Points per batch call */
+#define BENCH_CHECK            2000                                  /* Points checked against the linear scan */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * build_lots - @count lots of random size on a square pitch, in random id order.
+ */
+static int build_lots(ZoneMap *map, size_t count, int32_t *extent)
+{
+    size_t side = (size_t)ceil(sqrt((double)count));
+
+    memset(map, 0, sizeof(*map));
+    map->zones = calloc(count, sizeof(Zone));
+    if (!map->zones)
+    {
+        perror("calloc");
+        return -1;
+    }
+    map->count = count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Zone    *zone  = &map->zones[i];
+        int32_t width  = BENCH_MIN_EDGE + rand() % (BENCH_PITCH - BENCH_MIN_EDGE);
+        int32_t height = BENCH_MIN_EDGE + rand() % (BENCH_PITCH - BENCH_MIN_EDGE);
+        zone->id    = (int64_t)i + 1;
+        zone->x_min = (int32_t)(i % side) * BENCH_PITCH + rand() % (BENCH_PITCH - width + 1);
+        zone->y_min = (int32_t)(i / side) * BENCH_PITCH + rand() % (BENCH_PITCH - height + 1);
+        zone->x_max = zone->x_min + width;
+        zone->y_max = zone->y_min + height;
+    }
+
+    /* Shuffle, zone_map_build() has to restore the id order */
+    for (size_t i = count - 1; i > 0; i--)
+    {
+        size_t j    = (size_t)rand() % (i + 1);
+        Zone   swap = map->zones[i];
+        map->zones[i] = map->zones[j];
+        map->zones[j] = swap;
+    }
+
+    *extent = (int32_t)side * BENCH_PITCH;
+    return 0;
+}
+
+/**
+ * linear_lookup - Reference: test every zone, lowest id first.
+ */
+static int64_t linear_lookup(const ZoneMap *map, int32_t x, int32_t y)
+{
+    for (size_t i = 0; i < map->count; i++)
+    {
+        const Zone *zone = &map->zones[i];
+        if (x >= zone->x_min && x < zone->x_max && y >= zone->y_min && y < zone->y_max)
+        {
+            return zone->id;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long points = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_POINTS;
+    long count  = argc > 2 ? atol(argv[2]) : BENCH_DEFAULT_ZONES;
+    if (points < BENCH_CHECK || count <= 0)
+    {
+        fprintf(stderr, "Usage: %s [points >= %d] [zones]\n", argv[0], BENCH_CHECK);
+        return 1;
+    }
+
+    ZoneMap map;
+    int32_t extent;
+    srand(42);
+    if (build_lots(&map, (size_t)count, &extent) != 0)
+    {
+        return 1;
+    }
+
+    double start = now_ns();
+    if (zone_map_build(&map) != 0)
+    {
+        zone_map_free(&map);
+        return 1;
+    }
+    double build_ms = (now_ns() - start) / 1e6;
+
+    int32_t *x        = malloc((size_t)points * sizeof(int32_t));
+    int32_t *y        = malloc((size_t)points * sizeof(int32_t));
+    int64_t *zone_ids = malloc((size_t)points * sizeof(int64_t));
+    if (!x || !y || !zone_ids)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    /* Points over the map and a 5% margin around it */
+    int32_t margin = extent / 20;
+    for (long i = 0; i < points; i++)
+    {
+        x[i] = -margin + (int32_t)(((int64_t)rand() * RAND_MAX + rand()) % (extent + 2 * margin));
+        y[i] = -margin + (int32_t)(((int64_t)rand() * RAND_MAX + rand()) % (extent + 2 * margin));
+    }
+
+    printf("%ld zones, grid %u x %u cells of %.2f, %.2f zone entries per cell, built in %.1f ms\n", count,
+           map.columns, map.rows, (double)(1LL << map.cell_shift) / COORD_SCALE,
+           (double)map.cell_start[(size_t)map.columns * map.rows] / ((double)map.columns * map.rows), build_ms);
+
+    /* Reference scan on a sample */
+    int64_t expected[BENCH_CHECK];
+    start = now_ns();
+    for (int i = 0; i < BENCH_CHECK; i++)
+    {
+        expected[i] = linear_lookup(&map, x[i], y[i]);
+    }
+    double linear_ns = (now_ns() - start) / BENCH_CHECK;
+
+    volatile int64_t sink = 0;
+    start = now_ns();
+    for (long i = 0; i < points; i++)
+    {
+        sink += zone_map_lookup(&map, x[i], y[i]);
+    }
+    double lookup_ns = (now_ns() - start) / (double)points;
+
+    start = now_ns();
+    for (long i = 0; i < points; i += BENCH_BATCH)
+    {
+        size_t n = (size_t)(points - i < BENCH_BATCH ? points - i : BENCH_BATCH);
+        zone_map_lookup_batch(&map, x + i, y + i, n, zone_ids + i);
+    }
+    double batch_ns = (now_ns() - start) / (double)points;
+
+    long mismatches = 0, zoned = 0;
+    for (long i = 0; i < points; i++)
+    {
+        zoned      += zone_ids[i] != 0;
+        mismatches += i < BENCH_CHECK && zone_ids[i] != expected[i];
+        mismatches += zone_ids[i] != zone_map_lookup(&map, x[i], y[i]);
+    }
+
+    printf("%-8s %10d points   %10.1f ns/point   %12.0f points/s\n", "linear", BENCH_CHECK, linear_ns,
+           1e9 / linear_ns);
+    printf("%-8s %10ld points   %10.1f ns/point   %12.0f points/s\n", "lookup", points, lookup_ns, 1e9 / lookup_ns);
+    printf("%-8s %10ld points   %10.1f ns/point   %12.0f points/s\n", "batch", points, batch_ns, 1e9 / batch_ns);
+    printf("%.1f%% of the points in a zone, %ld mismatch(es)\n", 100.0 * zoned / points, mismatches);
+
+    free(x);
+    free(y);
+    free(zone_ids);
+    zone_map_free(&map);
+    return mismatches != 0;
+}
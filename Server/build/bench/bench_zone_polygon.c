@@ -0,0 +1,269 @@
+/**
+ * bench_zone_polygon.c: Point-in-polygon kernels and polygon zone assignment
+ *
+ * Two measurements:
+ *   - kernels: one concave BENCH_KERNEL_VERTICES-gon against many points with
+ *              each pip_classify_with() kernel, checked against pip_contains(),
+ *   - zones:   BENCH_POLYGONS irregular star-shaped lots in a ZoneMap,
+ *              zone_map_lookup() per point against zone_map_lookup_batch(),
+ *              once for points spread over the whole map and once for
+ *              batches whose readings come from BENCH_BUSY_LOTS lots (the
+ *              sensors that reported since the last batch).
+ *
+ * Compilation:
+ *      make bench    (from Server/build/make)
+ *
+ * Usage:
+ *      ./bench_zone_polygon [points] [polygons]
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "zone_map.h"
+#include "point_in_polygon.h"
+#include "sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+
+#define BENCH_DEFAULT_POINTS   1000000                               /* Points classified per measurement */
+#define BENCH_DEFAULT_POLYGONS 5000                                  /* Lots in the zone map */
+#define BENCH_KERNEL_VERTICES  24                                    /* Vertices of the kernel test polygon */
+#define BENCH_MIN_VERTICES     8                                     /* Vertices of a lot */
+#define BENCH_MAX_VERTICES     24
+#define BENCH_PITCH            (40 * COORD_SCALE)                    /* Lot spacing, fixed point */
+#define BENCH_BUSY_LOTS        64                                    /* Lots reporting in one clustered batch */
+#define BENCH_BATCH            ZONE_BATCH_CHUNK                      /* Points per batch call */
+
+
+/**
+ * now_ns - Monotonic clock in nanoseconds.
+ */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * random_in - Uniform integer in [@lo, @hi).
+ */
+static int32_t random_in(int32_t lo, int32_t hi)
+{
+    return lo + (int32_t)(((int64_t)rand() * RAND_MAX + rand()) % (hi - lo));
+}
+
+/**
+ * star_polygon - Concave polygon of @count vertices around (@cx, @cy), radius up to @radius.
+ *
+ * Vertices at increasing angles keep the ring simple (no self-intersection).
+ */
+static void star_polygon(int32_t cx, int32_t cy, int32_t radius, size_t count, int32_t *x, int32_t *y)
+{
+    for (size_t v = 0; v < count; v++)
+    {
+        double angle = 2 * M_PI * ((double)v + 0.8 * rand() / RAND_MAX) / (double)count;
+        double r     = radius * (0.5 + 0.5 * rand() / RAND_MAX);
+        x[v] = cx + (int32_t)lround(r * cos(angle));
+        y[v] = cy + (int32_t)lround(r * sin(angle));
+    }
+}
+
+/**
+ * bench_kernels - Time every kernel on one polygon.
+ *
+ * Return: number of results differing from pip_contains().
+ */
+static long bench_kernels(size_t points)
+{
+    int32_t     vx[BENCH_KERNEL_VERTICES], vy[BENCH_KERNEL_VERTICES];
+    PolygonEdge edges[BENCH_KERNEL_VERTICES];
+    double      *x       = malloc(points * sizeof(double));
+    double      *y       = malloc(points * sizeof(double));
+    uint8_t     *inside  = malloc(points);
+    uint8_t     *inside0 = malloc(points);
+    long        mismatches = 0;
+
+    if (!x || !y || !inside || !inside0)
+    {
+        perror("malloc");
+        exit(1);
+    }
+
+    star_polygon(0, 0, BENCH_PITCH / 2, BENCH_KERNEL_VERTICES, vx, vy);
+    for (size_t v = 0; v < BENCH_KERNEL_VERTICES; v++)
+    {
+        size_t next = (v + 1) % BENCH_KERNEL_VERTICES;
+        pip_edge(&edges[v], vx[v], vy[v], vx[next], vy[next]);
+    }
+    for (size_t i = 0; i < points; i++)
+    {
+        x[i] = random_in(-BENCH_PITCH / 2, BENCH_PITCH / 2);
+        y[i] = random_in(-BENCH_PITCH / 2, BENCH_PITCH / 2);
+        inside0[i] = (uint8_t)pip_contains(edges, BENCH_KERNEL_VERTICES, x[i], y[i]);
+    }
+
+    printf("Kernels, %d-gon, best on this CPU: %s\n", BENCH_KERNEL_VERTICES, pip_kernel_name(pip_best_kernel()));
+    for (pip_kernel_t kernel = PIP_SCALAR; kernel < PIP_KERNELS; kernel++)
+    {
+        double start = now_ns();
+        pip_classify_with(kernel, edges, BENCH_KERNEL_VERTICES, x, y, points, inside);
+        double ns = (now_ns() - start) / (double)points;
+
+        long differ = 0;
+        for (size_t i = 0; i < points; i++)
+        {
+            differ += inside[i] != inside0[i];
+        }
+        mismatches += differ;
+        printf("  %-8s %8.2f ns/point   %8.0f M edge tests/s   %ld mismatch(es)\n", pip_kernel_name(kernel), ns,
+               BENCH_KERNEL_VERTICES * 1e3 / ns, differ);
+    }
+
+    free(x);
+    free(y);
+    free(inside);
+    free(inside0);
+    return mismatches;
+}
+
+/**
+ * build_lots - @count star-shaped lots on a square pitch.
+ *
+ * Return: edge of the square map, * COORD_SCALE.
+ */
+static int32_t build_lots(ZoneMap *map, size_t count)
+{
+    size_t  side = (size_t)ceil(sqrt((double)count));
+    int32_t vx[BENCH_MAX_VERTICES], vy[BENCH_MAX_VERTICES];
+
+    memset(map, 0, sizeof(*map));
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t  vertices = BENCH_MIN_VERTICES + (size_t)rand() % (BENCH_MAX_VERTICES - BENCH_MIN_VERTICES + 1);
+        int32_t cx       = (int32_t)(i % side) * BENCH_PITCH + BENCH_PITCH / 2;
+        int32_t cy       = (int32_t)(i / side) * BENCH_PITCH + BENCH_PITCH / 2;
+        star_polygon(cx, cy, BENCH_PITCH * 11 / 20, vertices, vx, vy);  /* Neighbours' boxes overlap */
+        if (zone_map_add_polygon(map, (int64_t)i + 1, vx, vy, vertices) != 0)
+        {
+            exit(1);
+        }
+    }
+    if (zone_map_build(map) != 0)
+    {
+        exit(1);
+    }
+    return (int32_t)side * BENCH_PITCH;
+}
+
+/**
+ * bench_zones - Time per point and batch assignment of @points points.
+ *
+ * Return: number of batch results differing from zone_map_lookup().
+ */
+static long bench_zones(const char *name, const ZoneMap *map, const int32_t *x, const int32_t *y, size_t points)
+{
+    int64_t          *zone_ids = malloc(points * sizeof(int64_t));
+    volatile int64_t sink      = 0;
+    long             mismatches = 0, zoned = 0;
+
+    if (!zone_ids)
+    {
+        perror("malloc");
+        exit(1);
+    }
+
+    double start = now_ns();
+    for (size_t i = 0; i < points; i++)
+    {
+        sink += zone_map_lookup(map, x[i], y[i]);
+    }
+    double lookup_ns = (now_ns() - start) / (double)points;
+
+    start = now_ns();
+    for (size_t i = 0; i < points; i += BENCH_BATCH)
+    {
+        size_t n = points - i < BENCH_BATCH ? points - i : BENCH_BATCH;
+        zone_map_lookup_batch(map, x + i, y + i, n, zone_ids + i);
+    }
+    double batch_ns = (now_ns() - start) / (double)points;
+
+    for (size_t i = 0; i < points; i++)
+    {
+        zoned      += zone_ids[i] != 0;
+        mismatches += zone_ids[i] != zone_map_lookup(map, x[i], y[i]);
+    }
+    printf("  %-10s lookup %7.1f ns/point   batch %7.1f ns/point   %4.1f%% zoned   %ld mismatch(es)\n", name,
+           lookup_ns, batch_ns, 100.0 * zoned / points, mismatches);
+
+    free(zone_ids);
+    return mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+    long points   = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_POINTS;
+    long polygons = argc > 2 ? atol(argv[2]) : BENCH_DEFAULT_POLYGONS;
+    if (points <= 0 || polygons <= 0)
+    {
+        fprintf(stderr, "Usage: %s [points] [polygons]\n", argv[0]);
+        return 1;
+    }
+    srand(42);
+
+    long mismatches = bench_kernels((size_t)points);
+
+    ZoneMap map;
+    double  start  = now_ns();
+    int32_t extent = build_lots(&map, (size_t)polygons);
+    printf("Zones, %ld polygons with %zu edges, grid %u x %u, built in %.1f ms\n", polygons, map.edge_count,
+           map.columns, map.rows, (now_ns() - start) / 1e6);
+
+    int32_t *x = malloc((size_t)points * sizeof(int32_t));
+    int32_t *y = malloc((size_t)points * sizeof(int32_t));
+    if (!x || !y)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    for (long i = 0; i < points; i++)
+    {
+        x[i] = random_in(0, extent);
+        y[i] = random_in(0, extent);
+    }
+    mismatches += bench_zones("spread", &map, x, y, (size_t)points);
+
+    /* Each batch draws its readings from BENCH_BUSY_LOTS random lots */
+    int32_t side = extent / BENCH_PITCH;
+    for (long base = 0; base < points; base += BENCH_BATCH)
+    {
+        int32_t busy[BENCH_BUSY_LOTS];
+        for (int b = 0; b < BENCH_BUSY_LOTS; b++)
+        {
+            busy[b] = random_in(0, (int32_t)polygons);
+        }
+        for (long i = base; i < base + BENCH_BATCH && i < points; i++)
+        {
+            int32_t lot = busy[rand() % BENCH_BUSY_LOTS];
+            x[i] = (lot % side) * BENCH_PITCH + random_in(0, BENCH_PITCH);
+            y[i] = (lot / side) * BENCH_PITCH + random_in(0, BENCH_PITCH);
+        }
+    }
+    mismatches += bench_zones("clustered", &map, x, y, (size_t)points);
+
+    free(x);
+    free(y);
+    zone_map_free(&map);
+    return mismatches != 0;
+}
@@ -0,0 +1,174 @@
+#ifndef BILLING_H
+#define BILLING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "reading_store.h"
+#include "zone_map.h"
+#include "price_table.h"
+#include "price_history.h"
+#include "sensor_table.h"
+
+
+#define BILLING_SESSION_TIMEOUT_MS (10 * 60 * 1000)                  /* Close a session silent this long */
+#define BILLING_PRICE_UNIT_MS  PRICE_UNIT_MS                         /* Prices.price is per hour parked */
+#define BILLING_PRICE_REFRESH_MS 60000                               /* Rebuild the local prices, retry the shared table */
+
+
+/* Why an invoice's session ended (Invoices.closed_by) */
+#define BILLING_CLOSED_DEPARTED 'D'                                  /* The sensor reported a non-parked status */
+#define BILLING_CLOSED_MOVED    'M'                                  /* Parked again in another zone */
+#define BILLING_CLOSED_TIMEOUT  'T'                                  /* No reading for BILLING_SESSION_TIMEOUT_MS */
+
+
+/*
+ * Open parking session of one sensor. Open sessions are linked in
+ * last_seen order (oldest first) so expired ones are found at the head of
+ * the list without scanning the others.
+ */
+typedef struct
+{
+    int64_t   start_ms;                                              /* recv_time of the first parked reading, 0 if closed */
+    int64_t   last_seen;                                             /* recv_time of the newest parked reading */
+    int64_t   zone_id;                                               /* Zones.id, 0 outside every zone */
+    int64_t   prev;                                                  /* Sensor id of the previous session, 0 if head */
+    int64_t   next;                                                  /* Sensor id of the next session, 0 if tail */
+    int32_t   x;                                                     /* Position the zone was looked up for */
+    int32_t   y;
+    uint8_t   dirty;                                                 /* Opened since the last save */
+} BillingSession;
+
+
+/* Closed session waiting for the next flush */
+typedef struct
+{
+    int64_t   sensor_id;
+    int64_t   zone_id;
+    int64_t   start_ms;
+    int64_t   end_ms;
+    char      closed_by;                                             /* BILLING_CLOSED_* */
+} BillingClosed;
+
+
+/* Open sessions of all sensors, indexed by Sensors.id, and the invoices to write */
+typedef struct
+{
+    const ZoneMap   *zones;                                          /* Zone of a parked position */
+    SensorTable     sessions;                                        /* BillingSession, by sensor id; listed: to save */
+    int64_t         oldest;                                          /* Head of the last_seen list, 0 if empty */
+    int64_t         newest;                                          /* Tail of the last_seen list */
+    size_t          open;                                            /* Sessions in the list */
+    BillingClosed   *closed;                                         /* Sessions closed since the last flush */
+    size_t          closed_count;                                    /* Used entries of closed */
+    size_t          closed_capacity;                                 /* Allocated entries of closed */
+    PriceTable      *local_prices;                                   /* Built from the database */
+    int64_t         prices_loaded_ms;                                /* now_ms of the last reload */
+    PriceTableReader shared_prices;                                  /* Shared price table, used when published */
+    int64_t         shared_attach_ms;                                /* now_ms of the last attach attempt */
+    PriceHistory    history;                                         /* Past prices, loaded when a session needs one */
+    int64_t         history_valid_from;                              /* Latest valid_from the history holds, 0 before */
+    PriceHistoryQuery *history_queries;                              /* Scratch of billing_flush() */
+    const PriceInterval **history_results;                           /* Scratch of billing_flush() */
+    size_t          history_capacity;                                /* Entries of both scratch arrays */
+    uint64_t        opened;                                          /* Sessions opened */
+    uint64_t        invoiced;                                        /* Rows written to Invoices */
+    uint64_t        unpriced;                                        /* Of which without a price */
+    uint64_t        repriced;                                        /* Of which at a price since replaced */
+    uint64_t        timeouts;                                        /* Sessions closed by the timeout */
+    sqlite3_stmt    *invoice_stmt;                                   /* Insert into Invoices */
+    sqlite3_stmt    *save_stmt;                                      /* Upsert into Billing_Sessions */
+    sqlite3_stmt    *forget_stmt;                                    /* Delete from Billing_Sessions */
+    sqlite3         *db;
+} BillingEngine;
+
+
+/**
+ * billing_init - Load the prices and the sessions left open by the last run.
+ *
+ * Billing_Sessions holds the open sessions as of the last committed
+ * flush, so they survive a crash as well as a shutdown: a session's row is
+ * deleted by the flush that writes its invoice, so it is never billed twice.
+ * A session's last reading is the later of its saved last_seen and the
+ * sensor's Sensor_State.last_seen, which is kept current without billing
+ * rewriting the row on every reading.
+ *
+ * @engine: Engine to initialize.
+ * @db:     Open database at schema version 9 or later, outside a transaction.
+ * @zones:  Zones of the parked positions; must outlive the engine.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int billing_init(BillingEngine *engine, sqlite3 *db, const ZoneMap *zones);
+
+
+/**
+ * billing_update - Apply a stored reading to its sensor's session.
+ *
+ * A parked reading opens a session or extends the open one; a session
+ * parked again in another zone is closed and a new one opened there. Any
+ * other status closes the open session at the reading's time. Only memory
+ * is touched, in constant time: the zone is looked up only when the
+ * position changes.
+ *
+ * @engine:  Billing engine.
+ * @reading: Reading just stored.
+ */
+void billing_update(BillingEngine *engine, const StoredReading *reading);
+
+
+/**
+ * billing_due - Whether billing_flush() has work at @now_ms.
+ *
+ * @engine: Billing engine.
+ * @now_ms: CLOCK_REALTIME in ms, the clock of StoredReading.recv_time.
+ */
+int billing_due(const BillingEngine *engine, int64_t now_ms);
+
+
+/**
+ * billing_flush - Close the timed out sessions and write the invoices.
+ *
+ * A session with no reading for BILLING_SESSION_TIMEOUT_MS ends at its last
+ * reading. Each closed session is priced against the shared price table
+ * when out_update_prices publishes one, otherwise against a table built
+ * from the database, rebuilt first when older than BILLING_PRICE_REFRESH_MS:
+ * the zone's compiled schedule if it has one (see price_schedule_cost()),
+ * else price * duration / BILLING_PRICE_UNIT_MS; the amount is rounded to
+ * cents and the price written is the average rate per hour. A session
+ * that started before its zone's flat price last changed is billed at the
+ * price of its start instead, all such sessions of a flush looked up in
+ * one price_history_find_batch(). A session outside every zone, or in a
+ * zone without a price when it closes, is written with NULL price and
+ * amount, without a history lookup.
+ * A session whose invoice could not be written stays queued for the next
+ * flush. The flush deletes the invoiced sessions from Billing_Sessions and
+ * saves the sessions opened since the last one.
+ * Call inside the transaction that stored the readings.
+ *
+ * @engine: Billing engine.
+ * @now_ms: CLOCK_REALTIME in ms.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int billing_flush(BillingEngine *engine, int64_t now_ms);
+
+
+/**
+ * billing_save - Store the open sessions in Billing_Sessions (shutdown).
+ *
+ * Brings every saved last_seen up to date. Call inside a transaction,
+ * after the last billing_flush().
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int billing_save(BillingEngine *engine);
+
+
+/**
+ * billing_free - Release the engine.
+ */
+void billing_free(BillingEngine *engine);
+
+
+#endif  /* BILLING_H */
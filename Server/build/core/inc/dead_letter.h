@@ -0,0 +1,157 @@
+#ifndef DEAD_LETTER_H
+#define DEAD_LETTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "sensor_parser.h"
+
+
+#define DEAD_LETTER_PATH       "giis/dead_letter.log"                /* Log of rejected records */
+#define DLQ_MAX_BYTES          (16 * 1024 * 1024)                    /* Rotate to <path>.1 beyond this size */
+#define DLQ_BUFFER_SIZE        (64 * 1024)                           /* Records buffered between flushes */
+#define DLQ_RECORD_MAX         1024                                  /* Longer raw records are truncated */
+#define DLQ_SOURCE_SLOTS       256                                   /* Distinct sources counted individually */
+#define DLQ_REPORT_INTERVAL_MS 1000                                  /* At most one stderr report per interval */
+#define DLQ_MAGIC              0x514c4444u                           /* "DDLQ", start of every record */
+
+
+/*
+ * Why a record was rejected. Parse failures keep their parse_status_t
+ * value; failures after parsing follow them.
+ */
+typedef enum
+{
+    DLQ_REASON_SENSOR = PARSE_ERR_COUNT,                             /* Sensor id could not be resolved */
+    DLQ_REASON_STORE,                                                /* Storage backend refused the reading */
+    DLQ_REASON_COUNT                                                 /* Number of reason codes, keep last */
+} dlq_reason_t;
+
+
+/*
+ * On-disk record: header followed by len raw bytes (no delimiter). All
+ * fields are in host byte order; the log is read back on the same machine.
+ */
+typedef struct
+{
+    uint32_t  magic;                                                 /* DLQ_MAGIC */
+    uint16_t  len;                                                   /* Raw bytes following the header */
+    uint8_t   reason;                                                /* parse_status_t or dlq_reason_t */
+    uint8_t   truncated;                                             /* Raw record was longer than len */
+    int64_t   time_ms;                                               /* Rejection time, ms since the epoch */
+} DeadLetterHeader;
+
+
+/* Rejections of one source (gateway MAC, 0 if the MAC was unreadable) */
+typedef struct
+{
+    uint64_t  mac;                                                   /* Source MAC */
+    uint64_t  count;                                                 /* Records rejected */
+    uint8_t   last_reason;                                           /* Reason of the latest rejection */
+    int       used;                                                  /* Slot holds a source */
+} DeadLetterSource;
+
+
+/* Dead-letter sink state */
+typedef struct
+{
+    char              path[256];                                     /* Log path */
+    int               fd;                                            /* Log file, O_APPEND */
+    size_t            file_size;                                     /* Current log size */
+    char              buffer[DLQ_BUFFER_SIZE];                       /* Pending records */
+    size_t            buffered;                                      /* Bytes used in buffer */
+    uint64_t          reasons[DLQ_REASON_COUNT];                     /* Rejections per reason */
+    DeadLetterSource  sources[DLQ_SOURCE_SLOTS];                     /* Open addressing by MAC */
+    uint64_t          other_sources;                                 /* Rejections of sources beyond the table */
+    uint64_t          total;                                         /* All rejections */
+    uint64_t          dropped;                                       /* Records that could not be logged */
+    int64_t           last_report_ms;                                /* Time of the last stderr report */
+    uint64_t          suppressed;                                    /* Rejections since the last report */
+} DeadLetter;
+
+
+/**
+ * dead_letter_replay_handler_t - Callback for each record read back from a log.
+ *
+ * @record: Raw record, NUL-terminated.
+ * @len:    Length of @record.
+ * @header: Header the record was logged with.
+ * @ctx:    Caller context.
+ */
+typedef void (*dead_letter_replay_handler_t)(char *record, size_t len, const DeadLetterHeader *header, void *ctx);
+
+
+/**
+ * dead_letter_open - Open (or create) the dead-letter log.
+ *
+ * @dlq:  Sink to initialize (large, keep it off the stack).
+ * @path: Log path, usually DEAD_LETTER_PATH.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int dead_letter_open(DeadLetter *dlq, const char *path);
+
+
+/**
+ * dead_letter_reject - Record one rejected raw record.
+ *
+ * Counts the record per reason and per source and buffers it for the log;
+ * the cost does not depend on how much bad input arrives. At most one line
+ * per DLQ_REPORT_INTERVAL_MS goes to stderr, summarising the rejections
+ * suppressed since the previous one.
+ *
+ * @dlq:    Dead-letter sink.
+ * @record: Raw record as received.
+ * @len:    Length of @record.
+ * @reason: parse_status_t error or dlq_reason_t.
+ */
+void dead_letter_reject(DeadLetter *dlq, const char *record, size_t len, unsigned reason);
+
+
+/**
+ * dead_letter_flush - Write buffered records to the log, rotating it when
+ *                     it would exceed DLQ_MAX_BYTES.
+ *
+ * Return: 0 on success, -1 if records had to be dropped.
+ */
+int dead_letter_flush(DeadLetter *dlq);
+
+
+/**
+ * dead_letter_print - Print per-reason and per-source counters to @out.
+ */
+void dead_letter_print(const DeadLetter *dlq, FILE *out);
+
+
+/**
+ * dead_letter_close - Flush and close the log.
+ */
+void dead_letter_close(DeadLetter *dlq);
+
+
+/**
+ * dead_letter_reason_str - Human readable name of a reason code.
+ */
+const char *dead_letter_reason_str(unsigned reason);
+
+
+/**
+ * dead_letter_replay - Feed every record of a dead-letter log to @handler.
+ *
+ * The log is first renamed to "<path>.replay" so records rejected again
+ * while replaying go to a fresh log instead of the one being read. The
+ * renamed file is removed once it was read to the end; one left behind by
+ * a replay that did not finish is replayed first, before the rename.
+ *
+ * @dlq:     Sink that receives records rejected again; reopened if it
+ *           writes to @path.
+ * @path:    Log to replay.
+ * @handler: Called once per record.
+ * @ctx:     Passed to @handler.
+ *
+ * Return: number of records replayed, or -1 on failure.
+ */
+long dead_letter_replay(DeadLetter *dlq, const char *path, dead_letter_replay_handler_t handler, void *ctx);
+
+
+#endif  /* DEAD_LETTER_H */
@@ -0,0 +1,146 @@
+#ifndef DEDUP_WINDOW_H
+#define DEDUP_WINDOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "sensor_table.h"
+
+
+#define DEDUP_WINDOW_BITS      64                                    /* Out-of-order tolerance, in sequence numbers */
+
+
+/* Outcome of checking one sequence number */
+typedef enum
+{
+    DEDUP_ACCEPT = 0,                                                /* New reading, store it */
+    DEDUP_DUPLICATE,                                                 /* Already seen inside the window */
+    DEDUP_STALE                                                      /* Older than the window, assumed seen */
+} dedup_result_t;
+
+
+/* Per-sensor state: high-water mark plus a bitmap of the last 64 numbers */
+typedef struct
+{
+    uint64_t  high;                                                  /* Highest sequence number accepted */
+    uint64_t  seen;                                                  /* Bit i set: (high - i) was accepted */
+    int       dirty;                                                 /* Changed since the last flush */
+    int       undo_listed;                                           /* Saved in the undo log of the open batch */
+} DedupEntry;
+
+
+/* Entry as it was before the open batch changed it */
+typedef struct
+{
+    int64_t     sensor_id;
+    DedupEntry  entry;
+} DedupUndo;
+
+
+/* Duplicate counters, exposed through dedup_window_stats() */
+typedef struct
+{
+    uint64_t  accepted;                                              /* Sequenced readings accepted */
+    uint64_t  unsequenced;                                           /* Readings without a sequence number */
+    uint64_t  duplicates;                                            /* Dropped: seen inside the window */
+    uint64_t  stale;                                                 /* Dropped: older than the window */
+} DedupStats;
+
+
+/* Dedup state for all sensors, indexed by Sensors.id */
+typedef struct
+{
+    SensorTable   table;                                             /* DedupEntry; listed: unsaved high-water marks */
+    DedupUndo     *undo;                                             /* Entries changed by the open batch */
+    size_t        undo_count;
+    size_t        undo_capacity;
+    DedupStats    stats;                                             /* Counters */
+    sqlite3_stmt  *save_stmt;                                        /* Upsert into Sensor_Seq */
+} DedupWindow;
+
+
+/**
+ * dedup_window_init - Create the window and load high-water marks.
+ *
+ * High-water marks and the bitmap below them persist in the Sensor_Seq
+ * table, so a restarted inserter or a --replay run still drops readings
+ * stored before and accepts the ones missing in the window.
+ *
+ * @window: Window to initialize.
+ * @db:     Open database containing the Sensor_Seq table.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int dedup_window_init(DedupWindow *window, sqlite3 *db);
+
+
+/**
+ * dedup_window_check - Decide whether a reading is new.
+ *
+ * Nothing is recorded: a reading that is accepted and then fails to be
+ * stored must still be accepted when it is sent again or replayed from
+ * the dead-letter log. Call dedup_window_commit() once it is stored.
+ *
+ * @window:    Dedup window.
+ * @sensor_id: Sensors.id of the reading.
+ * @seq:       Sequence number from the gateway, 0 if the reading has none.
+ *
+ * Return: DEDUP_ACCEPT if the reading should be stored.
+ */
+dedup_result_t dedup_window_check(DedupWindow *window, int64_t sensor_id, uint64_t seq);
+
+
+/**
+ * dedup_window_commit - Record a reading accepted by dedup_window_check().
+ *
+ * @window:    Dedup window.
+ * @sensor_id: Sensors.id of the reading.
+ * @seq:       Its sequence number, 0 if it has none.
+ */
+void dedup_window_commit(DedupWindow *window, int64_t sensor_id, uint64_t seq);
+
+
+/**
+ * dedup_window_batch_done - The batch holding the recorded readings is committed.
+ *
+ * @window: Dedup window.
+ */
+void dedup_window_batch_done(DedupWindow *window);
+
+
+/**
+ * dedup_window_rollback - Forget the readings recorded since the last batch_done.
+ *
+ * Call after a rollback: the readings of the lost batch are accepted again
+ * when they are resent or replayed from the dead-letter log.
+ *
+ * @window: Dedup window.
+ */
+void dedup_window_rollback(DedupWindow *window);
+
+
+/**
+ * dedup_window_flush - Persist changed high-water marks.
+ *
+ * Call inside the transaction that stored the accepted readings.
+ *
+ * @window: Dedup window.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int dedup_window_flush(DedupWindow *window);
+
+
+/**
+ * dedup_window_stats - Current duplicate counters.
+ */
+const DedupStats *dedup_window_stats(const DedupWindow *window);
+
+
+/**
+ * dedup_window_free - Release the window.
+ */
+void dedup_window_free(DedupWindow *window);
+
+
+#endif  /* DEDUP_WINDOW_H */
@@ -0,0 +1,216 @@
+#ifndef EVENT_COMPACTOR_H
+#define EVENT_COMPACTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "reading_store.h"
+#include "sensor_parser.h"
+#include "sensor_table.h"
+
+
+#define COMPACT_MOVE_THRESHOLD (2 * COORD_SCALE)                     /* Distance that is a move */
+#define COMPACT_HYSTERESIS     2                                     /* Readings confirming a status change */
+#define COMPACT_HOLD_MS        5000                                  /* Or silence confirming it */
+#define COMPACT_KEEPALIVE_MS   (5 * 60 * 1000)                       /* Store an unchanged sensor this often */
+#define COMPACT_ARCHIVE_BUFFER (64 * 1024)                           /* stdio buffer of the raw archive */
+
+
+/* Why a reading was stored (EventCompactorStats.events) */
+typedef enum
+{
+    COMPACT_EVENT_FIRST = 0,                                         /* First reading of the sensor */
+    COMPACT_EVENT_ARRIVAL,                                           /* Status became 'S' (parked) */
+    COMPACT_EVENT_DEPARTURE,                                         /* Status left 'S' */
+    COMPACT_EVENT_MOVE,                                              /* Moved beyond the threshold */
+    COMPACT_EVENT_KEEPALIVE,                                         /* Unchanged for keepalive_ms */
+    COMPACT_EVENTS
+} compact_event_t;
+
+
+/* Tuning of the compaction, see the COMPACT_* defaults */
+typedef struct
+{
+    int         enabled;                                             /* 0: every reading is stored */
+    int32_t     move_threshold;                                      /* * COORD_SCALE, 3D distance */
+    int         hysteresis;                                          /* 1 stores a status change at once */
+    int64_t     hold_ms;
+    int64_t     keepalive_ms;                                        /* 0: no keepalives */
+    const char  *archive_path;                                       /* Raw records also go here, or NULL */
+} EventCompactorConfig;
+
+
+/* Last stored reading of one sensor and its unconfirmed status change */
+typedef struct
+{
+    int64_t   stored_time;                                           /* recv_time of the last stored reading, 0 if none */
+    int32_t   x;                                                     /* Position of the last stored reading */
+    int32_t   y;
+    int32_t   z;
+    char      status;                                                /* Status of the last stored reading */
+    char      pending_listed;                                        /* In EventCompactor.table.listed */
+    char      undo_listed;                                           /* Saved in the undo log of the open batch */
+    uint16_t  confirmations;                                         /* Readings agreeing with the candidate */
+    StoredReading candidate;                                         /* First reading of a new status, status 0 if none */
+} CompactorEntry;
+
+
+/* Entry as it was before the open batch changed it */
+typedef struct
+{
+    int64_t         sensor_id;
+    CompactorEntry  entry;
+} CompactorUndo;
+
+
+/* Counters for print_counters() */
+typedef struct
+{
+    uint64_t  readings;                                              /* Readings filtered */
+    uint64_t  stored;                                                /* Of which stored */
+    uint64_t  events[COMPACT_EVENTS];                                /* Stored, per reason */
+    uint64_t  flaps;                                                 /* Status changes reverted before confirmation */
+    uint64_t  archived;                                              /* Records written to the raw archive */
+} EventCompactorStats;
+
+
+/* Per sensor state of the compaction, indexed by Sensors.id */
+typedef struct
+{
+    EventCompactorConfig    config;
+    SensorTable             table;                                   /* CompactorEntry; listed: held candidates */
+    CompactorUndo           *undo;                                   /* Entries changed by the open batch */
+    size_t                  undo_count;
+    size_t                  undo_capacity;
+    CompactorUndo           last;                                    /* Entry before the last filter call */
+    int                     last_event;                              /* Event it stored, -1 if none */
+    FILE                    *archive;                                /* Raw archive, NULL if none */
+    EventCompactorStats     stats;
+} EventCompactor;
+
+
+/**
+ * compactor_emit_t - Callback storing a reading chosen by the compactor.
+ *
+ * Return: 0 on success, non-zero on failure.
+ */
+typedef int (*compactor_emit_t)(const StoredReading *reading, void *ctx);
+
+
+/**
+ * event_compactor_default_config - Fill @config with the COMPACT_* defaults, disabled.
+ */
+void event_compactor_default_config(EventCompactorConfig *config);
+
+
+/**
+ * event_compactor_init - Create the per sensor state and open the raw archive.
+ *
+ * @compactor: Compactor to initialize.
+ * @config:    Tuning; copied, archive_path must stay valid.
+ *
+ * Return: 0 on success, -1 if the archive cannot be opened.
+ */
+int event_compactor_init(EventCompactor *compactor, const EventCompactorConfig *config);
+
+
+/**
+ * event_compactor_archive - Append a raw record to the archive, if any.
+ *
+ * @compactor: Compactor.
+ * @record:    Record as received, without its newline.
+ * @len:       Length of @record.
+ */
+void event_compactor_archive(EventCompactor *compactor, const char *record, size_t len);
+
+
+/**
+ * event_compactor_filter - Decide whether a reading is stored.
+ *
+ * A reading is stored when it is the sensor's first, moved more than
+ * move_threshold from the last stored position, or the last stored
+ * reading is keepalive_ms old. A new status is held as a candidate and
+ * stored (the candidate, with its own time) once hysteresis readings in a
+ * row carry it; a reading with the stored status first drops it as a
+ * flap. A held candidate is also stored by event_compactor_flush() after
+ * hold_ms without a contradicting reading. Disabled, every reading is
+ * stored.
+ *
+ * The sensor's state counts @out as stored at once; if storing it fails,
+ * call event_compactor_revert().
+ *
+ * @compactor: Compactor.
+ * @reading:   Reading accepted by the inserter.
+ * @out:       Receives the reading to store.
+ *
+ * Return: 1 if @out is to be stored, 0 if nothing is.
+ */
+int event_compactor_filter(EventCompactor *compactor, const StoredReading *reading, StoredReading *out);
+
+
+/**
+ * event_compactor_revert - Undo the last event_compactor_filter() call,
+ *                          whose reading could not be stored.
+ *
+ * @compactor: Compactor.
+ */
+void event_compactor_revert(EventCompactor *compactor);
+
+
+/**
+ * event_compactor_batch_done - The batch holding the stored readings is committed.
+ *
+ * @compactor: Compactor.
+ */
+void event_compactor_batch_done(EventCompactor *compactor);
+
+
+/**
+ * event_compactor_rollback - Forget what was stored since the last batch_done.
+ *
+ * Call after a rollback: each sensor is back to its last committed stored
+ * reading and held candidate, so the readings of the lost batch are judged
+ * alike when they are replayed from the dead-letter log.
+ *
+ * @compactor: Compactor.
+ */
+void event_compactor_rollback(EventCompactor *compactor);
+
+
+/**
+ * event_compactor_due - Whether a candidate has been held for hold_ms.
+ *
+ * Lets an idle loop skip event_compactor_flush(), and the transaction
+ * around it, while the held candidates are all undecided.
+ *
+ * @compactor: Compactor.
+ * @now_ms:    CLOCK_REALTIME in ms, the clock of recv_time.
+ */
+int event_compactor_due(const EventCompactor *compactor, int64_t now_ms);
+
+
+/**
+ * event_compactor_flush - Store the candidates held for hold_ms, flush the archive.
+ *
+ * Call inside the batch transaction, before the store is flushed. A
+ * candidate @emit fails to store stays held and is retried by the next
+ * flush; one stored by a batch that is rolled back is held again by
+ * event_compactor_rollback().
+ *
+ * @compactor: Compactor.
+ * @now_ms:    CLOCK_REALTIME in ms, the clock of recv_time.
+ * @emit:      Stores one reading.
+ * @ctx:       Passed to @emit.
+ *
+ * Return: number of readings emitted, or -1 if @emit failed.
+ */
+long event_compactor_flush(EventCompactor *compactor, int64_t now_ms, compactor_emit_t emit, void *ctx);
+
+
+/**
+ * event_compactor_free - Release the state and close the archive.
+ */
+void event_compactor_free(EventCompactor *compactor);
+
+
+#endif  /* EVENT_COMPACTOR_H */
@@ -1,23 +1,25 @@
 #ifndef GIIS_H
 #define GIIS_H
 
+#include "record_reader.h"                                           /* FIFO_PIPE_SIZE */
+#include "record_ring.h"
 #include <pthread.h>
+#include <stdio.h>
 
 /* Constants */
-#define BUFFER_SIZE 1024
-#define SHM_KEY 0x1234
 #define OUTPUT_FILE "giis/gdfs.data"
 #define FIFO_TO_DB "giis/ipc_to_db"                                  /* Added named pipe */
 
 
-/* Structure for shared memory */
-struct shared_data
+/* Records drained from the ring, written to FIFO_TO_DB together */
+typedef struct
 {
-    char data[BUFFER_SIZE];
-};
-
-/* External global variables */
-extern pthread_mutex_t shm_mutex;
+    FILE    *output_file;
+    int     fifo_fd;
+    size_t  len;                                                     /* Bytes batched */
+    size_t  records;                                                 /* Records batched */
+    char    buf[FIFO_PIPE_SIZE];
+} ForwardBatch;
 
 /* Function declarations */
 
@@ -25,10 +27,11 @@ extern pthread_mutex_t shm_mutex;
  * read_from_shared_memory - Thread function to read data from shared memory
  *                           and write it to an output file and a FIFO.
  *
- * This function attaches to the shared memory segment specified by SHM_KEY,
- * reads the data from it, and writes the data to an output file defined by OUTPUT_FILE
- * and a FIFO file defined by FIFO_TO_DB. The shared memory data is cleared after
- * being read to prevent duplicate processing.
+ * This function attaches to the record ring out_server queues records in,
+ * and on each wakeup writes every record queued to an output file defined
+ * by OUTPUT_FILE and to a FIFO file defined by FIFO_TO_DB as newline
+ * terminated records. A slot is handed back to out_server once its record
+ * is forwarded.
  *
  * @arg: Unused parameter, required for pthread_create compatibility.
  *
@@ -5,14 +5,55 @@
 #define DATA_FILE "giis/gdfs.data"                                   /* Path to the data file */
 #define DB_PATH "prksys_db.db"                                       /* Path to the SQLite database */
 #define FIFO_TO_DB "giis/ipc_to_db"                                  /* Named FIFO path */
+#define STORE_BACKEND "sqlite"                                       /* Default reading storage backend */
+
+/**
+ * open_database - Open the database and prepare the insert path
+ * @db_path: Path to the SQLite database
+ * @backend: Reading storage backend, STORE_BACKEND_SQLITE or STORE_BACKEND_TSDB
+ *
+ * This function opens the database with the embedded SQLite library, creates
+ * any missing tables, preloads the sensor id cache and opens the storage
+ * backend that process_line writes readings to. Sensors and sequence numbers
+ * stay in the database with either backend.
+ *
+ * Return: 0 on success, -1 on failure
+ */
+int open_database(const char *db_path, const char *backend);
+
+
+/**
+ * close_database - Release the prepared statements and the connection
+ *
+ * Return: void
+ */
+void close_database();
+
+
+/**
+ * print_counters - Print ingest and duplicate counters to stdout
+ *
+ * Reports the sensor cache hit rate, how many readings were accepted,
+ * carried no sequence number, or were dropped as duplicates or stale, and
+ * the dead-letter counters per reason and per source.
+ * Also triggered by sending SIGUSR1 to the process.
+ *
+ * Return: void
+ */
+void print_counters();
+
 
 /**
  * process_line - Process a single line of input data
  * @line: The line of input data to be processed
  *
- * This function parses a line of input data to extract the mac address,
- * status, and coordinates (x, y, z). It then constructs an SQLite command
- * to insert this data into the database and executes the command.
+ * This function parses a line of input data with parse_reading() to extract
+ * the mac address, status, and coordinates (x, y, z). The mac address is
+ * resolved to its Sensors id, readings whose sequence number was already
+ * stored are dropped, and the reading is appended to the storage backend
+ * together with its receive time (with compaction enabled, only when it
+ * changes the sensor's stored history, see event_compactor.h). Lines that cannot be parsed, resolved or
+ * stored go to the dead-letter log with their reason.
  *
  * Return: void
  */
@@ -32,11 +73,26 @@ void process_line(const char *line);
 void process_data_file();
 
 
+/**
+ * replay_dead_letters - Reprocess the records of a dead-letter log
+ * @path: Dead-letter log, usually DEAD_LETTER_PATH
+ *
+ * Every record is passed to process_line in one transaction. The log is
+ * renamed to "<path>.replay" first, so records that are rejected again end
+ * up in a fresh dead-letter log.
+ *
+ * Return: number of records replayed, or -1 on failure
+ */
+long replay_dead_letters(const char *path);
+
+
 /**
  * process_fifo - Process data from the FIFO
  *
  * This function opens the named FIFO for reading and continuously reads data
- * from it. Each line of data read is processed using the process_line function.
+ * from it in chunks of up to RECORD_READER_CAPACITY bytes. Every complete,
+ * newline terminated record in a chunk is processed using the process_line
+ * function; a partial record is kept until the rest of it arrives.
  * If the FIFO is closed (EOF is reached), it is reopened to wait for new data.
  *
  * Return: void
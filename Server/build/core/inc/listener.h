@@ -2,17 +2,11 @@
 #define LISTENER_H
 
 
-#define SHM_KEY                0x1234                                /* Key for shared memory segment */
-#define BUFFER_SIZE            1024                                  /* Buffer size for data */
-#define FIFO_NAME              "giis/ipc_transfer_giis"              /* Path to the FIFO file */
-/*#define FIFO_TO_DB           "giis/ipc_to_db" */                   /* (Optional) Path to another FIFO file */
+#include "record_ring.h"
 
 
-/* Shared memory structure */
-struct shared_data
-{
-    char data[BUFFER_SIZE];                                          /* Data buffer */
-};
+#define FIFO_NAME              "giis/ipc_transfer_giis"              /* Path to the FIFO file */
+/*#define FIFO_TO_DB           "giis/ipc_to_db" */                   /* (Optional) Path to another FIFO file */
 
 
 /**
@@ -0,0 +1,204 @@
+#ifndef LOAD_GEN_H
+#define LOAD_GEN_H
+
+#include "prk_metrics.h"
+#include "prk_trace.h"
+#include <stdint.h>
+#include <stdio.h>
+
+
+#define LOAD_GEN_HOST          "127.0.0.1"                           /* out_server, never another host */
+#define LOAD_GEN_PORT          12345                                 /* SERVER_PORT */
+#define LOAD_GEN_MAX_GATEWAYS  100000
+#define LOAD_GEN_MAX_THREADS   64
+#define LOAD_GEN_SOURCE_ADDRS  16                                    /* Sources 127.0.0.1-16: 16 x 28k ephemeral ports */
+#define LOAD_GEN_WINDOW        16                                    /* Records sent and not acknowledged, per gateway */
+#define LOAD_GEN_RECORD_MAX    (96 + 24 + PRK_TRACE_STAMP_MAX)       /* MAC, reading, sequence number, trace */
+#define LOAD_GEN_MAC_PREFIX    0x024c47000000ull                     /* 02:4c:47: locally administered, "LG" */
+#define LOAD_GEN_STAY_RECORDS  8                                     /* Records per status, 'S' then 'D' */
+#define LOAD_GEN_TICK_MS       1                                     /* Longest wait, and acknowledgement polling */
+#define LOAD_GEN_CONNECT_MS    3000                                  /* Connect attempt given up after */
+#define LOAD_GEN_RECONNECT_MIN_MS 100                                /* As tcp_client: first reconnect delay ... */
+#define LOAD_GEN_RECONNECT_MAX_MS 5000                               /* ... doubling up to this */
+#define LOAD_GEN_DRAIN_MS      2000                                  /* Wait for acknowledgements after the run */
+#define LOAD_GEN_SETTLE_MS     500                                   /* Then for out_server to read them */
+#define LOAD_GEN_EPOLL_EVENTS  256                                   /* Events taken per epoll_wait() */
+#define LOAD_GEN_SERVER_STAGE  "server"                              /* Metrics page of out_server ... */
+#define LOAD_GEN_SERVER_RECORDS "prk_server_records_total"           /* ... and its record counter */
+
+
+/* Run parameters, from the command line */
+typedef struct
+{
+    uint32_t  gateways;
+    uint32_t  threads;
+    double    rate;                                                  /* Records per second per gateway */
+    uint32_t  burst;                                                 /* Records sent back to back */
+    int       poisson;                                               /* Exponential gaps between bursts */
+    double    duration_s;
+    double    ramp_s;                                                /* Gateways start over this time */
+    uint16_t  port;
+    uint64_t  reconnect_every;                                       /* Records per connection, 0: never close */
+    int64_t   reconnect_delay_ms;                                    /* After closing a connection on purpose */
+    int64_t   max_delay_ms;                                          /* Older records are dropped unsent */
+    uint32_t  trace_every;                                           /* One traced record in so many, 0: none */
+    double    interval_s;                                            /* Progress lines, 0: none */
+} LoadGenConfig;
+
+
+/* Latency histograms, log-linear buckets of nanoseconds as prk_metrics.h */
+typedef enum
+{
+    LG_HIST_CONNECT = 0,                                             /* connect() to established */
+    LG_HIST_SEND,                                                    /* Due to written to the socket */
+    LG_HIST_ACK,                                                     /* Due to acknowledged by the server */
+    LG_HIST_COUNT
+} lg_hist_t;
+
+
+/* Counters of a worker, or their total */
+typedef enum
+{
+    LG_CONNECTS = 0,                                                 /* Connections made */
+    LG_CONNECT_FAILED,                                               /* Refused or failed */
+    LG_CONNECT_TIMEOUTS,                                             /* Not made within LOAD_GEN_CONNECT_MS */
+    LG_CONNECTIONS_LOST,                                             /* Reset or closed by the server */
+    LG_CONNECTIONS_CLOSED,                                           /* Closed after reconnect_every records */
+    LG_RECORDS_SENT,                                                 /* Written to a socket, replays included */
+    LG_RECORDS_REPLAYED,                                             /* Written again after a lost connection */
+    LG_RECORDS_ACKED,
+    LG_RECORDS_STALE,                                                /* Dropped unsent after max_delay_ms */
+    LG_RECORDS_UNSENT,                                               /* Due during the run, never written */
+    LG_RECORDS_UNACKED,                                              /* Written, not acknowledged at the end */
+    LG_RECORDS_TRACED,
+    LG_BYTES_SENT,
+    LG_COUNTER_COUNT
+} lg_counter_t;
+
+
+/*
+ * Statistics of one worker. Only the worker writes them, with relaxed
+ * stores as prk_metrics_add() does, so the progress lines can read them
+ * while it runs.
+ */
+typedef struct
+{
+    _Alignas(64) _Atomic uint64_t counters[LG_COUNTER_COUNT];
+    _Atomic uint64_t              connected;                         /* Gateways connected now */
+    _Atomic uint64_t              max_ns[LG_HIST_COUNT];
+    _Atomic uint64_t              buckets[LG_HIST_COUNT][PRK_HISTOGRAM_BUCKETS];
+} LoadGenStats;
+
+
+/* A record sent and not yet acknowledged */
+typedef struct
+{
+    int64_t   due_ns;                                                /* When the gateway had it to send */
+    uint64_t  seq;
+    uint32_t  end;                                                   /* Bytes sent on the connection once written */
+} LgSlot;
+
+
+typedef enum
+{
+    LG_WAITING = 0,                                                  /* Timer: (re)connect */
+    LG_CONNECTING,                                                   /* Timer: connect timeout */
+    LG_CONNECTED                                                     /* Timer: next record due */
+} lg_state_t;
+
+
+/*
+ * One simulated gateway. Records are numbered in the order they fall
+ * due: [acked, written) are on the wire unacknowledged, [written,
+ * generated) were sent on a lost connection and wait to be replayed.
+ * Their content follows from the gateway and the sequence number, so
+ * only their timing is kept.
+ */
+typedef struct
+{
+    int64_t   timer_ns;
+    int32_t   timer_pos;                                             /* In the worker's heap, -1: none */
+    int32_t   fd;                                                    /* -1 unless connecting or connected */
+    uint8_t   state;                                                 /* lg_state_t */
+    uint8_t   blocked;                                               /* Socket full, waiting for EPOLLOUT */
+    uint8_t   unacked;                                               /* In the worker's unacknowledged list */
+    uint8_t   backoff;                                               /* Failed attempts in a row */
+    uint8_t   replay;                                                /* The pending record was sent before */
+    uint16_t  pending_len;                                           /* Record being written ... */
+    uint16_t  pending_off;                                           /* ... and how much of it is */
+    uint32_t  index;                                                 /* Gateway number, gives the MAC */
+    uint32_t  burst_left;                                            /* Records left in the current burst */
+    uint64_t  seq_next;                                              /* Of the next new record */
+    uint64_t  generated;
+    uint64_t  written;
+    uint64_t  acked;
+    uint64_t  conn_bytes;                                            /* Sent on this connection */
+    uint64_t  conn_records;
+    int64_t   due_ns;                                                /* Next new record falls due */
+    int64_t   connect_ns;                                            /* connect() called */
+    LgSlot    window[LOAD_GEN_WINDOW];
+    char      pending[LOAD_GEN_RECORD_MAX];
+} LgGateway;
+
+
+/* A thread driving a share of the gateways with one epoll set */
+typedef struct
+{
+    const LoadGenConfig *config;
+    LgGateway           *gateways;
+    uint32_t            count;
+    int                 epoll_fd;
+    uint32_t            *heap;                                       /* Gateways by timer_ns */
+    uint32_t            heap_len;
+    uint32_t            *unacked;                                    /* Gateways with records unacknowledged */
+    uint32_t            unacked_len;
+    uint64_t            random;                                      /* xorshift64 state */
+    uint64_t            traced;                                      /* New records, for trace_every */
+    uint64_t            outstanding;                                 /* Records generated, not acknowledged */
+    int64_t             end_ns;                                      /* No new record due from then on */
+    LoadGenStats        stats;
+} LgWorker;
+
+
+/**
+ * lg_format_record - Write a record of a gateway as tcp_client sends it.
+ *
+ * "<mac>: <status>: x <x> y <y> z <z> seq <n>\n", with the MAC derived
+ * from @index under LOAD_GEN_MAC_PREFIX and the reading from @seq, so a
+ * record written again is the same record. A @trace is appended after the
+ * sequence number, stamped "tcp" now.
+ *
+ * @index: Gateway number.
+ * @seq:   Sequence number.
+ * @trace: Trace suffix, or NULL.
+ * @buf:   Destination, LOAD_GEN_RECORD_MAX bytes.
+ *
+ * Return: length of the record, newline included.
+ */
+int lg_format_record(uint32_t index, uint64_t seq, const PrkTrace *trace, char *buf);
+
+
+/**
+ * lg_run_worker - Drive the gateways of a worker until the run and the
+ *                 drain after it are over.
+ *
+ * @arg: The LgWorker.
+ *
+ * Return: NULL.
+ */
+void *lg_run_worker(void *arg);
+
+
+/**
+ * lg_report - Print totals, drops and latency quantiles of a run.
+ *
+ * @config:  Run parameters.
+ * @total:   Statistics summed over the workers.
+ * @elapsed: Seconds from the first gateway's start to the end of the run.
+ * @server:  Records out_server counted meanwhile, -1 without its page.
+ * @out:     Stream to write to.
+ */
+void lg_report(const LoadGenConfig *config, const LoadGenStats *total, double elapsed, int64_t server, FILE *out);
+
+
+#endif  /* LOAD_GEN_H */
@@ -0,0 +1,45 @@
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include <stdio.h>
+
+
+#define METRICS_PORT           9464                                  /* HTTP port of the scrape endpoint */
+#define METRICS_LISTEN_ADDR    "127.0.0.1"                           /* Bound address, --listen 0.0.0.0 for every interface */
+#define METRICS_PATH           "/metrics"                            /* The only path served */
+#define METRICS_SHM_DIR        "/dev/shm"                            /* Where the stage pages are listed */
+#define METRICS_MAX_STAGES     64                                    /* Pages exported per scrape */
+#define METRICS_REQUEST_MAX    4096                                  /* Longest request head read */
+#define METRICS_CLIENT_TIMEOUT_S 2                                   /* Drop a client not sending or reading this long */
+
+
+/**
+ * write_metrics - Write the metrics of every running stage in the
+ *                 Prometheus text exposition format.
+ *
+ * Maps every page PRK_METRICS_PREFIX "<stage>" listed in METRICS_SHM_DIR
+ * whose stage is still running, writes prk_stage_start_time_seconds for
+ * each, then their own metrics (see prk_metrics_write_text()), in stage
+ * name order.
+ *
+ * @out: Stream to write to.
+ *
+ * Return: number of stages written, or -1 on a write error.
+ */
+int write_metrics(FILE *out);
+
+
+/**
+ * serve_client - Answer one HTTP request on a connected socket.
+ *
+ * GET METRICS_PATH gets the output of write_metrics(), anything else 404.
+ * A client that stalls METRICS_CLIENT_TIMEOUT_S while sending its request
+ * or reading the response is dropped, so it cannot hold up the next one.
+ * The connection is closed after the response.
+ *
+ * @fd: Accepted connection, closed by the caller.
+ */
+void serve_client(int fd);
+
+
+#endif  /* METRICS_EXPORTER_H */
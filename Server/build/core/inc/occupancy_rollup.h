@@ -0,0 +1,235 @@
+#ifndef OCCUPANCY_ROLLUP_H
+#define OCCUPANCY_ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "zone_map.h"
+
+
+#define ROLLUP_FLUSH_MS        1000                                  /* Upsert the rollups at most this often */
+#define ROLLUP_GRACE_MS        (60 * 1000LL)                         /* Keep closed buckets this long for late readings */
+#define ROLLUP_PARKED_STATUS   'S'                                   /* Status of a parked (static) car */
+
+
+/* Rollup granularity, one table each */
+typedef enum
+{
+    ROLLUP_MINUTE = 0,                                               /* Rollup_Minute */
+    ROLLUP_HOUR,                                                     /* Rollup_Hour */
+    ROLLUP_DAY,                                                      /* Rollup_Day */
+    ROLLUP_LEVELS
+} rollup_level_t;
+
+
+/*
+ * One (zone, bucket) of one level. readings, parked_readings and
+ * parked_minutes count what happened since the last drain and are added to
+ * the stored row; sensors, parked_sensors and peak_parked are totals for
+ * the bucket and replace the stored value when larger.
+ */
+typedef struct
+{
+    int64_t   zone_id;                                               /* Zones.id */
+    int64_t   bucket_ms;                                             /* Bucket start, ms since the epoch */
+    uint64_t  readings;                                              /* Readings in the zone */
+    uint64_t  parked_readings;                                       /* Of which with ROLLUP_PARKED_STATUS */
+    uint64_t  parked_minutes;                                        /* Hour, day: sum of minute parked_sensors */
+    uint32_t  sensors;                                               /* Minute: distinct sensors */
+    uint32_t  parked_sensors;                                        /* Minute: distinct parked sensors (cars) */
+    uint32_t  peak_parked;                                           /* Hour, day: max of minute parked_sensors */
+    int       used;                                                  /* Slot holds a cell */
+    int       dirty;                                                 /* Changed since the last drain */
+    int       emitted;                                               /* Drained, the upsert not committed yet */
+} RollupCell;
+
+
+/* Open addressing table of the live cells of one level */
+typedef struct
+{
+    RollupCell  *cells;                                              /* capacity slots, power of two */
+    size_t      capacity;                                            /* Number of slots */
+    size_t      count;                                               /* Used slots */
+} RollupTable;
+
+
+/* Sensor already counted in a minute (distinct counts) */
+typedef struct
+{
+    int64_t   zone_id;                                               /* Zones.id */
+    int64_t   bucket_ms;                                             /* Minute start */
+    int64_t   sensor_id;                                             /* Sensors.id */
+    int       parked;                                                /* Counted as parked, else as seen */
+    int       used;                                                  /* Slot holds a member */
+} RollupMember;
+
+
+/* Set of the sensors counted in the live minutes */
+typedef struct
+{
+    RollupMember  *slots;                                            /* capacity slots, power of two */
+    size_t        capacity;                                          /* Number of slots */
+    size_t        count;                                             /* Used slots */
+} RollupMembers;
+
+
+/* In-memory rollup state, see occupancy_rollup_add() */
+typedef struct
+{
+    const ZoneMap   *zones;                                          /* Coordinates -> zone */
+    RollupTable     levels[ROLLUP_LEVELS];                           /* Live cells per level */
+    RollupMembers   members;                                         /* Distinct sensors per live minute */
+    int64_t         newest_ms;                                       /* Latest reading time seen */
+    uint64_t        pending;                                         /* Readings counted since the last drain */
+    uint64_t        unzoned;                                         /* Readings outside every zone */
+    int             drained;                                         /* A drain waits for batch_done/rollback */
+    int             drained_final;                                   /* That drain was a final one */
+} OccupancyRollup;
+
+
+/* Called by occupancy_rollup_drain() for every changed cell; returns 0 on success */
+typedef int (*rollup_emit_t)(rollup_level_t level, const RollupCell *cell, void *ctx);
+
+
+/* Prepared upserts into the rollup tables */
+typedef struct
+{
+    sqlite3_stmt  *upsert[ROLLUP_LEVELS];                            /* One per level */
+} RollupWriter;
+
+
+/**
+ * occupancy_rollup_init - Create an empty rollup.
+ *
+ * @rollup: Rollup to initialize.
+ * @zones:  Zone map, must outlive the rollup.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int occupancy_rollup_init(OccupancyRollup *rollup, const ZoneMap *zones);
+
+
+/**
+ * occupancy_rollup_add - Count one reading.
+ *
+ * The reading is counted in its zone's minute, hour and day. A sensor is
+ * counted once per minute in sensors, and once more in parked_sensors if
+ * any of its readings in that minute has ROLLUP_PARKED_STATUS; the hour and
+ * day accumulate those minute counts (car-minutes) and their peak.
+ *
+ * @rollup:    Rollup.
+ * @sensor_id: Sensors.id of the reading.
+ * @recv_time: Receive time in ms since the epoch.
+ * @x:         X coordinate * COORD_SCALE.
+ * @y:         Y coordinate * COORD_SCALE.
+ * @status:    Status character of the reading.
+ *
+ * Return: 0 on success, -1 on allocation failure.
+ */
+int occupancy_rollup_add(OccupancyRollup *rollup, int64_t sensor_id, int64_t recv_time, int32_t x, int32_t y,
+                         char status);
+
+
+/**
+ * occupancy_rollup_drain - Hand every changed cell to @emit.
+ *
+ * The cells keep their deltas until occupancy_rollup_batch_done() confirms
+ * that what @emit wrote was committed; occupancy_rollup_rollback() keeps
+ * them for the next drain instead. One of the two is called before more
+ * readings are counted.
+ *
+ * @rollup: Rollup.
+ * @final:  Evict every bucket at batch_done (shutdown, end of a rebuild range).
+ * @emit:   Receives each changed cell.
+ * @ctx:    Passed to @emit.
+ *
+ * Return: number of cells emitted, or -1 if @emit failed (the remaining
+ *         cells keep their deltas for the next drain).
+ */
+long occupancy_rollup_drain(OccupancyRollup *rollup, int final, rollup_emit_t emit, void *ctx);
+
+
+/**
+ * occupancy_rollup_batch_done - The cells of the last drain were written:
+ *                               reset their deltas and evict closed buckets.
+ *
+ * Buckets that ended more than ROLLUP_GRACE_MS before the newest reading
+ * are forgotten, together with their distinct sensor sets; after a final
+ * drain everything is. After a drain that failed, buckets are kept until
+ * the cells it did not reach are written too. Does nothing if no drain is
+ * waiting.
+ *
+ * @rollup: Rollup.
+ *
+ * Return: 0 on success, -1 on allocation failure.
+ */
+int occupancy_rollup_batch_done(OccupancyRollup *rollup);
+
+
+/**
+ * occupancy_rollup_rollback - The writes of the last drain were rolled
+ *                             back: the next drain emits the same deltas.
+ *
+ * @rollup: Rollup.
+ */
+void occupancy_rollup_rollback(OccupancyRollup *rollup);
+
+
+/**
+ * occupancy_rollup_free - Release the cells and sensor sets.
+ */
+void occupancy_rollup_free(OccupancyRollup *rollup);
+
+
+/**
+ * rollup_writer_init - Prepare the upserts into Rollup_Minute/Hour/Day.
+ *
+ * @writer: Writer to initialize.
+ * @db:     Open database at schema version 4 or later.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int rollup_writer_init(RollupWriter *writer, sqlite3 *db);
+
+
+/**
+ * rollup_writer_emit - rollup_emit_t that upserts a cell into its table.
+ *
+ * Counters are added to the stored row, distinct counts and peaks keep
+ * the larger value, so draining the same bucket several times (or from a
+ * restarted inserter) accumulates instead of overwriting.
+ *
+ * @level:  Table to write.
+ * @cell:   Cell to write.
+ * @writer: RollupWriter.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int rollup_writer_emit(rollup_level_t level, const RollupCell *cell, void *writer);
+
+
+/**
+ * rollup_writer_clear - Delete the rollup rows of buckets starting in [@from, @to).
+ *
+ * @writer: Writer.
+ * @from:   First bucket start, inclusive.
+ * @to:     Bucket start upper bound, exclusive.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int rollup_writer_clear(RollupWriter *writer, int64_t from, int64_t to);
+
+
+/**
+ * rollup_writer_free - Finalize the prepared upserts.
+ */
+void rollup_writer_free(RollupWriter *writer);
+
+
+/**
+ * rollup_level_ms - Bucket length of @level in ms.
+ */
+int64_t rollup_level_ms(rollup_level_t level);
+
+
+#endif  /* OCCUPANCY_ROLLUP_H */
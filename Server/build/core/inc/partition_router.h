@@ -0,0 +1,134 @@
+#ifndef PARTITION_ROUTER_H
+#define PARTITION_ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+
+#define PARTITION_MS           (24 * 60 * 60 * 1000LL)               /* One readings table per UTC day */
+#define PARTITION_PREFIX       "Customer_Data_p"                     /* Followed by the UTC date (and hour) */
+#define PARTITION_RETENTION_MS (30 * 24 * 60 * 60 * 1000LL)          /* Drop partitions older than this, 0 keeps all */
+
+
+/* One readings partition: a table holding recv_time in [start_ms, end_ms) */
+typedef struct
+{
+    char          name[64];                                          /* Table name */
+    int64_t       start_ms;                                          /* First receive time */
+    int64_t       end_ms;                                            /* Receive time upper bound, exclusive */
+    int           legacy;                                            /* Pre-partitioning data, never routed to */
+    sqlite3_stmt  *insert_stmt;                                      /* Prepared on first insert */
+    sqlite3_stmt  *query_stmt;                                       /* Prepared on first query */
+} Partition;
+
+
+/* Partitions of the readings table, sorted by start_ms */
+typedef struct
+{
+    sqlite3     *db;                                                 /* Database holding the partitions */
+    Partition   *parts;                                              /* Sorted by start_ms */
+    size_t      count;                                               /* Used entries of parts */
+    size_t      capacity;                                            /* Allocated entries of parts */
+    size_t      current;                                             /* Index of the last routed partition */
+    int64_t     retention_ms;                                        /* PARTITION_RETENTION_MS, 0 keeps all */
+    int         changed;                                             /* Partitions created or dropped since batch_done */
+} PartitionRouter;
+
+
+/**
+ * partition_router_init - Load the partition list from the Partitions table.
+ *
+ * @router: Router to initialize.
+ * @db:     Open database at schema version 3 or later.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int partition_router_init(PartitionRouter *router, sqlite3 *db);
+
+
+/**
+ * partition_router_route - Partition a reading received at @recv_time goes to.
+ *
+ * Consecutive readings usually hit the same partition, which is checked
+ * first. A missing partition is created (table, index, Partitions row and
+ * Customer_Data view) in the caller's transaction; partitions that fell out
+ * of the retention window are dropped at the same time. If that transaction
+ * rolls back, partition_router_rollback() brings the list back in line.
+ *
+ * @router:    Partition router.
+ * @recv_time: Receive time in ms since the epoch.
+ *
+ * Return: partition with a prepared insert statement, or NULL on failure.
+ */
+Partition *partition_router_route(PartitionRouter *router, int64_t recv_time);
+
+
+/**
+ * partition_router_find - Partitions overlapping [@from, @to).
+ *
+ * Partition pruning for range queries: only these partitions can hold
+ * matching readings.
+ *
+ * @router: Partition router.
+ * @from:   Range start, inclusive.
+ * @to:     Range end, exclusive.
+ * @first:  Receives the index of the first candidate in router->parts.
+ *
+ * Return: number of candidates from @first on that may overlap the range;
+ *         each still has to be checked with its own start_ms/end_ms.
+ */
+size_t partition_router_find(const PartitionRouter *router, int64_t from, int64_t to, size_t *first);
+
+
+/**
+ * partition_router_expire - Drop every partition that ends at or before @cutoff.
+ *
+ * A partition is dropped with one DROP TABLE: no per-row deletes, no index
+ * maintenance and no VACUUM; the freed pages are reused by new partitions.
+ *
+ * @router: Partition router.
+ * @cutoff: Receive time before which readings may be discarded.
+ *
+ * Return: number of partitions dropped, or -1 on failure.
+ */
+int partition_router_expire(PartitionRouter *router, int64_t cutoff);
+
+
+/**
+ * partition_router_batch_done - The caller's transaction committed: keep the
+ *                               partitions it created or dropped.
+ *
+ * @router: Partition router.
+ */
+void partition_router_batch_done(PartitionRouter *router);
+
+
+/**
+ * partition_router_rollback - The caller's transaction rolled back: reload
+ *                             the partition list if it changed.
+ *
+ * The partitions created since partition_router_batch_done() are gone
+ * again and the dropped ones are back; the list is read again from the
+ * Partitions table and every prepared statement is released.
+ *
+ * @router: Partition router.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int partition_router_rollback(PartitionRouter *router);
+
+
+/**
+ * partition_router_max_id - Highest reading id, from the newest non-empty partition.
+ */
+int64_t partition_router_max_id(PartitionRouter *router);
+
+
+/**
+ * partition_router_free - Finalize the partition statements and free the list.
+ */
+void partition_router_free(PartitionRouter *router);
+
+
+#endif  /* PARTITION_ROUTER_H */
@@ -0,0 +1,91 @@
+#ifndef POINT_IN_POLYGON_H
+#define POINT_IN_POLYGON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * One polygon edge, precomputed for the crossing number test: a point
+ * (px, py) crosses the edge when (y1 > py) != (y2 > py) and
+ * px < x1 + (py - y1) * slope. The edges of a polygon are stored one after
+ * the other, the last one closing the ring, so testing a polygon streams
+ * one contiguous array.
+ */
+typedef struct
+{
+    double    x1;                                                    /* First vertex, * COORD_SCALE */
+    double    y1;
+    double    y2;                                                    /* Second vertex y */
+    double    slope;                                                 /* (x2 - x1) / (y2 - y1), 0 if horizontal */
+} PolygonEdge;
+
+
+/* Point-in-polygon implementations, see pip_classify_with() */
+typedef enum
+{
+    PIP_SCALAR = 0,                                                  /* Portable C, one point at a time */
+    PIP_SSE2,                                                        /* Two points per instruction (x86) */
+    PIP_AVX2,                                                        /* Four points per instruction (x86 with AVX2) */
+    PIP_KERNELS
+} pip_kernel_t;
+
+
+/**
+ * pip_edge - Precompute the edge from (@x1, @y1) to (@x2, @y2).
+ */
+void pip_edge(PolygonEdge *edge, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+
+
+/**
+ * pip_contains - Whether (@x, @y) is inside the polygon (crossing number rule).
+ *
+ * @edges: The polygon's edges.
+ * @count: Number of edges.
+ * @x:     X coordinate * COORD_SCALE.
+ * @y:     Y coordinate * COORD_SCALE.
+ *
+ * Return: 1 inside, 0 outside.
+ */
+int pip_contains(const PolygonEdge *edges, size_t count, double x, double y);
+
+
+/**
+ * pip_classify - Test many points against one polygon with the best kernel.
+ *
+ * Every kernel evaluates the same expressions in the same order, so all
+ * return the same result as pip_contains() for every point.
+ *
+ * @edges:  The polygon's edges.
+ * @count:  Number of edges.
+ * @x:      @points X coordinates * COORD_SCALE.
+ * @y:      @points Y coordinates * COORD_SCALE.
+ * @points: Number of points.
+ * @inside: Receives 1 or 0 per point.
+ */
+void pip_classify(const PolygonEdge *edges, size_t count, const double *x, const double *y, size_t points,
+                  uint8_t *inside);
+
+
+/**
+ * pip_classify_with - pip_classify() with a given kernel (benchmarks).
+ *
+ * @kernel: Kernel to use; one the CPU lacks falls back to the best one it has.
+ */
+void pip_classify_with(pip_kernel_t kernel, const PolygonEdge *edges, size_t count, const double *x,
+                       const double *y, size_t points, uint8_t *inside);
+
+
+/**
+ * pip_best_kernel - Fastest kernel this CPU supports.
+ */
+pip_kernel_t pip_best_kernel(void);
+
+
+/**
+ * pip_kernel_name - "scalar", "sse2" or "avx2".
+ */
+const char *pip_kernel_name(pip_kernel_t kernel);
+
+
+#endif  /* POINT_IN_POLYGON_H */
@@ -0,0 +1,120 @@
+#ifndef PRICE_HISTORY_H
+#define PRICE_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "string_arena.h"
+
+
+#define PRICE_HISTORY_OPEN     INT64_MAX                             /* valid_to of a current price */
+
+
+/* One price of a location and the time it applied in */
+typedef struct
+{
+    int64_t   valid_from;                                            /* CLOCK_REALTIME in ms */
+    int64_t   valid_to;                                              /* Exclusive, PRICE_HISTORY_OPEN if current */
+    double    price;
+} PriceInterval;
+
+
+/* Intervals of one location: intervals[first .. first + count) */
+typedef struct
+{
+    const char  *location;
+    int64_t     zone_id;                                             /* Zones.id of that name, 0 if none */
+    size_t      first;
+    size_t      count;
+} PriceHistoryLocation;
+
+
+/* Zone index entry, as in the shared price table */
+typedef struct
+{
+    int64_t   zone_id;
+    size_t    location;                                              /* Index in PriceHistory.locations */
+} PriceHistoryZone;
+
+
+/* One point-in-time lookup of a batch */
+typedef struct
+{
+    int64_t   zone_id;
+    int64_t   at_ms;
+} PriceHistoryQuery;
+
+
+/*
+ * Interval index of Price_History. Locations are sorted by name, the
+ * intervals of each by valid_from and disjoint, so a lookup is two binary
+ * searches: O(log n) in the number of locations and intervals.
+ */
+typedef struct
+{
+    PriceHistoryLocation    *locations;
+    size_t                  location_count;
+    PriceInterval           *intervals;
+    size_t                  interval_count;
+    PriceHistoryZone        *by_zone;                                /* Located zones, in zone id order */
+    size_t                  zone_count;
+    int64_t                 latest_ms;                               /* Newest valid_from or valid_to loaded */
+    StringArena             names;
+} PriceHistory;
+
+
+/**
+ * price_history_load - Load Price_History into an interval index.
+ *
+ * @db:      Open database at schema version 9 or later.
+ * @history: Receives the index, released with price_history_free().
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int price_history_load(sqlite3 *db, PriceHistory *history);
+
+
+/**
+ * price_history_find - Price of @location at @at_ms.
+ *
+ * Return: the interval holding @at_ms, or NULL when the location had no
+ * price then.
+ */
+const PriceInterval *price_history_find(const PriceHistory *history, const char *location, int64_t at_ms);
+
+
+/**
+ * price_history_find_zone - Price of the zone @zone_id at @at_ms.
+ *
+ * Return: the interval holding @at_ms, or NULL.
+ */
+const PriceInterval *price_history_find_zone(const PriceHistory *history, int64_t zone_id, int64_t at_ms);
+
+
+/**
+ * price_history_find_batch - Answer many point-in-time lookups at once.
+ *
+ * A query for the same zone as the one before it, at the same time or
+ * later, steps forward from the previous answer instead of searching
+ * again, so a run of queries sorted by zone and time costs about one
+ * search per zone plus one step per query; any other query costs what
+ * price_history_find_zone() does.
+ *
+ * @history: Index.
+ * @queries: Lookups, best grouped by zone in time order.
+ * @count:   Number of lookups.
+ * @results: Receives, for each query, its interval or NULL.
+ *
+ * Return: 0.
+ */
+int price_history_find_batch(const PriceHistory *history, const PriceHistoryQuery *queries, size_t count,
+                             const PriceInterval **results);
+
+
+/**
+ * price_history_free - Release the index.
+ */
+void price_history_free(PriceHistory *history);
+
+
+#endif  /* PRICE_HISTORY_H */
@@ -0,0 +1,49 @@
+#ifndef PRICE_IMPORT_H
+#define PRICE_IMPORT_H
+
+#include <stddef.h>
+#include "price_sync.h"
+
+
+#define PRICE_IMPORT_CHUNK     (1 << 20)                             /* Least bytes of the file per parsing thread */
+#define PRICE_IMPORT_MAX_THREADS 16                                  /* Most parsing threads */
+#define PRICE_IMPORT_REPORTED  10                                    /* Invalid lines printed per import */
+
+
+/* What an import read */
+typedef struct
+{
+    size_t    lines;                                                 /* Lines of the file, blank ones included */
+    size_t    invalid;                                               /* Lines rejected */
+    size_t    duplicates;                                            /* Entries overridden by a later line */
+    int       threads;                                               /* Parsing threads used */
+} PriceImportStats;
+
+
+/**
+ * price_import_file - Load a price file into a sorted, deduplicated list.
+ *
+ * The file is mapped and split at line boundaries into one chunk per
+ * thread. Each thread parses and validates its lines, copies the names
+ * into its own string arena and sorts its entries; the sorted runs are
+ * then merged pairwise in parallel. When a location is listed twice its
+ * last line wins.
+ *
+ * Lines are "<location>, <price>". Blank lines and lines starting with
+ * '#' are skipped. The location is trimmed, must not be empty and must be
+ * shorter than MAX_LINE_LENGTH; the price must be a finite number, zero or
+ * more, followed by blanks only. Any other line makes the whole file
+ * invalid: the first PRICE_IMPORT_REPORTED are reported with their line
+ * number and nothing is returned, so a damaged file never removes prices.
+ *
+ * @path:    Price file.
+ * @threads: Parsing threads, 0 for one per CPU; fewer are used for small files.
+ * @list:    Receives the entries in location order, released with price_list_free().
+ * @stats:   Receives the counters, also filled on an invalid file. May be NULL.
+ *
+ * Return: 0 on success, -1 on an invalid file or failure.
+ */
+int price_import_file(const char *path, int threads, PriceList *list, PriceImportStats *stats);
+
+
+#endif  /* PRICE_IMPORT_H */
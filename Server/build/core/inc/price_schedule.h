@@ -0,0 +1,148 @@
+#ifndef PRICE_SCHEDULE_H
+#define PRICE_SCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "price_sync.h"
+
+
+#define SCHEDULE_FILE          "schedules.txt"                       /* Default schedule file of out_update_prices */
+#define SCHEDULE_SLOT_MINUTES  15                                    /* Rule times are multiples of this */
+#define SCHEDULE_SLOTS         (7 * 24 * 60 / SCHEDULE_SLOT_MINUTES) /* Slots of one week, from Monday 00:00 */
+#define SCHEDULE_MAX_TIERS     8                                     /* Duration tiers per location */
+#define SCHEDULE_ALL_DAYS      0x7f                                  /* Bit 0 Monday .. bit 6 Sunday */
+#define PRICE_UNIT_MS          (60 * 60 * 1000)                      /* Prices and rates are per hour parked */
+
+
+/* Rate of a location in a window of the week ("Zone A, Mon-Fri, 08:00-18:00, 6.50") */
+typedef struct
+{
+    char      location[MAX_LINE_LENGTH];
+    uint8_t   days;                                                  /* Days the window starts on */
+    uint16_t  start_min;                                             /* Minute of the day, local time */
+    uint16_t  end_min;                                               /* Exclusive; <= start_min runs overnight */
+    int16_t   utc_offset_min;                                        /* Local time minus UTC */
+    double    price;                                                 /* Per hour within the window */
+} ScheduleRule;
+
+
+/* Rate factor of a location past a parking duration ("Zone A, after 2:00, x1.5") */
+typedef struct
+{
+    char      location[MAX_LINE_LENGTH];
+    uint32_t  after_min;
+    double    factor;
+} ScheduleTier;
+
+
+/* Rules and tiers of a schedule file or of the database */
+typedef struct
+{
+    ScheduleRule    *rules;
+    size_t          rule_count;
+    ScheduleTier    *tiers;
+    size_t          tier_count;
+} ScheduleSet;
+
+
+/* One compiled duration tier */
+typedef struct
+{
+    int64_t   after_ms;
+    double    factor;
+} PriceTier;
+
+
+/*
+ * Compiled schedule of one location. prefix[i] is the cost of parking from
+ * Monday 00:00 local time to the start of slot i, so the cost between any
+ * two instants is a difference of two interpolated prefix sums, whatever
+ * the number of rules. Fixed size, so it can be shared as is.
+ */
+typedef struct
+{
+    int64_t   utc_offset_ms;                                         /* Local time minus UTC */
+    uint32_t  tier_count;
+    uint32_t  reserved;
+    PriceTier tiers[SCHEDULE_MAX_TIERS];                             /* In after_ms order */
+    double    prefix[SCHEDULE_SLOTS + 1];
+} PriceSchedule;
+
+
+/**
+ * price_schedule_parse - Read a schedule file.
+ *
+ * Lines, '#' starting a comment:
+ *   utc_offset <+|->HH:MM                           applies to the rules after it (default +00:00)
+ *   <location>, <days>, <HH:MM>-<HH:MM>, <price>    rate per hour in that window
+ *   <location>, after <H:MM>, x<factor>             rate factor past that parking time
+ * <days> is "*" or days and ranges joined by '+', e.g. "Mon-Fri" or
+ * "Sat+Sun". Times and offsets are multiples of SCHEDULE_SLOT_MINUTES;
+ * "24:00" ends a day. Where windows overlap the later rule wins; outside
+ * every window the location's flat price applies.
+ *
+ * @path: Schedule file.
+ * @set:  Receives the rules and tiers, released with price_schedule_set_free().
+ *
+ * Return: 0 on success, 1 if @path does not exist (@set empty, not
+ * reported), -1 on an invalid line (reported) or failure.
+ */
+int price_schedule_parse(const char *path, ScheduleSet *set);
+
+
+/**
+ * price_schedule_store - Replace Price_Schedules and Price_Tiers with @set.
+ *
+ * @db:  Open database at schema version 8 or later, outside a transaction.
+ * @set: Rules and tiers, in file order.
+ *
+ * Return: 0 on success, -1 on failure (nothing changed).
+ */
+int price_schedule_store(sqlite3 *db, const ScheduleSet *set);
+
+
+/**
+ * price_schedule_load - Load Price_Schedules and Price_Tiers.
+ *
+ * Rules come in location then file order, tiers in location order.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int price_schedule_load(sqlite3 *db, ScheduleSet *set);
+
+
+/**
+ * price_schedule_compile - Compile the rules and tiers of one location.
+ *
+ * @schedule:   Receives the compiled schedule.
+ * @base_price: Flat price of the location, the rate outside every window.
+ * @rules:      Rules of the location, later ones winning, each in its own utc_offset_min.
+ * @rule_count: Number of rules.
+ * @tiers:      Tiers of the location; past SCHEDULE_MAX_TIERS are ignored.
+ * @tier_count: Number of tiers.
+ */
+void price_schedule_compile(PriceSchedule *schedule, double base_price, const ScheduleRule *rules,
+                            size_t rule_count, const ScheduleTier *tiers, size_t tier_count);
+
+
+/**
+ * price_schedule_cost - Cost of parking from @start_ms to @end_ms.
+ *
+ * Two prefix sum lookups per tier boundary crossed, independent of the
+ * number of rules and of the session length.
+ *
+ * @schedule: Compiled schedule.
+ * @start_ms: CLOCK_REALTIME in ms.
+ * @end_ms:   CLOCK_REALTIME in ms, not before @start_ms.
+ */
+double price_schedule_cost(const PriceSchedule *schedule, int64_t start_ms, int64_t end_ms);
+
+
+/**
+ * price_schedule_set_free - Release the arrays of a set.
+ */
+void price_schedule_set_free(ScheduleSet *set);
+
+
+#endif  /* PRICE_SCHEDULE_H */
@@ -0,0 +1,110 @@
+#ifndef PRICE_SYNC_H
+#define PRICE_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "string_arena.h"
+
+
+#define MAX_LINE_LENGTH        100                                   /* Longest location name, plus its NUL */
+
+
+/* Structure to hold city name and price */
+typedef struct
+{
+    const char  *city;                                               /* city, in its PriceList's names */
+    double      price;                                               /* price */
+} CityPrice;
+
+
+/* Prices in location order, each location once, owning their names */
+typedef struct
+{
+    CityPrice   *entries;
+    size_t      count;
+    StringArena names;
+} PriceList;
+
+
+/*
+ * Changes turning the Prices table into the price file. The entries point
+ * into the lists the diff was computed from.
+ */
+typedef struct
+{
+    const CityPrice **inserts;                                       /* In the file only */
+    size_t          insert_count;
+    const CityPrice **updates;                                       /* In both, with another price */
+    size_t          update_count;
+    const CityPrice **deletes;                                       /* In the table only */
+    size_t          delete_count;
+    size_t          unchanged;                                       /* In both with the same price */
+} PriceDiff;
+
+
+/**
+ * load_price_table - Load every row of the Prices table, in location order.
+ *
+ * The order comes from the unique index on Prices.location.
+ *
+ * @db:   Open database.
+ * @list: Receives the rows, released with price_list_free().
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int load_price_table(sqlite3 *db, PriceList *list);
+
+
+/**
+ * diff_prices - Compute the changes from the table's prices to the file's.
+ *
+ * Both lists are in location order (strcmp(), the order of SQLite's
+ * BINARY collation), so one merge pass over them costs O(n + m).
+ *
+ * @table: Rows of the Prices table, from load_price_table().
+ * @file:  Entries of the price file, from price_import_file().
+ * @diff:  Receives the changes, released with price_diff_free().
+ *
+ * Return: 0 on success, -1 on allocation failure.
+ */
+int diff_prices(const PriceList *table, const PriceList *file, PriceDiff *diff);
+
+
+/**
+ * apply_price_diff - Apply the changes in one transaction.
+ *
+ * Besides Prices, every change closes the location's current interval in
+ * Price_History at @now_ms and, unless the location is removed, opens the
+ * next one there. Any failure rolls the whole diff back.
+ *
+ * @db:     Open database at schema version 9 or later, outside a transaction.
+ * @diff:   Changes from diff_prices().
+ * @now_ms: CLOCK_REALTIME in ms at which the changes take effect.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int apply_price_diff(sqlite3 *db, const PriceDiff *diff, int64_t now_ms);
+
+
+/**
+ * price_hash_city - FNV-1a hash of a location.
+ *
+ * Hash of the shared price table's location index (price_table.h).
+ */
+uint64_t price_hash_city(const char *city);
+
+
+/**
+ * price_list_free - Release the entries and names of a list.
+ */
+void price_list_free(PriceList *list);
+
+
+/**
+ * price_diff_free - Release the arrays of a diff.
+ */
+void price_diff_free(PriceDiff *diff);
+
+
+#endif  /* PRICE_SYNC_H */
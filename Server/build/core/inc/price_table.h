@@ -0,0 +1,204 @@
+#ifndef PRICE_TABLE_H
+#define PRICE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sqlite3.h>
+#include "price_sync.h"
+#include "price_schedule.h"
+
+
+#define PRICE_TABLE_NAME       "/prk_prices"                         /* POSIX shm object holding the generation */
+#define PRICE_TABLE_MAGIC      0x50524b50u                           /* "PRKP" */
+#define PRICE_TABLE_FORMAT     3                                     /* Layout of PriceTable and its arrays */
+#define PRICE_TABLE_NAME_MAX   64                                    /* Longest snapshot object name */
+
+
+/*
+ * Control object: the generation of the current snapshot. Publishers
+ * serialize on an flock() of it; readers only load the generation.
+ */
+typedef struct
+{
+    uint32_t            magic;                                       /* PRICE_TABLE_MAGIC once initialized */
+    uint32_t            reserved;
+    _Atomic uint64_t    generation;                                  /* Current snapshot, 0 before the first */
+} PriceTableControl;
+
+
+/* Price of one location, with the zone of the same name */
+typedef struct
+{
+    char      location[MAX_LINE_LENGTH];                             /* Prices.location */
+    uint32_t  schedule;                                              /* Compiled schedule + 1, 0 for the flat price */
+    int64_t   zone_id;                                               /* Zones.id of that name, 0 if none */
+    double    price;                                                 /* Prices.price */
+    int64_t   valid_from;                                            /* Prices.valid_from, when price took effect */
+} PriceTableEntry;
+
+
+/* Zone index entry; the key is kept here so a search stays in this array */
+typedef struct
+{
+    int64_t   zone_id;
+    uint64_t  index;                                                 /* Entry of the zone */
+} PriceTableZone;
+
+
+/*
+ * Snapshot, the shm object "<name>.<generation>". Written once before it
+ * is published and never modified afterwards. The header is followed by
+ *   PriceTableEntry entries[count];
+ *   PriceSchedule   schedules[schedule_count];
+ *   PriceTableZone  by_zone[zone_count];   the zoned entries, in zone id order
+ *   uint32_t        slots[slot_count];     entry index + 1 by location hash, 0 free
+ */
+typedef struct
+{
+    uint32_t  magic;                                                 /* PRICE_TABLE_MAGIC */
+    uint32_t  format;                                                /* PRICE_TABLE_FORMAT of the publisher */
+    uint64_t  generation;                                            /* 0 for a private table */
+    uint64_t  count;                                                 /* Entries */
+    uint64_t  schedule_count;                                        /* Compiled schedules */
+    uint64_t  slot_count;                                            /* Power of two, at least 2 * count */
+    uint64_t  zone_count;                                            /* Entries with a zone */
+    int64_t   published_ms;                                          /* CLOCK_REALTIME of the publication */
+} PriceTable;
+
+
+/* What a table is built from */
+typedef struct
+{
+    PriceTableEntry *entries;
+    size_t          count;
+    PriceSchedule   *schedules;                                      /* Referenced by PriceTableEntry.schedule */
+    size_t          schedule_count;
+} PriceTableSource;
+
+
+/* One process's read-only view of the table */
+typedef struct
+{
+    char                    name[PRICE_TABLE_NAME_MAX];              /* Control object */
+    const PriceTableControl *control;                                /* NULL until attached */
+    const PriceTable        *table;                                  /* Mapped snapshot, NULL if none yet */
+    size_t                  table_size;                              /* Bytes mapped at table */
+    uint64_t                generation;                              /* Generation of table */
+    uint64_t                reloads;                                 /* Snapshots mapped so far */
+} PriceTableReader;
+
+
+/**
+ * price_table_load - Load every price with its zone and compiled schedule.
+ *
+ * The zone is the one named like the location; the schedule is compiled
+ * from the location's Price_Schedules and Price_Tiers rows, if any.
+ *
+ * @db:     Open database at schema version 9 or later.
+ * @source: Receives the entries, released with price_table_source_free().
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int price_table_load(sqlite3 *db, PriceTableSource *source);
+
+
+/**
+ * price_table_source_free - Release the arrays of a source.
+ */
+void price_table_source_free(PriceTableSource *source);
+
+
+/**
+ * price_table_publish - Publish @entries as the next generation.
+ *
+ * The snapshot is written to a new shm object, then made current by a
+ * release store of its generation in the control object; the previous
+ * snapshot is unlinked and lives on until its last reader moves on.
+ * Concurrent publishers wait for each other. Readers are never blocked.
+ *
+ * @name:   Control object, usually PRICE_TABLE_NAME.
+ * @source: Prices to publish; a location listed twice keeps its first entry.
+ *
+ * Return: the published generation, 0 on failure.
+ */
+uint64_t price_table_publish(const char *name, const PriceTableSource *source);
+
+
+/**
+ * price_table_build - Build a private table holding @source.
+ *
+ * Same layout and lookups as a published snapshot, in this process's
+ * memory; for readers that fall back to the database.
+ *
+ * Return: the table, released with free(), or NULL on failure.
+ */
+PriceTable *price_table_build(const PriceTableSource *source);
+
+
+/**
+ * price_table_remove - Unlink the control object and the current snapshot.
+ *
+ * Attached readers keep their mappings.
+ */
+void price_table_remove(const char *name);
+
+
+/**
+ * price_table_attach - Map the control object read-only.
+ *
+ * @reader: Reader to initialize.
+ * @name:   Control object, usually PRICE_TABLE_NAME.
+ *
+ * Return: 0 on success, -1 when nothing was published under @name yet.
+ */
+int price_table_attach(PriceTableReader *reader, const char *name);
+
+
+/**
+ * price_table_current - Current snapshot, mapping a newer one if published.
+ *
+ * Costs one atomic load when the generation did not change. The previous
+ * snapshot is unmapped when a newer one is mapped, so pointers into it are
+ * valid until the next call.
+ *
+ * @reader: Attached reader.
+ *
+ * Return: the snapshot, or NULL when none could be mapped.
+ */
+const PriceTable *price_table_current(PriceTableReader *reader);
+
+
+/**
+ * price_table_find - Entry of @location, or NULL.
+ */
+const PriceTableEntry *price_table_find(const PriceTable *table, const char *location);
+
+
+/**
+ * price_table_find_zone - Entry of the zone @zone_id, or NULL.
+ */
+const PriceTableEntry *price_table_find_zone(const PriceTable *table, int64_t zone_id);
+
+
+/**
+ * price_table_cost - Cost of parking at @entry from @start_ms to @end_ms.
+ *
+ * The flat price prorated per PRICE_UNIT_MS, or the entry's compiled
+ * schedule (see price_schedule_cost()).
+ *
+ * @table:    Table holding @entry.
+ * @entry:    Entry from price_table_find() or price_table_find_zone().
+ * @start_ms: CLOCK_REALTIME in ms.
+ * @end_ms:   CLOCK_REALTIME in ms, not before @start_ms.
+ */
+double price_table_cost(const PriceTable *table, const PriceTableEntry *entry, int64_t start_ms, int64_t end_ms);
+
+
+/**
+ * price_table_detach - Unmap everything the reader mapped.
+ */
+void price_table_detach(PriceTableReader *reader);
+
+
+#endif  /* PRICE_TABLE_H */
@@ -0,0 +1,153 @@
+#ifndef PRK_DB_H
+#define PRK_DB_H
+
+#include <stdint.h>
+#include <sqlite3.h>
+
+
+#define DB_BUSY_TIMEOUT_MS     5000                                  /* Wait this long for a locked database */
+#define PRK_DB_SCHEMA_VERSION  9                                     /* PRAGMA user_version of the current schema */
+#define PRK_DB_MIGRATE_CHUNK   10000                                 /* Rows copied per transaction when migrating */
+#define PRK_DB_MIGRATE_PAUSE_US 20000                                /* Pause between chunks so writers get the lock */
+#define PARTITION_LEGACY_NAME  "Customer_Data_legacy"                /* Readings received before partitioning */
+
+
+/**
+ * prk_db_open - Open (or create) the parking system database.
+ *
+ * Opens @db_path with the embedded SQLite library, enables WAL journaling so
+ * readers do not block the inserter, sets a busy timeout and turns on
+ * foreign key enforcement.
+ *
+ * @db_path: Path to the SQLite database.
+ *
+ * Return: database handle, or NULL on failure (an error is printed).
+ */
+sqlite3 *prk_db_open(const char *db_path);
+
+
+/**
+ * prk_db_close - Close a handle returned by prk_db_open().
+ *
+ * @db: Database handle, may be NULL.
+ */
+void prk_db_close(sqlite3 *db);
+
+
+/**
+ * prk_db_exec - Execute one or more SQL statements without results.
+ *
+ * @db:  Database handle.
+ * @sql: SQL text.
+ *
+ * Return: 0 on success, -1 on failure (an error is printed).
+ */
+int prk_db_exec(sqlite3 *db, const char *sql);
+
+
+/**
+ * prk_db_prepare - Compile a statement for repeated use.
+ *
+ * @db:  Database handle.
+ * @sql: SQL text of a single statement.
+ *
+ * Return: prepared statement, or NULL on failure (an error is printed).
+ */
+sqlite3_stmt *prk_db_prepare(sqlite3 *db, const char *sql);
+
+
+/**
+ * prk_db_create_schema - Create the schema, or bring it to the current version.
+ *
+ * Tables:
+ * - Prices:        parking price per location, unique on location.
+ * - Sensors:       one row per sensor, MAC address interned to an integer id.
+ * - Customer_Data: view over the readings partitions (UNION ALL).
+ * - Partitions:    name and [start_ms, end_ms) receive time range of every
+ *                  readings partition. Each partition is a WITHOUT ROWID
+ *                  table clustered on (sensor_id, recv_time, id) with an
+ *                  index on (recv_time, status) covering time window
+ *                  occupancy; see partition_router.h.
+ * - Sensor_Seq:    highest sequence number stored per sensor, and which
+ *                  of the 64 below it were (see dedup_window.h).
+ * - Zones:         parking zones as rectangles, named like Prices.location.
+ * - Rollup_Minute, Rollup_Hour, Rollup_Day: occupancy per zone and period,
+ *                  maintained by the inserter; see occupancy_rollup.h.
+ * - Sensor_State:  latest status and position of every sensor; see
+ *                  sensor_state.h.
+ *
+ * Same as prk_db_migrate(db, 0).
+ *
+ * @db: Database handle.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int prk_db_create_schema(sqlite3 *db);
+
+
+/**
+ * prk_db_migrate - Apply every migration above the recorded schema version.
+ *
+ * The version is kept in PRAGMA user_version. Each migration commits the new
+ * version together with its last change, so an interrupted run is resumed
+ * from the last completed step. Migrations run online: table rebuilds copy
+ * rows in short transactions while other connections keep writing. Each
+ * step reads the version again in its write transaction, so programs that
+ * open a database at the same time apply every step once. A database of
+ * the original MAC address schema (version 0) is migrated too.
+ *
+ * @db:      Database handle.
+ * @verbose: Print one line per migration applied.
+ *
+ * Return: 0 on success, -1 on failure or if the database is newer than
+ *         PRK_DB_SCHEMA_VERSION.
+ */
+int prk_db_migrate(sqlite3 *db, int verbose);
+
+
+/**
+ * prk_db_schema_version - Schema version recorded in the database.
+ *
+ * Return: version (0 for a database never migrated), -1 on error.
+ */
+int prk_db_schema_version(sqlite3 *db);
+
+
+/**
+ * prk_db_migration_description - What migrating to @version changes.
+ *
+ * Return: description, or NULL if there is no such migration.
+ */
+const char *prk_db_migration_description(int version);
+
+
+/**
+ * prk_db_create_partition - Create a readings partition and register it.
+ *
+ * Does not touch the Customer_Data view; call prk_db_rebuild_readings_view()
+ * in the same transaction.
+ *
+ * @db:       Database handle.
+ * @name:     Table name.
+ * @start_ms: First receive time the partition holds.
+ * @end_ms:   Receive time upper bound, exclusive.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int prk_db_create_partition(sqlite3 *db, const char *name, int64_t start_ms, int64_t end_ms);
+
+
+/**
+ * prk_db_rebuild_readings_view - Recreate Customer_Data over the partitions.
+ *
+ * Recreates the Customer_Data view as a UNION ALL of the partitions listed
+ * in Partitions, and Customer_Readings on top of it.
+ *
+ * @db: Database handle.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int prk_db_rebuild_readings_view(sqlite3 *db);
+
+
+#endif  /* PRK_DB_H */
@@ -0,0 +1,329 @@
+#ifndef PRK_METRICS_H
+#define PRK_METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <time.h>
+
+
+#define PRK_METRICS_PREFIX     "/prk_metrics."                       /* POSIX shm object of a stage: prefix + stage */
+#define PRK_METRICS_MAGIC      0x50524b4du                           /* "PRKM" */
+#define PRK_METRICS_FORMAT     1                                     /* Layout of PrkMetricsPage */
+#define PRK_METRICS_MAX        64                                    /* Metrics per stage */
+#define PRK_METRICS_SHARDS     16                                    /* Value blocks, one per thread, the last shared */
+#define PRK_METRICS_SLOTS      4096                                  /* Values per shard */
+#define PRK_METRICS_STAGE_LEN  32                                    /* Longest stage name */
+#define PRK_METRICS_NAME_LEN   96                                    /* Longest metric name, labels included */
+#define PRK_METRICS_HELP_LEN   128                                   /* Longest help text */
+
+#define PRK_HISTOGRAM_SUB_BITS 2                                     /* Linear sub-buckets per power of two: 4 */
+#define PRK_HISTOGRAM_SUB      (1u << PRK_HISTOGRAM_SUB_BITS)
+#define PRK_HISTOGRAM_BUCKETS  160                                   /* Up to 2^41, beyond that the last bucket */
+#define PRK_HISTOGRAM_SLOTS    (PRK_HISTOGRAM_BUCKETS + 1)           /* Buckets, then the sum of the values */
+
+#define PRK_SCALE_NS           1e9                                   /* Histogram of nanoseconds, exported in seconds */
+#define PRK_SCALE_NONE         1.0                                   /* Histogram of plain numbers */
+
+
+typedef enum
+{
+    PRK_METRIC_COUNTER = 1,                                          /* Sum of the shards, only grows */
+    PRK_METRIC_GAUGE,                                                /* One value, set or moved by any thread */
+    PRK_METRIC_HISTOGRAM                                             /* Log-linear buckets and a sum, per shard */
+} prk_metric_type_t;
+
+
+/* Description of a metric, written once when it is registered */
+typedef struct
+{
+    char      name[PRK_METRICS_NAME_LEN];                            /* Prometheus name, may end in {labels} */
+    char      help[PRK_METRICS_HELP_LEN];
+    uint32_t  type;                                                  /* prk_metric_type_t */
+    uint32_t  slot;                                                  /* First value in each shard, or gauge index */
+    double    scale;                                                 /* Histograms: recorded units per exported unit */
+} PrkMetricDesc;
+
+
+/*
+ * Metrics of one stage, the shm object PRK_METRICS_PREFIX "<stage>".
+ * Each thread that records a value gets a shard of its own: its values
+ * sit in memory no other thread writes, and updating them is a plain
+ * load, add and store. Threads beyond PRK_METRICS_SHARDS - 1 share the
+ * last shard and add atomically. Readers sum the shards.
+ */
+typedef struct
+{
+    uint32_t          magic;                                         /* PRK_METRICS_MAGIC once initialized */
+    uint32_t          format;                                        /* PRK_METRICS_FORMAT of the writer */
+    char              stage[PRK_METRICS_STAGE_LEN];
+    int32_t           pid;                                           /* Writer, to skip pages of dead stages */
+    _Atomic uint32_t  count;                                         /* Metrics described, published after each */
+    _Atomic uint32_t  shards;                                        /* Shards ever handed out, readers sum these */
+    uint32_t          slots;                                         /* Values used in each shard */
+    int64_t           start_time;                                    /* Unix time the stage started */
+    PrkMetricDesc     metrics[PRK_METRICS_MAX];
+    _Atomic int64_t   gauges[PRK_METRICS_MAX];
+    _Alignas(64) _Atomic uint64_t values[PRK_METRICS_SHARDS][PRK_METRICS_SLOTS];
+} PrkMetricsPage;
+
+
+/* Handles returned by the registration functions, copied by value */
+typedef struct { uint32_t slot; }               PrkCounter;
+typedef struct { uint32_t slot; }               PrkHistogram;
+typedef struct { _Atomic int64_t *value; }      PrkGauge;
+
+
+/* Shard of the calling thread, NULL until it records its first value */
+extern _Thread_local _Atomic uint64_t *prk_metrics_shard;
+
+/* Set when the calling thread writes the shared shard */
+extern _Thread_local int prk_metrics_shard_shared;
+
+
+/**
+ * prk_metrics_open - Create the metrics page of this stage.
+ *
+ * Creates PRK_METRICS_PREFIX "<stage>" afresh (a page left by a previous
+ * run is replaced, so counters restart from zero as Prometheus expects
+ * after a restart) and maps it. Call it once, before registering metrics
+ * and before starting threads. Without a page, or if it fails, the
+ * metrics still work but are recorded in private memory nobody reads.
+ *
+ * @stage: Stage name, such as "server"; also the "stage" label of every
+ *         exported sample.
+ *
+ * Return: 0 on success, -1 on failure (printed).
+ */
+int prk_metrics_open(const char *stage);
+
+
+/**
+ * prk_metrics_close - Remove the metrics page of this stage.
+ *
+ * Unlinks the shm object so exporters stop showing the stage. The page
+ * stays mapped until the process exits, so threads still recording do not
+ * fault.
+ */
+void prk_metrics_close(void);
+
+
+/**
+ * prk_counter - Register a counter.
+ *
+ * @name: Prometheus name ending in _total, prefixed with "prk_<stage>_" so
+ *        families of different stages never mix; may end with a label set
+ *        ({reason="parse"}). Register the series of one family one after
+ *        the other.
+ * @help: One line description.
+ *
+ * Return: the handle; a discarding one once PRK_METRICS_MAX or
+ * PRK_METRICS_SLOTS is exhausted (printed).
+ */
+PrkCounter prk_counter(const char *name, const char *help);
+
+
+/**
+ * prk_gauge - Register a gauge. Arguments and return as prk_counter().
+ */
+PrkGauge prk_gauge(const char *name, const char *help);
+
+
+/**
+ * prk_histogram - Register a log-linear histogram.
+ *
+ * Values fall into PRK_HISTOGRAM_SUB linear buckets per power of two,
+ * so a bucket is at most 25% wide, and a value is recorded with two
+ * additions whatever its size. The exporter shows the power of two
+ * boundaries.
+ *
+ * @name:  As prk_counter(), without _total.
+ * @help:  One line description.
+ * @scale: Recorded units per exported unit: PRK_SCALE_NS for durations
+ *         recorded in nanoseconds, PRK_SCALE_NONE for sizes or counts.
+ *
+ * Return: as prk_counter().
+ */
+PrkHistogram prk_histogram(const char *name, const char *help, double scale);
+
+
+/**
+ * prk_metrics_attach_thread - Hand the calling thread its shard.
+ *
+ * Called by the recording functions the first time a thread records a
+ * value. The shard goes back to the pool when the thread exits, and its
+ * values stay in the totals.
+ *
+ * Return: the shard.
+ */
+_Atomic uint64_t *prk_metrics_attach_thread(void);
+
+
+/**
+ * prk_metrics_map - Map the metrics page of a stage read-only.
+ *
+ * @stage: Stage name, as given to prk_metrics_open().
+ *
+ * Return: the page, or NULL if there is none or it has another format.
+ */
+const PrkMetricsPage *prk_metrics_map(const char *stage);
+
+
+/**
+ * prk_metrics_unmap - Unmap a page returned by prk_metrics_map().
+ */
+void prk_metrics_unmap(const PrkMetricsPage *page);
+
+
+/**
+ * prk_metrics_write_text - Write the metrics of a page in the Prometheus
+ *                          text exposition format.
+ *
+ * Every sample gets the label stage="<stage>". Histograms are written as
+ * cumulative buckets at every power of two, _sum and _count.
+ *
+ * @page: Page of a stage.
+ * @out:  Stream to write to.
+ *
+ * Return: 0 on success, -1 on a write error.
+ */
+int prk_metrics_write_text(const PrkMetricsPage *page, FILE *out);
+
+
+/**
+ * prk_counter_read - Value of a counter, summed over the shards.
+ *
+ * @page: Page holding the counter, as for prk_histogram_read().
+ * @desc: Its description, an entry of @page->metrics.
+ *
+ * Return: the count.
+ */
+uint64_t prk_counter_read(const PrkMetricsPage *page, const PrkMetricDesc *desc);
+
+
+/**
+ * prk_histogram_read - Buckets of a histogram, summed over the shards.
+ *
+ * @page:    Page holding the histogram, mapped or this stage's own.
+ * @desc:    Its description, an entry of @page->metrics.
+ * @buckets: Receives the count of each bucket.
+ * @sum:     Receives the sum of the values recorded, unless NULL.
+ *
+ * Return: number of values recorded.
+ */
+uint64_t prk_histogram_read(const PrkMetricsPage *page, const PrkMetricDesc *desc,
+                            uint64_t buckets[PRK_HISTOGRAM_BUCKETS], uint64_t *sum);
+
+
+/**
+ * prk_histogram_quantile - Estimate a quantile from histogram buckets.
+ *
+ * Interpolates linearly inside the bucket holding the quantile, so the
+ * result is within the bucket's width (at most 25%) of the true value.
+ *
+ * @buckets: Buckets as filled by prk_histogram_read().
+ * @count:   Their total.
+ * @q:       Quantile, 0.5 for the median, 0.999 for p999.
+ *
+ * Return: the estimate in recorded units, 0 if @count is 0.
+ */
+double prk_histogram_quantile(const uint64_t buckets[PRK_HISTOGRAM_BUCKETS], uint64_t count, double q);
+
+
+/**
+ * prk_histogram_bucket - Bucket of @value.
+ */
+static inline unsigned prk_histogram_bucket(uint64_t value)
+{
+    if (value < PRK_HISTOGRAM_SUB)
+    {
+        return (unsigned)value;
+    }
+
+    unsigned exp    = 63u - (unsigned)__builtin_clzll(value);
+    unsigned bucket = (exp - PRK_HISTOGRAM_SUB_BITS + 1) * PRK_HISTOGRAM_SUB +
+                      (unsigned)((value >> (exp - PRK_HISTOGRAM_SUB_BITS)) & (PRK_HISTOGRAM_SUB - 1));
+    return bucket < PRK_HISTOGRAM_BUCKETS ? bucket : PRK_HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * prk_metrics_values - Shard of the calling thread.
+ */
+static inline _Atomic uint64_t *prk_metrics_values(void)
+{
+    _Atomic uint64_t *shard = prk_metrics_shard;
+    return __builtin_expect(shard != NULL, 1) ? shard : prk_metrics_attach_thread();
+}
+
+/**
+ * prk_metrics_add - Add @n to a value of the calling thread's shard.
+ *
+ * The only writer of its own shard needs no atomic read-modify-write;
+ * the relaxed store keeps readers from seeing a torn value.
+ */
+static inline void prk_metrics_add(_Atomic uint64_t *value, uint64_t n)
+{
+    if (__builtin_expect(prk_metrics_shard_shared, 0))
+    {
+        atomic_fetch_add_explicit(value, n, memory_order_relaxed);
+    }
+    else
+    {
+        atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n, memory_order_relaxed);
+    }
+}
+
+/**
+ * prk_counter_add - Add @n to a counter.
+ */
+static inline void prk_counter_add(PrkCounter counter, uint64_t n)
+{
+    prk_metrics_add(&prk_metrics_values()[counter.slot], n);
+}
+
+/**
+ * prk_counter_inc - Add one to a counter.
+ */
+static inline void prk_counter_inc(PrkCounter counter)
+{
+    prk_counter_add(counter, 1);
+}
+
+/**
+ * prk_gauge_set - Set a gauge.
+ */
+static inline void prk_gauge_set(PrkGauge gauge, int64_t value)
+{
+    atomic_store_explicit(gauge.value, value, memory_order_relaxed);
+}
+
+/**
+ * prk_gauge_add - Move a gauge by @delta, which may be negative.
+ */
+static inline void prk_gauge_add(PrkGauge gauge, int64_t delta)
+{
+    atomic_fetch_add_explicit(gauge.value, delta, memory_order_relaxed);
+}
+
+/**
+ * prk_histogram_observe - Record @value in a histogram.
+ */
+static inline void prk_histogram_observe(PrkHistogram histogram, uint64_t value)
+{
+    _Atomic uint64_t *values = prk_metrics_values() + histogram.slot;
+    prk_metrics_add(&values[prk_histogram_bucket(value)], 1);
+    prk_metrics_add(&values[PRK_HISTOGRAM_BUCKETS], value);
+}
+
+/**
+ * prk_metrics_now_ns - CLOCK_MONOTONIC in nanoseconds, to time histograms.
+ */
+static inline uint64_t prk_metrics_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+#endif  /* PRK_METRICS_H */
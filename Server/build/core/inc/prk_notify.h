@@ -0,0 +1,35 @@
+#ifndef PRK_NOTIFY_H
+#define PRK_NOTIFY_H
+
+
+#define PRK_NOTIFY_ENV         "NOTIFY_SOCKET"                       /* Set by the supervisor (or systemd) */
+
+
+/**
+ * prk_notify - Send a state line to the supervisor of this process.
+ *
+ * The line goes as one datagram to the unix socket named by $NOTIFY_SOCKET
+ * (a path, or an abstract name written with a leading '@'), which is the
+ * protocol of systemd's sd_notify(): prk_sys_srv_run speaks it, and the
+ * stages can run as Type=notify units as well. Without the variable
+ * nothing is sent, so a stage started by hand behaves as before.
+ *
+ * @state: State line, such as "READY=1" or "STOPPING=1".
+ *
+ * Return: 1 when sent, 0 when there is no supervisor, -1 on failure (printed).
+ */
+int prk_notify(const char *state);
+
+
+/**
+ * prk_notify_ready - Tell the supervisor that this stage serves requests.
+ *
+ * Call once the resources the next stages rely on exist (socket bound,
+ * shared memory created, FIFO made), before blocking on them.
+ *
+ * Return: as prk_notify().
+ */
+int prk_notify_ready(void);
+
+
+#endif  /* PRK_NOTIFY_H */
@@ -0,0 +1,51 @@
+#ifndef PRK_SYS_SRV_RUN_H
+#define PRK_SYS_SRV_RUN_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+
+#define SUPERVISOR_SOCKET      "@prk_sys_srv_run.%d"                 /* Notify socket, abstract, per supervisor pid */
+#define SUPERVISOR_READY_TIMEOUT_MS 15000                            /* Restart a stage not ready this long after start */
+#define SUPERVISOR_STOP_TIMEOUT_MS  5000                             /* SIGKILL a stage still running this long after SIGTERM */
+#define SUPERVISOR_BACKOFF_MIN_MS   250                              /* First restart delay, doubled per crash */
+#define SUPERVISOR_BACKOFF_MAX_MS   30000                            /* Longest restart delay */
+#define SUPERVISOR_STABLE_MS   60000                                 /* Up this long: the next crash restarts at once */
+#define SUPERVISOR_MAX_ARGS    8                                     /* argv entries of a stage, NULL included */
+#define SUPERVISOR_MAX_AFTER   4                                     /* Stages a stage waits for */
+
+
+/* A stage of the pipeline and the stages that must be ready before it starts */
+typedef struct
+{
+    const char  *name;
+    const char  *argv[SUPERVISOR_MAX_ARGS];                          /* argv[0] is run from the current directory */
+    const char  *after[SUPERVISOR_MAX_AFTER];                        /* Names, NULL terminated */
+} StageSpec;
+
+
+typedef enum
+{
+    STAGE_WAITING,                                                   /* For the stages it starts after */
+    STAGE_STARTING,                                                  /* Running, not ready yet */
+    STAGE_READY,
+    STAGE_STOPPING,                                                  /* SIGTERM sent */
+    STAGE_BACKOFF,                                                   /* Crashed, restarts at deadline_ms */
+    STAGE_DOWN                                                       /* Stopped for good, or left out */
+} StageState;
+
+
+/* Run time state of a stage */
+typedef struct
+{
+    const StageSpec *spec;
+    StageState      state;
+    pid_t           pid;
+    int             restarts;                                        /* Crashes since the stage was last stable */
+    int             restart_after_stop;                              /* Stopped for a ready timeout, not a shutdown */
+    int64_t         started_ms;                                      /* CLOCK_MONOTONIC of the last start */
+    int64_t         deadline_ms;                                     /* Ready timeout, SIGKILL or restart time */
+} Stage;
+
+
+#endif  /* PRK_SYS_SRV_RUN_H */
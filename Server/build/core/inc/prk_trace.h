@@ -0,0 +1,152 @@
+#ifndef PRK_TRACE_H
+#define PRK_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define PRK_TRACE_TAG          "trace"                               /* Starts the trace suffix of a record */
+#define PRK_TRACE_STAMP_MAX    48                                    /* " <stage>:<mono_us>:<offset_us>" */
+#define PRK_TRACE_TEXT_MAX     (24 + PRK_TRACE_STAGES * PRK_TRACE_STAMP_MAX) /* Whole suffix */
+#define PRK_TRACE_SAME_CLOCK_US 1000                                 /* Offsets this close: same host */
+
+
+/* Where a record is stamped, in the order it passes them */
+typedef enum
+{
+    PRK_TRACE_MCU = 0,                                               /* STM32, HAL_UART_Transmit() */
+    PRK_TRACE_CTL,                                                   /* sys_com_controller, packet received */
+    PRK_TRACE_IPC,                                                   /* ipc_sender, written to the FIFO */
+    PRK_TRACE_TCP,                                                   /* tcp_client, sent to the server */
+    PRK_TRACE_SRV,                                                   /* out_server, written to shared memory */
+    PRK_TRACE_GIIS,                                                  /* out_giis, written to the inserter's FIFO */
+    PRK_TRACE_INS,                                                   /* Inserter, record parsed */
+    PRK_TRACE_DB,                                                    /* Inserter, batch committed */
+    PRK_TRACE_STAGES                                                 /* Number of stages, keep last */
+} prk_trace_stage_t;
+
+
+/*
+ * Time of one stage. @mono_us is CLOCK_MONOTONIC of the stamping host and
+ * @offset_us is CLOCK_REALTIME - CLOCK_MONOTONIC there at that moment: two
+ * stamps of one host are compared by their monotonic times, stamps of
+ * different hosts by mono_us + offset_us, i.e. by their synchronized
+ * wall clocks.
+ */
+typedef struct
+{
+    uint8_t   stage;                                                 /* prk_trace_stage_t */
+    int64_t   mono_us;
+    int64_t   offset_us;
+} PrkTraceStamp;
+
+
+/* A record's trace: its id and the stamps so far, in stage order */
+typedef struct
+{
+    uint64_t      id;                                                /* Never 0 */
+    uint32_t      count;                                             /* Stamps used */
+    PrkTraceStamp stamps[PRK_TRACE_STAGES];
+} PrkTrace;
+
+
+/**
+ * prk_trace_begin - Start the trace of a new record.
+ *
+ * Ids are random per process, then increase by one per trace.
+ *
+ * @trace: Trace to reset; it has an id and no stamps.
+ */
+void prk_trace_begin(PrkTrace *trace);
+
+
+/**
+ * prk_trace_stamp - Stamp a trace with the current time.
+ *
+ * @trace: Trace to extend; a stage already stamped, or a full trace, is
+ *         left as it is.
+ * @stage: Stage stamping the record.
+ */
+void prk_trace_stamp(PrkTrace *trace, prk_trace_stage_t stage);
+
+
+/**
+ * prk_trace_stamp_at - Stamp a trace with a monotonic time of this host.
+ *
+ * As prk_trace_stamp(), for an event that happened at @mono_us, e.g. the
+ * estimated send time of a packet received from the STM32.
+ */
+void prk_trace_stamp_at(PrkTrace *trace, prk_trace_stage_t stage, int64_t mono_us);
+
+
+/**
+ * prk_trace_format - Write the trace suffix of a record.
+ *
+ * Writes " trace <id> <stage>:<mono_us>:<offset_us>..." with the id in hex.
+ *
+ * @trace: Trace to write.
+ * @buf:   Destination.
+ * @size:  Size of @buf.
+ *
+ * Return: length written (without the NUL), or -1 if it does not fit.
+ */
+int prk_trace_format(const PrkTrace *trace, char *buf, size_t size);
+
+
+/**
+ * prk_trace_format_stamp - Write a stamp of the current time.
+ *
+ * For stages that forward records as text: append the result to a record
+ * that carries a trace suffix (see prk_trace_find()).
+ *
+ * @stage: Stage stamping the record.
+ * @buf:   Destination, at least PRK_TRACE_STAMP_MAX bytes.
+ * @size:  Size of @buf.
+ *
+ * Return: length written (without the NUL), or -1 if it does not fit.
+ */
+int prk_trace_format_stamp(prk_trace_stage_t stage, char *buf, size_t size);
+
+
+/**
+ * prk_trace_find - Locate the trace suffix of a record.
+ *
+ * @record: Record text (need not be NUL-terminated).
+ * @len:    Length of @record.
+ *
+ * Return: the blank that starts " trace ...", or NULL if the record has none.
+ */
+const char *prk_trace_find(const char *record, size_t len);
+
+
+/**
+ * prk_trace_parse - Read a trace suffix back.
+ *
+ * @text:  Suffix, from "trace" or the blank before it, to the end of the record.
+ * @len:   Length of @text.
+ * @trace: Receives the id and the stamps.
+ *
+ * Return: 0 on success, -1 if the suffix is malformed.
+ */
+int prk_trace_parse(const char *text, size_t len, PrkTrace *trace);
+
+
+/**
+ * prk_trace_elapsed_us - Time from stamp @from to stamp @to.
+ *
+ * Stamps whose offsets differ by less than PRK_TRACE_SAME_CLOCK_US come
+ * from one host and are compared by their monotonic clocks, immune to
+ * clock steps; others by their wall clocks.
+ *
+ * Return: microseconds, negative if the clocks disagree.
+ */
+int64_t prk_trace_elapsed_us(const PrkTraceStamp *from, const PrkTraceStamp *to);
+
+
+/**
+ * prk_trace_stage_name - Short name of a stage, as written in a stamp.
+ */
+const char *prk_trace_stage_name(prk_trace_stage_t stage);
+
+
+#endif  /* PRK_TRACE_H */
@@ -0,0 +1,258 @@
+#ifndef PRK_TRACEPOINT_H
+#define PRK_TRACEPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>                                               /* __rdtsc() */
+#endif
+
+
+#define PRK_TP_PREFIX          "/prk_tp."                            /* POSIX shm object of a stage: prefix + stage */
+#define PRK_TP_MAGIC           0x50524b54u                           /* "PRKT" */
+#define PRK_TP_FORMAT          1                                     /* Layout of PrkTpPage */
+#define PRK_TP_RINGS           32                                    /* Threads tracing at once, others discarded */
+#define PRK_TP_RING_EVENTS     16384                                 /* Events kept per thread, a power of two */
+#define PRK_TP_STAGE_LEN       32                                    /* Longest stage name */
+
+#define PRK_TP_PHASE_BEGIN     'B'                                   /* Chrome trace phases */
+#define PRK_TP_PHASE_END       'E'
+#define PRK_TP_PHASE_INSTANT   'i'
+
+
+/*
+ * The events, with the names of their two arguments (NULL: unused). The
+ * names are those shown by the trace viewer; add new events at the end so
+ * that dumps of running stages stay readable.
+ */
+#define PRK_TP_EVENTS(X)                                                                        \
+    X(PRK_TP_SERVER_CLIENT,   "handle_client",            "fd",       NULL)                     \
+    X(PRK_TP_SERVER_RECORD,   "server_record",            "bytes",    "traced")                 \
+    X(PRK_TP_GIIS_READ,       "read_from_shared_memory",  "bytes",    NULL)                     \
+    X(PRK_TP_INS_FIFO,        "process_fifo",             "bytes",    NULL)                     \
+    X(PRK_TP_INS_LINE,        "process_line",             "bytes",    NULL)                     \
+    X(PRK_TP_INS_COMMIT,      "commit_batch",             NULL,       NULL)                     \
+    X(PRK_TP_CTL_PACKET,      "sys_com_controller_packet", "bytes",   NULL)                     \
+    X(PRK_TP_IPC_WRITE,       "ipc_sender_write",         "bytes",    "traced")                 \
+    X(PRK_TP_TCP_READ,        "tcp_client_read",          "bytes",    NULL)                     \
+    X(PRK_TP_TCP_SEND,        "tcp_client_send",          "bytes",    "record")
+
+#define PRK_TP_ENUM(id, name, arg0, arg1) id,
+typedef enum
+{
+    PRK_TP_EVENTS(PRK_TP_ENUM)
+    PRK_TP_EVENT_COUNT
+} prk_tp_event_t;
+#undef PRK_TP_ENUM
+
+
+/* One event, 32 bytes */
+typedef struct
+{
+    uint64_t  ticks;                                                 /* prk_tp_ticks() */
+    int32_t   tid;                                                   /* Thread that emitted it */
+    uint16_t  event;                                                 /* prk_tp_event_t */
+    uint8_t   phase;                                                 /* PRK_TP_PHASE_* */
+    uint8_t   reserved;
+    uint64_t  args[2];
+} PrkTpEvent;
+
+
+/*
+ * Events of one thread. Only the owner writes; head counts the events
+ * ever written, the last PRK_TP_RING_EVENTS of them are kept. A ring is
+ * handed back when its thread exits and reused by the next one.
+ */
+typedef struct
+{
+    _Alignas(64) _Atomic int32_t  owner;                             /* Thread id, 0 when free */
+    _Alignas(64) _Atomic uint64_t head;
+    PrkTpEvent                    events[PRK_TP_RING_EVENTS];
+} PrkTpRing;
+
+
+/*
+ * Tracepoints of one stage, the shm object PRK_TP_PREFIX "<stage>".
+ * Ticks are converted to time with the pair taken when the page was
+ * opened: with a TSC, the reader takes a pair of its own to get the rate,
+ * which needs an invariant TSC (any x86 of the last decade).
+ */
+typedef struct
+{
+    uint32_t          magic;                                         /* PRK_TP_MAGIC once initialized */
+    uint32_t          format;                                        /* PRK_TP_FORMAT of the writer */
+    char              stage[PRK_TP_STAGE_LEN];
+    int32_t           pid;
+    uint32_t          ticks_are_ns;                                  /* 1: no TSC, ticks are CLOCK_MONOTONIC_RAW ns */
+    uint64_t          open_ticks;                                    /* prk_tp_ticks() ... */
+    int64_t           open_ns;                                       /* ... and CLOCK_MONOTONIC at the same time */
+    _Atomic uint64_t  lost_threads;                                  /* Threads that found every ring taken */
+    PrkTpRing         rings[PRK_TP_RINGS];
+} PrkTpPage;
+
+
+/* Ring of the calling thread, NULL until its first event */
+extern _Thread_local PrkTpRing *prk_tp_ring;
+
+/* Its thread id */
+extern _Thread_local int32_t prk_tp_tid;
+
+
+/**
+ * prk_tp_ticks - Timestamp of an event: the TSC, or CLOCK_MONOTONIC_RAW in ns.
+ */
+static inline uint64_t prk_tp_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+
+/**
+ * prk_tp_open - Create the tracepoint page of this stage.
+ *
+ * Until it is called, or if it fails, events are written to memory of
+ * this process only. Normally called through PRK_TP_OPEN().
+ *
+ * @stage: Stage name, e.g. "server".
+ *
+ * Return: 0 on success, -1 on error (printed).
+ */
+int prk_tp_open(const char *stage);
+
+
+/**
+ * prk_tp_close - Remove the tracepoint page of this stage.
+ *
+ * The events stay readable by a dumper that mapped it before.
+ */
+void prk_tp_close(void);
+
+
+/**
+ * prk_tp_attach - Give the calling thread a ring.
+ *
+ * Called on a thread's first event. A thread that finds every ring
+ * taken writes to a discarded ring and is counted in lost_threads.
+ *
+ * Return: the ring, never NULL.
+ */
+PrkTpRing *prk_tp_attach(void);
+
+
+/**
+ * prk_tp_emit - Write an event to the ring of the calling thread.
+ *
+ * @event: prk_tp_event_t.
+ * @phase: PRK_TP_PHASE_*.
+ * @arg0:  First argument, see PRK_TP_EVENTS.
+ * @arg1:  Second argument.
+ */
+static inline void prk_tp_emit(uint16_t event, uint8_t phase, uint64_t arg0, uint64_t arg1)
+{
+    PrkTpRing *ring = prk_tp_ring ? prk_tp_ring : prk_tp_attach();
+    uint64_t  head  = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    PrkTpEvent *slot = &ring->events[head & (PRK_TP_RING_EVENTS - 1)];
+    slot->ticks   = prk_tp_ticks();
+    slot->tid     = prk_tp_tid;
+    slot->event   = event;
+    slot->phase   = phase;
+    slot->args[0] = arg0;
+    slot->args[1] = arg1;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+/**
+ * prk_tp_scope_end - End event of PRK_TP_SCOPE(), run when its scope is left.
+ */
+static inline void prk_tp_scope_end(const uint16_t *event)
+{
+    prk_tp_emit(*event, PRK_TP_PHASE_END, 0, 0);
+}
+
+
+/**
+ * prk_tp_event_name - Name of an event, and of its arguments.
+ *
+ * @event: prk_tp_event_t.
+ * @arg:   -1 for the event, 0 or 1 for an argument.
+ *
+ * Return: the name, NULL for an unused argument or an unknown event.
+ */
+const char *prk_tp_event_name(uint32_t event, int arg);
+
+
+/**
+ * prk_tp_map - Map the tracepoint page of a stage read-only.
+ *
+ * Return: the page, or NULL if the stage has none.
+ */
+const PrkTpPage *prk_tp_map(const char *stage);
+
+
+/**
+ * prk_tp_copy_ring - Copy the events a ring still holds.
+ *
+ * The owner keeps writing while the copy is made; the events it may have
+ * overwritten meanwhile are left out.
+ *
+ * @ring:   Ring of a mapped page.
+ * @events: Receives up to PRK_TP_RING_EVENTS events, oldest first.
+ *
+ * Return: number of events copied.
+ */
+size_t prk_tp_copy_ring(const PrkTpRing *ring, PrkTpEvent *events);
+
+
+/**
+ * prk_tp_unmap - Unmap a page returned by prk_tp_map().
+ */
+void prk_tp_unmap(const PrkTpPage *mapped);
+
+
+/*
+ * Tracepoints. Built with -DPRK_TRACEPOINTS (make TRACEPOINTS=1) they
+ * write an event to the calling thread's ring: a TSC read and a few
+ * stores. Otherwise they compile to nothing and their arguments are not
+ * evaluated.
+ *
+ *   PRK_TP_OPEN(stage)             create the page of the stage
+ *   PRK_TP_CLOSE()                 remove it
+ *   PRK_TP_BEGIN(event, a0, a1)    start of a span on this thread
+ *   PRK_TP_END(event, a0, a1)      its end; the arguments are merged
+ *   PRK_TP_SCOPE(event, a0, a1)    a span ending with the enclosing block,
+ *                                  whichever way it is left
+ *   PRK_TP_INSTANT(event, a0, a1)  a point in time
+ */
+#ifdef PRK_TRACEPOINTS
+#define PRK_TP_CONCAT_(a, b)           a##b
+#define PRK_TP_CONCAT(a, b)            PRK_TP_CONCAT_(a, b)
+#define PRK_TP_OPEN(stage)             prk_tp_open(stage)
+#define PRK_TP_CLOSE()                 prk_tp_close()
+#define PRK_TP_BEGIN(event, a0, a1)    prk_tp_emit(event, PRK_TP_PHASE_BEGIN, (uint64_t)(a0), (uint64_t)(a1))
+#define PRK_TP_END(event, a0, a1)      prk_tp_emit(event, PRK_TP_PHASE_END, (uint64_t)(a0), (uint64_t)(a1))
+#define PRK_TP_INSTANT(event, a0, a1)  prk_tp_emit(event, PRK_TP_PHASE_INSTANT, (uint64_t)(a0), (uint64_t)(a1))
+#define PRK_TP_SCOPE(event, a0, a1)                                                                 \
+    __attribute__((cleanup(prk_tp_scope_end))) const uint16_t PRK_TP_CONCAT(prk_tp_scope_, __LINE__) = \
+        (PRK_TP_BEGIN(event, a0, a1), (uint16_t)(event))
+#else
+#define PRK_TP_OPEN(stage)             ((void)0)
+#define PRK_TP_CLOSE()                 ((void)0)
+#define PRK_TP_BEGIN(event, a0, a1)    ((void)0)
+#define PRK_TP_END(event, a0, a1)      ((void)0)
+#define PRK_TP_INSTANT(event, a0, a1)  ((void)0)
+#define PRK_TP_SCOPE(event, a0, a1)    ((void)0)
+#endif
+
+
+#endif  /* PRK_TRACEPOINT_H */
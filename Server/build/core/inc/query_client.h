@@ -0,0 +1,48 @@
+#ifndef QUERY_CLIENT_H
+#define QUERY_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "query_proto.h"
+
+
+/**
+ * query_client_connect - Connect to the query service.
+ *
+ * @path: Service socket, usually QUERY_SOCKET_PATH.
+ *
+ * Return: connected blocking socket, or -1 on failure (an error is printed).
+ */
+int query_client_connect(const char *path);
+
+
+/**
+ * query_client_send - Send one request without waiting for its response.
+ *
+ * Several requests may be sent before reading their responses; they are
+ * answered in order.
+ *
+ * @fd:    Connected socket.
+ * @op:    query_op_t.
+ * @tag:   Echoed in the response.
+ * @keys:  Request keys.
+ * @count: Number of keys, at most QUERY_MAX_KEYS.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int query_client_send(int fd, uint16_t op, uint32_t tag, const uint64_t *keys, uint32_t count);
+
+
+/**
+ * query_client_recv - Read the next response.
+ *
+ * @fd:      Connected socket.
+ * @header:  Receives the response header.
+ * @records: Receives the records, at least QUERY_MAX_RESPONSE bytes.
+ *
+ * Return: 0 on success, -1 on failure or a malformed response.
+ */
+int query_client_recv(int fd, QueryHeader *header, void *records);
+
+
+#endif  /* QUERY_CLIENT_H */
@@ -0,0 +1,16 @@
+#ifndef QUERY_DAEMON_H
+#define QUERY_DAEMON_H
+
+
+#define DB_PATH "prksys_db.db"                                       /* Read once at startup */
+
+
+/**
+ * stop_handler - SIGINT/SIGTERM handler stopping the service loop.
+ *
+ * @signum: The signal number that was received.
+ */
+void stop_handler(int signum);
+
+
+#endif  /* QUERY_DAEMON_H */
@@ -0,0 +1,79 @@
+#ifndef QUERY_FEED_H
+#define QUERY_FEED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "query_proto.h"
+#include "reading_store.h"
+
+
+#define QUERY_FEED_RETRY_MS    1000                                  /* Reconnect attempts while the service is down */
+
+
+/* Inserter side of the query service feed */
+typedef struct
+{
+    int             fd;                                              /* SOCK_DGRAM, non-blocking */
+    int             connected;                                       /* connect() to the service succeeded */
+    const char      *path;                                           /* Service feed socket */
+    int64_t         retry_ms;                                        /* CLOCK_MONOTONIC of the next reconnect */
+    QueryFeedRecord *queued;                                         /* Updates of the open batch, not sent yet */
+    size_t          queued_count;
+    size_t          queued_capacity;
+    QueryFeedBatch  batch;                                           /* Datagram being sent */
+    uint64_t        sent;                                            /* Updates delivered to the socket */
+    uint64_t        dropped;                                         /* Updates lost: service down or lagging */
+} QueryFeed;
+
+
+/**
+ * query_feed_open - Create the feed socket.
+ *
+ * The service does not have to be running: updates are dropped until it
+ * is, and it starts from Sensor_State anyway.
+ *
+ * @feed: Feed to initialize.
+ * @path: Feed socket of the service, usually QUERY_FEED_PATH.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int query_feed_open(QueryFeed *feed, const char *path);
+
+
+/**
+ * query_feed_add - Queue the new state of a sensor.
+ *
+ * Nothing is sent before query_feed_flush(), so a batch that is rolled
+ * back never reaches the service. Never blocks.
+ *
+ * @feed:    Feed.
+ * @reading: Reading just stored.
+ * @mac:     48-bit MAC of the sensor.
+ */
+void query_feed_add(QueryFeed *feed, const StoredReading *reading, uint64_t mac);
+
+
+/**
+ * query_feed_flush - Send the queued updates.
+ *
+ * Call after the COMMIT of the batch that stored them. Sends
+ * QUERY_FEED_BATCH updates per datagram and never blocks: a lagging
+ * service loses updates (counted in dropped) rather than slowing the
+ * inserter down; the sensor's next reading corrects its state.
+ */
+void query_feed_flush(QueryFeed *feed);
+
+
+/**
+ * query_feed_discard - Drop the queued updates of a batch that was rolled back.
+ */
+void query_feed_discard(QueryFeed *feed);
+
+
+/**
+ * query_feed_close - Close the feed socket.
+ */
+void query_feed_close(QueryFeed *feed);
+
+
+#endif  /* QUERY_FEED_H */
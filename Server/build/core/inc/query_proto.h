@@ -0,0 +1,117 @@
+#ifndef QUERY_PROTO_H
+#define QUERY_PROTO_H
+
+#include <stdint.h>
+
+
+/*
+ * Wire format of the occupancy query service (out_query_daemon).
+ *
+ * Clients connect a SOCK_STREAM unix socket at QUERY_SOCKET_PATH and send
+ * requests back to back without waiting for the answers (pipelining).
+ * Every message is a QueryHeader followed by header.count items: uint64_t
+ * keys in a request, QuerySensor or QueryZone records in a response.
+ * Responses come in request order and echo the request's tag. All fields
+ * are in host byte order: the socket is local, both ends share the ABI.
+ *
+ * The inserter feeds the service over a SOCK_DGRAM unix socket at
+ * QUERY_FEED_PATH, one QueryFeedBatch per datagram.
+ */
+
+#define QUERY_SOCKET_PATH      "giis/query.sock"                     /* Clients connect here */
+#define QUERY_FEED_PATH        "giis/query_feed.sock"                /* The inserter sends state updates here */
+#define QUERY_MAX_KEYS         1024                                  /* Keys per request, records per response */
+#define QUERY_FEED_BATCH       64                                    /* Updates per feed datagram */
+
+
+/* Request operations */
+typedef enum
+{
+    QOP_SENSOR = 1,                                                  /* Keys: Sensors.id -> QuerySensor */
+    QOP_SENSOR_MAC,                                                  /* Keys: 48-bit MAC -> QuerySensor */
+    QOP_ZONE,                                                        /* Keys: Zones.id -> QueryZone */
+    QOP_ZONE_LIST                                                    /* Key: first Zones.id -> up to QUERY_MAX_KEYS QueryZone */
+} query_op_t;
+
+
+/* Response status */
+typedef enum
+{
+    QST_OK = 0,                                                      /* Records follow (each has its own found flag) */
+    QST_BAD_REQUEST                                                  /* Unknown op or bad count, no records */
+} query_status_t;
+
+
+/* Header of every request and response, 16 bytes */
+typedef struct
+{
+    uint32_t  len;                                                   /* Message length including the header */
+    uint16_t  op;                                                    /* query_op_t */
+    uint16_t  status;                                                /* query_status_t, 0 in requests */
+    uint32_t  tag;                                                   /* Chosen by the client, echoed back */
+    uint32_t  count;                                                 /* Keys or records following */
+} QueryHeader;
+
+
+/* Current state of one sensor, 48 bytes */
+typedef struct
+{
+    int64_t   sensor_id;                                             /* Sensors.id, as requested for QOP_SENSOR */
+    uint64_t  mac;                                                   /* 48-bit MAC, as requested for QOP_SENSOR_MAC */
+    int64_t   last_seen;                                             /* recv_time of the latest reading, ms */
+    int64_t   zone_id;                                               /* Zone of the latest position, 0 if none */
+    int32_t   x;                                                     /* X coordinate * COORD_SCALE */
+    int32_t   y;                                                     /* Y coordinate * COORD_SCALE */
+    int32_t   z;                                                     /* Z coordinate * COORD_SCALE */
+    char      status;                                                /* Status character of the latest reading */
+    uint8_t   found;                                                 /* 0: unknown sensor, other fields zero */
+    uint16_t  reserved;
+} QuerySensor;
+
+
+/* Current occupancy of one zone, 32 bytes */
+typedef struct
+{
+    int64_t   zone_id;                                               /* Zones.id */
+    uint32_t  sensors;                                               /* Sensors whose latest position is in the zone */
+    uint32_t  parked;                                                /* Of which parked (status 'S') */
+    int64_t   last_update;                                           /* recv_time of the latest change, ms */
+    uint32_t  found;                                                 /* 0: no such zone */
+    uint32_t  reserved;
+} QueryZone;
+
+
+/* One state update from the inserter, 40 bytes */
+typedef struct
+{
+    int64_t   sensor_id;                                             /* Sensors.id */
+    uint64_t  mac;                                                   /* 48-bit MAC */
+    int64_t   recv_time;                                             /* Receive time, ms since the epoch */
+    int32_t   x;                                                     /* X coordinate * COORD_SCALE */
+    int32_t   y;                                                     /* Y coordinate * COORD_SCALE */
+    int32_t   z;                                                     /* Z coordinate * COORD_SCALE */
+    char      status;                                                /* Status character */
+    char      reserved[3];
+} QueryFeedRecord;
+
+
+/* One feed datagram */
+typedef struct
+{
+    uint32_t          count;                                         /* Used records */
+    uint32_t          reserved;
+    QueryFeedRecord   records[QUERY_FEED_BATCH];
+} QueryFeedBatch;
+
+
+_Static_assert(sizeof(QueryHeader) == 16, "QueryHeader is part of the wire format");
+_Static_assert(sizeof(QuerySensor) == 48, "QuerySensor is part of the wire format");
+_Static_assert(sizeof(QueryZone) == 32, "QueryZone is part of the wire format");
+_Static_assert(sizeof(QueryFeedRecord) == 40, "QueryFeedRecord is part of the wire format");
+
+
+#define QUERY_MAX_REQUEST      (sizeof(QueryHeader) + QUERY_MAX_KEYS * sizeof(uint64_t))
+#define QUERY_MAX_RESPONSE     (sizeof(QueryHeader) + QUERY_MAX_KEYS * sizeof(QuerySensor))
+
+
+#endif  /* QUERY_PROTO_H */
@@ -0,0 +1,145 @@
+#ifndef QUERY_SERVICE_H
+#define QUERY_SERVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sqlite3.h>
+#include "query_proto.h"
+#include "zone_map.h"
+
+
+#define QUERY_MAX_CLIENTS      256                                   /* Concurrent client connections */
+#define QUERY_OUT_BUFFER       (2 * QUERY_MAX_RESPONSE)              /* Pending response bytes per client */
+
+
+/* Current state of one sensor, indexed by Sensors.id */
+typedef struct
+{
+    uint64_t  mac;                                                   /* 48-bit MAC, 0 if unknown */
+    int64_t   last_seen;                                             /* recv_time of the latest reading */
+    int64_t   zone_id;                                               /* Zone of the latest position */
+    int32_t   x;
+    int32_t   y;
+    int32_t   z;
+    char      status;
+    int       positioned;                                            /* A reading is known, counted in zone_id */
+} ServiceSensor;
+
+
+/* Current occupancy of one zone, indexed by Zones.id (0: outside every zone) */
+typedef struct
+{
+    uint32_t  sensors;                                               /* Sensors positioned in the zone */
+    uint32_t  parked;                                                /* Of which parked */
+    int64_t   last_update;                                           /* Latest change, ms */
+    int       exists;                                                /* Listed in the Zones table */
+} ServiceZone;
+
+
+/* MAC -> Sensors.id hash slot (id 0 marks an empty slot) */
+typedef struct
+{
+    uint64_t  mac;
+    int64_t   id;
+} ServiceMacSlot;
+
+
+/* In-memory state served by out_query_daemon */
+typedef struct
+{
+    const ZoneMap           *zones;                                  /* Coordinates -> zone */
+    ServiceSensor           *sensors;                                /* Indexed by Sensors.id */
+    size_t                  sensor_capacity;                         /* Allocated entries of sensors */
+    ServiceMacSlot          *macs;                                   /* Open addressing, power of two */
+    size_t                  mac_capacity;                            /* Number of slots */
+    size_t                  mac_count;                               /* Used slots */
+    ServiceZone             *zone_state;                             /* Indexed by Zones.id */
+    size_t                  zone_capacity;                           /* Max Zones.id + 1 */
+    uint64_t                requests;                                /* Requests answered */
+    uint64_t                updates;                                 /* Feed records applied */
+    volatile sig_atomic_t   stop;                                    /* Set by query_service_stop() */
+} QueryService;
+
+
+/**
+ * query_service_init - Create an empty service.
+ *
+ * @service: Service to initialize.
+ * @zones:   Zone map, must outlive the service.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int query_service_init(QueryService *service, const ZoneMap *zones);
+
+
+/**
+ * query_service_load - Seed the state from Sensors and Sensor_State.
+ *
+ * The only database access of the service; afterwards the state follows
+ * the feed.
+ *
+ * @service: Service.
+ * @db:      Open database at schema version 5 or later.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int query_service_load(QueryService *service, sqlite3 *db);
+
+
+/**
+ * query_service_apply - Apply one state update.
+ *
+ * Moves the sensor between zone counters when its zone or parked status
+ * changes. Updates older than the state held are ignored.
+ *
+ * @service: Service.
+ * @record:  Update from the feed.
+ *
+ * Return: 0 on success, -1 on allocation failure.
+ */
+int query_service_apply(QueryService *service, const QueryFeedRecord *record);
+
+
+/**
+ * query_service_answer - Answer one request.
+ *
+ * @service: Service.
+ * @request: Request header; header->len already checked against the keys.
+ * @keys:    request->count keys.
+ * @out:     Receives the response, at least QUERY_MAX_RESPONSE bytes.
+ *
+ * Return: length of the response written to @out.
+ */
+size_t query_service_answer(QueryService *service, const QueryHeader *request, const uint64_t *keys, uint8_t *out);
+
+
+/**
+ * query_service_run - Serve clients and apply the feed until stopped.
+ *
+ * Single threaded epoll loop. Each client's requests are answered in
+ * order as soon as they are complete, many per read(); a client that does
+ * not read its responses is paused once QUERY_OUT_BUFFER bytes are pending.
+ *
+ * @service:   Service.
+ * @listen_fd: Listening non-blocking SOCK_STREAM unix socket.
+ * @feed_fd:   Bound non-blocking SOCK_DGRAM unix socket, or -1 without a feed.
+ *
+ * Return: 0 when stopped, -1 on failure.
+ */
+int query_service_run(QueryService *service, int listen_fd, int feed_fd);
+
+
+/**
+ * query_service_stop - Make query_service_run() return (async-signal-safe).
+ */
+void query_service_stop(QueryService *service);
+
+
+/**
+ * query_service_free - Release the state.
+ */
+void query_service_free(QueryService *service);
+
+
+#endif  /* QUERY_SERVICE_H */
@@ -0,0 +1,122 @@
+#ifndef READING_STORE_H
+#define READING_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+
+#define STORE_BACKEND_SQLITE   "sqlite"                              /* Customer_Data partitions in prksys_db.db */
+#define STORE_BACKEND_TSDB     "tsdb"                                /* Native time-series engine (store_tsdb.c) */
+
+
+/* One stored position reading */
+typedef struct
+{
+    int64_t   sensor_id;                                             /* Sensors.id */
+    int64_t   recv_time;                                             /* Receive time, ms since the epoch */
+    int32_t   x;                                                     /* X coordinate * COORD_SCALE */
+    int32_t   y;                                                     /* Y coordinate * COORD_SCALE */
+    int32_t   z;                                                     /* Z coordinate * COORD_SCALE */
+    char      status;                                                /* Status character */
+} StoredReading;
+
+
+/**
+ * reading_visitor_t - Callback invoked for each reading returned by a query.
+ *
+ * Return: 0 to continue, non-zero to stop the query.
+ */
+typedef int (*reading_visitor_t)(const StoredReading *reading, void *ctx);
+
+
+/* Operations every storage backend implements */
+typedef struct
+{
+    /* Store one reading; may be buffered until flush */
+    int     (*append)(void *impl, const StoredReading *reading);
+
+    /* Make buffered readings durable (called once their batch has committed) */
+    int     (*flush)(void *impl);
+
+    /* Drop the readings appended since the last flush (their batch was
+     * rolled back); may be NULL when the transaction holds them */
+    void    (*discard)(void *impl);
+
+    /* Visit readings of @sensor_id with from <= recv_time < to */
+    long    (*query)(void *impl, int64_t sensor_id, int64_t from, int64_t to,
+                     reading_visitor_t visitor, void *ctx);
+
+    /* Run pending maintenance (compaction) now; may be NULL */
+    int     (*compact)(void *impl);
+
+    /* Release the backend */
+    void    (*close)(void *impl);
+} ReadingStoreOps;
+
+
+/* A storage backend instance */
+typedef struct
+{
+    const char              *name;                                   /* STORE_BACKEND_* */
+    const ReadingStoreOps   *ops;                                    /* Backend operations */
+    void                    *impl;                                   /* Backend state */
+} ReadingStore;
+
+
+/**
+ * reading_store_open - Open a storage backend by name.
+ *
+ * @backend: STORE_BACKEND_SQLITE or STORE_BACKEND_TSDB.
+ * @db:      Open database; the SQLite backend writes Customer_Data through it.
+ * @dir:     Data directory of the time-series backend (ignored by SQLite).
+ * @store:   Receives the opened backend.
+ *
+ * Return: 0 on success, -1 on failure or unknown backend.
+ */
+int reading_store_open(const char *backend, sqlite3 *db, const char *dir, ReadingStore *store);
+
+
+/**
+ * reading_store_close - Flush and release a backend.
+ */
+void reading_store_close(ReadingStore *store);
+
+
+/* Convenience wrappers around the operations table */
+static inline int reading_store_append(ReadingStore *store, const StoredReading *reading)
+{
+    return store->ops->append(store->impl, reading);
+}
+
+static inline int reading_store_flush(ReadingStore *store)
+{
+    return store->ops->flush(store->impl);
+}
+
+static inline void reading_store_discard(ReadingStore *store)
+{
+    if (store->ops->discard)
+    {
+        store->ops->discard(store->impl);
+    }
+}
+
+static inline long reading_store_query(ReadingStore *store, int64_t sensor_id, int64_t from, int64_t to,
+                                       reading_visitor_t visitor, void *ctx)
+{
+    return store->ops->query(store->impl, sensor_id, from, to, visitor, ctx);
+}
+
+static inline int reading_store_compact(ReadingStore *store)
+{
+    return store->ops->compact ? store->ops->compact(store->impl) : 0;
+}
+
+
+/* Backend constructors (used by reading_store_open) */
+int store_sqlite_open(sqlite3 *db, ReadingStore *store);
+int store_tsdb_open(const char *dir, ReadingStore *store);
+
+
+#endif  /* READING_STORE_H */
@@ -0,0 +1,84 @@
+#ifndef RECORD_READER_H
+#define RECORD_READER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+
+#define RECORD_DELIMITER       '\n'                                  /* Records on the FIFO are newline framed */
+#define RECORD_READER_CAPACITY (64 * 1024)                           /* Matches the default Linux pipe capacity */
+#define FIFO_PIPE_SIZE         (64 * 1024)                           /* Requested pipe size (F_SETPIPE_SZ) */
+
+
+/**
+ * record_handler_t - Callback invoked once per complete record.
+ *
+ * @record: The record, NUL-terminated in place (delimiter stripped).
+ * @len:    Length of the record in bytes, not counting the terminator.
+ * @ctx:    Opaque pointer passed through from record_reader_drain().
+ */
+typedef void (*record_handler_t)(char *record, size_t len, void *ctx);
+
+
+/* Buffered reader that frames a byte stream into delimited records */
+typedef struct
+{
+    int     fd;                                                      /* Source descriptor (FIFO) */
+    size_t  head;                                                    /* Offset of the first unconsumed byte */
+    size_t  tail;                                                    /* Offset one past the last buffered byte */
+    int     discarding;                                              /* Skipping the rest of an oversized record */
+    size_t  records;                                                 /* Complete records delivered */
+    size_t  oversized;                                               /* Records dropped for exceeding capacity */
+    char    buf[RECORD_READER_CAPACITY + 1];                         /* Chunk buffer (+1 for the terminator) */
+} RecordReader;
+
+
+/**
+ * record_reader_init - Prepare a reader for the given descriptor.
+ *
+ * @reader: Reader to initialize.
+ * @fd:     Descriptor to read from.
+ */
+void record_reader_init(RecordReader *reader, int fd);
+
+
+/**
+ * record_reader_fill - Read as many bytes as fit into the free buffer space.
+ *
+ * Any partial record left from the previous call is moved to the front of
+ * the buffer first, so one read() always pulls the largest possible chunk.
+ *
+ * @reader: Reader to fill.
+ *
+ * Return: bytes read, 0 on EOF, -1 on error (errno is set, EINTR when a
+ * signal interrupted the read).
+ */
+ssize_t record_reader_fill(RecordReader *reader);
+
+
+/**
+ * record_reader_drain - Deliver every complete record currently buffered.
+ *
+ * A trailing partial record stays in the buffer until the next fill. A
+ * record that does not fit into the buffer at all is dropped up to its
+ * next delimiter and counted in @reader->oversized.
+ *
+ * @reader:  Reader to drain.
+ * @handler: Callback invoked for each record.
+ * @ctx:     Opaque pointer passed to @handler.
+ *
+ * Return: number of records delivered.
+ */
+size_t record_reader_drain(RecordReader *reader, record_handler_t handler, void *ctx);
+
+
+/**
+ * record_reader_reset - Drop buffered bytes, e.g. after the writer went away.
+ *
+ * @reader: Reader to reset.
+ * @fd:     New descriptor to read from.
+ */
+void record_reader_reset(RecordReader *reader, int fd);
+
+
+#endif  /* RECORD_READER_H */
@@ -0,0 +1,108 @@
+#ifndef RECORD_RING_H
+#define RECORD_RING_H
+
+#include "record_reader.h"                                           /* record_handler_t */
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define RECORD_RING_KEY        0x1234                                /* SysV shm key of out_server, out_giis, out_listener */
+#define RECORD_RING_SLOTS      256                                   /* Records queued before out_server waits */
+#define RECORD_RING_RECORD_MAX 1024                                  /* Longest record, terminator included */
+#define RECORD_RING_MAGIC      0x52524e47                            /* "RRNG": the segment is initialized */
+#define RECORD_RING_FULL_WAIT_US 1000                                /* Poll interval while the ring is full */
+
+
+/*
+ * Records from out_server to out_giis. out_server is the only producer:
+ * its client threads push under shm_mutex. out_giis is the only consumer.
+ * head and tail count records from the start, a slot is [count % SLOTS].
+ */
+typedef struct
+{
+    uint32_t          magic;                                         /* RECORD_RING_MAGIC once initialized */
+    sem_t             pushed;                                        /* Posted once per record, process shared */
+    _Atomic uint32_t  head;                                          /* Records pushed */
+    _Atomic uint32_t  tail;                                          /* Records delivered */
+    uint32_t          len[RECORD_RING_SLOTS];
+    char              slots[RECORD_RING_SLOTS][RECORD_RING_RECORD_MAX];
+} RecordRing;
+
+
+/**
+ * record_ring_create - Create the ring, or attach to the one a previous
+ *                      out_server left with its records still queued.
+ *
+ * A segment of an older layout under RECORD_RING_KEY is removed first.
+ *
+ * Return: the ring, NULL on error (printed).
+ */
+RecordRing *record_ring_create(void);
+
+
+/**
+ * record_ring_attach - Attach to the ring out_server created.
+ *
+ * Return: the ring, NULL on error (printed).
+ */
+RecordRing *record_ring_attach(void);
+
+
+/**
+ * record_ring_detach - Detach from the ring, which stays for the other side.
+ *
+ * @ring: Ring to detach from.
+ */
+void record_ring_detach(RecordRing *ring);
+
+
+/**
+ * record_ring_push - Queue a record, waiting while the ring is full.
+ *
+ * A record longer than RECORD_RING_RECORD_MAX - 1 bytes is cut there.
+ * Callers serialize pushes.
+ *
+ * @ring:   Ring to push to.
+ * @record: Record, without a delimiter.
+ * @len:    Length of the record.
+ */
+void record_ring_push(RecordRing *ring, const char *record, size_t len);
+
+
+/**
+ * record_ring_wait - Wait until records are queued.
+ *
+ * Return: 0 when records may be queued, -1 on error (errno is set, EINTR
+ * when a signal interrupted the wait).
+ */
+int record_ring_wait(RecordRing *ring);
+
+
+/**
+ * record_ring_drain - Deliver every record queued, oldest first.
+ *
+ * Each record is NUL-terminated in its slot, which is handed back to the
+ * producer once @handler returns.
+ *
+ * @ring:    Ring to drain.
+ * @handler: Callback invoked for each record.
+ * @ctx:     Opaque pointer passed to @handler.
+ *
+ * Return: number of records delivered.
+ */
+size_t record_ring_drain(RecordRing *ring, record_handler_t handler, void *ctx);
+
+
+/**
+ * record_ring_queued - Records pushed and not delivered yet.
+ *
+ * @ring: Ring to look at.
+ *
+ * Return: number of records queued.
+ */
+uint32_t record_ring_queued(const RecordRing *ring);
+
+
+#endif  /* RECORD_RING_H */
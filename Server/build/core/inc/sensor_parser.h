@@ -0,0 +1,128 @@
+#ifndef SENSOR_PARSER_H
+#define SENSOR_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define MAC_STR_LEN            17                                    /* "xx:xx:xx:xx:xx:xx" */
+#define COORD_SCALE            100                                   /* Coordinates are fixed point, 1/100 units */
+#define COORD_MAX_INT_DIGITS   7                                     /* Keeps |value| * COORD_SCALE in int32 range */
+
+
+/* Result of parsing one reading line */
+typedef enum
+{
+    PARSE_OK = 0,                                                    /* Line parsed into a SensorReading */
+    PARSE_ERR_EMPTY,                                                 /* Empty or whitespace-only line */
+    PARSE_ERR_MAC,                                                   /* MAC address malformed */
+    PARSE_ERR_STATUS,                                                /* Status field missing or malformed */
+    PARSE_ERR_FIELD,                                                 /* Expected "x", "y" or "z" label missing */
+    PARSE_ERR_NUMBER,                                                /* Coordinate is not a decimal number */
+    PARSE_ERR_RANGE,                                                 /* Coordinate does not fit the fixed point range */
+    PARSE_ERR_SEQ,                                                   /* Sequence number malformed */
+    PARSE_ERR_TRAILING,                                              /* Unexpected characters after the last field */
+    PARSE_ERR_COUNT                                                  /* Number of result codes, keep last */
+} parse_status_t;
+
+
+/* One parsed sensor reading: "<mac>: <status>: x <x> y <y> z <z> [seq <n>] [trace ...]" */
+typedef struct
+{
+    uint64_t  mac;                                                   /* 48-bit MAC, first octet in the high byte */
+    uint64_t  seq;                                                   /* Per-sensor sequence number, 0 if absent */
+    int32_t   x;                                                     /* X coordinate * COORD_SCALE */
+    int32_t   y;                                                     /* Y coordinate * COORD_SCALE */
+    int32_t   z;                                                     /* Z coordinate * COORD_SCALE */
+    char      status;                                                /* Status character, e.g. 'D' or 'S' */
+    uint16_t  trace;                                                 /* Offset of the trace suffix, 0 if none */
+} SensorReading;
+
+
+/**
+ * parse_reading - Parse a single reading line.
+ *
+ * Replacement for sscanf(line, "%17s: %c: x %lf y %lf z %lf", ...). The MAC
+ * is decoded from its fixed 17 character layout and coordinates are parsed
+ * as fixed point decimals (no strtod, no locale). Digits beyond the second
+ * decimal place are rounded half away from zero. An optional trailing
+ * "seq <n>" field carries the gateway's per-sensor sequence number; an
+ * optional "trace ..." suffix after it (prk_trace.h) is located, not parsed.
+ *
+ * @line: Start of the line (need not be NUL-terminated).
+ * @len:  Length of the line, without the delimiter.
+ * @out:  Receives the parsed reading on PARSE_OK.
+ *
+ * Return: PARSE_OK or the first error encountered.
+ */
+parse_status_t parse_reading(const char *line, size_t len, SensorReading *out);
+
+
+/**
+ * parse_reading_batch - Parse a buffer holding many newline-separated lines.
+ *
+ * Line boundaries are located with the widest delimiter scanner the CPU
+ * supports (AVX2, SSE2 or scalar). Only complete lines are parsed; a trailing
+ * line without a delimiter is left for the caller. bench_sensor_parser
+ * compares it with parse_reading(); ingest frames records with
+ * record_reader.c, which uses the same scanner, and parses them one by one.
+ *
+ * @buf:       Buffer holding the lines.
+ * @len:       Length of @buf in bytes.
+ * @out:       Array receiving one SensorReading per line.
+ * @status:    Array receiving one parse_status_t per line.
+ * @max_lines: Capacity of @out and @status.
+ * @consumed:  Receives the number of bytes covered by the parsed lines.
+ *
+ * Return: number of lines parsed; @out[i] is valid where @status[i] == PARSE_OK.
+ */
+size_t parse_reading_batch(const char *buf, size_t len, SensorReading *out,
+                           parse_status_t *status, size_t max_lines, size_t *consumed);
+
+
+/**
+ * scan_delimiter - Find the first occurrence of @c in [@p, @end).
+ *
+ * Frames the FIFO records of the inserter and the client lines of
+ * out_server (record_reader.c).
+ *
+ * Return: pointer to the match, or @end if there is none.
+ */
+const char *scan_delimiter(const char *p, const char *end, char c);
+
+
+/**
+ * scan_delimiter_impl - Name of the scanner selected at runtime.
+ *
+ * Return: "avx2", "sse2" or "scalar".
+ */
+const char *scan_delimiter_impl(void);
+
+
+/**
+ * parse_mac - Decode a "xx:xx:xx:xx:xx:xx" string (exactly MAC_STR_LEN chars).
+ *
+ * @str: NUL-terminated MAC address.
+ * @mac: Receives the 48-bit MAC as stored in SensorReading.
+ *
+ * Return: 0 on success, -1 if @str is not a MAC address.
+ */
+int parse_mac(const char *str, uint64_t *mac);
+
+
+/**
+ * format_mac - Format a decoded MAC back to "xx:xx:xx:xx:xx:xx".
+ *
+ * @mac: 48-bit MAC as stored in SensorReading.
+ * @buf: Buffer of at least MAC_STR_LEN + 1 bytes.
+ */
+void format_mac(uint64_t mac, char *buf);
+
+
+/**
+ * parse_status_str - Human readable name of a parse_status_t.
+ */
+const char *parse_status_str(parse_status_t status);
+
+
+#endif  /* SENSOR_PARSER_H */
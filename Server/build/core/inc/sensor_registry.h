@@ -0,0 +1,90 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+
+#define SENSOR_REGISTRY_INITIAL_SLOTS  1024                          /* Initial hash table size, power of two */
+
+
+/* One hash slot: MAC address -> Sensors.id (id 0 marks an empty slot) */
+typedef struct
+{
+    uint64_t  mac;                                                   /* 48-bit MAC address */
+    int64_t   id;                                                    /* Sensors.id */
+} SensorSlot;
+
+
+/* In-memory MAC -> id cache in front of the Sensors table */
+typedef struct
+{
+    SensorSlot    *slots;                                            /* Open addressing, linear probing */
+    size_t        capacity;                                          /* Number of slots, power of two */
+    size_t        count;                                             /* Used slots */
+    size_t        hits;                                              /* Lookups served from memory */
+    size_t        misses;                                            /* Lookups that touched the database */
+    sqlite3       *db;                                               /* Database holding the Sensors table */
+    sqlite3_stmt  *select_stmt;                                      /* SELECT id FROM Sensors WHERE mac_address=? */
+    sqlite3_stmt  *insert_stmt;                                      /* INSERT INTO Sensors(mac_address) VALUES(?) */
+    uint64_t      *added;                                            /* Inserted by the open batch */
+    size_t        added_count;
+    size_t        added_capacity;
+} SensorRegistry;
+
+
+/**
+ * sensor_registry_init - Create the cache and preload it from Sensors.
+ *
+ * @registry: Registry to initialize.
+ * @db:       Open database containing the Sensors table.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int sensor_registry_init(SensorRegistry *registry, sqlite3 *db);
+
+
+/**
+ * sensor_registry_lookup - Resolve a MAC address to its Sensors.id.
+ *
+ * Served from memory when the sensor is known; otherwise the sensor is looked
+ * up in, or added to, the Sensors table and cached. A sensor added is part
+ * of the caller's transaction until sensor_registry_batch_done().
+ *
+ * @registry: Registry to query.
+ * @mac:      48-bit MAC address (see SensorReading).
+ *
+ * Return: sensor id (> 0), or -1 on database error.
+ */
+int64_t sensor_registry_lookup(SensorRegistry *registry, uint64_t mac);
+
+
+/**
+ * sensor_registry_batch_done - The batch that added the new sensors is committed.
+ *
+ * @registry: Registry.
+ */
+void sensor_registry_batch_done(SensorRegistry *registry);
+
+
+/**
+ * sensor_registry_rollback - Forget the sensors added since the last batch_done.
+ *
+ * Call after a rollback: their Sensors rows are gone and their ids may be
+ * given to other sensors, so they are registered again when they report.
+ *
+ * @registry: Registry.
+ */
+void sensor_registry_rollback(SensorRegistry *registry);
+
+
+/**
+ * sensor_registry_free - Release the cache and its prepared statements.
+ *
+ * @registry: Registry to release.
+ */
+void sensor_registry_free(SensorRegistry *registry);
+
+
+#endif  /* SENSOR_REGISTRY_H */
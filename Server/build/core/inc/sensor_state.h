@@ -0,0 +1,79 @@
+#ifndef SENSOR_STATE_H
+#define SENSOR_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "reading_store.h"
+#include "sensor_table.h"
+
+
+#define SENSOR_STATE_FLUSH_MS  500                                   /* Upsert changed sensors at most this often */
+
+
+/* Latest reading of one sensor, as last seen by the inserter */
+typedef struct
+{
+    int64_t   last_seen;                                             /* recv_time of the reading, 0 if none */
+    int32_t   x;                                                     /* X coordinate * COORD_SCALE */
+    int32_t   y;                                                     /* Y coordinate * COORD_SCALE */
+    int32_t   z;                                                     /* Z coordinate * COORD_SCALE */
+    char      status;                                                /* Status character */
+    int       dirty;                                                 /* Changed since the last flush */
+} SensorStateEntry;
+
+
+/* Latest state of all sensors, indexed by Sensors.id */
+typedef struct
+{
+    SensorTable       table;                                         /* SensorStateEntry; listed: changed sensors */
+    uint64_t          updates;                                       /* Readings applied */
+    uint64_t          upserts;                                       /* Rows written to Sensor_State */
+    sqlite3_stmt      *save_stmt;                                    /* Upsert into Sensor_State */
+} SensorState;
+
+
+/**
+ * sensor_state_init - Create the in-memory state and prepare the upsert.
+ *
+ * @state: State to initialize.
+ * @db:    Open database at schema version 5 or later.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int sensor_state_init(SensorState *state, sqlite3 *db);
+
+
+/**
+ * sensor_state_update - Record a stored reading as its sensor's latest state.
+ *
+ * Only memory is touched. A sensor updated many times between two flushes
+ * is written once, with its newest reading; an older reading than the one
+ * held is ignored.
+ *
+ * @state:   Sensor state.
+ * @reading: Reading just stored.
+ */
+void sensor_state_update(SensorState *state, const StoredReading *reading);
+
+
+/**
+ * sensor_state_flush - Upsert the sensors changed since the last flush.
+ *
+ * Call inside the transaction that stored the readings. The upsert keeps
+ * a stored row that is newer than the one written.
+ *
+ * @state: Sensor state.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int sensor_state_flush(SensorState *state);
+
+
+/**
+ * sensor_state_free - Release the state.
+ */
+void sensor_state_free(SensorState *state);
+
+
+#endif  /* SENSOR_STATE_H */
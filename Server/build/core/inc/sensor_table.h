@@ -0,0 +1,78 @@
+#ifndef SENSOR_TABLE_H
+#define SENSOR_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define SENSOR_TABLE_INITIAL   64                                    /* Entries, and listed ids, allocated first */
+
+
+/*
+ * Per-sensor state indexed directly by Sensors.id. Ids are small and
+ * dense, so an array beats a hash table; it grows by doubling and new
+ * entries are zeroed. Entries that need attention later (saving, a held
+ * candidate) are queued by id in listed[], at most once each: the caller
+ * keeps a flag in the entry and clears it when it drains the list.
+ */
+typedef struct
+{
+    void      *entries;                                              /* entry_size bytes per sensor id */
+    size_t    entry_size;
+    size_t    capacity;                                              /* Number of entries allocated */
+    int64_t   *listed;                                               /* Sensor ids queued by sensor_table_list() */
+    size_t    listed_count;                                          /* Used entries of listed */
+    size_t    listed_capacity;                                       /* Allocated entries of listed */
+} SensorTable;
+
+
+/**
+ * sensor_table_init - Create an empty table.
+ *
+ * @table:      Table to initialize.
+ * @entry_size: Size of one entry.
+ */
+void sensor_table_init(SensorTable *table, size_t entry_size);
+
+
+/**
+ * sensor_table_get - Entry of @sensor_id, growing the table when needed.
+ *
+ * Growing moves the entries: pointers from earlier calls are invalid.
+ *
+ * @table:     Table.
+ * @sensor_id: Sensors.id.
+ *
+ * Return: the entry, zeroed if new, or NULL if the id is not positive or
+ *         memory runs out.
+ */
+void *sensor_table_get(SensorTable *table, int64_t sensor_id);
+
+
+/**
+ * sensor_table_at - Entry of an id known to be in the table.
+ */
+static inline void *sensor_table_at(const SensorTable *table, int64_t sensor_id)
+{
+    return (char *)table->entries + (size_t)sensor_id * table->entry_size;
+}
+
+
+/**
+ * sensor_table_list - Queue @sensor_id in listed[].
+ *
+ * @table:     Table.
+ * @sensor_id: Sensors.id.
+ *
+ * Return: 0 on success, -1 if memory runs out (nothing queued).
+ */
+int sensor_table_list(SensorTable *table, int64_t sensor_id);
+
+
+/**
+ * sensor_table_free - Release the entries and the list.
+ */
+void sensor_table_free(SensorTable *table);
+
+
+#endif  /* SENSOR_TABLE_H */
@@ -6,31 +6,24 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <semaphore.h>
+#include "record_ring.h"
 
 
 #define SERVER_PORT            12345                                 /* Server port number */
-#define BUFFER_SIZE            1024                                  /* Buffer size for reading and writing data */
-#define SHM_KEY                0x1234                                /* Key for shared memory */
 #define MAX_CLIENTS            10                                    /* Maximum number of concurrent clients */
 #define VERSION                "1.1"                                 /* Server version */
 
 
-/* Shared memory structure */
-struct shared_data
-{
-    char data[BUFFER_SIZE];                                          /* Buffer to hold shared data */
-};
-
-
 /* Thread argument structure */
 struct thread_arg
 {
     int                csck;                                         /* Client socket descriptor */
     struct sockaddr_in caddr;                                        /* Client address structure */
+    RecordRing         *ring;                                        /* Shared memory, records for out_giis */
 };
 
 
-/* Mutex for shared memory synchronization */
+/* Mutex for shared memory synchronization: one record ring producer at a time */
 pthread_mutex_t shm_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
@@ -41,12 +34,13 @@ void signal_handler(int signum);
 /**
  * handle_client - Thread function to handle communication with a client.
  *
- * This function reads data from the client, prints it to the terminal,
- * and writes it to shared memory. It uses a mutex to synchronize access
- * to shared memory and signals a semaphore when the client has finished.
+ * This function reads data from the client, splits it into lines, prints
+ * them to the terminal and queues them in shared memory. A line split
+ * across two reads is kept until its end arrives. The semaphore is signaled
+ * when the client has finished.
  *
  * @arg: Pointer to a thread_arg structure containing the client socket
- *       descriptor and client address.
+ *       descriptor, client address and the record ring.
  *
  * Return: NULL.
  */
@@ -0,0 +1,47 @@
+#ifndef STORE_TSDB_H
+#define STORE_TSDB_H
+
+#include <stdint.h>
+
+
+#define TSDB_DIR               "tsdb"                                /* Default data directory */
+#define TSDB_BUCKET_MS         (60 * 60 * 1000LL)                    /* One chunk file per sensor per hour */
+#define TSDB_COMPACT_INTERVAL  30                                    /* Seconds between background compactions */
+#define TSDB_CHUNK_SUFFIX      ".chk"                                /* Append chunk, arrival order */
+#define TSDB_SEGMENT_SUFFIX    ".seg"                                /* Compacted segment, sorted by time */
+#define TSDB_MARKER_SUFFIX     ".cmp"                                /* Compaction in progress, see below */
+
+
+/*
+ * On-disk layout:
+ *      <dir>/<sensor_id>/<bucket>.chk    records appended as they arrive
+ *      <dir>/<sensor_id>/<bucket>.seg    records of a closed bucket, sorted
+ *      <dir>/<sensor_id>/<bucket>.cmp    TsdbMarker, while a compaction swaps
+ *                                        the merged segment in
+ * where bucket = recv_time / TSDB_BUCKET_MS. Both files are flat arrays of
+ * TsdbRecord; the record count is the file size / sizeof(TsdbRecord).
+ */
+typedef struct
+{
+    int64_t   recv_time;                                             /* Receive time, ms since the epoch */
+    int32_t   x;                                                     /* X coordinate * COORD_SCALE */
+    int32_t   y;                                                     /* Y coordinate * COORD_SCALE */
+    int32_t   z;                                                     /* Z coordinate * COORD_SCALE */
+    char      status;                                                /* Status character */
+    char      reserved[3];                                           /* Padding, zero */
+} TsdbRecord;
+
+
+/*
+ * Written before a merged segment is renamed over the old one and removed
+ * once the chunk is gone. On open, a segment of seg_count records means the
+ * rename happened and the chunk's records are already in it.
+ */
+typedef struct
+{
+    uint64_t  seg_count;                                             /* Records in the merged segment */
+    uint64_t  chk_count;                                             /* Of them, taken from the chunk */
+} TsdbMarker;
+
+
+#endif  /* STORE_TSDB_H */
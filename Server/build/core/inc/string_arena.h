@@ -0,0 +1,58 @@
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#include <stddef.h>
+
+
+#define STRING_ARENA_BLOCK     (64 * 1024)                           /* Default block size, in bytes */
+
+
+/* One block of an arena; strings are packed in data[] */
+typedef struct StringArenaBlock
+{
+    struct StringArenaBlock *next;                                   /* Previous block, NULL for the first */
+    size_t                  used;                                    /* Bytes of data[] taken */
+    size_t                  size;                                    /* Bytes of data[] */
+    char                    data[];
+} StringArenaBlock;
+
+
+/*
+ * Append-only store of NUL-terminated strings. Strings never move, so
+ * pointers to them stay valid until the arena is freed; the arena only
+ * grows by whole blocks, so it holds little more than the strings.
+ */
+typedef struct
+{
+    StringArenaBlock *head;                                          /* Block being filled, NULL when empty */
+    size_t           bytes;                                          /* Bytes of strings stored */
+} StringArena;
+
+
+/**
+ * string_arena_add - Copy @len bytes of @s into the arena, NUL-terminated.
+ *
+ * @arena: Arena, zero-initialized before the first call.
+ * @s:     Bytes to copy; need not be NUL-terminated.
+ * @len:   Number of bytes.
+ *
+ * Return: the stored string, or NULL on allocation failure.
+ */
+const char *string_arena_add(StringArena *arena, const char *s, size_t len);
+
+
+/**
+ * string_arena_join - Move every string of @src into @dst.
+ *
+ * The strings keep their addresses; @src is left empty.
+ */
+void string_arena_join(StringArena *dst, StringArena *src);
+
+
+/**
+ * string_arena_free - Release every block of the arena.
+ */
+void string_arena_free(StringArena *arena);
+
+
+#endif  /* STRING_ARENA_H */
@@ -0,0 +1,53 @@
+#ifndef TP_DUMP_H
+#define TP_DUMP_H
+
+#include "prk_tracepoint.h"
+#include <stddef.h>
+#include <stdio.h>
+
+
+#define TP_DUMP_SHM_DIR        "/dev/shm"                            /* Where the stage pages are listed */
+#define TP_DUMP_MAX_STAGES     64                                    /* Pages dumped at once */
+#define TP_DUMP_CALIBRATE_MS   100                                   /* Least time between the two clock pairs */
+
+
+/* Ticks of one page to CLOCK_MONOTONIC */
+typedef struct
+{
+    uint64_t  ticks;                                                 /* A tick count ... */
+    int64_t   ns;                                                    /* ... and the time it was taken */
+    double    ns_per_tick;
+} TpClock;
+
+
+/**
+ * tp_clock - Conversion of the ticks of a page to CLOCK_MONOTONIC.
+ *
+ * With a TSC, the rate comes from the pair the stage took when it opened
+ * the page and a pair taken now, waiting until TP_DUMP_CALIBRATE_MS have
+ * passed between them.
+ *
+ * @page:  Mapped page.
+ * @clock: Receives the conversion.
+ */
+void tp_clock(const PrkTpPage *page, TpClock *clock);
+
+
+/**
+ * tp_dump_page - Write the events of a page as Chrome trace events.
+ *
+ * One JSON object per event, each preceded by ",\n" but for the first of
+ * the file, plus a process_name metadata event with the stage name. The
+ * timestamps are CLOCK_MONOTONIC microseconds, so pages of stages on one
+ * host line up.
+ *
+ * @page:  Mapped page.
+ * @out:   Stream, inside the "traceEvents" array.
+ * @first: Set while nothing was written yet, cleared on the first event.
+ *
+ * Return: number of events written.
+ */
+size_t tp_dump_page(const PrkTpPage *page, FILE *out, int *first);
+
+
+#endif  /* TP_DUMP_H */
@@ -0,0 +1,49 @@
+#ifndef TRACE_REPORT_H
+#define TRACE_REPORT_H
+
+#include "prk_metrics.h"
+#include <stdio.h>
+
+
+#define TRACE_REPORT_STAGE     "inserter"                            /* Metrics page holding the trace histograms */
+#define TRACE_REPORT_PREFIX    "prk_trace_"                          /* Histograms reported */
+#define TRACE_REPORT_MAX       PRK_METRICS_MAX
+
+
+/* Buckets of one trace histogram at a point in time */
+typedef struct
+{
+    const PrkMetricDesc *desc;
+    uint64_t            count;
+    uint64_t            buckets[PRK_HISTOGRAM_BUCKETS];
+} TraceSnapshot;
+
+
+/**
+ * trace_snapshot - Read the trace histograms of a metrics page.
+ *
+ * @page:      Page of the stage holding them (TRACE_REPORT_STAGE).
+ * @snapshots: Receives one entry per histogram named TRACE_REPORT_PREFIX...
+ * @max:       Capacity of @snapshots.
+ *
+ * Return: number of entries filled.
+ */
+size_t trace_snapshot(const PrkMetricsPage *page, TraceSnapshot *snapshots, size_t max);
+
+
+/**
+ * trace_report - Print count, p50, p99 and p999 of each hop.
+ *
+ * One line per histogram, in milliseconds. With @before, only the values
+ * recorded since that snapshot are reported.
+ *
+ * @now:    Current snapshot.
+ * @before: Earlier snapshot of the same page, or NULL for everything since
+ *          the stage started.
+ * @count:  Entries in @now (and @before).
+ * @out:    Stream to print to.
+ */
+void trace_report(const TraceSnapshot *now, const TraceSnapshot *before, size_t count, FILE *out);
+
+
+#endif  /* TRACE_REPORT_H */
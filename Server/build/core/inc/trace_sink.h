@@ -0,0 +1,80 @@
+#ifndef TRACE_SINK_H
+#define TRACE_SINK_H
+
+#include "prk_metrics.h"
+#include "prk_trace.h"
+#include <stddef.h>
+
+
+#define TRACE_SINK_BATCH       4096                                  /* Traces waiting for their commit */
+
+
+/*
+ * Per hop latencies of the traced records stored by the inserter. A hop
+ * is the time between two consecutive stages of prk_trace_stage_t; a
+ * record that skipped a stage (e.g. it did not come from an STM32) still
+ * counts in the hops it did pass and in the end to end time.
+ */
+typedef struct
+{
+    int           enabled;                                           /* 0: traces are ignored (--replay) */
+    PrkTrace      *pending;                                          /* Stamped at parse, waiting for the commit */
+    size_t        pending_count;
+    PrkHistogram  hops[PRK_TRACE_STAGES];                            /* Index: stage the hop ends at, 0 unused */
+    PrkHistogram  end_to_end;                                        /* First stamp to the commit */
+    PrkCounter    traces;                                            /* Traced records folded */
+    PrkCounter    malformed;                                         /* Trace suffixes that did not parse */
+    PrkCounter    skewed;                                            /* Hops with a negative time, counted as 0 */
+    PrkCounter    overflow;                                          /* Traces dropped, batch full */
+} TraceSink;
+
+
+/**
+ * trace_sink_init - Register the trace metrics of the inserter.
+ *
+ * prk_trace_hop_seconds{hop="<from>-<to>"} for each hop and
+ * prk_trace_end_to_end_seconds, on the inserter's metrics page, where
+ * out_metrics_exporter and out_trace_report find them.
+ *
+ * @sink:    Sink to initialize.
+ * @enabled: 0 to ignore traces, e.g. when replaying old records.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+int trace_sink_init(TraceSink *sink, int enabled);
+
+
+/**
+ * trace_sink_add - Take the trace of a record being stored.
+ *
+ * Parses the suffix and stamps it PRK_TRACE_INS. The trace is folded by
+ * the next trace_sink_commit(), once the record is committed.
+ *
+ * @sink:   Trace sink.
+ * @suffix: Trace suffix of the record (see prk_trace_find()).
+ * @len:    Length of @suffix.
+ */
+void trace_sink_add(TraceSink *sink, const char *suffix, size_t len);
+
+
+/**
+ * trace_sink_commit - Stamp the pending traces PRK_TRACE_DB and record them.
+ *
+ * Call it right after the COMMIT of the batch holding their records.
+ */
+void trace_sink_commit(TraceSink *sink);
+
+
+/**
+ * trace_sink_discard - Drop the pending traces of a batch that was rolled back.
+ */
+void trace_sink_discard(TraceSink *sink);
+
+
+/**
+ * trace_sink_free - Release the pending traces.
+ */
+void trace_sink_free(TraceSink *sink);
+
+
+#endif  /* TRACE_SINK_H */
@@ -0,0 +1,140 @@
+#ifndef ZONE_MAP_H
+#define ZONE_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "point_in_polygon.h"
+
+
+#define ZONE_GRID_CELLS_PER_ZONE 4                                   /* Upper bound on grid cells per zone */
+#define ZONE_BATCH_CHUNK       4096                                  /* Points grouped per polygon pass */
+#define ZONE_SIMD_MIN_POINTS   4                                     /* Smaller groups use pip_contains() */
+
+
+/*
+ * One parking zone in fixed point coordinates: an axis-aligned rectangle,
+ * or a polygon (edge_count > 0) whose bounding box the rectangle holds.
+ */
+typedef struct
+{
+    int64_t   id;                                                    /* Zones.id */
+    int32_t   x_min;                                                 /* Inclusive, * COORD_SCALE */
+    int32_t   y_min;                                                 /* Inclusive, * COORD_SCALE */
+    int32_t   x_max;                                                 /* Exclusive, * COORD_SCALE */
+    int32_t   y_max;                                                 /* Exclusive, * COORD_SCALE */
+    uint32_t  first_edge;                                            /* Polygon: first of its ZoneMap.edges */
+    uint32_t  edge_count;                                            /* Polygon: number of edges, 0 for a rectangle */
+} Zone;
+
+
+/*
+ * All zones, loaded once from the Zones table, with a uniform grid index:
+ * the bounding box of the zones is cut into columns x rows square cells and
+ * each cell lists the zones overlapping it, so a lookup tests only the few
+ * zones of one cell. The edges of all polygons are stored in one array,
+ * each polygon's contiguous, and tested only for points inside its
+ * bounding box.
+ */
+typedef struct
+{
+    Zone        *zones;                                              /* In Zones.id order */
+    size_t      count;                                               /* Number of zones */
+    size_t      capacity;                                            /* Allocated zones */
+    PolygonEdge *edges;                                              /* Polygon edges of all zones */
+    size_t      edge_count;                                          /* Used edges */
+    size_t      edge_capacity;                                       /* Allocated edges */
+    int64_t     origin_x;                                            /* Lower left corner of the grid */
+    int64_t     origin_y;
+    int         cell_shift;                                          /* Cell edge is 1 << cell_shift, * COORD_SCALE */
+    uint32_t    columns;                                             /* Cells per row, 0 without an index */
+    uint32_t    rows;                                                /* Cells per column */
+    uint32_t    *cell_start;                                         /* columns * rows + 1 offsets into cell_zones */
+    uint32_t    *cell_zones;                                         /* Zone indexes per cell, ascending */
+} ZoneMap;
+
+
+/**
+ * zone_map_load - Load every zone from the Zones and Zone_Vertices tables.
+ *
+ * A zone with at least three vertices becomes that polygon, and its
+ * rectangle is replaced by the polygon's bounding box.
+ *
+ * @map: Map to fill.
+ * @db:  Open database at schema version 6 or later.
+ *
+ * Return: 0 on success, -1 on failure.
+ */
+int zone_map_load(ZoneMap *map, sqlite3 *db);
+
+
+/**
+ * zone_map_add_polygon - Append a polygon zone (before zone_map_build()).
+ *
+ * @map:   Zone map, zero-initialized or loaded.
+ * @id:    Zones.id of the new zone.
+ * @x:     @count vertex X coordinates * COORD_SCALE, in ring order.
+ * @y:     @count vertex Y coordinates * COORD_SCALE.
+ * @count: Number of vertices, at least 3.
+ *
+ * Return: 0 on success, -1 on a bad polygon or allocation failure.
+ */
+int zone_map_add_polygon(ZoneMap *map, int64_t id, const int32_t *x, const int32_t *y, size_t count);
+
+
+/**
+ * zone_map_build - Sort the zones by id and (re)build the grid index.
+ *
+ * Called by zone_map_load(); call it after filling map->zones by hand or
+ * with zone_map_add_polygon().
+ * The cell edge is the power of two at or above the mean zone edge,
+ * enlarged if needed to stay within ZONE_GRID_CELLS_PER_ZONE cells per
+ * zone, so a zone overlaps a few cells and a cell holds a few zones.
+ *
+ * @map: Map with zones and count set.
+ *
+ * Return: 0 on success, -1 on allocation failure (the map has no index).
+ */
+int zone_map_build(ZoneMap *map);
+
+
+/**
+ * zone_map_lookup - Zone containing the point (@x, @y).
+ *
+ * Tests the zones of the point's grid cell only: the rectangle, then for a
+ * polygon pip_contains(). When zones overlap, the one with the lowest id
+ * wins.
+ *
+ * @map: Zone map.
+ * @x:   X coordinate * COORD_SCALE.
+ * @y:   Y coordinate * COORD_SCALE.
+ *
+ * Return: Zones.id, or 0 if the point is outside every zone.
+ */
+int64_t zone_map_lookup(const ZoneMap *map, int32_t x, int32_t y);
+
+
+/**
+ * zone_map_lookup_batch - Zones containing @count points.
+ *
+ * Same result as zone_map_lookup() for each point. Polygons are tested
+ * per polygon instead of per point: the points of a ZONE_BATCH_CHUNK that
+ * fall in a polygon's bounding box are grouped and classified together by
+ * pip_classify(), one point per SIMD lane.
+ *
+ * @map:      Zone map.
+ * @x:        @count X coordinates * COORD_SCALE.
+ * @y:        @count Y coordinates * COORD_SCALE.
+ * @count:    Number of points.
+ * @zone_ids: Receives @count Zones.id, 0 for points outside every zone.
+ */
+void zone_map_lookup_batch(const ZoneMap *map, const int32_t *x, const int32_t *y, size_t count, int64_t *zone_ids);
+
+
+/**
+ * zone_map_free - Release the zones and the index.
+ */
+void zone_map_free(ZoneMap *map);
+
+
+#endif  /* ZONE_MAP_H */
@@ -0,0 +1,640 @@
+/**
+ * billing.c: Incremental billing of parking sessions
+ *
+ * Billing used to be an offline step joining every reading with Prices.
+ * This module follows the session of each sensor as its readings are
+ * stored: the first parked reading opens it, a departure, a move to
+ * another zone or BILLING_SESSION_TIMEOUT_MS of silence closes it, and the
+ * closed sessions are priced against an in-memory snapshot of Prices and
+ * written to Invoices with the batch that closed them. Each reading costs
+ * a few memory accesses; only sessions that close reach the database.
+ * Prices come from the shared price table (price_table.c) when one is
+ * published, so a new price applies from the next flush; a private table
+ * built from the database is the fallback. Either way a session costs a
+ * zone lookup and a few prefix sums of its compiled schedule. A session
+ * that started before its zone's price changed is billed at the price of
+ * its start, looked up in Price_History (price_history.c). The open
+ * sessions are mirrored in Billing_Sessions with the same batches, so a
+ * crash loses none of them.
+ *
+ * Version: v1.5
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            open sessions saved by each flush, failed invoices retried
+ *   19-10-2026       Morris              v1.2            prices from the shared price table
+ *   19-10-2026       Morris              v1.3            time-of-day and tiered rates (price_schedule.c)
+ *   19-10-2026       Morris              v1.4            price at the session start (price_history.c)
+ *   19-10-2026       Morris              v1.5            unpriced zones billed without Price_History
+ *
+ */
+
+#include "../inc/billing.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+#define POSITION_UNKNOWN       INT32_MIN                             /* Restored session: look the zone up again */
+
+
+/**
+ * session_at - Session of a sensor id already in the table.
+ */
+static inline BillingSession *session_at(const BillingEngine *engine, int64_t sensor_id)
+{
+    return sensor_table_at(&engine->sessions, sensor_id);
+}
+
+/**
+ * mark_dirty - Remember that the session of @sensor_id needs its row saved.
+ */
+static void mark_dirty(BillingEngine *engine, BillingSession *session, int64_t sensor_id)
+{
+    if (!session->dirty && sensor_table_list(&engine->sessions, sensor_id) == 0)
+    {
+        session->dirty = 1;                                          /* Else saved with a later change */
+    }
+}
+
+/**
+ * list_unlink - Take the session of @sensor_id out of the last_seen list.
+ */
+static void list_unlink(BillingEngine *engine, int64_t sensor_id)
+{
+    BillingSession *session = session_at(engine, sensor_id);
+
+    if (session->prev)
+    {
+        session_at(engine, session->prev)->next = session->next;
+    }
+    else
+    {
+        engine->oldest = session->next;
+    }
+    if (session->next)
+    {
+        session_at(engine, session->next)->prev = session->prev;
+    }
+    else
+    {
+        engine->newest = session->prev;
+    }
+    session->prev = session->next = 0;
+    engine->open--;
+}
+
+/**
+ * list_append - Put the session of @sensor_id at the newest end of the list.
+ */
+static void list_append(BillingEngine *engine, int64_t sensor_id)
+{
+    BillingSession *session = session_at(engine, sensor_id);
+
+    session->prev = engine->newest;
+    session->next = 0;
+    if (engine->newest)
+    {
+        session_at(engine, engine->newest)->next = sensor_id;
+    }
+    else
+    {
+        engine->oldest = sensor_id;
+    }
+    engine->newest = sensor_id;
+    engine->open++;
+}
+
+/**
+ * open_session - Start a session of @sensor_id in @zone_id at @start_ms.
+ */
+static void open_session(BillingEngine *engine, int64_t sensor_id, int64_t zone_id, int64_t start_ms,
+                         int64_t last_seen, int32_t x, int32_t y)
+{
+    BillingSession *session = session_at(engine, sensor_id);
+
+    session->start_ms  = start_ms;
+    session->last_seen = last_seen;
+    session->zone_id   = zone_id;
+    session->x         = x;
+    session->y         = y;
+    list_append(engine, sensor_id);
+    mark_dirty(engine, session, sensor_id);
+}
+
+/**
+ * close_session - End the session of @sensor_id at @end_ms and queue its invoice.
+ *
+ * Return: 0 on success, -1 if the session stays open (out of memory).
+ */
+static int close_session(BillingEngine *engine, int64_t sensor_id, int64_t end_ms, char closed_by)
+{
+    BillingSession *session = session_at(engine, sensor_id);
+
+    if (engine->closed_count == engine->closed_capacity)
+    {
+        size_t          capacity = engine->closed_capacity ? engine->closed_capacity * 2 : 64;
+        BillingClosed   *closed  = realloc(engine->closed, capacity * sizeof(BillingClosed));
+        if (!closed)
+        {
+            perror("realloc");
+            return -1;
+        }
+        engine->closed          = closed;
+        engine->closed_capacity = capacity;
+    }
+
+    engine->closed[engine->closed_count++] = (BillingClosed)
+    {
+        .sensor_id = sensor_id,
+        .zone_id   = session->zone_id,
+        .start_ms  = session->start_ms,
+        .end_ms    = end_ms,
+        .closed_by = closed_by,
+    };
+    list_unlink(engine, sensor_id);
+    session->start_ms = 0;
+    return 0;
+}
+
+/**
+ * load_prices - Rebuild the local price table from the database.
+ */
+static int load_prices(BillingEngine *engine, int64_t now_ms)
+{
+    PriceTableSource    source;
+    PriceTable          *prices = NULL;
+
+    engine->prices_loaded_ms = now_ms;                               /* Retry a failed load with the next period */
+    if (price_table_load(engine->db, &source) == 0)
+    {
+        prices = price_table_build(&source);
+        price_table_source_free(&source);
+    }
+    if (!prices)
+    {
+        fprintf(stderr, "Error loading the prices, keeping the previous ones\n");
+        return -1;
+    }
+
+    free(engine->local_prices);
+    engine->local_prices = prices;
+    return 0;
+}
+
+/**
+ * shared_prices - Current shared price table, or NULL when none is published.
+ */
+static const PriceTable *shared_prices(BillingEngine *engine, int64_t now_ms)
+{
+    if (!engine->shared_prices.control && now_ms - engine->shared_attach_ms >= BILLING_PRICE_REFRESH_MS)
+    {
+        engine->shared_attach_ms = now_ms;
+        price_table_attach(&engine->shared_prices, PRICE_TABLE_NAME);
+    }
+    return engine->shared_prices.control ? price_table_current(&engine->shared_prices) : NULL;
+}
+
+/**
+ * session_cost - Cost of a closed session at its zone's current price.
+ *
+ * Return: 1 with *amount and the *rate per unit set (the average one for a
+ * scheduled zone), 0 when the zone has no price.
+ */
+static int session_cost(const PriceTable *prices, const PriceTableEntry *entry, const BillingClosed *closed,
+                        double *amount, double *rate)
+{
+    if (!entry)
+    {
+        return 0;
+    }
+
+    int64_t duration = closed->end_ms - closed->start_ms;
+    *amount = price_table_cost(prices, entry, closed->start_ms, closed->end_ms);
+    *rate   = entry->price;
+    if (entry->schedule && duration > 0)
+    {
+        *rate = round(*amount * BILLING_PRICE_UNIT_MS / (double)duration * 100.0) / 100.0;
+    }
+    return 1;
+}
+
+/**
+ * needs_history - Whether a session is priced from Price_History.
+ *
+ * That is when its zone's flat price changed after the session started. A
+ * zone without a price is billed unpriced without a lookup. Schedules are
+ * not versioned: a scheduled zone is billed on its current schedule.
+ */
+static int needs_history(const PriceTableEntry *entry, const BillingClosed *closed)
+{
+    return entry && !entry->schedule && entry->valid_from > closed->start_ms;
+}
+
+/**
+ * price_history - Price_History index holding the change at @changed_ms.
+ *
+ * A history loaded once a price's valid_from was seen holds that change
+ * and every earlier one, so it is only reloaded for a later valid_from.
+ *
+ * Return: the index, or NULL when it could never be loaded.
+ */
+static const PriceHistory *price_history(BillingEngine *engine, int64_t changed_ms)
+{
+    if (changed_ms > engine->history_valid_from)
+    {
+        PriceHistory history;
+        if (price_history_load(engine->db, &history) == 0)
+        {
+            price_history_free(&engine->history);
+            engine->history            = history;
+            engine->history_valid_from = changed_ms;
+        }
+    }
+    return engine->history_valid_from ? &engine->history : NULL;
+}
+
+/**
+ * history_prices - Look the sessions needing it up in Price_History, in one batch.
+ *
+ * Return: the interval of each such session in closed order (NULL: no
+ * price), or NULL when the history is unavailable.
+ */
+static const PriceInterval **history_prices(BillingEngine *engine, const PriceTable *prices)
+{
+    if (engine->history_capacity < engine->closed_count)
+    {
+        PriceHistoryQuery   *queries = realloc(engine->history_queries,
+                                               engine->closed_count * sizeof(PriceHistoryQuery));
+        if (queries)
+        {
+            engine->history_queries = queries;
+        }
+        const PriceInterval **results = realloc(engine->history_results,
+                                                engine->closed_count * sizeof(PriceInterval *));
+        if (results)
+        {
+            engine->history_results = results;
+        }
+        if (!queries || !results)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        engine->history_capacity = engine->closed_count;
+    }
+
+    size_t  count      = 0;
+    int64_t changed_ms = 0;
+    for (size_t i = 0; i < engine->closed_count; i++)
+    {
+        const BillingClosed     *closed = &engine->closed[i];
+        const PriceTableEntry   *entry  = prices ? price_table_find_zone(prices, closed->zone_id) : NULL;
+        if (needs_history(entry, closed))
+        {
+            engine->history_queries[count++] = (PriceHistoryQuery){ closed->zone_id, closed->start_ms };
+            changed_ms = entry->valid_from > changed_ms ? entry->valid_from : changed_ms;
+        }
+    }
+    if (count == 0)
+    {
+        return engine->history_results;
+    }
+
+    const PriceHistory *history = price_history(engine, changed_ms);
+    if (!history || price_history_find_batch(history, engine->history_queries, count, engine->history_results) != 0)
+    {
+        return NULL;
+    }
+    return engine->history_results;
+}
+
+/**
+ * save_sessions - Save the listed open sessions in Billing_Sessions.
+ */
+static int save_sessions(BillingEngine *engine)
+{
+    int rc = 0;
+
+    for (size_t i = 0; i < engine->sessions.listed_count; i++)
+    {
+        int64_t         id      = engine->sessions.listed[i];
+        BillingSession  *session = session_at(engine, id);
+
+        session->dirty = 0;
+        if (!session->start_ms)
+        {
+            continue;                                                /* Closed since: its row went with the invoice */
+        }
+        sqlite3_bind_int64(engine->save_stmt, 1, id);
+        sqlite3_bind_int64(engine->save_stmt, 2, session->zone_id);
+        sqlite3_bind_int64(engine->save_stmt, 3, session->start_ms);
+        sqlite3_bind_int64(engine->save_stmt, 4, session->last_seen);
+        if (sqlite3_step(engine->save_stmt) != SQLITE_DONE)
+        {
+            fprintf(stderr, "Error saving the session of sensor %lld\n", (long long)id);
+            rc = -1;
+        }
+        sqlite3_reset(engine->save_stmt);
+    }
+    engine->sessions.listed_count = 0;
+
+    return rc;
+}
+
+/**
+ * restore_sessions - Reopen the sessions saved in Billing_Sessions.
+ *
+ * A row is saved when its session opens, so the sensor's newest reading,
+ * in Sensor_State, gives its last_seen after a crash.
+ */
+static int restore_sessions(BillingEngine *engine, sqlite3 *db)
+{
+    sqlite3_stmt *stmt = prk_db_prepare(db,
+        "SELECT b.sensor_id, b.zone_id, b.start_ms, MAX(b.last_seen, COALESCE(s.last_seen, 0)) AS seen "
+        "FROM Billing_Sessions b LEFT JOIN Sensor_State s ON s.sensor_id = b.sensor_id ORDER BY seen;");
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        int64_t         sensor_id = sqlite3_column_int64(stmt, 0);
+        BillingSession  *session  = sensor_table_get(&engine->sessions, sensor_id);
+        if (session)
+        {
+            open_session(engine, sensor_id, sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2),
+                         sqlite3_column_int64(stmt, 3), POSITION_UNKNOWN, POSITION_UNKNOWN);
+            session->dirty = 0;
+        }
+    }
+    sqlite3_finalize(stmt);
+    engine->sessions.listed_count = 0;                               /* Their rows are up to date */
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Reading Billing_Sessions failed: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * billing_init - Load the prices and the sessions left open by the last run.
+ */
+int billing_init(BillingEngine *engine, sqlite3 *db, const ZoneMap *zones)
+{
+    memset(engine, 0, sizeof(*engine));
+    sensor_table_init(&engine->sessions, sizeof(BillingSession));
+    engine->db    = db;
+    engine->zones = zones;
+
+    engine->invoice_stmt = prk_db_prepare(db,
+        "INSERT INTO Invoices (sensor_id, zone_id, start_ms, end_ms, price, amount, closed_by) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?);");
+    engine->save_stmt = prk_db_prepare(db,
+        "INSERT OR REPLACE INTO Billing_Sessions (sensor_id, zone_id, start_ms, last_seen) VALUES (?, ?, ?, ?);");
+    engine->forget_stmt = prk_db_prepare(db, "DELETE FROM Billing_Sessions WHERE sensor_id = ?;");
+    if (!engine->invoice_stmt || !engine->save_stmt || !engine->forget_stmt)
+    {
+        billing_free(engine);
+        return -1;
+    }
+
+    if (load_prices(engine, 0) != 0 || restore_sessions(engine, db) != 0)
+    {
+        billing_free(engine);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * billing_update - Apply a stored reading to its sensor's session.
+ */
+void billing_update(BillingEngine *engine, const StoredReading *reading)
+{
+    BillingSession *session = sensor_table_get(&engine->sessions, reading->sensor_id);
+    if (!session || (session->start_ms && reading->recv_time < session->last_seen))
+    {
+        return;
+    }
+
+    if (reading->status != 'S')
+    {
+        if (session->start_ms)
+        {
+            close_session(engine, reading->sensor_id, reading->recv_time, BILLING_CLOSED_DEPARTED);
+        }
+        return;
+    }
+
+    if (session->start_ms)
+    {
+        if (reading->x != session->x || reading->y != session->y)
+        {
+            int64_t zone_id = zone_map_lookup(engine->zones, reading->x, reading->y);
+            if (zone_id != session->zone_id)
+            {
+                if (close_session(engine, reading->sensor_id, reading->recv_time, BILLING_CLOSED_MOVED) != 0)
+                {
+                    return;
+                }
+                open_session(engine, reading->sensor_id, zone_id, reading->recv_time, reading->recv_time,
+                             reading->x, reading->y);
+                engine->opened++;
+                return;
+            }
+            session->x = reading->x;
+            session->y = reading->y;
+        }
+
+        /* Still parked: the session becomes the newest of the list */
+        session->last_seen = reading->recv_time;
+        if (engine->newest != reading->sensor_id)
+        {
+            list_unlink(engine, reading->sensor_id);
+            list_append(engine, reading->sensor_id);
+        }
+        return;
+    }
+
+    open_session(engine, reading->sensor_id, zone_map_lookup(engine->zones, reading->x, reading->y),
+                 reading->recv_time, reading->recv_time, reading->x, reading->y);
+    engine->opened++;
+}
+
+/**
+ * billing_due - Whether billing_flush() has work at @now_ms.
+ */
+int billing_due(const BillingEngine *engine, int64_t now_ms)
+{
+    return engine->closed_count > 0 || engine->sessions.listed_count > 0 ||
+           (engine->oldest && now_ms - session_at(engine, engine->oldest)->last_seen >= BILLING_SESSION_TIMEOUT_MS);
+}
+
+/**
+ * billing_flush - Close the timed out sessions and write the invoices.
+ */
+int billing_flush(BillingEngine *engine, int64_t now_ms)
+{
+    int rc = 0;
+
+    while (engine->oldest && now_ms - session_at(engine, engine->oldest)->last_seen >= BILLING_SESSION_TIMEOUT_MS)
+    {
+        if (close_session(engine, engine->oldest, session_at(engine, engine->oldest)->last_seen,
+                          BILLING_CLOSED_TIMEOUT) != 0)
+        {
+            break;                                                   /* Out of memory, retried with the next flush */
+        }
+        engine->timeouts++;
+    }
+
+    if (engine->closed_count == 0)
+    {
+        return save_sessions(engine);
+    }
+    const PriceTable *prices = shared_prices(engine, now_ms);
+    if (!prices && now_ms - engine->prices_loaded_ms >= BILLING_PRICE_REFRESH_MS)
+    {
+        load_prices(engine, now_ms);
+    }
+    if (!prices)
+    {
+        prices = engine->local_prices;
+    }
+
+    /* Sessions that started under another price are priced from the history, in one batch */
+    const PriceInterval **intervals = history_prices(engine, prices);
+    size_t              query       = 0;
+    size_t              kept        = 0;
+
+    sqlite3_stmt *stmt = engine->invoice_stmt;
+    for (size_t i = 0; i < engine->closed_count; i++)
+    {
+        const BillingClosed     *closed = &engine->closed[i];
+        const PriceTableEntry   *entry  = closed->zone_id && prices ? price_table_find_zone(prices, closed->zone_id) :
+                                          NULL;
+        double                  amount  = 0.0, rate = 0.0;
+        int                     priced  = 0;
+
+        if (needs_history(entry, closed))
+        {
+            const PriceInterval *interval = intervals ? intervals[query] : NULL;
+            query++;
+            if (interval)
+            {
+                rate   = interval->price;
+                amount = rate * (double)(closed->end_ms - closed->start_ms) / BILLING_PRICE_UNIT_MS;
+                priced = 1;
+            }
+        }
+        else
+        {
+            priced = session_cost(prices, entry, closed, &amount, &rate);
+        }
+
+        sqlite3_bind_int64(stmt, 1, closed->sensor_id);
+        if (closed->zone_id)
+        {
+            sqlite3_bind_int64(stmt, 2, closed->zone_id);
+        }
+        else
+        {
+            sqlite3_bind_null(stmt, 2);
+        }
+        sqlite3_bind_int64(stmt, 3, closed->start_ms);
+        sqlite3_bind_int64(stmt, 4, closed->end_ms);
+        if (priced)
+        {
+            sqlite3_bind_double(stmt, 5, rate);
+            sqlite3_bind_double(stmt, 6, round(amount * 100.0) / 100.0);
+        }
+        else
+        {
+            sqlite3_bind_null(stmt, 5);
+            sqlite3_bind_null(stmt, 6);
+        }
+        sqlite3_bind_text(stmt, 7, &closed->closed_by, 1, SQLITE_TRANSIENT);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            fprintf(stderr, "Error writing the invoice of sensor %lld: %s\n", (long long)closed->sensor_id,
+                    sqlite3_errmsg(engine->db));
+            sqlite3_reset(stmt);
+            engine->closed[kept++] = *closed;                        /* Retried by the next flush, its row kept */
+            rc = -1;
+            continue;
+        }
+        sqlite3_reset(stmt);
+        engine->invoiced++;
+        engine->repriced += needs_history(entry, closed) && priced;
+        engine->unpriced += !priced;
+
+        /* Billed: a restart must not reopen it */
+        sqlite3_bind_int64(engine->forget_stmt, 1, closed->sensor_id);
+        if (sqlite3_step(engine->forget_stmt) != SQLITE_DONE)
+        {
+            fprintf(stderr, "Error forgetting the session of sensor %lld\n", (long long)closed->sensor_id);
+            rc = -1;
+        }
+        sqlite3_reset(engine->forget_stmt);
+    }
+    engine->closed_count = kept;
+
+    if (save_sessions(engine) != 0)
+    {
+        rc = -1;
+    }
+    return rc;
+}
+
+/**
+ * billing_save - Store the open sessions in Billing_Sessions (shutdown).
+ */
+int billing_save(BillingEngine *engine)
+{
+    int rc = 0;
+
+    for (int64_t id = engine->oldest; id; id = session_at(engine, id)->next)
+    {
+        const BillingSession *session = session_at(engine, id);
+
+        sqlite3_bind_int64(engine->save_stmt, 1, id);
+        sqlite3_bind_int64(engine->save_stmt, 2, session->zone_id);
+        sqlite3_bind_int64(engine->save_stmt, 3, session->start_ms);
+        sqlite3_bind_int64(engine->save_stmt, 4, session->last_seen);
+        if (sqlite3_step(engine->save_stmt) != SQLITE_DONE)
+        {
+            fprintf(stderr, "Error saving the session of sensor %lld\n", (long long)id);
+            rc = -1;
+        }
+        sqlite3_reset(engine->save_stmt);
+    }
+
+    return rc;
+}
+
+/**
+ * billing_free - Release the engine.
+ */
+void billing_free(BillingEngine *engine)
+{
+    price_table_detach(&engine->shared_prices);
+    sqlite3_finalize(engine->invoice_stmt);
+    sqlite3_finalize(engine->save_stmt);
+    sqlite3_finalize(engine->forget_stmt);
+    sensor_table_free(&engine->sessions);
+    free(engine->closed);
+    free(engine->local_prices);
+    price_history_free(&engine->history);
+    free(engine->history_queries);
+    free(engine->history_results);
+    memset(engine, 0, sizeof(*engine));
+}
@@ -0,0 +1,412 @@
+/**
+ * dead_letter.c: Dead-letter sink for records the inserter rejects
+ *
+ * Instead of printing every malformed line to stderr, rejected records are
+ * counted per reason and per source, buffered and appended to a bounded
+ * binary log. A single rate-limited stderr line reports rejections, so a
+ * gateway sending garbage costs a counter update and a memcpy per record.
+ * The log can be replayed through the inserter once the cause is fixed.
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            remove replayed logs, pick up unfinished replays
+ *
+ */
+
+#include "../inc/dead_letter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/* Names of the reasons after the parse_status_t range */
+static const char *reason_names[DLQ_REASON_COUNT - PARSE_ERR_COUNT] =
+{
+    [DLQ_REASON_SENSOR - PARSE_ERR_COUNT] = "unknown sensor",
+    [DLQ_REASON_STORE - PARSE_ERR_COUNT]  = "store failed",
+};
+
+
+/**
+ * now_ms - Wall clock in milliseconds.
+ */
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * record_source - MAC address at the start of a raw record, 0 if unreadable.
+ */
+static uint64_t record_source(const char *record, size_t len)
+{
+    char        str[MAC_STR_LEN + 1];
+    uint64_t    mac;
+
+    if (len < MAC_STR_LEN)
+    {
+        return 0;
+    }
+    memcpy(str, record, MAC_STR_LEN);
+    str[MAC_STR_LEN] = '\0';
+    return parse_mac(str, &mac) == 0 ? mac : 0;
+}
+
+/**
+ * source_slot - Counter slot of @mac, NULL if the table is full.
+ */
+static DeadLetterSource *source_slot(DeadLetter *dlq, uint64_t mac)
+{
+    size_t i = (size_t)((mac * 0x9e3779b97f4a7c15ull) >> 56) % DLQ_SOURCE_SLOTS;
+
+    for (size_t probe = 0; probe < DLQ_SOURCE_SLOTS; probe++, i = (i + 1) % DLQ_SOURCE_SLOTS)
+    {
+        DeadLetterSource *slot = &dlq->sources[i];
+        if (!slot->used)
+        {
+            slot->used = 1;
+            slot->mac  = mac;
+            return slot;
+        }
+        if (slot->mac == mac)
+        {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * write_all - write() the whole buffer.
+ */
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len  -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * open_log - (Re)open the log file and pick up its size.
+ */
+static int open_log(DeadLetter *dlq)
+{
+    struct stat st;
+
+    dlq->fd = open(dlq->path, O_WRONLY | O_CREAT | O_APPEND, 0664);
+    if (dlq->fd == -1)
+    {
+        fprintf(stderr, "Error opening dead-letter log %s: %s\n", dlq->path, strerror(errno));
+        return -1;
+    }
+    dlq->file_size = (fstat(dlq->fd, &st) == 0) ? (size_t)st.st_size : 0;
+    return 0;
+}
+
+
+/**
+ * dead_letter_open - Open (or create) the dead-letter log.
+ */
+int dead_letter_open(DeadLetter *dlq, const char *path)
+{
+    memset(dlq, 0, sizeof(*dlq));
+    snprintf(dlq->path, sizeof(dlq->path), "%s", path);
+    return open_log(dlq);
+}
+
+/**
+ * dead_letter_reject - Record one rejected raw record.
+ */
+void dead_letter_reject(DeadLetter *dlq, const char *record, size_t len, unsigned reason)
+{
+    if (reason >= DLQ_REASON_COUNT)
+    {
+        reason = PARSE_OK;                                           /* Should not happen; keep it countable */
+    }
+
+    /* Counters */
+    dlq->total++;
+    dlq->reasons[reason]++;
+
+    DeadLetterSource *source = source_slot(dlq, record_source(record, len));
+    if (source)
+    {
+        source->count++;
+        source->last_reason = (uint8_t)reason;
+    }
+    else
+    {
+        dlq->other_sources++;
+    }
+
+    /* Buffer the record for the log */
+    DeadLetterHeader header =
+    {
+        .magic     = DLQ_MAGIC,
+        .len       = (uint16_t)(len > DLQ_RECORD_MAX ? DLQ_RECORD_MAX : len),
+        .reason    = (uint8_t)reason,
+        .truncated = len > DLQ_RECORD_MAX,
+        .time_ms   = now_ms(),
+    };
+    if (dlq->buffered + sizeof(header) + header.len > sizeof(dlq->buffer))
+    {
+        dead_letter_flush(dlq);
+    }
+    memcpy(dlq->buffer + dlq->buffered, &header, sizeof(header));
+    memcpy(dlq->buffer + dlq->buffered + sizeof(header), record, header.len);
+    dlq->buffered += sizeof(header) + header.len;
+
+    /* Rate-limited report */
+    dlq->suppressed++;
+    if (header.time_ms - dlq->last_report_ms >= DLQ_REPORT_INTERVAL_MS)
+    {
+        fprintf(stderr, "Dead-lettered %llu record(s) (%llu total), last (%s): %.*s\n",
+                (unsigned long long)dlq->suppressed, (unsigned long long)dlq->total,
+                dead_letter_reason_str(reason), (int)(len > 80 ? 80 : len), record);
+        dlq->suppressed     = 0;
+        dlq->last_report_ms = header.time_ms;
+    }
+}
+
+/**
+ * dead_letter_flush - Write buffered records to the log.
+ */
+int dead_letter_flush(DeadLetter *dlq)
+{
+    if (dlq->buffered == 0)
+    {
+        return 0;
+    }
+
+    /* Bounded log: keep one previous generation */
+    if (dlq->fd != -1 && dlq->file_size + dlq->buffered > DLQ_MAX_BYTES)
+    {
+        char rotated[sizeof(dlq->path) + 2];
+        snprintf(rotated, sizeof(rotated), "%s.1", dlq->path);
+        close(dlq->fd);
+        rename(dlq->path, rotated);
+        open_log(dlq);
+    }
+
+    int rc = 0;
+    if (dlq->fd == -1 || write_all(dlq->fd, dlq->buffer, dlq->buffered) != 0)
+    {
+        /* Count what was lost, the counters above are still accurate */
+        for (size_t off = 0; off < dlq->buffered; )
+        {
+            const DeadLetterHeader *header = (const DeadLetterHeader *)(dlq->buffer + off);
+            dlq->dropped++;
+            off += sizeof(*header) + header->len;
+        }
+        rc = -1;
+    }
+    else
+    {
+        dlq->file_size += dlq->buffered;
+    }
+    dlq->buffered = 0;
+    return rc;
+}
+
+/**
+ * dead_letter_print - Print per-reason and per-source counters.
+ */
+void dead_letter_print(const DeadLetter *dlq, FILE *out)
+{
+    fprintf(out, "Dead letters: %llu total, %llu not logged\n",
+            (unsigned long long)dlq->total, (unsigned long long)dlq->dropped);
+    if (dlq->total == 0)
+    {
+        return;
+    }
+
+    for (unsigned reason = 0; reason < DLQ_REASON_COUNT; reason++)
+    {
+        if (dlq->reasons[reason])
+        {
+            fprintf(out, "  reason %-16s %llu\n", dead_letter_reason_str(reason),
+                    (unsigned long long)dlq->reasons[reason]);
+        }
+    }
+
+    for (size_t i = 0; i < DLQ_SOURCE_SLOTS; i++)
+    {
+        const DeadLetterSource *source = &dlq->sources[i];
+        if (!source->used)
+        {
+            continue;
+        }
+
+        char mac[MAC_STR_LEN + 1] = "unknown";
+        if (source->mac)
+        {
+            format_mac(source->mac, mac);
+        }
+        fprintf(out, "  source %-17s %llu (last: %s)\n", mac, (unsigned long long)source->count,
+                dead_letter_reason_str(source->last_reason));
+    }
+    if (dlq->other_sources)
+    {
+        fprintf(out, "  source %-17s %llu\n", "other", (unsigned long long)dlq->other_sources);
+    }
+}
+
+/**
+ * dead_letter_close - Flush and close the log.
+ */
+void dead_letter_close(DeadLetter *dlq)
+{
+    dead_letter_flush(dlq);
+    if (dlq->fd != -1)
+    {
+        close(dlq->fd);
+        dlq->fd = -1;
+    }
+}
+
+/**
+ * dead_letter_reason_str - Human readable name of a reason code.
+ */
+const char *dead_letter_reason_str(unsigned reason)
+{
+    if (reason < PARSE_ERR_COUNT)
+    {
+        return parse_status_str((parse_status_t)reason);
+    }
+    if (reason < DLQ_REASON_COUNT)
+    {
+        return reason_names[reason - PARSE_ERR_COUNT];
+    }
+    return "unknown";
+}
+
+/**
+ * replay_file - Feed every record of one log file to @handler.
+ *
+ * A corrupt tail ends the pass like the end of the file does.
+ *
+ * Return: number of records replayed, or -1 if the file cannot be read.
+ */
+static long replay_file(const char *path, dead_letter_replay_handler_t handler, void *ctx)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    const char *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+
+    long    replayed = 0;
+    size_t  size     = (size_t)st.st_size;
+    char    record[DLQ_RECORD_MAX + 1];
+
+    for (size_t off = 0; off + sizeof(DeadLetterHeader) <= size; )
+    {
+        DeadLetterHeader header;
+        memcpy(&header, map + off, sizeof(header));
+        if (header.magic != DLQ_MAGIC || header.len > DLQ_RECORD_MAX ||
+            off + sizeof(header) + header.len > size)
+        {
+            fprintf(stderr, "Dead-letter log %s is corrupt at offset %zu\n", path, off);
+            break;
+        }
+
+        memcpy(record, map + off + sizeof(header), header.len);
+        record[header.len] = '\0';
+        handler(record, header.len, &header, ctx);
+        replayed++;
+        off += sizeof(header) + header.len;
+    }
+
+    munmap((void *)map, size);
+    return replayed;
+}
+
+/**
+ * dead_letter_replay - Feed every record of a dead-letter log to @handler.
+ */
+long dead_letter_replay(DeadLetter *dlq, const char *path, dead_letter_replay_handler_t handler, void *ctx)
+{
+    char replay_path[512];
+    long replayed = 0;
+    snprintf(replay_path, sizeof(replay_path), "%s.replay", path);
+
+    /* A replay that did not finish left its records here: take them first, the rename would lose them */
+    if (access(replay_path, F_OK) == 0)
+    {
+        replayed = replay_file(replay_path, handler, ctx);
+        if (replayed < 0)
+        {
+            return -1;
+        }
+        unlink(replay_path);
+    }
+
+    if (rename(path, replay_path) != 0)
+    {
+        if (errno == ENOENT && replayed > 0)
+        {
+            return replayed;                                         /* Only the leftover to replay */
+        }
+        fprintf(stderr, "Error renaming %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    /* The sink's descriptor followed the rename: start a fresh log */
+    if (strcmp(path, dlq->path) == 0)
+    {
+        dead_letter_flush(dlq);
+        if (dlq->fd != -1)
+        {
+            close(dlq->fd);
+        }
+        open_log(dlq);
+    }
+
+    long n = replay_file(replay_path, handler, ctx);
+    if (n < 0)
+    {
+        return -1;                                                   /* Kept, replayed first next time */
+    }
+    unlink(replay_path);
+
+    return replayed + n;
+}
@@ -0,0 +1,244 @@
+/**
+ * dedup_window.c: Per-sensor duplicate suppression by sequence number
+ *
+ * Gateways number their readings with a per-sensor, strictly increasing
+ * sequence number. giis re-emits shared memory content and gateways resend
+ * their last readings after a reconnect, so the same reading can arrive more
+ * than once. For every sensor this module keeps the highest number seen and
+ * a 64-bit bitmap of the numbers just below it; a reading is stored only if
+ * its number is above the high-water mark or is an unseen gap inside the
+ * bitmap. Everything older than the window is dropped as stale.
+ *
+ * Version: v1.4
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            record a number only once the reading is stored
+ *   19-10-2026       Morris              v1.2            save the bitmap with the high-water mark
+ *   19-10-2026       Morris              v1.3            entries in a SensorTable (sensor_table.c)
+ *   19-10-2026       Morris              v1.4            undo the numbers of a batch that is rolled back
+ *
+ */
+
+#include "../inc/dedup_window.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * mark_dirty - Remember that @sensor_id needs its high-water mark saved.
+ */
+static void mark_dirty(DedupWindow *window, DedupEntry *entry, int64_t sensor_id)
+{
+    if (!entry->dirty && sensor_table_list(&window->table, sensor_id) == 0)
+    {
+        entry->dirty = 1;                                            /* Else saved with a later change */
+    }
+}
+
+
+/**
+ * save_undo - Keep @entry as it was before the open batch changes it.
+ */
+static void save_undo(DedupWindow *window, DedupEntry *entry, int64_t sensor_id)
+{
+    if (window->undo_count == window->undo_capacity)
+    {
+        size_t      capacity = window->undo_capacity ? window->undo_capacity * 2 : SENSOR_TABLE_INITIAL;
+        DedupUndo   *undo    = realloc(window->undo, capacity * sizeof(DedupUndo));
+        if (!undo)
+        {
+            perror("realloc");
+            return;                                                  /* A rollback keeps this reading seen */
+        }
+        window->undo          = undo;
+        window->undo_capacity = capacity;
+    }
+
+    window->undo[window->undo_count].sensor_id = sensor_id;
+    window->undo[window->undo_count].entry     = *entry;
+    window->undo_count++;
+    entry->undo_listed = 1;
+}
+
+
+/**
+ * dedup_window_init - Create the window and load high-water marks.
+ */
+int dedup_window_init(DedupWindow *window, sqlite3 *db)
+{
+    memset(window, 0, sizeof(*window));
+    sensor_table_init(&window->table, sizeof(DedupEntry));
+
+    window->save_stmt = prk_db_prepare(db, "INSERT OR REPLACE INTO Sensor_Seq (sensor_id, last_seq, seen) VALUES (?, ?, ?);");
+    sqlite3_stmt *load = prk_db_prepare(db, "SELECT sensor_id, last_seq, seen FROM Sensor_Seq;");
+    if (!window->save_stmt || !load)
+    {
+        sqlite3_finalize(load);
+        dedup_window_free(window);
+        return -1;
+    }
+
+    /* Seed the high-water marks and the numbers seen below them */
+    while (sqlite3_step(load) == SQLITE_ROW)
+    {
+        DedupEntry *entry = sensor_table_get(&window->table, sqlite3_column_int64(load, 0));
+        if (entry)
+        {
+            entry->high = (uint64_t)sqlite3_column_int64(load, 1);
+            entry->seen = (uint64_t)sqlite3_column_int64(load, 2);
+        }
+    }
+    sqlite3_finalize(load);
+
+    return 0;
+}
+
+/**
+ * dedup_window_check - Decide whether a reading is new, without recording it.
+ */
+dedup_result_t dedup_window_check(DedupWindow *window, int64_t sensor_id, uint64_t seq)
+{
+    if (seq == 0)
+    {
+        window->stats.unsequenced++;
+        return DEDUP_ACCEPT;                                         /* Legacy gateway, nothing to compare */
+    }
+
+    DedupEntry *entry = sensor_table_get(&window->table, sensor_id);
+    if (!entry)
+    {
+        window->stats.unsequenced++;
+        return DEDUP_ACCEPT;                                         /* Cannot track it, do not lose data */
+    }
+
+    if (seq > entry->high)
+    {
+        return DEDUP_ACCEPT;
+    }
+
+    uint64_t age = entry->high - seq;
+    if (age >= DEDUP_WINDOW_BITS)
+    {
+        window->stats.stale++;
+        return DEDUP_STALE;
+    }
+
+    if (entry->seen & (1ULL << age))
+    {
+        window->stats.duplicates++;
+        return DEDUP_DUPLICATE;
+    }
+
+    return DEDUP_ACCEPT;                                             /* Late, but not seen before */
+}
+
+/**
+ * dedup_window_commit - Record a reading accepted by dedup_window_check().
+ */
+void dedup_window_commit(DedupWindow *window, int64_t sensor_id, uint64_t seq)
+{
+    DedupEntry *entry = (seq != 0 && sensor_id > 0 && (size_t)sensor_id < window->table.capacity)
+                      ? sensor_table_at(&window->table, sensor_id) : NULL;
+    if (!entry)
+    {
+        return;                                                      /* Counted as unsequenced by the check */
+    }
+    if (!entry->undo_listed)
+    {
+        save_undo(window, entry, sensor_id);
+    }
+
+    if (seq > entry->high)
+    {
+        uint64_t shift = seq - entry->high;
+        entry->seen  = (shift >= DEDUP_WINDOW_BITS) ? 1 : (entry->seen << shift) | 1;
+        entry->high  = seq;
+        mark_dirty(window, entry, sensor_id);
+    }
+    else if (entry->high - seq < DEDUP_WINDOW_BITS)
+    {
+        entry->seen |= 1ULL << (entry->high - seq);                 /* Late, but not seen before */
+        mark_dirty(window, entry, sensor_id);
+    }
+    window->stats.accepted++;
+}
+
+/**
+ * dedup_window_batch_done - The batch holding the recorded readings is committed.
+ */
+void dedup_window_batch_done(DedupWindow *window)
+{
+    for (size_t i = 0; i < window->undo_count; i++)
+    {
+        DedupEntry *entry = sensor_table_at(&window->table, window->undo[i].sensor_id);
+        entry->undo_listed = 0;
+    }
+    window->undo_count = 0;
+}
+
+/**
+ * dedup_window_rollback - Forget the readings recorded since the last batch_done.
+ */
+void dedup_window_rollback(DedupWindow *window)
+{
+    for (size_t i = 0; i < window->undo_count; i++)
+    {
+        DedupEntry *entry = sensor_table_at(&window->table, window->undo[i].sensor_id);
+        *entry       = window->undo[i].entry;
+        entry->dirty = 0;                                            /* Sensor_Seq holds it, the save was rolled back */
+    }
+    window->undo_count = 0;
+}
+
+/**
+ * dedup_window_flush - Persist changed high-water marks.
+ */
+int dedup_window_flush(DedupWindow *window)
+{
+    int rc = 0;
+
+    for (size_t i = 0; i < window->table.listed_count; i++)
+    {
+        int64_t     id    = window->table.listed[i];
+        DedupEntry  *entry = sensor_table_at(&window->table, id);
+
+        sqlite3_bind_int64(window->save_stmt, 1, id);
+        sqlite3_bind_int64(window->save_stmt, 2, (sqlite3_int64)entry->high);
+        sqlite3_bind_int64(window->save_stmt, 3, (sqlite3_int64)entry->seen);
+        if (sqlite3_step(window->save_stmt) != SQLITE_DONE)
+        {
+            fprintf(stderr, "Error saving sequence number of sensor %lld\n", (long long)id);
+            rc = -1;
+        }
+        sqlite3_reset(window->save_stmt);
+        entry->dirty = 0;
+    }
+    window->table.listed_count = 0;
+
+    return rc;
+}
+
+/**
+ * dedup_window_stats - Current duplicate counters.
+ */
+const DedupStats *dedup_window_stats(const DedupWindow *window)
+{
+    return &window->stats;
+}
+
+/**
+ * dedup_window_free - Release the window.
+ */
+void dedup_window_free(DedupWindow *window)
+{
+    sqlite3_finalize(window->save_stmt);
+    sensor_table_free(&window->table);
+    free(window->undo);
+    memset(window, 0, sizeof(*window));
+    sensor_table_init(&window->table, sizeof(DedupEntry));
+}
@@ -0,0 +1,367 @@
+/**
+ * event_compactor.c: Store state changes instead of every reading
+ *
+ * A parked car reports the same status and nearly the same position over
+ * and over, and each report used to become a stored reading. This stage
+ * remembers what was last stored for each sensor and lets a reading
+ * through only when it says something new: the sensor arrived (parked),
+ * departed, moved beyond a distance threshold, or has not been stored for
+ * the keepalive period, so time window queries still see every parked
+ * car. Status changes pass a hysteresis so a single flapping report is not
+ * stored twice. The other ingest stages (rollups, sensor state, billing,
+ * query feed) still see every reading; raw records can be kept in a text
+ * archive.
+ *
+ * Version: v1.2
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            candidates kept when storing fails, event_compactor_due()
+ *   19-10-2026       Morris              v1.2            undo the stored readings of a batch that is rolled back
+ *
+ */
+
+#include "../inc/event_compactor.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * list_pending - Remember that @sensor_id holds a candidate.
+ */
+static void list_pending(EventCompactor *compactor, CompactorEntry *entry, int64_t sensor_id)
+{
+    if (!entry->pending_listed && sensor_table_list(&compactor->table, sensor_id) == 0)
+    {
+        entry->pending_listed = 1;                                   /* Else confirmed by readings only */
+    }
+}
+
+/**
+ * save_undo - Keep @entry as it was before the open batch changes it.
+ */
+static void save_undo(EventCompactor *compactor, CompactorEntry *entry, int64_t sensor_id)
+{
+    if (entry->undo_listed)
+    {
+        return;
+    }
+    if (compactor->undo_count == compactor->undo_capacity)
+    {
+        size_t          capacity = compactor->undo_capacity ? compactor->undo_capacity * 2 : SENSOR_TABLE_INITIAL;
+        CompactorUndo   *undo    = realloc(compactor->undo, capacity * sizeof(CompactorUndo));
+        if (!undo)
+        {
+            perror("realloc");
+            return;                                                  /* A rollback keeps this state */
+        }
+        compactor->undo          = undo;
+        compactor->undo_capacity = capacity;
+    }
+
+    compactor->undo[compactor->undo_count].sensor_id = sensor_id;
+    compactor->undo[compactor->undo_count].entry     = *entry;
+    compactor->undo_count++;
+    entry->undo_listed = 1;
+}
+
+/**
+ * restore - Put @saved back as the state of @sensor_id.
+ *
+ * The list bookkeeping stays as it is now; a restored candidate is listed
+ * again for event_compactor_flush().
+ */
+static void restore(EventCompactor *compactor, int64_t sensor_id, const CompactorEntry *saved)
+{
+    CompactorEntry  *entry          = sensor_table_at(&compactor->table, sensor_id);
+    char            pending_listed  = entry->pending_listed;
+    char            undo_listed     = entry->undo_listed;
+
+    *entry                = *saved;
+    entry->pending_listed = pending_listed;
+    entry->undo_listed    = undo_listed;
+    if (entry->candidate.status)
+    {
+        list_pending(compactor, entry, sensor_id);
+    }
+}
+
+/**
+ * moved - Whether @reading is more than move_threshold from the stored position.
+ */
+static int moved(const EventCompactor *compactor, const CompactorEntry *entry, const StoredReading *reading)
+{
+    int64_t dx        = (int64_t)reading->x - entry->x;
+    int64_t dy        = (int64_t)reading->y - entry->y;
+    int64_t dz        = (int64_t)reading->z - entry->z;
+    int64_t threshold = compactor->config.move_threshold;
+
+    return dx * dx + dy * dy + dz * dz > threshold * threshold;
+}
+
+/**
+ * mark_stored - Make @reading the sensor's last stored reading.
+ */
+static void mark_stored(EventCompactor *compactor, CompactorEntry *entry, const StoredReading *reading,
+                        compact_event_t event)
+{
+    entry->stored_time = reading->recv_time;
+    entry->x           = reading->x;
+    entry->y           = reading->y;
+    entry->z           = reading->z;
+    entry->status      = reading->status;
+    compactor->stats.stored++;
+    compactor->stats.events[event]++;
+    compactor->last_event = (int)event;
+}
+
+/**
+ * status_event - Event of a change to @status.
+ */
+static compact_event_t status_event(char status)
+{
+    return status == 'S' ? COMPACT_EVENT_ARRIVAL : COMPACT_EVENT_DEPARTURE;
+}
+
+
+/**
+ * event_compactor_default_config - Fill @config with the COMPACT_* defaults, disabled.
+ */
+void event_compactor_default_config(EventCompactorConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->move_threshold = COMPACT_MOVE_THRESHOLD;
+    config->hysteresis     = COMPACT_HYSTERESIS;
+    config->hold_ms        = COMPACT_HOLD_MS;
+    config->keepalive_ms   = COMPACT_KEEPALIVE_MS;
+}
+
+/**
+ * event_compactor_init - Create the per sensor state and open the raw archive.
+ */
+int event_compactor_init(EventCompactor *compactor, const EventCompactorConfig *config)
+{
+    memset(compactor, 0, sizeof(*compactor));
+    sensor_table_init(&compactor->table, sizeof(CompactorEntry));
+    compactor->config = *config;
+    if (compactor->config.hysteresis < 1)
+    {
+        compactor->config.hysteresis = 1;
+    }
+
+    if (config->archive_path)
+    {
+        compactor->archive = fopen(config->archive_path, "a");
+        if (!compactor->archive)
+        {
+            perror(config->archive_path);
+            return -1;
+        }
+        setvbuf(compactor->archive, NULL, _IOFBF, COMPACT_ARCHIVE_BUFFER);
+    }
+
+    return 0;
+}
+
+/**
+ * event_compactor_archive - Append a raw record to the archive, if any.
+ */
+void event_compactor_archive(EventCompactor *compactor, const char *record, size_t len)
+{
+    if (compactor->archive)
+    {
+        fwrite(record, 1, len, compactor->archive);
+        putc('\n', compactor->archive);
+        compactor->stats.archived++;
+    }
+}
+
+/**
+ * event_compactor_filter - Decide whether a reading is stored.
+ */
+int event_compactor_filter(EventCompactor *compactor, const StoredReading *reading, StoredReading *out)
+{
+    compactor->stats.readings++;
+    compactor->last_event     = -1;
+    compactor->last.sensor_id = 0;
+
+    CompactorEntry *entry = compactor->config.enabled ? sensor_table_get(&compactor->table, reading->sensor_id) : NULL;
+    if (!entry)
+    {
+        *out = *reading;                                             /* Disabled, or no memory for the state */
+        compactor->stats.stored++;
+        return 1;
+    }
+    save_undo(compactor, entry, reading->sensor_id);
+    compactor->last.sensor_id = reading->sensor_id;
+    compactor->last.entry     = *entry;
+
+    if (entry->stored_time == 0)
+    {
+        mark_stored(compactor, entry, reading, COMPACT_EVENT_FIRST);
+        *out = *reading;
+        return 1;
+    }
+
+    /* A new status counts once hysteresis readings in a row carry it */
+    if (reading->status != entry->status)
+    {
+        if (entry->candidate.status != reading->status)
+        {
+            entry->candidate     = *reading;
+            entry->confirmations = 0;
+            list_pending(compactor, entry, reading->sensor_id);
+        }
+        if (++entry->confirmations < compactor->config.hysteresis)
+        {
+            return 0;
+        }
+
+        *out = entry->candidate;
+        mark_stored(compactor, entry, out, status_event(out->status));
+        entry->candidate.status = 0;
+        return 1;
+    }
+
+    if (entry->candidate.status)
+    {
+        entry->candidate.status = 0;                                 /* Back to the stored status */
+        compactor->stats.flaps++;
+    }
+
+    if (moved(compactor, entry, reading))
+    {
+        mark_stored(compactor, entry, reading, COMPACT_EVENT_MOVE);
+        *out = *reading;
+        return 1;
+    }
+    if (compactor->config.keepalive_ms > 0 && reading->recv_time - entry->stored_time >= compactor->config.keepalive_ms)
+    {
+        mark_stored(compactor, entry, reading, COMPACT_EVENT_KEEPALIVE);
+        *out = *reading;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * event_compactor_revert - Undo the last filter call, its reading was not stored.
+ */
+void event_compactor_revert(EventCompactor *compactor)
+{
+    compactor->stats.stored--;
+    if (compactor->last_event >= 0)
+    {
+        compactor->stats.events[compactor->last_event]--;
+    }
+    if (compactor->last.sensor_id != 0)
+    {
+        restore(compactor, compactor->last.sensor_id, &compactor->last.entry);
+    }
+    compactor->last_event     = -1;
+    compactor->last.sensor_id = 0;
+}
+
+/**
+ * event_compactor_batch_done - The batch holding the stored readings is committed.
+ */
+void event_compactor_batch_done(EventCompactor *compactor)
+{
+    for (size_t i = 0; i < compactor->undo_count; i++)
+    {
+        CompactorEntry *entry = sensor_table_at(&compactor->table, compactor->undo[i].sensor_id);
+        entry->undo_listed = 0;
+    }
+    compactor->undo_count = 0;
+}
+
+/**
+ * event_compactor_rollback - Forget what was stored since the last batch_done.
+ */
+void event_compactor_rollback(EventCompactor *compactor)
+{
+    for (size_t i = 0; i < compactor->undo_count; i++)
+    {
+        CompactorEntry *entry = sensor_table_at(&compactor->table, compactor->undo[i].sensor_id);
+        restore(compactor, compactor->undo[i].sensor_id, &compactor->undo[i].entry);
+        entry->undo_listed = 0;
+    }
+    compactor->undo_count = 0;
+}
+
+/**
+ * event_compactor_due - Whether a held candidate is due at @now_ms.
+ */
+int event_compactor_due(const EventCompactor *compactor, int64_t now_ms)
+{
+    for (size_t i = 0; i < compactor->table.listed_count; i++)
+    {
+        const CompactorEntry *entry = sensor_table_at(&compactor->table, compactor->table.listed[i]);
+        if (entry->candidate.status && now_ms - entry->candidate.recv_time >= compactor->config.hold_ms)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * event_compactor_flush - Store the candidates held for hold_ms, flush the archive.
+ */
+long event_compactor_flush(EventCompactor *compactor, int64_t now_ms, compactor_emit_t emit, void *ctx)
+{
+    long    emitted = 0;
+    int     failed  = 0;
+    size_t  kept    = 0;
+
+    for (size_t i = 0; i < compactor->table.listed_count; i++)
+    {
+        int64_t         id    = compactor->table.listed[i];
+        CompactorEntry  *entry = sensor_table_at(&compactor->table, id);
+
+        if (entry->candidate.status && now_ms - entry->candidate.recv_time < compactor->config.hold_ms)
+        {
+            compactor->table.listed[kept++] = id;                         /* Still undecided */
+            continue;
+        }
+
+        if (entry->candidate.status)
+        {
+            if (emit(&entry->candidate, ctx) != 0)
+            {
+                compactor->table.listed[kept++] = id;                     /* Still held, stored by a later flush */
+                failed = 1;
+                continue;
+            }
+            save_undo(compactor, entry, id);
+            mark_stored(compactor, entry, &entry->candidate, status_event(entry->candidate.status));
+            entry->candidate.status = 0;
+            emitted++;
+        }
+        entry->pending_listed = 0;
+    }
+    compactor->table.listed_count = kept;
+
+    if (compactor->archive)
+    {
+        fflush(compactor->archive);
+    }
+
+    return failed ? -1 : emitted;
+}
+
+/**
+ * event_compactor_free - Release the state and close the archive.
+ */
+void event_compactor_free(EventCompactor *compactor)
+{
+    if (compactor->archive)
+    {
+        fclose(compactor->archive);
+    }
+    sensor_table_free(&compactor->table);
+    free(compactor->undo);
+    memset(compactor, 0, sizeof(*compactor));
+}
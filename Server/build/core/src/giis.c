@@ -3,20 +3,24 @@
  *
  * This program reads data from shared memory and writes it to a specified
  * output file as well as a FIFO (First In, First Out) file for further processing.
- * The program ensures that the shared memory is accessed synchronously by using
- * mutexes to avoid data corruption.
+ * out_server queues the records in a ring in shared memory and wakes this
+ * program, which forwards every record queued.
  *
  * Compilation:
- *      gcc giis.c -o out_giis
+ *      gcc giis.c record_ring.c prk_notify.c prk_metrics.c prk_trace.c prk_tracepoint.c -o out_giis -lpthread -lrt
  *
  * Usage:
  *      ./out_giis
  *
  * Features:
- * - Reads data from shared memory defined by SHM_KEY.
+ * - Reads the records out_server queues in shared memory (record_ring.h),
+ *   all of them each time it is woken.
  * - Writes data to an output file defined by OUTPUT_FILE.
- * - Writes data to a FIFO file defined by FIFO_TO_DB.
- * - Ensures synchronization using a mutex.
+ * - Writes data to a FIFO file defined by FIFO_TO_DB as newline terminated
+ *   records, those of one wakeup in one write() where they fit.
+ * - Keeps its metrics in the shm page "giis" (prk_metrics.h).
+ * - Stamps traced records (prk_trace.h) as it forwards them to FIFO_TO_DB.
+ * - A tracepoint (prk_tracepoint.h) per record forwarded, with TRACEPOINTS=1.
  *
  * Version: v1.0
  * Date:    19-05-2024
@@ -24,25 +28,102 @@
  *                                   
  * Date:            Name:               Version:        Modification:
  *   19-05-2024       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            newline framed records on FIFO_TO_DB
+ *   19-10-2026       Morris              v1.2            drain the record ring on each wakeup instead of
+ *                                                        polling one slot every 100 ms, batched writes
+ *   19-10-2026       Morris              v1.3            readiness notification to prk_sys_srv_run
+ *   19-10-2026       Morris              v1.4            metrics (prk_metrics.h): records, bytes, FIFO
+ *                                                        write time and fill
+ *   19-10-2026       Morris              v1.5            stamp traced records
+ *   19-10-2026       Morris              v1.6            tracepoints
  *
  */
 
 
+#define _GNU_SOURCE                                                  /* F_SETPIPE_SZ */
 #include "../inc/giis.h"
+#include "../inc/prk_notify.h"
+#include "../inc/prk_metrics.h"
+#include "../inc/prk_trace.h"
+#include "../inc/prk_tracepoint.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include <errno.h>
 #include <unistd.h>
-#include <pthread.h>                                                 /* For pthread_mutex_t */
+#include <pthread.h>
 
 #include <fcntl.h>                                                   /* open(FIFO_TO_DB, O_WRONLY) */
 #include <sys/stat.h>                                                /* mkfifo */
+#include <sys/ioctl.h>                                               /* FIONREAD */
 
 
-/* Mutex for shared memory synchronization */
-pthread_mutex_t shm_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Metrics, registered in main() before the thread starts */
+static PrkCounter       records_forwarded;                           /* Records written to FIFO_TO_DB */
+static PrkCounter       bytes_forwarded;
+static PrkHistogram     fifo_write_time;                             /* Long when the inserter falls behind */
+static PrkGauge         fifo_queued;                                 /* Bytes in FIFO_TO_DB not read yet */
+
+/**
+ * flush_batch - Write the records batched so far to FIFO_TO_DB.
+ */
+static void flush_batch(ForwardBatch *batch)
+{
+    size_t written = 0;
+
+    /* out_giis is the only writer: records never interleave, even when a
+       batch is longer than PIPE_BUF and written in parts */
+    uint64_t started = prk_metrics_now_ns();
+    while (written < batch->len)
+    {
+        ssize_t n = write(batch->fifo_fd, batch->buf + written, batch->len - written);
+        if (n <= 0)
+        {
+            perror("write fifo");
+            break;
+        }
+        written += (size_t)n;
+    }
+    if (written == batch->len && batch->len > 0)
+    {
+        prk_histogram_observe(fifo_write_time, prk_metrics_now_ns() - started);
+        prk_counter_add(records_forwarded, batch->records);
+        prk_counter_add(bytes_forwarded, batch->len);
+    }
+
+    batch->len     = 0;
+    batch->records = 0;
+}
+
+/**
+ * forward_record - Append a record drained from the ring to the output
+ *                  file and to the batch for FIFO_TO_DB (record_handler_t).
+ */
+static void forward_record(char *record, size_t len, void *ctx)
+{
+    ForwardBatch *batch = ctx;
+
+    PRK_TP_SCOPE(PRK_TP_GIIS_READ, len, 0);
+
+    /* Write data to file, flushed once per drain */
+    fprintf(batch->output_file, "%s\n", record);
+
+    /* One newline framed record, with room for a trace stamp */
+    if (batch->len + len + PRK_TRACE_STAMP_MAX + 1 > sizeof(batch->buf))
+    {
+        flush_batch(batch);
+    }
+    char *start = batch->buf + batch->len;
+    memcpy(start, record, len);
+    if (prk_trace_find(start, len))
+    {
+        int stamp_len = prk_trace_format_stamp(PRK_TRACE_GIIS, start + len, PRK_TRACE_STAMP_MAX);
+        len += stamp_len > 0 ? (size_t)stamp_len : 0;
+    }
+    start[len] = '\n';
+    batch->len += len + 1;
+    batch->records++;
+}
 
 /**
  * read_from_shared_memory - Thread function to read data from shared memory
@@ -50,80 +131,68 @@ pthread_mutex_t shm_mutex = PTHREAD_MUTEX_INITIALIZER;
  */
 void *read_from_shared_memory(void *arg)
 {
-    int                 shm_id;
-    struct shared_data  *shm_data;
-    FILE                *output_file;
-    char                last_data[BUFFER_SIZE] = "";
-
-    /* Attach shared memory */
-    shm_id = shmget(SHM_KEY, sizeof(struct shared_data), 0666);
-    if (shm_id == -1)
+    RecordRing      *ring;
+    ForwardBatch    *batch;
+
+    /* Attach the record ring out_server created */
+    ring = record_ring_attach();
+    if (!ring)
     {
-        perror("shmget");
         pthread_exit(NULL);
     }
-    shm_data = (struct shared_data *)shmat(shm_id, NULL, 0);
-    if (shm_data == (void *)-1)
+    batch = calloc(1, sizeof(ForwardBatch));
+    if (!batch)
     {
-        perror("shmat");
+        perror("calloc");
+        record_ring_detach(ring);
         pthread_exit(NULL);
     }
 
     /* Open output file for writing */
-    output_file = fopen(OUTPUT_FILE, "a");                           /* "a" - append, "w" - write (refresh the file) */
-    if (output_file == NULL)
+    batch->output_file = fopen(OUTPUT_FILE, "a");                    /* "a" - append, "w" - write (refresh the file) */
+    if (batch->output_file == NULL)
     {
         perror("fopen");
-        shmdt(shm_data);
+        free(batch);
+        record_ring_detach(ring);
         pthread_exit(NULL);
     }
 
+    /* Ready: the open below waits for the inserter, which starts after this stage */
+    prk_notify_ready();
+
     /* Open FIFO for writing */
-    int fifo_fd = open(FIFO_TO_DB, O_WRONLY);
-    if (fifo_fd == -1)
+    batch->fifo_fd = open(FIFO_TO_DB, O_WRONLY);
+    if (batch->fifo_fd == -1)
     {
         perror("open fifo");
-        fclose(output_file);
-        shmdt(shm_data);
+        fclose(batch->output_file);
+        free(batch);
+        record_ring_detach(ring);
         pthread_exit(NULL);
     }
+    fcntl(batch->fifo_fd, F_SETPIPE_SZ, FIFO_PIPE_SIZE);             /* Best effort, the default is 64 KiB anyway */
 
-    /* Loop to read data from shared memory and write to the file */
-    while (1)
+    /* Sleep until out_server queues records, then forward all of them */
+    while (record_ring_wait(ring) == 0 || errno == EINTR)
     {
-        /* Lock mutex */
-        pthread_mutex_lock(&shm_mutex);
+        record_ring_drain(ring, forward_record, batch);
+        flush_batch(batch);
+        fflush(batch->output_file);
 
-        /* Read data from shared memory */
-        /* if (strlen(shm_data->data) > 0 && strcmp(shm_data->data, last_data) != 0) */
-        if (strlen(shm_data->data) > 0)
+        int queued;
+        if (ioctl(batch->fifo_fd, FIONREAD, &queued) == 0)
         {
-            /* Write data to file */
-            fprintf(output_file, "%s\n", shm_data->data);
-            fflush(output_file);
-
-            /* Write data to FIFO */
-            write(fifo_fd, shm_data->data, strlen(shm_data->data));
-
-            /* Update last_data with the current data */
-            strncpy(last_data, shm_data->data, BUFFER_SIZE);
-
-
-            /* Clear shared memory data */
-            memset(shm_data->data, 0, BUFFER_SIZE);
+            prk_gauge_set(fifo_queued, queued);
         }
-
-        /* Unlock mutex */
-        pthread_mutex_unlock(&shm_mutex);
-
-        /* Sleep for a while to avoid busy waiting */
-        usleep(100000);                                              /* 100ms */
     }
+    perror("sem_wait");
 
     /* Cleanup */
-    close(fifo_fd);
-    fclose(output_file);
-    shmdt(shm_data);
+    close(batch->fifo_fd);
+    fclose(batch->output_file);
+    free(batch);
+    record_ring_detach(ring);
 
     pthread_exit(NULL);
 }
@@ -142,6 +211,15 @@ int main()
         }
     }
 
+    /* Metrics page, read by out_metrics_exporter */
+    prk_metrics_open("giis");
+    PRK_TP_OPEN("giis");
+    records_forwarded = prk_counter("prk_giis_records_total", "Records forwarded to the inserter.");
+    bytes_forwarded   = prk_counter("prk_giis_forwarded_bytes_total", "Bytes forwarded to the inserter.");
+    fifo_write_time   = prk_histogram("prk_giis_fifo_write_seconds",
+                                      "Time to write a batch of records to the inserter's FIFO.", PRK_SCALE_NS);
+    fifo_queued       = prk_gauge("prk_giis_fifo_queued_bytes", "Bytes in the inserter's FIFO not read yet.");
+
     /* Create a thread to read from shared memory */
     if (pthread_create(&thread_id, NULL, read_from_shared_memory, NULL) != 0)
     {
@@ -151,6 +229,8 @@ int main()
 
     /* Wait for the thread to finish */
     pthread_join(thread_id, NULL);
+    PRK_TP_CLOSE();
+    prk_metrics_close();
 
     return 0;
 }
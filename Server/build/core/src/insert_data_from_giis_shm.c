@@ -6,14 +6,47 @@
  * accordingly before being inserted into the database.
  *
  * Compilation:
- *   gcc insert_data_from_giis_shm.c -o out_insert_data_from_giis_shm
+ *   gcc insert_data_from_giis_shm.c record_reader.c sensor_parser.c \
+ *          sensor_registry.c sensor_table.c dedup_window.c dead_letter.c reading_store.c partition_router.c \
+ *          store_tsdb.c zone_map.c point_in_polygon.c occupancy_rollup.c sensor_state.c query_feed.c billing.c \
+ *          event_compactor.c price_table.c price_schedule.c price_sync.c prk_db.c prk_notify.c prk_metrics.c \
+ *          prk_trace.c trace_sink.c prk_tracepoint.c \
+ *          -o out_insert_data_from_giis_shm -lsqlite3 -lpthread
  *
  * Usage:
- *   ./out_insert_data_from_giis_shm
+ *   ./out_insert_data_from_giis_shm [sqlite|tsdb] [--replay <dead_letter_log>] [--compact]
+ *          [--move-threshold <distance>] [--hysteresis <readings>] [--keepalive <s>] [--archive <path>]
  *
  * Features:
- * - Reads data from a named FIFO defined by FIFO_TO_DB.
+ * - Reads newline framed records from a named FIFO defined by FIFO_TO_DB.
  * - Parses the data and inserts it into an SQLite database defined by DB_PATH.
+ * - Stores each sensor once in the Sensors table; readings reference it by id.
+ * - Drops readings whose per-sensor sequence number was already stored.
+ * - Prints ingest and duplicate counters on SIGUSR1 and at exit.
+ * - Stores readings in Customer_Data (default) or in the native time-series
+ *   engine under TSDB_DIR, selected by the first argument.
+ * - Rejected records go to a bounded dead-letter log (DEAD_LETTER_PATH) with
+ *   a reason code, counted per reason and per source; --replay feeds a log
+ *   back through the inserter.
+ * - Maintains the per zone occupancy rollups (Rollup_Minute/Hour/Day) in
+ *   memory and upserts them every ROLLUP_FLUSH_MS.
+ * - Keeps Sensor_State (latest reading per sensor) with coalesced upserts
+ *   every SENSOR_STATE_FLUSH_MS.
+ * - Sends every committed reading to the query service (out_query_daemon)
+ *   over QUERY_FEED_PATH.
+ * - Follows the parking session of every sensor and writes an invoice
+ *   (Invoices) priced from Prices when it closes.
+ * - With --compact, stores only the readings that change a sensor's stored
+ *   history (arrival, departure, move, keepalive); --archive keeps every
+ *   raw record in a text file.
+ * - Keeps its metrics in the shm page "inserter" (prk_metrics.h): records
+ *   by outcome, batch sizes, batch and commit times, FIFO fill.
+ * - Folds the stage stamps of traced records into per hop latency
+ *   histograms once they are committed (trace_sink.h).
+ * - Tracepoints (prk_tracepoint.h) per chunk, record and commit, with
+ *   TRACEPOINTS=1.
+ * - SIGTERM or SIGINT stops it cleanly: pending rollups, states and
+ *   invoices are written and open sessions saved for the next run.
  * - Handles errors during file operations and SQLite command execution.
  *
  * Version: v1.0
@@ -22,46 +55,574 @@
  *                                   
  * Date:            Name:               Version:        Modification:
  *   01-06-2024       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            read the FIFO through record_reader: newline framed
+ *                                                        records, 64 KiB chunks, several records per read()
+ *   19-10-2026       Morris              v1.2            parse lines with sensor_parser instead of sscanf
+ *   19-10-2026       Morris              v1.3            embedded SQLite connection, prepared inserts,
+ *                                                        MAC addresses interned into the Sensors table
+ *   19-10-2026       Morris              v1.4            drop duplicate readings by per-sensor sequence
+ *                                                        number, SIGUSR1 prints the counters
+ *   19-10-2026       Morris              v1.5            write readings through reading_store, stamp the
+ *                                                        receive time, optional time-series backend
+ *   19-10-2026       Morris              v1.6            dead-letter log for rejected records instead of
+ *                                                        one stderr line each, --replay
+ *   19-10-2026       Morris              v1.7            incremental occupancy rollups per zone
+ *   19-10-2026       Morris              v1.8            Sensor_State upserts from a dirty set
+ *   19-10-2026       Morris              v1.9            feed the query service
+ *   19-10-2026       Morris              v1.10           incremental billing of parking sessions,
+ *                                                        clean stop on SIGTERM/SIGINT
+ *   19-10-2026       Morris              v1.11           state-change compaction of stored readings
+ *   19-10-2026       Morris              v1.12           billing prices from the shared price table
+ *   19-10-2026       Morris              v1.13           readiness notification to prk_sys_srv_run
+ *   19-10-2026       Morris              v1.14           metrics (prk_metrics.h): records by outcome, batch
+ *                                                        size and time, commit time, FIFO fill
+ *   19-10-2026       Morris              v1.15           per hop latencies of traced records
+ *   19-10-2026       Morris              v1.16           tracepoints
  *
  */
 
+#define _GNU_SOURCE                                                  /* F_SETPIPE_SZ */
 #include "../inc/insert_data_from_giis_shm.h"
+#include "../inc/record_reader.h"
+#include "../inc/sensor_parser.h"
+#include "../inc/sensor_registry.h"
+#include "../inc/dedup_window.h"
+#include "../inc/dead_letter.h"
+#include "../inc/reading_store.h"
+#include "../inc/store_tsdb.h"
+#include "../inc/zone_map.h"
+#include "../inc/occupancy_rollup.h"
+#include "../inc/sensor_state.h"
+#include "../inc/query_feed.h"
+#include "../inc/billing.h"
+#include "../inc/event_compactor.h"
+#include "../inc/prk_db.h"
+#include "../inc/prk_notify.h"
+#include "../inc/prk_metrics.h"
+#include "../inc/trace_sink.h"
+#include "../inc/prk_tracepoint.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
 
 
 
+/* Database state shared by the processing functions */
+static sqlite3          *db;                                         /* Embedded SQLite connection */
+static ReadingStore     store;                                       /* Where accepted readings go */
+static SensorRegistry   sensors;                                     /* MAC -> Sensors.id cache */
+static DedupWindow      dedup;                                       /* Per-sensor duplicate suppression */
+static DeadLetter       dead_letters;                                /* Rejected records (about 90 KiB) */
+static ZoneMap          zones;                                       /* Zones, for the rollups */
+static OccupancyRollup  rollup;                                      /* Occupancy not yet upserted */
+static RollupWriter     rollup_writer;                               /* Upserts into the rollup tables */
+static int64_t          rollup_flushed_ms;                           /* CLOCK_MONOTONIC of the last upsert */
+static SensorState      sensor_state;                                /* Latest reading per sensor */
+static int64_t          state_flushed_ms;                            /* CLOCK_MONOTONIC of the last upsert */
+static QueryFeed        query_feed;                                  /* State updates for out_query_daemon */
+static BillingEngine    billing;                                     /* Open parking sessions */
+static EventCompactorConfig compact_config;                          /* Set from the command line */
+static EventCompactor   compactor;                                   /* Which readings reach the store */
+
+/* Metrics, see register_metrics() */
+static PrkCounter       records_read;                                /* Every record, whatever becomes of it */
+static PrkCounter       records_accepted;                            /* Passed parsing, lookup and dedup */
+static PrkCounter       records_rejected[DLQ_REASON_COUNT];          /* Dead-lettered, per reason */
+static PrkCounter       records_dropped[DEDUP_STALE + 1];            /* Duplicates and stale, per dedup result */
+static PrkHistogram     batch_records;                               /* Records per FIFO chunk */
+static PrkHistogram     batch_time;                                  /* From the chunk read to its commit */
+static PrkHistogram     commit_time;                                 /* Flushes and COMMIT of a batch */
+static PrkGauge         fifo_queued;                                 /* Bytes in FIFO_TO_DB not read yet */
+static PrkGauge         open_sessions;                               /* Parking sessions being billed */
+static TraceSink        traces;                                      /* Traced records of the open batch */
+
+/* Records accepted into the open batch, NUL separated, dead-lettered if its COMMIT fails */
+static char             *batch_lines;
+static size_t           batch_lines_len;
+static size_t           batch_lines_capacity;
+
+/* Set by SIGUSR1: print the counters after the current chunk */
+static volatile sig_atomic_t report_requested = 0;
+
+/* Set by SIGTERM or SIGINT: leave the FIFO loop and close the database */
+static volatile sig_atomic_t stop_requested = 0;
+
+
+/**
+ * open_database - Open the database and prepare the insert path
+ */
+int open_database(const char *db_path, const char *backend)
+{
+    db = prk_db_open(db_path);
+    if (!db)
+    {
+        return -1;
+    }
+
+    if (prk_db_create_schema(db) != 0 || sensor_registry_init(&sensors, db) != 0 ||
+        dedup_window_init(&dedup, db) != 0)
+    {
+        close_database();
+        return -1;
+    }
+
+    if (reading_store_open(backend, db, TSDB_DIR, &store) != 0 ||
+        event_compactor_init(&compactor, &compact_config) != 0)
+    {
+        close_database();
+        return -1;
+    }
+
+    /* Rollups go to the database whatever the reading backend */
+    if (zone_map_load(&zones, db) != 0 || occupancy_rollup_init(&rollup, &zones) != 0 ||
+        rollup_writer_init(&rollup_writer, db) != 0 || sensor_state_init(&sensor_state, db) != 0 ||
+        billing_init(&billing, db, &zones) != 0)
+    {
+        close_database();
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * monotonic_ms - CLOCK_MONOTONIC in milliseconds
+ */
+static int64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * realtime_ms - CLOCK_REALTIME in milliseconds, the clock of recv_time
+ */
+static int64_t realtime_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * flush_rollups - Upsert the changed rollup buckets, in the caller's transaction
+ *                 (occupancy_rollup_batch_done() once it commits)
+ * @final: Also forget the open buckets (shutdown)
+ */
+static void flush_rollups(int final)
+{
+    if (occupancy_rollup_drain(&rollup, final, rollup_writer_emit, &rollup_writer) < 0)
+    {
+        fprintf(stderr, "Rollup flush failed, retrying with the next batch\n");
+    }
+    rollup_flushed_ms = monotonic_ms();
+}
+
+/**
+ * store_event - compactor_emit_t adapter appending a held reading to the store
+ */
+static int store_event(const StoredReading *reading, void *ctx)
+{
+    (void)ctx;
+    return reading_store_append(&store, reading);
+}
+
+/**
+ * flush_held - Store the held status changes due at @now_ms
+ */
+static void flush_held(int64_t now_ms)
+{
+    if (event_compactor_flush(&compactor, now_ms, store_event, NULL) < 0)
+    {
+        fprintf(stderr, "Error storing held status changes, still held\n");
+    }
+}
+
+/**
+ * end_batch - COMMIT the open transaction, rolling it back if that fails
+ *
+ * Return: 0 if committed, -1 if rolled back.
+ */
+static int end_batch(void)
+{
+    if (prk_db_exec(db, "COMMIT;") == 0)
+    {
+        return 0;
+    }
+    if (!sqlite3_get_autocommit(db))                                 /* Still open, e.g. SQLITE_BUSY */
+    {
+        prk_db_exec(db, "ROLLBACK;");
+    }
+    return -1;
+}
+
+/**
+ * close_database - Release the prepared statements and the connection
+ */
+void close_database()
+{
+    if (rollup_writer.upsert[ROLLUP_MINUTE])
+    {
+        prk_db_exec(db, "BEGIN;");
+        flush_held(INT64_MAX);                                       /* Every held status change */
+        flush_rollups(1);
+        sensor_state_flush(&sensor_state);
+        if (billing.invoice_stmt)
+        {
+            billing_flush(&billing, realtime_ms());
+            billing_save(&billing);                                  /* Reopened by the next run */
+        }
+        if (end_batch() == 0)
+        {
+            reading_store_flush(&store);
+            occupancy_rollup_batch_done(&rollup);
+            event_compactor_batch_done(&compactor);
+        }
+        else
+        {
+            reading_store_discard(&store);
+            occupancy_rollup_rollback(&rollup);
+            event_compactor_rollback(&compactor);
+            fprintf(stderr, "Error committing the final flush, rolled back\n");
+        }
+        rollup_writer_free(&rollup_writer);
+    }
+    billing_free(&billing);
+    event_compactor_free(&compactor);
+    sensor_state_free(&sensor_state);
+    occupancy_rollup_free(&rollup);
+    zone_map_free(&zones);
+    if (store.ops)
+    {
+        reading_store_close(&store);
+    }
+    if (sensors.slots)
+    {
+        sensor_registry_free(&sensors);
+    }
+    dedup_window_free(&dedup);
+    free(batch_lines);
+    batch_lines = NULL;
+    prk_db_close(db);
+    db = NULL;
+}
+
+/**
+ * register_metrics - Describe the metrics of the inserter
+ */
+static void register_metrics(void)
+{
+    char name[PRK_METRICS_NAME_LEN];
+
+    records_read     = prk_counter("prk_inserter_records_total", "Records read from the FIFO or replayed.");
+    records_accepted = prk_counter("prk_inserter_accepted_total", "Records parsed, resolved and not seen before.");
+    for (unsigned reason = PARSE_ERR_EMPTY; reason < DLQ_REASON_COUNT; reason++)
+    {
+        snprintf(name, sizeof(name), "prk_inserter_rejected_total{reason=\"%s\"}", dead_letter_reason_str(reason));
+        records_rejected[reason] = prk_counter(name, "Records sent to the dead-letter log.");
+    }
+    records_dropped[DEDUP_DUPLICATE] = prk_counter("prk_inserter_dropped_total{cause=\"duplicate\"}",
+                                                   "Readings dropped by sequence number.");
+    records_dropped[DEDUP_STALE]     = prk_counter("prk_inserter_dropped_total{cause=\"stale\"}",
+                                                   "Readings dropped by sequence number.");
+    batch_records = prk_histogram("prk_inserter_batch_records", "Records per FIFO chunk.", PRK_SCALE_NONE);
+    batch_time    = prk_histogram("prk_inserter_batch_seconds", "Time from reading a chunk to its commit.",
+                                  PRK_SCALE_NS);
+    commit_time   = prk_histogram("prk_inserter_commit_seconds",
+                                  "Time to flush a batch to the database and commit it.", PRK_SCALE_NS);
+    fifo_queued   = prk_gauge("prk_inserter_fifo_queued_bytes", "Bytes in the FIFO not read yet, after a read.");
+    open_sessions = prk_gauge("prk_inserter_open_sessions", "Parking sessions being billed.");
+}
+
+/**
+ * reject - Count a rejected record and send it to the dead-letter log
+ */
+static void reject(const char *line, size_t len, unsigned reason)
+{
+    prk_counter_inc(records_rejected[reason < DLQ_REASON_COUNT ? reason : 0]);
+    dead_letter_reject(&dead_letters, line, len, reason);
+}
+
+/**
+ * batch_log - Keep an accepted record until its batch is committed
+ */
+static void batch_log(const char *line, size_t len)
+{
+    if (batch_lines_len + len + 1 > batch_lines_capacity)
+    {
+        size_t capacity = batch_lines_capacity ? batch_lines_capacity : RECORD_READER_CAPACITY;
+        while (capacity < batch_lines_len + len + 1)
+        {
+            capacity *= 2;
+        }
+        char *lines = realloc(batch_lines, capacity);
+        if (!lines)
+        {
+            perror("realloc");                                       /* Lost only if the COMMIT fails */
+            return;
+        }
+        batch_lines          = lines;
+        batch_lines_capacity = capacity;
+    }
+
+    memcpy(batch_lines + batch_lines_len, line, len);
+    batch_lines[batch_lines_len + len] = '\0';
+    batch_lines_len += len + 1;
+}
+
 /**
  * process_line - Process a single line of input data
  */
 void process_line(const char *line)
 {
-    char    mac_address[18];                                         /* Buffer for MAC address */
-    char    status;                                                  /* Status character */
-    double  x, y, z;                                                 /* Coordinates */
+    SensorReading   reading;
+    size_t          len = strlen(line);
+    parse_status_t  rc;
+
+    PRK_TP_SCOPE(PRK_TP_INS_LINE, len, 0);
 
     /* Parse the line to extract the data */
-    if (sscanf(line, "%17s: %c: x %lf y %lf z %lf", mac_address, &status, &x, &y, &z) != 5)
+    rc = parse_reading(line, len, &reading);
+    prk_counter_inc(records_read);
+    if (rc != PARSE_OK)
+    {
+        reject(line, len, rc);
+        return;
+    }
+
+    /* Resolve the MAC address to its sensor id (memory first, Sensors table on a miss) */
+    int64_t sensor_id = sensor_registry_lookup(&sensors, reading.mac);
+    if (sensor_id < 0)
     {
-        fprintf(stderr, "Error parsing line: %s\n", line);
+        reject(line, len, DLQ_REASON_SENSOR);
         return;
     }
 
-    /* Construct the SQLite command to insert the data */
-    char    command[256];
-    snprintf(command, sizeof(command), "sqlite %s \"INSERT INTO Customer_Data (mac_address, status, x, y, z) VALUES ('%s', '%c', %.2f, %.2f, %.2f);\"", DB_PATH, mac_address, status, x, y, z);
+    /* Drop readings that were already stored (re-emitted or resent) */
+    dedup_result_t verdict = dedup_window_check(&dedup, sensor_id, reading.seq);
+    if (verdict != DEDUP_ACCEPT)
+    {
+        prk_counter_inc(records_dropped[verdict]);
+        return;
+    }
+    prk_counter_inc(records_accepted);
 
-    /* Execute the SQLite command */
-    int result = system(command);
-    if (result != 0)
+    /* Hand the reading to the storage backend, stamped with its receive time */
+    /* Only the readings that change the sensor's stored history, when compacting */
+    StoredReading stored =
+    {
+        .sensor_id = sensor_id,
+        .recv_time = realtime_ms(),
+        .x         = reading.x,
+        .y         = reading.y,
+        .z         = reading.z,
+        .status    = reading.status,
+    };
+    StoredReading event;
+    event_compactor_archive(&compactor, line, len);
+    if (event_compactor_filter(&compactor, &stored, &event) && reading_store_append(&store, &event) != 0)
+    {
+        event_compactor_revert(&compactor);
+        reject(line, len, DLQ_REASON_STORE);                         /* Its number stays unseen, a resend is stored */
+        return;
+    }
+    dedup_window_commit(&dedup, sensor_id, reading.seq);
+    batch_log(line, len);
+    if (reading.trace)
     {
-        fprintf(stderr, "Error executing SQLite command: %s\n", command);
+        trace_sink_add(&traces, line + reading.trace, len - reading.trace);
     }
+
+    /* Count it in its zone's occupancy, as the sensor's state and in its session, written by commit_batch */
+    occupancy_rollup_add(&rollup, sensor_id, stored.recv_time, stored.x, stored.y, stored.status);
+    sensor_state_update(&sensor_state, &stored);
+    billing_update(&billing, &stored);
+    query_feed_add(&query_feed, &stored, reading.mac);
+}
+
+/**
+ * begin_batch - Start the transaction that groups one batch of records
+ */
+static void begin_batch(void)
+{
+    prk_db_exec(db, "BEGIN;");
+    batch_lines_len = 0;
+}
+
+/**
+ * reject_batch - Undo what a failed COMMIT leaves behind: the accepted
+ *                records go to the dead-letter log for a replay, their
+ *                sequence numbers and the sensors they registered are
+ *                forgotten, neither the store, the compactor, the query
+ *                feed nor the traces see them, and the rollup deltas are
+ *                drained again
+ */
+static void reject_batch(void)
+{
+    size_t rejected = 0;
+
+    reading_store_discard(&store);
+    occupancy_rollup_rollback(&rollup);
+    event_compactor_rollback(&compactor);
+    query_feed_discard(&query_feed);
+    trace_sink_discard(&traces);
+    dedup_window_rollback(&dedup);
+    sensor_registry_rollback(&sensors);
+    for (size_t off = 0; off < batch_lines_len; rejected++)
+    {
+        const char  *line = batch_lines + off;
+        size_t      len  = strlen(line);
+        reject(line, len, DLQ_REASON_STORE);
+        off += len + 1;
+    }
+    batch_lines_len = 0;
+    fprintf(stderr, "Error committing a batch, %zu record(s) dead-lettered\n", rejected);
+}
+
+/**
+ * commit_batch - Persist sequence high-water marks, upsert the rollups and
+ *                sensor states when due, write the invoices of closed
+ *                sessions, commit the batch and then write out the
+ *                readings the store buffered
+ */
+static void commit_batch(void)
+{
+    PRK_TP_SCOPE(PRK_TP_INS_COMMIT, 0, 0);
+    int64_t     now     = monotonic_ms();
+    uint64_t    started = prk_metrics_now_ns();
+
+    flush_held(realtime_ms());
+    dedup_window_flush(&dedup);
+    if (now - rollup_flushed_ms >= ROLLUP_FLUSH_MS)
+    {
+        flush_rollups(0);
+    }
+    if (now - state_flushed_ms >= SENSOR_STATE_FLUSH_MS)
+    {
+        sensor_state_flush(&sensor_state);
+        state_flushed_ms = now;
+    }
+    billing_flush(&billing, realtime_ms());
+    if (end_batch() == 0)
+    {
+        prk_histogram_observe(commit_time, prk_metrics_now_ns() - started);
+        reading_store_flush(&store);                                 /* A rolled back batch never reaches it */
+        occupancy_rollup_batch_done(&rollup);
+        event_compactor_batch_done(&compactor);
+        dedup_window_batch_done(&dedup);
+        sensor_registry_batch_done(&sensors);
+        trace_sink_commit(&traces);
+        query_feed_flush(&query_feed);                               /* Only committed states reach the service */
+    }
+    else
+    {
+        reject_batch();
+    }
+    prk_gauge_set(open_sessions, (int64_t)billing.open);
+    dead_letter_flush(&dead_letters);
+
+    if (report_requested)
+    {
+        report_requested = 0;
+        print_counters();
+    }
+}
+
+/**
+ * idle_flush - Upsert counted rollups and sensor states, store held status
+ *              changes and close timed out sessions while no records arrive
+ */
+static void idle_flush(void)
+{
+    int64_t now = realtime_ms();
+
+    if (rollup.pending > 0 || sensor_state.table.listed_count > 0 || billing_due(&billing, now) ||
+        event_compactor_due(&compactor, now))
+    {
+        begin_batch();
+        flush_held(now);
+        flush_rollups(0);
+        sensor_state_flush(&sensor_state);
+        state_flushed_ms = monotonic_ms();
+        billing_flush(&billing, now);
+        if (end_batch() == 0)
+        {
+            reading_store_flush(&store);
+            occupancy_rollup_batch_done(&rollup);
+            event_compactor_batch_done(&compactor);
+        }
+        else
+        {
+            reading_store_discard(&store);
+            occupancy_rollup_rollback(&rollup);
+            event_compactor_rollback(&compactor);
+            fprintf(stderr, "Error committing an idle flush, rolled back\n");
+        }
+    }
+}
+
+/**
+ * print_counters - Print ingest and duplicate counters to stdout
+ */
+void print_counters()
+{
+    const DedupStats *stats = dedup_window_stats(&dedup);
+
+    printf("Sensors: %zu cached (%zu hits, %zu misses)\n", sensors.count, sensors.hits, sensors.misses);
+    printf("Readings: %llu accepted, %llu unsequenced, %llu duplicates, %llu stale\n",
+           (unsigned long long)stats->accepted, (unsigned long long)stats->unsequenced,
+           (unsigned long long)stats->duplicates, (unsigned long long)stats->stale);
+    printf("Rollups: %zu zones, %llu readings outside every zone\n", zones.count,
+           (unsigned long long)rollup.unzoned);
+    printf("Sensor state: %llu updates, %llu upserts\n", (unsigned long long)sensor_state.updates,
+           (unsigned long long)sensor_state.upserts);
+    printf("Query feed: %llu sent, %llu dropped\n", (unsigned long long)query_feed.sent,
+           (unsigned long long)query_feed.dropped);
+    if (compact_config.enabled)
+    {
+        const EventCompactorStats *compacted = &compactor.stats;
+        printf("Compaction: %llu of %llu stored (%llu first, %llu arrivals, %llu departures, %llu moves, "
+               "%llu keepalives), %llu flaps\n", (unsigned long long)compacted->stored,
+               (unsigned long long)compacted->readings, (unsigned long long)compacted->events[COMPACT_EVENT_FIRST],
+               (unsigned long long)compacted->events[COMPACT_EVENT_ARRIVAL],
+               (unsigned long long)compacted->events[COMPACT_EVENT_DEPARTURE],
+               (unsigned long long)compacted->events[COMPACT_EVENT_MOVE],
+               (unsigned long long)compacted->events[COMPACT_EVENT_KEEPALIVE], (unsigned long long)compacted->flaps);
+    }
+    printf("Billing: %zu open, %llu opened, %llu invoiced (%llu unpriced, %llu at an earlier price), "
+           "%llu timed out, price table generation %llu\n", billing.open, (unsigned long long)billing.opened,
+           (unsigned long long)billing.invoiced, (unsigned long long)billing.unpriced,
+           (unsigned long long)billing.repriced, (unsigned long long)billing.timeouts, (unsigned long long)billing.shared_prices.generation);
+    dead_letter_print(&dead_letters, stdout);
+    fflush(stdout);
+}
+
+/**
+ * report_handler - SIGUSR1 handler requesting a counter report
+ */
+static void report_handler(int signum)
+{
+    (void)signum;
+    report_requested = 1;
+}
+
+/**
+ * stop_handler - SIGTERM/SIGINT handler requesting a clean shutdown
+ */
+static void stop_handler(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
 }
 
 /**
@@ -94,12 +655,15 @@ void process_data_file()
         return;
     }
 
-    /* Read and process each line of the file */
+    /* Read and process each line of the file, all in one transaction */
     char line[256];
+    begin_batch();
     while (fgets(line, sizeof(line), file))
     {
+        line[strcspn(line, "\r\n")] = '\0';                          /* Strip the line delimiter */
         process_line(line);
     }
+    commit_batch();
 
     /* <B1: explicitly unlock */
     /* Unlock the file */
@@ -114,11 +678,53 @@ void process_data_file()
     close(fd);
 }
 
+/**
+ * process_record - record_handler_t adapter that forwards a framed record
+ *                  from the FIFO to process_line().
+ */
+static void process_record(char *record, size_t len, void *ctx)
+{
+    (void)len;
+    (void)ctx;
+    process_line(record);
+}
+
+/**
+ * replay_record - dead_letter_replay_handler_t adapter that feeds a logged
+ *                 record back to process_line().
+ */
+static void replay_record(char *record, size_t len, const DeadLetterHeader *header, void *ctx)
+{
+    (void)ctx;
+    if (!header->truncated)                                          /* A cut record cannot parse, log it again */
+    {
+        process_line(record);
+    }
+    else
+    {
+        reject(record, len, header->reason);
+    }
+}
+
+/**
+ * replay_dead_letters - Reprocess the records of a dead-letter log
+ */
+long replay_dead_letters(const char *path)
+{
+    begin_batch();
+    long replayed = dead_letter_replay(&dead_letters, path, replay_record, NULL);
+    commit_batch();
+
+    return replayed;
+}
+
 /**
  * process_fifo - Process data from the FIFO
  */
 void process_fifo()
 {
+    static RecordReader reader;                                      /* 64 KiB chunk buffer, kept off the stack */
+
     /* Open the FIFO for reading */
     int fd = open(FIFO_TO_DB, O_RDONLY);
     if (fd == -1)
@@ -126,30 +732,74 @@ void process_fifo()
         perror("Error opening FIFO");
         return;
     }
+    fcntl(fd, F_SETPIPE_SZ, FIFO_PIPE_SIZE);                         /* Best effort, the default is 64 KiB anyway */
 
-    char line[256];
-    while (1)
+    record_reader_init(&reader, fd);
+    while (!stop_requested)
     {
-        /* Read data from the FIFO */
-        ssize_t bytes_read = read(fd, line, sizeof(line) - 1);
+        /* Idle with unsaved rollups or states, or open sessions: write them instead of holding them back */
+        if (rollup.pending > 0 || sensor_state.table.listed_count > 0 || billing.open > 0 || compactor.table.listed_count > 0)
+        {
+            struct pollfd pfd   = { .fd = fd, .events = POLLIN };
+            int           ready = poll(&pfd, 1, ROLLUP_FLUSH_MS);
+            if (ready == 0)
+            {
+                idle_flush();
+                continue;
+            }
+            if (ready < 0 && errno == EINTR)
+            {
+                continue;                                            /* Check for a stop before blocking in read() */
+            }
+        }
+
+        /* Read a chunk from the FIFO and process every complete record in it */
+        ssize_t bytes_read = record_reader_fill(&reader);
         if (bytes_read > 0)
         {
-            /* Null-terminate the line and process it */
-            line[bytes_read] = '\0';
-            process_line(line);
+            PRK_TP_SCOPE(PRK_TP_INS_FIFO, bytes_read, 0);
+            uint64_t    started = prk_metrics_now_ns();
+            int         queued;
+            if (ioctl(fd, FIONREAD, &queued) == 0)
+            {
+                prk_gauge_set(fifo_queued, queued);
+            }
+
+            /* One transaction per chunk instead of one per record */
+            begin_batch();
+            size_t records = record_reader_drain(&reader, process_record, NULL);
+            commit_batch();
+            prk_histogram_observe(batch_records, records);
+            prk_histogram_observe(batch_time, prk_metrics_now_ns() - started);
         }
         else if (bytes_read == 0)
         {
             /* End of file, close and reopen to wait for new data */
+            idle_flush();
             close(fd);
             fd = open(FIFO_TO_DB, O_RDONLY);
             if (fd == -1)
             {
-                perror("Error opening FIFO");
+                if (errno != EINTR)                                  /* EINTR: stopped while waiting for a writer */
+                {
+                    perror("Error opening FIFO");
+                }
                 return;
             }
+            record_reader_reset(&reader, fd);
+        }
+        else if (errno == EINTR)
+        {
+            continue;                                                /* Interrupted by SIGUSR1 or a stop */
+        }
+        else
+        {
+            perror("Error reading FIFO");
+            close(fd);
+            return;
         }
     }
+    close(fd);
 }
 
 /**
@@ -159,10 +809,110 @@ void process_fifo()
  * the data file (optional, can be enabled by uncommenting the corresponding line),
  * and then processes data from the FIFO.
  *
+ * An optional argument selects the storage backend for readings
+ * (STORE_BACKEND_SQLITE or STORE_BACKEND_TSDB, default STORE_BACKEND).
+ * With --replay <log> the records of a dead-letter log are reprocessed
+ * and the program exits instead of reading the FIFO. --compact stores
+ * only state changes (see event_compactor.h), tuned by --move-threshold,
+ * --hysteresis and --keepalive; --archive appends every accepted raw
+ * record to a text file.
+ *
  * Return: 0 on success, exits with failure code otherwise
  */
-int main()
+int main(int argc, char *argv[])
 {
+    const char *backend = STORE_BACKEND;
+    const char *replay  = NULL;
+
+    event_compactor_default_config(&compact_config);
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replay = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compact") == 0)
+        {
+            compact_config.enabled = 1;
+        }
+        else if (strcmp(argv[i], "--move-threshold") == 0 && i + 1 < argc)
+        {
+            compact_config.move_threshold = (int32_t)(atof(argv[++i]) * COORD_SCALE);
+        }
+        else if (strcmp(argv[i], "--hysteresis") == 0 && i + 1 < argc)
+        {
+            compact_config.hysteresis = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--keepalive") == 0 && i + 1 < argc)
+        {
+            compact_config.keepalive_ms = (int64_t)(atof(argv[++i]) * 1000);
+        }
+        else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+        {
+            compact_config.archive_path = argv[++i];
+        }
+        else if (argv[i][0] != '-')
+        {
+            backend = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [sqlite|tsdb] [--replay <dead_letter_log>] [--compact]\n"
+                            "       [--move-threshold <distance>] [--hysteresis <readings>] [--keepalive <s>]\n"
+                            "       [--archive <path>]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Metrics page, read by out_metrics_exporter; a replay keeps its own private */
+    if (!replay)
+    {
+        prk_metrics_open("inserter");
+        PRK_TP_OPEN("inserter");
+    }
+    register_metrics();
+    if (trace_sink_init(&traces, !replay) != 0)                      /* Replayed records carry old stamps */
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    /* Open the database once for the lifetime of the program */
+    if (open_database(DB_PATH, backend) != 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    /* Rejected records are logged and counted instead of printed one by one */
+    if (dead_letter_open(&dead_letters, DEAD_LETTER_PATH) != 0)
+    {
+        close_database();
+        exit(EXIT_FAILURE);
+    }
+
+    /* Best effort: the query service may start later or not at all */
+    query_feed_open(&query_feed, QUERY_FEED_PATH);
+
+    if (replay)
+    {
+        long replayed = replay_dead_letters(replay);
+        printf("Replayed %ld dead-lettered record(s) from %s.\n", replayed, replay);
+        print_counters();
+        query_feed_close(&query_feed);
+        dead_letter_close(&dead_letters);
+        close_database();
+        trace_sink_free(&traces);
+        return replayed < 0 ? EXIT_FAILURE : 0;
+    }
+
+    /* SIGUSR1 prints the ingest and duplicate counters */
+    signal(SIGUSR1, report_handler);
+
+    /* SIGTERM and SIGINT interrupt the FIFO read (no SA_RESTART) and stop the loop */
+    struct sigaction stop = { .sa_handler = stop_handler };
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGTERM, &stop, NULL);
+    sigaction(SIGINT, &stop, NULL);
+
     /* Create FIFO if it doesn't exist */
     if (access(FIFO_TO_DB, F_OK) == -1)
     {
@@ -180,9 +930,18 @@ int main()
 
     /* Process data from the FIFO */
     printf("Waiting for data from FIFO...\n");
+    fflush(stdout);
+    prk_notify_ready();
     process_fifo();
     printf("FIFO data processed.\n");
 
+    print_counters();
+    query_feed_close(&query_feed);
+    dead_letter_close(&dead_letters);
+    close_database();
+    trace_sink_free(&traces);
+    PRK_TP_CLOSE();
+    prk_metrics_close();
     return 0;
 }
 
@@ -6,16 +6,17 @@
  * The program also handles clean termination on receiving a SIGINT signal.
  *
  * Compilation:
- *      gcc listener.c -o out_listener
+ *      gcc listener.c record_ring.c -o out_listener
  *
  * Usage:
  *      ./out_listener
  *
  * Features:
- * - Reads data from shared memory segment defined by SHM_KEY.
- * - Monitors the data for changes.
+ * - Looks at the record ring out_server queues records in (record_ring.h).
+ * - Monitors it for new records.
  * - Sends notifications to a FIFO defined by FIFO_NAME when data changes.
  * - Handles termination signals to clean up resources.
+ * - Keeps its metrics in the shm page "listener" (prk_metrics.h).
  *
  * Version: v1.0
  * Date:    20-05-2024
@@ -23,17 +24,21 @@
  *                                   
  * Date:            Name:               Version:        Modification:
  *   20-05-2024       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            watch the head of the record ring
+ *   19-10-2026       Morris              v1.2            readiness notification to prk_sys_srv_run
+ *   19-10-2026       Morris              v1.3            metrics (prk_metrics.h): checks, changes,
+ *                                                        notification time
  *
  */
 
 
 #include "../inc/listener.h"
+#include "../inc/prk_notify.h"
+#include "../inc/prk_metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <string.h>
@@ -52,19 +57,10 @@ void signal_handler(int signum)
 
 int main()
 {
-    /* Get shared memory ID */
-    int shm_id = shmget(SHM_KEY, sizeof(struct shared_data), 0666);
-    if (shm_id == -1)
+    /* Attach the record ring of out_server */
+    RecordRing *ring = record_ring_attach();
+    if (!ring)
     {
-        perror("shmget");
-        exit(EXIT_FAILURE);
-    }
-
-    /* Attach shared memory segment */
-    struct shared_data *shm_data = (struct shared_data *)shmat(shm_id, NULL, 0);
-    if (shm_data == (void *)-1)
-    {
-        perror("shmat");
         exit(EXIT_FAILURE);
     }
 
@@ -79,20 +75,31 @@ int main()
         }
     }
 
+    /* Metrics page, read by out_metrics_exporter */
+    prk_metrics_open("listener");
+    PrkCounter      checks      = prk_counter("prk_listener_checks_total", "Shared memory checks.");
+    PrkCounter      changes     = prk_counter("prk_listener_changes_total", "Changes notified on the FIFO.");
+    PrkHistogram    notify_time = prk_histogram("prk_listener_notify_seconds",
+                                                "Time to open the FIFO and write a notification.", PRK_SCALE_NS);
+
     /* Set up signal handler for SIGINT */
     signal(SIGINT, signal_handler);
+    prk_notify_ready();
 
-    char last_data[BUFFER_SIZE] = "";                                /* Buffer to store last read data */
+    uint32_t last_head = atomic_load(&ring->head);                   /* Records pushed at the last check */
     while (running)
     {
         sleep(10);                                                   /* Sleep for 10 seconds */
 
-        /* Check if data has changed */
-        if (strcmp(last_data, shm_data->data) != 0)
+        /* Check if records were pushed */
+        prk_counter_inc(checks);
+        uint32_t head = atomic_load(&ring->head);
+        if (head != last_head)
         {
-            strcpy(last_data, shm_data->data);                       /* Update last data */
+            last_head = head;
 
             /* Write notification to FIFO */
+            uint64_t started = prk_metrics_now_ns();
             int fd = open(FIFO_NAME, O_WRONLY);
             if (fd == -1)
             {
@@ -101,12 +108,15 @@ int main()
             }
             write(fd, "data received\n", 15);                        /* Write notification */
             close(fd);
+            prk_histogram_observe(notify_time, prk_metrics_now_ns() - started);
+            prk_counter_inc(changes);
         }
     }
 
     /* Detach shared memory segment */
-    shmdt(shm_data);
+    record_ring_detach(ring);
     unlink(FIFO_NAME);                                               /* Remove the FIFO file */
+    prk_metrics_close();
 
     puts("");
     return 0;
@@ -0,0 +1,1078 @@
+/**
+ * load_gen.c: Fleet of simulated BBG gateways loading out_server on localhost
+ *
+ * out_server could only be fed by real gateways. This program opens up to
+ * LOAD_GEN_MAX_GATEWAYS connections to it over the loopback interface,
+ * each sending readings as tcp_client does at a set rate, and reports the
+ * throughput reached, the records dropped and latency quantiles.
+ *
+ * Compilation:
+ *      gcc load_gen.c prk_metrics.c prk_trace.c -o out_load_gen -lpthread -lrt -lm
+ *
+ * Usage:
+ *      ./out_load_gen [--gateways <n>] [--rate <records/s>] [--burst <n>] [--poisson]
+ *                     [--duration <s>] [--ramp <s>] [--threads <n>] [--port <port>]
+ *                     [--reconnect-every <records>] [--reconnect-delay <ms>]
+ *                     [--max-delay <ms>] [--trace-every <n>] [--interval <s>]
+ *
+ * Features:
+ * - Each gateway has its own connection, MAC address and sequence numbers,
+ *   and sends "<mac>: <status>: x <x> y <y> z <z> seq <n>\n" records.
+ * - --rate records per second per gateway, in bursts of --burst records
+ *   sent back to back, evenly spaced or, with --poisson, at exponential
+ *   intervals. The gateways start over --ramp seconds.
+ * - Connections come from LOAD_GEN_SOURCE_ADDRS loopback addresses, so
+ *   100k of them fit in the ephemeral port range.
+ * - A lost connection is made again after 100 ms, doubling up to 5 s, and
+ *   the records it left unacknowledged are sent again, as tcp_client does.
+ *   --reconnect-every closes each connection after that many records.
+ * - out_server never answers: a record is acknowledged once the server's
+ *   TCP stack has acknowledged its last byte (SIOCOUTQ, polled every
+ *   LOAD_GEN_TICK_MS). Latencies are counted from the time a record fell
+ *   due, so a stalled server shows in them instead of slowing the load.
+ * - Drops: records older than --max-delay skipped unsent, records due and
+ *   never sent, records unacknowledged at the end, and records sent that
+ *   out_server did not count (from its metrics page).
+ * - --trace-every <n> traces one new record in n (prk_trace.h), for
+ *   out_trace_report to follow through the stages behind the server.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/load_gen.h"
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/sockios.h>                                           /* SIOCOUTQ */
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#ifndef IP_BIND_ADDRESS_NO_PORT
+#define IP_BIND_ADDRESS_NO_PORT 24                                   /* linux/in.h, Linux 4.2 */
+#endif
+
+
+/* Flag to control the main loop */
+static volatile sig_atomic_t running = 1;
+
+/* Workers finished, read by the progress loop */
+static _Atomic uint32_t workers_done;
+
+static struct sockaddr_in server_addr;
+
+
+/* Signal handler for graceful shutdown */
+static void signal_handler(int signum)
+{
+    (void)signum;
+    running = 0;
+}
+
+/**
+ * now_ns - CLOCK_MONOTONIC in nanoseconds.
+ */
+static int64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * uniform - Random number in (0, 1], xorshift64.
+ */
+static double uniform(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (double)((x >> 11) + 1) / 9007199254740992.0;            /* 2^53 */
+}
+
+/**
+ * stat_add - Add @n to a statistic of the calling worker.
+ */
+static inline void stat_add(_Atomic uint64_t *value, uint64_t n)
+{
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/**
+ * count_add - Add @n to a counter of a worker.
+ */
+static inline void count_add(LgWorker *worker, lg_counter_t counter, uint64_t n)
+{
+    stat_add(&worker->stats.counters[counter], n);
+}
+
+/**
+ * observe - Record a latency in a histogram of a worker.
+ */
+static void observe(LgWorker *worker, lg_hist_t hist, int64_t ns)
+{
+    uint64_t value = ns > 0 ? (uint64_t)ns : 0;
+
+    stat_add(&worker->stats.buckets[hist][prk_histogram_bucket(value)], 1);
+    if (value > atomic_load_explicit(&worker->stats.max_ns[hist], memory_order_relaxed))
+    {
+        atomic_store_explicit(&worker->stats.max_ns[hist], value, memory_order_relaxed);
+    }
+}
+
+/**
+ * heap_swap - Exchange two entries of a worker's timer heap.
+ */
+static void heap_swap(LgWorker *worker, uint32_t a, uint32_t b)
+{
+    uint32_t tmp      = worker->heap[a];
+    worker->heap[a]   = worker->heap[b];
+    worker->heap[b]   = tmp;
+    worker->gateways[worker->heap[a]].timer_pos = (int32_t)a;
+    worker->gateways[worker->heap[b]].timer_pos = (int32_t)b;
+}
+
+/**
+ * heap_fix - Move a heap entry up or down to its place.
+ */
+static void heap_fix(LgWorker *worker, uint32_t pos)
+{
+    LgGateway *gw = worker->gateways;
+
+    while (pos > 0 && gw[worker->heap[pos]].timer_ns < gw[worker->heap[(pos - 1) / 2]].timer_ns)
+    {
+        heap_swap(worker, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    for (;;)
+    {
+        uint32_t least = pos;
+        uint32_t left  = 2 * pos + 1;
+        uint32_t right = left + 1;
+        if (left < worker->heap_len && gw[worker->heap[left]].timer_ns < gw[worker->heap[least]].timer_ns)
+        {
+            least = left;
+        }
+        if (right < worker->heap_len && gw[worker->heap[right]].timer_ns < gw[worker->heap[least]].timer_ns)
+        {
+            least = right;
+        }
+        if (least == pos)
+        {
+            return;
+        }
+        heap_swap(worker, pos, least);
+        pos = least;
+    }
+}
+
+/**
+ * timer_set - Set the one timer of a gateway.
+ */
+static void timer_set(LgWorker *worker, uint32_t i, int64_t at_ns)
+{
+    LgGateway *g = &worker->gateways[i];
+
+    g->timer_ns = at_ns;
+    if (g->timer_pos < 0)
+    {
+        g->timer_pos = (int32_t)worker->heap_len;
+        worker->heap[worker->heap_len++] = i;
+    }
+    heap_fix(worker, (uint32_t)g->timer_pos);
+}
+
+/**
+ * timer_clear - Cancel the timer of a gateway, if it has one.
+ */
+static void timer_clear(LgWorker *worker, uint32_t i)
+{
+    LgGateway *g   = &worker->gateways[i];
+    int32_t   pos  = g->timer_pos;
+
+    if (pos < 0)
+    {
+        return;
+    }
+    g->timer_pos = -1;
+    if ((uint32_t)pos != --worker->heap_len)
+    {
+        worker->heap[pos] = worker->heap[worker->heap_len];
+        worker->gateways[worker->heap[pos]].timer_pos = pos;
+        heap_fix(worker, (uint32_t)pos);
+    }
+}
+
+/**
+ * advance - Move the due time of a gateway past one record.
+ */
+static void advance(LgWorker *worker, LgGateway *g)
+{
+    const LoadGenConfig *config = worker->config;
+
+    if (--g->burst_left > 0)
+    {
+        return;                                                      /* Same burst, back to back */
+    }
+    g->burst_left = config->burst;
+
+    double gap = config->burst * 1e9 / config->rate;
+    if (config->poisson)
+    {
+        gap *= -log(uniform(&worker->random));
+    }
+    g->due_ns += (int64_t)gap;
+}
+
+/**
+ * lg_format_record - Write a record of a gateway as tcp_client sends it.
+ */
+int lg_format_record(uint32_t index, uint64_t seq, const PrkTrace *trace, char *buf)
+{
+    uint64_t    mac     = LOAD_GEN_MAC_PREFIX | index;
+    char        status  = (seq / LOAD_GEN_STAY_RECORDS) & 1 ? 'D' : 'S';
+    int32_t     x       = (int32_t)(index % 1000) * 250 + (int32_t)(seq % 7);
+    int32_t     y       = (int32_t)(index / 1000 % 1000) * 250 + (int32_t)(seq % 5);
+    char        suffix[PRK_TRACE_TEXT_MAX] = "";
+
+    if (trace && prk_trace_format(trace, suffix, sizeof(suffix)) < 0)
+    {
+        suffix[0] = '\0';
+    }
+
+    /* The reading as data_formatter writes it, the rest as tcp_client */
+    int len = snprintf(buf, LOAD_GEN_RECORD_MAX,
+                       "%02x:%02x:%02x:%02x:%02x:%02x: %c: x %.2f y %.2f z %.2f seq %llu%s\n",
+                       (unsigned)(mac >> 40) & 0xff, (unsigned)(mac >> 32) & 0xff, (unsigned)(mac >> 24) & 0xff,
+                       (unsigned)(mac >> 16) & 0xff, (unsigned)(mac >> 8) & 0xff, (unsigned)mac & 0xff,
+                       status, x / 100.0, y / 100.0, 0.0, (unsigned long long)seq, suffix);
+    if (len >= LOAD_GEN_RECORD_MAX)
+    {
+        len = LOAD_GEN_RECORD_MAX - 1;
+        buf[len - 1] = '\n';
+    }
+    return len;
+}
+
+/**
+ * fail - Drop the connection of a gateway and try again later.
+ */
+static void fail(LgWorker *worker, uint32_t i, lg_counter_t reason, int64_t now)
+{
+    LgGateway *g = &worker->gateways[i];
+
+    if (g->fd >= 0)
+    {
+        close(g->fd);                                                /* Also leaves the epoll set */
+    }
+    if (g->state == LG_CONNECTED)
+    {
+        stat_add(&worker->stats.connected, (uint64_t)-1);
+    }
+    count_add(worker, reason, 1);
+
+    /* Unacknowledged records are sent again on the next connection */
+    g->fd           = -1;
+    g->state        = LG_WAITING;
+    g->blocked      = 0;
+    g->pending_len  = 0;
+    g->pending_off  = 0;
+    g->written      = g->acked;
+    g->conn_bytes   = 0;
+    g->conn_records = 0;
+
+    int64_t delay_ms = (int64_t)LOAD_GEN_RECONNECT_MIN_MS << (g->backoff < 6 ? g->backoff : 6);
+    if (delay_ms > LOAD_GEN_RECONNECT_MAX_MS)
+    {
+        delay_ms = LOAD_GEN_RECONNECT_MAX_MS;
+    }
+    if (g->backoff < UINT8_MAX)
+    {
+        g->backoff++;
+    }
+    timer_set(worker, i, now + delay_ms * 1000000);
+}
+
+/**
+ * start_connect - Open the connection of a gateway.
+ */
+static void start_connect(LgWorker *worker, uint32_t i, int64_t now)
+{
+    LgGateway           *g  = &worker->gateways[i];
+    struct sockaddr_in  source;
+    int                 one = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        fail(worker, i, LG_CONNECT_FAILED, now);
+        return;
+    }
+    g->fd = fd;
+
+    /* The port is chosen at connect(), per source address */
+    memset(&source, 0, sizeof(source));
+    source.sin_family      = AF_INET;
+    source.sin_addr.s_addr = htonl(INADDR_LOOPBACK + g->index % LOAD_GEN_SOURCE_ADDRS);
+    setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&source, sizeof(source)) != 0 ||
+        (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0 && errno != EINPROGRESS))
+    {
+        fail(worker, i, LG_CONNECT_FAILED, now);
+        return;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.u32 = i };
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        fail(worker, i, LG_CONNECT_FAILED, now);
+        return;
+    }
+    g->state      = LG_CONNECTING;
+    g->connect_ns = now;
+    timer_set(worker, i, now + (int64_t)LOAD_GEN_CONNECT_MS * 1000000);
+}
+
+/**
+ * next_record - Put the next record of a gateway in its pending buffer.
+ *
+ * Return: 0 if there is one, -1 if the gateway has nothing to send now.
+ */
+static int next_record(LgWorker *worker, uint32_t i, int64_t now)
+{
+    const LoadGenConfig *config = worker->config;
+    LgGateway           *g      = &worker->gateways[i];
+
+    /* Records of a lost connection first */
+    if (g->written < g->generated)
+    {
+        g->pending_len = (uint16_t)lg_format_record(g->index, g->window[g->written % LOAD_GEN_WINDOW].seq, NULL,
+                                                    g->pending);
+        g->replay      = 1;
+        return 0;
+    }
+    if ((config->reconnect_every && g->conn_records >= config->reconnect_every) ||
+        g->generated - g->acked >= LOAD_GEN_WINDOW)
+    {
+        return -1;                                                   /* Until the acknowledgements */
+    }
+
+    /* Readings the gateway could not send in time are lost */
+    while (g->due_ns < worker->end_ns && now - g->due_ns > config->max_delay_ms * 1000000)
+    {
+        g->seq_next++;
+        advance(worker, g);
+        count_add(worker, LG_RECORDS_STALE, 1);
+    }
+    if (g->due_ns >= worker->end_ns)
+    {
+        return -1;
+    }
+    if (g->due_ns > now)
+    {
+        timer_set(worker, i, g->due_ns);
+        return -1;
+    }
+
+    LgSlot      *slot = &g->window[g->generated % LOAD_GEN_WINDOW];
+    PrkTrace    trace;
+    PrkTrace    *traced = NULL;
+
+    slot->due_ns = g->due_ns;
+    slot->seq    = g->seq_next++;
+    g->generated++;
+    worker->outstanding++;
+    advance(worker, g);
+    if (config->trace_every && worker->traced++ % config->trace_every == 0)
+    {
+        prk_trace_begin(&trace);
+        prk_trace_stamp(&trace, PRK_TRACE_TCP);
+        traced = &trace;
+        count_add(worker, LG_RECORDS_TRACED, 1);
+    }
+    g->pending_len = (uint16_t)lg_format_record(g->index, slot->seq, traced, g->pending);
+    g->replay      = 0;
+    return 0;
+}
+
+/**
+ * pump - Write records of a connected gateway until it has none due or
+ *        its socket is full.
+ */
+static void pump(LgWorker *worker, uint32_t i, int64_t now)
+{
+    LgGateway *g = &worker->gateways[i];
+
+    while (g->state == LG_CONNECTED && !g->blocked)
+    {
+        if (g->pending_len == 0 && next_record(worker, i, now) != 0)
+        {
+            return;
+        }
+
+        ssize_t sent = send(g->fd, g->pending + g->pending_off, (size_t)(g->pending_len - g->pending_off),
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                g->blocked = 1;
+            }
+            else if (errno != EINTR)
+            {
+                fail(worker, i, LG_CONNECTIONS_LOST, now);
+            }
+            continue;
+        }
+        count_add(worker, LG_BYTES_SENT, (uint64_t)sent);
+        g->pending_off += (uint16_t)sent;
+        if (g->pending_off < g->pending_len)
+        {
+            g->blocked = 1;                                          /* Socket full mid-record */
+            continue;
+        }
+
+        /* Whole record written: acknowledged once the server has its last byte */
+        LgSlot *slot = &g->window[g->written % LOAD_GEN_WINDOW];
+        g->conn_bytes  += g->pending_len;
+        slot->end       = (uint32_t)g->conn_bytes;
+        g->written++;
+        g->conn_records++;
+        g->pending_len  = 0;
+        g->pending_off  = 0;
+        count_add(worker, LG_RECORDS_SENT, 1);
+        if (g->replay)
+        {
+            count_add(worker, LG_RECORDS_REPLAYED, 1);
+        }
+        else
+        {
+            observe(worker, LG_HIST_SEND, now - slot->due_ns);
+        }
+        if (!g->unacked)
+        {
+            g->unacked = 1;
+            worker->unacked[worker->unacked_len++] = i;
+        }
+    }
+}
+
+/**
+ * close_on_purpose - Close a connection after --reconnect-every records.
+ */
+static void close_on_purpose(LgWorker *worker, uint32_t i, int64_t now)
+{
+    LgGateway *g = &worker->gateways[i];
+
+    shutdown(g->fd, SHUT_WR);
+    close(g->fd);
+    stat_add(&worker->stats.connected, (uint64_t)-1);
+    count_add(worker, LG_CONNECTIONS_CLOSED, 1);
+    g->fd           = -1;
+    g->state        = LG_WAITING;
+    g->conn_bytes   = 0;
+    g->conn_records = 0;
+    timer_set(worker, i, now + worker->config->reconnect_delay_ms * 1000000);
+}
+
+/**
+ * poll_acks - Collect the acknowledgements of the gateways with records
+ *             unacknowledged.
+ */
+static void poll_acks(LgWorker *worker, int64_t now)
+{
+    const LoadGenConfig *config = worker->config;
+    uint32_t            listed  = worker->unacked_len;
+    uint32_t            kept    = 0;
+
+    for (uint32_t k = 0; k < listed; k++)
+    {
+        uint32_t    i         = worker->unacked[k];
+        LgGateway   *g        = &worker->gateways[i];
+        uint64_t    before    = g->acked;
+        int         queued    = 0;
+
+        if (g->state == LG_CONNECTED && g->written > g->acked && ioctl(g->fd, SIOCOUTQ, &queued) == 0)
+        {
+            uint32_t delivered = (uint32_t)(g->conn_bytes - (uint64_t)queued);
+            while (g->acked < g->written &&
+                   (int32_t)(delivered - g->window[g->acked % LOAD_GEN_WINDOW].end) >= 0)
+            {
+                observe(worker, LG_HIST_ACK, now - g->window[g->acked % LOAD_GEN_WINDOW].due_ns);
+                g->acked++;
+            }
+            count_add(worker, LG_RECORDS_ACKED, g->acked - before);
+            worker->outstanding -= g->acked - before;
+        }
+
+        if (g->state == LG_CONNECTED && g->written > g->acked)
+        {
+            worker->unacked[kept++] = i;
+        }
+        else
+        {
+            g->unacked = 0;
+        }
+        if (g->acked != before && g->state == LG_CONNECTED)
+        {
+            if (config->reconnect_every && g->conn_records >= config->reconnect_every && g->acked == g->generated)
+            {
+                close_on_purpose(worker, i, now);
+            }
+            else
+            {
+                pump(worker, i, now);                                /* The window opened */
+            }
+        }
+    }
+
+    /* Gateways listed by pump() meanwhile */
+    uint32_t added = worker->unacked_len - listed;
+    memmove(worker->unacked + kept, worker->unacked + listed, added * sizeof(*worker->unacked));
+    worker->unacked_len = kept + added;
+}
+
+/**
+ * handle_event - Act on the epoll event of a gateway.
+ */
+static void handle_event(LgWorker *worker, uint32_t i, uint32_t events, int64_t now)
+{
+    LgGateway *g = &worker->gateways[i];
+
+    if (g->state == LG_CONNECTING)
+    {
+        int         error = 0;
+        socklen_t   len   = sizeof(error);
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+        {
+            return;
+        }
+        if (getsockopt(g->fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0 || (events & EPOLLHUP))
+        {
+            fail(worker, i, LG_CONNECT_FAILED, now);
+            return;
+        }
+        timer_clear(worker, i);
+        observe(worker, LG_HIST_CONNECT, now - g->connect_ns);
+        count_add(worker, LG_CONNECTS, 1);
+        stat_add(&worker->stats.connected, 1);
+        g->state   = LG_CONNECTED;
+        g->backoff = 0;
+        g->blocked = 0;
+        pump(worker, i, now);
+        return;
+    }
+    if (g->state != LG_CONNECTED)
+    {
+        return;                                                      /* Closed earlier in this batch */
+    }
+
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        fail(worker, i, LG_CONNECTIONS_LOST, now);
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP))
+    {
+        char    discard[256];                                        /* The server sends nothing */
+        ssize_t got;
+        while ((got = recv(g->fd, discard, sizeof(discard), MSG_DONTWAIT)) > 0)
+        {
+        }
+        if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            fail(worker, i, LG_CONNECTIONS_LOST, now);
+            return;
+        }
+    }
+    if ((events & EPOLLOUT) && g->blocked)
+    {
+        g->blocked = 0;
+        pump(worker, i, now);
+    }
+}
+
+/**
+ * finish - Account for what the gateways of a worker left undone.
+ */
+static void finish(LgWorker *worker)
+{
+    for (uint32_t i = 0; i < worker->count; i++)
+    {
+        LgGateway *g = &worker->gateways[i];
+
+        count_add(worker, LG_RECORDS_UNACKED, g->generated - g->acked);
+        while (g->due_ns < worker->end_ns)
+        {
+            count_add(worker, LG_RECORDS_UNSENT, 1);
+            advance(worker, g);
+        }
+        if (g->fd >= 0)
+        {
+            close(g->fd);
+            g->fd = -1;
+        }
+        if (g->state == LG_CONNECTED)
+        {
+            stat_add(&worker->stats.connected, (uint64_t)-1);
+        }
+        g->state = LG_WAITING;
+    }
+}
+
+/**
+ * lg_run_worker - Drive the gateways of a worker until the run and the
+ *                 drain after it are over.
+ */
+void *lg_run_worker(void *arg)
+{
+    LgWorker            *worker   = arg;
+    struct epoll_event  events[LOAD_GEN_EPOLL_EVENTS];
+    int64_t             drain_ns  = worker->end_ns + (int64_t)LOAD_GEN_DRAIN_MS * 1000000;
+    int64_t             poll_ns   = 0;
+
+    for (;;)
+    {
+        int64_t now = now_ns();
+        if (!running && worker->end_ns > now)
+        {
+            worker->end_ns = now;                                    /* Interrupted: drain now */
+            drain_ns       = now + (int64_t)LOAD_GEN_DRAIN_MS * 1000000;
+        }
+        if (now >= worker->end_ns && (worker->outstanding == 0 || now >= drain_ns))
+        {
+            break;
+        }
+
+        int timeout = LOAD_GEN_TICK_MS;
+        if (worker->heap_len > 0 && worker->gateways[worker->heap[0]].timer_ns <= now)
+        {
+            timeout = 0;
+        }
+        int ready = epoll_wait(worker->epoll_fd, events, LOAD_GEN_EPOLL_EVENTS, timeout);
+
+        now = now_ns();
+        for (int e = 0; e < ready; e++)
+        {
+            handle_event(worker, events[e].data.u32, events[e].events, now);
+        }
+
+        /* Timers due: connect, give up connecting, or a record due */
+        while (worker->heap_len > 0 && worker->gateways[worker->heap[0]].timer_ns <= now)
+        {
+            uint32_t i = worker->heap[0];
+            timer_clear(worker, i);
+            switch (worker->gateways[i].state)
+            {
+                case LG_WAITING:
+                    start_connect(worker, i, now);
+                    break;
+                case LG_CONNECTING:
+                    fail(worker, i, LG_CONNECT_TIMEOUTS, now);
+                    break;
+                default:
+                    pump(worker, i, now);
+                    break;
+            }
+        }
+
+        if (now >= poll_ns)
+        {
+            poll_acks(worker, now);
+            poll_ns = now + (int64_t)LOAD_GEN_TICK_MS * 1000000;
+        }
+    }
+
+    finish(worker);
+    atomic_fetch_add(&workers_done, 1);
+    return NULL;
+}
+
+/**
+ * sum_stats - Statistics of every worker added up.
+ */
+static void sum_stats(const LgWorker *workers, uint32_t count, LoadGenStats *total)
+{
+    memset(total, 0, sizeof(*total));
+    for (uint32_t w = 0; w < count; w++)
+    {
+        const LoadGenStats *stats = &workers[w].stats;
+        for (int c = 0; c < LG_COUNTER_COUNT; c++)
+        {
+            total->counters[c] += atomic_load_explicit(&stats->counters[c], memory_order_relaxed);
+        }
+        total->connected += atomic_load_explicit(&stats->connected, memory_order_relaxed);
+        for (int h = 0; h < LG_HIST_COUNT; h++)
+        {
+            uint64_t max = atomic_load_explicit(&stats->max_ns[h], memory_order_relaxed);
+            if (max > total->max_ns[h])
+            {
+                total->max_ns[h] = max;
+            }
+            for (unsigned b = 0; b < PRK_HISTOGRAM_BUCKETS; b++)
+            {
+                total->buckets[h][b] += atomic_load_explicit(&stats->buckets[h][b], memory_order_relaxed);
+            }
+        }
+    }
+}
+
+/**
+ * quantile_ms - Quantile of the difference of two snapshots of a histogram.
+ */
+static double quantile_ms(const LoadGenStats *now, const LoadGenStats *before, lg_hist_t hist, double q,
+                          uint64_t *count)
+{
+    uint64_t buckets[PRK_HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+
+    for (unsigned b = 0; b < PRK_HISTOGRAM_BUCKETS; b++)
+    {
+        buckets[b] = now->buckets[hist][b] - (before ? before->buckets[hist][b] : 0);
+        total     += buckets[b];
+    }
+    if (count)
+    {
+        *count = total;
+    }
+    double ns = prk_histogram_quantile(buckets, total, q);
+    return (ns < (double)now->max_ns[hist] ? ns : (double)now->max_ns[hist]) / 1e6;   /* Buckets are coarser */
+}
+
+/**
+ * lg_report - Print totals, drops and latency quantiles of a run.
+ */
+void lg_report(const LoadGenConfig *config, const LoadGenStats *total, double elapsed, int64_t server, FILE *out)
+{
+    static const char   *names[LG_HIST_COUNT]   = { "connect", "send (due to written)", "ack (due to acknowledged)" };
+    static const double quantiles[]              = { 0.5, 0.9, 0.99, 0.999 };
+    const uint64_t      *c                       = (const uint64_t *)total->counters;
+    uint64_t            sent                     = c[LG_RECORDS_SENT];
+
+    fprintf(out, "Load: %u gateway(s), %.2f records/s each in bursts of %u (%s), %.1f s after a %.1f s ramp, "
+            "%u thread(s)\n", config->gateways, config->rate, config->burst, config->poisson ? "poisson" : "even",
+            config->duration_s, config->ramp_s, config->threads);
+    fprintf(out, "Connections: %llu made, %llu failed, %llu timed out, %llu lost, %llu closed on purpose\n",
+            (unsigned long long)c[LG_CONNECTS], (unsigned long long)c[LG_CONNECT_FAILED],
+            (unsigned long long)c[LG_CONNECT_TIMEOUTS], (unsigned long long)c[LG_CONNECTIONS_LOST],
+            (unsigned long long)c[LG_CONNECTIONS_CLOSED]);
+    fprintf(out, "Records: %llu sent in %.1f s, %.1f/s, %.2f MB/s; %llu acknowledged, %llu replayed, %llu traced\n",
+            (unsigned long long)sent, elapsed, elapsed > 0 ? sent / elapsed : 0.0,
+            elapsed > 0 ? c[LG_BYTES_SENT] / elapsed / 1e6 : 0.0, (unsigned long long)c[LG_RECORDS_ACKED],
+            (unsigned long long)c[LG_RECORDS_REPLAYED], (unsigned long long)c[LG_RECORDS_TRACED]);
+    fprintf(out, "Dropped: %llu stale (due over %lld ms before they could be sent), %llu never sent, "
+            "%llu unacknowledged at the end\n", (unsigned long long)c[LG_RECORDS_STALE],
+            (long long)config->max_delay_ms, (unsigned long long)c[LG_RECORDS_UNSENT],
+            (unsigned long long)c[LG_RECORDS_UNACKED]);
+    if (server >= 0)
+    {
+        fprintf(out, "Server: %lld records counted by out_server, %.2f%% of those sent\n", (long long)server,
+                sent ? 100.0 * (double)server / (double)sent : 0.0);
+    }
+    else
+    {
+        fprintf(out, "Server: records counted by out_server unknown (no metrics page, restarted or another port)\n");
+    }
+
+    fprintf(out, "%-28s %10s %10s %10s %10s %10s %10s\n", "Latency (ms)", "count", "p50", "p90", "p99", "p999",
+            "max");
+    for (int h = 0; h < LG_HIST_COUNT; h++)
+    {
+        uint64_t count;
+        quantile_ms(total, NULL, (lg_hist_t)h, 0.5, &count);
+        fprintf(out, "%-28s %10llu", names[h], (unsigned long long)count);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+        {
+            fprintf(out, " %10.3f", quantile_ms(total, NULL, (lg_hist_t)h, quantiles[q], NULL));
+        }
+        fprintf(out, " %10.3f\n", (double)total->max_ns[h] / 1e6);
+    }
+}
+
+/**
+ * server_records - Records counted by out_server so far, -1 without its page.
+ */
+static int64_t server_records(void)
+{
+    const PrkMetricsPage    *page   = prk_metrics_map(LOAD_GEN_SERVER_STAGE);
+    int64_t                 records = -1;
+
+    if (!page)
+    {
+        return -1;
+    }
+    uint32_t metrics = atomic_load_explicit(&page->count, memory_order_acquire);
+    for (uint32_t m = 0; m < metrics && m < PRK_METRICS_MAX; m++)
+    {
+        if (page->metrics[m].type == PRK_METRIC_COUNTER && strcmp(page->metrics[m].name, LOAD_GEN_SERVER_RECORDS) == 0)
+        {
+            records = (int64_t)prk_counter_read(page, &page->metrics[m]);
+            break;
+        }
+    }
+    prk_metrics_unmap(page);
+    return records;
+}
+
+/**
+ * usage - Print the command line and fail.
+ */
+static int usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--gateways <n>] [--rate <records/s>] [--burst <n>] [--poisson]\n"
+            "       [--duration <s>] [--ramp <s>] [--threads <n>] [--port <port>]\n"
+            "       [--reconnect-every <records>] [--reconnect-delay <ms>]\n"
+            "       [--max-delay <ms>] [--trace-every <n>] [--interval <s>]\n", program);
+    return 1;
+}
+
+/**
+ * main - Entry point of the program
+ *
+ * Return: 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    LoadGenConfig config =
+    {
+        .gateways = 100, .threads = 1, .rate = 10.0, .burst = 1, .duration_s = 10.0, .ramp_s = 1.0,
+        .port = LOAD_GEN_PORT, .max_delay_ms = 5000, .interval_s = 1.0
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--poisson") == 0)
+        {
+            config.poisson = 1;
+            continue;
+        }
+        if (!value)
+        {
+            return usage(argv[0]);
+        }
+        if (strcmp(argv[i], "--gateways") == 0)
+        {
+            config.gateways = (uint32_t)atol(value);
+        }
+        else if (strcmp(argv[i], "--rate") == 0)
+        {
+            config.rate = atof(value);
+        }
+        else if (strcmp(argv[i], "--burst") == 0)
+        {
+            config.burst = (uint32_t)atol(value);
+        }
+        else if (strcmp(argv[i], "--duration") == 0)
+        {
+            config.duration_s = atof(value);
+        }
+        else if (strcmp(argv[i], "--ramp") == 0)
+        {
+            config.ramp_s = atof(value);
+        }
+        else if (strcmp(argv[i], "--threads") == 0)
+        {
+            config.threads = (uint32_t)atol(value);
+        }
+        else if (strcmp(argv[i], "--port") == 0)
+        {
+            config.port = (uint16_t)atoi(value);
+        }
+        else if (strcmp(argv[i], "--reconnect-every") == 0)
+        {
+            config.reconnect_every = (uint64_t)atoll(value);
+        }
+        else if (strcmp(argv[i], "--reconnect-delay") == 0)
+        {
+            config.reconnect_delay_ms = atoll(value);
+        }
+        else if (strcmp(argv[i], "--max-delay") == 0)
+        {
+            config.max_delay_ms = atoll(value);
+        }
+        else if (strcmp(argv[i], "--trace-every") == 0)
+        {
+            config.trace_every = (uint32_t)atol(value);
+        }
+        else if (strcmp(argv[i], "--interval") == 0)
+        {
+            config.interval_s = atof(value);
+        }
+        else
+        {
+            return usage(argv[0]);
+        }
+        i++;
+    }
+    if (config.gateways < 1 || config.gateways > LOAD_GEN_MAX_GATEWAYS || config.threads < 1 ||
+        config.threads > LOAD_GEN_MAX_THREADS || config.threads > config.gateways || !(config.rate > 0.0) ||
+        config.burst < 1 || !(config.duration_s > 0.0) || config.ramp_s < 0.0 || config.port == 0 ||
+        config.reconnect_delay_ms < 0 || config.max_delay_ms < 0 || config.interval_s < 0.0)
+    {
+        return usage(argv[0]);
+    }
+
+    /* A descriptor per gateway, and some */
+    struct rlimit limit;
+    rlim_t        needed = (rlim_t)config.gateways + 64 + 2 * config.threads;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < needed)
+    {
+        limit.rlim_cur = limit.rlim_max < needed ? limit.rlim_max : needed;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        if (limit.rlim_cur < needed)
+        {
+            fprintf(stderr, "%u gateways need %llu file descriptors, the limit is %llu: raise it (ulimit -n)\n",
+                    config.gateways, (unsigned long long)needed, (unsigned long long)limit.rlim_cur);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port   = htons(config.port);
+    inet_pton(AF_INET, LOAD_GEN_HOST, &server_addr.sin_addr);
+
+    LgGateway   *gateways   = calloc(config.gateways, sizeof(*gateways));
+    uint32_t    *heaps      = calloc(config.gateways, sizeof(*heaps));
+    uint32_t    *unacked    = calloc(config.gateways, sizeof(*unacked));
+    LgWorker    *workers    = calloc(config.threads, sizeof(*workers));
+    pthread_t   threads[LOAD_GEN_MAX_THREADS];
+    if (!gateways || !heaps || !unacked || !workers)
+    {
+        perror("calloc");
+        return 1;
+    }
+
+    /* Sequence numbers from the wall clock in us, as tcp_client */
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    uint64_t    seq_base    = (uint64_t)wall.tv_sec * 1000000ULL + (uint64_t)wall.tv_nsec / 1000ULL;
+    int64_t     start_ns    = now_ns();
+    int64_t     end_ns      = start_ns + (int64_t)((config.ramp_s + config.duration_s) * 1e9);
+    int64_t     server_base = config.port == LOAD_GEN_PORT ? server_records() : -1;
+    uint32_t    first       = 0;
+
+    for (uint32_t w = 0; w < config.threads; w++)
+    {
+        LgWorker *worker  = &workers[w];
+        uint32_t count    = config.gateways / config.threads + (w < config.gateways % config.threads);
+
+        worker->config    = &config;
+        worker->gateways  = gateways + first;
+        worker->count     = count;
+        worker->heap      = heaps + first;
+        worker->unacked   = unacked + first;
+        worker->random    = 0x9e3779b97f4a7c15ull * (w + 1) ^ (uint64_t)start_ns;
+        worker->end_ns    = end_ns;
+        worker->epoll_fd  = epoll_create1(EPOLL_CLOEXEC);
+        if (worker->epoll_fd < 0)
+        {
+            perror("epoll_create1");
+            return 1;
+        }
+
+        /* Gateways start evenly over the ramp, each at its own phase */
+        for (uint32_t i = 0; i < count; i++)
+        {
+            LgGateway   *g      = &worker->gateways[i];
+            uint32_t    index   = first + i;
+            int64_t     start   = start_ns + (int64_t)(config.ramp_s * 1e9 * index / config.gateways);
+
+            g->fd         = -1;
+            g->timer_pos  = -1;
+            g->index      = index;
+            g->seq_next   = seq_base;
+            g->burst_left = config.burst;
+            g->due_ns     = start + (int64_t)(uniform(&worker->random) * config.burst * 1e9 / config.rate);
+            timer_set(worker, i, start);
+        }
+        first += count;
+    }
+
+    printf("Load generator: %u gateway(s) to %s:%u, %.2f records/s each, %u thread(s)\n", config.gateways,
+           LOAD_GEN_HOST, config.port, config.rate, config.threads);
+    for (uint32_t w = 0; w < config.threads; w++)
+    {
+        if (pthread_create(&threads[w], NULL, lg_run_worker, &workers[w]) != 0)
+        {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    /* Progress, once per interval */
+    static LoadGenStats before;
+    static LoadGenStats now;
+    int64_t             stop_ns     = end_ns;
+    int64_t             next_line   = start_ns + (int64_t)(config.interval_s * 1e9);
+    while (atomic_load(&workers_done) < config.threads)
+    {
+        usleep(10000);
+        int64_t t = now_ns();
+        if (!running && t < stop_ns)
+        {
+            stop_ns = t;
+        }
+        if (config.interval_s <= 0.0 || t < next_line)
+        {
+            continue;
+        }
+
+        double seconds = config.interval_s + (double)(t - next_line) / 1e9;
+        sum_stats(workers, config.threads, &now);
+        printf("%7.1f s: %llu/%u connected, %.0f sent/s, %.0f acknowledged/s, %.2f MB/s, ack p99 %.3f ms\n",
+               (double)(t - start_ns) / 1e9, (unsigned long long)now.connected, config.gateways,
+               (double)(now.counters[LG_RECORDS_SENT] - before.counters[LG_RECORDS_SENT]) / seconds,
+               (double)(now.counters[LG_RECORDS_ACKED] - before.counters[LG_RECORDS_ACKED]) / seconds,
+               (double)(now.counters[LG_BYTES_SENT] - before.counters[LG_BYTES_SENT]) / seconds / 1e6,
+               quantile_ms(&now, &before, LG_HIST_ACK, 0.99, NULL));
+        fflush(stdout);
+        before    = now;
+        next_line = t + (int64_t)(config.interval_s * 1e9);
+    }
+    for (uint32_t w = 0; w < config.threads; w++)
+    {
+        pthread_join(threads[w], NULL);
+        close(workers[w].epoll_fd);
+    }
+
+    /* What out_server counted, once it has read what it acknowledged */
+    int64_t server = -1;
+    if (server_base >= 0)
+    {
+        usleep(LOAD_GEN_SETTLE_MS * 1000);
+        int64_t server_now = server_records();
+        server = server_now >= server_base ? server_now - server_base : -1;
+    }
+
+    sum_stats(workers, config.threads, &now);
+    printf("\n");
+    lg_report(&config, &now, (double)(stop_ns - start_ns) / 1e9, server, stdout);
+
+    free(workers);
+    free(unacked);
+    free(heaps);
+    free(gateways);
+    return 0;
+}
@@ -0,0 +1,333 @@
+/**
+ * metrics_exporter.c: Prometheus scrape endpoint for the metrics of every stage
+ *
+ * Each instrumented stage keeps its counters, gauges and histograms in a
+ * shared memory page (see prk_metrics.h). This program reads the pages of
+ * the running stages when it is scraped and answers in the Prometheus
+ * text exposition format, so the stages themselves never format, lock or
+ * serve anything for monitoring.
+ *
+ * Compilation:
+ *      gcc metrics_exporter.c prk_metrics.c prk_notify.c -o out_metrics_exporter -lpthread -lrt
+ *
+ * Usage:
+ *      ./out_metrics_exporter [--listen <addr>] [--port <port>] [--once]
+ *
+ * Features:
+ * - Serves GET METRICS_PATH over HTTP on METRICS_PORT of METRICS_LISTEN_ADDR
+ *   (loopback; --listen 0.0.0.0 for every interface).
+ * - --once writes the metrics to stdout and exits, for a cron job, the
+ *   node_exporter textfile collector or a look by hand.
+ * - Skips the pages of stages that are no longer running.
+ * - Exports its own scrape count and duration as stage "exporter".
+ * - SIGTERM or SIGINT stops it.
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            loopback by default (--listen), client send timeout
+ *
+ */
+
+#define _GNU_SOURCE                                                  /* accept4 */
+#include "../inc/metrics_exporter.h"
+#include "../inc/prk_metrics.h"
+#include "../inc/prk_notify.h"
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static PrkCounter       scrapes;                                     /* Requests answered with the metrics */
+static PrkCounter       not_found;                                   /* Any other request */
+static PrkHistogram     scrape_time;                                 /* Reading and formatting every page */
+
+
+/**
+ * stop_handler - SIGTERM/SIGINT handler, interrupts accept().
+ */
+static void stop_handler(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
+
+/**
+ * compare_names - qsort() order of stage names.
+ */
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/**
+ * write_metrics - Write the metrics of every running stage.
+ */
+int write_metrics(FILE *out)
+{
+    const char              *prefix = PRK_METRICS_PREFIX + 1;        /* Listed without the leading '/' */
+    size_t                  prefix_len = strlen(prefix);
+    char                    *stages[METRICS_MAX_STAGES];
+    const PrkMetricsPage    *pages[METRICS_MAX_STAGES];
+    size_t                  count = 0, mapped = 0;
+
+    DIR *dir = opendir(METRICS_SHM_DIR);
+    if (!dir)
+    {
+        perror(METRICS_SHM_DIR);
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < METRICS_MAX_STAGES)
+    {
+        if (strncmp(entry->d_name, prefix, prefix_len) == 0 && entry->d_name[prefix_len] != '\0')
+        {
+            stages[count++] = strdup(entry->d_name + prefix_len);
+        }
+    }
+    closedir(dir);
+    qsort(stages, count, sizeof(stages[0]), compare_names);
+
+    /* Pages of crashed stages stay until the stage runs again */
+    for (size_t i = 0; i < count; i++)
+    {
+        const PrkMetricsPage *page = stages[i] ? prk_metrics_map(stages[i]) : NULL;
+        if (page && kill(page->pid, 0) != 0 && errno == ESRCH)
+        {
+            prk_metrics_unmap(page);
+            page = NULL;
+        }
+        if (page)
+        {
+            pages[mapped++] = page;
+        }
+        free(stages[i]);
+    }
+
+    fprintf(out, "# HELP prk_stage_start_time_seconds Unix time the stage started.\n"
+                 "# TYPE prk_stage_start_time_seconds gauge\n");
+    for (size_t i = 0; i < mapped; i++)
+    {
+        fprintf(out, "prk_stage_start_time_seconds{stage=\"%s\"} %lld\n", pages[i]->stage,
+                (long long)pages[i]->start_time);
+    }
+
+    int rc = 0;
+    for (size_t i = 0; i < mapped; i++)
+    {
+        if (prk_metrics_write_text(pages[i], out) != 0)
+        {
+            rc = -1;
+        }
+        prk_metrics_unmap(pages[i]);
+    }
+    return rc == 0 ? (int)mapped : -1;
+}
+
+/**
+ * send_all - Send the whole buffer, looping over partial sends.
+ */
+static int send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR && !stop_requested)
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += sent;
+        len  -= (size_t)sent;
+    }
+    return 0;
+}
+
+/**
+ * serve_client - Answer one HTTP request on a connected socket.
+ */
+void serve_client(int fd)
+{
+    char            request[METRICS_REQUEST_MAX + 1];
+    size_t          len = 0;
+    struct timeval  timeout = { .tv_sec = METRICS_CLIENT_TIMEOUT_S };
+
+    /* Clients are served one at a time: none may stall the loop */
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    /* The request head; the body of a GET, if any, is ignored */
+    while (len < METRICS_REQUEST_MAX)
+    {
+        ssize_t got = recv(fd, request + len, METRICS_REQUEST_MAX - len, 0);
+        if (got <= 0)
+        {
+            return;
+        }
+        len += (size_t)got;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+        {
+            break;
+        }
+    }
+    request[len] = '\0';
+
+    size_t path_len = strlen(METRICS_PATH);
+    if (strncmp(request, "GET " METRICS_PATH, 4 + path_len) != 0 ||
+        (request[4 + path_len] != ' ' && request[4 + path_len] != '?'))
+    {
+        static const char response[] = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n"
+                                       "Content-Length: 10\r\nConnection: close\r\n\r\nNot found\n";
+        prk_counter_inc(not_found);
+        send_all(fd, response, sizeof(response) - 1);
+        return;
+    }
+
+    uint64_t    started = prk_metrics_now_ns();
+    char        *body   = NULL;
+    size_t      size    = 0;
+    FILE        *out    = open_memstream(&body, &size);
+    if (!out)
+    {
+        perror("open_memstream");
+        return;
+    }
+    write_metrics(out);
+    fclose(out);
+    prk_histogram_observe(scrape_time, prk_metrics_now_ns() - started);
+    prk_counter_inc(scrapes);
+
+    char head[160];
+    int  head_len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                             "Content-Length: %zu\r\nConnection: close\r\n\r\n", size);
+    if (send_all(fd, head, (size_t)head_len) == 0)
+    {
+        send_all(fd, body, size);
+    }
+    free(body);
+}
+
+/**
+ * listen_on - TCP socket listening on @port of the IPv4 address @host.
+ */
+static int listen_on(const char *host, int port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid listen address: %s\n", host);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * main - Entry point of the program
+ *
+ * Return: 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    const char  *host = METRICS_LISTEN_ADDR;
+    int         port = METRICS_PORT;
+    int         once = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc)
+        {
+            host = argv[++i];
+        }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            port = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--once") == 0)
+        {
+            once = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--listen <addr>] [--port <port>] [--once]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (once)
+    {
+        return write_metrics(stdout) < 0 || fflush(stdout) != 0 ? 1 : 0;
+    }
+
+    prk_metrics_open("exporter");
+    scrapes     = prk_counter("prk_exporter_scrapes_total", "Scrapes answered.");
+    not_found   = prk_counter("prk_exporter_not_found_total", "Requests for anything but " METRICS_PATH ".");
+    scrape_time = prk_histogram("prk_exporter_scrape_seconds", "Time to read and format every page.", PRK_SCALE_NS);
+
+    int listen_fd = listen_on(host, port);
+    if (listen_fd < 0)
+    {
+        prk_metrics_close();
+        return 1;
+    }
+
+    /* SIGTERM and SIGINT interrupt accept() (no SA_RESTART) and stop the loop */
+    struct sigaction stop = { .sa_handler = stop_handler };
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGTERM, &stop, NULL);
+    sigaction(SIGINT, &stop, NULL);
+
+    printf("Serving metrics on %s port %d, path %s\n", host, port, METRICS_PATH);
+    fflush(stdout);
+    prk_notify_ready();
+
+    while (!stop_requested)
+    {
+        int client = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno != EINTR)
+            {
+                perror("accept");
+            }
+            continue;
+        }
+        serve_client(client);
+        close(client);
+    }
+
+    close(listen_fd);
+    prk_metrics_close();
+    return 0;
+}
@@ -0,0 +1,538 @@
+/**
+ * occupancy_rollup.c: Per zone occupancy rollups maintained at ingest
+ *
+ * Every accepted reading is counted in memory in its zone's minute, hour
+ * and day bucket. The inserter drains the changed buckets into
+ * Rollup_Minute, Rollup_Hour and Rollup_Day every ROLLUP_FLUSH_MS with
+ * additive upserts, so dashboard queries read one row per zone and period
+ * instead of aggregating Customer_Data. out_rebuild_rollups uses the same
+ * code to regenerate the tables from the raw readings.
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            keep the deltas of a drain until its upserts commit
+ *
+ */
+
+#include "../inc/occupancy_rollup.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define ROLLUP_INITIAL_SLOTS   64                                    /* Per table, grows by doubling */
+
+
+static const int64_t level_ms[ROLLUP_LEVELS] =
+{
+    60 * 1000LL,                                                     /* ROLLUP_MINUTE */
+    60 * 60 * 1000LL,                                                /* ROLLUP_HOUR */
+    24 * 60 * 60 * 1000LL,                                           /* ROLLUP_DAY */
+};
+
+static const char *upsert_sql[ROLLUP_LEVELS] =
+{
+    "INSERT INTO Rollup_Minute (zone_id, bucket_ms, readings, parked_readings, sensors, parked_sensors) "
+    "VALUES (?1, ?2, ?3, ?4, ?6, ?7) "
+    "ON CONFLICT (zone_id, bucket_ms) DO UPDATE SET "
+    "    readings = readings + excluded.readings, "
+    "    parked_readings = parked_readings + excluded.parked_readings, "
+    "    sensors = max(sensors, excluded.sensors), "
+    "    parked_sensors = max(parked_sensors, excluded.parked_sensors);",
+
+    "INSERT INTO Rollup_Hour (zone_id, bucket_ms, readings, parked_readings, parked_minutes, peak_parked) "
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?8) "
+    "ON CONFLICT (zone_id, bucket_ms) DO UPDATE SET "
+    "    readings = readings + excluded.readings, "
+    "    parked_readings = parked_readings + excluded.parked_readings, "
+    "    parked_minutes = parked_minutes + excluded.parked_minutes, "
+    "    peak_parked = max(peak_parked, excluded.peak_parked);",
+
+    "INSERT INTO Rollup_Day (zone_id, bucket_ms, readings, parked_readings, parked_minutes, peak_parked) "
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?8) "
+    "ON CONFLICT (zone_id, bucket_ms) DO UPDATE SET "
+    "    readings = readings + excluded.readings, "
+    "    parked_readings = parked_readings + excluded.parked_readings, "
+    "    parked_minutes = parked_minutes + excluded.parked_minutes, "
+    "    peak_parked = max(peak_parked, excluded.peak_parked);",
+};
+
+
+/**
+ * bucket_start - Start of the @length bucket containing @time_ms.
+ */
+static int64_t bucket_start(int64_t time_ms, int64_t length)
+{
+    int64_t start = time_ms - time_ms % length;
+    return (time_ms < 0 && start != time_ms) ? start - length : start;
+}
+
+/**
+ * mix - Hash of up to three keys.
+ */
+static uint64_t mix(int64_t a, int64_t b, int64_t c)
+{
+    uint64_t h = (uint64_t)a * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)b + 0xBF58476D1CE4E5B9ULL + (h << 6) + (h >> 2);
+    h ^= (uint64_t)c + 0x94D049BB133111EBULL + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    return h;
+}
+
+
+/**
+ * table_slot - Slot of (@zone_id, @bucket_ms): the cell, or the empty slot it would go to.
+ */
+static RollupCell *table_slot(RollupCell *cells, size_t capacity, int64_t zone_id, int64_t bucket_ms)
+{
+    size_t mask = capacity - 1;
+    size_t i    = mix(zone_id, bucket_ms, 0) & mask;
+
+    while (cells[i].used && (cells[i].zone_id != zone_id || cells[i].bucket_ms != bucket_ms))
+    {
+        i = (i + 1) & mask;
+    }
+    return &cells[i];
+}
+
+/**
+ * table_resize - Rehash the cells of @table into @capacity slots, dropping the evicted ones.
+ */
+static int table_resize(RollupTable *table, size_t capacity, int64_t keep_from, int64_t length)
+{
+    RollupCell *cells = calloc(capacity, sizeof(RollupCell));
+    if (!cells)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        const RollupCell *cell = &table->cells[i];
+        if (cell->used && cell->bucket_ms + length > keep_from)
+        {
+            *table_slot(cells, capacity, cell->zone_id, cell->bucket_ms) = *cell;
+            count++;
+        }
+    }
+
+    free(table->cells);
+    table->cells    = cells;
+    table->capacity = capacity;
+    table->count    = count;
+    return 0;
+}
+
+/**
+ * table_cell - Cell of (@zone_id, @bucket_ms), created if missing.
+ */
+static RollupCell *table_cell(RollupTable *table, int64_t zone_id, int64_t bucket_ms)
+{
+    RollupCell *cell = table_slot(table->cells, table->capacity, zone_id, bucket_ms);
+    if (cell->used)
+    {
+        return cell;
+    }
+
+    /* Keep the load factor at or below 1/2 */
+    if ((table->count + 1) * 2 > table->capacity)
+    {
+        if (table_resize(table, table->capacity * 2, INT64_MIN, 0) != 0)
+        {
+            return NULL;
+        }
+        cell = table_slot(table->cells, table->capacity, zone_id, bucket_ms);
+    }
+
+    memset(cell, 0, sizeof(*cell));
+    cell->zone_id   = zone_id;
+    cell->bucket_ms = bucket_ms;
+    cell->used      = 1;
+    table->count++;
+    return cell;
+}
+
+
+/**
+ * member_slot - Slot of a member: the member, or the empty slot it would go to.
+ */
+static RollupMember *member_slot(RollupMember *slots, size_t capacity, const RollupMember *key)
+{
+    size_t mask = capacity - 1;
+    size_t i    = mix(key->zone_id, key->bucket_ms, key->sensor_id * 2 + key->parked) & mask;
+
+    while (slots[i].used && (slots[i].sensor_id != key->sensor_id || slots[i].bucket_ms != key->bucket_ms ||
+                             slots[i].zone_id != key->zone_id || slots[i].parked != key->parked))
+    {
+        i = (i + 1) & mask;
+    }
+    return &slots[i];
+}
+
+/**
+ * members_resize - Rehash the members into @capacity slots, dropping minutes before @keep_from.
+ */
+static int members_resize(RollupMembers *members, size_t capacity, int64_t keep_from)
+{
+    RollupMember *slots = calloc(capacity, sizeof(RollupMember));
+    if (!slots)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < members->capacity; i++)
+    {
+        const RollupMember *member = &members->slots[i];
+        if (member->used && member->bucket_ms + level_ms[ROLLUP_MINUTE] > keep_from)
+        {
+            *member_slot(slots, capacity, member) = *member;
+            count++;
+        }
+    }
+
+    free(members->slots);
+    members->slots    = slots;
+    members->capacity = capacity;
+    members->count    = count;
+    return 0;
+}
+
+/**
+ * members_add - Add a member.
+ *
+ * Return: 1 if it was not in the set, 0 if it was, -1 on allocation failure.
+ */
+static int members_add(RollupMembers *members, int64_t zone_id, int64_t bucket_ms, int64_t sensor_id, int parked)
+{
+    RollupMember key =
+    {
+        .zone_id   = zone_id,
+        .bucket_ms = bucket_ms,
+        .sensor_id = sensor_id,
+        .parked    = parked,
+        .used      = 1,
+    };
+
+    RollupMember *slot = member_slot(members->slots, members->capacity, &key);
+    if (slot->used)
+    {
+        return 0;
+    }
+
+    if ((members->count + 1) * 2 > members->capacity)
+    {
+        if (members_resize(members, members->capacity * 2, INT64_MIN) != 0)
+        {
+            return -1;
+        }
+        slot = member_slot(members->slots, members->capacity, &key);
+    }
+
+    *slot = key;
+    members->count++;
+    return 1;
+}
+
+
+/**
+ * occupancy_rollup_init - Create an empty rollup.
+ */
+int occupancy_rollup_init(OccupancyRollup *rollup, const ZoneMap *zones)
+{
+    memset(rollup, 0, sizeof(*rollup));
+    rollup->zones     = zones;
+    rollup->newest_ms = INT64_MIN;
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        if (table_resize(&rollup->levels[level], ROLLUP_INITIAL_SLOTS, INT64_MIN, 0) != 0)
+        {
+            occupancy_rollup_free(rollup);
+            return -1;
+        }
+    }
+    if (members_resize(&rollup->members, ROLLUP_INITIAL_SLOTS, INT64_MIN) != 0)
+    {
+        occupancy_rollup_free(rollup);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * occupancy_rollup_add - Count one reading.
+ */
+int occupancy_rollup_add(OccupancyRollup *rollup, int64_t sensor_id, int64_t recv_time, int32_t x, int32_t y,
+                         char status)
+{
+    int64_t zone_id = zone_map_lookup(rollup->zones, x, y);
+    if (zone_id == 0)
+    {
+        rollup->unzoned++;
+        return 0;
+    }
+    if (recv_time > rollup->newest_ms)
+    {
+        rollup->newest_ms = recv_time;
+    }
+
+    int         parked = (status == ROLLUP_PARKED_STATUS);
+    int64_t     minute = bucket_start(recv_time, level_ms[ROLLUP_MINUTE]);
+    RollupCell  *cell  = table_cell(&rollup->levels[ROLLUP_MINUTE], zone_id, minute);
+    if (!cell)
+    {
+        return -1;
+    }
+    cell->readings++;
+    cell->parked_readings += parked;
+    cell->dirty            = 1;
+
+    /* Distinct sensors of the minute */
+    int seen = members_add(&rollup->members, zone_id, minute, sensor_id, 0);
+    int car  = parked ? members_add(&rollup->members, zone_id, minute, sensor_id, 1) : 0;
+    if (seen < 0 || car < 0)
+    {
+        return -1;
+    }
+    cell->sensors        += seen;
+    cell->parked_sensors += car;
+
+    uint32_t minute_parked = cell->parked_sensors;
+    for (int level = ROLLUP_HOUR; level < ROLLUP_LEVELS; level++)
+    {
+        cell = table_cell(&rollup->levels[level], zone_id, bucket_start(recv_time, level_ms[level]));
+        if (!cell)
+        {
+            return -1;
+        }
+        cell->readings++;
+        cell->parked_readings += parked;
+        cell->parked_minutes  += car;
+        if (minute_parked > cell->peak_parked)
+        {
+            cell->peak_parked = minute_parked;
+        }
+        cell->dirty = 1;
+    }
+
+    rollup->pending++;
+    return 0;
+}
+
+/**
+ * occupancy_rollup_drain - Hand every changed cell to @emit.
+ */
+long occupancy_rollup_drain(OccupancyRollup *rollup, int final, rollup_emit_t emit, void *ctx)
+{
+    long emitted = 0;
+
+    rollup->drained       = 1;
+    rollup->drained_final = final;
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        RollupTable *table = &rollup->levels[level];
+        for (size_t i = 0; i < table->capacity; i++)
+        {
+            RollupCell *cell = &table->cells[i];
+            if (!cell->used || !cell->dirty)
+            {
+                continue;
+            }
+            if (emit((rollup_level_t)level, cell, ctx) != 0)
+            {
+                return -1;
+            }
+            cell->emitted = 1;
+            emitted++;
+        }
+    }
+
+    return emitted;
+}
+
+/**
+ * occupancy_rollup_batch_done - Reset the deltas of the last drain and evict closed buckets.
+ */
+int occupancy_rollup_batch_done(OccupancyRollup *rollup)
+{
+    int left = 0;                                                    /* Dirty cells a failed drain did not reach */
+
+    if (!rollup->drained)
+    {
+        return 0;
+    }
+    rollup->drained = 0;
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        RollupTable *table = &rollup->levels[level];
+        for (size_t i = 0; i < table->capacity; i++)
+        {
+            RollupCell *cell = &table->cells[i];
+            if (!cell->used || !cell->emitted)
+            {
+                left |= cell->used && cell->dirty;
+                continue;
+            }
+
+            cell->readings        = 0;
+            cell->parked_readings = 0;
+            cell->parked_minutes  = 0;
+            cell->dirty           = 0;
+            cell->emitted         = 0;
+        }
+    }
+
+    if (left)
+    {
+        return 0;                                                    /* Evict once they are written too */
+    }
+    rollup->pending = 0;
+
+    /* Forget buckets that can no longer receive readings */
+    int     final     = rollup->drained_final;
+    int64_t keep_from = final ? INT64_MAX : INT64_MIN;
+    if (!final && rollup->newest_ms > INT64_MIN + ROLLUP_GRACE_MS)
+    {
+        keep_from = rollup->newest_ms - ROLLUP_GRACE_MS;
+    }
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        RollupTable *table = &rollup->levels[level];
+        if (table_resize(table, table->capacity, keep_from, level_ms[level]) != 0)
+        {
+            return -1;
+        }
+    }
+    if (members_resize(&rollup->members, rollup->members.capacity, keep_from) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * occupancy_rollup_rollback - Keep the deltas of the last drain for the next one.
+ */
+void occupancy_rollup_rollback(OccupancyRollup *rollup)
+{
+    if (!rollup->drained)
+    {
+        return;
+    }
+    rollup->drained = 0;
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        RollupTable *table = &rollup->levels[level];
+        for (size_t i = 0; i < table->capacity; i++)
+        {
+            table->cells[i].emitted = 0;
+        }
+    }
+}
+
+/**
+ * occupancy_rollup_free - Release the cells and sensor sets.
+ */
+void occupancy_rollup_free(OccupancyRollup *rollup)
+{
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        free(rollup->levels[level].cells);
+    }
+    free(rollup->members.slots);
+    memset(rollup, 0, sizeof(*rollup));
+}
+
+
+/**
+ * rollup_writer_init - Prepare the upserts into Rollup_Minute/Hour/Day.
+ */
+int rollup_writer_init(RollupWriter *writer, sqlite3 *db)
+{
+    memset(writer, 0, sizeof(*writer));
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        writer->upsert[level] = prk_db_prepare(db, upsert_sql[level]);
+        if (!writer->upsert[level])
+        {
+            rollup_writer_free(writer);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * rollup_writer_emit - rollup_emit_t that upserts a cell into its table.
+ */
+int rollup_writer_emit(rollup_level_t level, const RollupCell *cell, void *writer)
+{
+    sqlite3_stmt *stmt = ((RollupWriter *)writer)->upsert[level];
+
+    sqlite3_bind_int64(stmt, 1, cell->zone_id);
+    sqlite3_bind_int64(stmt, 2, cell->bucket_ms);
+    sqlite3_bind_int64(stmt, 3, (sqlite3_int64)cell->readings);
+    sqlite3_bind_int64(stmt, 4, (sqlite3_int64)cell->parked_readings);
+    sqlite3_bind_int64(stmt, 5, (sqlite3_int64)cell->parked_minutes);
+    sqlite3_bind_int64(stmt, 6, cell->sensors);
+    sqlite3_bind_int64(stmt, 7, cell->parked_sensors);
+    sqlite3_bind_int64(stmt, 8, cell->peak_parked);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Rollup upsert failed: %s\n", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * rollup_writer_clear - Delete the rollup rows of buckets starting in [@from, @to).
+ */
+int rollup_writer_clear(RollupWriter *writer, int64_t from, int64_t to)
+{
+    char *sql = sqlite3_mprintf("DELETE FROM Rollup_Minute WHERE bucket_ms >= %lld AND bucket_ms < %lld;"
+                                "DELETE FROM Rollup_Hour WHERE bucket_ms >= %lld AND bucket_ms < %lld;"
+                                "DELETE FROM Rollup_Day WHERE bucket_ms >= %lld AND bucket_ms < %lld;",
+                                (long long)from, (long long)to, (long long)from, (long long)to,
+                                (long long)from, (long long)to);
+    int rc = sql ? prk_db_exec(sqlite3_db_handle(writer->upsert[ROLLUP_MINUTE]), sql) : -1;
+    sqlite3_free(sql);
+    return rc;
+}
+
+/**
+ * rollup_writer_free - Finalize the prepared upserts.
+ */
+void rollup_writer_free(RollupWriter *writer)
+{
+    for (int level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        sqlite3_finalize(writer->upsert[level]);
+        writer->upsert[level] = NULL;
+    }
+}
+
+/**
+ * rollup_level_ms - Bucket length of @level in ms.
+ */
+int64_t rollup_level_ms(rollup_level_t level)
+{
+    return level_ms[level];
+}
@@ -0,0 +1,379 @@
+/**
+ * partition_router.c: Time partitions of the readings table
+ *
+ * Readings are stored in one table per PARTITION_MS of receive time
+ * (Customer_Data_pYYYYMMDD), listed in the Partitions table and united by
+ * the Customer_Data view. The router sends each insert to its partition,
+ * creating partitions on demand, prunes range queries to the partitions
+ * that overlap them, and enforces retention by dropping whole partitions
+ * instead of deleting rows.
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            reload the list when the transaction that changed
+ *                                                        it rolls back
+ *
+ */
+
+#include "../inc/partition_router.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/**
+ * partition_start - Start of the partition period containing @recv_time.
+ */
+static int64_t partition_start(int64_t recv_time)
+{
+    int64_t start = recv_time - recv_time % PARTITION_MS;
+    return (recv_time < 0 && start != recv_time) ? start - PARTITION_MS : start;
+}
+
+/**
+ * partition_name - Table name of the partition starting at @start_ms.
+ */
+static void partition_name(int64_t start_ms, char *name, size_t size)
+{
+    time_t      seconds = (time_t)(start_ms / 1000);
+    struct tm   tm;
+
+    gmtime_r(&seconds, &tm);
+    if (PARTITION_MS % (24 * 60 * 60 * 1000LL) == 0)
+    {
+        snprintf(name, size, PARTITION_PREFIX "%04d%02d%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    }
+    else
+    {
+        snprintf(name, size, PARTITION_PREFIX "%04d%02d%02d%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                 tm.tm_hour);
+    }
+}
+
+/**
+ * lower_bound - Index of the first partition with start_ms >= @start.
+ */
+static size_t lower_bound(const PartitionRouter *router, int64_t start)
+{
+    size_t lo = 0, hi = router->count;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (router->parts[mid].start_ms < start)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * max_span - Longest partition, bounds how far back a range query looks.
+ */
+static int64_t max_span(const PartitionRouter *router)
+{
+    int64_t span = 0;
+
+    for (size_t i = 0; i < router->count; i++)
+    {
+        int64_t length = router->parts[i].end_ms - router->parts[i].start_ms;
+        if (length > span)
+        {
+            span = length;
+        }
+    }
+    return span;
+}
+
+/**
+ * add_partition - Insert an entry into the sorted list.
+ */
+static Partition *add_partition(PartitionRouter *router, const char *name, int64_t start_ms, int64_t end_ms)
+{
+    if (router->count == router->capacity)
+    {
+        size_t      capacity = router->capacity ? router->capacity * 2 : 16;
+        Partition   *parts   = realloc(router->parts, capacity * sizeof(Partition));
+        if (!parts)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        router->parts    = parts;
+        router->capacity = capacity;
+    }
+
+    size_t i = lower_bound(router, start_ms);
+    memmove(&router->parts[i + 1], &router->parts[i], (router->count - i) * sizeof(Partition));
+    router->count++;
+
+    Partition *part = &router->parts[i];
+    memset(part, 0, sizeof(*part));
+    snprintf(part->name, sizeof(part->name), "%s", name);
+    part->start_ms = start_ms;
+    part->end_ms   = end_ms;
+    part->legacy   = strcmp(name, PARTITION_LEGACY_NAME) == 0;
+    return part;
+}
+
+/**
+ * release_partition - Finalize the statements of a partition entry.
+ */
+static void release_partition(Partition *part)
+{
+    sqlite3_finalize(part->insert_stmt);
+    sqlite3_finalize(part->query_stmt);
+    part->insert_stmt = NULL;
+    part->query_stmt  = NULL;
+}
+
+/**
+ * prepare_insert - Prepare the insert statement of a partition.
+ */
+static int prepare_insert(PartitionRouter *router, Partition *part)
+{
+    char *sql = sqlite3_mprintf("INSERT INTO \"%w\" (sensor_id, recv_time, id, status, x, y, z) "
+                                "VALUES (?, ?, ?, ?, ?, ?, ?);", part->name);
+    part->insert_stmt = sql ? prk_db_prepare(router->db, sql) : NULL;
+    sqlite3_free(sql);
+    return part->insert_stmt ? 0 : -1;
+}
+
+
+/**
+ * partition_router_init - Load the partition list from the Partitions table.
+ */
+int partition_router_init(PartitionRouter *router, sqlite3 *db)
+{
+    memset(router, 0, sizeof(*router));
+    router->db           = db;
+    router->retention_ms = PARTITION_RETENTION_MS;
+
+    sqlite3_stmt *stmt = prk_db_prepare(db, "SELECT name, start_ms, end_ms FROM Partitions;");
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if (!add_partition(router, (const char *)sqlite3_column_text(stmt, 0),
+                           sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2)))
+        {
+            sqlite3_finalize(stmt);
+            partition_router_free(router);
+            return -1;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    return 0;
+}
+
+/**
+ * partition_router_route - Partition a reading received at @recv_time goes to.
+ */
+Partition *partition_router_route(PartitionRouter *router, int64_t recv_time)
+{
+    /* Fast path: same partition as the previous reading */
+    if (router->current < router->count)
+    {
+        Partition *part = &router->parts[router->current];
+        if (!part->legacy && recv_time >= part->start_ms && recv_time < part->end_ms)
+        {
+            return part;
+        }
+    }
+
+    int64_t start = partition_start(recv_time);
+    for (size_t i = lower_bound(router, start); i < router->count && router->parts[i].start_ms == start; i++)
+    {
+        Partition *part = &router->parts[i];
+        if (!part->legacy && part->end_ms == start + PARTITION_MS)
+        {
+            if (!part->insert_stmt && prepare_insert(router, part) != 0)
+            {
+                return NULL;
+            }
+            router->current = i;
+            return part;
+        }
+    }
+
+    /* New period: create its table and put it behind the view */
+    char name[64];
+    partition_name(start, name, sizeof(name));
+    if (prk_db_create_partition(router->db, name, start, start + PARTITION_MS) != 0 ||
+        prk_db_rebuild_readings_view(router->db) != 0)
+    {
+        return NULL;
+    }
+    router->changed = 1;
+
+    Partition *part = add_partition(router, name, start, start + PARTITION_MS);
+    if (!part || prepare_insert(router, part) != 0)
+    {
+        return NULL;
+    }
+    router->current = (size_t)(part - router->parts);
+
+    /* A new period is also when old ones fall out of the retention window */
+    if (router->retention_ms > 0 && partition_router_expire(router, recv_time - router->retention_ms) > 0)
+    {
+        for (router->current = 0; router->current < router->count; router->current++)
+        {
+            if (strcmp(router->parts[router->current].name, name) == 0)
+            {
+                break;
+            }
+        }
+        part = &router->parts[router->current];
+    }
+
+    return part;
+}
+
+/**
+ * partition_router_find - Partitions overlapping [@from, @to).
+ */
+size_t partition_router_find(const PartitionRouter *router, int64_t from, int64_t to, size_t *first)
+{
+    if (from >= to || router->count == 0)
+    {
+        *first = 0;
+        return 0;
+    }
+
+    /* Partitions starting before from - longest span cannot reach from */
+    int64_t span  = max_span(router);
+    size_t  begin = lower_bound(router, (from > INT64_MIN + span) ? from - span + 1 : INT64_MIN);
+    size_t  end   = lower_bound(router, to);
+
+    *first = begin;
+    return end - begin;
+}
+
+/**
+ * partition_router_expire - Drop every partition that ends at or before @cutoff.
+ */
+int partition_router_expire(PartitionRouter *router, int64_t cutoff)
+{
+    int     dropped = 0;
+    size_t  kept    = 0;
+
+    for (size_t i = 0; i < router->count; i++)
+    {
+        Partition *part = &router->parts[i];
+        if (part->end_ms > cutoff)
+        {
+            router->parts[kept++] = *part;
+            continue;
+        }
+
+        release_partition(part);
+        char *sql = sqlite3_mprintf("DROP TABLE IF EXISTS \"%w\";"
+                                    "DELETE FROM Partitions WHERE name = %Q;", part->name, part->name);
+        int rc = sql ? prk_db_exec(router->db, sql) : -1;
+        sqlite3_free(sql);
+        if (rc != 0)
+        {
+            router->parts[kept++] = *part;                           /* Still there, try again next time */
+            continue;
+        }
+
+        printf("Dropped readings partition %s (retention)\n", part->name);
+        dropped++;
+    }
+    router->count   = kept;
+    router->current = 0;
+    router->changed |= dropped > 0;
+
+    if (dropped > 0 && prk_db_rebuild_readings_view(router->db) != 0)
+    {
+        return -1;
+    }
+    return dropped;
+}
+
+/**
+ * partition_router_batch_done - The caller's transaction committed.
+ */
+void partition_router_batch_done(PartitionRouter *router)
+{
+    router->changed = 0;
+}
+
+/**
+ * partition_router_rollback - The caller's transaction rolled back: reload the list if it changed.
+ */
+int partition_router_rollback(PartitionRouter *router)
+{
+    if (!router->changed)
+    {
+        return 0;
+    }
+
+    sqlite3 *db        = router->db;
+    int64_t retention  = router->retention_ms;
+
+    partition_router_free(router);
+    if (partition_router_init(router, db) != 0)
+    {
+        fprintf(stderr, "Error reloading the readings partitions\n");
+        return -1;
+    }
+    router->retention_ms = retention;
+    return 0;
+}
+
+/**
+ * partition_router_max_id - Highest reading id, from the newest non-empty partition.
+ */
+int64_t partition_router_max_id(PartitionRouter *router)
+{
+    for (size_t i = router->count; i-- > 0; )
+    {
+        char            *sql  = sqlite3_mprintf("SELECT max(id) FROM \"%w\";", router->parts[i].name);
+        sqlite3_stmt    *stmt = sql ? prk_db_prepare(router->db, sql) : NULL;
+        int64_t         id    = 0;
+        int             found = 0;
+
+        sqlite3_free(sql);
+        if (stmt && sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        {
+            id    = sqlite3_column_int64(stmt, 0);
+            found = 1;
+        }
+        sqlite3_finalize(stmt);
+
+        if (found)
+        {
+            return id;
+        }
+    }
+    return 0;
+}
+
+/**
+ * partition_router_free - Finalize the partition statements and free the list.
+ */
+void partition_router_free(PartitionRouter *router)
+{
+    for (size_t i = 0; i < router->count; i++)
+    {
+        release_partition(&router->parts[i]);
+    }
+    free(router->parts);
+    memset(router, 0, sizeof(*router));
+}
@@ -0,0 +1,198 @@
+/**
+ * point_in_polygon.c: Crossing number point-in-polygon kernels
+ *
+ * Tests a batch of points against one polygon. The vector kernels keep one
+ * point per lane and walk the polygon's edges once for the whole batch:
+ * each edge is broadcast, compared against all lanes and the lanes that
+ * cross it flip their inside bit. x86 builds carry SSE2 and AVX2 versions
+ * and pick one at run time; other targets use the scalar loop.
+ *
+ * Compilation:
+ *      gcc -O2 -c point_in_polygon.c
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/point_in_polygon.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIP_X86
+#include <immintrin.h>
+#endif
+
+
+/**
+ * pip_edge - Precompute the edge from (@x1, @y1) to (@x2, @y2).
+ */
+void pip_edge(PolygonEdge *edge, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+    edge->x1    = x1;
+    edge->y1    = y1;
+    edge->y2    = y2;
+    edge->slope = (y1 == y2) ? 0.0 : ((double)x2 - x1) / ((double)y2 - y1);
+}
+
+/**
+ * pip_contains - Whether (@x, @y) is inside the polygon (crossing number rule).
+ */
+int pip_contains(const PolygonEdge *edges, size_t count, double x, double y)
+{
+    int inside = 0;
+
+    for (size_t e = 0; e < count; e++)
+    {
+        const PolygonEdge *edge = &edges[e];
+        if ((edge->y1 > y) != (edge->y2 > y) && x < edge->x1 + (y - edge->y1) * edge->slope)
+        {
+            inside ^= 1;
+        }
+    }
+    return inside;
+}
+
+/**
+ * classify_scalar - PIP_SCALAR kernel.
+ */
+static void classify_scalar(const PolygonEdge *edges, size_t count, const double *x, const double *y, size_t points,
+                            uint8_t *inside)
+{
+    for (size_t i = 0; i < points; i++)
+    {
+        inside[i] = (uint8_t)pip_contains(edges, count, x[i], y[i]);
+    }
+}
+
+#ifdef PIP_X86
+
+/**
+ * classify_sse2 - PIP_SSE2 kernel, two points per pass over the edges.
+ */
+__attribute__((target("sse2")))
+static void classify_sse2(const PolygonEdge *edges, size_t count, const double *x, const double *y, size_t points,
+                          uint8_t *inside)
+{
+    size_t i = 0;
+
+    for (; i + 2 <= points; i += 2)
+    {
+        __m128d px  = _mm_loadu_pd(&x[i]);
+        __m128d py  = _mm_loadu_pd(&y[i]);
+        __m128d odd = _mm_setzero_pd();
+
+        for (size_t e = 0; e < count; e++)
+        {
+            __m128d y1       = _mm_set1_pd(edges[e].y1);
+            __m128d straddle = _mm_xor_pd(_mm_cmpgt_pd(y1, py), _mm_cmpgt_pd(_mm_set1_pd(edges[e].y2), py));
+            __m128d cross_x  = _mm_add_pd(_mm_set1_pd(edges[e].x1),
+                                          _mm_mul_pd(_mm_sub_pd(py, y1), _mm_set1_pd(edges[e].slope)));
+            odd = _mm_xor_pd(odd, _mm_and_pd(straddle, _mm_cmplt_pd(px, cross_x)));
+        }
+
+        int mask      = _mm_movemask_pd(odd);
+        inside[i]     = (uint8_t)(mask & 1);
+        inside[i + 1] = (uint8_t)((mask >> 1) & 1);
+    }
+    classify_scalar(edges, count, x + i, y + i, points - i, inside + i);
+}
+
+/**
+ * classify_avx2 - PIP_AVX2 kernel, four points per pass over the edges.
+ */
+__attribute__((target("avx2")))
+static void classify_avx2(const PolygonEdge *edges, size_t count, const double *x, const double *y, size_t points,
+                          uint8_t *inside)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= points; i += 4)
+    {
+        __m256d px  = _mm256_loadu_pd(&x[i]);
+        __m256d py  = _mm256_loadu_pd(&y[i]);
+        __m256d odd = _mm256_setzero_pd();
+
+        for (size_t e = 0; e < count; e++)
+        {
+            __m256d y1       = _mm256_broadcast_sd(&edges[e].y1);
+            __m256d straddle = _mm256_xor_pd(_mm256_cmp_pd(y1, py, _CMP_GT_OQ),
+                                             _mm256_cmp_pd(_mm256_broadcast_sd(&edges[e].y2), py, _CMP_GT_OQ));
+            __m256d cross_x  = _mm256_add_pd(_mm256_broadcast_sd(&edges[e].x1),
+                                             _mm256_mul_pd(_mm256_sub_pd(py, y1),
+                                                           _mm256_broadcast_sd(&edges[e].slope)));
+            odd = _mm256_xor_pd(odd, _mm256_and_pd(straddle, _mm256_cmp_pd(px, cross_x, _CMP_LT_OQ)));
+        }
+
+        int mask = _mm256_movemask_pd(odd);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            inside[i + lane] = (uint8_t)((mask >> lane) & 1);
+        }
+    }
+    classify_sse2(edges, count, x + i, y + i, points - i, inside + i);
+}
+
+#endif  /* PIP_X86 */
+
+/**
+ * pip_best_kernel - Fastest kernel this CPU supports.
+ */
+pip_kernel_t pip_best_kernel(void)
+{
+#ifdef PIP_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return PIP_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return PIP_SSE2;
+    }
+#endif
+    return PIP_SCALAR;
+}
+
+/**
+ * pip_kernel_name - "scalar", "sse2" or "avx2".
+ */
+const char *pip_kernel_name(pip_kernel_t kernel)
+{
+    static const char *names[PIP_KERNELS] = { "scalar", "sse2", "avx2" };
+    return (kernel >= 0 && kernel < PIP_KERNELS) ? names[kernel] : "unknown";
+}
+
+/**
+ * pip_classify_with - pip_classify() with a given kernel (benchmarks).
+ */
+void pip_classify_with(pip_kernel_t kernel, const PolygonEdge *edges, size_t count, const double *x,
+                       const double *y, size_t points, uint8_t *inside)
+{
+#ifdef PIP_X86
+    if (kernel == PIP_AVX2 && __builtin_cpu_supports("avx2"))
+    {
+        classify_avx2(edges, count, x, y, points, inside);
+        return;
+    }
+    if (kernel >= PIP_SSE2 && __builtin_cpu_supports("sse2"))
+    {
+        classify_sse2(edges, count, x, y, points, inside);
+        return;
+    }
+#else
+    (void)kernel;
+#endif
+    classify_scalar(edges, count, x, y, points, inside);
+}
+
+/**
+ * pip_classify - Test many points against one polygon with the best kernel.
+ */
+void pip_classify(const PolygonEdge *edges, size_t count, const double *x, const double *y, size_t points,
+                  uint8_t *inside)
+{
+    pip_classify_with(pip_best_kernel(), edges, count, x, y, points, inside);
+}
@@ -0,0 +1,304 @@
+/**
+ * price_history.c: Point-in-time price lookups over Price_History
+ *
+ * Prices used to be overwritten in place, so a session that started before
+ * a price change could only be billed at the new price. out_update_prices
+ * now keeps every price with the interval it applied in; this module loads
+ * those intervals once, grouped by location and sorted by start, and
+ * answers "price of L at T" with two binary searches. In a batch, a query
+ * following one for the same zone steps forward from its answer instead
+ * of searching again.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/price_history.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * grow - Make room for one more element in a doubling array.
+ */
+static int grow(void **array, size_t *capacity, size_t count, size_t size)
+{
+    if (count < *capacity)
+    {
+        return 0;
+    }
+
+    size_t grown_capacity = *capacity ? *capacity * 2 : 256;
+    void   *grown         = realloc(*array, grown_capacity * size);
+    if (!grown)
+    {
+        perror("realloc");
+        return -1;
+    }
+    *array    = grown;
+    *capacity = grown_capacity;
+    return 0;
+}
+
+/**
+ * compare_zones - qsort() order of PriceHistoryZone by zone id.
+ */
+static int compare_zones(const void *a, const void *b)
+{
+    int64_t za = ((const PriceHistoryZone *)a)->zone_id;
+    int64_t zb = ((const PriceHistoryZone *)b)->zone_id;
+    return (za > zb) - (za < zb);
+}
+
+/**
+ * find_location - Index of @location in the sorted locations, or -1.
+ */
+static long find_location(const PriceHistory *history, const char *location)
+{
+    size_t lo = 0, hi = history->location_count;
+
+    while (lo < hi)
+    {
+        size_t mid   = lo + (hi - lo) / 2;
+        int    order = strcmp(history->locations[mid].location, location);
+        if (order == 0)
+        {
+            return (long)mid;
+        }
+        if (order < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+/**
+ * find_zone - Location of the zone @zone_id, or NULL.
+ */
+static const PriceHistoryLocation *find_zone(const PriceHistory *history, int64_t zone_id)
+{
+    size_t lo = 0, hi = history->zone_count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (history->by_zone[mid].zone_id < zone_id)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo < history->zone_count && history->by_zone[lo].zone_id == zone_id ?
+           &history->locations[history->by_zone[lo].location] : NULL;
+}
+
+/**
+ * last_starting - Index of the last interval of @loc starting at or before
+ *                 @at_ms, or @loc->first - 1 (as size_t) if none.
+ */
+static size_t last_starting(const PriceHistory *history, const PriceHistoryLocation *loc, int64_t at_ms)
+{
+    size_t lo = loc->first, hi = loc->first + loc->count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (history->intervals[mid].valid_from <= at_ms)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+/**
+ * interval_at - Interval of @loc holding @at_ms, or NULL.
+ */
+static const PriceInterval *interval_at(const PriceHistory *history, const PriceHistoryLocation *loc, int64_t at_ms)
+{
+    size_t i = last_starting(history, loc, at_ms);
+    if (i + 1 == loc->first || at_ms >= history->intervals[i].valid_to)
+    {
+        return NULL;
+    }
+    return &history->intervals[i];
+}
+
+
+/**
+ * price_history_load - Load Price_History into an interval index.
+ */
+int price_history_load(sqlite3 *db, PriceHistory *history)
+{
+    sqlite3_stmt *stmt = prk_db_prepare(db,
+        "SELECT h.location, h.price, h.valid_from, h.valid_to, z.id FROM Price_History h "
+        "LEFT JOIN Zones z ON z.name = h.location ORDER BY h.location, h.valid_from, h.id;");
+    size_t       location_capacity = 0, interval_capacity = 0;
+    int          rc                = stmt ? SQLITE_DONE : SQLITE_ERROR;
+
+    memset(history, 0, sizeof(*history));
+    while (stmt && (rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        const char              *location = (const char *)sqlite3_column_text(stmt, 0);
+        PriceHistoryLocation    *loc      = history->location_count ?
+                                            &history->locations[history->location_count - 1] : NULL;
+        location = location ? location : "";
+
+        if (!loc || strcmp(loc->location, location) != 0)
+        {
+            if (grow((void **)&history->locations, &location_capacity, history->location_count,
+                     sizeof(PriceHistoryLocation)) != 0)
+            {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            loc           = &history->locations[history->location_count++];
+            loc->location = string_arena_add(&history->names, location, strlen(location));
+            loc->zone_id  = sqlite3_column_int64(stmt, 4);
+            loc->first    = history->interval_count;
+            loc->count    = 0;
+            if (!loc->location)
+            {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+        }
+        if (grow((void **)&history->intervals, &interval_capacity, history->interval_count,
+                 sizeof(PriceInterval)) != 0)
+        {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+
+        PriceInterval *interval = &history->intervals[history->interval_count++];
+        interval->price      = sqlite3_column_double(stmt, 1);
+        interval->valid_from = sqlite3_column_int64(stmt, 2);
+        interval->valid_to   = sqlite3_column_type(stmt, 3) == SQLITE_NULL ? PRICE_HISTORY_OPEN :
+                               sqlite3_column_int64(stmt, 3);
+        if (loc->count && interval[-1].valid_to > interval->valid_from)
+        {
+            interval[-1].valid_to = interval->valid_from;            /* Keep the intervals disjoint */
+        }
+        loc->count++;
+
+        if (interval->valid_from > history->latest_ms)
+        {
+            history->latest_ms = interval->valid_from;
+        }
+        if (interval->valid_to != PRICE_HISTORY_OPEN && interval->valid_to > history->latest_ms)
+        {
+            history->latest_ms = interval->valid_to;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc == SQLITE_DONE)
+    {
+        history->by_zone = malloc((history->location_count + 1) * sizeof(PriceHistoryZone));
+        rc = history->by_zone ? SQLITE_DONE : SQLITE_NOMEM;
+    }
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Error loading Price_History: %s\n", rc == SQLITE_NOMEM ? "out of memory" : sqlite3_errmsg(db));
+        price_history_free(history);
+        return -1;
+    }
+
+    for (size_t i = 0; i < history->location_count; i++)
+    {
+        if (history->locations[i].zone_id)
+        {
+            history->by_zone[history->zone_count++] = (PriceHistoryZone){ history->locations[i].zone_id, i };
+        }
+    }
+    qsort(history->by_zone, history->zone_count, sizeof(PriceHistoryZone), compare_zones);
+    return 0;
+}
+
+/**
+ * price_history_find - Price of @location at @at_ms.
+ */
+const PriceInterval *price_history_find(const PriceHistory *history, const char *location, int64_t at_ms)
+{
+    long i = find_location(history, location);
+    return i < 0 ? NULL : interval_at(history, &history->locations[i], at_ms);
+}
+
+/**
+ * price_history_find_zone - Price of the zone @zone_id at @at_ms.
+ */
+const PriceInterval *price_history_find_zone(const PriceHistory *history, int64_t zone_id, int64_t at_ms)
+{
+    const PriceHistoryLocation *loc = find_zone(history, zone_id);
+    return loc ? interval_at(history, loc, at_ms) : NULL;
+}
+
+/**
+ * price_history_find_batch - Answer many point-in-time lookups at once.
+ */
+int price_history_find_batch(const PriceHistory *history, const PriceHistoryQuery *queries, size_t count,
+                             const PriceInterval **results)
+{
+    const PriceHistoryLocation  *loc     = NULL;
+    size_t                      at       = 0;                        /* Interval of loc answering the last query */
+    int64_t                     zone_id  = 0, at_ms = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const PriceHistoryQuery *query = &queries[i];
+        if (i == 0 || query->zone_id != zone_id)
+        {
+            loc = find_zone(history, query->zone_id);
+            at  = loc ? last_starting(history, loc, query->at_ms) : 0;
+        }
+        else if (loc && query->at_ms >= at_ms)
+        {
+            /* Same zone, later time: step forward from the last answer */
+            while (at + 1 < loc->first + loc->count && history->intervals[at + 1].valid_from <= query->at_ms)
+            {
+                at++;
+            }
+        }
+        else if (loc)
+        {
+            at = last_starting(history, loc, query->at_ms);
+        }
+        zone_id = query->zone_id;
+        at_ms   = query->at_ms;
+
+        results[i] = loc && at + 1 != loc->first && query->at_ms < history->intervals[at].valid_to ?
+                     &history->intervals[at] : NULL;
+    }
+    return 0;
+}
+
+/**
+ * price_history_free - Release the index.
+ */
+void price_history_free(PriceHistory *history)
+{
+    free(history->locations);
+    free(history->intervals);
+    free(history->by_zone);
+    string_arena_free(&history->names);
+    memset(history, 0, sizeof(*history));
+}
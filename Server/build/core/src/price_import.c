@@ -0,0 +1,515 @@
+/**
+ * price_import.c: Parallel loading of large price files
+ *
+ * The price file used to be read with fgets()/sscanf() into a doubling
+ * array of 108-byte entries holding each name in a fixed 100-byte slot.
+ * Here the file is mapped, cut at line boundaries into one chunk per
+ * thread, and every thread parses, validates and sorts its own chunk,
+ * copying the names into its own string arena. The sorted runs are merged
+ * pairwise, in parallel, and duplicates dropped in one pass over the
+ * result. An entry takes 16 bytes plus its name, so memory follows the
+ * data rather than the longest name allowed.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/price_import.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define PRICE_FIELD_MAX        64                                    /* Longest price text accepted */
+#define INSERTION_RUN          16                                    /* Entries sorted by insertion first */
+
+
+/* One chunk of the file and what its thread made of it */
+typedef struct
+{
+    const char  *begin;                                              /* First byte of the chunk's first line */
+    const char  *end;                                                /* One past the chunk's last byte */
+    CityPrice   *entries;                                            /* Sorted by location once parsed */
+    size_t      count;
+    size_t      capacity;
+    StringArena names;
+    size_t      lines;
+    size_t      invalid;
+    size_t      bad_lines[PRICE_IMPORT_REPORTED];                    /* First invalid lines, numbered in the chunk */
+    int         failed;                                              /* Out of memory */
+    int         started;                                             /* Parsed by its own thread */
+    pthread_t   thread;
+} ImportChunk;
+
+
+/* Merge of two adjacent sorted runs */
+typedef struct
+{
+    const CityPrice *a;
+    size_t          a_count;
+    const CityPrice *b;
+    size_t          b_count;
+    CityPrice       *out;
+    int             started;                                         /* Run by its own thread */
+    pthread_t       thread;
+} MergeJob;
+
+
+/**
+ * merge_runs - Merge two sorted runs into @out, @a first on equal names.
+ */
+static void merge_runs(const CityPrice *a, size_t a_count, const CityPrice *b, size_t b_count, CityPrice *out)
+{
+    size_t i = 0, j = 0;
+
+    while (i < a_count && j < b_count)
+    {
+        *out++ = strcmp(b[j].city, a[i].city) < 0 ? b[j++] : a[i++];
+    }
+    memcpy(out, a + i, (a_count - i) * sizeof(CityPrice));
+    memcpy(out + (a_count - i), b + j, (b_count - j) * sizeof(CityPrice));
+}
+
+/**
+ * sort_prices - Stable sort by location, with @tmp as large as @entries.
+ *
+ * Stable, so of two lines of the same location the later stays later.
+ */
+static void sort_prices(CityPrice *entries, size_t count, CityPrice *tmp)
+{
+    for (size_t run = 0; run < count; run += INSERTION_RUN)
+    {
+        size_t end = run + INSERTION_RUN < count ? run + INSERTION_RUN : count;
+        for (size_t i = run + 1; i < end; i++)
+        {
+            CityPrice entry = entries[i];
+            size_t    j     = i;
+            while (j > run && strcmp(entries[j - 1].city, entry.city) > 0)
+            {
+                entries[j] = entries[j - 1];
+                j--;
+            }
+            entries[j] = entry;
+        }
+    }
+
+    CityPrice *from = entries, *to = tmp;
+    for (size_t width = INSERTION_RUN; width < count; width *= 2)
+    {
+        for (size_t lo = 0; lo < count; lo += 2 * width)
+        {
+            size_t mid = lo + width < count ? lo + width : count;
+            size_t hi  = lo + 2 * width < count ? lo + 2 * width : count;
+            merge_runs(from + lo, mid - lo, from + mid, hi - mid, to + lo);
+        }
+        CityPrice *swap = from;
+        from = to;
+        to   = swap;
+    }
+    if (from != entries)
+    {
+        memcpy(entries, from, count * sizeof(CityPrice));
+    }
+}
+
+/**
+ * parse_line - Parse one line of @len bytes into @entry.
+ *
+ * Return: 1 for an entry, 0 for a blank or comment line, -1 if invalid,
+ * -2 on allocation failure.
+ */
+static int parse_line(const char *line, size_t len, StringArena *names, CityPrice *entry)
+{
+    while (len > 0 && isspace((unsigned char)*line))
+    {
+        line++;
+        len--;
+    }
+    if (len == 0 || *line == '#')
+    {
+        return 0;
+    }
+
+    const char *comma = memchr(line, ',', len);
+    if (!comma)
+    {
+        return -1;
+    }
+    size_t name_len = (size_t)(comma - line);
+    while (name_len > 0 && isspace((unsigned char)line[name_len - 1]))
+    {
+        name_len--;
+    }
+
+    /* The price needs a NUL terminator the mapping does not have */
+    char   field[PRICE_FIELD_MAX];
+    size_t field_len = len - (size_t)(comma + 1 - line);
+    if (name_len == 0 || name_len >= MAX_LINE_LENGTH || field_len >= sizeof(field))
+    {
+        return -1;
+    }
+    memcpy(field, comma + 1, field_len);
+    field[field_len] = '\0';
+
+    char    *end;
+    double  price = strtod(field, &end);
+    while (isspace((unsigned char)*end))
+    {
+        end++;
+    }
+    if (end == field || *end != '\0' || !isfinite(price) || price < 0.0)
+    {
+        return -1;
+    }
+
+    entry->city  = string_arena_add(names, line, name_len);
+    entry->price = price;
+    return entry->city ? 1 : -2;
+}
+
+/**
+ * import_chunk - Parse, validate and sort the lines of one chunk (thread).
+ */
+static void *import_chunk(void *arg)
+{
+    ImportChunk *chunk = arg;
+
+    for (const char *line = chunk->begin; line < chunk->end && !chunk->failed; )
+    {
+        const char  *newline = memchr(line, '\n', (size_t)(chunk->end - line));
+        const char  *next    = newline ? newline + 1 : chunk->end;
+        chunk->lines++;
+
+        if (chunk->count == chunk->capacity)
+        {
+            size_t      grown_capacity = chunk->capacity ? chunk->capacity * 2 : 1024;
+            CityPrice   *grown         = realloc(chunk->entries, grown_capacity * sizeof(CityPrice));
+            if (!grown)
+            {
+                chunk->failed = 1;
+                break;
+            }
+            chunk->entries  = grown;
+            chunk->capacity = grown_capacity;
+        }
+
+        int rc = parse_line(line, (size_t)(next - line), &chunk->names, &chunk->entries[chunk->count]);
+        if (rc > 0)
+        {
+            chunk->count++;
+        }
+        else if (rc == -2)
+        {
+            chunk->failed = 1;
+        }
+        else if (rc < 0)
+        {
+            if (chunk->invalid < PRICE_IMPORT_REPORTED)
+            {
+                chunk->bad_lines[chunk->invalid] = chunk->lines;
+            }
+            chunk->invalid++;
+        }
+        line = next;
+    }
+
+    if (!chunk->failed && !chunk->invalid && chunk->count > 1)
+    {
+        CityPrice *tmp = malloc(chunk->count * sizeof(CityPrice));
+        if (!tmp)
+        {
+            chunk->failed = 1;
+            return NULL;
+        }
+        sort_prices(chunk->entries, chunk->count, tmp);
+        free(tmp);
+    }
+    return NULL;
+}
+
+/**
+ * merge_job - Run one merge (thread).
+ */
+static void *merge_job(void *arg)
+{
+    MergeJob *job = arg;
+    merge_runs(job->a, job->a_count, job->b, job->b_count, job->out);
+    return NULL;
+}
+
+/**
+ * merge_chunks - Merge the sorted runs of every chunk into one sorted array.
+ *
+ * Adjacent runs are merged pairwise, every merge of a round in its own
+ * thread, so the later of two equal names stays later.
+ *
+ * Return: the merged array (@all or @tmp), or NULL on allocation failure.
+ */
+static CityPrice *merge_chunks(const ImportChunk *chunks, int chunk_count, CityPrice *all, CityPrice *tmp)
+{
+    size_t      *runs     = malloc(((size_t)chunk_count + 1) * sizeof(size_t));   /* Run i: [runs[i], runs[i + 1]) */
+    MergeJob    *jobs     = calloc((size_t)chunk_count, sizeof(MergeJob));
+    int         run_count = chunk_count;
+    if (!runs || !jobs)
+    {
+        free(runs);
+        free(jobs);
+        return NULL;
+    }
+
+    runs[0] = 0;
+    for (int c = 0; c < chunk_count; c++)
+    {
+        memcpy(all + runs[c], chunks[c].entries, chunks[c].count * sizeof(CityPrice));
+        runs[c + 1] = runs[c] + chunks[c].count;
+    }
+
+    CityPrice *from = all, *to = tmp;
+    while (run_count > 1)
+    {
+        int job_count = run_count / 2;
+        for (int j = 0; j < job_count; j++)
+        {
+            size_t lo = runs[2 * j], mid = runs[2 * j + 1], hi = runs[2 * j + 2];
+            jobs[j] = (MergeJob){ .a = from + lo, .a_count = mid - lo, .b = from + mid, .b_count = hi - mid,
+                                  .out = to + lo };
+            jobs[j].started = j + 1 < job_count && pthread_create(&jobs[j].thread, NULL, merge_job, &jobs[j]) == 0;
+            if (!jobs[j].started)
+            {
+                merge_job(&jobs[j]);                                 /* The last one runs here */
+            }
+        }
+        if (run_count % 2)
+        {
+            size_t lo = runs[run_count - 1], hi = runs[run_count];
+            memcpy(to + lo, from + lo, (hi - lo) * sizeof(CityPrice));
+        }
+        for (int j = 0; j < job_count; j++)
+        {
+            if (jobs[j].started)
+            {
+                pthread_join(jobs[j].thread, NULL);
+            }
+        }
+
+        /* Run j of the next round is runs 2j and 2j + 1 of this one */
+        for (int r = 1; r <= (run_count + 1) / 2; r++)
+        {
+            runs[r] = runs[2 * r < run_count ? 2 * r : run_count];
+        }
+        run_count = (run_count + 1) / 2;
+
+        CityPrice *swap = from;
+        from = to;
+        to   = swap;
+    }
+
+    free(runs);
+    free(jobs);
+    return from;
+}
+
+/**
+ * split_chunks - Cut [@data, @data + @size) into @count chunks of whole lines.
+ */
+static void split_chunks(const char *data, size_t size, ImportChunk *chunks, int count)
+{
+    const char *end   = data + size;
+    const char *begin = data;
+
+    for (int c = 0; c < count; c++)
+    {
+        const char *cut = c + 1 == count ? end : data + size / (size_t)count * (size_t)(c + 1);
+        if (cut < begin)
+        {
+            cut = begin;
+        }
+        if (cut < end)
+        {
+            const char *newline = memchr(cut, '\n', (size_t)(end - cut));
+            cut = newline ? newline + 1 : end;
+        }
+        chunks[c].begin = begin;
+        chunks[c].end   = cut;
+        begin           = cut;
+    }
+}
+
+/**
+ * import_mapped - Import a mapped file with @thread_count threads.
+ */
+static int import_mapped(const char *path, const char *data, size_t size, int thread_count, PriceList *list,
+                         PriceImportStats *stats)
+{
+    ImportChunk *chunks = calloc((size_t)thread_count, sizeof(ImportChunk));
+    if (!chunks)
+    {
+        perror("calloc");
+        return -1;
+    }
+    split_chunks(data, size, chunks, thread_count);
+
+    /* The first chunk is parsed here, and any chunk whose thread did not start */
+    for (int c = 1; c < thread_count; c++)
+    {
+        chunks[c].started = pthread_create(&chunks[c].thread, NULL, import_chunk, &chunks[c]) == 0;
+    }
+    import_chunk(&chunks[0]);
+    for (int c = 1; c < thread_count; c++)
+    {
+        if (chunks[c].started)
+        {
+            pthread_join(chunks[c].thread, NULL);
+        }
+        else
+        {
+            import_chunk(&chunks[c]);
+        }
+    }
+
+    int     failed = 0;
+    size_t  count  = 0, line_base = 0, reported = 0;
+    for (int c = 0; c < thread_count; c++)
+    {
+        for (size_t i = 0; i < chunks[c].invalid && i < PRICE_IMPORT_REPORTED && reported < PRICE_IMPORT_REPORTED; i++)
+        {
+            fprintf(stderr, "%s:%zu: invalid price line\n", path, line_base + chunks[c].bad_lines[i]);
+            reported++;
+        }
+        failed           |= chunks[c].failed;
+        stats->invalid   += chunks[c].invalid;
+        count            += chunks[c].count;
+        line_base        += chunks[c].lines;
+    }
+    stats->lines   = line_base;
+    stats->threads = thread_count;
+    if (stats->invalid > reported)
+    {
+        fprintf(stderr, "%s: %zu more invalid line(s)\n", path, stats->invalid - reported);
+    }
+    if (failed)
+    {
+        fprintf(stderr, "Out of memory importing %s.\n", path);
+    }
+
+    CityPrice *all = NULL, *tmp = NULL, *merged = NULL;
+    if (!failed && !stats->invalid)
+    {
+        all = malloc((count + 1) * sizeof(CityPrice));
+        tmp = malloc((count + 1) * sizeof(CityPrice));
+        merged = all && tmp ? merge_chunks(chunks, thread_count, all, tmp) : NULL;
+    }
+
+    if (merged)
+    {
+        /* Of each run of equal names keep the last, the file's latest line */
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i + 1 < count && strcmp(merged[i].city, merged[i + 1].city) == 0)
+            {
+                stats->duplicates++;
+                continue;
+            }
+            merged[kept++] = merged[i];
+        }
+
+        CityPrice *shrunk = realloc(merged, (kept + 1) * sizeof(CityPrice));
+        list->entries = shrunk ? shrunk : merged;
+        list->count   = kept;
+        free(merged == all ? tmp : all);
+        for (int c = 0; c < thread_count; c++)
+        {
+            string_arena_join(&list->names, &chunks[c].names);
+        }
+    }
+    else
+    {
+        free(all);
+        free(tmp);
+    }
+
+    for (int c = 0; c < thread_count; c++)
+    {
+        free(chunks[c].entries);
+        string_arena_free(&chunks[c].names);
+    }
+    free(chunks);
+    return merged ? 0 : -1;
+}
+
+
+/**
+ * price_import_file - Load a price file into a sorted, deduplicated list.
+ */
+int price_import_file(const char *path, int threads, PriceList *list, PriceImportStats *stats)
+{
+    PriceImportStats unused;
+    if (!stats)
+    {
+        stats = &unused;
+    }
+    memset(list, 0, sizeof(*list));
+    memset(stats, 0, sizeof(*stats));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error opening price file %s.\n", path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return 0;                                                    /* No prices */
+    }
+
+    size_t  size = (size_t)st.st_size;
+    char    *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror(path);
+        return -1;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    long max_threads = (long)(size / PRICE_IMPORT_CHUNK) + 1;
+    long count       = threads > 0 ? threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > max_threads)
+    {
+        count = max_threads;
+    }
+    if (count > PRICE_IMPORT_MAX_THREADS)
+    {
+        count = PRICE_IMPORT_MAX_THREADS;
+    }
+    if (count < 1)
+    {
+        count = 1;
+    }
+
+    int rc = import_mapped(path, data, size, (int)count, list, stats);
+    munmap(data, size);
+    return rc;
+}
@@ -0,0 +1,523 @@
+/**
+ * price_schedule.c: Time-of-day and tiered rates compiled into lookup tables
+ *
+ * A location's flat price can be refined by rate windows over the week and
+ * by rate factors past a parking duration. Walking those rules for every
+ * session would cost one step per rule and per window crossed; instead
+ * each location's rules are compiled once into the rate of every
+ * SCHEDULE_SLOT_MINUTES slot of the week and the prefix sums of those
+ * rates, and a session costs two interpolated prefix sum lookups per
+ * duration tier it reaches.
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            missing file reported apart, per rule utc_offset
+ *
+ */
+
+#include "../inc/price_schedule.h"
+#include "../inc/prk_db.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+
+#define MAX_FIELDS             5                                     /* Comma separated fields per line */
+#define SLOT_MS                ((int64_t)SCHEDULE_SLOT_MINUTES * 60 * 1000)
+#define WEEK_MS                ((int64_t)7 * 24 * 60 * 60 * 1000)
+#define SLOTS_PER_DAY          (24 * 60 / SCHEDULE_SLOT_MINUTES)
+#define WEEK_ORIGIN_MS         ((int64_t)4 * 24 * 60 * 60 * 1000)    /* 1970-01-05, the first Monday */
+
+
+static const char *day_names[7] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun" };
+
+
+/**
+ * trim - Strip leading and trailing blanks in place.
+ */
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+    {
+        s++;
+    }
+    size_t len = strlen(s);
+    while (len > 0 && isspace((unsigned char)s[len - 1]))
+    {
+        s[--len] = '\0';
+    }
+    return s;
+}
+
+/**
+ * grow - Make room for one more element of @size bytes.
+ */
+static int grow(void **array, size_t *capacity, size_t count, size_t size)
+{
+    if (count < *capacity)
+    {
+        return 0;
+    }
+
+    size_t  grown_capacity = *capacity ? *capacity * 2 : 64;
+    void    *grown         = realloc(*array, grown_capacity * size);
+    if (!grown)
+    {
+        perror("realloc");
+        return -1;
+    }
+    *array    = grown;
+    *capacity = grown_capacity;
+    return 0;
+}
+
+/**
+ * parse_clock - Parse "H:MM" into minutes, at most @max_minutes.
+ */
+static int parse_clock(const char *s, int max_minutes, int *minutes)
+{
+    int hours, mins, used = 0;
+    if (sscanf(s, "%d:%2d%n", &hours, &mins, &used) != 2 || s[used] != '\0' || hours < 0 || mins < 0 || mins > 59)
+    {
+        return -1;
+    }
+    *minutes = hours * 60 + mins;
+    return *minutes <= max_minutes ? 0 : -1;
+}
+
+/**
+ * parse_day - Index of a day name (its first three letters), or -1.
+ */
+static int parse_day(const char *s, size_t len)
+{
+    for (int d = 0; d < 7 && len >= 3; d++)
+    {
+        if (strncasecmp(s, day_names[d], 3) == 0)
+        {
+            return d;
+        }
+    }
+    return -1;
+}
+
+/**
+ * parse_days - Parse "*", "Mon", "Mon-Fri", "Sat+Sun", "Fri-Mon+Wed" into a mask.
+ */
+static int parse_days(const char *s, uint8_t *days)
+{
+    if (strcmp(s, "*") == 0)
+    {
+        *days = SCHEDULE_ALL_DAYS;
+        return 0;
+    }
+
+    *days = 0;
+    while (*s)
+    {
+        size_t      len  = strcspn(s, "+");
+        const char  *dash = memchr(s, '-', len);
+        int         from = parse_day(s, dash ? (size_t)(dash - s) : len);
+        int         to   = dash ? parse_day(dash + 1, len - (size_t)(dash + 1 - s)) : from;
+        if (from < 0 || to < 0)
+        {
+            return -1;
+        }
+        for (int d = from; ; d = (d + 1) % 7)                        /* "Fri-Mon" wraps over the weekend */
+        {
+            *days |= (uint8_t)(1u << d);
+            if (d == to)
+            {
+                break;
+            }
+        }
+        s += len + (s[len] == '+');
+    }
+    return *days ? 0 : -1;
+}
+
+/**
+ * parse_line - Add the rule or tier of one schedule line to @set.
+ */
+static int parse_line(char *line, int *utc_offset_min, ScheduleSet *set, size_t *rule_capacity,
+                      size_t *tier_capacity)
+{
+    char *hash = strchr(line, '#');
+    if (hash)
+    {
+        *hash = '\0';
+    }
+    line = trim(line);
+    if (*line == '\0')
+    {
+        return 0;
+    }
+
+    if (strncmp(line, "utc_offset", 10) == 0 && isspace((unsigned char)line[10]))
+    {
+        char    *value = trim(line + 10);
+        int     sign   = *value == '-' ? -1 : 1;
+        int     minutes;
+        if ((*value != '+' && *value != '-') || parse_clock(value + 1, 14 * 60, &minutes) != 0 ||
+            minutes % SCHEDULE_SLOT_MINUTES != 0)
+        {
+            return -1;
+        }
+        *utc_offset_min = sign * minutes;
+        return 0;
+    }
+
+    char    *fields[MAX_FIELDS];
+    int     count = 0;
+    for (char *field = line; field; count++)
+    {
+        if (count == MAX_FIELDS)
+        {
+            return -1;
+        }
+        char *comma = strchr(field, ',');
+        if (comma)
+        {
+            *comma = '\0';
+        }
+        fields[count] = trim(field);
+        field = comma ? comma + 1 : NULL;
+    }
+    if (count < 3 || fields[0][0] == '\0' || strlen(fields[0]) >= MAX_LINE_LENGTH)
+    {
+        return -1;
+    }
+
+    if (count == 3 && strncmp(fields[1], "after", 5) == 0 && isspace((unsigned char)fields[1][5]))
+    {
+        ScheduleTier    tier;
+        char            *end;
+        int             minutes;
+        if (parse_clock(trim(fields[1] + 5), INT32_MAX / 60, &minutes) != 0 || fields[2][0] != 'x')
+        {
+            return -1;
+        }
+        tier.factor = strtod(fields[2] + 1, &end);
+        if (end == fields[2] + 1 || *end != '\0' || tier.factor < 0.0)
+        {
+            return -1;
+        }
+        snprintf(tier.location, sizeof(tier.location), "%s", fields[0]);
+        tier.after_min = (uint32_t)minutes;
+
+        if (grow((void **)&set->tiers, tier_capacity, set->tier_count, sizeof(ScheduleTier)) != 0)
+        {
+            return -1;
+        }
+        set->tiers[set->tier_count++] = tier;
+        return 0;
+    }
+
+    ScheduleRule    rule;
+    char            *dash = strchr(fields[2], '-');
+    char            *end;
+    int             start_min, end_min;
+    if (count != 4 || !dash || parse_days(fields[1], &rule.days) != 0)
+    {
+        return -1;
+    }
+    *dash = '\0';
+    if (parse_clock(trim(fields[2]), 24 * 60 - 1, &start_min) != 0 ||
+        parse_clock(trim(dash + 1), 24 * 60, &end_min) != 0 || start_min == end_min ||
+        start_min % SCHEDULE_SLOT_MINUTES != 0 || end_min % SCHEDULE_SLOT_MINUTES != 0)
+    {
+        return -1;
+    }
+    rule.price = strtod(fields[3], &end);
+    if (end == fields[3] || *end != '\0' || rule.price < 0.0)
+    {
+        return -1;
+    }
+    snprintf(rule.location, sizeof(rule.location), "%s", fields[0]);
+    rule.start_min      = (uint16_t)start_min;
+    rule.end_min        = (uint16_t)end_min;
+    rule.utc_offset_min = (int16_t)*utc_offset_min;
+
+    if (grow((void **)&set->rules, rule_capacity, set->rule_count, sizeof(ScheduleRule)) != 0)
+    {
+        return -1;
+    }
+    set->rules[set->rule_count++] = rule;
+    return 0;
+}
+
+/**
+ * compare_tiers - qsort() order of PriceTier by after_ms.
+ */
+static int compare_tiers(const void *a, const void *b)
+{
+    const PriceTier *ta = a, *tb = b;
+    return (ta->after_ms > tb->after_ms) - (ta->after_ms < tb->after_ms);
+}
+
+/**
+ * cost_until - Cost from Monday 00:00 local time of week 0 to @t_ms.
+ */
+static inline double cost_until(const PriceSchedule *schedule, int64_t t_ms)
+{
+    int64_t local = t_ms + schedule->utc_offset_ms - WEEK_ORIGIN_MS;
+    int64_t week  = local / WEEK_MS;
+    int64_t rem   = local % WEEK_MS;
+    if (rem < 0)
+    {
+        rem += WEEK_MS;
+        week--;
+    }
+
+    int64_t         slot  = rem / SLOT_MS;
+    const double    *p    = &schedule->prefix[slot];
+    return (double)week * schedule->prefix[SCHEDULE_SLOTS] + p[0] + (p[1] - p[0]) * (double)(rem - slot * SLOT_MS) /
+           (double)SLOT_MS;
+}
+
+
+/**
+ * price_schedule_parse - Read a schedule file.
+ */
+int price_schedule_parse(const char *path, ScheduleSet *set)
+{
+    memset(set, 0, sizeof(*set));
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        if (errno == ENOENT)
+        {
+            return 1;
+        }
+        perror(path);
+        return -1;
+    }
+
+    char    line[4 * MAX_LINE_LENGTH];
+    size_t  rule_capacity = 0, tier_capacity = 0;
+    int     utc_offset_min = 0, line_no = 0, rc = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        line_no++;
+        if (parse_line(line, &utc_offset_min, set, &rule_capacity, &tier_capacity) != 0)
+        {
+            fprintf(stderr, "%s:%d: invalid schedule line\n", path, line_no);
+            rc = -1;
+        }
+    }
+    fclose(file);
+
+    if (rc != 0)
+    {
+        price_schedule_set_free(set);
+    }
+    return rc;
+}
+
+/**
+ * price_schedule_store - Replace Price_Schedules and Price_Tiers with @set.
+ */
+int price_schedule_store(sqlite3 *db, const ScheduleSet *set)
+{
+    sqlite3_stmt *rule_stmt = prk_db_prepare(db,
+        "INSERT INTO Price_Schedules (location, days, start_min, end_min, utc_offset_min, price) "
+        "VALUES (?, ?, ?, ?, ?, ?);");
+    sqlite3_stmt *tier_stmt = prk_db_prepare(db,
+        "INSERT INTO Price_Tiers (location, after_min, factor) VALUES (?, ?, ?);");
+    int          rc         = -1;
+
+    if (rule_stmt && tier_stmt && prk_db_exec(db, "BEGIN IMMEDIATE;") == 0)
+    {
+        rc = prk_db_exec(db, "DELETE FROM Price_Schedules; DELETE FROM Price_Tiers;");
+        for (size_t i = 0; rc == 0 && i < set->rule_count; i++)
+        {
+            const ScheduleRule *rule = &set->rules[i];
+            sqlite3_bind_text(rule_stmt, 1, rule->location, -1, SQLITE_STATIC);
+            sqlite3_bind_int(rule_stmt, 2, rule->days);
+            sqlite3_bind_int(rule_stmt, 3, rule->start_min);
+            sqlite3_bind_int(rule_stmt, 4, rule->end_min);
+            sqlite3_bind_int(rule_stmt, 5, rule->utc_offset_min);
+            sqlite3_bind_double(rule_stmt, 6, rule->price);
+            rc = sqlite3_step(rule_stmt) == SQLITE_DONE ? 0 : -1;
+            sqlite3_reset(rule_stmt);
+        }
+        for (size_t i = 0; rc == 0 && i < set->tier_count; i++)
+        {
+            const ScheduleTier *tier = &set->tiers[i];
+            sqlite3_bind_text(tier_stmt, 1, tier->location, -1, SQLITE_STATIC);
+            sqlite3_bind_int64(tier_stmt, 2, tier->after_min);
+            sqlite3_bind_double(tier_stmt, 3, tier->factor);
+            rc = sqlite3_step(tier_stmt) == SQLITE_DONE ? 0 : -1;
+            sqlite3_reset(tier_stmt);
+        }
+
+        if (rc == 0)
+        {
+            rc = prk_db_exec(db, "COMMIT;");
+        }
+        else
+        {
+            fprintf(stderr, "Error storing the price schedules: %s\n", sqlite3_errmsg(db));
+            prk_db_exec(db, "ROLLBACK;");
+        }
+    }
+
+    sqlite3_finalize(rule_stmt);
+    sqlite3_finalize(tier_stmt);
+    return rc;
+}
+
+/**
+ * price_schedule_load - Load Price_Schedules and Price_Tiers.
+ */
+int price_schedule_load(sqlite3 *db, ScheduleSet *set)
+{
+    sqlite3_stmt *rule_stmt = prk_db_prepare(db,
+        "SELECT location, days, start_min, end_min, utc_offset_min, price FROM Price_Schedules ORDER BY location, id;");
+    sqlite3_stmt *tier_stmt = prk_db_prepare(db,
+        "SELECT location, after_min, factor FROM Price_Tiers ORDER BY location, after_min;");
+    size_t       rule_capacity = 0, tier_capacity = 0;
+    int          rc = rule_stmt && tier_stmt ? SQLITE_DONE : SQLITE_ERROR;
+
+    memset(set, 0, sizeof(*set));
+    while (rc == SQLITE_DONE && (rc = sqlite3_step(rule_stmt)) == SQLITE_ROW)
+    {
+        if (grow((void **)&set->rules, &rule_capacity, set->rule_count, sizeof(ScheduleRule)) != 0)
+        {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        ScheduleRule    *rule     = &set->rules[set->rule_count++];
+        const char      *location = (const char *)sqlite3_column_text(rule_stmt, 0);
+        snprintf(rule->location, sizeof(rule->location), "%s", location ? location : "");
+        rule->days           = (uint8_t)sqlite3_column_int(rule_stmt, 1);
+        rule->start_min      = (uint16_t)sqlite3_column_int(rule_stmt, 2);
+        rule->end_min        = (uint16_t)sqlite3_column_int(rule_stmt, 3);
+        rule->utc_offset_min = (int16_t)sqlite3_column_int(rule_stmt, 4);
+        rule->price          = sqlite3_column_double(rule_stmt, 5);
+        rc = SQLITE_DONE;
+    }
+    while (rc == SQLITE_DONE && (rc = sqlite3_step(tier_stmt)) == SQLITE_ROW)
+    {
+        if (grow((void **)&set->tiers, &tier_capacity, set->tier_count, sizeof(ScheduleTier)) != 0)
+        {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        ScheduleTier    *tier     = &set->tiers[set->tier_count++];
+        const char      *location = (const char *)sqlite3_column_text(tier_stmt, 0);
+        snprintf(tier->location, sizeof(tier->location), "%s", location ? location : "");
+        tier->after_min = (uint32_t)sqlite3_column_int64(tier_stmt, 1);
+        tier->factor    = sqlite3_column_double(tier_stmt, 2);
+        rc = SQLITE_DONE;
+    }
+    sqlite3_finalize(rule_stmt);
+    sqlite3_finalize(tier_stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Error loading the price schedules: %s\n", sqlite3_errmsg(db));
+        price_schedule_set_free(set);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * price_schedule_compile - Compile the rules and tiers of one location.
+ */
+void price_schedule_compile(PriceSchedule *schedule, double base_price, const ScheduleRule *rules,
+                            size_t rule_count, const ScheduleTier *tiers, size_t tier_count)
+{
+    double rate[SCHEDULE_SLOTS];
+
+    memset(schedule, 0, sizeof(*schedule));
+    for (int s = 0; s < SCHEDULE_SLOTS; s++)
+    {
+        rate[s] = base_price;
+    }
+
+    /* Slots are in the local time of the first rule, a rule in another offset is shifted by the difference */
+    for (size_t i = 0; i < rule_count; i++)
+    {
+        const ScheduleRule *rule = &rules[i];
+        int shift = (rule->utc_offset_min - rules[0].utc_offset_min) / SCHEDULE_SLOT_MINUTES;
+        int first = rule->start_min / SCHEDULE_SLOT_MINUTES;
+        int last  = rule->end_min / SCHEDULE_SLOT_MINUTES;
+        if (last <= first)
+        {
+            last += SLOTS_PER_DAY;                                   /* Overnight: ends on the next day */
+        }
+        for (int d = 0; d < 7; d++)
+        {
+            if (!(rule->days & (1u << d)))
+            {
+                continue;
+            }
+            for (int s = first; s < last; s++)
+            {
+                rate[(d * SLOTS_PER_DAY + s - shift + SCHEDULE_SLOTS) % SCHEDULE_SLOTS] = rule->price;
+            }
+        }
+    }
+    schedule->utc_offset_ms = rule_count ? (int64_t)rules[0].utc_offset_min * 60 * 1000 : 0;
+
+    for (int s = 0; s < SCHEDULE_SLOTS; s++)
+    {
+        schedule->prefix[s + 1] = schedule->prefix[s] + rate[s] * SCHEDULE_SLOT_MINUTES / 60.0;
+    }
+
+    for (size_t i = 0; i < tier_count && i < SCHEDULE_MAX_TIERS; i++)
+    {
+        schedule->tiers[i].after_ms = (int64_t)tiers[i].after_min * 60 * 1000;
+        schedule->tiers[i].factor   = tiers[i].factor;
+    }
+    schedule->tier_count = tier_count < SCHEDULE_MAX_TIERS ? (uint32_t)tier_count : SCHEDULE_MAX_TIERS;
+    qsort(schedule->tiers, schedule->tier_count, sizeof(PriceTier), compare_tiers);
+}
+
+/**
+ * price_schedule_cost - Cost of parking from @start_ms to @end_ms.
+ */
+double price_schedule_cost(const PriceSchedule *schedule, int64_t start_ms, int64_t end_ms)
+{
+    double  cost      = 0.0;
+    double  factor    = 1.0;
+    int64_t from      = start_ms;
+    double  from_cost = cost_until(schedule, start_ms);
+
+    for (uint32_t i = 0; i < schedule->tier_count; i++)
+    {
+        int64_t boundary = start_ms + schedule->tiers[i].after_ms;
+        if (boundary >= end_ms)
+        {
+            break;
+        }
+        if (boundary > from)
+        {
+            double boundary_cost = cost_until(schedule, boundary);
+            cost     += factor * (boundary_cost - from_cost);
+            from      = boundary;
+            from_cost = boundary_cost;
+        }
+        factor = schedule->tiers[i].factor;
+    }
+    return cost + factor * (cost_until(schedule, end_ms) - from_cost);
+}
+
+/**
+ * price_schedule_set_free - Release the arrays of a set.
+ */
+void price_schedule_set_free(ScheduleSet *set)
+{
+    free(set->rules);
+    free(set->tiers);
+    memset(set, 0, sizeof(*set));
+}
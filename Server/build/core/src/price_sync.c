@@ -0,0 +1,245 @@
+/**
+ * price_sync.c: Bring the Prices table in line with a price file
+ *
+ * out_update_prices used to run one sqlite3 process per location to read
+ * its price, one more per INSERT, UPDATE or DELETE, and compared the two
+ * sides with a nested loop. Here both sides are loaded once in location
+ * order (the table over the embedded connection, the file by
+ * price_import.c), matched in one merge pass and the resulting diff is
+ * applied with prepared statements in one transaction.
+ *
+ * Version: v1.2
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            merge diff of sorted lists, names in an arena
+ *   19-10-2026       Morris              v1.2            Price_History kept with every change
+ *
+ */
+
+#include "../inc/price_sync.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * price_hash_city - FNV-1a hash of a location.
+ */
+uint64_t price_hash_city(const char *city)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while (*city)
+    {
+        hash = (hash ^ (unsigned char)*city++) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+/**
+ * load_price_table - Load every row of the Prices table, in location order.
+ */
+int load_price_table(sqlite3 *db, PriceList *list)
+{
+    sqlite3_stmt    *stmt     = prk_db_prepare(db, "SELECT location, price FROM Prices ORDER BY location;");
+    size_t          capacity  = 0;
+    int             rc        = SQLITE_DONE;
+
+    memset(list, 0, sizeof(*list));
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (list->count == capacity)
+        {
+            size_t      grown_capacity = capacity ? capacity * 2 : 1024;
+            CityPrice   *grown         = realloc(list->entries, grown_capacity * sizeof(CityPrice));
+            if (!grown)
+            {
+                perror("realloc");
+                break;
+            }
+            list->entries = grown;
+            capacity      = grown_capacity;
+        }
+
+        const char  *city  = (const char *)sqlite3_column_text(stmt, 0);
+        CityPrice   *entry = &list->entries[list->count];
+        entry->city  = string_arena_add(&list->names, city ? city : "", (size_t)sqlite3_column_bytes(stmt, 0));
+        entry->price = sqlite3_column_double(stmt, 1);
+        if (!entry->city)
+        {
+            break;
+        }
+        list->count++;
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Error reading Prices: %s\n", sqlite3_errmsg(db));
+        price_list_free(list);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * diff_prices - Compute the changes from the table's prices to the file's.
+ */
+int diff_prices(const PriceList *table, const PriceList *file, PriceDiff *diff)
+{
+    memset(diff, 0, sizeof(*diff));
+    diff->inserts = malloc((file->count + 1) * sizeof(CityPrice *));
+    diff->updates = malloc((file->count + 1) * sizeof(CityPrice *));
+    diff->deletes = malloc((table->count + 1) * sizeof(CityPrice *));
+    if (!diff->inserts || !diff->updates || !diff->deletes)
+    {
+        perror("malloc");
+        price_diff_free(diff);
+        return -1;
+    }
+
+    /* One merge pass sorts every location into its change */
+    size_t t = 0, f = 0;
+    while (t < table->count || f < file->count)
+    {
+        int order = t == table->count ? 1 : f == file->count ? -1 :
+                    strcmp(table->entries[t].city, file->entries[f].city);
+        if (order < 0)
+        {
+            diff->deletes[diff->delete_count++] = &table->entries[t++];
+        }
+        else if (order > 0)
+        {
+            diff->inserts[diff->insert_count++] = &file->entries[f++];
+        }
+        else
+        {
+            if (table->entries[t].price != file->entries[f].price)
+            {
+                diff->updates[diff->update_count++] = &file->entries[f];
+            }
+            else
+            {
+                diff->unchanged++;
+            }
+            t++;
+            f++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * run_each - Step every statement of @stmts once per entry.
+ *
+ * Parameters are bound by name: :location, :price and :now, where the
+ * statement has them.
+ */
+static int run_each(sqlite3 *db, sqlite3_stmt **stmts, size_t stmt_count, const CityPrice **entries, size_t count,
+                    int64_t now_ms)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t s = 0; s < stmt_count; s++)
+        {
+            sqlite3_stmt *stmt = stmts[s];
+            int          param;
+            if ((param = sqlite3_bind_parameter_index(stmt, ":location")) > 0)
+            {
+                sqlite3_bind_text(stmt, param, entries[i]->city, -1, SQLITE_STATIC);
+            }
+            if ((param = sqlite3_bind_parameter_index(stmt, ":price")) > 0)
+            {
+                sqlite3_bind_double(stmt, param, entries[i]->price);
+            }
+            if ((param = sqlite3_bind_parameter_index(stmt, ":now")) > 0)
+            {
+                sqlite3_bind_int64(stmt, param, now_ms);
+            }
+
+            int rc = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            if (rc != SQLITE_DONE)
+            {
+                fprintf(stderr, "Error updating the price of %s: %s\n", entries[i]->city, sqlite3_errmsg(db));
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * apply_price_diff - Apply the changes in one transaction.
+ */
+int apply_price_diff(sqlite3 *db, const PriceDiff *diff, int64_t now_ms)
+{
+    sqlite3_stmt *delete_stmt = prk_db_prepare(db, "DELETE FROM Prices WHERE location = :location;");
+    sqlite3_stmt *update_stmt = prk_db_prepare(db,
+        "UPDATE Prices SET price = :price, valid_from = :now WHERE location = :location;");
+    sqlite3_stmt *insert_stmt = prk_db_prepare(db,
+        "INSERT INTO Prices (location, price, valid_from) VALUES (:location, :price, :now);");
+    sqlite3_stmt *close_stmt  = prk_db_prepare(db,
+        "UPDATE Price_History SET valid_to = :now WHERE location = :location AND valid_to IS NULL;");
+    sqlite3_stmt *open_stmt   = prk_db_prepare(db,
+        "INSERT INTO Price_History (location, price, valid_from) VALUES (:location, :price, :now);");
+    int          rc           = -1;
+
+    if (delete_stmt && update_stmt && insert_stmt && close_stmt && open_stmt &&
+        prk_db_exec(db, "BEGIN IMMEDIATE;") == 0)
+    {
+        sqlite3_stmt *deletes[] = { delete_stmt, close_stmt };
+        sqlite3_stmt *updates[] = { update_stmt, close_stmt, open_stmt };
+        sqlite3_stmt *inserts[] = { insert_stmt, open_stmt };
+
+        if (run_each(db, deletes, 2, diff->deletes, diff->delete_count, now_ms) == 0 &&
+            run_each(db, updates, 3, diff->updates, diff->update_count, now_ms) == 0 &&
+            run_each(db, inserts, 2, diff->inserts, diff->insert_count, now_ms) == 0)
+        {
+            rc = prk_db_exec(db, "COMMIT;");
+        }
+        else
+        {
+            prk_db_exec(db, "ROLLBACK;");
+        }
+    }
+
+    sqlite3_finalize(delete_stmt);
+    sqlite3_finalize(update_stmt);
+    sqlite3_finalize(insert_stmt);
+    sqlite3_finalize(close_stmt);
+    sqlite3_finalize(open_stmt);
+    return rc;
+}
+
+/**
+ * price_list_free - Release the entries and names of a list.
+ */
+void price_list_free(PriceList *list)
+{
+    free(list->entries);
+    string_arena_free(&list->names);
+    memset(list, 0, sizeof(*list));
+}
+
+/**
+ * price_diff_free - Release the arrays of a diff.
+ */
+void price_diff_free(PriceDiff *diff)
+{
+    free(diff->inserts);
+    free(diff->updates);
+    free(diff->deletes);
+    memset(diff, 0, sizeof(*diff));
+}
@@ -0,0 +1,598 @@
+/**
+ * price_table.c: Shared, hot-reloadable table of prices
+ *
+ * Every price lookup used to be a query on Prices. Here the prices are
+ * published in shared memory as immutable snapshots, one shm object per
+ * generation, and a small control object names the current generation.
+ * A publisher writes the next snapshot completely, then switches the
+ * generation with one release store; a reader compares the generation
+ * with the one it mapped on each lookup and maps the new snapshot when
+ * it changed. Readers take no lock and never see a half written table.
+ * An old snapshot is unlinked once replaced and freed by the kernel when
+ * its last reader unmaps it, which is the whole grace period.
+ * Locations with time-of-day or tiered rates carry their compiled
+ * schedule (price_schedule.c) in the snapshot.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            compiled price schedules, private tables
+ *   19-10-2026       Morris              v1.2            valid_from of each price
+ *
+ */
+
+#include "../inc/price_table.h"
+#include "../inc/prk_db.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define MAP_ATTEMPTS           4                                     /* Snapshots replaced while being mapped */
+
+
+/**
+ * table_entries - Entries following the header of @table.
+ */
+static inline const PriceTableEntry *table_entries(const PriceTable *table)
+{
+    return (const PriceTableEntry *)(table + 1);
+}
+
+/**
+ * table_schedules - Compiled schedules following the entries.
+ */
+static inline const PriceSchedule *table_schedules(const PriceTable *table)
+{
+    return (const PriceSchedule *)(table_entries(table) + table->count);
+}
+
+/**
+ * table_by_zone - Zone index following the schedules.
+ */
+static inline const PriceTableZone *table_by_zone(const PriceTable *table)
+{
+    return (const PriceTableZone *)(table_schedules(table) + table->schedule_count);
+}
+
+/**
+ * table_slots - Location hash index following the zone index.
+ */
+static inline const uint32_t *table_slots(const PriceTable *table)
+{
+    return (const uint32_t *)(table_by_zone(table) + table->zone_count);
+}
+
+/**
+ * table_bytes - Size of the table described by @header's counts.
+ */
+static size_t table_bytes(const PriceTable *header)
+{
+    return sizeof(PriceTable) + header->count * sizeof(PriceTableEntry) +
+           header->schedule_count * sizeof(PriceSchedule) + header->zone_count * sizeof(PriceTableZone) +
+           header->slot_count * sizeof(uint32_t);
+}
+
+/**
+ * table_layout - Counts of the table holding @source, in @header.
+ */
+static size_t table_layout(const PriceTableSource *source, PriceTable *header)
+{
+    memset(header, 0, sizeof(*header));
+    header->count          = source->count;
+    header->schedule_count = source->schedule_count;
+    header->slot_count     = 16;
+    while (header->slot_count < 2 * (uint64_t)source->count)
+    {
+        header->slot_count *= 2;
+    }
+    for (size_t i = 0; i < source->count; i++)
+    {
+        header->zone_count += source->entries[i].zone_id != 0;
+    }
+    return table_bytes(header);
+}
+
+/**
+ * snapshot_name - Name of the shm object of @generation.
+ */
+static void snapshot_name(char *buf, size_t len, const char *name, uint64_t generation)
+{
+    snprintf(buf, len, "%s.%llu", name, (unsigned long long)generation);
+}
+
+/**
+ * compare_zones - qsort() order of PriceTableZone by zone id.
+ */
+static int compare_zones(const void *a, const void *b)
+{
+    const PriceTableZone *ka = a, *kb = b;
+    return (ka->zone_id > kb->zone_id) - (ka->zone_id < kb->zone_id);
+}
+
+/**
+ * fill_table - Write @source and its indexes into zeroed memory sized by table_layout().
+ */
+static void fill_table(PriceTable *table, const PriceTable *header, const PriceTableSource *source)
+{
+    *table = *header;
+
+    PriceTableEntry *copy    = (PriceTableEntry *)table_entries(table);
+    PriceTableZone  *by_zone = (PriceTableZone *)table_by_zone(table);
+    uint32_t        *slots   = (uint32_t *)table_slots(table);
+    size_t          mask     = (size_t)table->slot_count - 1;
+
+    memcpy(copy, source->entries, source->count * sizeof(PriceTableEntry));
+    memcpy((PriceSchedule *)table_schedules(table), source->schedules, source->schedule_count * sizeof(PriceSchedule));
+    for (size_t i = 0, z = 0; i < source->count; i++)
+    {
+        if (copy[i].zone_id)
+        {
+            by_zone[z++] = (PriceTableZone){ copy[i].zone_id, i };
+        }
+    }
+    qsort(by_zone, table->zone_count, sizeof(PriceTableZone), compare_zones);
+
+    /* Every slot starts free in zeroed memory */
+    for (size_t i = 0; i < source->count; i++)
+    {
+        size_t s = (size_t)price_hash_city(copy[i].location) & mask;
+        while (slots[s] && strcmp(copy[slots[s] - 1].location, copy[i].location) != 0)
+        {
+            s = (s + 1) & mask;
+        }
+        if (!slots[s])
+        {
+            slots[s] = (uint32_t)i + 1;                              /* A repeated location keeps its first entry */
+        }
+    }
+
+    table->format = PRICE_TABLE_FORMAT;
+    table->magic  = PRICE_TABLE_MAGIC;
+}
+
+/**
+ * write_snapshot - Create the shm object of @generation holding @source.
+ */
+static int write_snapshot(const char *name, uint64_t generation, const PriceTableSource *source)
+{
+    PriceTable header;
+    size_t     size = table_layout(source, &header);
+
+    char snapshot[PRICE_TABLE_NAME_MAX + 24];
+    snapshot_name(snapshot, sizeof(snapshot), name, generation);
+    shm_unlink(snapshot);                                            /* Left behind by a publisher that died */
+
+    int fd = shm_open(snapshot, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)size) != 0)                   /* ftruncate() zero fills */
+    {
+        perror(snapshot);
+        if (fd >= 0)
+        {
+            close(fd);
+            shm_unlink(snapshot);
+        }
+        return -1;
+    }
+    PriceTable *table = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (table == MAP_FAILED)
+    {
+        perror("mmap");
+        shm_unlink(snapshot);
+        return -1;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.published_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    header.generation   = generation;
+    fill_table(table, &header, source);
+    munmap(table, size);
+    return 0;
+}
+
+/**
+ * map_generation - Map the snapshot current in the control object (slow path).
+ */
+static const PriceTable *map_generation(PriceTableReader *reader, uint64_t generation)
+{
+    for (int attempt = 0; attempt < MAP_ATTEMPTS && generation != reader->generation; attempt++)
+    {
+        char snapshot[PRICE_TABLE_NAME_MAX + 24];
+        snapshot_name(snapshot, sizeof(snapshot), reader->name, generation);
+
+        int         fd = shm_open(snapshot, O_RDONLY, 0);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PriceTable))
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            /* Replaced between the load and the open: try the newer one */
+            generation = atomic_load_explicit(&reader->control->generation, memory_order_acquire);
+            continue;
+        }
+
+        size_t              size  = (size_t)st.st_size;
+        const PriceTable    *table = mmap(NULL, size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (table == MAP_FAILED)                                     /* Prefaulted: lookups never page fault */
+        {
+            break;
+        }
+        if (table->magic != PRICE_TABLE_MAGIC || table->format != PRICE_TABLE_FORMAT ||
+            table->generation != generation || table->count >= UINT32_MAX || size < table_bytes(table))
+        {
+            fprintf(stderr, "Invalid price table %s, keeping generation %llu\n", snapshot,
+                    (unsigned long long)reader->generation);
+            munmap((void *)table, size);
+            break;
+        }
+
+        if (reader->table)
+        {
+            munmap((void *)reader->table, reader->table_size);
+        }
+        reader->table      = table;
+        reader->table_size = size;
+        reader->generation = generation;
+        reader->reloads++;
+    }
+    return reader->table;
+}
+
+
+/**
+ * attach_schedules - Compile the schedule of every entry with rules or tiers.
+ *
+ * Entries and both lists of @set are in location order, so one merge pass
+ * pairs them. Rules of locations without a price are ignored.
+ */
+static int attach_schedules(PriceTableSource *source, const ScheduleSet *set)
+{
+    size_t r = 0, t = 0, capacity = 0;
+
+    for (size_t i = 0; i < source->count; i++)
+    {
+        PriceTableEntry *entry = &source->entries[i];
+        while (r < set->rule_count && strcmp(set->rules[r].location, entry->location) < 0)
+        {
+            r++;
+        }
+        while (t < set->tier_count && strcmp(set->tiers[t].location, entry->location) < 0)
+        {
+            t++;
+        }
+
+        size_t rule_end = r, tier_end = t;
+        while (rule_end < set->rule_count && strcmp(set->rules[rule_end].location, entry->location) == 0)
+        {
+            rule_end++;
+        }
+        while (tier_end < set->tier_count && strcmp(set->tiers[tier_end].location, entry->location) == 0)
+        {
+            tier_end++;
+        }
+        if (rule_end == r && tier_end == t)
+        {
+            continue;
+        }
+
+        if (source->schedule_count == capacity)
+        {
+            size_t          grown_capacity = capacity ? capacity * 2 : 16;
+            PriceSchedule   *grown         = realloc(source->schedules, grown_capacity * sizeof(PriceSchedule));
+            if (!grown)
+            {
+                perror("realloc");
+                return -1;
+            }
+            source->schedules = grown;
+            capacity          = grown_capacity;
+        }
+        price_schedule_compile(&source->schedules[source->schedule_count++], entry->price, &set->rules[r],
+                               rule_end - r, &set->tiers[t], tier_end - t);
+        entry->schedule = (uint32_t)source->schedule_count;
+        r = rule_end;
+        t = tier_end;
+    }
+    return 0;
+}
+
+
+/**
+ * price_table_load - Load every price with its zone and compiled schedule.
+ */
+int price_table_load(sqlite3 *db, PriceTableSource *source)
+{
+    sqlite3_stmt    *stmt     = prk_db_prepare(db,
+        "SELECT Prices.location, Prices.price, coalesce(Zones.id, 0), Prices.valid_from FROM Prices "
+        "LEFT JOIN Zones ON Zones.name = Prices.location ORDER BY Prices.location;");
+    size_t          capacity  = 0;
+    int             rc        = SQLITE_DONE;
+
+    memset(source, 0, sizeof(*source));
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (source->count == capacity)
+        {
+            size_t          grown_capacity = capacity ? capacity * 2 : 1024;
+            PriceTableEntry *grown         = realloc(source->entries, grown_capacity * sizeof(PriceTableEntry));
+            if (!grown)
+            {
+                perror("realloc");
+                break;
+            }
+            source->entries = grown;
+            capacity        = grown_capacity;
+        }
+
+        PriceTableEntry *entry    = &source->entries[source->count++];
+        const char      *location = (const char *)sqlite3_column_text(stmt, 0);
+        memset(entry, 0, sizeof(*entry));
+        snprintf(entry->location, sizeof(entry->location), "%s", location ? location : "");
+        entry->price      = sqlite3_column_double(stmt, 1);
+        entry->zone_id    = sqlite3_column_int64(stmt, 2);
+        entry->valid_from = sqlite3_column_int64(stmt, 3);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Error loading the price table: %s\n", sqlite3_errmsg(db));
+        price_table_source_free(source);
+        return -1;
+    }
+
+    ScheduleSet set;
+    if (price_schedule_load(db, &set) != 0 || attach_schedules(source, &set) != 0)
+    {
+        price_schedule_set_free(&set);
+        price_table_source_free(source);
+        return -1;
+    }
+    price_schedule_set_free(&set);
+    return 0;
+}
+
+/**
+ * price_table_source_free - Release the arrays of a source.
+ */
+void price_table_source_free(PriceTableSource *source)
+{
+    free(source->entries);
+    free(source->schedules);
+    memset(source, 0, sizeof(*source));
+}
+
+/**
+ * price_table_publish - Publish @entries as the next generation.
+ */
+uint64_t price_table_publish(const char *name, const PriceTableSource *source)
+{
+    if (strlen(name) >= PRICE_TABLE_NAME_MAX || source->count >= UINT32_MAX)
+    {
+        fprintf(stderr, "Cannot publish %zu prices as %s\n", source->count, name);
+        return 0;
+    }
+
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        perror(name);
+        return 0;
+    }
+    if (flock(fd, LOCK_EX) != 0 || ftruncate(fd, sizeof(PriceTableControl)) != 0)
+    {
+        perror(name);
+        close(fd);
+        return 0;
+    }
+    PriceTableControl *control = mmap(NULL, sizeof(PriceTableControl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (control == MAP_FAILED)
+    {
+        perror("mmap");
+        close(fd);
+        return 0;
+    }
+
+    uint64_t previous   = atomic_load_explicit(&control->generation, memory_order_relaxed);
+    uint64_t generation = previous + 1;
+    if (write_snapshot(name, generation, source) == 0)
+    {
+        control->magic = PRICE_TABLE_MAGIC;
+        atomic_store_explicit(&control->generation, generation, memory_order_release);
+        if (previous)
+        {
+            char snapshot[PRICE_TABLE_NAME_MAX + 24];
+            snapshot_name(snapshot, sizeof(snapshot), name, previous);
+            shm_unlink(snapshot);                                    /* Freed when its last reader unmaps it */
+        }
+    }
+    else
+    {
+        generation = 0;
+    }
+
+    munmap(control, sizeof(PriceTableControl));
+    close(fd);                                                       /* Releases the publishers' lock */
+    return generation;
+}
+
+/**
+ * price_table_build - Build a private table holding @source.
+ */
+PriceTable *price_table_build(const PriceTableSource *source)
+{
+    PriceTable header;
+    size_t     size = table_layout(source, &header);
+
+    if (source->count >= UINT32_MAX)
+    {
+        return NULL;
+    }
+    PriceTable *table = calloc(1, size);
+    if (!table)
+    {
+        perror("calloc");
+        return NULL;
+    }
+    fill_table(table, &header, source);
+    return table;
+}
+
+/**
+ * price_table_remove - Unlink the control object and the current snapshot.
+ */
+void price_table_remove(const char *name)
+{
+    PriceTableReader reader;
+    if (price_table_attach(&reader, name) == 0)
+    {
+        char snapshot[PRICE_TABLE_NAME_MAX + 24];
+        snapshot_name(snapshot, sizeof(snapshot), name,
+                      atomic_load_explicit(&reader.control->generation, memory_order_acquire));
+        shm_unlink(snapshot);
+        price_table_detach(&reader);
+    }
+    shm_unlink(name);
+}
+
+/**
+ * price_table_attach - Map the control object read-only.
+ */
+int price_table_attach(PriceTableReader *reader, const char *name)
+{
+    memset(reader, 0, sizeof(*reader));
+    if (strlen(name) >= PRICE_TABLE_NAME_MAX)
+    {
+        return -1;
+    }
+    snprintf(reader->name, sizeof(reader->name), "%s", name);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        if (errno != ENOENT)
+        {
+            perror(name);
+        }
+        return -1;
+    }
+
+    struct stat st;
+    void        *control = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(PriceTableControl))
+    {
+        control = mmap(NULL, sizeof(PriceTableControl), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (control == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    reader->control = control;
+    return 0;
+}
+
+/**
+ * price_table_current - Current snapshot, mapping a newer one if published.
+ */
+const PriceTable *price_table_current(PriceTableReader *reader)
+{
+    uint64_t generation = atomic_load_explicit(&reader->control->generation, memory_order_acquire);
+    if (__builtin_expect(generation == reader->generation, 1))
+    {
+        return reader->table;
+    }
+    return map_generation(reader, generation);
+}
+
+/**
+ * price_table_find - Entry of @location, or NULL.
+ */
+const PriceTableEntry *price_table_find(const PriceTable *table, const char *location)
+{
+    const PriceTableEntry   *entries = table_entries(table);
+    const uint32_t          *slots   = table_slots(table);
+    size_t                  mask     = (size_t)table->slot_count - 1;
+
+    for (size_t s = (size_t)price_hash_city(location) & mask; slots[s]; s = (s + 1) & mask)
+    {
+        if (strcmp(entries[slots[s] - 1].location, location) == 0)
+        {
+            return &entries[slots[s] - 1];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * price_table_find_zone - Entry of the zone @zone_id, or NULL.
+ */
+const PriceTableEntry *price_table_find_zone(const PriceTable *table, int64_t zone_id)
+{
+    const PriceTableZone    *by_zone = table_by_zone(table);
+    size_t                  low = 0, high = (size_t)table->zone_count;
+
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (by_zone[mid].zone_id < zone_id)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return (low < table->zone_count && by_zone[low].zone_id == zone_id) ? &table_entries(table)[by_zone[low].index]
+                                                                         : NULL;
+}
+
+/**
+ * price_table_cost - Cost of parking at @entry from @start_ms to @end_ms.
+ */
+double price_table_cost(const PriceTable *table, const PriceTableEntry *entry, int64_t start_ms, int64_t end_ms)
+{
+    if (entry->schedule)
+    {
+        return price_schedule_cost(&table_schedules(table)[entry->schedule - 1], start_ms, end_ms);
+    }
+    return entry->price * (double)(end_ms - start_ms) / PRICE_UNIT_MS;
+}
+
+/**
+ * price_table_detach - Unmap everything the reader mapped.
+ */
+void price_table_detach(PriceTableReader *reader)
+{
+    if (reader->table)
+    {
+        munmap((void *)reader->table, reader->table_size);
+    }
+    if (reader->control)
+    {
+        munmap((void *)reader->control, sizeof(PriceTableControl));
+    }
+    memset(reader, 0, sizeof(*reader));
+}
@@ -0,0 +1,947 @@
+/**
+ * prk_db.c: Embedded SQLite access shared by the server programs
+ *
+ * Small helpers around the SQLite C library: opening the database with the
+ * pragmas the pipeline relies on, executing statements with error reporting,
+ * and the schema definition used by out_create_tables and the inserter.
+ *
+ * Compilation:
+ *      gcc -c prk_db.c          (link the program with -lsqlite3)
+ *
+ * Version: v1.10
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            Customer_Data.recv_time, (sensor_id, recv_time) index
+ *   19-10-2026       Morris              v1.2            versioned migrations (PRAGMA user_version),
+ *                                                        clustered Customer_Data, unique Prices.location
+ *   19-10-2026       Morris              v1.3            migrate the original MAC address schema, steps
+ *                                                        checked under the write lock
+ *   19-10-2026       Morris              v1.4            time partitioned readings behind a view
+ *   19-10-2026       Morris              v1.5            Zones, occupancy rollup tables
+ *   19-10-2026       Morris              v1.6            Sensor_State, latest reading per sensor
+ *   19-10-2026       Morris              v1.7            Zone_Vertices, polygon zones
+ *   19-10-2026       Morris              v1.8            Invoices, Billing_Sessions
+ *   19-10-2026       Morris              v1.9            Price_Schedules, Price_Tiers
+ *   19-10-2026       Morris              v1.10           Price_History, Prices.valid_from
+ *
+ */
+
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+
+/* Schema version 1: base tables (rowid readings table) */
+static const char *schema_v1_sql =
+    "CREATE TABLE IF NOT EXISTS Prices "
+    "    (id INTEGER PRIMARY KEY, "
+    "     location TEXT NOT NULL, "
+    "     price REAL NOT NULL);"
+
+    "CREATE TABLE IF NOT EXISTS Sensors "
+    "    (id INTEGER PRIMARY KEY, "
+    "     mac_address TEXT NOT NULL UNIQUE);"
+
+    "CREATE TABLE IF NOT EXISTS Customer_Data "
+    "    (id INTEGER PRIMARY KEY, "
+    "     sensor_id INTEGER NOT NULL REFERENCES Sensors(id), "
+    "     status CHAR(1) NOT NULL, "
+    "     x REAL NOT NULL, "
+    "     y REAL NOT NULL, "
+    "     z REAL NOT NULL, "
+    "     recv_time INTEGER NOT NULL DEFAULT 0);"
+
+    /* Highest sequence number stored per sensor and the 64 below it (duplicate suppression) */
+    "CREATE TABLE IF NOT EXISTS Sensor_Seq "
+    "    (sensor_id INTEGER PRIMARY KEY REFERENCES Sensors(id), "
+    "     last_seq INTEGER NOT NULL, "
+    "     seen INTEGER NOT NULL DEFAULT -1);"
+
+    /* Readings with the MAC address resolved, for ad-hoc queries */
+    "CREATE VIEW IF NOT EXISTS Customer_Readings AS "
+    "    SELECT c.id, s.mac_address, c.status, c.x, c.y, c.z "
+    "    FROM Customer_Data c JOIN Sensors s ON s.id = c.sensor_id;";
+
+/*
+ * Schema version 0, the tables of the original out_create_tables, kept
+ * readings with their MAC address. Sensors are numbered in the order they
+ * first reported; the readings keep their ids and get recv_time 0.
+ */
+static const char *sensors_v0_sql =
+    "INSERT OR IGNORE INTO Sensors (mac_address) "
+    "    SELECT mac_address FROM Customer_Data_v0 GROUP BY mac_address ORDER BY min(id);"
+
+    "INSERT INTO Customer_Data (id, sensor_id, status, x, y, z) "
+    "    SELECT c.id, s.id, c.status, c.x, c.y, c.z "
+    "    FROM Customer_Data_v0 c JOIN Sensors s ON s.mac_address = c.mac_address;"
+
+    "DROP TABLE Customer_Data_v0;";
+
+/* Schema version 1 indexes, created once every column they cover exists */
+static const char *index_v1_sql =
+    "CREATE INDEX IF NOT EXISTS idx_customer_data_sensor_time "
+    "    ON Customer_Data(sensor_id, recv_time);"
+    "DROP INDEX IF EXISTS idx_customer_data_sensor;";
+
+/*
+ * Schema version 2: readings clustered on (sensor_id, recv_time). The table
+ * is created under a temporary name, filled, then renamed over the old one.
+ */
+static const char *customer_data_v2_sql =
+    /* Kept by an interrupted migration: the copy skips the rows it holds */
+    "CREATE TABLE IF NOT EXISTS Customer_Data_v2 "
+    "    (sensor_id INTEGER NOT NULL REFERENCES Sensors(id), "
+    "     recv_time INTEGER NOT NULL, "
+    "     id INTEGER NOT NULL, "
+    "     status CHAR(1) NOT NULL, "
+    "     x REAL NOT NULL, "
+    "     y REAL NOT NULL, "
+    "     z REAL NOT NULL, "
+    "     PRIMARY KEY (sensor_id, recv_time, id)) WITHOUT ROWID;"
+
+    /* Occupancy over a time window across all sensors: (recv_time, status)
+     * plus the primary key columns, so the scan never touches the table.
+     * Built during the copy so the final swap does not have to. */
+    "CREATE INDEX IF NOT EXISTS idx_customer_data_time_status "
+    "    ON Customer_Data_v2(recv_time, status);";
+
+static const char *copy_v2_sql =
+    "INSERT OR IGNORE INTO Customer_Data_v2 (sensor_id, recv_time, id, status, x, y, z) "
+    "    SELECT sensor_id, recv_time, id, status, x, y, z FROM Customer_Data "
+    "    WHERE id > ? AND id <= ?;";
+
+static const char *swap_v2_sql =
+    "DROP VIEW IF EXISTS Customer_Readings;"
+    "ALTER TABLE Customer_Data RENAME TO Customer_Data_v1;"         /* Emptied and dropped after the swap */
+    "ALTER TABLE Customer_Data_v2 RENAME TO Customer_Data;"
+
+    "CREATE VIEW Customer_Readings AS "
+    "    SELECT c.id, s.mac_address, c.recv_time, c.status, c.x, c.y, c.z "
+    "    FROM Customer_Data c JOIN Sensors s ON s.id = c.sensor_id;";
+
+/* Prices: one row per location, looked up by location */
+static const char *drain_v1_sql =
+    "DELETE FROM Customer_Data_v1 WHERE id <= ?;";
+
+static const char *prices_v2_sql =
+    "DELETE FROM Prices WHERE id NOT IN (SELECT max(id) FROM Prices GROUP BY location);"
+    "CREATE UNIQUE INDEX IF NOT EXISTS idx_prices_location ON Prices(location);";
+
+
+/*
+ * Schema version 3: readings are split into time partitions, one table per
+ * PARTITION_MS, listed in Partitions. The v2 table becomes the legacy
+ * partition holding everything received before the migration; the
+ * Customer_Data name moves to a UNION ALL view over the partitions.
+ */
+static const char *partitions_v3_sql =
+    "CREATE TABLE IF NOT EXISTS Partitions "
+    "    (name TEXT PRIMARY KEY, "
+    "     start_ms INTEGER NOT NULL, "                               /* First recv_time it may hold */
+    "     end_ms INTEGER NOT NULL);"                                 /* recv_time upper bound, exclusive */
+
+    "DROP VIEW IF EXISTS Customer_Readings;"
+    "ALTER TABLE Customer_Data RENAME TO " PARTITION_LEGACY_NAME ";";   /* Keeps idx_customer_data_time_status */
+
+/* Partition table, the v2 Customer_Data layout under another name */
+static const char *partition_sql =
+    "CREATE TABLE IF NOT EXISTS %w "
+    "    (sensor_id INTEGER NOT NULL REFERENCES Sensors(id), "
+    "     recv_time INTEGER NOT NULL, "
+    "     id INTEGER NOT NULL, "
+    "     status CHAR(1) NOT NULL, "
+    "     x REAL NOT NULL, "
+    "     y REAL NOT NULL, "
+    "     z REAL NOT NULL, "
+    "     PRIMARY KEY (sensor_id, recv_time, id)) WITHOUT ROWID;"
+    "CREATE INDEX IF NOT EXISTS \"idx_%w_time_status\" ON %w(recv_time, status);"
+    "INSERT OR REPLACE INTO Partitions (name, start_ms, end_ms) VALUES (%Q, %lld, %lld);";
+
+
+/*
+ * Schema version 4: parking zones and the occupancy rollups the inserter
+ * maintains per zone and minute / hour / day (see occupancy_rollup.h).
+ */
+static const char *rollups_v4_sql =
+    "CREATE TABLE IF NOT EXISTS Zones "
+    "    (id INTEGER PRIMARY KEY, "
+    "     name TEXT NOT NULL UNIQUE, "                               /* Matches Prices.location */
+    "     x_min REAL NOT NULL, "
+    "     y_min REAL NOT NULL, "
+    "     x_max REAL NOT NULL, "                                     /* Exclusive */
+    "     y_max REAL NOT NULL);"                                     /* Exclusive */
+
+    "CREATE TABLE IF NOT EXISTS Rollup_Minute "
+    "    (zone_id INTEGER NOT NULL REFERENCES Zones(id), "
+    "     bucket_ms INTEGER NOT NULL, "                              /* Minute start, ms since the epoch */
+    "     readings INTEGER NOT NULL, "
+    "     parked_readings INTEGER NOT NULL, "
+    "     sensors INTEGER NOT NULL, "                                /* Distinct sensors seen */
+    "     parked_sensors INTEGER NOT NULL, "                         /* Distinct sensors parked: cars */
+    "     PRIMARY KEY (zone_id, bucket_ms)) WITHOUT ROWID;"
+
+    "CREATE TABLE IF NOT EXISTS Rollup_Hour "
+    "    (zone_id INTEGER NOT NULL REFERENCES Zones(id), "
+    "     bucket_ms INTEGER NOT NULL, "
+    "     readings INTEGER NOT NULL, "
+    "     parked_readings INTEGER NOT NULL, "
+    "     parked_minutes INTEGER NOT NULL, "                         /* Sum of the minutes' parked_sensors */
+    "     peak_parked INTEGER NOT NULL, "                            /* Max of the minutes' parked_sensors */
+    "     PRIMARY KEY (zone_id, bucket_ms)) WITHOUT ROWID;"
+
+    "CREATE TABLE IF NOT EXISTS Rollup_Day "
+    "    (zone_id INTEGER NOT NULL REFERENCES Zones(id), "
+    "     bucket_ms INTEGER NOT NULL, "
+    "     readings INTEGER NOT NULL, "
+    "     parked_readings INTEGER NOT NULL, "
+    "     parked_minutes INTEGER NOT NULL, "
+    "     peak_parked INTEGER NOT NULL, "
+    "     PRIMARY KEY (zone_id, bucket_ms)) WITHOUT ROWID;";
+
+/*
+ * Schema version 5: latest reading of every sensor, upserted by the inserter
+ * (see sensor_state.h) and seeded from the readings held at migration time.
+ */
+static const char *sensor_state_v5_sql =
+    "CREATE TABLE IF NOT EXISTS Sensor_State "
+    "    (sensor_id INTEGER PRIMARY KEY REFERENCES Sensors(id), "
+    "     status CHAR(1) NOT NULL, "
+    "     x REAL NOT NULL, "
+    "     y REAL NOT NULL, "
+    "     z REAL NOT NULL, "
+    "     last_seen INTEGER NOT NULL);"                              /* recv_time of the reading */
+
+    "INSERT OR IGNORE INTO Sensor_State (sensor_id, status, x, y, z, last_seen) "
+    "    SELECT sensor_id, status, x, y, z, max(recv_time) FROM Customer_Data GROUP BY sensor_id;";
+
+/*
+ * Schema version 6: optional polygon outline of a zone, one row per vertex
+ * in ring order. A zone with vertices is the polygon; its Zones rectangle
+ * is replaced by the polygon's bounding box when loaded (see zone_map.h).
+ */
+static const char *zone_vertices_v6_sql =
+    "CREATE TABLE IF NOT EXISTS Zone_Vertices "
+    "    (zone_id INTEGER NOT NULL REFERENCES Zones(id), "
+    "     seq INTEGER NOT NULL, "                                    /* Position in the ring */
+    "     x REAL NOT NULL, "
+    "     y REAL NOT NULL, "
+    "     PRIMARY KEY (zone_id, seq)) WITHOUT ROWID;";
+
+/*
+ * Schema version 7: invoices of closed parking sessions, written by the
+ * billing engine of the inserter (see billing.h), and the sessions it left
+ * open at its last shutdown.
+ */
+static const char *billing_v7_sql =
+    "CREATE TABLE IF NOT EXISTS Invoices "
+    "    (id INTEGER PRIMARY KEY, "
+    "     sensor_id INTEGER NOT NULL REFERENCES Sensors(id), "
+    "     zone_id INTEGER REFERENCES Zones(id), "                    /* NULL outside every zone */
+    "     start_ms INTEGER NOT NULL, "                               /* First parked reading */
+    "     end_ms INTEGER NOT NULL, "                                 /* Departure, or last reading on a timeout */
+    "     price REAL, "                                              /* Prices.price applied, NULL if none */
+    "     amount REAL, "                                             /* price * hours, NULL if no price */
+    "     closed_by CHAR(1) NOT NULL);"                              /* 'D' departed, 'M' moved, 'T' timeout */
+
+    "CREATE INDEX IF NOT EXISTS Invoices_sensor ON Invoices (sensor_id, start_ms);"
+
+    "CREATE TABLE IF NOT EXISTS Billing_Sessions "
+    "    (sensor_id INTEGER PRIMARY KEY REFERENCES Sensors(id), "
+    "     zone_id INTEGER NOT NULL, "                                /* 0 outside every zone */
+    "     start_ms INTEGER NOT NULL, "
+    "     last_seen INTEGER NOT NULL);";
+
+/*
+ * Schema version 8: time-of-day rates and duration tiers refining the
+ * price of a location, imported from the schedule file by
+ * out_update_prices (see price_schedule.h).
+ */
+static const char *schedules_v8_sql =
+    "CREATE TABLE IF NOT EXISTS Price_Schedules "
+    "    (id INTEGER PRIMARY KEY, "                                  /* Later rules win where they overlap */
+    "     location TEXT NOT NULL, "                                  /* Matches Prices.location */
+    "     days INTEGER NOT NULL, "                                   /* Bit 0 Monday .. bit 6 Sunday */
+    "     start_min INTEGER NOT NULL, "                              /* Minute of the day, local time */
+    "     end_min INTEGER NOT NULL, "                                /* Exclusive, before start_min runs overnight */
+    "     utc_offset_min INTEGER NOT NULL, "                         /* Local time minus UTC */
+    "     price REAL NOT NULL);"                                     /* Per hour within the window */
+
+    "CREATE INDEX IF NOT EXISTS Price_Schedules_location ON Price_Schedules (location);"
+
+    "CREATE TABLE IF NOT EXISTS Price_Tiers "
+    "    (id INTEGER PRIMARY KEY, "
+    "     location TEXT NOT NULL, "
+    "     after_min INTEGER NOT NULL, "                              /* Parked longer than this */
+    "     factor REAL NOT NULL);"                                    /* Multiplies the rate from then on */
+
+    "CREATE INDEX IF NOT EXISTS Price_Tiers_location ON Price_Tiers (location);";
+
+/*
+ * Schema version 9: every price a location ever had, with the interval it
+ * applied in, so a session is billed at the price of its start (see
+ * price_history.h). out_update_prices closes and opens the intervals in
+ * the transaction that changes Prices; Prices.valid_from is the start of
+ * the current one. Prices present at the migration apply since time 0.
+ */
+static const char *history_v9_sql =
+    "CREATE TABLE IF NOT EXISTS Price_History "
+    "    (id INTEGER PRIMARY KEY, "
+    "     location TEXT NOT NULL, "                                  /* Matches Prices.location */
+    "     price REAL NOT NULL, "
+    "     valid_from INTEGER NOT NULL, "                             /* CLOCK_REALTIME in ms */
+    "     valid_to INTEGER);"                                        /* Exclusive, NULL while current */
+
+    "CREATE INDEX IF NOT EXISTS Price_History_location ON Price_History (location, valid_from);"
+
+    "INSERT INTO Price_History (location, price, valid_from) "
+    "    SELECT location, price, valid_from FROM Prices p "
+    "    WHERE NOT EXISTS (SELECT 1 FROM Price_History h WHERE h.location = p.location AND h.valid_to IS NULL);";
+
+#define READING_COLUMNS        "sensor_id, recv_time, id, status, x, y, z"
+
+
+/* One schema migration step */
+typedef struct
+{
+    int         version;                                             /* user_version after the step */
+    const char  *description;                                        /* Shown by out_migrate_db */
+    int         (*apply)(sqlite3 *db);                               /* Sets user_version itself */
+} Migration;
+
+static int migrate_v1(sqlite3 *db);
+static int migrate_v2(sqlite3 *db);
+static int migrate_v3(sqlite3 *db);
+static int migrate_v4(sqlite3 *db);
+static int migrate_v5(sqlite3 *db);
+static int migrate_v6(sqlite3 *db);
+static int migrate_v7(sqlite3 *db);
+static int migrate_v8(sqlite3 *db);
+static int migrate_v9(sqlite3 *db);
+
+static const Migration migrations[] =
+{
+    { 1, "base schema, Customer_Data.recv_time, Sensor_Seq.seen",        migrate_v1 },
+    { 2, "Customer_Data clustered on (sensor_id, recv_time), "
+         "unique Prices.location, occupancy index",                      migrate_v2 },
+    { 3, "Customer_Data split into time partitions behind a view",      migrate_v3 },
+    { 4, "Zones, per zone occupancy rollups (minute, hour, day)",        migrate_v4 },
+    { 5, "Sensor_State, latest reading of every sensor",                 migrate_v5 },
+    { 6, "Zone_Vertices, polygon outlines of irregular zones",           migrate_v6 },
+    { 7, "Invoices and open Billing_Sessions of the billing engine",     migrate_v7 },
+    { 8, "Price_Schedules and Price_Tiers, time-of-day and tiered rates", migrate_v8 },
+    { 9, "Price_History, the interval each price applied in",            migrate_v9 },
+};
+
+
+/**
+ * prk_db_open - Open (or create) the parking system database.
+ */
+sqlite3 *prk_db_open(const char *db_path)
+{
+    sqlite3 *db = NULL;
+
+    if (sqlite3_open(db_path, &db) != SQLITE_OK)
+    {
+        fprintf(stderr, "Error opening database %s: %s\n", db_path, db ? sqlite3_errmsg(db) : "out of memory");
+        sqlite3_close(db);
+        return NULL;
+    }
+
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
+    if (prk_db_exec(db, "PRAGMA journal_mode=WAL;"
+                        "PRAGMA synchronous=NORMAL;"
+                        "PRAGMA foreign_keys=ON;") != 0)
+    {
+        sqlite3_close(db);
+        return NULL;
+    }
+
+    return db;
+}
+
+/**
+ * prk_db_close - Close a handle returned by prk_db_open().
+ */
+void prk_db_close(sqlite3 *db)
+{
+    sqlite3_close(db);
+}
+
+/**
+ * prk_db_exec - Execute one or more SQL statements without results.
+ */
+int prk_db_exec(sqlite3 *db, const char *sql)
+{
+    char *errmsg = NULL;
+
+    if (sqlite3_exec(db, sql, NULL, NULL, &errmsg) != SQLITE_OK)
+    {
+        fprintf(stderr, "Error executing SQL: %s\n", errmsg ? errmsg : sqlite3_errmsg(db));
+        sqlite3_free(errmsg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * prk_db_prepare - Compile a statement for repeated use.
+ */
+sqlite3_stmt *prk_db_prepare(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Error preparing SQL: %s\n  %s\n", sqlite3_errmsg(db), sql);
+        return NULL;
+    }
+
+    return stmt;
+}
+
+/**
+ * column_exists - Whether @table has a column named @column.
+ */
+static int column_exists(sqlite3 *db, const char *table, const char *column)
+{
+    char            sql[128];
+    sqlite3_stmt    *stmt;
+    int             found = 0;
+
+    snprintf(sql, sizeof(sql), "PRAGMA table_info(%s);", table);
+    if ((stmt = prk_db_prepare(db, sql)) == NULL)
+    {
+        return 0;
+    }
+
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char *name = sqlite3_column_text(stmt, 1);
+        found = name && strcmp((const char *)name, column) == 0;
+    }
+    sqlite3_finalize(stmt);
+
+    return found;
+}
+
+/**
+ * set_version - Record the schema version (inside the step's transaction).
+ */
+static int set_version(sqlite3 *db, int version)
+{
+    char sql[64];
+    snprintf(sql, sizeof(sql), "PRAGMA user_version=%d;", version);
+    return prk_db_exec(db, sql);
+}
+
+/**
+ * rollback - Abandon the step's transaction and report failure.
+ */
+static int rollback(sqlite3 *db)
+{
+    prk_db_exec(db, "ROLLBACK;");
+    return -1;
+}
+
+/**
+ * begin_step - Open the write transaction of the step to @version.
+ *
+ * The version is read again under the write lock: another program opening
+ * the database may have applied the step since prk_db_migrate looked.
+ *
+ * Return: 0 to apply the step, 1 if it is applied already (no transaction
+ * left open), -1 on error.
+ */
+static int begin_step(sqlite3 *db, int version)
+{
+    if (prk_db_exec(db, "BEGIN IMMEDIATE;") != 0)
+    {
+        return -1;
+    }
+
+    int current = prk_db_schema_version(db);
+    if (current < 0)
+    {
+        return rollback(db);
+    }
+    if (current >= version)
+    {
+        prk_db_exec(db, "COMMIT;");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * max_reading_id - Highest Customer_Data.id (rowid table: O(log n)).
+ */
+static int64_t max_reading_id(sqlite3 *db)
+{
+    sqlite3_stmt    *stmt = prk_db_prepare(db, "SELECT max(id) FROM Customer_Data;");
+    int64_t         id    = 0;
+
+    if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        id = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return id;
+}
+
+/**
+ * migrate_v1 - Base schema; older databases get Customer_Data.recv_time
+ *              and Sensor_Seq.seen.
+ *
+ * A database of the original out_create_tables has its readings moved from
+ * MAC addresses to Sensors ids.
+ */
+static int migrate_v1(sqlite3 *db)
+{
+    int rc = begin_step(db, 1);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+
+    int v0 = column_exists(db, "Customer_Data", "mac_address");
+    if (v0 && prk_db_exec(db, "ALTER TABLE Customer_Data RENAME TO Customer_Data_v0;") != 0)
+    {
+        return rollback(db);
+    }
+
+    if (prk_db_exec(db, schema_v1_sql) != 0 || (v0 && prk_db_exec(db, sensors_v0_sql) != 0))
+    {
+        return rollback(db);
+    }
+
+    /* Databases created before readings carried a receive time */
+    if (!column_exists(db, "Customer_Data", "recv_time") &&
+        prk_db_exec(db, "ALTER TABLE Customer_Data ADD COLUMN recv_time INTEGER NOT NULL DEFAULT 0;") != 0)
+    {
+        return rollback(db);
+    }
+
+    /* Sensor_Seq from before the bitmap: every number below last_seq counts as seen */
+    if (!column_exists(db, "Sensor_Seq", "seen") &&
+        prk_db_exec(db, "ALTER TABLE Sensor_Seq ADD COLUMN seen INTEGER NOT NULL DEFAULT -1;") != 0)
+    {
+        return rollback(db);
+    }
+
+    if (prk_db_exec(db, index_v1_sql) != 0 || set_version(db, 1) != 0)
+    {
+        return rollback(db);
+    }
+
+    return prk_db_exec(db, "COMMIT;");
+}
+
+/**
+ * migrate_v2 - Rebuild Customer_Data as a WITHOUT ROWID table.
+ *
+ * Rows are copied in PRK_DB_MIGRATE_CHUNK id ranges, one short transaction
+ * each, so a running inserter keeps committing between chunks. The final
+ * transaction copies what arrived meanwhile and swaps the tables. Each
+ * transaction checks the version first: when another program finished the
+ * step meanwhile, this one stops.
+ */
+static int migrate_v2(sqlite3 *db)
+{
+    int rc = begin_step(db, 2);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+
+    sqlite3_stmt *copy = NULL;
+    if (prk_db_exec(db, customer_data_v2_sql) != 0 || (copy = prk_db_prepare(db, copy_v2_sql)) == NULL ||
+        prk_db_exec(db, "COMMIT;") != 0)
+    {
+        sqlite3_finalize(copy);
+        return rollback(db);
+    }
+
+    int64_t copied = 0;
+    int64_t high   = max_reading_id(db);
+    while (copied < high)
+    {
+        int64_t next = copied + PRK_DB_MIGRATE_CHUNK;
+
+        if ((rc = begin_step(db, 2)) != 0)
+        {
+            sqlite3_finalize(copy);
+            return (rc > 0) ? 0 : -1;
+        }
+        sqlite3_bind_int64(copy, 1, copied);
+        sqlite3_bind_int64(copy, 2, next);
+        rc = sqlite3_step(copy);
+        sqlite3_reset(copy);
+        if (rc != SQLITE_DONE || prk_db_exec(db, "COMMIT;") != 0)
+        {
+            fprintf(stderr, "Error copying readings: %s\n", sqlite3_errmsg(db));
+            sqlite3_finalize(copy);
+            return rollback(db);
+        }
+
+        copied = next;
+        high   = max_reading_id(db);                                 /* Follow the live inserter */
+        usleep(PRK_DB_MIGRATE_PAUSE_US);
+    }
+
+    /* Catch up and swap, holding the write lock only for the tail */
+    if ((rc = begin_step(db, 2)) != 0)
+    {
+        sqlite3_finalize(copy);
+        return (rc > 0) ? 0 : -1;
+    }
+    sqlite3_bind_int64(copy, 1, copied);
+    sqlite3_bind_int64(copy, 2, INT64_MAX);
+    rc = sqlite3_step(copy);
+    sqlite3_finalize(copy);
+    if (rc != SQLITE_DONE || prk_db_exec(db, swap_v2_sql) != 0 ||
+        prk_db_exec(db, prices_v2_sql) != 0 || set_version(db, 2) != 0)
+    {
+        return rollback(db);
+    }
+    if (prk_db_exec(db, "COMMIT;") != 0)
+    {
+        return -1;
+    }
+
+    /* Free the old table in chunks too; one DROP of a large table would
+     * hold the write lock for as long as the whole copy. If this is cut
+     * short, Customer_Data_v1 is left behind and can be dropped by hand. */
+    sqlite3_stmt *drain = prk_db_prepare(db, drain_v1_sql);
+    for (int64_t deleted = 0; drain && deleted < copied; deleted += PRK_DB_MIGRATE_CHUNK)
+    {
+        sqlite3_bind_int64(drain, 1, deleted + PRK_DB_MIGRATE_CHUNK);
+        sqlite3_step(drain);
+        sqlite3_reset(drain);
+        usleep(PRK_DB_MIGRATE_PAUSE_US);
+    }
+    sqlite3_finalize(drain);
+
+    return prk_db_exec(db, "DROP TABLE Customer_Data_v1;");
+}
+
+
+/**
+ * migrate_v3 - Turn Customer_Data into the legacy partition behind a view.
+ *
+ * Renames only, so the step is instant whatever the table size. The legacy
+ * partition covers [min(recv_time), now] and ages out with retention like
+ * any other partition.
+ */
+static int migrate_v3(sqlite3 *db)
+{
+    int rc = begin_step(db, 3);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+
+    sqlite3_stmt    *stmt  = prk_db_prepare(db, "SELECT coalesce(min(recv_time), 0), coalesce(max(recv_time), 0) "
+                                                "FROM Customer_Data;");
+    int64_t         first  = 0;
+    int64_t         last   = 0;
+    if (!stmt || sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        sqlite3_finalize(stmt);
+        return rollback(db);
+    }
+    first = sqlite3_column_int64(stmt, 0);
+    last  = sqlite3_column_int64(stmt, 1);
+    sqlite3_finalize(stmt);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t now_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    int64_t end_ms = (last >= now_ms) ? last + 1 : now_ms;
+
+    char *sql = sqlite3_mprintf("INSERT OR REPLACE INTO Partitions (name, start_ms, end_ms) VALUES (%Q, %lld, %lld);",
+                                PARTITION_LEGACY_NAME, (long long)first, (long long)end_ms);
+    rc = (sql != NULL) ? 0 : -1;
+    if (rc == 0)
+    {
+        rc = prk_db_exec(db, partitions_v3_sql);
+    }
+    if (rc == 0)
+    {
+        rc = prk_db_exec(db, sql);
+    }
+    sqlite3_free(sql);
+
+    if (rc != 0 || prk_db_rebuild_readings_view(db) != 0 || set_version(db, 3) != 0)
+    {
+        return rollback(db);
+    }
+
+    return prk_db_exec(db, "COMMIT;");
+}
+
+
+/**
+ * migrate_v4 - Add Zones and the empty rollup tables.
+ *
+ * Existing readings are not rolled up here; run out_rollup_rebuild once the
+ * zones are defined.
+ */
+static int migrate_v4(sqlite3 *db)
+{
+    int rc = begin_step(db, 4);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+    if (prk_db_exec(db, rollups_v4_sql) != 0 || set_version(db, 4) != 0)
+    {
+        return rollback(db);
+    }
+    return prk_db_exec(db, "COMMIT;");
+}
+
+
+/**
+ * migrate_v5 - Add Sensor_State, seeded with the newest reading of each sensor.
+ *
+ * One pass over the readings (max() picks the columns of the newest row),
+ * in the same transaction as the version so the inserter starts from a
+ * complete table.
+ */
+static int migrate_v5(sqlite3 *db)
+{
+    int rc = begin_step(db, 5);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+    if (prk_db_exec(db, sensor_state_v5_sql) != 0 || set_version(db, 5) != 0)
+    {
+        return rollback(db);
+    }
+    return prk_db_exec(db, "COMMIT;");
+}
+
+/**
+ * migrate_v6 - Add the empty Zone_Vertices table.
+ */
+static int migrate_v6(sqlite3 *db)
+{
+    int rc = begin_step(db, 6);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+    if (prk_db_exec(db, zone_vertices_v6_sql) != 0 || set_version(db, 6) != 0)
+    {
+        return rollback(db);
+    }
+    return prk_db_exec(db, "COMMIT;");
+}
+
+/**
+ * migrate_v7 - Add the empty Invoices and Billing_Sessions tables.
+ *
+ * Readings stored before the migration are not billed.
+ */
+static int migrate_v7(sqlite3 *db)
+{
+    int rc = begin_step(db, 7);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+    if (prk_db_exec(db, billing_v7_sql) != 0 || set_version(db, 7) != 0)
+    {
+        return rollback(db);
+    }
+    return prk_db_exec(db, "COMMIT;");
+}
+
+/**
+ * migrate_v8 - Add the empty Price_Schedules and Price_Tiers tables.
+ *
+ * Every location keeps its flat price until a schedule file is imported.
+ */
+static int migrate_v8(sqlite3 *db)
+{
+    int rc = begin_step(db, 8);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+    if (prk_db_exec(db, schedules_v8_sql) != 0 || set_version(db, 8) != 0)
+    {
+        return rollback(db);
+    }
+    return prk_db_exec(db, "COMMIT;");
+}
+
+/**
+ * migrate_v9 - Add Prices.valid_from and Price_History, seeded with Prices.
+ */
+static int migrate_v9(sqlite3 *db)
+{
+    int rc = begin_step(db, 9);
+    if (rc != 0)
+    {
+        return (rc > 0) ? 0 : -1;
+    }
+    if (!column_exists(db, "Prices", "valid_from") &&
+        prk_db_exec(db, "ALTER TABLE Prices ADD COLUMN valid_from INTEGER NOT NULL DEFAULT 0;") != 0)
+    {
+        return rollback(db);
+    }
+    if (prk_db_exec(db, history_v9_sql) != 0 || set_version(db, 9) != 0)
+    {
+        return rollback(db);
+    }
+    return prk_db_exec(db, "COMMIT;");
+}
+
+
+/**
+ * prk_db_create_partition - Create a readings partition and register it.
+ */
+int prk_db_create_partition(sqlite3 *db, const char *name, int64_t start_ms, int64_t end_ms)
+{
+    char *sql = sqlite3_mprintf(partition_sql, name, name, name, name, (long long)start_ms, (long long)end_ms);
+    if (!sql)
+    {
+        return -1;
+    }
+
+    int rc = prk_db_exec(db, sql);
+    sqlite3_free(sql);
+    return rc;
+}
+
+/**
+ * prk_db_rebuild_readings_view - Recreate Customer_Data over the partitions.
+ */
+int prk_db_rebuild_readings_view(sqlite3 *db)
+{
+    sqlite3_stmt *stmt = prk_db_prepare(db, "SELECT name, start_ms, end_ms FROM Partitions ORDER BY start_ms, name;");
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    sqlite3_str *sql = sqlite3_str_new(db);
+    sqlite3_str_appendall(sql, "DROP VIEW IF EXISTS Customer_Readings;"
+                               "DROP VIEW IF EXISTS Customer_Data;"
+                               "CREATE VIEW Customer_Data AS ");
+
+    int count = 0;
+    /* The range predicate lets the planner turn branches outside a query's
+     * time range into an empty index seek */
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        sqlite3_str_appendf(sql, "%sSELECT " READING_COLUMNS " FROM \"%w\" WHERE recv_time >= %lld AND recv_time < %lld",
+                            count++ ? " UNION ALL " : "", (const char *)sqlite3_column_text(stmt, 0),
+                            (long long)sqlite3_column_int64(stmt, 1), (long long)sqlite3_column_int64(stmt, 2));
+    }
+    sqlite3_finalize(stmt);
+
+    if (count == 0)
+    {
+        /* No partition left: an empty view with the same columns */
+        sqlite3_str_appendall(sql, "SELECT 0 AS sensor_id, 0 AS recv_time, 0 AS id, '' AS status, "
+                                   "0.0 AS x, 0.0 AS y, 0.0 AS z WHERE 0");
+    }
+    sqlite3_str_appendall(sql, ";"
+                               "CREATE VIEW Customer_Readings AS "
+                               "    SELECT c.id, s.mac_address, c.recv_time, c.status, c.x, c.y, c.z "
+                               "    FROM Customer_Data c JOIN Sensors s ON s.id = c.sensor_id;");
+
+    char    *text = sqlite3_str_finish(sql);
+    int     rc    = text ? prk_db_exec(db, text) : -1;
+    sqlite3_free(text);
+    return rc;
+}
+
+
+/**
+ * prk_db_schema_version - Schema version recorded in the database.
+ */
+int prk_db_schema_version(sqlite3 *db)
+{
+    sqlite3_stmt    *stmt    = prk_db_prepare(db, "PRAGMA user_version;");
+    int             version  = -1;
+
+    if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+/**
+ * prk_db_migration_description - What migrating to @version changes.
+ */
+const char *prk_db_migration_description(int version)
+{
+    for (size_t i = 0; i < sizeof(migrations) / sizeof(migrations[0]); i++)
+    {
+        if (migrations[i].version == version)
+        {
+            return migrations[i].description;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * prk_db_migrate - Apply every migration above the recorded version.
+ */
+int prk_db_migrate(sqlite3 *db, int verbose)
+{
+    int version = prk_db_schema_version(db);
+    if (version < 0)
+    {
+        return -1;
+    }
+    if (version > PRK_DB_SCHEMA_VERSION)
+    {
+        fprintf(stderr, "Database schema v%d is newer than this program (v%d)\n", version, PRK_DB_SCHEMA_VERSION);
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(migrations) / sizeof(migrations[0]); i++)
+    {
+        const Migration *m = &migrations[i];
+        if (m->version <= version)
+        {
+            continue;
+        }
+
+        if (verbose)
+        {
+            printf("Migrating schema to v%d: %s\n", m->version, m->description);
+            fflush(stdout);
+        }
+        if (m->apply(db) != 0)
+        {
+            fprintf(stderr, "Schema migration to v%d failed\n", m->version);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * prk_db_create_schema - Create the schema, or bring it to the current version.
+ */
+int prk_db_create_schema(sqlite3 *db)
+{
+    return prk_db_migrate(db, 0);
+}
@@ -0,0 +1,478 @@
+/**
+ * prk_metrics.c: Counters, gauges and latency histograms of a stage in shared memory
+ *
+ * The stages only printed to stdout, so the ingest rate, the queue depths
+ * and the database latency could not be watched. Each stage now keeps
+ * its metrics in a POSIX shm page (PRK_METRICS_PREFIX "<stage>") that an
+ * exporter such as out_metrics_exporter reads without involving the
+ * stage. Recording a value touches only memory of the calling thread:
+ * no lock, no system call, no cache line shared with other threads.
+ *
+ * Version: v1.2
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            labelled histograms, histogram read-back and
+ *                                                        quantiles for report tools
+ *   19-10-2026       Morris              v1.2            counter read-back
+ *
+ */
+
+#include "../inc/prk_metrics.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define EXCLUSIVE_SHARDS       (PRK_METRICS_SHARDS - 1)              /* Shards with a single writer */
+#define SHARED_SHARD           (PRK_METRICS_SHARDS - 1)              /* For the threads beyond them */
+#define DISCARD_SLOT           0                                     /* Values of handles that did not fit */
+
+
+_Thread_local _Atomic uint64_t  *prk_metrics_shard;
+_Thread_local int               prk_metrics_shard_shared;
+
+static PrkMetricsPage   *page;                                       /* This stage's page, shm or private */
+static char             page_name[sizeof(PRK_METRICS_PREFIX) + PRK_METRICS_STAGE_LEN];
+static _Atomic int64_t  discard_gauge;                               /* Gauges that did not fit */
+static pthread_mutex_t  shard_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t         shards_taken;                                /* Bit per exclusive shard in use */
+static pthread_key_t    shard_key;                                   /* Shard + 1 of a thread, released at its exit */
+static pthread_once_t   shard_key_once = PTHREAD_ONCE_INIT;
+
+
+/**
+ * init_page - Header of a new page; slots before the first handle are discarded values.
+ */
+static void init_page(PrkMetricsPage *new_page, const char *stage)
+{
+    new_page->format     = PRK_METRICS_FORMAT;
+    new_page->pid        = (int32_t)getpid();
+    new_page->slots      = PRK_HISTOGRAM_SLOTS;                      /* A discarded histogram fits in front */
+    new_page->start_time = (int64_t)time(NULL);
+    snprintf(new_page->stage, sizeof(new_page->stage), "%s", stage);
+    atomic_thread_fence(memory_order_release);
+    new_page->magic      = PRK_METRICS_MAGIC;
+}
+
+/**
+ * private_page - Page in memory of this process only, when no shm page was opened.
+ */
+static PrkMetricsPage *private_page(void)
+{
+    if (!page)
+    {
+        PrkMetricsPage *anonymous = mmap(NULL, sizeof(PrkMetricsPage), PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (anonymous == MAP_FAILED)
+        {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+        init_page(anonymous, "private");
+        page = anonymous;
+    }
+    return page;
+}
+
+/**
+ * prk_metrics_open - Create the metrics page of this stage.
+ */
+int prk_metrics_open(const char *stage)
+{
+    if (page)
+    {
+        fprintf(stderr, "prk_metrics_open: metrics already in use\n");
+        return -1;
+    }
+
+    snprintf(page_name, sizeof(page_name), PRK_METRICS_PREFIX "%s", stage);
+    shm_unlink(page_name);                                           /* Left by a previous run */
+    int fd = shm_open(page_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(PrkMetricsPage)) != 0)        /* ftruncate() zero fills */
+    {
+        perror(page_name);
+        if (fd >= 0)
+        {
+            close(fd);
+            shm_unlink(page_name);
+        }
+        page_name[0] = '\0';
+        return -1;
+    }
+
+    PrkMetricsPage *shared = mmap(NULL, sizeof(PrkMetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED)
+    {
+        perror("mmap");
+        shm_unlink(page_name);
+        page_name[0] = '\0';
+        return -1;
+    }
+    init_page(shared, stage);
+    page = shared;
+    return 0;
+}
+
+/**
+ * prk_metrics_close - Remove the metrics page of this stage.
+ */
+void prk_metrics_close(void)
+{
+    if (page_name[0])
+    {
+        shm_unlink(page_name);
+        page_name[0] = '\0';
+    }
+}
+
+/**
+ * describe - Append the description of a metric and publish it.
+ *
+ * Return: its index, or -1 when the page is full (printed).
+ */
+static int describe(const char *name, const char *help, prk_metric_type_t type, uint32_t slots, double scale)
+{
+    PrkMetricsPage  *target = private_page();
+    uint32_t        index   = atomic_load_explicit(&target->count, memory_order_relaxed);
+
+    if (index >= PRK_METRICS_MAX || target->slots + slots > PRK_METRICS_SLOTS ||
+        strlen(name) >= PRK_METRICS_NAME_LEN)
+    {
+        fprintf(stderr, "Metric %s not registered: no room left\n", name);
+        return -1;
+    }
+
+    PrkMetricDesc *desc = &target->metrics[index];
+    snprintf(desc->name, sizeof(desc->name), "%s", name);
+    snprintf(desc->help, sizeof(desc->help), "%s", help);
+    desc->type  = type;
+    desc->scale = scale;
+    if (type == PRK_METRIC_GAUGE)
+    {
+        desc->slot = index;
+    }
+    else
+    {
+        desc->slot     = target->slots;
+        target->slots += slots;
+    }
+    atomic_store_explicit(&target->count, index + 1, memory_order_release);
+    return (int)index;
+}
+
+/**
+ * prk_counter - Register a counter.
+ */
+PrkCounter prk_counter(const char *name, const char *help)
+{
+    int         index   = describe(name, help, PRK_METRIC_COUNTER, 1, PRK_SCALE_NONE);
+    PrkCounter  counter = { index < 0 ? DISCARD_SLOT : page->metrics[index].slot };
+    return counter;
+}
+
+/**
+ * prk_gauge - Register a gauge.
+ */
+PrkGauge prk_gauge(const char *name, const char *help)
+{
+    int         index = describe(name, help, PRK_METRIC_GAUGE, 0, PRK_SCALE_NONE);
+    PrkGauge    gauge = { index < 0 ? &discard_gauge : &page->gauges[index] };
+    return gauge;
+}
+
+/**
+ * prk_histogram - Register a log-linear histogram.
+ */
+PrkHistogram prk_histogram(const char *name, const char *help, double scale)
+{
+    int             index     = describe(name, help, PRK_METRIC_HISTOGRAM, PRK_HISTOGRAM_SLOTS, scale);
+    PrkHistogram    histogram = { index < 0 ? DISCARD_SLOT : page->metrics[index].slot };
+    return histogram;
+}
+
+/**
+ * release_shard - Thread exit: give an exclusive shard back to the pool.
+ */
+static void release_shard(void *value)
+{
+    uint32_t shard = (uint32_t)(uintptr_t)value - 1;
+
+    if (shard < EXCLUSIVE_SHARDS)
+    {
+        pthread_mutex_lock(&shard_lock);
+        shards_taken &= ~(1u << shard);
+        pthread_mutex_unlock(&shard_lock);
+    }
+    prk_metrics_shard        = NULL;
+    prk_metrics_shard_shared = 0;
+}
+
+/**
+ * create_shard_key - pthread_once() routine of shard_key.
+ */
+static void create_shard_key(void)
+{
+    pthread_key_create(&shard_key, release_shard);
+}
+
+/**
+ * prk_metrics_attach_thread - Hand the calling thread its shard.
+ */
+_Atomic uint64_t *prk_metrics_attach_thread(void)
+{
+    PrkMetricsPage  *target = private_page();
+    uint32_t        shard   = SHARED_SHARD;
+
+    pthread_once(&shard_key_once, create_shard_key);
+    pthread_mutex_lock(&shard_lock);
+    for (uint32_t s = 0; s < EXCLUSIVE_SHARDS; s++)
+    {
+        if (!(shards_taken & (1u << s)))
+        {
+            shards_taken |= 1u << s;
+            shard         = s;
+            break;
+        }
+    }
+    if (atomic_load_explicit(&target->shards, memory_order_relaxed) < shard + 1)
+    {
+        atomic_store_explicit(&target->shards, shard + 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&shard_lock);
+
+    pthread_setspecific(shard_key, (void *)(uintptr_t)(shard + 1));
+    prk_metrics_shard_shared = shard == SHARED_SHARD;
+    prk_metrics_shard        = target->values[shard];
+    return prk_metrics_shard;
+}
+
+/**
+ * prk_metrics_map - Map the metrics page of a stage read-only.
+ */
+const PrkMetricsPage *prk_metrics_map(const char *stage)
+{
+    char        name[sizeof(page_name)];
+    struct stat st;
+
+    snprintf(name, sizeof(name), PRK_METRICS_PREFIX "%s", stage);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t)sizeof(PrkMetricsPage))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    const PrkMetricsPage *mapped = mmap(NULL, sizeof(PrkMetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (mapped->magic != PRK_METRICS_MAGIC || mapped->format != PRK_METRICS_FORMAT)
+    {
+        prk_metrics_unmap(mapped);
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return mapped;
+}
+
+/**
+ * prk_metrics_unmap - Unmap a page returned by prk_metrics_map().
+ */
+void prk_metrics_unmap(const PrkMetricsPage *mapped)
+{
+    munmap((void *)mapped, sizeof(PrkMetricsPage));
+}
+
+/**
+ * sum_shards - Total of value @slot over the shards handed out.
+ */
+static uint64_t sum_shards(const PrkMetricsPage *mapped, uint32_t shards, uint32_t slot)
+{
+    uint64_t total = 0;
+    for (uint32_t s = 0; s < shards; s++)
+    {
+        total += atomic_load_explicit(&mapped->values[s][slot], memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * bucket_upper - Smallest value above bucket @bucket.
+ */
+static uint64_t bucket_upper(unsigned bucket)
+{
+    if (bucket < PRK_HISTOGRAM_SUB)
+    {
+        return bucket + 1;
+    }
+    unsigned exp = bucket / PRK_HISTOGRAM_SUB + PRK_HISTOGRAM_SUB_BITS - 1;
+    unsigned sub = bucket % PRK_HISTOGRAM_SUB;
+    return (uint64_t)(PRK_HISTOGRAM_SUB + sub + 1) << (exp - PRK_HISTOGRAM_SUB_BITS);
+}
+
+/**
+ * write_histogram - Cumulative buckets at the powers of two, _sum and _count.
+ */
+static void write_histogram(const PrkMetricsPage *mapped, uint32_t shards, const PrkMetricDesc *desc,
+                            int base_len, const char *labels, int label_len, FILE *out)
+{
+    const char  *sep        = label_len ? "," : "";
+    uint64_t    cumulative  = 0;
+
+    for (unsigned b = 0; b < PRK_HISTOGRAM_BUCKETS; b++)
+    {
+        cumulative += sum_shards(mapped, shards, desc->slot + b);
+        if (b % PRK_HISTOGRAM_SUB == PRK_HISTOGRAM_SUB - 1 && b + 1 < PRK_HISTOGRAM_BUCKETS)
+        {
+            /* Integer values: at most upper - 1 is the same as below upper */
+            fprintf(out, "%.*s_bucket{stage=\"%s\"%s%.*s,le=\"%.13g\"} %llu\n", base_len, desc->name,
+                    mapped->stage, sep, label_len, labels, (double)(bucket_upper(b) - 1) / desc->scale,
+                    (unsigned long long)cumulative);
+        }
+    }
+    fprintf(out, "%.*s_bucket{stage=\"%s\"%s%.*s,le=\"+Inf\"} %llu\n", base_len, desc->name, mapped->stage,
+            sep, label_len, labels, (unsigned long long)cumulative);
+    fprintf(out, "%.*s_sum{stage=\"%s\"%s%.*s} %.9g\n", base_len, desc->name, mapped->stage, sep, label_len,
+            labels, (double)sum_shards(mapped, shards, desc->slot + PRK_HISTOGRAM_BUCKETS) / desc->scale);
+    fprintf(out, "%.*s_count{stage=\"%s\"%s%.*s} %llu\n", base_len, desc->name, mapped->stage, sep,
+            label_len, labels, (unsigned long long)cumulative);
+}
+
+/**
+ * prk_metrics_write_text - Write the metrics of a page in the Prometheus text exposition format.
+ */
+int prk_metrics_write_text(const PrkMetricsPage *mapped, FILE *out)
+{
+    static const char *const type_names[] = { "untyped", "counter", "gauge", "histogram" };
+    uint32_t    count    = atomic_load_explicit(&mapped->count, memory_order_acquire);
+    uint32_t    shards   = atomic_load_explicit(&mapped->shards, memory_order_acquire);
+    const char  *family  = "";
+    int         family_len = 0;
+
+    if (count > PRK_METRICS_MAX)
+    {
+        count = PRK_METRICS_MAX;
+    }
+    if (shards > PRK_METRICS_SHARDS)
+    {
+        shards = PRK_METRICS_SHARDS;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const PrkMetricDesc *desc     = &mapped->metrics[i];
+        const char          *labels   = strchr(desc->name, '{');
+        int                 base_len  = labels ? (int)(labels - desc->name) : (int)strlen(desc->name);
+        int                 label_len = labels ? (int)strcspn(labels + 1, "}") : 0;
+
+        /* HELP and TYPE once per family, before its first series */
+        if (base_len != family_len || strncmp(desc->name, family, (size_t)base_len) != 0)
+        {
+            family     = desc->name;
+            family_len = base_len;
+            fprintf(out, "# HELP %.*s %s\n# TYPE %.*s %s\n", base_len, desc->name, desc->help, base_len,
+                    desc->name, type_names[desc->type <= PRK_METRIC_HISTOGRAM ? desc->type : 0]);
+        }
+
+        switch (desc->type)
+        {
+            case PRK_METRIC_COUNTER:
+                fprintf(out, "%.*s{stage=\"%s\"%s%.*s} %llu\n", base_len, desc->name, mapped->stage,
+                        label_len ? "," : "", label_len, labels ? labels + 1 : "",
+                        (unsigned long long)sum_shards(mapped, shards, desc->slot));
+                break;
+            case PRK_METRIC_GAUGE:
+                fprintf(out, "%.*s{stage=\"%s\"%s%.*s} %lld\n", base_len, desc->name, mapped->stage,
+                        label_len ? "," : "", label_len, labels ? labels + 1 : "",
+                        (long long)atomic_load_explicit(&mapped->gauges[desc->slot % PRK_METRICS_MAX],
+                                                        memory_order_relaxed));
+                break;
+            case PRK_METRIC_HISTOGRAM:
+                write_histogram(mapped, shards, desc, base_len, labels ? labels + 1 : "", label_len, out);
+                break;
+            default:
+                break;
+        }
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+/**
+ * prk_counter_read - Value of a counter, summed over the shards.
+ */
+uint64_t prk_counter_read(const PrkMetricsPage *mapped, const PrkMetricDesc *desc)
+{
+    uint32_t shards = atomic_load_explicit(&mapped->shards, memory_order_acquire);
+
+    if (shards > PRK_METRICS_SHARDS)
+    {
+        shards = PRK_METRICS_SHARDS;
+    }
+    return sum_shards(mapped, shards, desc->slot);
+}
+
+/**
+ * prk_histogram_read - Buckets of a histogram, summed over the shards.
+ */
+uint64_t prk_histogram_read(const PrkMetricsPage *mapped, const PrkMetricDesc *desc,
+                            uint64_t buckets[PRK_HISTOGRAM_BUCKETS], uint64_t *sum)
+{
+    uint32_t shards = atomic_load_explicit(&mapped->shards, memory_order_acquire);
+    uint64_t count  = 0;
+
+    if (shards > PRK_METRICS_SHARDS)
+    {
+        shards = PRK_METRICS_SHARDS;
+    }
+    for (unsigned b = 0; b < PRK_HISTOGRAM_BUCKETS; b++)
+    {
+        buckets[b] = sum_shards(mapped, shards, desc->slot + b);
+        count     += buckets[b];
+    }
+    if (sum)
+    {
+        *sum = sum_shards(mapped, shards, desc->slot + PRK_HISTOGRAM_BUCKETS);
+    }
+    return count;
+}
+
+/**
+ * prk_histogram_quantile - Value below which a fraction @q of the values lie.
+ */
+double prk_histogram_quantile(const uint64_t buckets[PRK_HISTOGRAM_BUCKETS], uint64_t count, double q)
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+
+    /* Rank of the value sought, then linear within its bucket */
+    double      rank  = q * (double)count;
+    uint64_t    below = 0;
+    for (unsigned b = 0; b < PRK_HISTOGRAM_BUCKETS; b++)
+    {
+        if (buckets[b] > 0 && (double)(below + buckets[b]) >= rank)
+        {
+            double lower = b == 0 ? 0.0 : (double)bucket_upper(b - 1);
+            double upper = (double)bucket_upper(b);
+            double share = (rank - (double)below) / (double)buckets[b];
+            return lower + (upper - lower) * (share > 0.0 ? share : 0.0);
+        }
+        below += buckets[b];
+    }
+    return (double)bucket_upper(PRK_HISTOGRAM_BUCKETS - 1);
+}
@@ -0,0 +1,75 @@
+/**
+ * prk_notify.c: Readiness notification to the stage supervisor
+ *
+ * prk_sys_srv_run used to sleep a fixed two seconds after starting each
+ * stage. Each stage now reports when it is ready with one datagram on the
+ * socket the supervisor passes in $NOTIFY_SOCKET, so the next stage starts
+ * as soon as it can.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/prk_notify.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/**
+ * prk_notify - Send a state line to the supervisor of this process.
+ */
+int prk_notify(const char *state)
+{
+    const char *path = getenv(PRK_NOTIFY_ENV);
+    if (!path || !*path)
+    {
+        return 0;
+    }
+
+    struct sockaddr_un  addr = { .sun_family = AF_UNIX };
+    size_t              len  = strlen(path);
+    if ((path[0] != '/' && path[0] != '@') || len >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "%s: unsupported socket address %s\n", PRK_NOTIFY_ENV, path);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, len);
+    if (path[0] == '@')
+    {
+        addr.sun_path[0] = '\0';                                     /* Abstract name */
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    ssize_t sent = sendto(fd, state, strlen(state), MSG_NOSIGNAL, (struct sockaddr *)&addr,
+                          (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len));
+    close(fd);
+    if (sent < 0)
+    {
+        perror(PRK_NOTIFY_ENV);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * prk_notify_ready - Tell the supervisor that this stage serves requests.
+ */
+int prk_notify_ready(void)
+{
+    return prk_notify("READY=1");
+}
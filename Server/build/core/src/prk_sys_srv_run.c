@@ -1,107 +1,614 @@
-/* gcc prk_sys_srv_run.c -o out_prk_sys_srv_run */                   /* Compile command to create the executable */
-/* prk_sys_srv_run.c: Program to start multiple services in separate terminal windows */
-
-/*
- * prk_sys_srv_run.c: Program to start multiple services in separate terminal windows
+/**
+ * prk_sys_srv_run.c: Headless supervisor of the server-side stages
  *
- * This program sequentially starts several specified programs in new terminal windows.
- * Each program is given a brief period to initialize before the next program is started.
+ * This program starts the stages of the server pipeline in dependency
+ * order, keeps them running and stops them in reverse order.
  *
- * Programs started:
- * - out_server
- * - out_listener
- * - out_giis
- * - out_insert_data_from_giis_shm
+ * Each stage runs in the background, in its own process group, with
+ * NOTIFY_SOCKET pointing at a datagram socket of the supervisor. A stage
+ * reports "READY=1" on it once the resources of the next stages exist
+ * (see prk_notify.h), and the stages waiting for it start right away
+ * instead of after a fixed sleep. A stage that exits, or is not ready
+ * within SUPERVISOR_READY_TIMEOUT_MS, is restarted after a delay that
+ * doubles with each crash, from SUPERVISOR_BACKOFF_MIN_MS up to
+ * SUPERVISOR_BACKOFF_MAX_MS, and starts over once it stays up for
+ * SUPERVISOR_STABLE_MS. SIGTERM, SIGINT or SIGHUP stop the stages, each
+ * one only after every stage started after it has exited: SIGTERM first,
+ * SIGKILL after SUPERVISOR_STOP_TIMEOUT_MS.
  *
- * The `run_in_terminal` function constructs a command to open a new terminal window
- * and execute a specified program within it, leaving the terminal open after the
- * program finishes execution.
- *
- * The `main` function prints status messages and adds delays between starting each program.
+ * Stages and their order:
+ * - out_server
+ * - out_listener, out_giis                    (after out_server)
+ * - out_query_daemon, out_update_prices --watch, out_metrics_exporter
+ * - out_insert_data_from_giis_shm             (after out_giis, out_query_daemon
+ *                                              and out_update_prices)
  *
  * Compilation:
- *      gcc prk_sys_srv_run.c -o out_prk_sys_srv_run
+ *      make    (from Server/build/make)
  *
  * Usage:
- *      ./out_prk_sys_srv_run
+ *      ./prk_sys_srv_run [--log-dir <dir>] [--without <stage>]...
  *
  * Features:
- * - Opens a new terminal window for each program.
- * - Adds delays to ensure each program has time to initialize.
- * - Prints status messages before starting each program.
- * 
- * Version: 1.0
- * Author: Morris
+ * - Needs no terminal or desktop session; run it in the directory of the stages.
+ * - Prints when each stage starts, is ready, exits and is restarted, with
+ *   the time since the supervisor started.
+ * - --log-dir appends the output of each stage to <dir>/<stage>.log.
+ * - --without leaves a stage out (for instance one run by hand); the stages
+ *   after it do not wait for it.
+ * - A stage gets SIGTERM if the supervisor itself dies.
+ *
+ * Version: v2.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   01-07-2024       Morris              v1.0            created
+ *   19-10-2026       Morris              v2.0            headless: readiness notification instead of sleeps,
+ *                                                        restart with backoff, ordered shutdown
+ *   19-10-2026       Morris              v2.1            out_metrics_exporter stage
  *
- * Date:                Name:                 Modification:
- *      01-07-2024           Morris                  created
  */
 
-
+#define _GNU_SOURCE                                                  /* struct ucred */
+#include "../inc/prk_sys_srv_run.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+
+static const StageSpec stage_specs[] =
+{
+    { "out_server",         { "./out_server", NULL },                   { NULL } },
+    { "out_listener",       { "./out_listener", NULL },                 { "out_server", NULL } },
+    { "out_giis",           { "./out_giis", NULL },                     { "out_server", NULL } },
+    { "out_query_daemon",   { "./out_query_daemon", NULL },             { NULL } },
+    { "out_update_prices",  { "./out_update_prices", "--watch", NULL }, { NULL } },
+    { "out_metrics_exporter", { "./out_metrics_exporter", NULL },       { NULL } },
+    { "out_insert_data_from_giis_shm", { "./out_insert_data_from_giis_shm", NULL },
+                            { "out_giis", "out_query_daemon", "out_update_prices", NULL } },
+};
+
+#define STAGE_COUNT            (sizeof(stage_specs) / sizeof(stage_specs[0]))
+
+
+static Stage        stages[STAGE_COUNT];
+static const char   *log_dir;                                        /* --log-dir, NULL: output inherited */
+static int64_t      boot_ms;                                         /* CLOCK_MONOTONIC at start */
+static pid_t        supervisor_pid;
+
+
+/**
+ * monotonic_ms - CLOCK_MONOTONIC in ms.
+ */
+static int64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * log_event - Print one line, stamped with the seconds since start.
+ */
+static void log_event(const char *name, const char *format, ...)
+{
+    va_list args;
+
+    printf("[%8.3f] %s: ", (double)(monotonic_ms() - boot_ms) / 1000.0, name);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+}
+
+/**
+ * find_stage - Stage named @name, or NULL.
+ */
+static Stage *find_stage(const char *name)
+{
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+    {
+        if (strcmp(stages[i].spec->name, name) == 0)
+        {
+            return &stages[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * stage_of_pid - Running stage with process @pid, or NULL.
+ */
+static Stage *stage_of_pid(pid_t pid)
+{
+    for (size_t i = 0; pid > 0 && i < STAGE_COUNT; i++)
+    {
+        if (stages[i].pid == pid)
+        {
+            return &stages[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * after_ready - Whether every stage @stage starts after is ready or left out.
+ */
+static int after_ready(const Stage *stage)
+{
+    for (const char *const *name = stage->spec->after; *name; name++)
+    {
+        const Stage *before = find_stage(*name);
+        if (before && before->state != STAGE_READY && before->state != STAGE_DOWN)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * needed_by_running - Whether a stage started after @stage still runs.
+ */
+static int needed_by_running(const Stage *stage)
+{
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+    {
+        for (const char *const *name = stages[i].spec->after; stages[i].pid > 0 && *name; name++)
+        {
+            if (strcmp(*name, stage->spec->name) == 0)
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * schedule_restart - Restart @stage after its backoff delay.
+ */
+static void schedule_restart(Stage *stage, int64_t now_ms)
+{
+    if (now_ms - stage->started_ms >= SUPERVISOR_STABLE_MS)
+    {
+        stage->restarts = 0;
+    }
+
+    int64_t delay = SUPERVISOR_BACKOFF_MIN_MS;
+    for (int i = 0; i < stage->restarts && delay < SUPERVISOR_BACKOFF_MAX_MS; i++)
+    {
+        delay *= 2;
+    }
+    delay = delay < SUPERVISOR_BACKOFF_MAX_MS ? delay : SUPERVISOR_BACKOFF_MAX_MS;
+
+    stage->restarts++;
+    stage->state       = STAGE_BACKOFF;
+    stage->deadline_ms = now_ms + delay;
+    log_event(stage->spec->name, "restarting in %lld ms", (long long)delay);
+}
+
+/**
+ * start_stage - Fork and exec @stage.
+ */
+static void start_stage(Stage *stage, int64_t now_ms)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        stage->started_ms = now_ms;
+        schedule_restart(stage, now_ms);
+        return;
+    }
+
+    if (pid == 0)
+    {
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        setpgid(0, 0);                                               /* Ctrl+C reaches the supervisor only */
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != supervisor_pid)
+        {
+            _exit(EXIT_FAILURE);                                     /* The supervisor died before prctl() */
+        }
+        if (log_dir)
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s.log", log_dir, stage->spec->name);
+            int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd < 0)
+            {
+                perror(path);
+                _exit(EXIT_FAILURE);
+            }
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execv(stage->spec->argv[0], (char *const *)stage->spec->argv);
+        perror(stage->spec->argv[0]);
+        _exit(127);
+    }
+
+    stage->pid                = pid;
+    stage->state              = STAGE_STARTING;
+    stage->started_ms         = now_ms;
+    stage->deadline_ms        = now_ms + SUPERVISOR_READY_TIMEOUT_MS;
+    stage->restart_after_stop = 0;
+    log_event(stage->spec->name, "started, pid %d", (int)pid);
+}
 
+/**
+ * stop_stage - Send SIGTERM to @stage; @restart: start it again once it exits.
+ */
+static void stop_stage(Stage *stage, int64_t now_ms, int restart)
+{
+    kill(stage->pid, SIGTERM);
+    stage->state              = STAGE_STOPPING;
+    stage->deadline_ms        = now_ms + SUPERVISOR_STOP_TIMEOUT_MS;
+    stage->restart_after_stop = restart;
+}
 
 /**
- * run_in_terminal - Executes a program in a new terminal window.
+ * step_stage - Start, stop or time out @stage as its state requires.
+ */
+static void step_stage(Stage *stage, int stopping, int64_t now_ms)
+{
+    switch (stage->state)
+    {
+    case STAGE_BACKOFF:
+        if (!stopping && now_ms < stage->deadline_ms)
+        {
+            break;
+        }
+        stage->state = STAGE_WAITING;
+        /* fall through */
+    case STAGE_WAITING:
+        if (stopping)
+        {
+            stage->state = STAGE_DOWN;
+        }
+        else if (after_ready(stage))
+        {
+            start_stage(stage, now_ms);
+        }
+        break;
+
+    case STAGE_STARTING:
+    case STAGE_READY:
+        if (stopping)
+        {
+            if (!needed_by_running(stage))
+            {
+                log_event(stage->spec->name, "stopping");
+                stop_stage(stage, now_ms, 0);
+            }
+        }
+        else if (stage->state == STAGE_STARTING && now_ms >= stage->deadline_ms)
+        {
+            log_event(stage->spec->name, "not ready after %d ms", SUPERVISOR_READY_TIMEOUT_MS);
+            stop_stage(stage, now_ms, 1);
+        }
+        break;
+
+    case STAGE_STOPPING:
+        if (now_ms >= stage->deadline_ms)
+        {
+            log_event(stage->spec->name, "still running %d ms after SIGTERM, killing it", SUPERVISOR_STOP_TIMEOUT_MS);
+            kill(stage->pid, SIGKILL);
+            stage->deadline_ms = INT64_MAX;
+        }
+        break;
+
+    case STAGE_DOWN:
+        break;
+    }
+}
+
+/**
+ * reap_stages - Collect the exited stages; restart them unless @stopping.
+ */
+static void reap_stages(int stopping, int64_t now_ms)
+{
+    int     status;
+    pid_t   pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        Stage *stage = stage_of_pid(pid);
+        if (!stage)
+        {
+            continue;
+        }
+
+        char how[64];
+        if (WIFSIGNALED(status))
+        {
+            snprintf(how, sizeof(how), "killed by signal %d (%s)", WTERMSIG(status), strsignal(WTERMSIG(status)));
+        }
+        else
+        {
+            snprintf(how, sizeof(how), "exited with status %d", WEXITSTATUS(status));
+        }
+
+        int expected = stage->state == STAGE_STOPPING && !stage->restart_after_stop;
+        stage->pid = 0;
+        log_event(stage->spec->name, "%s%s", expected ? "stopped, " : "", how);
+        if (stopping || expected)
+        {
+            stage->state = STAGE_DOWN;
+        }
+        else
+        {
+            schedule_restart(stage, now_ms);
+        }
+    }
+}
+
+/**
+ * has_line - Whether the NUL-terminated @message holds the line @line.
+ */
+static int has_line(const char *message, const char *line)
+{
+    size_t len = strlen(line);
+
+    for (const char *p = message; *p; )
+    {
+        const char *end = strchr(p, '\n');
+        size_t     n    = end ? (size_t)(end - p) : strlen(p);
+        if (n == len && memcmp(p, line, len) == 0)
+        {
+            return 1;
+        }
+        p += n + (end != NULL);
+    }
+    return 0;
+}
+
+/**
+ * receive_notify - Handle the pending datagrams of the notify socket.
  *
- * This function constructs a command to open a new terminal window and
- * execute the specified program within it. The terminal remains open
- * after the program finishes execution.
+ * The sender is identified by the credentials the kernel attaches
+ * (SO_PASSCRED), not by what the message says.
  *
- * @param program: The name of the program to run.
+ * Return: 1 when a stage became ready, 0 otherwise.
+ */
+static int receive_notify(int fd, int64_t now_ms)
+{
+    int became_ready = 0;
+
+    for (;;)
+    {
+        char            message[512];
+        union
+        {
+            struct cmsghdr  align;
+            char            buf[CMSG_SPACE(sizeof(struct ucred))];
+        } control;
+        struct iovec    iov = { .iov_base = message, .iov_len = sizeof(message) - 1 };
+        struct msghdr   msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf,
+                                .msg_controllen = sizeof(control.buf) };
+
+        ssize_t len = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (len < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                perror("recvmsg");
+            }
+            return became_ready;
+        }
+        message[len] = '\0';
+
+        pid_t pid = 0;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS)
+            {
+                struct ucred cred;
+                memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+                pid = cred.pid;
+            }
+        }
+
+        Stage *stage = stage_of_pid(pid);
+        if (stage && stage->state == STAGE_STARTING && has_line(message, "READY=1"))
+        {
+            stage->state = STAGE_READY;
+            became_ready = 1;
+            log_event(stage->spec->name, "ready in %lld ms", (long long)(now_ms - stage->started_ms));
+        }
+    }
+}
+
+/**
+ * open_notify_socket - Bind the notify socket and export it as NOTIFY_SOCKET.
  *
- * Note: This function uses `gnome-terminal` and `bash` to run the command.
- *       If `gnome-terminal` is not available, or if the system command fails,
- *       the function prints an error message and exits the program.
+ * Return: the socket, or -1.
  */
-void run_in_terminal(const char *program)
+static int open_notify_socket(void)
 {
-    char command[256];
-    snprintf(command, sizeof(command), "gnome-terminal -- bash -c './%s; exec bash'", program);
-    if (system(command) == -1)
+    char                name[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    struct sockaddr_un  addr = { .sun_family = AF_UNIX };
+    int                 on   = 1;
+
+    snprintf(name, sizeof(name), SUPERVISOR_SOCKET, (int)supervisor_pid);
+    size_t len = strlen(name);
+    memcpy(addr.sun_path, name, len);
+    addr.sun_path[0] = '\0';                                         /* Abstract: nothing to remove afterwards */
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) != 0 ||
+        bind(fd, (struct sockaddr *)&addr, (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len)) != 0)
     {
-        perror("system");
-        exit(EXIT_FAILURE);
+        perror("notify socket");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    setenv("NOTIFY_SOCKET", name, 1);
+    return fd;
+}
+
+/**
+ * report_all_ready - Print the start time once every stage is first ready.
+ */
+static void report_all_ready(void)
+{
+    static int reported;
+
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+    {
+        if (stages[i].state != STAGE_READY && stages[i].state != STAGE_DOWN)
+        {
+            return;
+        }
+    }
+    if (!reported)
+    {
+        reported = 1;
+        log_event("prk_sys_srv_run", "all stages ready");
     }
 }
 
 /**
  * main - Entry point of the program.
  *
- * This function sequentially starts several programs in new terminal windows.
- * It provides delays between each program start to ensure proper initialization.
- *
- * Programs started:
- * - out_server
- * - out_listener
- * - out_giis
- * - out_insert_data_from_giis_shm
+ * This function starts the stages, then waits on a signalfd (SIGCHLD,
+ * SIGTERM, SIGINT, SIGHUP) and on the notify socket until a stop request
+ * has stopped every stage, with the nearest ready, stop or restart
+ * deadline as the poll() timeout.
  *
- * Return: 0 on successful completion.
- *
- * Note: The function prints messages to the console before starting each program.
- *       Delays are added using `sleep` to ensure each program has time to initialize.
+ * Return: 0 after a clean shutdown, 1 on a usage or setup error.
  */
-int main()
+int main(int argc, char *argv[])
 {
-    printf("Starting out_server...\n");
-    run_in_terminal("out_server");
-    sleep(2);                                                        /* Give time for the server to start */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    boot_ms        = monotonic_ms();
+    supervisor_pid = getpid();
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+    {
+        stages[i].spec  = &stage_specs[i];
+        stages[i].state = STAGE_WAITING;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        Stage *stage;
+        if (strcmp(argv[i], "--log-dir") == 0 && i + 1 < argc)
+        {
+            log_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--without") == 0 && i + 1 < argc && (stage = find_stage(argv[i + 1])))
+        {
+            stage->state = STAGE_DOWN;
+            i++;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--log-dir <dir>] [--without <stage>]...\nStages:", argv[0]);
+            for (size_t s = 0; s < STAGE_COUNT; s++)
+            {
+                fprintf(stderr, " %s", stage_specs[s].name);
+            }
+            fputc('\n', stderr);
+            return 1;
+        }
+    }
 
-    printf("Starting out_listener...\n");
-    run_in_terminal("out_listener");
-    sleep(2);                                                        /* Give time for the listener to start */
+    /* Signals arrive on a descriptor, between two steps of the loop */
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGHUP);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    int notify_fd = open_notify_socket();
+    if (signal_fd < 0 || notify_fd < 0)
+    {
+        if (signal_fd < 0)
+        {
+            perror("signalfd");
+        }
+        return 1;
+    }
 
-    printf("Starting out_giis...\n");
-    run_in_terminal("out_giis");
-    sleep(2);                                                        /* Give time for giis to start */
+    int stopping = 0;
+    for (;;)
+    {
+        int64_t now_ms   = monotonic_ms();
+        int64_t next_ms  = INT64_MAX;
+        int     running  = 0;
 
-    printf("Staring out_insert_data_from_giis_shm...\n");
-    run_in_terminal("out_insert_data_from_giis_shm");
-    sleep(1);                                                        /* Give time for insert_data_from_giis_shm to start */
+        for (size_t i = 0; i < STAGE_COUNT; i++)
+        {
+            step_stage(&stages[i], stopping, now_ms);
+        }
+        for (size_t i = 0; i < STAGE_COUNT; i++)
+        {
+            running += stages[i].pid > 0;
+            if (stages[i].state == STAGE_STARTING || stages[i].state == STAGE_STOPPING ||
+                stages[i].state == STAGE_BACKOFF)
+            {
+                next_ms = stages[i].deadline_ms < next_ms ? stages[i].deadline_ms : next_ms;
+            }
+        }
+        if (stopping && running == 0)
+        {
+            break;
+        }
 
+        struct pollfd fds[2] = { { .fd = signal_fd, .events = POLLIN }, { .fd = notify_fd, .events = POLLIN } };
+        int           wait   = -1;
+        if (next_ms != INT64_MAX)
+        {
+            wait = next_ms <= now_ms ? 0 : (int)(next_ms - now_ms < 60000 ? next_ms - now_ms : 60000);
+        }
+        if (poll(fds, 2, wait) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        struct signalfd_siginfo info;
+        while (read(signal_fd, &info, sizeof(info)) == sizeof(info))
+        {
+            if (info.ssi_signo != SIGCHLD && !stopping)
+            {
+                stopping = 1;
+                log_event("prk_sys_srv_run", "%s, stopping the stages", strsignal((int)info.ssi_signo));
+            }
+        }
+        now_ms = monotonic_ms();
+        reap_stages(stopping, now_ms);
+        if (receive_notify(notify_fd, now_ms))
+        {
+            report_all_ready();
+        }
+    }
+
+    log_event("prk_sys_srv_run", "all stages stopped");
+    close(notify_fd);
+    close(signal_fd);
     return 0;
 }
-
@@ -0,0 +1,272 @@
+/**
+ * prk_trace.c: Trace ids and stage timestamps carried by records
+ *
+ * A traced record carries a suffix
+ *      "... trace 5f1c0e2a9b3d4c71 ctl:81234567:1729301234000000 ipc:81234890:1729301234000001"
+ * after its last field: the trace id, then one stamp per stage it passed,
+ * each the stage's CLOCK_MONOTONIC and the wall clock offset of its host,
+ * in microseconds. Binary stages fill a PrkTrace and format it; text
+ * stages append their stamp to the record; the inserter parses the suffix
+ * and folds the stamps into per hop latencies (see trace_sink.h).
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#define _GNU_SOURCE                                                  /* memmem */
+#include "../inc/prk_trace.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* Names of prk_trace_stage_t, as written in stamps */
+static const char *const stage_names[PRK_TRACE_STAGES] =
+{
+    "mcu", "ctl", "ipc", "tcp", "srv", "giis", "ins", "db",
+};
+
+static _Atomic uint64_t next_id;                                     /* 0 until the first trace */
+
+
+/**
+ * clock_us - A clock in microseconds.
+ */
+static int64_t clock_us(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * mix64 - splitmix64 finalizer, spreads a seed over all 64 bits.
+ */
+static uint64_t mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * prk_trace_begin - Start the trace of a new record.
+ */
+void prk_trace_begin(PrkTrace *trace)
+{
+    uint64_t id = atomic_load_explicit(&next_id, memory_order_relaxed);
+    if (id == 0)
+    {
+        /* Random start per process, so ids of different gateways do not collide */
+        uint64_t seed = mix64((uint64_t)clock_us(CLOCK_REALTIME) ^ ((uint64_t)getpid() << 40)) | 1;
+        uint64_t none = 0;
+        atomic_compare_exchange_strong(&next_id, &none, seed);
+    }
+    id = atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed);
+
+    trace->id    = id ? id : atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed);
+    trace->count = 0;
+}
+
+/**
+ * prk_trace_stamp_at - Stamp a trace with a monotonic time of this host.
+ */
+void prk_trace_stamp_at(PrkTrace *trace, prk_trace_stage_t stage, int64_t mono_us)
+{
+    if (trace->count >= PRK_TRACE_STAGES ||
+        (trace->count > 0 && trace->stamps[trace->count - 1].stage >= stage))
+    {
+        return;
+    }
+
+    PrkTraceStamp *stamp = &trace->stamps[trace->count++];
+    int64_t       now    = clock_us(CLOCK_MONOTONIC);
+    stamp->stage     = (uint8_t)stage;
+    stamp->mono_us   = mono_us;
+    stamp->offset_us = clock_us(CLOCK_REALTIME) - now;
+}
+
+/**
+ * prk_trace_stamp - Stamp a trace with the current time.
+ */
+void prk_trace_stamp(PrkTrace *trace, prk_trace_stage_t stage)
+{
+    prk_trace_stamp_at(trace, stage, clock_us(CLOCK_MONOTONIC));
+}
+
+/**
+ * prk_trace_format - Write the trace suffix of a record.
+ */
+int prk_trace_format(const PrkTrace *trace, char *buf, size_t size)
+{
+    int len = snprintf(buf, size, " " PRK_TRACE_TAG " %016llx", (unsigned long long)trace->id);
+    for (uint32_t i = 0; i < trace->count && len >= 0 && (size_t)len < size; i++)
+    {
+        const PrkTraceStamp *stamp = &trace->stamps[i];
+        int                 wrote  = snprintf(buf + len, size - (size_t)len, " %s:%lld:%lld",
+                                              prk_trace_stage_name(stamp->stage), (long long)stamp->mono_us,
+                                              (long long)stamp->offset_us);
+        len = wrote < 0 ? -1 : len + wrote;
+    }
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
+
+/**
+ * prk_trace_format_stamp - Write a stamp of the current time.
+ */
+int prk_trace_format_stamp(prk_trace_stage_t stage, char *buf, size_t size)
+{
+    int64_t mono = clock_us(CLOCK_MONOTONIC);
+    int64_t real = clock_us(CLOCK_REALTIME);
+    int     len  = snprintf(buf, size, " %s:%lld:%lld", prk_trace_stage_name(stage), (long long)mono,
+                            (long long)(real - mono));
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
+
+/**
+ * prk_trace_find - Locate the trace suffix of a record.
+ */
+const char *prk_trace_find(const char *record, size_t len)
+{
+    static const char tag[] = " " PRK_TRACE_TAG " ";
+    return memmem(record, len, tag, sizeof(tag) - 1);
+}
+
+/**
+ * parse_int - Parse a decimal integer at *@pp, optionally negative.
+ */
+static int parse_int(const char **pp, const char *end, int64_t *out)
+{
+    const char  *p        = *pp;
+    int         negative  = p < end && *p == '-';
+    uint64_t    value     = 0;
+    int         digits    = 0;
+
+    p += negative;
+    while (p < end && (unsigned)(*p - '0') < 10u)
+    {
+        if (++digits > 18)
+        {
+            return -1;
+        }
+        value = value * 10 + (uint64_t)(*p++ - '0');
+    }
+    if (digits == 0)
+    {
+        return -1;
+    }
+    *out = negative ? -(int64_t)value : (int64_t)value;
+    *pp  = p;
+    return 0;
+}
+
+/**
+ * prk_trace_parse - Read a trace suffix back.
+ */
+int prk_trace_parse(const char *text, size_t len, PrkTrace *trace)
+{
+    const char  *p   = text;
+    const char  *end = text + len;
+    size_t      tag  = strlen(PRK_TRACE_TAG);
+
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+    if ((size_t)(end - p) < tag + 2 || memcmp(p, PRK_TRACE_TAG, tag) != 0 || p[tag] != ' ')
+    {
+        return -1;
+    }
+    p += tag + 1;
+
+    /* Id: up to 16 hex digits */
+    uint64_t id     = 0;
+    int      digits = 0;
+    for (; p < end && *p != ' '; p++, digits++)
+    {
+        int c = (unsigned char)*p | 0x20;
+        int v = (unsigned)(c - '0') < 10u ? c - '0' : (unsigned)(c - 'a') < 6u ? c - 'a' + 10 : -1;
+        if (v < 0 || digits == 16)
+        {
+            return -1;
+        }
+        id = id << 4 | (uint64_t)v;
+    }
+    if (id == 0)
+    {
+        return -1;
+    }
+    trace->id    = id;
+    trace->count = 0;
+
+    /* Stamps: " <stage>:<mono_us>:<offset_us>", stages in order */
+    while (p < end)
+    {
+        while (p < end && *p == ' ')
+        {
+            p++;
+        }
+        if (p == end)
+        {
+            break;
+        }
+
+        const char  *colon = memchr(p, ':', (size_t)(end - p));
+        int         stage  = -1;
+        for (int s = 0; colon && s < PRK_TRACE_STAGES; s++)
+        {
+            size_t name_len = strlen(stage_names[s]);
+            if ((size_t)(colon - p) == name_len && memcmp(p, stage_names[s], name_len) == 0)
+            {
+                stage = s;
+                break;
+            }
+        }
+        if (stage < 0 || trace->count >= PRK_TRACE_STAGES ||
+            (trace->count > 0 && trace->stamps[trace->count - 1].stage >= stage))
+        {
+            return -1;
+        }
+
+        PrkTraceStamp *stamp = &trace->stamps[trace->count];
+        p = colon + 1;
+        if (parse_int(&p, end, &stamp->mono_us) != 0 || p == end || *p++ != ':' ||
+            parse_int(&p, end, &stamp->offset_us) != 0 || (p < end && *p != ' '))
+        {
+            return -1;
+        }
+        stamp->stage = (uint8_t)stage;
+        trace->count++;
+    }
+
+    return 0;
+}
+
+/**
+ * prk_trace_elapsed_us - Time from stamp @from to stamp @to.
+ */
+int64_t prk_trace_elapsed_us(const PrkTraceStamp *from, const PrkTraceStamp *to)
+{
+    int64_t skew = to->offset_us - from->offset_us;
+    if (skew > -PRK_TRACE_SAME_CLOCK_US && skew < PRK_TRACE_SAME_CLOCK_US)
+    {
+        return to->mono_us - from->mono_us;
+    }
+    return (to->mono_us + to->offset_us) - (from->mono_us + from->offset_us);
+}
+
+/**
+ * prk_trace_stage_name - Short name of a stage, as written in a stamp.
+ */
+const char *prk_trace_stage_name(prk_trace_stage_t stage)
+{
+    return (unsigned)stage < PRK_TRACE_STAGES ? stage_names[stage] : "?";
+}
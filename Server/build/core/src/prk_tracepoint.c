@@ -0,0 +1,251 @@
+/**
+ * prk_tracepoint.c: Per-thread rings of tracepoint events in shared memory
+ *
+ * The metrics tell how long a stage takes on average and in its tail, not
+ * what it was doing when it took long. Tracepoints (PRK_TP_* in
+ * prk_tracepoint.h) write timestamped events to a ring per thread in a
+ * POSIX shm page (PRK_TP_PREFIX "<stage>"), from which out_tp_dump writes
+ * a timeline in the Chrome trace format. Writing an event takes no lock
+ * and no system call. Without -DPRK_TRACEPOINTS nothing calls in here.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/prk_tracepoint.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+
+_Thread_local PrkTpRing *prk_tp_ring;
+_Thread_local int32_t   prk_tp_tid;
+
+static PrkTpPage        *page;                                       /* This stage's page, NULL until opened */
+static char             page_name[sizeof(PRK_TP_PREFIX) + PRK_TP_STAGE_LEN];
+static PrkTpRing        discard_ring;                                /* Events with no ring to go to */
+static pthread_key_t    ring_key;                                    /* Ring of a thread, handed back at its exit */
+static pthread_once_t   ring_key_once = PTHREAD_ONCE_INIT;
+
+#define PRK_TP_EVENT_NAMES(id, name, arg0, arg1) { name, arg0, arg1 },
+static const char *const event_names[PRK_TP_EVENT_COUNT][3] =
+{
+    PRK_TP_EVENTS(PRK_TP_EVENT_NAMES)
+};
+#undef PRK_TP_EVENT_NAMES
+
+
+/**
+ * monotonic_ns - CLOCK_MONOTONIC in nanoseconds.
+ */
+static int64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * prk_tp_open - Create the tracepoint page of this stage.
+ */
+int prk_tp_open(const char *stage)
+{
+    if (page)
+    {
+        fprintf(stderr, "prk_tp_open: tracepoints already in use\n");
+        return -1;
+    }
+
+    snprintf(page_name, sizeof(page_name), PRK_TP_PREFIX "%s", stage);
+    shm_unlink(page_name);                                           /* Left by a previous run */
+    int fd = shm_open(page_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(PrkTpPage)) != 0)             /* Sparse: rings use memory once written */
+    {
+        perror(page_name);
+        if (fd >= 0)
+        {
+            close(fd);
+            shm_unlink(page_name);
+        }
+        page_name[0] = '\0';
+        return -1;
+    }
+
+    PrkTpPage *shared = mmap(NULL, sizeof(PrkTpPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED)
+    {
+        perror("mmap");
+        shm_unlink(page_name);
+        page_name[0] = '\0';
+        return -1;
+    }
+
+    shared->format = PRK_TP_FORMAT;
+    shared->pid    = (int32_t)getpid();
+#if defined(__x86_64__) || defined(__i386__)
+    shared->ticks_are_ns = 0;
+#else
+    shared->ticks_are_ns = 1;
+#endif
+    shared->open_ticks = prk_tp_ticks();
+    shared->open_ns    = monotonic_ns();
+    snprintf(shared->stage, sizeof(shared->stage), "%s", stage);
+    atomic_thread_fence(memory_order_release);
+    shared->magic = PRK_TP_MAGIC;
+    page = shared;
+    return 0;
+}
+
+/**
+ * prk_tp_close - Remove the tracepoint page of this stage.
+ */
+void prk_tp_close(void)
+{
+    if (page_name[0])
+    {
+        shm_unlink(page_name);
+        page_name[0] = '\0';
+    }
+}
+
+/**
+ * release_ring - Hand the ring of an exiting thread back.
+ */
+static void release_ring(void *ring)
+{
+    atomic_store_explicit(&((PrkTpRing *)ring)->owner, 0, memory_order_release);
+}
+
+/**
+ * create_ring_key - Key whose destructor hands rings back.
+ */
+static void create_ring_key(void)
+{
+    pthread_key_create(&ring_key, release_ring);
+}
+
+/**
+ * prk_tp_attach - Give the calling thread a ring.
+ */
+PrkTpRing *prk_tp_attach(void)
+{
+    if (!page)
+    {
+        return &discard_ring;                                        /* Not cached: a ring once the page is open */
+    }
+    if (prk_tp_tid == 0)
+    {
+        prk_tp_tid = (int32_t)syscall(SYS_gettid);
+    }
+
+    pthread_once(&ring_key_once, create_ring_key);
+    for (int r = 0; r < PRK_TP_RINGS; r++)
+    {
+        int32_t free_owner = 0;
+        if (atomic_compare_exchange_strong(&page->rings[r].owner, &free_owner, prk_tp_tid))
+        {
+            pthread_setspecific(ring_key, &page->rings[r]);
+            prk_tp_ring = &page->rings[r];
+            return prk_tp_ring;
+        }
+    }
+
+    atomic_fetch_add_explicit(&page->lost_threads, 1, memory_order_relaxed);
+    prk_tp_ring = &discard_ring;
+    return prk_tp_ring;
+}
+
+/**
+ * prk_tp_event_name - Name of an event, and of its arguments.
+ */
+const char *prk_tp_event_name(uint32_t event, int arg)
+{
+    if (event >= PRK_TP_EVENT_COUNT || arg < -1 || arg > 1)
+    {
+        return NULL;
+    }
+    return event_names[event][arg + 1];
+}
+
+/**
+ * prk_tp_map - Map the tracepoint page of a stage read-only.
+ */
+const PrkTpPage *prk_tp_map(const char *stage)
+{
+    char        name[sizeof(page_name)];
+    struct stat st;
+
+    snprintf(name, sizeof(name), PRK_TP_PREFIX "%s", stage);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t)sizeof(PrkTpPage))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    const PrkTpPage *mapped = mmap(NULL, sizeof(PrkTpPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (mapped->magic != PRK_TP_MAGIC || mapped->format != PRK_TP_FORMAT)
+    {
+        prk_tp_unmap(mapped);
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return mapped;
+}
+
+/**
+ * prk_tp_copy_ring - Copy the events a ring still holds.
+ */
+size_t prk_tp_copy_ring(const PrkTpRing *ring, PrkTpEvent *events)
+{
+    uint64_t head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = head > PRK_TP_RING_EVENTS ? head - PRK_TP_RING_EVENTS : 0;
+
+    for (uint64_t i = first; i < head; i++)
+    {
+        events[i - first] = ring->events[i & (PRK_TP_RING_EVENTS - 1)];
+    }
+
+    /* Events the owner may have rewritten during the copy, the one at the new head included */
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t now   = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t valid = now >= PRK_TP_RING_EVENTS ? now - PRK_TP_RING_EVENTS + 1 : 0;
+    if (valid <= first)
+    {
+        return (size_t)(head - first);
+    }
+    if (valid >= head)
+    {
+        return 0;
+    }
+    memmove(events, events + (valid - first), (size_t)(head - valid) * sizeof(*events));
+    return (size_t)(head - valid);
+}
+
+/**
+ * prk_tp_unmap - Unmap a page returned by prk_tp_map().
+ */
+void prk_tp_unmap(const PrkTpPage *mapped)
+{
+    munmap((void *)mapped, sizeof(PrkTpPage));
+}
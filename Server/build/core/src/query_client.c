@@ -0,0 +1,139 @@
+/**
+ * query_client.c: Blocking client helpers for the query service
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/query_client.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+
+/**
+ * read_full - Read exactly @size bytes.
+ */
+static int read_full(int fd, void *buf, size_t size)
+{
+    uint8_t *p = buf;
+
+    while (size > 0)
+    {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n > 0)
+        {
+            p    += n;
+            size -= (size_t)n;
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * query_client_connect - Connect to the query service.
+ */
+int query_client_connect(const char *path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * query_client_send - Send one request without waiting for its response.
+ */
+int query_client_send(int fd, uint16_t op, uint32_t tag, const uint64_t *keys, uint32_t count)
+{
+    if (count > QUERY_MAX_KEYS)
+    {
+        return -1;
+    }
+
+    QueryHeader header =
+    {
+        .len   = (uint32_t)(sizeof(QueryHeader) + count * sizeof(uint64_t)),
+        .op    = op,
+        .tag   = tag,
+        .count = count,
+    };
+    struct iovec    iov[2] = { { &header, sizeof(header) }, { (void *)keys, count * sizeof(uint64_t) } };
+    struct msghdr   msg    = { .msg_iov = iov, .msg_iovlen = count ? 2 : 1 };
+    size_t          left   = header.len;
+
+    while (left > 0)
+    {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return -1;
+        }
+
+        /* Short write: skip what went out */
+        left -= (size_t)n;
+        while (n > 0 && msg.msg_iovlen > 0)
+        {
+            if ((size_t)n >= msg.msg_iov->iov_len)
+            {
+                n -= (ssize_t)msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+            else
+            {
+                msg.msg_iov->iov_base  = (uint8_t *)msg.msg_iov->iov_base + n;
+                msg.msg_iov->iov_len  -= (size_t)n;
+                n = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * query_client_recv - Read the next response.
+ */
+int query_client_recv(int fd, QueryHeader *header, void *records)
+{
+    if (read_full(fd, header, sizeof(*header)) != 0 || header->len < sizeof(*header) ||
+        header->len > QUERY_MAX_RESPONSE)
+    {
+        return -1;
+    }
+    return read_full(fd, records, header->len - sizeof(*header));
+}
@@ -0,0 +1,139 @@
+/**
+ * query_daemon.c: Occupancy query service over a unix socket
+ *
+ * Serves the current state of every sensor and the occupancy of every zone
+ * to local consumers, so they do not open prksys_db.db and contend with the
+ * inserter's locks. The state lives in memory (see query_service.c): it is
+ * loaded from Sensor_State once and then follows the updates the inserter
+ * sends to QUERY_FEED_PATH. Clients use the binary protocol of
+ * query_proto.h on QUERY_SOCKET_PATH (helpers in query_client.h).
+ *
+ * Compilation:
+ *   gcc query_daemon.c query_service.c zone_map.c point_in_polygon.c sensor_parser.c prk_db.c \
+ *          -o out_query_daemon -lsqlite3 -lm
+ *
+ * Usage:
+ *   ./out_query_daemon
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            readiness notification to prk_sys_srv_run
+ *
+ */
+
+#include "../inc/query_daemon.h"
+#include "../inc/query_service.h"
+#include "../inc/zone_map.h"
+#include "../inc/prk_db.h"
+#include "../inc/prk_notify.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+static QueryService service;                                         /* Sensor and zone state */
+
+
+/**
+ * stop_handler - SIGINT/SIGTERM handler stopping the service loop.
+ */
+void stop_handler(int signum)
+{
+    (void)signum;
+    query_service_stop(&service);
+}
+
+/**
+ * bind_socket - Create a non-blocking unix socket bound to @path.
+ *
+ * A stale socket file left by a previous run is replaced.
+ */
+static int bind_socket(int type, const char *path)
+{
+    int fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || (type == SOCK_STREAM && listen(fd, 64) != 0))
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * main - Entry point of the program
+ *
+ * Loads the zones and the latest sensor states, binds the client and feed
+ * sockets and serves queries until SIGINT or SIGTERM.
+ *
+ * Return: 0 on success, 1 on failure
+ */
+int main(void)
+{
+    ZoneMap zones;
+
+    /* The only database access: zones and latest states */
+    sqlite3 *db = prk_db_open(DB_PATH);
+    if (!db || prk_db_create_schema(db) != 0 || zone_map_load(&zones, db) != 0)
+    {
+        prk_db_close(db);
+        return 1;
+    }
+    if (query_service_init(&service, &zones) != 0 || query_service_load(&service, db) != 0)
+    {
+        zone_map_free(&zones);
+        prk_db_close(db);
+        return 1;
+    }
+    prk_db_close(db);
+
+    int listen_fd = bind_socket(SOCK_STREAM, QUERY_SOCKET_PATH);
+    int feed_fd   = bind_socket(SOCK_DGRAM, QUERY_FEED_PATH);
+    if (listen_fd < 0 || feed_fd < 0)
+    {
+        query_service_free(&service);
+        zone_map_free(&zones);
+        return 1;
+    }
+
+    /* Let the feed queue absorb ingest bursts */
+    int size = 4 * 1024 * 1024;
+    setsockopt(feed_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    printf("Serving %zu zones on %s, feed on %s\n", zones.count, QUERY_SOCKET_PATH, QUERY_FEED_PATH);
+    fflush(stdout);
+    prk_notify_ready();
+    int rc = query_service_run(&service, listen_fd, feed_fd);
+
+    printf("Answered %llu requests, applied %llu updates\n", (unsigned long long)service.requests,
+           (unsigned long long)service.updates);
+
+    close(listen_fd);
+    close(feed_fd);
+    unlink(QUERY_SOCKET_PATH);
+    unlink(QUERY_FEED_PATH);
+    query_service_free(&service);
+    zone_map_free(&zones);
+
+    return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+/**
+ * query_feed.c: State updates from the inserter to the query service
+ *
+ * Batches the latest state of the sensors the inserter stored and sends
+ * it to out_query_daemon as unix datagrams once the batch is committed.
+ * Sending never blocks and a missing service only costs a failed send per
+ * datagram.
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            send only after the commit, discard on rollback
+ *
+ */
+
+#include "../inc/query_feed.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/**
+ * monotonic_ms - CLOCK_MONOTONIC in milliseconds.
+ */
+static int64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * feed_connect - Connect to the service socket, at most once per QUERY_FEED_RETRY_MS.
+ */
+static int feed_connect(QueryFeed *feed)
+{
+    int64_t now = monotonic_ms();
+    if (now < feed->retry_ms)
+    {
+        return -1;
+    }
+    feed->retry_ms = now + QUERY_FEED_RETRY_MS;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", feed->path);
+    if (connect(feed->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        return -1;
+    }
+
+    feed->connected = 1;
+    return 0;
+}
+
+
+/**
+ * query_feed_open - Create the feed socket.
+ */
+int query_feed_open(QueryFeed *feed, const char *path)
+{
+    memset(feed, 0, sizeof(*feed));
+    feed->path = path;
+    feed->fd   = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (feed->fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    feed_connect(feed);
+    return 0;
+}
+
+/**
+ * query_feed_add - Queue the new state of a sensor.
+ */
+void query_feed_add(QueryFeed *feed, const StoredReading *reading, uint64_t mac)
+{
+    if (feed->queued_count == feed->queued_capacity)
+    {
+        size_t          capacity = feed->queued_capacity ? feed->queued_capacity * 2 : QUERY_FEED_BATCH;
+        QueryFeedRecord *queued  = realloc(feed->queued, capacity * sizeof(QueryFeedRecord));
+        if (!queued)
+        {
+            feed->dropped++;
+            return;
+        }
+        feed->queued          = queued;
+        feed->queued_capacity = capacity;
+    }
+
+    QueryFeedRecord *record = &feed->queued[feed->queued_count++];
+    record->sensor_id = reading->sensor_id;
+    record->mac       = mac;
+    record->recv_time = reading->recv_time;
+    record->x         = reading->x;
+    record->y         = reading->y;
+    record->z         = reading->z;
+    record->status    = reading->status;
+}
+
+/**
+ * send_batch - Send @count queued updates, starting at @first, as one datagram.
+ */
+static void send_batch(QueryFeed *feed, size_t first, uint32_t count)
+{
+    if (!feed->connected && feed_connect(feed) != 0)
+    {
+        feed->dropped += count;
+        return;
+    }
+
+    feed->batch.count = count;
+    memcpy(feed->batch.records, feed->queued + first, count * sizeof(QueryFeedRecord));
+
+    size_t  size = offsetof(QueryFeedBatch, records) + count * sizeof(QueryFeedRecord);
+    ssize_t sent = send(feed->fd, &feed->batch, size, MSG_NOSIGNAL);
+    if (sent == (ssize_t)size)
+    {
+        feed->sent += count;
+        return;
+    }
+
+    feed->dropped += count;
+    if (errno == ECONNREFUSED || errno == ENOENT || errno == ENOTCONN)
+    {
+        /* Service restarted or stopped: a new socket reconnects to the new one */
+        int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd >= 0)
+        {
+            close(feed->fd);
+            feed->fd = fd;
+        }
+        feed->connected = 0;
+    }
+}
+
+/**
+ * query_feed_flush - Send the queued updates.
+ */
+void query_feed_flush(QueryFeed *feed)
+{
+    for (size_t first = 0; first < feed->queued_count; first += QUERY_FEED_BATCH)
+    {
+        size_t left = feed->queued_count - first;
+        send_batch(feed, first, (uint32_t)(left < QUERY_FEED_BATCH ? left : QUERY_FEED_BATCH));
+    }
+    feed->queued_count = 0;
+}
+
+/**
+ * query_feed_discard - Drop the queued updates of a batch that was rolled back.
+ */
+void query_feed_discard(QueryFeed *feed)
+{
+    feed->queued_count = 0;
+}
+
+/**
+ * query_feed_close - Close the feed socket.
+ */
+void query_feed_close(QueryFeed *feed)
+{
+    query_feed_flush(feed);
+    if (feed->fd >= 0)
+    {
+        close(feed->fd);
+    }
+    feed->fd = -1;
+    free(feed->queued);
+    feed->queued          = NULL;
+    feed->queued_capacity = 0;
+}
@@ -0,0 +1,714 @@
+/**
+ * query_service.c: In-memory occupancy state served over a unix socket
+ *
+ * Holds the current state of every sensor and the occupancy of every zone,
+ * seeded once from Sensor_State and then kept current by the inserter's
+ * feed. Clients ask for sensors by id or MAC and for zones by id with the
+ * binary protocol of query_proto.h; lookups are array indexing or one hash
+ * probe, with no SQLite and no allocation on the read path.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#define _GNU_SOURCE                                                  /* accept4 */
+#include "../inc/query_service.h"
+#include "../inc/occupancy_rollup.h"
+#include "../inc/sensor_parser.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+
+#define QUERY_MAC_INITIAL_SLOTS 1024                                 /* Power of two */
+#define QUERY_EPOLL_EVENTS     64                                    /* Events per epoll_wait() */
+#define QUERY_EPOLL_TIMEOUT_MS 500                                   /* Bounds the reaction to stop */
+
+
+/* One client connection */
+typedef struct
+{
+    int       fd;
+    size_t    slot;                                                  /* Index in the client table */
+    size_t    in_len;                                                /* Buffered request bytes */
+    size_t    out_off;                                               /* Response bytes already written */
+    size_t    out_len;                                               /* Response bytes buffered */
+    int       want_write;                                            /* Registered for EPOLLOUT */
+    uint64_t  in[QUERY_MAX_REQUEST / sizeof(uint64_t) * 2];          /* Two requests, 8 byte aligned */
+    uint8_t   out[QUERY_OUT_BUFFER];
+} QueryClient;
+
+/* Tags of the non-client descriptors in epoll_event.data.ptr */
+static char listen_tag;
+static char feed_tag;
+
+
+/**
+ * mac_hash - Mix the MAC bits so consecutive addresses spread over the table.
+ */
+static inline size_t mac_hash(uint64_t mac)
+{
+    mac ^= mac >> 33;
+    mac *= 0xff51afd7ed558ccdULL;
+    mac ^= mac >> 33;
+    return (size_t)mac;
+}
+
+/**
+ * mac_find - Slot holding @mac, or the empty slot where it belongs.
+ */
+static ServiceMacSlot *mac_find(ServiceMacSlot *slots, size_t capacity, uint64_t mac)
+{
+    size_t i = mac_hash(mac) & (capacity - 1);
+
+    while (slots[i].id != 0 && slots[i].mac != mac)
+    {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &slots[i];
+}
+
+/**
+ * mac_put - Map @mac to @id, growing the table at half load.
+ */
+static int mac_put(QueryService *service, uint64_t mac, int64_t id)
+{
+    if ((service->mac_count + 1) * 2 > service->mac_capacity)
+    {
+        size_t          capacity = service->mac_capacity * 2;
+        ServiceMacSlot  *slots   = calloc(capacity, sizeof(ServiceMacSlot));
+        if (!slots)
+        {
+            perror("calloc");
+            return -1;
+        }
+        for (size_t i = 0; i < service->mac_capacity; i++)
+        {
+            if (service->macs[i].id != 0)
+            {
+                *mac_find(slots, capacity, service->macs[i].mac) = service->macs[i];
+            }
+        }
+        free(service->macs);
+        service->macs         = slots;
+        service->mac_capacity = capacity;
+    }
+
+    ServiceMacSlot *slot = mac_find(service->macs, service->mac_capacity, mac);
+    if (slot->id == 0)
+    {
+        service->mac_count++;
+    }
+    slot->mac = mac;
+    slot->id  = id;
+    return 0;
+}
+
+/**
+ * sensor_entry - Entry for @sensor_id, growing the table when needed.
+ */
+static ServiceSensor *sensor_entry(QueryService *service, int64_t sensor_id)
+{
+    if (sensor_id <= 0)
+    {
+        return NULL;
+    }
+
+    if ((size_t)sensor_id >= service->sensor_capacity)
+    {
+        size_t capacity = service->sensor_capacity ? service->sensor_capacity : 1024;
+        while (capacity <= (size_t)sensor_id)
+        {
+            capacity *= 2;
+        }
+
+        ServiceSensor *sensors = realloc(service->sensors, capacity * sizeof(ServiceSensor));
+        if (!sensors)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        memset(sensors + service->sensor_capacity, 0, (capacity - service->sensor_capacity) * sizeof(ServiceSensor));
+        service->sensors         = sensors;
+        service->sensor_capacity = capacity;
+    }
+
+    return &service->sensors[sensor_id];
+}
+
+/**
+ * zone_entry - Counters of @zone_id, NULL for an id outside the zone table.
+ */
+static ServiceZone *zone_entry(QueryService *service, int64_t zone_id)
+{
+    return (zone_id >= 0 && (uint64_t)zone_id < service->zone_capacity) ? &service->zone_state[zone_id] : NULL;
+}
+
+
+/**
+ * query_service_init - Create an empty service.
+ */
+int query_service_init(QueryService *service, const ZoneMap *zones)
+{
+    memset(service, 0, sizeof(*service));
+    service->zones = zones;
+
+    int64_t max_id = 0;
+    for (size_t i = 0; i < zones->count; i++)
+    {
+        if (zones->zones[i].id > max_id)
+        {
+            max_id = zones->zones[i].id;
+        }
+    }
+
+    service->zone_capacity = (size_t)max_id + 1;
+    service->zone_state    = calloc(service->zone_capacity, sizeof(ServiceZone));
+    service->mac_capacity  = QUERY_MAC_INITIAL_SLOTS;
+    service->macs          = calloc(service->mac_capacity, sizeof(ServiceMacSlot));
+    if (!service->zone_state || !service->macs)
+    {
+        perror("calloc");
+        query_service_free(service);
+        return -1;
+    }
+
+    for (size_t i = 0; i < zones->count; i++)
+    {
+        service->zone_state[zones->zones[i].id].exists = 1;
+    }
+    return 0;
+}
+
+/**
+ * query_service_load - Seed the state from Sensors and Sensor_State.
+ */
+int query_service_load(QueryService *service, sqlite3 *db)
+{
+    sqlite3_stmt *stmt = prk_db_prepare(db, "SELECT s.id, s.mac_address, st.status, st.x, st.y, st.z, st.last_seen "
+                                            "FROM Sensors s LEFT JOIN Sensor_State st ON st.sensor_id = s.id;");
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    int rc = 0;
+    while (rc == 0 && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char  *text = (const char *)sqlite3_column_text(stmt, 1);
+        uint64_t    mac   = 0;
+        if (!text || parse_mac(text, &mac) != 0)
+        {
+            continue;                                                /* Not a sensor the inserter could have made */
+        }
+
+        QueryFeedRecord record =
+        {
+            .sensor_id = sqlite3_column_int64(stmt, 0),
+            .mac       = mac,
+        };
+        if (sqlite3_column_type(stmt, 2) != SQLITE_NULL)
+        {
+            const unsigned char *status = sqlite3_column_text(stmt, 2);
+            record.status    = status ? (char)status[0] : '\0';
+            record.x         = (int32_t)lround(sqlite3_column_double(stmt, 3) * COORD_SCALE);
+            record.y         = (int32_t)lround(sqlite3_column_double(stmt, 4) * COORD_SCALE);
+            record.z         = (int32_t)lround(sqlite3_column_double(stmt, 5) * COORD_SCALE);
+            record.recv_time = sqlite3_column_int64(stmt, 6);
+            rc = query_service_apply(service, &record);
+        }
+        else
+        {
+            ServiceSensor *sensor = sensor_entry(service, record.sensor_id);
+            rc = (sensor && mac_put(service, mac, record.sensor_id) == 0) ? 0 : -1;
+            if (sensor)
+            {
+                sensor->mac = mac;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    service->updates = 0;
+
+    return rc;
+}
+
+/**
+ * query_service_apply - Apply one state update.
+ */
+int query_service_apply(QueryService *service, const QueryFeedRecord *record)
+{
+    ServiceSensor *sensor = sensor_entry(service, record->sensor_id);
+    if (!sensor)
+    {
+        return -1;
+    }
+    if (sensor->mac != record->mac && record->mac != 0)
+    {
+        if (mac_put(service, record->mac, record->sensor_id) != 0)
+        {
+            return -1;
+        }
+        sensor->mac = record->mac;
+    }
+    if (sensor->positioned && record->recv_time < sensor->last_seen)
+    {
+        return 0;                                                    /* Older than what we hold */
+    }
+
+    int64_t zone_id = zone_map_lookup(service->zones, record->x, record->y);
+    int     parked  = (record->status == ROLLUP_PARKED_STATUS);
+
+    /* Leave the old zone, enter the new one */
+    if (sensor->positioned)
+    {
+        ServiceZone *old = zone_entry(service, sensor->zone_id);
+        if (old)
+        {
+            old->sensors--;
+            old->parked -= (sensor->status == ROLLUP_PARKED_STATUS);
+            old->last_update = record->recv_time;
+        }
+    }
+    ServiceZone *zone = zone_entry(service, zone_id);
+    if (zone)
+    {
+        zone->sensors++;
+        zone->parked     += parked;
+        zone->last_update = record->recv_time;
+    }
+
+    sensor->last_seen  = record->recv_time;
+    sensor->zone_id    = zone_id;
+    sensor->x          = record->x;
+    sensor->y          = record->y;
+    sensor->z          = record->z;
+    sensor->status     = record->status;
+    sensor->positioned = 1;
+    service->updates++;
+    return 0;
+}
+
+/**
+ * fill_sensor - Response record of @sensor_id (0 if not found).
+ */
+static void fill_sensor(const QueryService *service, int64_t sensor_id, QuerySensor *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->sensor_id = sensor_id;
+    if (sensor_id <= 0 || (uint64_t)sensor_id >= service->sensor_capacity)
+    {
+        return;
+    }
+
+    const ServiceSensor *sensor = &service->sensors[sensor_id];
+    if (sensor->mac == 0 && !sensor->positioned)
+    {
+        return;
+    }
+    out->mac       = sensor->mac;
+    out->last_seen = sensor->last_seen;
+    out->zone_id   = sensor->zone_id;
+    out->x         = sensor->x;
+    out->y         = sensor->y;
+    out->z         = sensor->z;
+    out->status    = sensor->status;
+    out->found     = 1;
+}
+
+/**
+ * fill_zone - Response record of @zone_id.
+ */
+static void fill_zone(const QueryService *service, int64_t zone_id, QueryZone *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->zone_id = zone_id;
+    if (zone_id <= 0 || (uint64_t)zone_id >= service->zone_capacity || !service->zone_state[zone_id].exists)
+    {
+        return;
+    }
+
+    const ServiceZone *zone = &service->zone_state[zone_id];
+    out->sensors     = zone->sensors;
+    out->parked      = zone->parked;
+    out->last_update = zone->last_update;
+    out->found       = 1;
+}
+
+/**
+ * query_service_answer - Answer one request.
+ */
+size_t query_service_answer(QueryService *service, const QueryHeader *request, const uint64_t *keys, uint8_t *out)
+{
+    QueryHeader *response = (QueryHeader *)out;
+    uint8_t     *record   = out + sizeof(QueryHeader);
+    uint32_t    count     = 0;
+
+    response->op     = request->op;
+    response->tag    = request->tag;
+    response->status = QST_OK;
+    service->requests++;
+
+    switch (request->op)
+    {
+    case QOP_SENSOR:
+        for (count = 0; count < request->count; count++)
+        {
+            fill_sensor(service, (int64_t)keys[count], (QuerySensor *)record + count);
+        }
+        record += count * sizeof(QuerySensor);
+        break;
+
+    case QOP_SENSOR_MAC:
+        for (count = 0; count < request->count; count++)
+        {
+            const ServiceMacSlot *slot = mac_find(service->macs, service->mac_capacity, keys[count]);
+            fill_sensor(service, slot->id, (QuerySensor *)record + count);
+            ((QuerySensor *)record)[count].mac = keys[count];
+        }
+        record += count * sizeof(QuerySensor);
+        break;
+
+    case QOP_ZONE:
+        for (count = 0; count < request->count; count++)
+        {
+            fill_zone(service, (int64_t)keys[count], (QueryZone *)record + count);
+        }
+        record += count * sizeof(QueryZone);
+        break;
+
+    case QOP_ZONE_LIST:
+        if (request->count != 1)
+        {
+            response->status = QST_BAD_REQUEST;
+            break;
+        }
+        for (uint64_t id = keys[0] ? keys[0] : 1; id < service->zone_capacity && count < QUERY_MAX_KEYS; id++)
+        {
+            if (service->zone_state[id].exists)
+            {
+                fill_zone(service, (int64_t)id, (QueryZone *)record + count++);
+            }
+        }
+        record += count * sizeof(QueryZone);
+        break;
+
+    default:
+        response->status = QST_BAD_REQUEST;
+        break;
+    }
+
+    response->count = count;
+    response->len   = (uint32_t)(record - out);
+    return response->len;
+}
+
+
+/**
+ * client_flush - Write buffered responses; returns -1 if the client is gone.
+ */
+static int client_flush(QueryClient *client)
+{
+    while (client->out_off < client->out_len)
+    {
+        ssize_t n = send(client->fd, client->out + client->out_off, client->out_len - client->out_off, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            client->out_off += (size_t)n;
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            return 0;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    client->out_off = 0;
+    client->out_len = 0;
+    return 0;
+}
+
+/**
+ * client_answer - Answer every complete buffered request that fits the output buffer.
+ *
+ * Return: 0, or -1 on a malformed request (framing is lost, drop the client).
+ */
+static int client_answer(QueryService *service, QueryClient *client)
+{
+    uint8_t *in  = (uint8_t *)client->in;
+    size_t  off  = 0;
+    int     rc   = 0;
+
+    while (client->in_len - off >= sizeof(QueryHeader))
+    {
+        QueryHeader header;
+        memcpy(&header, in + off, sizeof(header));
+        if (header.count > QUERY_MAX_KEYS || header.len != sizeof(QueryHeader) + header.count * sizeof(uint64_t))
+        {
+            rc = -1;
+            break;
+        }
+        if (client->in_len - off < header.len)
+        {
+            break;                                                   /* Rest of the request not read yet */
+        }
+
+        /* Compact the output buffer, then wait for the client if still full */
+        if (client->out_off > 0)
+        {
+            memmove(client->out, client->out + client->out_off, client->out_len - client->out_off);
+            client->out_len -= client->out_off;
+            client->out_off  = 0;
+        }
+        if (sizeof(client->out) - client->out_len < QUERY_MAX_RESPONSE)
+        {
+            break;
+        }
+
+        client->out_len += query_service_answer(service, &header, (const uint64_t *)(in + off + sizeof(header)),
+                                                client->out + client->out_len);
+        off += header.len;
+    }
+
+    memmove(in, in + off, client->in_len - off);
+    client->in_len -= off;
+    return rc;
+}
+
+/**
+ * client_close - Drop a client connection.
+ */
+static void client_close(int epoll_fd, QueryClient *client, QueryClient **clients)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    clients[client->slot] = NULL;
+    free(client);
+}
+
+/**
+ * client_serve - Read, answer and write for one readiness event.
+ *
+ * Return: 0 to keep the client, -1 to drop it.
+ */
+static int client_serve(QueryService *service, int epoll_fd, QueryClient *client)
+{
+    /* Read what fits; requests are answered in order even when pipelined */
+    int eof = 0;
+    while (client->in_len < sizeof(client->in))
+    {
+        ssize_t n = recv(client->fd, (uint8_t *)client->in + client->in_len, sizeof(client->in) - client->in_len, 0);
+        if (n > 0)
+        {
+            client->in_len += (size_t)n;
+            if (client_answer(service, client) != 0)
+            {
+                return -1;
+            }
+        }
+        else if (n == 0)
+        {
+            eof = 1;
+            break;
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno == EAGAIN)
+        {
+            break;
+        }
+        else
+        {
+            return -1;
+        }
+
+        if (client->out_len > 0 && client_flush(client) != 0)
+        {
+            return -1;
+        }
+        if (client->out_len > 0)
+        {
+            break;                                                   /* Client is not reading, stop until it does */
+        }
+    }
+
+    /* Requests held back by a full output buffer */
+    if (client_answer(service, client) != 0 || client_flush(client) != 0)
+    {
+        return -1;
+    }
+    if (eof && client->out_len == 0)
+    {
+        return -1;
+    }
+
+    /* Watch for writability only while responses are pending */
+    int want_write = client->out_len > 0;
+    if (want_write != client->want_write)
+    {
+        struct epoll_event event =
+        {
+            .events   = want_write ? EPOLLOUT : EPOLLIN,
+            .data.ptr = client,
+        };
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+        client->want_write = want_write;
+    }
+    return 0;
+}
+
+/**
+ * feed_drain - Apply every queued feed datagram.
+ */
+static void feed_drain(QueryService *service, int feed_fd)
+{
+    static QueryFeedBatch batch;
+
+    while (1)
+    {
+        ssize_t n = recv(feed_fd, &batch, sizeof(batch), MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;                                                  /* EAGAIN: queue empty */
+        }
+        if ((size_t)n < offsetof(QueryFeedBatch, records) || batch.count > QUERY_FEED_BATCH ||
+            (size_t)n < offsetof(QueryFeedBatch, records) + batch.count * sizeof(QueryFeedRecord))
+        {
+            continue;                                                /* Not a feed batch */
+        }
+        for (uint32_t i = 0; i < batch.count; i++)
+        {
+            query_service_apply(service, &batch.records[i]);
+        }
+    }
+}
+
+/**
+ * query_service_run - Serve clients and apply the feed until stopped.
+ */
+int query_service_run(QueryService *service, int listen_fd, int feed_fd)
+{
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = &listen_tag };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    if (feed_fd >= 0)
+    {
+        event.data.ptr = &feed_tag;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, feed_fd, &event);
+    }
+
+    static QueryClient  *clients[QUERY_MAX_CLIENTS];
+    struct epoll_event  events[QUERY_EPOLL_EVENTS];
+    while (!service->stop)
+    {
+        int ready = epoll_wait(epoll_fd, events, QUERY_EPOLL_EVENTS, QUERY_EPOLL_TIMEOUT_MS);
+        if (ready < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < ready; i++)
+        {
+            if (events[i].data.ptr == &feed_tag)
+            {
+                feed_drain(service, feed_fd);
+            }
+            else if (events[i].data.ptr == &listen_tag)
+            {
+                int fd;
+                while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    size_t slot = 0;
+                    while (slot < QUERY_MAX_CLIENTS && clients[slot])
+                    {
+                        slot++;
+                    }
+
+                    QueryClient *client = (slot < QUERY_MAX_CLIENTS) ? malloc(sizeof(QueryClient)) : NULL;
+                    if (!client)
+                    {
+                        close(fd);                                   /* Over the limit */
+                        continue;
+                    }
+                    client->fd         = fd;
+                    client->slot       = slot;
+                    client->in_len     = 0;
+                    client->out_off    = 0;
+                    client->out_len    = 0;
+                    client->want_write = 0;
+                    clients[slot]      = client;
+
+                    struct epoll_event client_event = { .events = EPOLLIN, .data.ptr = client };
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &client_event);
+                }
+            }
+            else
+            {
+                QueryClient *client = events[i].data.ptr;
+                if (client_serve(service, epoll_fd, client) != 0)
+                {
+                    client_close(epoll_fd, client, clients);
+                }
+            }
+        }
+    }
+
+    for (size_t slot = 0; slot < QUERY_MAX_CLIENTS; slot++)
+    {
+        if (clients[slot])
+        {
+            client_close(epoll_fd, clients[slot], clients);
+        }
+    }
+    close(epoll_fd);
+    return 0;
+}
+
+/**
+ * query_service_stop - Make query_service_run() return (async-signal-safe).
+ */
+void query_service_stop(QueryService *service)
+{
+    service->stop = 1;
+}
+
+/**
+ * query_service_free - Release the state.
+ */
+void query_service_free(QueryService *service)
+{
+    free(service->sensors);
+    free(service->macs);
+    free(service->zone_state);
+    memset(service, 0, sizeof(*service));
+}
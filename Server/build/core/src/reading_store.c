@@ -0,0 +1,262 @@
+/**
+ * reading_store.c: Storage backend selection and the SQLite backend
+ *
+ * out_insert_data_from_giis_shm writes readings through the ReadingStore
+ * interface so it can target either the Customer_Data table (this file) or
+ * the native time-series engine (store_tsdb.c).
+ *
+ * Version: v1.3
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            assign Customer_Data.id (WITHOUT ROWID table)
+ *   19-10-2026       Morris              v1.2            route inserts and prune queries by time partition
+ *   19-10-2026       Morris              v1.3            forget the partitions of a rolled back batch
+ *
+ */
+
+#include "../inc/reading_store.h"
+#include "../inc/sensor_parser.h"
+#include "../inc/partition_router.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* State of the SQLite backend */
+typedef struct
+{
+    sqlite3         *db;                                             /* Shared connection (not owned) */
+    PartitionRouter router;                                          /* Customer_Data time partitions */
+    int64_t         next_id;                                         /* Customer_Data.id of the next reading */
+} SqliteStore;
+
+
+/**
+ * to_fixed - Convert a stored REAL coordinate back to fixed point.
+ */
+static inline int32_t to_fixed(double value)
+{
+    value *= COORD_SCALE;
+    return (int32_t)(value >= 0 ? value + 0.5 : value - 0.5);
+}
+
+/**
+ * sqlite_append - Insert one reading into its Customer_Data partition.
+ */
+static int sqlite_append(void *impl, const StoredReading *reading)
+{
+    SqliteStore *store = impl;
+    Partition   *part  = partition_router_route(&store->router, reading->recv_time);
+    if (!part)
+    {
+        return -1;
+    }
+
+    sqlite3_stmt *stmt = part->insert_stmt;
+    sqlite3_bind_int64(stmt, 1, reading->sensor_id);
+    sqlite3_bind_int64(stmt, 2, reading->recv_time);
+    sqlite3_bind_int64(stmt, 3, store->next_id);
+    sqlite3_bind_text(stmt, 4, &reading->status, 1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(stmt, 5, reading->x / (double)COORD_SCALE);
+    sqlite3_bind_double(stmt, 6, reading->y / (double)COORD_SCALE);
+    sqlite3_bind_double(stmt, 7, reading->z / (double)COORD_SCALE);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Error inserting reading: %s\n", sqlite3_errmsg(store->db));
+        return -1;
+    }
+
+    store->next_id++;
+    return 0;
+}
+
+/**
+ * sqlite_flush - Nothing buffered; the caller's transaction committed the
+ *                rows and the partitions they went to.
+ */
+static int sqlite_flush(void *impl)
+{
+    SqliteStore *store = impl;
+
+    partition_router_batch_done(&store->router);
+    return 0;
+}
+
+/**
+ * sqlite_discard - The ROLLBACK dropped the rows; forget the partitions
+ *                  created (or dropped) with them.
+ */
+static void sqlite_discard(void *impl)
+{
+    SqliteStore *store = impl;
+
+    partition_router_rollback(&store->router);
+}
+
+/**
+ * sqlite_query - Range query over the partitions overlapping [@from, @to).
+ *
+ * Each partition is a range scan of its clustered primary key; partitions
+ * outside the range are not touched.
+ */
+static long sqlite_query(void *impl, int64_t sensor_id, int64_t from, int64_t to,
+                         reading_visitor_t visitor, void *ctx)
+{
+    SqliteStore *store = impl;
+    long        count  = 0;
+    size_t      first;
+    size_t      candidates = partition_router_find(&store->router, from, to, &first);
+
+    for (size_t i = first; i < first + candidates; i++)
+    {
+        Partition *part = &store->router.parts[i];
+        if (part->end_ms <= from || part->start_ms >= to)
+        {
+            continue;
+        }
+
+        if (!part->query_stmt)
+        {
+            char *sql = sqlite3_mprintf("SELECT recv_time, status, x, y, z FROM \"%w\" "
+                                        "WHERE sensor_id = ? AND recv_time >= ? AND recv_time < ? "
+                                        "ORDER BY recv_time;", part->name);
+            part->query_stmt = sql ? prk_db_prepare(store->db, sql) : NULL;
+            sqlite3_free(sql);
+            if (!part->query_stmt)
+            {
+                return -1;
+            }
+        }
+
+        sqlite3_stmt *stmt = part->query_stmt;
+        sqlite3_bind_int64(stmt, 1, sensor_id);
+        sqlite3_bind_int64(stmt, 2, from);
+        sqlite3_bind_int64(stmt, 3, to);
+
+        int stop = 0;
+        while (!stop && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const unsigned char *status = sqlite3_column_text(stmt, 1);
+            StoredReading reading =
+            {
+                .sensor_id = sensor_id,
+                .recv_time = sqlite3_column_int64(stmt, 0),
+                .status    = status ? (char)status[0] : '?',
+                .x         = to_fixed(sqlite3_column_double(stmt, 2)),
+                .y         = to_fixed(sqlite3_column_double(stmt, 3)),
+                .z         = to_fixed(sqlite3_column_double(stmt, 4)),
+            };
+            count++;
+            stop = visitor && visitor(&reading, ctx) != 0;
+        }
+        sqlite3_reset(stmt);
+
+        if (stop)
+        {
+            break;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * sqlite_close - Finalize the statements (the connection belongs to the caller).
+ */
+static void sqlite_close(void *impl)
+{
+    SqliteStore *store = impl;
+
+    partition_router_free(&store->router);
+    free(store);
+}
+
+static const ReadingStoreOps sqlite_ops =
+{
+    .append  = sqlite_append,
+    .flush   = sqlite_flush,
+    .discard = sqlite_discard,
+    .query   = sqlite_query,
+    .compact = NULL,
+    .close   = sqlite_close,
+};
+
+
+/**
+ * store_sqlite_open - Backend writing the Customer_Data partitions through @db.
+ */
+int store_sqlite_open(sqlite3 *db, ReadingStore *store)
+{
+    SqliteStore *impl = calloc(1, sizeof(SqliteStore));
+    if (!impl)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    impl->db = db;
+    if (partition_router_init(&impl->router, db) != 0)
+    {
+        free(impl);
+        return -1;
+    }
+
+    /* Partitions have no rowid to allocate ids: continue after the highest
+     * one (a scan of the newest non-empty partition, once at startup) */
+    impl->next_id = partition_router_max_id(&impl->router) + 1;
+
+    /* Retention also runs at startup, not only when a new period begins */
+    if (impl->router.retention_ms > 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        partition_router_expire(&impl->router, (int64_t)now.tv_sec * 1000 - impl->router.retention_ms);
+    }
+
+    store->name = STORE_BACKEND_SQLITE;
+    store->ops  = &sqlite_ops;
+    store->impl = impl;
+    return 0;
+}
+
+
+/**
+ * reading_store_open - Open a storage backend by name.
+ */
+int reading_store_open(const char *backend, sqlite3 *db, const char *dir, ReadingStore *store)
+{
+    memset(store, 0, sizeof(*store));
+
+    if (strcmp(backend, STORE_BACKEND_SQLITE) == 0)
+    {
+        return store_sqlite_open(db, store);
+    }
+    if (strcmp(backend, STORE_BACKEND_TSDB) == 0)
+    {
+        return store_tsdb_open(dir, store);
+    }
+
+    fprintf(stderr, "Unknown storage backend: %s\n", backend);
+    return -1;
+}
+
+/**
+ * reading_store_close - Flush and release a backend.
+ */
+void reading_store_close(ReadingStore *store)
+{
+    if (store->ops)
+    {
+        store->ops->flush(store->impl);
+        store->ops->close(store->impl);
+    }
+    memset(store, 0, sizeof(*store));
+}
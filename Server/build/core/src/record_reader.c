@@ -0,0 +1,146 @@
+/**
+ * record_reader.c: Buffered, newline framed record reader for FIFOs
+ *
+ * out_giis writes one record per write() terminated by RECORD_DELIMITER.
+ * This reader pulls the FIFO in chunks of up to RECORD_READER_CAPACITY bytes
+ * and hands every complete record in the chunk to a callback, keeping the
+ * trailing partial record for the next read. Several records per read() and
+ * records split across reads are both handled. out_server frames the lines
+ * of its client sockets with it as well. Delimiters are found with the
+ * SSE2/AVX2 scanner of sensor_parser.c.
+ *
+ * Usage:
+ *      RecordReader reader;
+ *      record_reader_init(&reader, fd);
+ *      while (record_reader_fill(&reader) > 0)
+ *          record_reader_drain(&reader, handler, ctx);
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            find delimiters with scan_delimiter()
+ *   19-10-2026       Morris              v1.2            return EINTR instead of retrying
+ *
+ */
+
+#include "../inc/record_reader.h"
+#include "../inc/sensor_parser.h"                                    /* scan_delimiter() */
+#include <string.h>
+#include <unistd.h>
+
+
+/**
+ * record_reader_init - Prepare a reader for the given descriptor.
+ */
+void record_reader_init(RecordReader *reader, int fd)
+{
+    reader->fd          = fd;
+    reader->head        = 0;
+    reader->tail        = 0;
+    reader->discarding  = 0;
+    reader->records     = 0;
+    reader->oversized   = 0;
+}
+
+
+/**
+ * record_reader_fill - Read as many bytes as fit into the free buffer space.
+ */
+ssize_t record_reader_fill(RecordReader *reader)
+{
+    /* Compact: move the partial record to the front of the buffer */
+    if (reader->head > 0)
+    {
+        size_t pending = reader->tail - reader->head;
+        memmove(reader->buf, reader->buf + reader->head, pending);
+        reader->head = 0;
+        reader->tail = pending;
+    }
+
+    /* Buffer full without a delimiter: the record can never fit, drop it */
+    if (reader->tail == RECORD_READER_CAPACITY)
+    {
+        if (!reader->discarding)
+        {
+            reader->oversized++;
+        }
+        reader->tail       = 0;
+        reader->discarding = 1;
+    }
+
+    /* EINTR goes back to the caller, whose signal handler may have asked it to stop */
+    ssize_t bytes_read = read(reader->fd, reader->buf + reader->tail, RECORD_READER_CAPACITY - reader->tail);
+
+    if (bytes_read > 0)
+    {
+        reader->tail += (size_t)bytes_read;
+    }
+
+    return bytes_read;
+}
+
+
+/**
+ * record_reader_drain - Deliver every complete record currently buffered.
+ */
+size_t record_reader_drain(RecordReader *reader, record_handler_t handler, void *ctx)
+{
+    size_t delivered = 0;
+
+    while (reader->head < reader->tail)
+    {
+        char *start = reader->buf + reader->head;
+        char *end   = (char *)scan_delimiter(start, reader->buf + reader->tail, RECORD_DELIMITER);
+        if (end == reader->buf + reader->tail)
+        {
+            break;                                                   /* Partial record, wait for more data */
+        }
+
+        size_t len   = (size_t)(end - start);
+        reader->head += len + 1;
+
+        if (reader->discarding)
+        {
+            reader->discarding = 0;                                  /* Tail of an oversized record */
+            continue;
+        }
+
+        /* Strip a CR so CRLF framed writers work as well */
+        if (len > 0 && start[len - 1] == '\r')
+        {
+            len--;
+        }
+        if (len == 0)
+        {
+            continue;                                                /* Skip empty records */
+        }
+
+        start[len] = '\0';
+        handler(start, len, ctx);
+        delivered++;
+    }
+
+    if (reader->head == reader->tail)
+    {
+        reader->head = 0;
+        reader->tail = 0;
+    }
+
+    reader->records += delivered;
+    return delivered;
+}
+
+
+/**
+ * record_reader_reset - Drop buffered bytes, e.g. after the writer went away.
+ */
+void record_reader_reset(RecordReader *reader, int fd)
+{
+    reader->fd          = fd;
+    reader->head        = 0;
+    reader->tail        = 0;
+    reader->discarding  = 0;
+}
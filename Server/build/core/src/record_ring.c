@@ -0,0 +1,202 @@
+/**
+ * record_ring.c: Queue of records from out_server to out_giis in shared memory
+ *
+ * out_server used to keep one record in its shared memory segment, which
+ * out_giis polled every 100 ms: a second record arriving in between
+ * overwrote the first, and no more than ten records a second got through.
+ * The segment now holds RECORD_RING_SLOTS records. out_server pushes each
+ * record and posts a process shared semaphore; out_giis sleeps on it and
+ * drains every record queued on each wakeup. A full ring makes out_server
+ * wait, so a stalled out_giis slows the clients down instead of losing
+ * their records.
+ *
+ * Usage:
+ *      RecordRing *ring = record_ring_attach();
+ *      while (record_ring_wait(ring) == 0)
+ *          record_ring_drain(ring, handler, ctx);
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/record_ring.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+
+
+/**
+ * attach_segment - Attach the segment @shm_id as a ring.
+ */
+static RecordRing *attach_segment(int shm_id)
+{
+    RecordRing *ring = shmat(shm_id, NULL, 0);
+    if (ring == (void *)-1)
+    {
+        perror("shmat");
+        return NULL;
+    }
+    return ring;
+}
+
+
+/**
+ * record_ring_create - Create the ring, or attach to the one a previous
+ *                      out_server left with its records still queued.
+ */
+RecordRing *record_ring_create(void)
+{
+    int shm_id = shmget(RECORD_RING_KEY, sizeof(RecordRing), 0666 | IPC_CREAT);
+    if (shm_id == -1 && errno == EINVAL)
+    {
+        /* A smaller segment of an older layout: replace it */
+        int old_id = shmget(RECORD_RING_KEY, 0, 0666);
+        if (old_id != -1 && shmctl(old_id, IPC_RMID, NULL) == 0)
+        {
+            printf("Replaced the shared memory segment of an older layout\n");
+            shm_id = shmget(RECORD_RING_KEY, sizeof(RecordRing), 0666 | IPC_CREAT);
+        }
+    }
+    if (shm_id == -1)
+    {
+        perror("shmget");
+        return NULL;
+    }
+
+    RecordRing *ring = attach_segment(shm_id);
+    if (ring && ring->magic != RECORD_RING_MAGIC)
+    {
+        /* A new segment is zeroed: set it up before out_giis attaches */
+        if (sem_init(&ring->pushed, 1, 0) == -1)
+        {
+            perror("sem_init");
+            shmdt(ring);
+            return NULL;
+        }
+        atomic_store(&ring->head, 0);
+        atomic_store(&ring->tail, 0);
+        ring->magic = RECORD_RING_MAGIC;
+    }
+    return ring;
+}
+
+
+/**
+ * record_ring_attach - Attach to the ring out_server created.
+ */
+RecordRing *record_ring_attach(void)
+{
+    int shm_id = shmget(RECORD_RING_KEY, sizeof(RecordRing), 0666);
+    if (shm_id == -1)
+    {
+        perror("shmget");
+        return NULL;
+    }
+
+    RecordRing *ring = attach_segment(shm_id);
+    if (ring && ring->magic != RECORD_RING_MAGIC)
+    {
+        fprintf(stderr, "Record ring not initialized, start out_server first\n");
+        shmdt(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+
+/**
+ * record_ring_detach - Detach from the ring, which stays for the other side.
+ */
+void record_ring_detach(RecordRing *ring)
+{
+    shmdt(ring);
+}
+
+
+/**
+ * record_ring_push - Queue a record, waiting while the ring is full.
+ */
+void record_ring_push(RecordRing *ring, const char *record, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    /* The tail is read with acquire: out_giis is done with the slot it frees */
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= RECORD_RING_SLOTS)
+    {
+        usleep(RECORD_RING_FULL_WAIT_US);
+    }
+
+    uint32_t slot = head % RECORD_RING_SLOTS;
+    if (len > RECORD_RING_RECORD_MAX - 1)
+    {
+        len = RECORD_RING_RECORD_MAX - 1;
+    }
+    memcpy(ring->slots[slot], record, len);
+    ring->slots[slot][len] = '\0';
+    ring->len[slot]        = (uint32_t)len;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    sem_post(&ring->pushed);
+}
+
+
+/**
+ * record_ring_wait - Wait until records are queued.
+ */
+int record_ring_wait(RecordRing *ring)
+{
+    if (sem_wait(&ring->pushed) == -1)
+    {
+        return -1;
+    }
+
+    /* The drain that follows delivers the records of these posts as well */
+    while (sem_trywait(&ring->pushed) == 0)
+    {
+    }
+    return 0;
+}
+
+
+/**
+ * record_ring_drain - Deliver every record queued, oldest first.
+ */
+size_t record_ring_drain(RecordRing *ring, record_handler_t handler, void *ctx)
+{
+    uint32_t    tail      = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t    head      = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t      delivered = 0;
+
+    while (tail != head)
+    {
+        uint32_t slot = tail % RECORD_RING_SLOTS;
+        handler(ring->slots[slot], ring->len[slot], ctx);
+        delivered++;
+
+        /* Free the slot at once: out_server may be waiting for it */
+        atomic_store_explicit(&ring->tail, ++tail, memory_order_release);
+        if (tail == head)
+        {
+            head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        }
+    }
+    return delivered;
+}
+
+
+/**
+ * record_ring_queued - Records pushed and not delivered yet.
+ */
+uint32_t record_ring_queued(const RecordRing *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
@@ -0,0 +1,485 @@
+/**
+ * sensor_parser.c: Hand-written parser for sensor reading lines
+ *
+ * Parses lines of the form
+ *      "00:50:56:2b:d3:c1: D: x 91.37 y 72.45 z 0.70 seq 1729300000000001"
+ * into typed SensorReading records without sscanf: the MAC is decoded from
+ * its fixed layout, coordinates are parsed as fixed point decimals scaled by
+ * COORD_SCALE, and batches of lines are split with a SIMD delimiter scanner
+ * (AVX2 or SSE2, selected at runtime, with a scalar fallback).
+ *
+ * Usage:
+ *      SensorReading reading;
+ *      if (parse_reading(line, strlen(line), &reading) == PARSE_OK) ...
+ *
+ * Version: v1.2
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            optional "seq <n>" field
+ *   19-10-2026       Morris              v1.2            optional trace suffix, located, not parsed
+ *
+ */
+
+#include "../inc/sensor_parser.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+
+/* Names for parse_status_t, indexed by value */
+static const char *parse_status_names[PARSE_ERR_COUNT] =
+{
+    "ok",
+    "empty line",
+    "bad mac address",
+    "bad status",
+    "missing field label",
+    "bad number",
+    "number out of range",
+    "bad sequence number",
+    "trailing characters",
+};
+
+
+/**
+ * is_blank - Whitespace as skipped by the sscanf format this parser replaces.
+ */
+static inline int is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * skip_blanks - Advance @p past whitespace, never beyond @end.
+ */
+static inline const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && is_blank(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * hex_value - Value of a hex digit, or -1 if @c is not one.
+ */
+static inline int hex_value(unsigned char c)
+{
+    if ((unsigned)(c - '0') < 10u)
+    {
+        return c - '0';
+    }
+    c |= 0x20;                                                       /* Fold to lower case */
+    if ((unsigned)(c - 'a') < 6u)
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * decode_mac - Decode the fixed "xx:xx:xx:xx:xx:xx" layout at @p.
+ *
+ * Return: 0 on success, -1 if the layout does not match.
+ */
+static int decode_mac(const char *p, uint64_t *mac)
+{
+    uint64_t value = 0;
+
+    for (int i = 0; i < 6; i++)
+    {
+        const char *octet = p + i * 3;
+        int hi = hex_value((unsigned char)octet[0]);
+        int lo = hex_value((unsigned char)octet[1]);
+        if (hi < 0 || lo < 0 || (i < 5 && octet[2] != ':'))
+        {
+            return -1;
+        }
+        value = (value << 8) | (uint64_t)(hi << 4 | lo);
+    }
+
+    *mac = value;
+    return 0;
+}
+
+/**
+ * parse_fixed - Parse a decimal number at *@pp into fixed point.
+ *
+ * Accepts an optional sign, up to COORD_MAX_INT_DIGITS integer digits and
+ * any number of fraction digits; the result is rounded to 1/COORD_SCALE.
+ */
+static parse_status_t parse_fixed(const char **pp, const char *end, int32_t *out)
+{
+    const char *p        = *pp;
+    int         negative = 0;
+    int32_t     int_part = 0;
+    int32_t     frac     = 0;
+    int         digits   = 0;
+
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    while (p < end && (unsigned)(*p - '0') < 10u)
+    {
+        if (++digits > COORD_MAX_INT_DIGITS)
+        {
+            return PARSE_ERR_RANGE;
+        }
+        int_part = int_part * 10 + (*p - '0');
+        p++;
+    }
+
+    if (p < end && *p == '.')
+    {
+        int frac_digits = 0;
+        p++;
+        while (p < end && (unsigned)(*p - '0') < 10u)
+        {
+            if (frac_digits < 2)
+            {
+                frac = frac * 10 + (*p - '0');                       /* Hundredths */
+            }
+            else if (frac_digits == 2 && *p >= '5')
+            {
+                frac++;                                              /* Round half away from zero */
+            }
+            frac_digits++;
+            digits++;
+            p++;
+        }
+        if (frac_digits == 1)
+        {
+            frac *= 10;
+        }
+    }
+
+    if (digits == 0)
+    {
+        return PARSE_ERR_NUMBER;
+    }
+
+    int32_t value = int_part * COORD_SCALE + frac;
+    *out = negative ? -value : value;
+    *pp  = p;
+
+    return PARSE_OK;
+}
+
+/**
+ * parse_coord - Parse "<label> <number>" with surrounding whitespace.
+ */
+static parse_status_t parse_coord(const char **pp, const char *end, char label, int32_t *out)
+{
+    const char *p = skip_blanks(*pp, end);
+
+    if (p >= end || *p != label)
+    {
+        return PARSE_ERR_FIELD;
+    }
+    p = skip_blanks(p + 1, end);
+
+    parse_status_t rc = parse_fixed(&p, end, out);
+    if (rc != PARSE_OK)
+    {
+        return rc;
+    }
+
+    /* The number must end at whitespace or at the end of the line */
+    if (p < end && !is_blank(*p))
+    {
+        return PARSE_ERR_NUMBER;
+    }
+
+    *pp = p;
+    return PARSE_OK;
+}
+
+
+/**
+ * is_trace - Whether the trace suffix starts at @p.
+ */
+static inline int is_trace(const char *p, const char *end)
+{
+    return end - p > 5 && memcmp(p, "trace", 5) == 0 && is_blank(p[5]);
+}
+
+/**
+ * parse_seq - Parse an optional " seq <n>" suffix; absent means 0.
+ */
+static parse_status_t parse_seq(const char **pp, const char *end, uint64_t *seq)
+{
+    const char *p = skip_blanks(*pp, end);
+
+    *seq = 0;
+    if (p == end || is_trace(p, end))
+    {
+        return PARSE_OK;
+    }
+    if (end - p < 3 || memcmp(p, "seq", 3) != 0)
+    {
+        return PARSE_ERR_TRAILING;
+    }
+    p = skip_blanks(p + 3, end);
+
+    int digits = 0;
+    while (p < end && (unsigned)(*p - '0') < 10u)
+    {
+        if (++digits > 19)
+        {
+            return PARSE_ERR_SEQ;                                    /* Would overflow 64 bits */
+        }
+        *seq = *seq * 10 + (uint64_t)(*p - '0');
+        p++;
+    }
+    if (digits == 0 || *seq == 0)
+    {
+        return PARSE_ERR_SEQ;
+    }
+
+    *pp = p;
+    return PARSE_OK;
+}
+
+
+/**
+ * parse_reading - Parse a single reading line.
+ */
+parse_status_t parse_reading(const char *line, size_t len, SensorReading *out)
+{
+    const char      *end = line + len;
+    const char      *p   = skip_blanks(line, end);
+    parse_status_t  rc;
+
+    if (p == end)
+    {
+        return PARSE_ERR_EMPTY;
+    }
+    out->trace = 0;
+
+    /* "<mac>:" */
+    if ((size_t)(end - p) < MAC_STR_LEN + 1 || decode_mac(p, &out->mac) != 0 || p[MAC_STR_LEN] != ':')
+    {
+        return PARSE_ERR_MAC;
+    }
+    p += MAC_STR_LEN + 1;
+
+    /* " <status>:" */
+    p = skip_blanks(p, end);
+    if (end - p < 2 || p[0] == ':' || p[1] != ':')
+    {
+        return PARSE_ERR_STATUS;
+    }
+    out->status = p[0];
+    p += 2;
+
+    /* " x <x> y <y> z <z>" */
+    if ((rc = parse_coord(&p, end, 'x', &out->x)) != PARSE_OK ||
+        (rc = parse_coord(&p, end, 'y', &out->y)) != PARSE_OK ||
+        (rc = parse_coord(&p, end, 'z', &out->z)) != PARSE_OK ||
+        (rc = parse_seq(&p, end, &out->seq)) != PARSE_OK)
+    {
+        return rc;
+    }
+
+    /* " trace ...": left to the trace sink */
+    p = skip_blanks(p, end);
+    if (p != end && is_trace(p, end) && p - line <= UINT16_MAX)
+    {
+        out->trace = (uint16_t)(p - line);
+        p          = end;
+    }
+    if (p != end)
+    {
+        return PARSE_ERR_TRAILING;
+    }
+
+    return PARSE_OK;
+}
+
+
+/**
+ * scan_scalar - Portable delimiter scanner.
+ */
+static const char *scan_scalar(const char *p, const char *end, char c)
+{
+    const char *hit = memchr(p, c, (size_t)(end - p));
+    return hit ? hit : end;
+}
+
+#ifdef HAVE_X86_SIMD
+/**
+ * scan_sse2 - Delimiter scanner comparing 16 bytes per step.
+ */
+__attribute__((target("sse2")))
+static const char *scan_sse2(const char *p, const char *end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+
+    while (end - p >= 16)
+    {
+        __m128i  chunk = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask  = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+
+    while (p < end && *p != c)
+    {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * scan_avx2 - Delimiter scanner comparing 32 bytes per step.
+ */
+__attribute__((target("avx2")))
+static const char *scan_avx2(const char *p, const char *end, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+
+    while (end - p >= 32)
+    {
+        __m256i  chunk = _mm256_loadu_si256((const __m256i *)p);
+        unsigned mask  = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+
+    return scan_sse2(p, end, c);
+}
+#endif
+
+
+/* Scanner selected on first use */
+static const char *(*scan_impl)(const char *, const char *, char) = NULL;
+static const char *scan_impl_name = "scalar";
+
+/**
+ * select_scanner - Pick the widest scanner the running CPU supports.
+ */
+static void select_scanner(void)
+{
+    scan_impl      = scan_scalar;
+    scan_impl_name = "scalar";
+
+#if defined(HAVE_X86_SIMD) && !defined(PARSER_FORCE_SCALAR)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        scan_impl      = scan_avx2;
+        scan_impl_name = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        scan_impl      = scan_sse2;
+        scan_impl_name = "sse2";
+    }
+#endif
+}
+
+
+/**
+ * scan_delimiter - Find the first occurrence of @c in [@p, @end).
+ */
+const char *scan_delimiter(const char *p, const char *end, char c)
+{
+    if (scan_impl == NULL)
+    {
+        select_scanner();
+    }
+    return scan_impl(p, end, c);
+}
+
+/**
+ * scan_delimiter_impl - Name of the scanner selected at runtime.
+ */
+const char *scan_delimiter_impl(void)
+{
+    if (scan_impl == NULL)
+    {
+        select_scanner();
+    }
+    return scan_impl_name;
+}
+
+
+/**
+ * parse_reading_batch - Parse a buffer holding many newline-separated lines.
+ */
+size_t parse_reading_batch(const char *buf, size_t len, SensorReading *out,
+                           parse_status_t *status, size_t max_lines, size_t *consumed)
+{
+    const char *p     = buf;
+    const char *end   = buf + len;
+    size_t     lines  = 0;
+
+    while (lines < max_lines && p < end)
+    {
+        const char *nl = scan_delimiter(p, end, '\n');
+        if (nl == end)
+        {
+            break;                                                   /* Incomplete last line */
+        }
+
+        status[lines] = parse_reading(p, (size_t)(nl - p), &out[lines]);
+        lines++;
+        p = nl + 1;
+    }
+
+    *consumed = (size_t)(p - buf);
+    return lines;
+}
+
+
+/**
+ * parse_mac - Decode a "xx:xx:xx:xx:xx:xx" string (exactly MAC_STR_LEN chars).
+ */
+int parse_mac(const char *str, uint64_t *mac)
+{
+    if (strnlen(str, MAC_STR_LEN + 1) != MAC_STR_LEN)
+    {
+        return -1;
+    }
+    return decode_mac(str, mac);
+}
+
+/**
+ * format_mac - Format a decoded MAC back to "xx:xx:xx:xx:xx:xx".
+ */
+void format_mac(uint64_t mac, char *buf)
+{
+    snprintf(buf, MAC_STR_LEN + 1, "%02x:%02x:%02x:%02x:%02x:%02x",
+             (unsigned)(mac >> 40) & 0xff, (unsigned)(mac >> 32) & 0xff,
+             (unsigned)(mac >> 24) & 0xff, (unsigned)(mac >> 16) & 0xff,
+             (unsigned)(mac >> 8)  & 0xff, (unsigned)mac & 0xff);
+}
+
+/**
+ * parse_status_str - Human readable name of a parse_status_t.
+ */
+const char *parse_status_str(parse_status_t status)
+{
+    if ((unsigned)status >= PARSE_ERR_COUNT)
+    {
+        return "unknown";
+    }
+    return parse_status_names[status];
+}
@@ -0,0 +1,259 @@
+/**
+ * sensor_registry.c: MAC address interning for the Sensors table
+ *
+ * Each sensor is stored once in the Sensors table and Customer_Data rows
+ * reference it by integer id. This module keeps an open addressing hash map
+ * from the 48-bit MAC to that id, preloaded at start-up, so the inserter
+ * only touches the Sensors table the first time a new sensor reports.
+ * Sensors added by a batch that is rolled back are forgotten again.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            forget the sensors of a rolled back batch
+ *
+ */
+
+#include "../inc/sensor_registry.h"
+#include "../inc/sensor_parser.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * mac_hash - Mix the MAC bits so consecutive addresses spread over the table.
+ */
+static inline size_t mac_hash(uint64_t mac)
+{
+    mac ^= mac >> 33;
+    mac *= 0xff51afd7ed558ccdULL;
+    mac ^= mac >> 33;
+    return (size_t)mac;
+}
+
+/**
+ * slot_find - Slot holding @mac, or the empty slot where it belongs.
+ */
+static SensorSlot *slot_find(SensorSlot *slots, size_t capacity, uint64_t mac)
+{
+    size_t i = mac_hash(mac) & (capacity - 1);
+
+    while (slots[i].id != 0 && slots[i].mac != mac)
+    {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &slots[i];
+}
+
+/**
+ * registry_grow - Double the table once it is 70% full.
+ */
+static int registry_grow(SensorRegistry *registry)
+{
+    size_t      capacity = registry->capacity * 2;
+    SensorSlot  *slots   = calloc(capacity, sizeof(SensorSlot));
+    if (!slots)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    for (size_t i = 0; i < registry->capacity; i++)
+    {
+        if (registry->slots[i].id != 0)
+        {
+            *slot_find(slots, capacity, registry->slots[i].mac) = registry->slots[i];
+        }
+    }
+
+    free(registry->slots);
+    registry->slots    = slots;
+    registry->capacity = capacity;
+    return 0;
+}
+
+/**
+ * registry_put - Cache @mac -> @id.
+ */
+static int registry_put(SensorRegistry *registry, uint64_t mac, int64_t id)
+{
+    if ((registry->count + 1) * 10 > registry->capacity * 7 && registry_grow(registry) != 0)
+    {
+        return -1;
+    }
+
+    SensorSlot *slot = slot_find(registry->slots, registry->capacity, mac);
+    if (slot->id == 0)
+    {
+        registry->count++;
+    }
+    slot->mac = mac;
+    slot->id  = id;
+    return 0;
+}
+
+/**
+ * registry_remove - Drop @mac from the cache, shifting back the slots that
+ *                   probed past it.
+ */
+static void registry_remove(SensorRegistry *registry, uint64_t mac)
+{
+    size_t      mask  = registry->capacity - 1;
+    SensorSlot  *hole = slot_find(registry->slots, registry->capacity, mac);
+    if (hole->id == 0)
+    {
+        return;
+    }
+    hole->id = 0;
+    registry->count--;
+
+    size_t i = (size_t)(hole - registry->slots);
+    for (size_t j = (i + 1) & mask; registry->slots[j].id != 0; j = (j + 1) & mask)
+    {
+        size_t home = mac_hash(registry->slots[j].mac) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask))                 /* The hole lies on its probe path */
+        {
+            registry->slots[i]    = registry->slots[j];
+            registry->slots[j].id = 0;
+            i = j;
+        }
+    }
+}
+
+
+/**
+ * sensor_registry_init - Create the cache and preload it from Sensors.
+ */
+int sensor_registry_init(SensorRegistry *registry, sqlite3 *db)
+{
+    memset(registry, 0, sizeof(*registry));
+    registry->db       = db;
+    registry->capacity = SENSOR_REGISTRY_INITIAL_SLOTS;
+    registry->slots    = calloc(registry->capacity, sizeof(SensorSlot));
+    if (!registry->slots)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    registry->select_stmt = prk_db_prepare(db, "SELECT id FROM Sensors WHERE mac_address = ?;");
+    registry->insert_stmt = prk_db_prepare(db, "INSERT INTO Sensors (mac_address) VALUES (?);");
+    sqlite3_stmt *load    = prk_db_prepare(db, "SELECT id, mac_address FROM Sensors;");
+    if (!registry->select_stmt || !registry->insert_stmt || !load)
+    {
+        sqlite3_finalize(load);
+        sensor_registry_free(registry);
+        return -1;
+    }
+
+    /* Preload every known sensor */
+    while (sqlite3_step(load) == SQLITE_ROW)
+    {
+        uint64_t    mac;
+        const char  *text = (const char *)sqlite3_column_text(load, 1);
+        if (text && parse_mac(text, &mac) == 0)
+        {
+            registry_put(registry, mac, sqlite3_column_int64(load, 0));
+        }
+    }
+    sqlite3_finalize(load);
+
+    return 0;
+}
+
+/**
+ * sensor_registry_lookup - Resolve a MAC address to its Sensors.id.
+ */
+int64_t sensor_registry_lookup(SensorRegistry *registry, uint64_t mac)
+{
+    SensorSlot *slot = slot_find(registry->slots, registry->capacity, mac);
+    if (slot->id != 0)
+    {
+        registry->hits++;
+        return slot->id;
+    }
+    registry->misses++;
+
+    char mac_address[MAC_STR_LEN + 1];
+    format_mac(mac, mac_address);
+
+    /* Known to the database (e.g. added by another process)? */
+    int64_t id = -1;
+    sqlite3_bind_text(registry->select_stmt, 1, mac_address, MAC_STR_LEN, SQLITE_TRANSIENT);
+    if (sqlite3_step(registry->select_stmt) == SQLITE_ROW)
+    {
+        id = sqlite3_column_int64(registry->select_stmt, 0);
+    }
+    sqlite3_reset(registry->select_stmt);
+
+    /* New sensor: register it, remembered until its batch is committed */
+    if (id < 0)
+    {
+        if (registry->added_count == registry->added_capacity)
+        {
+            size_t      capacity = registry->added_capacity ? registry->added_capacity * 2 : 64;
+            uint64_t    *added   = realloc(registry->added, capacity * sizeof(uint64_t));
+            if (!added)
+            {
+                perror("realloc");
+                return -1;
+            }
+            registry->added          = added;
+            registry->added_capacity = capacity;
+        }
+
+        sqlite3_bind_text(registry->insert_stmt, 1, mac_address, MAC_STR_LEN, SQLITE_TRANSIENT);
+        if (sqlite3_step(registry->insert_stmt) != SQLITE_DONE)
+        {
+            fprintf(stderr, "Error registering sensor %s: %s\n", mac_address, sqlite3_errmsg(registry->db));
+            sqlite3_reset(registry->insert_stmt);
+            return -1;
+        }
+        sqlite3_reset(registry->insert_stmt);
+        id = sqlite3_last_insert_rowid(registry->db);
+        registry->added[registry->added_count++] = mac;
+    }
+
+    if (registry_put(registry, mac, id) != 0)
+    {
+        return -1;
+    }
+    return id;
+}
+
+/**
+ * sensor_registry_batch_done - The batch that added the new sensors is committed.
+ */
+void sensor_registry_batch_done(SensorRegistry *registry)
+{
+    registry->added_count = 0;
+}
+
+/**
+ * sensor_registry_rollback - Forget the sensors added since the last batch_done.
+ */
+void sensor_registry_rollback(SensorRegistry *registry)
+{
+    for (size_t i = 0; i < registry->added_count; i++)
+    {
+        registry_remove(registry, registry->added[i]);
+    }
+    registry->added_count = 0;
+}
+
+/**
+ * sensor_registry_free - Release the cache and its prepared statements.
+ */
+void sensor_registry_free(SensorRegistry *registry)
+{
+    sqlite3_finalize(registry->select_stmt);
+    sqlite3_finalize(registry->insert_stmt);
+    free(registry->added);
+    free(registry->slots);
+    memset(registry, 0, sizeof(*registry));
+}
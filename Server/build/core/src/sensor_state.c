@@ -0,0 +1,118 @@
+/**
+ * sensor_state.c: Latest status and position of every sensor
+ *
+ * Answering "where is this sensor now" from Customer_Data means finding its
+ * newest row among all partitions. This module keeps the newest reading of
+ * each sensor in memory and writes the sensors that changed to the
+ * Sensor_State table (one row per sensor) with coalesced upserts, so the
+ * table stays as large as the fleet whatever the history held.
+ *
+ * Version: v1.1
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            entries in a SensorTable (sensor_table.c)
+ *
+ */
+
+#include "../inc/sensor_state.h"
+#include "../inc/sensor_parser.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <string.h>
+
+
+/**
+ * mark_dirty - Remember that @sensor_id needs its row written.
+ */
+static void mark_dirty(SensorState *state, SensorStateEntry *entry, int64_t sensor_id)
+{
+    if (!entry->dirty && sensor_table_list(&state->table, sensor_id) == 0)
+    {
+        entry->dirty = 1;                                            /* Else written with a later change */
+    }
+}
+
+
+/**
+ * sensor_state_init - Create the in-memory state and prepare the upsert.
+ */
+int sensor_state_init(SensorState *state, sqlite3 *db)
+{
+    memset(state, 0, sizeof(*state));
+    sensor_table_init(&state->table, sizeof(SensorStateEntry));
+
+    state->save_stmt = prk_db_prepare(db,
+        "INSERT INTO Sensor_State (sensor_id, status, x, y, z, last_seen) VALUES (?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT (sensor_id) DO UPDATE SET "
+        "    status = excluded.status, x = excluded.x, y = excluded.y, z = excluded.z, "
+        "    last_seen = excluded.last_seen "
+        "WHERE excluded.last_seen >= Sensor_State.last_seen;");
+
+    return state->save_stmt ? 0 : -1;
+}
+
+/**
+ * sensor_state_update - Record a stored reading as its sensor's latest state.
+ */
+void sensor_state_update(SensorState *state, const StoredReading *reading)
+{
+    SensorStateEntry *entry = sensor_table_get(&state->table, reading->sensor_id);
+    if (!entry || reading->recv_time < entry->last_seen)
+    {
+        return;
+    }
+
+    entry->last_seen = reading->recv_time;
+    entry->x         = reading->x;
+    entry->y         = reading->y;
+    entry->z         = reading->z;
+    entry->status    = reading->status;
+    mark_dirty(state, entry, reading->sensor_id);
+    state->updates++;
+}
+
+/**
+ * sensor_state_flush - Upsert the sensors changed since the last flush.
+ */
+int sensor_state_flush(SensorState *state)
+{
+    int rc = 0;
+
+    for (size_t i = 0; i < state->table.listed_count; i++)
+    {
+        int64_t             id    = state->table.listed[i];
+        SensorStateEntry    *entry = sensor_table_at(&state->table, id);
+
+        sqlite3_bind_int64(state->save_stmt, 1, id);
+        sqlite3_bind_text(state->save_stmt, 2, &entry->status, 1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(state->save_stmt, 3, entry->x / (double)COORD_SCALE);
+        sqlite3_bind_double(state->save_stmt, 4, entry->y / (double)COORD_SCALE);
+        sqlite3_bind_double(state->save_stmt, 5, entry->z / (double)COORD_SCALE);
+        sqlite3_bind_int64(state->save_stmt, 6, entry->last_seen);
+        if (sqlite3_step(state->save_stmt) != SQLITE_DONE)
+        {
+            fprintf(stderr, "Error saving the state of sensor %lld\n", (long long)id);
+            rc = -1;
+        }
+        sqlite3_reset(state->save_stmt);
+        entry->dirty = 0;
+        state->upserts++;
+    }
+    state->table.listed_count = 0;
+
+    return rc;
+}
+
+/**
+ * sensor_state_free - Release the state.
+ */
+void sensor_state_free(SensorState *state)
+{
+    sqlite3_finalize(state->save_stmt);
+    sensor_table_free(&state->table);
+    memset(state, 0, sizeof(*state));
+    sensor_table_init(&state->table, sizeof(SensorStateEntry));
+}
@@ -0,0 +1,95 @@
+/**
+ * sensor_table.c: Per-sensor state indexed by sensor id
+ *
+ * The inserter keeps several kinds of per-sensor state (sequence windows,
+ * latest positions, compaction candidates, open sessions), each in an
+ * array indexed by Sensors.id with a list of the ids to visit at the next
+ * flush. This module holds that array and list once for all of them.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/sensor_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * sensor_table_init - Create an empty table.
+ */
+void sensor_table_init(SensorTable *table, size_t entry_size)
+{
+    memset(table, 0, sizeof(*table));
+    table->entry_size = entry_size;
+}
+
+/**
+ * sensor_table_get - Entry of @sensor_id, growing the table when needed.
+ */
+void *sensor_table_get(SensorTable *table, int64_t sensor_id)
+{
+    if (sensor_id <= 0)
+    {
+        return NULL;
+    }
+
+    if ((size_t)sensor_id >= table->capacity)
+    {
+        size_t capacity = table->capacity ? table->capacity : SENSOR_TABLE_INITIAL;
+        while (capacity <= (size_t)sensor_id)
+        {
+            capacity *= 2;
+        }
+
+        char *entries = realloc(table->entries, capacity * table->entry_size);
+        if (!entries)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        memset(entries + table->capacity * table->entry_size, 0, (capacity - table->capacity) * table->entry_size);
+        table->entries  = entries;
+        table->capacity = capacity;
+    }
+
+    return sensor_table_at(table, sensor_id);
+}
+
+/**
+ * sensor_table_list - Queue @sensor_id in listed[].
+ */
+int sensor_table_list(SensorTable *table, int64_t sensor_id)
+{
+    if (table->listed_count == table->listed_capacity)
+    {
+        size_t  capacity = table->listed_capacity ? table->listed_capacity * 2 : SENSOR_TABLE_INITIAL;
+        int64_t *listed  = realloc(table->listed, capacity * sizeof(int64_t));
+        if (!listed)
+        {
+            perror("realloc");
+            return -1;
+        }
+        table->listed          = listed;
+        table->listed_capacity = capacity;
+    }
+
+    table->listed[table->listed_count++] = sensor_id;
+    return 0;
+}
+
+/**
+ * sensor_table_free - Release the entries and the list.
+ */
+void sensor_table_free(SensorTable *table)
+{
+    free(table->entries);
+    free(table->listed);
+    memset(table, 0, sizeof(*table));
+}
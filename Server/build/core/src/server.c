@@ -7,18 +7,23 @@
  * graceful shutdown using signal handling.
  *
  * Compilation:
- *      gcc server.c -o out_server -lpthread
+ *      gcc server.c record_reader.c record_ring.c prk_notify.c prk_metrics.c prk_trace.c prk_tracepoint.c \
+ *          -o out_server -lpthread -lrt
  *
  * Usage:
  *      ./out_server
  *
  * Features:
  * - Listens for incoming connections on a port defined by SERVER_PORT.
- * - Uses shared memory to store received data.
+ * - Splits the data of each client into lines, also across reads (record_reader.h).
+ * - Queues the lines in shared memory for out_giis (record_ring.h).
  * - Supports multiple concurrent clients using threads.
  * - Synchronizes access to shared memory using mutexes.
  * - Limits the number of concurrent clients using semaphores.
  * - Handles signals for graceful shutdown.
+ * - Keeps its metrics in the shm page "server" (prk_metrics.h).
+ * - Stamps traced records (prk_trace.h) when it writes them to shared memory.
+ * - Tracepoints (prk_tracepoint.h) for each client and record, with TRACEPOINTS=1.
  *
  * Version: v1.0
  * Date:    24-03-2024
@@ -33,17 +38,28 @@
  *                                                          - Added signal handling for graceful shutdown
  *
  *  09-09-2024      morris              v2.0            add header file
+ *   19-10-2026       Morris              v2.1            lines framed across reads, queued in a record
+ *                                                        ring instead of one shared memory slot
+ *   19-10-2026       Morris              v2.2            readiness notification to prk_sys_srv_run
+ *   19-10-2026       Morris              v2.3            metrics (prk_metrics.h): connections, clients,
+ *                                                        bytes, records, shared memory write time
+ *   19-10-2026       Morris              v2.4            stamp traced records
+ *   19-10-2026       Morris              v2.5            tracepoints
  * 
  */
 
 
 #include "../inc/server.h"
+#include "../inc/prk_notify.h"
+#include "../inc/prk_metrics.h"
+#include "../inc/prk_trace.h"
+#include "../inc/prk_tracepoint.h"
+#include "../inc/record_reader.h"
+#include "../inc/record_ring.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
 #include <semaphore.h>
 #include <signal.h>
 
@@ -54,6 +70,13 @@ sem_t client_sem;
 /* Flag to control the main loop */
 volatile sig_atomic_t running = 1;
 
+/* Metrics, registered in main() before the first client thread */
+static PrkCounter       connections;                                 /* Clients accepted */
+static PrkGauge         clients;                                     /* Client threads running */
+static PrkCounter       bytes_received;
+static PrkCounter       records_received;                            /* Lines written to shared memory */
+static PrkHistogram     shm_write_time;                              /* Mutex wait included */
+
 /* Signal handler for graceful shutdown */
 void signal_handler(int signum)
 {
@@ -62,15 +85,57 @@ void signal_handler(int signum)
 }
 
 
+/**
+ * handle_record - Print a complete line of a client and queue it for
+ *                 out_giis (record_handler_t).
+ */
+static void handle_record(char *line, size_t len, void *ctx)
+{
+    struct thread_arg   *targ = ctx;
+    char                record[RECORD_RING_RECORD_MAX];
+
+    printf("Received from %s: %s\n", inet_ntoa(targ->caddr.sin_addr), line);  /* Print each line */
+
+    /* A traced record gets this stage's stamp */
+    int stamp_len = 0;
+    if (prk_trace_find(line, len) && len + PRK_TRACE_STAMP_MAX < RECORD_RING_RECORD_MAX)
+    {
+        memcpy(record, line, len);
+        stamp_len = prk_trace_format_stamp(PRK_TRACE_SRV, record + len, PRK_TRACE_STAMP_MAX);
+    }
+    PRK_TP_SCOPE(PRK_TP_SERVER_RECORD, len, stamp_len > 0);
+
+    /* Lock mutex: the ring takes one producer at a time */
+    uint64_t started = prk_metrics_now_ns();
+    pthread_mutex_lock(&shm_mutex);
+
+    /* Queue the record in shared memory */
+    if (stamp_len > 0)
+    {
+        record_ring_push(targ->ring, record, len + (size_t)stamp_len);
+    }
+    else
+    {
+        record_ring_push(targ->ring, line, len);
+    }
+
+    /* Unlock mutex */
+    pthread_mutex_unlock(&shm_mutex);
+    prk_histogram_observe(shm_write_time, prk_metrics_now_ns() - started);
+    prk_counter_inc(records_received);
+}
+
+
 /**
  * handle_client - Thread function to handle communication with a client.
  *
- * This function reads data from the client, prints it to the terminal,
- * and writes it to shared memory. It uses a mutex to synchronize access
- * to shared memory and signals a semaphore when the client has finished.
+ * This function reads data from the client, splits it into lines, prints
+ * them to the terminal and queues them in shared memory. A line split
+ * across two reads is kept until its end arrives. The semaphore is signaled
+ * when the client has finished.
  *
  * @arg: Pointer to a thread_arg structure containing the client socket
- *       descriptor and client address.
+ *       descriptor, client address and the record ring.
  *
  * Return: NULL.
  */
@@ -78,66 +143,39 @@ void *handle_client(void *arg)
 {
     struct thread_arg   *targ   = (struct thread_arg *)arg;
     int                 csck    = targ->csck;
-    struct sockaddr_in  caddr   = targ->caddr;
-    char                buffer[BUFFER_SIZE + 1];
-    int                 tbrecv;                                      /* Total bytes received from client */
-    int                 brecv;
-    char                *line;                                       /* Split the buffer into lines */
-
-    /* Attach shared memory */
-    int shm_id = shmget(SHM_KEY, sizeof(struct shared_data), 0666);
-    if (shm_id == -1)
-    {
-        perror("shmget");
-        close(csck);
-        free(arg);
-        pthread_exit(NULL);
-    }
-    struct shared_data *shm_data = (struct shared_data *)shmat(shm_id, NULL, 0);
-    if (shm_data == (void *)-1)
+    RecordReader        *reader = malloc(sizeof(RecordReader));      /* Lines, split across reads or not */
+    ssize_t             brecv;
+
+    if (!reader)
     {
-        perror("shmat");
+        perror("malloc");
         close(csck);
         free(arg);
+        sem_post(&client_sem);
         pthread_exit(NULL);
     }
 
     /* Read data from the client and print it to the terminal */
-    while ((brecv = recv(csck, buffer, BUFFER_SIZE, 0)) > 0)
+    prk_gauge_add(clients, 1);
+    PRK_TP_BEGIN(PRK_TP_SERVER_CLIENT, csck, 0);
+    record_reader_init(reader, csck);
+    while ((brecv = record_reader_fill(reader)) > 0)
     {
-        tbrecv         =  0;
-        buffer[brecv]  =  '\0';                                      /* Null-terminate the string */
-        line           =  strtok(buffer, "\n");                      /* Tokenize within the recv loop */
-
-        while (line != NULL)
-        {
-            printf("Received from %s: %s\n", inet_ntoa(caddr.sin_addr), line);  /* Print each line */
-
-            /* Lock mutex */
-            pthread_mutex_lock(&shm_mutex);
-
-            /* Write to shared memory */
-            strncpy(shm_data->data, line, BUFFER_SIZE);
-
-            /* Unlock mutex */
-            pthread_mutex_unlock(&shm_mutex);
-
-            line = strtok(NULL, "\n");                               /* Move to the next line */
-        }
-
-        tbrecv += brecv;
+        prk_counter_add(bytes_received, (uint64_t)brecv);
+        record_reader_drain(reader, handle_record, targ);
     }
 
+    prk_gauge_add(clients, -1);
+    PRK_TP_END(PRK_TP_SERVER_CLIENT, csck, 0);
+
     /* Print a message indicating the end of data reception from the client */
-    if (tbrecv > 0)
+    if (reader->records > 0)
     {
         printf("Complete message received from client.\n");
     }
 
-    /* Detach shared memory */
-    shmdt(shm_data);
-
     /* Close the client socket */
+    free(reader);
     close(csck);
     free(arg);
 
@@ -156,6 +194,16 @@ int main()
     /* Print version information */
     printf("Server Version: %s\n", VERSION);
 
+    /* Metrics page, read by out_metrics_exporter */
+    prk_metrics_open("server");
+    PRK_TP_OPEN("server");
+    connections      = prk_counter("prk_server_connections_total", "Client connections accepted.");
+    clients          = prk_gauge("prk_server_clients", "Clients connected.");
+    bytes_received   = prk_counter("prk_server_received_bytes_total", "Bytes received from clients.");
+    records_received = prk_counter("prk_server_records_total", "Records written to shared memory.");
+    shm_write_time   = prk_histogram("prk_server_shm_write_seconds",
+                                     "Time to write a record to shared memory, mutex wait included.", PRK_SCALE_NS);
+
     /* Set up signal handler for SIGINT (Ctrl+C) */
     if (signal(SIGINT, signal_handler) == SIG_ERR)
     {
@@ -190,11 +238,10 @@ int main()
 
     printf("Server is listening on port %d\n", SERVER_PORT);
 
-    /* Initialize shared memory */
-    int shm_id = shmget(SHM_KEY, sizeof(struct shared_data), IPC_CREAT | 0666);
-    if (shm_id == -1)
+    /* Initialize shared memory: the record ring read by out_giis */
+    RecordRing *ring = record_ring_create();
+    if (!ring)
     {
-        perror("shmget");
         exit(EXIT_FAILURE);
     }
 
@@ -205,6 +252,9 @@ int main()
         exit(EXIT_FAILURE);
     }
 
+    /* Listening, shared memory created: the next stages can start */
+    prk_notify_ready();
+
     /* Main loop to accept and handle client connections */
     while (running)
     {
@@ -215,6 +265,7 @@ int main()
             perror("malloc");
             exit(EXIT_FAILURE);
         }
+        targ->ring = ring;
 
         /* Wait for a semaphore signal (only allow MAX_CLIENTS concurrent clients) */
         sem_wait(&client_sem);
@@ -230,6 +281,7 @@ int main()
             sem_post(&client_sem);
             continue;
         }
+        prk_counter_inc(connections);
 
         /* Create a thread to handle the client */
         if (pthread_create(&thread_id, NULL, handle_client, (void *)targ) != 0)
@@ -245,10 +297,13 @@ int main()
         pthread_detach(thread_id);
     }
 
-    /* Cleanup: close the server socket */
+    /* Cleanup: close the server socket, leave the ring to out_giis */
     close(ssck);
+    record_ring_detach(ring);
     /* Cleanup: destroy the semaphore */
     sem_destroy(&client_sem);
+    PRK_TP_CLOSE();
+    prk_metrics_close();
 
     return 0;
 }
@@ -0,0 +1,1026 @@
+/**
+ * store_tsdb.c: Native time-series storage engine for position readings
+ *
+ * An alternative to row-at-a-time SQLite inserts for raw readings. Each
+ * sensor gets one append chunk per hour bucket; readings are buffered in
+ * memory until their batch commits and written with one write() per sensor
+ * and bucket, or dropped if it is rolled back. An in-memory
+ * index keeps, per sensor, the sorted list of buckets that exist on disk,
+ * so a range query touches only the chunk files that overlap it and reads
+ * them through mmap. A background thread compacts closed buckets: it merges
+ * the chunk (and any earlier segment) into one segment sorted by time, which
+ * range queries can binary search. A marker file written before the swap
+ * lets a restart tell whether the merged segment already holds a chunk's
+ * records, so a crash mid-swap never reports them twice.
+ *
+ * Usage:
+ *      ReadingStore store;
+ *      reading_store_open(STORE_BACKEND_TSDB, NULL, TSDB_DIR, &store);
+ *
+ * Version: v1.2
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            crash-safe compaction, merged outside the lock
+ *   19-10-2026       Morris              v1.2            write a batch's records once it is committed,
+ *                                                        drop them when it is rolled back
+ *
+ */
+
+#include "../inc/reading_store.h"
+#include "../inc/store_tsdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define TSDB_DIR_MAX           256                                   /* Longest data directory path */
+
+
+/* One hour bucket of one sensor */
+typedef struct
+{
+    int64_t   bucket;                                                /* recv_time / TSDB_BUCKET_MS */
+    size_t    chk_count;                                             /* Records in the append chunk */
+    size_t    seg_count;                                             /* Records in the compacted segment */
+    int       chk_sorted;                                            /* Chunk records are in time order */
+    int64_t   chk_last;                                              /* Last recv_time appended to the chunk */
+} TsdbBucket;
+
+/* Index and write buffer of one sensor */
+typedef struct
+{
+    int64_t     sensor_id;                                           /* Sensors.id */
+    TsdbBucket  *buckets;                                            /* Sorted by bucket */
+    size_t      bucket_count;
+    size_t      bucket_capacity;
+    TsdbRecord  *pending;                                            /* Appended, not yet written */
+    size_t      pending_count;
+    size_t      pending_capacity;
+    size_t      pending_kept;                                        /* Of committed batches, their write failed */
+    int         dirty;                                               /* Listed in Tsdb.dirty */
+} TsdbSeries;
+
+/* Engine state */
+typedef struct
+{
+    char            dir[TSDB_DIR_MAX];                               /* Data directory */
+    TsdbSeries      **series;                                        /* Indexed by sensor id */
+    size_t          series_capacity;
+    int64_t         *dirty;                                          /* Sensor ids with pending records */
+    size_t          dirty_count;
+    size_t          dirty_capacity;
+    pthread_mutex_t lock;                                            /* Guards everything above */
+    pthread_t       compactor;                                       /* Background compaction thread */
+    pthread_cond_t  wake;                                            /* Signalled on shutdown */
+    int             running;                                         /* Compactor keeps going while set */
+} Tsdb;
+
+
+/**
+ * now_ms - Wall clock in milliseconds.
+ */
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * bucket_of - Bucket number of a receive time (floor division).
+ */
+static inline int64_t bucket_of(int64_t recv_time)
+{
+    int64_t b = recv_time / TSDB_BUCKET_MS;
+    return (recv_time < 0 && recv_time % TSDB_BUCKET_MS) ? b - 1 : b;
+}
+
+/**
+ * bucket_path - Path of a bucket file with the given suffix.
+ */
+static void bucket_path(const Tsdb *tsdb, int64_t sensor_id, int64_t bucket, const char *suffix,
+                        char *path, size_t size)
+{
+    snprintf(path, size, "%s/%lld/%lld%s", tsdb->dir, (long long)sensor_id, (long long)bucket, suffix);
+}
+
+/**
+ * write_all - write() the whole buffer.
+ */
+static int write_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+
+/**
+ * series_get - Series of @sensor_id, created on demand when @create is set.
+ */
+static TsdbSeries *series_get(Tsdb *tsdb, int64_t sensor_id, int create)
+{
+    if (sensor_id <= 0)
+    {
+        return NULL;
+    }
+
+    if ((size_t)sensor_id >= tsdb->series_capacity)
+    {
+        if (!create)
+        {
+            return NULL;
+        }
+
+        size_t capacity = tsdb->series_capacity ? tsdb->series_capacity : 64;
+        while (capacity <= (size_t)sensor_id)
+        {
+            capacity *= 2;
+        }
+        TsdbSeries **series = realloc(tsdb->series, capacity * sizeof(TsdbSeries *));
+        if (!series)
+        {
+            return NULL;
+        }
+        memset(series + tsdb->series_capacity, 0, (capacity - tsdb->series_capacity) * sizeof(TsdbSeries *));
+        tsdb->series          = series;
+        tsdb->series_capacity = capacity;
+    }
+
+    TsdbSeries *s = tsdb->series[sensor_id];
+    if (!s && create)
+    {
+        s = calloc(1, sizeof(TsdbSeries));
+        if (!s)
+        {
+            return NULL;
+        }
+        s->sensor_id = sensor_id;
+        tsdb->series[sensor_id] = s;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%lld", tsdb->dir, (long long)sensor_id);
+        mkdir(path, 0775);
+    }
+    return s;
+}
+
+/**
+ * bucket_lower - Index of the first bucket >= @bucket (binary search).
+ */
+static size_t bucket_lower(const TsdbSeries *s, int64_t bucket)
+{
+    size_t lo = 0, hi = s->bucket_count;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (s->buckets[mid].bucket < bucket)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * bucket_get - Index entry of @bucket, inserted in order if missing.
+ */
+static TsdbBucket *bucket_get(TsdbSeries *s, int64_t bucket)
+{
+    size_t i = bucket_lower(s, bucket);
+    if (i < s->bucket_count && s->buckets[i].bucket == bucket)
+    {
+        return &s->buckets[i];
+    }
+
+    if (s->bucket_count == s->bucket_capacity)
+    {
+        size_t      capacity = s->bucket_capacity ? s->bucket_capacity * 2 : 8;
+        TsdbBucket  *buckets = realloc(s->buckets, capacity * sizeof(TsdbBucket));
+        if (!buckets)
+        {
+            return NULL;
+        }
+        s->buckets         = buckets;
+        s->bucket_capacity = capacity;
+    }
+
+    memmove(&s->buckets[i + 1], &s->buckets[i], (s->bucket_count - i) * sizeof(TsdbBucket));
+    memset(&s->buckets[i], 0, sizeof(TsdbBucket));
+    s->buckets[i].bucket     = bucket;
+    s->buckets[i].chk_sorted = 1;
+    s->buckets[i].chk_last   = INT64_MIN;
+    s->bucket_count++;
+    return &s->buckets[i];
+}
+
+/**
+ * series_flush - Append the pending records to their chunk files, one
+ *                write() per bucket they fall in.
+ *
+ * Records that could not be written stay pending.
+ */
+static int series_flush(Tsdb *tsdb, TsdbSeries *s)
+{
+    size_t done = 0;
+    int    rc   = 0;
+
+    while (done < s->pending_count)
+    {
+        /* The run of records in the bucket of the first one left */
+        int64_t bucket = bucket_of(s->pending[done].recv_time);
+        size_t  end    = done + 1;
+        while (end < s->pending_count && bucket_of(s->pending[end].recv_time) == bucket)
+        {
+            end++;
+        }
+
+        TsdbBucket *b = bucket_get(s, bucket);
+        if (!b)
+        {
+            rc = -1;
+            break;
+        }
+
+        char path[PATH_MAX];
+        bucket_path(tsdb, s->sensor_id, bucket, TSDB_CHUNK_SUFFIX, path, sizeof(path));
+        int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0664);
+        if (fd == -1 || write_all(fd, s->pending + done, (end - done) * sizeof(TsdbRecord)) != 0)
+        {
+            fprintf(stderr, "Error writing %s: %s\n", path, strerror(errno));
+            if (fd != -1)
+            {
+                close(fd);
+            }
+            rc = -1;
+            break;
+        }
+        close(fd);
+
+        for (size_t i = done; i < end; i++)
+        {
+            if (s->pending[i].recv_time < b->chk_last)
+            {
+                b->chk_sorted = 0;
+            }
+            b->chk_last = s->pending[i].recv_time;
+        }
+        b->chk_count += end - done;
+        done          = end;
+    }
+
+    memmove(s->pending, s->pending + done, (s->pending_count - done) * sizeof(TsdbRecord));
+    s->pending_count -= done;
+    return rc;
+}
+
+
+/**
+ * tsdb_append - Buffer one reading for its sensor until its batch commits.
+ */
+static int tsdb_append(void *impl, const StoredReading *reading)
+{
+    Tsdb    *tsdb   = impl;
+
+    pthread_mutex_lock(&tsdb->lock);
+
+    TsdbSeries *s = series_get(tsdb, reading->sensor_id, 1);
+    if (!s)
+    {
+        pthread_mutex_unlock(&tsdb->lock);
+        return -1;
+    }
+
+    if (s->pending_count == s->pending_capacity)
+    {
+        size_t      capacity = s->pending_capacity ? s->pending_capacity * 2 : 16;
+        TsdbRecord  *pending = realloc(s->pending, capacity * sizeof(TsdbRecord));
+        if (!pending)
+        {
+            pthread_mutex_unlock(&tsdb->lock);
+            return -1;
+        }
+        s->pending          = pending;
+        s->pending_capacity = capacity;
+    }
+
+    TsdbRecord *r = &s->pending[s->pending_count++];
+    memset(r, 0, sizeof(*r));
+    r->recv_time      = reading->recv_time;
+    r->x              = reading->x;
+    r->y              = reading->y;
+    r->z              = reading->z;
+    r->status         = reading->status;
+
+    if (!s->dirty)
+    {
+        if (tsdb->dirty_count == tsdb->dirty_capacity)
+        {
+            size_t  capacity = tsdb->dirty_capacity ? tsdb->dirty_capacity * 2 : 64;
+            int64_t *dirty   = realloc(tsdb->dirty, capacity * sizeof(int64_t));
+            if (!dirty)
+            {
+                pthread_mutex_unlock(&tsdb->lock);
+                return -1;
+            }
+            tsdb->dirty          = dirty;
+            tsdb->dirty_capacity = capacity;
+        }
+        tsdb->dirty[tsdb->dirty_count++] = s->sensor_id;
+        s->dirty = 1;
+    }
+
+    pthread_mutex_unlock(&tsdb->lock);
+    return 0;
+}
+
+/**
+ * tsdb_flush - Write every sensor's pending records, one write() per bucket.
+ *
+ * Records whose write fails belong to a committed batch now: they stay
+ * pending, are retried with the next flush and survive a discard.
+ */
+static int tsdb_flush(void *impl)
+{
+    Tsdb    *tsdb = impl;
+    size_t  kept  = 0;
+    int     rc    = 0;
+
+    pthread_mutex_lock(&tsdb->lock);
+    for (size_t i = 0; i < tsdb->dirty_count; i++)
+    {
+        TsdbSeries *s = tsdb->series[tsdb->dirty[i]];
+        if (series_flush(tsdb, s) != 0)
+        {
+            rc = -1;
+        }
+        s->pending_kept = s->pending_count;
+        s->dirty        = s->pending_count > 0;
+        if (s->dirty)
+        {
+            tsdb->dirty[kept++] = s->sensor_id;
+        }
+    }
+    tsdb->dirty_count = kept;
+    pthread_mutex_unlock(&tsdb->lock);
+
+    return rc;
+}
+
+/**
+ * tsdb_discard - Drop the records appended since the last flush.
+ */
+static void tsdb_discard(void *impl)
+{
+    Tsdb    *tsdb = impl;
+    size_t  kept  = 0;
+
+    pthread_mutex_lock(&tsdb->lock);
+    for (size_t i = 0; i < tsdb->dirty_count; i++)
+    {
+        TsdbSeries *s = tsdb->series[tsdb->dirty[i]];
+        s->pending_count = s->pending_kept;
+        s->dirty         = s->pending_count > 0;
+        if (s->dirty)
+        {
+            tsdb->dirty[kept++] = s->sensor_id;
+        }
+    }
+    tsdb->dirty_count = kept;
+    pthread_mutex_unlock(&tsdb->lock);
+}
+
+
+/**
+ * record_lower - First record with recv_time >= @from in a sorted array.
+ */
+static size_t record_lower(const TsdbRecord *records, size_t count, int64_t from)
+{
+    size_t lo = 0, hi = count;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (records[mid].recv_time < from)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * visit_records - Report records in [@from, @to); sorted arrays are binary searched.
+ *
+ * Return: records visited, or -1 - visited if the visitor stopped the query.
+ */
+static long visit_records(const TsdbRecord *records, size_t count, int sorted, int64_t sensor_id,
+                          int64_t from, int64_t to, reading_visitor_t visitor, void *ctx)
+{
+    long    visited = 0;
+    size_t  i       = sorted ? record_lower(records, count, from) : 0;
+
+    for (; i < count; i++)
+    {
+        const TsdbRecord *r = &records[i];
+        if (r->recv_time >= to)
+        {
+            if (sorted)
+            {
+                break;
+            }
+            continue;
+        }
+        if (r->recv_time < from)
+        {
+            continue;
+        }
+
+        visited++;
+        if (visitor)
+        {
+            StoredReading reading =
+            {
+                .sensor_id = sensor_id,
+                .recv_time = r->recv_time,
+                .x         = r->x,
+                .y         = r->y,
+                .z         = r->z,
+                .status    = r->status,
+            };
+            if (visitor(&reading, ctx) != 0)
+            {
+                return -1 - visited;
+            }
+        }
+    }
+    return visited;
+}
+
+/**
+ * visit_file - mmap a bucket file and report its records in range.
+ */
+static long visit_file(const char *path, size_t count, int sorted, int64_t sensor_id,
+                       int64_t from, int64_t to, reading_visitor_t visitor, void *ctx)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return 0;
+    }
+
+    size_t  len = count * sizeof(TsdbRecord);
+    void    *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return 0;
+    }
+
+    long visited = visit_records(map, count, sorted, sensor_id, from, to, visitor, ctx);
+    munmap(map, len);
+    return visited;
+}
+
+/**
+ * tsdb_query - Visit readings of one sensor in [@from, @to).
+ *
+ * Only buckets overlapping the range are opened. Compacted segments are
+ * reported in time order; records still in a chunk follow in arrival order.
+ */
+static long tsdb_query(void *impl, int64_t sensor_id, int64_t from, int64_t to,
+                       reading_visitor_t visitor, void *ctx)
+{
+    Tsdb    *tsdb  = impl;
+    long    total  = 0;
+    char    path[PATH_MAX];
+
+    pthread_mutex_lock(&tsdb->lock);
+
+    TsdbSeries *s = series_get(tsdb, sensor_id, 0);
+    if (!s || from >= to)
+    {
+        pthread_mutex_unlock(&tsdb->lock);
+        return 0;
+    }
+
+    int64_t last_bucket = bucket_of(to - 1);
+    for (size_t i = bucket_lower(s, bucket_of(from)); i < s->bucket_count && s->buckets[i].bucket <= last_bucket; i++)
+    {
+        TsdbBucket  *b = &s->buckets[i];
+        long        n;
+
+        bucket_path(tsdb, sensor_id, b->bucket, TSDB_SEGMENT_SUFFIX, path, sizeof(path));
+        n = visit_file(path, b->seg_count, 1, sensor_id, from, to, visitor, ctx);
+        if (n < 0)
+        {
+            total += -1 - n;
+            goto out;
+        }
+        total += n;
+
+        bucket_path(tsdb, sensor_id, b->bucket, TSDB_CHUNK_SUFFIX, path, sizeof(path));
+        n = visit_file(path, b->chk_count, b->chk_sorted, sensor_id, from, to, visitor, ctx);
+        if (n < 0)
+        {
+            total += -1 - n;
+            goto out;
+        }
+        total += n;
+    }
+
+    /* Readings appended but not flushed yet */
+    if (s->pending_count > 0)
+    {
+        long n = visit_records(s->pending, s->pending_count, 0, sensor_id, from, to, visitor, ctx);
+        total += (n < 0) ? -1 - n : n;
+    }
+
+out:
+    pthread_mutex_unlock(&tsdb->lock);
+    return total;
+}
+
+
+/**
+ * compare_records - qsort comparator, by receive time.
+ */
+static int compare_records(const void *a, const void *b)
+{
+    int64_t ta = ((const TsdbRecord *)a)->recv_time;
+    int64_t tb = ((const TsdbRecord *)b)->recv_time;
+    return (ta > tb) - (ta < tb);
+}
+
+/**
+ * read_file - Append the records of a bucket file to @records.
+ */
+static int read_file(const char *path, TsdbRecord *records, size_t count)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    size_t  len  = count * sizeof(TsdbRecord);
+    ssize_t got  = pread(fd, records, len, 0);
+    close(fd);
+    return (got == (ssize_t)len) ? 0 : -1;
+}
+
+/**
+ * sync_dir - fsync() a directory, making renames and unlinks in it durable.
+ */
+static int sync_dir(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    int rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+/**
+ * write_file - Create @path with @data and fsync() it.
+ */
+static int write_file(const char *path, const void *data, size_t len)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (fd == -1 || write_all(fd, data, len) != 0 || fsync(fd) != 0)
+    {
+        fprintf(stderr, "Error writing %s: %s\n", path, strerror(errno));
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        unlink(path);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * compact_bucket - Merge chunk and segment of a closed bucket into a sorted segment.
+ *
+ * The files are read, merged and written without the lock, from the counts
+ * seen when it starts; the lock is taken again only to swap the segment in.
+ * A bucket that changed meanwhile is left for the next pass.
+ *
+ * Return: 0 on success or when there was nothing to do, -1 on failure.
+ */
+static int compact_bucket(Tsdb *tsdb, int64_t sensor_id, int64_t bucket)
+{
+    char        dir[PATH_MAX], chk[PATH_MAX], seg[PATH_MAX], tmp[PATH_MAX + 8], mark[PATH_MAX];
+    TsdbSeries  *s;
+    TsdbBucket  *b;
+    size_t      i;
+
+    pthread_mutex_lock(&tsdb->lock);
+    s = series_get(tsdb, sensor_id, 0);
+    i = s ? bucket_lower(s, bucket) : 0;
+    if (!s || i == s->bucket_count || s->buckets[i].bucket != bucket || s->buckets[i].chk_count == 0)
+    {
+        pthread_mutex_unlock(&tsdb->lock);
+        return 0;
+    }
+    size_t seg_count = s->buckets[i].seg_count;
+    size_t chk_count = s->buckets[i].chk_count;
+    pthread_mutex_unlock(&tsdb->lock);
+
+    size_t      total   = seg_count + chk_count;
+    TsdbRecord  *records = malloc(total * sizeof(TsdbRecord));
+    if (!records)
+    {
+        return -1;
+    }
+
+    snprintf(dir, sizeof(dir), "%s/%lld", tsdb->dir, (long long)sensor_id);
+    bucket_path(tsdb, sensor_id, bucket, TSDB_CHUNK_SUFFIX, chk, sizeof(chk));
+    bucket_path(tsdb, sensor_id, bucket, TSDB_SEGMENT_SUFFIX, seg, sizeof(seg));
+    bucket_path(tsdb, sensor_id, bucket, TSDB_MARKER_SUFFIX, mark, sizeof(mark));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", seg);
+
+    /* Only appends touch a chunk, so its first chk_count records are stable */
+    if ((seg_count > 0 && read_file(seg, records, seg_count) != 0) ||
+        read_file(chk, records + seg_count, chk_count) != 0)
+    {
+        fprintf(stderr, "Error reading bucket %s for compaction\n", chk);
+        free(records);
+        return -1;
+    }
+
+    qsort(records, total, sizeof(TsdbRecord), compare_records);
+
+    /* Write the new segment next to the old one, then the marker that lets a restart finish the swap */
+    TsdbMarker marker = { .seg_count = total, .chk_count = chk_count };
+    int rc = write_file(tmp, records, total * sizeof(TsdbRecord));
+    free(records);
+    if (rc != 0 || write_file(mark, &marker, sizeof(marker)) != 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+
+    pthread_mutex_lock(&tsdb->lock);
+    i = bucket_lower(s, bucket);
+    b = (i < s->bucket_count && s->buckets[i].bucket == bucket) ? &s->buckets[i] : NULL;
+    if (!b || b->seg_count != seg_count || b->chk_count != chk_count)
+    {
+        pthread_mutex_unlock(&tsdb->lock);                           /* Appended to meanwhile: next pass */
+        unlink(tmp);
+        unlink(mark);
+        return 0;
+    }
+
+    /* Segment in, then chunk out, each made durable before the marker goes */
+    rc = rename(tmp, seg);
+    if (rc == 0)
+    {
+        sync_dir(dir);
+        unlink(chk);
+        sync_dir(dir);
+        unlink(mark);
+
+        b->seg_count  = total;
+        b->chk_count  = 0;
+        b->chk_sorted = 1;
+        b->chk_last   = INT64_MIN;
+    }
+    pthread_mutex_unlock(&tsdb->lock);
+
+    if (rc != 0)
+    {
+        fprintf(stderr, "Error renaming %s: %s\n", tmp, strerror(errno));
+        unlink(tmp);
+        unlink(mark);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * tsdb_compact - Compact every closed bucket that still has a chunk.
+ *
+ * The lock is held only to pick the next bucket and to swap it in, so
+ * ingest and queries interleave with a long compaction run.
+ */
+static int tsdb_compact(void *impl)
+{
+    Tsdb    *tsdb    = impl;
+    int64_t current  = bucket_of(now_ms());
+    int     rc       = 0;
+
+    pthread_mutex_lock(&tsdb->lock);
+    size_t capacity = tsdb->series_capacity;
+    pthread_mutex_unlock(&tsdb->lock);
+
+    for (size_t id = 1; id < capacity; id++)
+    {
+        int64_t next = INT64_MIN;
+
+        for (;;)
+        {
+            /* Next closed bucket with a chunk, by number: the index can move while unlocked */
+            pthread_mutex_lock(&tsdb->lock);
+            TsdbSeries  *s      = tsdb->series[id];
+            int64_t     bucket  = INT64_MAX;
+            if (s)
+            {
+                for (size_t i = bucket_lower(s, next); i < s->bucket_count && s->buckets[i].bucket < current; i++)
+                {
+                    if (s->buckets[i].chk_count > 0)
+                    {
+                        bucket = s->buckets[i].bucket;
+                        break;
+                    }
+                }
+            }
+            pthread_mutex_unlock(&tsdb->lock);
+
+            if (bucket == INT64_MAX)
+            {
+                break;
+            }
+            if (compact_bucket(tsdb, (int64_t)id, bucket) != 0)
+            {
+                rc = -1;
+            }
+            next = bucket + 1;
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * compactor_thread - Run tsdb_compact() every TSDB_COMPACT_INTERVAL seconds.
+ */
+static void *compactor_thread(void *arg)
+{
+    Tsdb *tsdb = arg;
+
+    pthread_mutex_lock(&tsdb->lock);
+    while (tsdb->running)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += TSDB_COMPACT_INTERVAL;
+        pthread_cond_timedwait(&tsdb->wake, &tsdb->lock, &deadline);
+        if (!tsdb->running)
+        {
+            break;
+        }
+
+        pthread_mutex_unlock(&tsdb->lock);
+        tsdb_compact(tsdb);
+        pthread_mutex_lock(&tsdb->lock);
+    }
+    pthread_mutex_unlock(&tsdb->lock);
+
+    return NULL;
+}
+
+
+/**
+ * recover_compaction - Finish or undo a compaction cut short by a crash.
+ */
+static void recover_compaction(const Tsdb *tsdb, int64_t sensor_id, int64_t bucket)
+{
+    char        dir[PATH_MAX], mark[PATH_MAX], chk[PATH_MAX], seg[PATH_MAX], tmp[PATH_MAX + 8];
+    TsdbMarker  marker;
+    struct stat st;
+
+    snprintf(dir, sizeof(dir), "%s/%lld", tsdb->dir, (long long)sensor_id);
+    bucket_path(tsdb, sensor_id, bucket, TSDB_MARKER_SUFFIX, mark, sizeof(mark));
+    bucket_path(tsdb, sensor_id, bucket, TSDB_CHUNK_SUFFIX, chk, sizeof(chk));
+    bucket_path(tsdb, sensor_id, bucket, TSDB_SEGMENT_SUFFIX, seg, sizeof(seg));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", seg);
+
+    int fd = open(mark, O_RDONLY);
+    if (fd != -1 && read(fd, &marker, sizeof(marker)) == (ssize_t)sizeof(marker) &&
+        stat(seg, &st) == 0 && (uint64_t)st.st_size == marker.seg_count * sizeof(TsdbRecord))
+    {
+        /* The merged segment is in: drop the chunk it was merged from */
+        if (stat(chk, &st) == 0 && (uint64_t)st.st_size <= marker.chk_count * sizeof(TsdbRecord))
+        {
+            unlink(chk);
+        }
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    /* Otherwise the old segment and the chunk are intact and the merge is redone */
+    unlink(tmp);
+    sync_dir(dir);
+    unlink(mark);
+}
+
+/**
+ * load_index - Rebuild the bucket index from the files in the data directory.
+ */
+static void load_index(Tsdb *tsdb)
+{
+    DIR *top = opendir(tsdb->dir);
+    if (!top)
+    {
+        return;
+    }
+
+    struct dirent *sensor_entry;
+    while ((sensor_entry = readdir(top)) != NULL)
+    {
+        char    *end;
+        long long sensor_id = strtoll(sensor_entry->d_name, &end, 10);
+        if (*end != '\0' || sensor_id <= 0)
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", tsdb->dir, sensor_entry->d_name);
+        DIR *sub = opendir(path);
+        if (!sub)
+        {
+            continue;
+        }
+
+        /* Settle interrupted compactions before the files are counted */
+        struct dirent   *file;
+        while ((file = readdir(sub)) != NULL)
+        {
+            long long bucket = strtoll(file->d_name, &end, 10);
+            if (end != file->d_name && strcmp(end, TSDB_MARKER_SUFFIX) == 0)
+            {
+                recover_compaction(tsdb, sensor_id, bucket);
+            }
+        }
+        rewinddir(sub);
+
+        TsdbSeries      *s = series_get(tsdb, sensor_id, 1);
+        while (s && (file = readdir(sub)) != NULL)
+        {
+            long long bucket = strtoll(file->d_name, &end, 10);
+            int is_chunk     = strcmp(end, TSDB_CHUNK_SUFFIX) == 0;
+            if (end == file->d_name || (!is_chunk && strcmp(end, TSDB_SEGMENT_SUFFIX) != 0))
+            {
+                continue;                                            /* Not a bucket file (e.g. a stale .tmp) */
+            }
+
+            struct stat st;
+            if (fstatat(dirfd(sub), file->d_name, &st, 0) != 0)
+            {
+                continue;
+            }
+
+            TsdbBucket *b = bucket_get(s, bucket);
+            if (!b)
+            {
+                continue;
+            }
+            if (is_chunk)
+            {
+                b->chk_count  = (size_t)st.st_size / sizeof(TsdbRecord);
+                b->chk_sorted = 0;                                   /* Unknown, scan it linearly */
+                b->chk_last   = INT64_MAX;
+            }
+            else
+            {
+                b->seg_count  = (size_t)st.st_size / sizeof(TsdbRecord);
+            }
+        }
+        closedir(sub);
+    }
+    closedir(top);
+}
+
+/**
+ * tsdb_close - Stop the compactor, write pending records and free the index.
+ */
+static void tsdb_close(void *impl)
+{
+    Tsdb *tsdb = impl;
+
+    pthread_mutex_lock(&tsdb->lock);
+    tsdb->running = 0;
+    pthread_cond_signal(&tsdb->wake);
+    pthread_mutex_unlock(&tsdb->lock);
+    pthread_join(tsdb->compactor, NULL);
+
+    tsdb_flush(tsdb);
+
+    for (size_t i = 0; i < tsdb->series_capacity; i++)
+    {
+        if (tsdb->series[i])
+        {
+            free(tsdb->series[i]->buckets);
+            free(tsdb->series[i]->pending);
+            free(tsdb->series[i]);
+        }
+    }
+    free(tsdb->series);
+    free(tsdb->dirty);
+    pthread_mutex_destroy(&tsdb->lock);
+    pthread_cond_destroy(&tsdb->wake);
+    free(tsdb);
+}
+
+static const ReadingStoreOps tsdb_ops =
+{
+    .append  = tsdb_append,
+    .flush   = tsdb_flush,
+    .discard = tsdb_discard,
+    .query   = tsdb_query,
+    .compact = tsdb_compact,
+    .close   = tsdb_close,
+};
+
+
+/**
+ * store_tsdb_open - Open (or create) a time-series store in @dir.
+ */
+int store_tsdb_open(const char *dir, ReadingStore *store)
+{
+    if (strlen(dir) >= TSDB_DIR_MAX)
+    {
+        fprintf(stderr, "Time-series directory path too long: %s\n", dir);
+        return -1;
+    }
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST)
+    {
+        perror("mkdir");
+        return -1;
+    }
+
+    Tsdb *tsdb = calloc(1, sizeof(Tsdb));
+    if (!tsdb)
+    {
+        perror("calloc");
+        return -1;
+    }
+    snprintf(tsdb->dir, sizeof(tsdb->dir), "%s", dir);
+    pthread_mutex_init(&tsdb->lock, NULL);
+    pthread_cond_init(&tsdb->wake, NULL);
+
+    load_index(tsdb);
+
+    tsdb->running = 1;
+    if (pthread_create(&tsdb->compactor, NULL, compactor_thread, tsdb) != 0)
+    {
+        perror("pthread_create");
+        tsdb->running = 0;
+        free(tsdb);
+        return -1;
+    }
+
+    store->name = STORE_BACKEND_TSDB;
+    store->ops  = &tsdb_ops;
+    store->impl = tsdb;
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * string_arena.c: Append-only storage for many short strings
+ *
+ * Location names used to sit in fixed 100-byte slots, most of them empty.
+ * Here they are packed one after the other in 64 KiB blocks, each name
+ * taking its length plus one byte, and released all at once.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/string_arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * string_arena_add - Copy @len bytes of @s into the arena, NUL-terminated.
+ */
+const char *string_arena_add(StringArena *arena, const char *s, size_t len)
+{
+    StringArenaBlock *block = arena->head;
+
+    if (!block || block->size - block->used < len + 1)
+    {
+        size_t size = len + 1 > STRING_ARENA_BLOCK ? len + 1 : STRING_ARENA_BLOCK;
+        block = malloc(sizeof(StringArenaBlock) + size);
+        if (!block)
+        {
+            perror("malloc");
+            return NULL;
+        }
+        block->next = arena->head;
+        block->used = 0;
+        block->size = size;
+        arena->head = block;
+    }
+
+    char *copy = block->data + block->used;
+    memcpy(copy, s, len);
+    copy[len]    = '\0';
+    block->used += len + 1;
+    arena->bytes += len + 1;
+    return copy;
+}
+
+/**
+ * string_arena_join - Move every string of @src into @dst.
+ */
+void string_arena_join(StringArena *dst, StringArena *src)
+{
+    if (!src->head)
+    {
+        return;
+    }
+
+    /* @src's blocks go behind @dst's head, which keeps filling */
+    StringArenaBlock *last = src->head;
+    while (last->next)
+    {
+        last = last->next;
+    }
+    if (dst->head)
+    {
+        last->next      = dst->head->next;
+        dst->head->next = src->head;
+    }
+    else
+    {
+        dst->head = src->head;
+    }
+    dst->bytes += src->bytes;
+    memset(src, 0, sizeof(*src));
+}
+
+/**
+ * string_arena_free - Release every block of the arena.
+ */
+void string_arena_free(StringArena *arena)
+{
+    StringArenaBlock *block = arena->head;
+
+    while (block)
+    {
+        StringArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
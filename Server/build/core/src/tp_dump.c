@@ -0,0 +1,228 @@
+/**
+ * tp_dump.c: Timeline of the tracepoints of every stage in the Chrome trace format
+ *
+ * Stages built with make TRACEPOINTS=1 keep their latest events in a
+ * shared memory page per stage (see prk_tracepoint.h). This program copies
+ * them, running or not, and writes a JSON trace that chrome://tracing and
+ * https://ui.perfetto.dev open: one row per thread, spans for the
+ * instrumented functions and their arguments.
+ *
+ * Compilation:
+ *      gcc tp_dump.c prk_tracepoint.c -o out_tp_dump -lpthread -lrt
+ *
+ * Usage:
+ *      ./out_tp_dump [--stage <stage>]... [-o <file>]
+ *
+ * Features:
+ * - Without --stage, dumps every page found in TP_DUMP_SHM_DIR, including
+ *   those left by a stage that crashed.
+ * - Writes to stdout, or to <file> with -o.
+ * - Each ring holds the last PRK_TP_RING_EVENTS events of its thread; a
+ *   span whose start was overwritten shows as an end without a start,
+ *   which the viewers ignore.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/tp_dump.h"
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/**
+ * monotonic_ns - CLOCK_MONOTONIC in nanoseconds.
+ */
+static int64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * tp_clock - Conversion of the ticks of a page to CLOCK_MONOTONIC.
+ */
+void tp_clock(const PrkTpPage *page, TpClock *clock)
+{
+    clock->ticks = page->open_ticks;
+    clock->ns    = page->open_ns;
+    if (page->ticks_are_ns)
+    {
+        clock->ns_per_tick = 1.0;
+        return;
+    }
+
+    int64_t wait_ns = page->open_ns + (int64_t)TP_DUMP_CALIBRATE_MS * 1000000 - monotonic_ns();
+    if (wait_ns > 0)
+    {
+        usleep((useconds_t)(wait_ns / 1000));
+    }
+    uint64_t ticks = prk_tp_ticks();
+    int64_t  ns    = monotonic_ns();
+    clock->ns_per_tick = ticks > page->open_ticks ? (double)(ns - page->open_ns) / (double)(ticks - page->open_ticks)
+                                                  : 1.0;
+}
+
+/**
+ * write_args - Write the named arguments of an event.
+ */
+static void write_args(FILE *out, const PrkTpEvent *event)
+{
+    int written = 0;
+
+    for (int a = 0; a < 2; a++)
+    {
+        const char *name = prk_tp_event_name(event->event, a);
+        if (!name || (event->phase == PRK_TP_PHASE_END && event->args[a] == 0))
+        {
+            continue;
+        }
+        fprintf(out, "%s\"%s\":%llu", written++ ? "," : ",\"args\":{", name, (unsigned long long)event->args[a]);
+    }
+    if (written)
+    {
+        fputc('}', out);
+    }
+}
+
+/**
+ * tp_dump_page - Write the events of a page as Chrome trace events.
+ */
+size_t tp_dump_page(const PrkTpPage *page, FILE *out, int *first)
+{
+    static PrkTpEvent   events[PRK_TP_RING_EVENTS];
+    TpClock             clock;
+    size_t              written = 0;
+
+    tp_clock(page, &clock);
+    fprintf(out, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",\n", page->pid, page->stage);
+    *first = 0;
+
+    for (int r = 0; r < PRK_TP_RINGS; r++)
+    {
+        size_t count = prk_tp_copy_ring(&page->rings[r], events);
+        for (size_t e = 0; e < count; e++)
+        {
+            const char *name = prk_tp_event_name(events[e].event, -1);
+            if (!name)
+            {
+                continue;
+            }
+            double us = ((double)clock.ns + ((double)events[e].ticks - (double)clock.ticks) * clock.ns_per_tick) / 1e3;
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+                    name, page->stage, events[e].phase, us, page->pid, events[e].tid);
+            if (events[e].phase == PRK_TP_PHASE_INSTANT)
+            {
+                fprintf(out, ",\"s\":\"t\"");
+            }
+            write_args(out, &events[e]);
+            fputc('}', out);
+            written++;
+        }
+    }
+    return written;
+}
+
+/**
+ * main - Entry point of the program
+ *
+ * Return: 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    const char  *stages[TP_DUMP_MAX_STAGES];
+    char        *listed[TP_DUMP_MAX_STAGES];
+    size_t      count = 0, listed_count = 0;
+    const char  *path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stage") == 0 && i + 1 < argc && count < TP_DUMP_MAX_STAGES)
+        {
+            stages[count++] = argv[++i];
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            path = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--stage <stage>]... [-o <file>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* Every page there is, without --stage */
+    if (count == 0)
+    {
+        const char  *prefix     = PRK_TP_PREFIX + 1;                 /* Listed without the leading '/' */
+        size_t      prefix_len  = strlen(prefix);
+        DIR         *dir        = opendir(TP_DUMP_SHM_DIR);
+        if (!dir)
+        {
+            perror(TP_DUMP_SHM_DIR);
+            return 1;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL && listed_count < TP_DUMP_MAX_STAGES)
+        {
+            if (strncmp(entry->d_name, prefix, prefix_len) == 0 && entry->d_name[prefix_len] != '\0')
+            {
+                listed[listed_count] = strdup(entry->d_name + prefix_len);
+                stages[count++]      = listed[listed_count++];
+            }
+        }
+        closedir(dir);
+    }
+
+    FILE *out = path ? fopen(path, "w") : stdout;
+    if (!out)
+    {
+        perror(path);
+        return 1;
+    }
+
+    int     first   = 1;
+    size_t  events  = 0, pages = 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < count; i++)
+    {
+        const PrkTpPage *page = prk_tp_map(stages[i]);
+        if (!page)
+        {
+            fprintf(stderr, "No tracepoints for stage %s: was it built with TRACEPOINTS=1?\n", stages[i]);
+            continue;
+        }
+        events += tp_dump_page(page, out, &first);
+        if (page->lost_threads > 0)
+        {
+            fprintf(stderr, "%s: %llu thread(s) found no free ring\n", page->stage,
+                    (unsigned long long)page->lost_threads);
+        }
+        prk_tp_unmap(page);
+        pages++;
+    }
+    fprintf(out, "\n]}\n");
+
+    for (size_t i = 0; i < listed_count; i++)
+    {
+        free(listed[i]);
+    }
+    int rc = ferror(out) ? 1 : 0;
+    if (path)
+    {
+        rc |= fclose(out) != 0;
+        fprintf(stderr, "%zu event(s) of %zu stage(s) written to %s\n", events, pages, path);
+    }
+    return rc;
+}
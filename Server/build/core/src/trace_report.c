@@ -0,0 +1,168 @@
+/**
+ * trace_report.c: Latency quantiles of each hop of the traced records
+ *
+ * Reads the per hop histograms the inserter keeps for traced records (see
+ * trace_sink.h) from its metrics page and prints count, p50, p99 and p999
+ * of each hop, from the STM32 to the database commit, and end to end.
+ *
+ * Compilation:
+ *      gcc trace_report.c prk_metrics.c -o out_trace_report -lpthread -lrt
+ *
+ * Usage:
+ *      ./out_trace_report [--stage <stage>] [--interval <s>]
+ *
+ * Features:
+ * - Without --interval, reports everything since the inserter started.
+ * - --interval <s> reports the values recorded over the next <s> seconds.
+ * - Quantiles are estimated inside log-linear buckets, within 25%.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/trace_report.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/**
+ * trace_snapshot - Read the trace histograms of a metrics page.
+ */
+size_t trace_snapshot(const PrkMetricsPage *page, TraceSnapshot *snapshots, size_t max)
+{
+    uint32_t    metrics = atomic_load_explicit(&page->count, memory_order_acquire);
+    size_t      count   = 0;
+
+    for (uint32_t i = 0; i < metrics && i < PRK_METRICS_MAX && count < max; i++)
+    {
+        const PrkMetricDesc *desc = &page->metrics[i];
+        if (desc->type == PRK_METRIC_HISTOGRAM &&
+            strncmp(desc->name, TRACE_REPORT_PREFIX, strlen(TRACE_REPORT_PREFIX)) == 0)
+        {
+            snapshots[count].desc  = desc;
+            snapshots[count].count = prk_histogram_read(page, desc, snapshots[count].buckets, NULL);
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * hop_name - Label of a trace histogram: its hop, or what follows the prefix.
+ */
+static void hop_name(const PrkMetricDesc *desc, char *buf, size_t size)
+{
+    const char *hop = strstr(desc->name, "hop=\"");
+    if (hop)
+    {
+        hop += 5;
+        snprintf(buf, size, "%.*s", (int)strcspn(hop, "\""), hop);
+        return;
+    }
+
+    const char *name = desc->name + strlen(TRACE_REPORT_PREFIX);
+    const char *unit = strstr(name, "_seconds");
+    snprintf(buf, size, "%.*s", unit ? (int)(unit - name) : (int)strlen(name), name);
+}
+
+/**
+ * trace_report - Print count, p50, p99 and p999 of each hop.
+ */
+void trace_report(const TraceSnapshot *now, const TraceSnapshot *before, size_t count, FILE *out)
+{
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+    uint64_t            buckets[PRK_HISTOGRAM_BUCKETS];
+    char                name[PRK_METRICS_NAME_LEN];
+
+    fprintf(out, "%-14s %10s %12s %12s %12s\n", "hop", "count", "p50 ms", "p99 ms", "p999 ms");
+    for (size_t h = 0; h < count; h++)
+    {
+        uint64_t total = 0;
+        for (unsigned b = 0; b < PRK_HISTOGRAM_BUCKETS; b++)
+        {
+            buckets[b] = now[h].buckets[b] - (before ? before[h].buckets[b] : 0);
+            total     += buckets[b];
+        }
+
+        hop_name(now[h].desc, name, sizeof(name));
+        fprintf(out, "%-14s %10llu", name, (unsigned long long)total);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+        {
+            if (total == 0)
+            {
+                fprintf(out, " %12s", "-");
+                continue;
+            }
+            double value = prk_histogram_quantile(buckets, total, quantiles[q]);
+            fprintf(out, " %12.3f", value / now[h].desc->scale * 1e3);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+/**
+ * main - Entry point of the program
+ *
+ * Return: 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    const char  *stage    = TRACE_REPORT_STAGE;
+    int         interval  = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stage") == 0 && i + 1 < argc)
+        {
+            stage = argv[++i];
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            interval = atoi(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--stage <stage>] [--interval <s>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const PrkMetricsPage *page = prk_metrics_map(stage);
+    if (!page)
+    {
+        fprintf(stderr, "No metrics page for stage %s: is it running?\n", stage);
+        return 1;
+    }
+
+    static TraceSnapshot    before[TRACE_REPORT_MAX];
+    static TraceSnapshot    now[TRACE_REPORT_MAX];
+    size_t                  count = trace_snapshot(page, before, TRACE_REPORT_MAX);
+    if (count == 0)
+    {
+        fprintf(stderr, "Stage %s has no trace histograms\n", stage);
+        prk_metrics_unmap(page);
+        return 1;
+    }
+
+    if (interval > 0)
+    {
+        sleep((unsigned)interval);
+        trace_snapshot(page, now, count);
+        printf("Traced records over the last %d s:\n", interval);
+        trace_report(now, before, count, stdout);
+    }
+    else
+    {
+        printf("Traced records since %s started:\n", page->stage);
+        trace_report(before, NULL, count, stdout);
+    }
+
+    prk_metrics_unmap(page);
+    return 0;
+}
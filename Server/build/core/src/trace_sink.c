@@ -0,0 +1,142 @@
+/**
+ * trace_sink.c: Per hop latencies of traced records
+ *
+ * Records traced by the gateway carry a stamp of every stage they passed
+ * (see prk_trace.h). The inserter hands the trace of each stored record
+ * here; once the batch holding it is committed, the time between each
+ * pair of consecutive stamps goes into the histogram of that hop, and the
+ * time from the first stamp to the commit into the end to end histogram.
+ * out_trace_report prints their quantiles.
+ *
+ * Version: v1.0
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *
+ */
+
+#include "../inc/trace_sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * trace_sink_init - Register the trace metrics of the inserter.
+ */
+int trace_sink_init(TraceSink *sink, int enabled)
+{
+    char name[PRK_METRICS_NAME_LEN];
+
+    memset(sink, 0, sizeof(*sink));
+    sink->enabled = enabled;
+    sink->pending = malloc(TRACE_SINK_BATCH * sizeof(*sink->pending));
+    if (!sink->pending)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    for (int stage = PRK_TRACE_CTL; stage < PRK_TRACE_STAGES; stage++)
+    {
+        snprintf(name, sizeof(name), "prk_trace_hop_seconds{hop=\"%s-%s\"}", prk_trace_stage_name(stage - 1),
+                 prk_trace_stage_name(stage));
+        sink->hops[stage] = prk_histogram(name, "Time a traced record spent between two stages.", PRK_SCALE_NS);
+    }
+    sink->end_to_end = prk_histogram("prk_trace_end_to_end_seconds",
+                                     "Time from a traced record's first stamp to its commit.", PRK_SCALE_NS);
+    sink->traces     = prk_counter("prk_trace_records_total", "Traced records stored.");
+    sink->malformed  = prk_counter("prk_trace_malformed_total", "Trace suffixes that could not be parsed.");
+    sink->skewed     = prk_counter("prk_trace_skewed_hops_total",
+                                   "Hops that took negative time: clocks of two hosts disagree.");
+    sink->overflow   = prk_counter("prk_trace_overflow_total", "Traces dropped: too many in one batch.");
+    return 0;
+}
+
+/**
+ * trace_sink_add - Take the trace of a record being stored.
+ */
+void trace_sink_add(TraceSink *sink, const char *suffix, size_t len)
+{
+    if (!sink->enabled)
+    {
+        return;
+    }
+    if (sink->pending_count >= TRACE_SINK_BATCH)
+    {
+        prk_counter_inc(sink->overflow);
+        return;
+    }
+
+    PrkTrace *trace = &sink->pending[sink->pending_count];
+    if (prk_trace_parse(suffix, len, trace) != 0)
+    {
+        prk_counter_inc(sink->malformed);
+        return;
+    }
+    prk_trace_stamp(trace, PRK_TRACE_INS);
+    sink->pending_count++;
+}
+
+/**
+ * elapsed_ns - Time between two stamps, negative times counted as 0.
+ */
+static uint64_t elapsed_ns(TraceSink *sink, const PrkTraceStamp *from, const PrkTraceStamp *to)
+{
+    int64_t us = prk_trace_elapsed_us(from, to);
+    if (us < 0)
+    {
+        prk_counter_inc(sink->skewed);
+        return 0;
+    }
+    return (uint64_t)us * 1000u;
+}
+
+/**
+ * trace_sink_commit - Stamp the pending traces PRK_TRACE_DB and record them.
+ */
+void trace_sink_commit(TraceSink *sink)
+{
+    for (size_t i = 0; i < sink->pending_count; i++)
+    {
+        PrkTrace *trace = &sink->pending[i];
+        prk_trace_stamp(trace, PRK_TRACE_DB);
+
+        for (uint32_t s = 1; s < trace->count; s++)
+        {
+            const PrkTraceStamp *from = &trace->stamps[s - 1];
+            const PrkTraceStamp *to   = &trace->stamps[s];
+            if (to->stage == from->stage + 1)
+            {
+                prk_histogram_observe(sink->hops[to->stage], elapsed_ns(sink, from, to));
+            }
+        }
+        if (trace->count > 1)
+        {
+            prk_histogram_observe(sink->end_to_end,
+                                  elapsed_ns(sink, &trace->stamps[0], &trace->stamps[trace->count - 1]));
+        }
+        prk_counter_inc(sink->traces);
+    }
+    sink->pending_count = 0;
+}
+
+/**
+ * trace_sink_discard - Drop the pending traces of a batch that was rolled back.
+ */
+void trace_sink_discard(TraceSink *sink)
+{
+    sink->pending_count = 0;
+}
+
+/**
+ * trace_sink_free - Release the pending traces.
+ */
+void trace_sink_free(TraceSink *sink)
+{
+    free(sink->pending);
+    sink->pending       = NULL;
+    sink->pending_count = 0;
+}
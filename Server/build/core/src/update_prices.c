@@ -6,15 +6,22 @@
  * entries not present in the file are removed from the database.
  *
  * Compilation:
- *      gcc update_prices.c -o out_update_prices
+ *      gcc update_prices.c price_import.c price_sync.c string_arena.c price_table.c price_schedule.c prk_db.c \
+ *          -o out_update_prices -lsqlite3 -lpthread -lm
  *
  * Usage:
- *      ./out_update_prices
+ *      ./out_update_prices [--watch] [--schedules <file>] [price_file] [db_path]
  *
  * Features:
  * - Reads from a file defined by DATA_PRICE_FILE.
  * - Updates a SQLite database defined by DB_PATH.
  * - Adds new entries, updates existing ones, and removes missing ones.
+ * - Keeps every past price in Price_History, with the interval it applied in.
+ * - Parses the file in parallel (price_import.c); an invalid line changes nothing.
+ * - One embedded SQLite connection, one transaction for all changes.
+ * - Replaces the time-of-day and tiered rates with the schedule file's.
+ * - Publishes the result as the shared price table (price_table.h).
+ * - With --watch, runs again whenever either file is written.
  *
  * Version: v1.0
  * Date:    10-06-2024
@@ -24,246 +31,319 @@
  *   10-06-2024       Morris              v1.0            created
  *   09-09-2024     morris              v2.0            update
  *                                                        - cleate *.h file
- * 
+ *   19-10-2026       Morris              v2.1            embedded SQLite instead of sqlite3 processes,
+ *                                                        hash diff (price_sync.c) applied in one transaction
+ *   19-10-2026       Morris              v2.2            publish the shared price table, --watch
+ *   19-10-2026       Morris              v2.3            schedule file, --schedules
+ *   19-10-2026       Morris              v2.4            a missing default schedule file keeps the schedules
+ *   19-10-2026       Morris              v2.5            parallel import, merge diff
+ *   19-10-2026       Morris              v2.6            price history
+ *   19-10-2026       Morris              v2.7            --watch reports readiness to prk_sys_srv_run
+ *
  */
 
 
 #include "../inc/update_prices.h"
+#include "../inc/price_import.h"
+#include "../inc/price_table.h"
+#include "../inc/price_schedule.h"
+#include "../inc/prk_db.h"
+#include "../inc/prk_notify.h"
+#include <errno.h>
+#include <libgen.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+
+static volatile sig_atomic_t stop_requested = 0;                     /* Set by SIGTERM/SIGINT in --watch */
 
 
 
 /**
- * load_file_data - Loads data from a file into memory.
- * Note: The caller is responsible for freeing the allocated memory for file_data.
+ * realtime_ms - CLOCK_REALTIME in milliseconds, the clock of Price_History
+ */
+static int64_t realtime_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/**
+ * update_prices - Makes the Prices table match the price file.
  */
-int load_file_data(const char *data_price_file, CityPrice **file_data, size_t *file_count)
+int update_prices(sqlite3 *db, const char *data_price_file, PriceDiff *diff)
 {
-    FILE   *file = fopen(data_price_file, "r");
-    if (!file)
+    memset(diff, 0, sizeof(*diff));
+
+    PriceList           file_data;                                   /* Entries of the price file */
+    PriceImportStats    stats;
+    if (price_import_file(data_price_file, 0, &file_data, &stats) != 0)
     {
-        fprintf(stderr, "Error opening price file.\n");
+        fprintf(stderr, "Error loading data from file, prices left unchanged.\n");
         return 1;
     }
-
-    char   line[MAX_LINE_LENGTH];
-    size_t count    = 0;
-    size_t capacity = 10;
-    *file_data      = malloc(capacity * sizeof(CityPrice));          /* Allocate initial memory for file data */
-
-    while (fgets(line, sizeof(line), file))
+    if (stats.duplicates)
     {
-        if (count >= capacity)
-        {
-            capacity  *= 2;
-            *file_data = realloc(*file_data, capacity * sizeof(CityPrice));   /* Expand memory if capacity reached */
-        }
+        printf("%zu duplicate location(s) in %s, the last line of each wins.\n", stats.duplicates, data_price_file);
+    }
 
-        CityPrice *entry = &(*file_data)[count];
-        if (sscanf(line, "%99[^,], %lf", entry->city, &entry->price) == 2)
-        {
-            /* Trim trailing spaces from the city name */
-            size_t len       = strnlen(entry->city, sizeof(entry->city));
-            entry->city[len] = '\0';
-            count++;
-        }
+    PriceList db_data;                                               /* Rows of the Prices table */
+    if (load_price_table(db, &db_data) != 0)
+    {
+        fprintf(stderr, "Error loading data from database.\n");
+        price_list_free(&file_data);
+        return 1;
     }
 
-    fclose(file);
-    *file_count = count;
+    /* Compare both sides once, then write every change in one transaction */
+    int rc = diff_prices(&db_data, &file_data, diff) != 0 || apply_price_diff(db, diff, realtime_ms()) != 0;
 
-    return 0;
+    /* The diff's entries point into both lists, only its counts stay valid */
+    price_list_free(&file_data);
+    price_list_free(&db_data);
+
+    return rc;
 }
 
 
 /**
- * load_db_data - Loads data from a SQLite database into memory.
- * Note: The caller is responsible for freeing the allocated memory for db_data.
+ * publish_prices - Publish the Prices table as the next shared generation.
  */
-int load_db_data(const char *db_path, CityPrice **db_data, size_t *db_count)
+static int publish_prices(sqlite3 *db)
 {
-    char select_command[256];
-    snprintf(select_command, sizeof(select_command),
-            "sqlite %s \"SELECT location, price FROM Prices;\"",
-            db_path);
-
-    FILE *pipe = popen(select_command, "r");
-    if (!pipe)
+    PriceTableSource source;
+    if (price_table_load(db, &source) != 0)
     {
-        fprintf(stderr, "Error executing SQLite command: %s\n", select_command);
         return 1;
     }
 
-    size_t count = 0;
-    size_t capacity = 10;
-    *db_data = malloc(capacity * sizeof(CityPrice));                 /* Allocate initial memory for database data */
+    uint64_t generation = price_table_publish(PRICE_TABLE_NAME, &source);
+    if (generation)
+    {
+        printf("Published price table generation %llu (%zu prices, %zu schedules).\n",
+               (unsigned long long)generation, source.count, source.schedule_count);
+    }
+    else
+    {
+        fprintf(stderr, "Error publishing the price table.\n");
+    }
+    price_table_source_free(&source);
+    return generation ? 0 : 1;
+}
 
-    char city[MAX_LINE_LENGTH];
-    double price;
-    while (fscanf(pipe, "%99[^|]|%lf\n", city, &price) == 2)
+/**
+ * update_schedules - Replace the stored schedules with the schedule file's.
+ *
+ * A missing file keeps the stored schedules; it is an error only when the
+ * file was named with --schedules (@required).
+ */
+static int update_schedules(sqlite3 *db, const char *schedule_file, int required)
+{
+    ScheduleSet set;
+    int         parsed = price_schedule_parse(schedule_file, &set);
+    if (parsed == 1 && !required)
+    {
+        printf("No schedule file %s, keeping the previous schedules.\n", schedule_file);
+        return 0;
+    }
+    if (parsed != 0)
     {
-        if (count >= capacity)
+        if (parsed == 1)
         {
-            capacity *= 2;
-            *db_data = realloc(*db_data, capacity * sizeof(CityPrice));  /* Expand memory if capacity reached */
+            fprintf(stderr, "%s: %s\n", schedule_file, strerror(ENOENT));
         }
+        fprintf(stderr, "Keeping the previous schedules.\n");
+        return 1;
+    }
 
-        CityPrice *entry = &(*db_data)[count];
-        strncpy(entry->city, city, sizeof(entry->city));
-        entry->city[sizeof(entry->city) - 1] = '\0';                 /* Ensure null-termination of city name */
-        entry->price = price;
-        count++;
+    int rc = price_schedule_store(db, &set);
+    if (rc == 0)
+    {
+        printf("Schedules successfully updated: %zu rules, %zu tiers.\n", set.rule_count, set.tier_count);
     }
+    price_schedule_set_free(&set);
+    return rc != 0;
+}
 
-    pclose(pipe);
-    *db_count = count;
+/**
+ * sync_prices - Update Prices and the schedules from their files and publish them.
+ */
+static int sync_prices(sqlite3 *db, const char *data_price_file, const char *schedule_file, int schedule_required)
+{
+    PriceDiff diff;
+    int rc = update_prices(db, data_price_file, &diff);
 
-    return 0;
+    if (rc == 0)
+    {
+        printf("Prices successfully updated: %zu added, %zu changed, %zu removed, %zu unchanged.\n",
+               diff.insert_count, diff.update_count, diff.delete_count, diff.unchanged);
+    }
+    price_diff_free(&diff);
+
+    rc |= update_schedules(db, schedule_file, schedule_required);
+    rc |= publish_prices(db);                                        /* What the database now holds */
+    fflush(stdout);
+    return rc;
 }
 
+/**
+ * request_stop - SIGTERM/SIGINT handler of --watch.
+ */
+static void request_stop(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
 
 /**
- * update_prices - Updates prices in the database based on file data.
- * Note: This function assumes that the Prices table exists in the database.
+ * add_watch - Watch the directory of @path; its file name goes to @base.
+ *
+ * The directory is watched rather than the file, so editors and scripts
+ * that write a new file and rename it over the old one are seen too.
+ *
+ * Return: the watch descriptor, or -1.
  */
-void update_prices(const char *db_path, CityPrice *file_data, size_t file_count)
+static int add_watch(int fd, const char *path, char *base, size_t len)
 {
-    for (size_t i = 0; i < file_count; i++)
-    {
-        CityPrice *entry = &file_data[i];
-        char select_command[256];
-        snprintf(select_command, sizeof(select_command),
-                "sqlite %s \"SELECT price FROM Prices WHERE location='%s';\"",
-                db_path, entry->city);
-
-        FILE *pipe = popen(select_command, "r");
-        if (!pipe)
-        {
-            fprintf(stderr, "Error executing SQLite command: %s\n", select_command);
-            continue;
-        }
+    char dir_buf[4096], base_buf[4096];
+    snprintf(dir_buf, sizeof(dir_buf), "%s", path);
+    snprintf(base_buf, sizeof(base_buf), "%s", path);
+    snprintf(base, len, "%s", basename(base_buf));
 
-        double existing_price;
-        int found = fscanf(pipe, "%lf", &existing_price);            /* Check if city price already exists in database */
-        pclose(pipe);
+    int wd = inotify_add_watch(fd, dirname(dir_buf), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0)
+    {
+        perror(path);
+    }
+    return wd;
+}
 
-        if (found == 1)
+/**
+ * watch_prices - Sync again each time the price or schedule file is written or replaced.
+ */
+static int watch_prices(sqlite3 *db, const char *data_price_file, const char *schedule_file, int schedule_required)
+{
+    char    price_base[4096], schedule_base[4096];
+    int     fd          = inotify_init1(IN_CLOEXEC);
+    int     price_wd    = fd < 0 ? -1 : add_watch(fd, data_price_file, price_base, sizeof(price_base));
+    int     schedule_wd = price_wd < 0 ? -1 : add_watch(fd, schedule_file, schedule_base, sizeof(schedule_base));
+    if (schedule_wd < 0)
+    {
+        if (fd < 0)
         {
-            if (existing_price != entry->price)
-            {
-                char update_command[256];
-                snprintf(update_command, sizeof(update_command),
-                        "sqlite %s \"UPDATE Prices SET price=%.2f WHERE location='%s';\"",
-                        db_path, entry->price, entry->city);
-
-                int result = system(update_command);                 /* Execute update command in SQLite */
-                if (result != 0)
-                {
-                    fprintf(stderr, "Error executing SQLite command: %s\n", update_command);
-                }
-            }
+            perror("inotify");
         }
         else
         {
-            char insert_command[256];
-            snprintf(insert_command, sizeof(insert_command),
-                    "sqlite %s \"INSERT INTO Prices(location, price) VALUES('%s', %.2f);\"",
-                    db_path, entry->city, entry->price);
-
-            int result = system(insert_command);                     /* Execute insert command in SQLite */
-            if (result != 0)
-            {
-                fprintf(stderr, "Error executing SQLite command: %s\n", insert_command);
-            }
+            close(fd);
         }
+        return 1;
     }
-}
 
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;                                    /* No SA_RESTART: read() returns EINTR */
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    prk_notify_ready();                                              /* Prices published, watching */
 
-/**
- * delete_missing_cities - Deletes cities from the database not present in file data.
- * Note: This function assumes that the database and file data are both sorted and
- *       contain unique city names. It iterates through the database data and checks
- *       each city against the file data, removing those not found in the file.
- */
-void delete_missing_cities(const char *db_path,
-        CityPrice *db_data, size_t db_count, CityPrice *file_data, size_t file_count)
-{
-    for (size_t i = 0; i < db_count; i++)
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (!stop_requested)
     {
-        CityPrice *db_entry = &db_data[i];
-        int found = 0;
-
-        for (size_t j = 0; j < file_count; j++)
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len < 0)
         {
-            if (strcmp(db_entry->city, file_data[j].city) == 0)      /* Check if city exists in file data */
+            if (errno == EINTR)
             {
-                found = 1;
-                break;
+                continue;
             }
+            perror("read");
+            break;
         }
 
-        if (!found)
+        int changed = 0;
+        for (char *p = buf; p < buf + len; )
         {
-            char delete_command[256];
-            snprintf(delete_command, sizeof(delete_command),
-                    "sqlite %s \"DELETE FROM Prices WHERE location='%s';\"",
-                    db_path, db_entry->city);
-
-            int result = system(delete_command);                     /* Execute delete command in SQLite */
-            if (result != 0)
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->len > 0)
             {
-                fprintf(stderr, "Error executing SQLite command: %s\n", delete_command);
+                changed |= event->wd == price_wd && strcmp(event->name, price_base) == 0;
+                changed |= event->wd == schedule_wd && strcmp(event->name, schedule_base) == 0;
             }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+        if (changed)
+        {
+            /* A bad file is reported, the watch goes on */
+            sync_prices(db, data_price_file, schedule_file, schedule_required);
         }
     }
+
+    close(fd);
+    return 0;
 }
 
 
 /**
  * main - Main function to coordinate the update of prices.
  *
- * This function coordinates the overall process of updating prices in the database
- * based on the data from the file. It loads the file data and the database data,
- * updates the prices, deletes missing cities, and frees the allocated memory.
+ * This function opens the database (creating or upgrading its schema),
+ * makes the Prices table match the price file and the stored schedules
+ * match the schedule file, prints what changed and publishes the shared
+ * price table. With --watch it then keeps doing so each time either file
+ * changes, until SIGTERM or SIGINT. The price file, the schedule file and
+ * the database default to DATA_PRICE_FILE, SCHEDULE_FILE and DB_PATH; a
+ * missing default schedule file leaves the stored schedules as they are.
  *
  * @return: 0 on success, 1 on failure.
  */
-int main()
+int main(int argc, char *argv[])
 {
-    const char *db_path = "prksys_db.db";                            /* Path to the SQLite database */
-    const char *data_price_file = "prices.txt";                      /* Path to the input file containing prices */
+    const char  *schedule_file = SCHEDULE_FILE;
+    int         schedule_given = 0;
+    int         watch          = 0;
+    int         arg            = 1;
 
-    CityPrice *file_data = NULL;                                     /* Pointer to hold database data */
-    size_t file_count = 0;                                           /* Number of entries in file data */
-    if (load_file_data(data_price_file, &file_data, &file_count) != 0)
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++)
     {
-        fprintf(stderr, "Error loading data from file.\n");
-        return 1;
+        if (strcmp(argv[arg], "--watch") == 0)
+        {
+            watch = 1;
+        }
+        else if (strcmp(argv[arg], "--schedules") == 0 && arg + 1 < argc)
+        {
+            schedule_file  = argv[++arg];
+            schedule_given = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--watch] [--schedules <file>] [price_file] [db_path]\n", argv[0]);
+            return 1;
+        }
     }
 
-    CityPrice *db_data = NULL;                                       /* Pointer to hold database data */
-    size_t db_count = 0;                                             /* Number of entries in database data */
-    if (load_db_data(db_path, &db_data, &db_count) != 0)
+    const char *data_price_file = arg < argc ? argv[arg] : DATA_PRICE_FILE;
+    const char *db_path         = arg + 1 < argc ? argv[arg + 1] : DB_PATH;
+
+    sqlite3 *db = prk_db_open(db_path);
+    if (!db || prk_db_create_schema(db) != 0)
     {
-        fprintf(stderr, "Erro loading data from database.\n");
-        free(file_data);
+        prk_db_close(db);
         return 1;
     }
 
-    /* Update prices in the database based on file data */
-    update_prices(db_path, file_data, file_count);
-
-    /* Delete cities from the database that are not present in the file data */
-    delete_missing_cities(db_path, db_data, db_count, file_data, file_count);
-
-    /* Free allocated memory */
-    free(file_data);
-    free(db_data);
-
-    printf("Prices successfully updated.\n");
-    return 0;
+    int rc = sync_prices(db, data_price_file, schedule_file, schedule_given);
+    if (watch)
+    {
+        rc = watch_prices(db, data_price_file, schedule_file, schedule_given);
+    }
+    prk_db_close(db);
+    return rc;
 }
-
@@ -0,0 +1,698 @@
+/**
+ * zone_map.c: Map reading coordinates to parking zones
+ *
+ * Zones are rectangles stored in the Zones table (REAL coordinates, same
+ * units as the readings), or polygons listed in Zone_Vertices. They are
+ * loaded once and converted to the fixed point representation used by
+ * sensor_parser, and indexed by a uniform grid so that mapping a reading to
+ * its zone costs one cell and a few rectangle tests, independent of the
+ * number of zones; a polygon is only tested for points inside its bounding
+ * box.
+ *
+ * Version: v1.2
+ * Date:    19-10-2026
+ * Author:  Morris
+ *
+ * Date:            Name:               Version:        Modification:
+ *   19-10-2026       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            uniform grid index, batch lookup
+ *   19-10-2026       Morris              v1.2            polygon zones, batch classified per polygon
+ *
+ */
+
+#include "../inc/zone_map.h"
+#include "../inc/sensor_parser.h"
+#include "../inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <stdint.h>
+
+
+/* Scratch space of zone_map_lookup_batch() */
+typedef struct
+{
+    int64_t   best[ZONE_BATCH_CHUNK];                                /* Lowest zone id found per point, INT64_MAX if none */
+    double    x[ZONE_BATCH_CHUNK];                                   /* Coordinates of one polygon's group */
+    double    y[ZONE_BATCH_CHUNK];
+    uint32_t  member[ZONE_BATCH_CHUNK];                              /* Point of each group entry */
+    uint8_t   inside[ZONE_BATCH_CHUNK];                              /* pip_classify() result per group entry */
+    uint64_t  *pairs;                                                /* (zone index << 32) | point, to be tested */
+    uint64_t  *sorted;                                               /* Radix sort buffer, same size */
+    size_t    pair_capacity;
+} ZoneBatch;
+
+
+/**
+ * to_fixed - Convert a REAL coordinate to fixed point.
+ */
+static int32_t to_fixed(double value)
+{
+    return (int32_t)lround(value * COORD_SCALE);
+}
+
+/**
+ * compare_zone_id - qsort comparator, ascending Zones.id.
+ */
+static int compare_zone_id(const void *a, const void *b)
+{
+    int64_t ia = ((const Zone *)a)->id, ib = ((const Zone *)b)->id;
+    return (ia > ib) - (ia < ib);
+}
+
+/**
+ * zone_is_empty - Zone that contains no point (max <= min).
+ */
+static int zone_is_empty(const Zone *zone)
+{
+    return zone->x_max <= zone->x_min || zone->y_max <= zone->y_min;
+}
+
+/**
+ * zone_cells - Grid cells overlapped by @zone, as inclusive column and row ranges.
+ */
+static void zone_cells(const ZoneMap *map, const Zone *zone, uint32_t *col_lo, uint32_t *col_hi, uint32_t *row_lo,
+                       uint32_t *row_hi)
+{
+    *col_lo = (uint32_t)((zone->x_min - map->origin_x) >> map->cell_shift);
+    *col_hi = (uint32_t)(((int64_t)zone->x_max - 1 - map->origin_x) >> map->cell_shift);
+    *row_lo = (uint32_t)((zone->y_min - map->origin_y) >> map->cell_shift);
+    *row_hi = (uint32_t)(((int64_t)zone->y_max - 1 - map->origin_y) >> map->cell_shift);
+}
+
+/**
+ * grid_cell - Index of the grid cell of (@x, @y), or SIZE_MAX outside the grid.
+ */
+static inline size_t grid_cell(const ZoneMap *map, int32_t x, int32_t y)
+{
+    int64_t dx = (int64_t)x - map->origin_x;
+    int64_t dy = (int64_t)y - map->origin_y;
+    if (dx < 0 || dy < 0)
+    {
+        return SIZE_MAX;
+    }
+
+    int64_t column = dx >> map->cell_shift;
+    int64_t row    = dy >> map->cell_shift;
+    if (column >= map->columns || row >= map->rows)
+    {
+        return SIZE_MAX;                                             /* Also when there is no index */
+    }
+    return (size_t)row * map->columns + (size_t)column;
+}
+
+/**
+ * cell_lookup - Zone of @cell containing (@x, @y).
+ */
+static inline int64_t cell_lookup(const ZoneMap *map, size_t cell, int32_t x, int32_t y)
+{
+    for (uint32_t i = map->cell_start[cell]; i < map->cell_start[cell + 1]; i++)
+    {
+        const Zone *zone = &map->zones[map->cell_zones[i]];
+        if (x >= zone->x_min && x < zone->x_max && y >= zone->y_min && y < zone->y_max &&
+            (zone->edge_count == 0 || pip_contains(&map->edges[zone->first_edge], zone->edge_count, x, y)))
+        {
+            return zone->id;                                         /* Lists ascend, so the lowest id */
+        }
+    }
+    return 0;
+}
+
+/**
+ * reserve_zones - Make room for @more zones.
+ */
+static int reserve_zones(ZoneMap *map, size_t more)
+{
+    if (map->count + more <= map->capacity)
+    {
+        return 0;
+    }
+
+    size_t capacity = map->capacity ? map->capacity : 16;
+    while (capacity < map->count + more)
+    {
+        capacity *= 2;
+    }
+    Zone *zones = realloc(map->zones, capacity * sizeof(Zone));
+    if (!zones)
+    {
+        perror("realloc");
+        return -1;
+    }
+    map->zones    = zones;
+    map->capacity = capacity;
+    return 0;
+}
+
+/**
+ * reserve_edges - Make room for @more polygon edges.
+ */
+static int reserve_edges(ZoneMap *map, size_t more)
+{
+    if (map->edge_count + more <= map->edge_capacity)
+    {
+        return 0;
+    }
+    if (map->edge_count + more > UINT32_MAX)
+    {
+        fprintf(stderr, "Too many zone polygon edges\n");
+        return -1;
+    }
+
+    size_t capacity = map->edge_capacity ? map->edge_capacity : 64;
+    while (capacity < map->edge_count + more)
+    {
+        capacity *= 2;
+    }
+    PolygonEdge *edges = realloc(map->edges, capacity * sizeof(PolygonEdge));
+    if (!edges)
+    {
+        perror("realloc");
+        return -1;
+    }
+    map->edges         = edges;
+    map->edge_capacity = capacity;
+    return 0;
+}
+
+/**
+ * set_polygon - Make @zone the polygon of @count vertices, its rectangle the bounding box.
+ */
+static int set_polygon(ZoneMap *map, Zone *zone, const int32_t *x, const int32_t *y, size_t count)
+{
+    if (count < 3 || reserve_edges(map, count) != 0)
+    {
+        return -1;
+    }
+
+    int32_t x_lo = INT32_MAX, y_lo = INT32_MAX, x_hi = INT32_MIN, y_hi = INT32_MIN;
+    for (size_t v = 0; v < count; v++)
+    {
+        size_t next = (v + 1 == count) ? 0 : v + 1;                  /* Last edge closes the ring */
+        pip_edge(&map->edges[map->edge_count + v], x[v], y[v], x[next], y[next]);
+        x_lo = x[v] < x_lo ? x[v] : x_lo;
+        y_lo = y[v] < y_lo ? y[v] : y_lo;
+        x_hi = x[v] > x_hi ? x[v] : x_hi;
+        y_hi = y[v] > y_hi ? y[v] : y_hi;
+    }
+
+    zone->x_min      = x_lo;
+    zone->y_min      = y_lo;
+    zone->x_max      = x_hi == INT32_MAX ? x_hi : x_hi + 1;          /* Exclusive */
+    zone->y_max      = y_hi == INT32_MAX ? y_hi : y_hi + 1;
+    zone->first_edge = (uint32_t)map->edge_count;
+    zone->edge_count = (uint32_t)count;
+    map->edge_count += count;
+    return 0;
+}
+
+/**
+ * load_vertices - Turn the zones listed in Zone_Vertices into polygons.
+ */
+static int load_vertices(ZoneMap *map, sqlite3 *db)
+{
+    sqlite3_stmt *stmt = prk_db_prepare(db, "SELECT zone_id, x, y FROM Zone_Vertices ORDER BY zone_id, seq;");
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    int32_t *x        = NULL;
+    int32_t *y        = NULL;
+    size_t  count     = 0;
+    size_t  capacity  = 0;
+    int64_t zone_id   = 0;
+    int     rc        = 0;
+    int     step;
+    do
+    {
+        step = sqlite3_step(stmt);
+
+        /* A zone's vertices are complete at the next zone or the end */
+        if (count > 0 && (step != SQLITE_ROW || sqlite3_column_int64(stmt, 0) != zone_id))
+        {
+            Zone key  = { .id = zone_id };
+            Zone *zone = bsearch(&key, map->zones, map->count, sizeof(Zone), compare_zone_id);
+            if (!zone)
+            {
+                fprintf(stderr, "Zone_Vertices: zone %lld not in Zones, ignored\n", (long long)zone_id);
+            }
+            else if (count < 3)
+            {
+                fprintf(stderr, "Zone_Vertices: zone %lld has %zu vertices, kept as a rectangle\n",
+                        (long long)zone_id, count);
+            }
+            else if (set_polygon(map, zone, x, y, count) != 0)
+            {
+                rc = -1;
+                break;
+            }
+            count = 0;
+        }
+        if (step != SQLITE_ROW)
+        {
+            break;
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            int32_t *grown_x = realloc(x, capacity * sizeof(int32_t));
+            int32_t *grown_y = grown_x ? realloc(y, capacity * sizeof(int32_t)) : NULL;
+            x = grown_x ? grown_x : x;
+            y = grown_y ? grown_y : y;
+            if (!grown_x || !grown_y)
+            {
+                perror("realloc");
+                rc = -1;
+                break;
+            }
+        }
+        zone_id  = sqlite3_column_int64(stmt, 0);
+        x[count] = to_fixed(sqlite3_column_double(stmt, 1));
+        y[count] = to_fixed(sqlite3_column_double(stmt, 2));
+        count++;
+    } while (1);
+
+    if (rc == 0 && step != SQLITE_DONE)
+    {
+        fprintf(stderr, "Reading Zone_Vertices failed: %s\n", sqlite3_errmsg(db));
+        rc = -1;
+    }
+    sqlite3_finalize(stmt);
+    free(x);
+    free(y);
+    return rc;
+}
+
+/**
+ * zone_map_load - Load every zone from the Zones and Zone_Vertices tables.
+ */
+int zone_map_load(ZoneMap *map, sqlite3 *db)
+{
+    memset(map, 0, sizeof(*map));
+
+    sqlite3_stmt *stmt = prk_db_prepare(db, "SELECT id, x_min, y_min, x_max, y_max FROM Zones ORDER BY id;");
+    if (!stmt)
+    {
+        return -1;
+    }
+
+    int step;
+    while ((step = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (reserve_zones(map, 1) != 0)
+        {
+            sqlite3_finalize(stmt);
+            zone_map_free(map);
+            return -1;
+        }
+
+        Zone *zone       = &map->zones[map->count++];
+        zone->id         = sqlite3_column_int64(stmt, 0);
+        zone->x_min      = to_fixed(sqlite3_column_double(stmt, 1));
+        zone->y_min      = to_fixed(sqlite3_column_double(stmt, 2));
+        zone->x_max      = to_fixed(sqlite3_column_double(stmt, 3));
+        zone->y_max      = to_fixed(sqlite3_column_double(stmt, 4));
+        zone->first_edge = 0;
+        zone->edge_count = 0;
+    }
+    if (step != SQLITE_DONE)
+    {
+        fprintf(stderr, "Reading Zones failed: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        zone_map_free(map);
+        return -1;
+    }
+    sqlite3_finalize(stmt);
+
+    if (load_vertices(map, db) != 0 || zone_map_build(map) != 0)
+    {
+        zone_map_free(map);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * zone_map_add_polygon - Append a polygon zone (before zone_map_build()).
+ */
+int zone_map_add_polygon(ZoneMap *map, int64_t id, const int32_t *x, const int32_t *y, size_t count)
+{
+    if (reserve_zones(map, 1) != 0)
+    {
+        return -1;
+    }
+
+    Zone *zone = &map->zones[map->count];
+    zone->id   = id;
+    if (set_polygon(map, zone, x, y, count) != 0)
+    {
+        return -1;
+    }
+    map->count++;
+    return 0;
+}
+
+/**
+ * zone_map_build - Sort the zones by id and (re)build the grid index.
+ */
+int zone_map_build(ZoneMap *map)
+{
+    free(map->cell_start);
+    free(map->cell_zones);
+    map->cell_start = NULL;
+    map->cell_zones = NULL;
+    map->columns    = 0;
+    map->rows       = 0;
+    map->cell_shift = 0;
+
+    if (map->count == 0)
+    {
+        return 0;
+    }
+    qsort(map->zones, map->count, sizeof(Zone), compare_zone_id);
+
+    /* Bounding box and mean edge of the zones that can contain a point */
+    int64_t x_lo = INT64_MAX, y_lo = INT64_MAX, x_hi = INT64_MIN, y_hi = INT64_MIN;
+    double  edges = 0;
+    size_t  used  = 0;
+    for (size_t i = 0; i < map->count; i++)
+    {
+        const Zone *zone = &map->zones[i];
+        if (zone_is_empty(zone))
+        {
+            continue;
+        }
+        x_lo   = zone->x_min < x_lo ? zone->x_min : x_lo;
+        y_lo   = zone->y_min < y_lo ? zone->y_min : y_lo;
+        x_hi   = zone->x_max > x_hi ? zone->x_max : x_hi;
+        y_hi   = zone->y_max > y_hi ? zone->y_max : y_hi;
+        edges += ((double)zone->x_max - zone->x_min + (double)zone->y_max - zone->y_min) / 2;
+        used++;
+    }
+    if (used == 0)
+    {
+        return 0;
+    }
+
+    /* Power of two at least the mean zone edge (cells are found by shifting), doubled while there are too many */
+    double   mean_edge = edges / (double)used;
+    uint64_t max_cells = (uint64_t)ZONE_GRID_CELLS_PER_ZONE * used;
+    uint64_t columns, rows;
+    int      shift     = 0;
+    while ((double)(1LL << shift) < mean_edge)
+    {
+        shift++;
+    }
+    while (1)
+    {
+        columns = (uint64_t)(((x_hi - x_lo - 1) >> shift) + 1);
+        rows    = (uint64_t)(((y_hi - y_lo - 1) >> shift) + 1);
+        if (columns * rows <= max_cells || (columns == 1 && rows == 1))
+        {
+            break;
+        }
+        shift++;
+    }
+    map->origin_x   = x_lo;
+    map->origin_y   = y_lo;
+    map->cell_shift = shift;
+
+    /* Count the zones of every cell, then fill the lists in zone order */
+    size_t   cells  = (size_t)(columns * rows);
+    uint32_t *start = calloc(cells + 1, sizeof(uint32_t));
+    uint32_t *next  = malloc(cells * sizeof(uint32_t));
+    if (!start || !next)
+    {
+        perror("calloc");
+        free(start);
+        free(next);
+        return -1;
+    }
+
+    uint64_t entries = 0;
+    for (size_t i = 0; i < map->count; i++)
+    {
+        uint32_t col_lo, col_hi, row_lo, row_hi;
+        if (zone_is_empty(&map->zones[i]))
+        {
+            continue;
+        }
+        zone_cells(map, &map->zones[i], &col_lo, &col_hi, &row_lo, &row_hi);
+        for (uint32_t row = row_lo; row <= row_hi; row++)
+        {
+            for (uint32_t column = col_lo; column <= col_hi; column++)
+            {
+                start[(size_t)row * columns + column + 1]++;
+            }
+        }
+        entries += (uint64_t)(col_hi - col_lo + 1) * (row_hi - row_lo + 1);
+    }
+    if (entries > UINT32_MAX)
+    {
+        fprintf(stderr, "Zone index too large (%llu entries)\n", (unsigned long long)entries);
+        free(start);
+        free(next);
+        return -1;
+    }
+    for (size_t cell = 0; cell < cells; cell++)
+    {
+        start[cell + 1] += start[cell];
+        next[cell]       = start[cell];
+    }
+
+    uint32_t *cell_zones = malloc((entries ? entries : 1) * sizeof(uint32_t));
+    if (!cell_zones)
+    {
+        perror("malloc");
+        free(start);
+        free(next);
+        return -1;
+    }
+    for (size_t i = 0; i < map->count; i++)
+    {
+        uint32_t col_lo, col_hi, row_lo, row_hi;
+        if (zone_is_empty(&map->zones[i]))
+        {
+            continue;
+        }
+        zone_cells(map, &map->zones[i], &col_lo, &col_hi, &row_lo, &row_hi);
+        for (uint32_t row = row_lo; row <= row_hi; row++)
+        {
+            for (uint32_t column = col_lo; column <= col_hi; column++)
+            {
+                cell_zones[next[(size_t)row * columns + column]++] = (uint32_t)i;
+            }
+        }
+    }
+    free(next);
+
+    map->columns    = (uint32_t)columns;
+    map->rows       = (uint32_t)rows;
+    map->cell_start = start;
+    map->cell_zones = cell_zones;
+    return 0;
+}
+
+/**
+ * zone_map_lookup - Zone containing the point (@x, @y).
+ */
+int64_t zone_map_lookup(const ZoneMap *map, int32_t x, int32_t y)
+{
+    size_t cell = grid_cell(map, x, y);
+    return cell == SIZE_MAX ? 0 : cell_lookup(map, cell, x, y);
+}
+
+/**
+ * sort_pairs - Radix sort (zone index << 32 | point) pairs by zone index.
+ *
+ * Stable, so each zone's points stay in batch order.
+ * Return: @pairs or @buffer, whichever holds the result.
+ */
+static uint64_t *sort_pairs(uint64_t *pairs, uint64_t *buffer, size_t count, size_t zones)
+{
+    int bits = 0;
+    while (bits < 32 && ((size_t)1 << bits) < zones)
+    {
+        bits++;
+    }
+
+    for (int shift = 32; shift < 32 + bits; shift += 8)
+    {
+        size_t offsets[257] = { 0 };
+        for (size_t i = 0; i < count; i++)
+        {
+            offsets[((pairs[i] >> shift) & 0xff) + 1]++;
+        }
+        for (int digit = 0; digit < 256; digit++)
+        {
+            offsets[digit + 1] += offsets[digit];
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            buffer[offsets[(pairs[i] >> shift) & 0xff]++] = pairs[i];
+        }
+
+        uint64_t *swap = pairs;
+        pairs  = buffer;
+        buffer = swap;
+    }
+    return pairs;
+}
+
+/**
+ * add_pair - Queue point @point for the polygon test of zone @zone.
+ */
+static int add_pair(ZoneBatch *batch, size_t *count, size_t zone, size_t point)
+{
+    if (*count == batch->pair_capacity)
+    {
+        size_t   capacity = batch->pair_capacity ? batch->pair_capacity * 2 : 2 * ZONE_BATCH_CHUNK;
+        uint64_t *pairs   = realloc(batch->pairs, capacity * sizeof(uint64_t));
+        if (pairs)
+        {
+            batch->pairs = pairs;
+        }
+        uint64_t *sorted  = pairs ? realloc(batch->sorted, capacity * sizeof(uint64_t)) : NULL;
+        if (!sorted)
+        {
+            return -1;
+        }
+        batch->sorted        = sorted;
+        batch->pair_capacity = capacity;
+    }
+    batch->pairs[(*count)++] = ((uint64_t)zone << 32) | point;
+    return 0;
+}
+
+/**
+ * classify_chunk - zone_map_lookup_batch() for at most ZONE_BATCH_CHUNK points.
+ *
+ * Rectangles are resolved per point while walking the cells. Points inside
+ * a polygon's bounding box (before the first matching rectangle, which has
+ * a higher id) are queued per polygon, the queue is grouped by polygon and
+ * every group is classified with one pip_classify() call.
+ */
+static void classify_chunk(const ZoneMap *map, ZoneBatch *batch, const int32_t *x, const int32_t *y, size_t count,
+                           int64_t *zone_ids)
+{
+    size_t pairs = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        batch->best[i] = INT64_MAX;
+        size_t cell    = grid_cell(map, x[i], y[i]);
+        if (cell == SIZE_MAX)
+        {
+            continue;
+        }
+
+        for (uint32_t c = map->cell_start[cell]; c < map->cell_start[cell + 1]; c++)
+        {
+            const Zone *zone = &map->zones[map->cell_zones[c]];
+            if (x[i] < zone->x_min || x[i] >= zone->x_max || y[i] < zone->y_min || y[i] >= zone->y_max)
+            {
+                continue;
+            }
+            if (zone->edge_count == 0)
+            {
+                batch->best[i] = zone->id;
+                break;
+            }
+            if (add_pair(batch, &pairs, map->cell_zones[c], i) != 0)
+            {
+                /* Out of memory: settle this point alone, the queued polygons cannot beat it */
+                int64_t id     = cell_lookup(map, cell, x[i], y[i]);
+                batch->best[i] = id ? id : INT64_MAX;
+                break;
+            }
+        }
+    }
+
+    const uint64_t *sorted = pairs ? sort_pairs(batch->pairs, batch->sorted, pairs, map->count) : NULL;
+    for (size_t first = 0, end; first < pairs; first = end)
+    {
+        const Zone *zone  = &map->zones[sorted[first] >> 32];
+        size_t     points = 0;
+        for (end = first; end < pairs && (sorted[end] >> 32) == (sorted[first] >> 32); end++)
+        {
+            uint32_t point        = (uint32_t)sorted[end];
+            batch->member[points] = point;
+            batch->x[points]      = x[point];
+            batch->y[points]      = y[point];
+            points++;
+        }
+
+        const PolygonEdge *edges = &map->edges[zone->first_edge];
+        if (points < ZONE_SIMD_MIN_POINTS)
+        {
+            for (size_t k = 0; k < points; k++)
+            {
+                batch->inside[k] = (uint8_t)pip_contains(edges, zone->edge_count, batch->x[k], batch->y[k]);
+            }
+        }
+        else
+        {
+            pip_classify(edges, zone->edge_count, batch->x, batch->y, points, batch->inside);
+        }
+
+        for (size_t k = 0; k < points; k++)
+        {
+            if (batch->inside[k] && zone->id < batch->best[batch->member[k]])
+            {
+                batch->best[batch->member[k]] = zone->id;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        zone_ids[i] = batch->best[i] == INT64_MAX ? 0 : batch->best[i];
+    }
+}
+
+/**
+ * zone_map_lookup_batch - Zones containing @count points.
+ */
+void zone_map_lookup_batch(const ZoneMap *map, const int32_t *x, const int32_t *y, size_t count, int64_t *zone_ids)
+{
+    ZoneBatch *batch = map->edge_count > 0 ? malloc(sizeof(ZoneBatch)) : NULL;
+
+    if (!batch)
+    {
+        /* Rectangles only (or out of memory): nothing to group */
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t cell = grid_cell(map, x[i], y[i]);
+            zone_ids[i] = cell == SIZE_MAX ? 0 : cell_lookup(map, cell, x[i], y[i]);
+        }
+        return;
+    }
+
+    batch->pairs         = NULL;
+    batch->sorted        = NULL;
+    batch->pair_capacity = 0;
+    for (size_t base = 0; base < count; base += ZONE_BATCH_CHUNK)
+    {
+        size_t chunk = count - base < ZONE_BATCH_CHUNK ? count - base : ZONE_BATCH_CHUNK;
+        classify_chunk(map, batch, x + base, y + base, chunk, zone_ids + base);
+    }
+    free(batch->pairs);
+    free(batch->sorted);
+    free(batch);
+}
+
+/**
+ * zone_map_free - Release the zones and the index.
+ */
+void zone_map_free(ZoneMap *map)
+{
+    free(map->zones);
+    free(map->edges);
+    free(map->cell_start);
+    free(map->cell_zones);
+    memset(map, 0, sizeof(*map));
+}
@@ -1,35 +1,93 @@
 #!/bin/bash
+#
+# scr_prksys_control.sh: Start, stop or show the server-side stages, headless
+#
+# Runs prk_sys_srv_run in the background; it starts the stages in order as
+# each reports ready, restarts crashed ones and stops them in order on
+# SIGTERM. No terminal windows, no fixed sleeps.
+#
+# Usage:
+#      ./scr_prksys_control.sh start|stop|status
+#
 
 
-# Function to run a program in a new terminal
-run_in_terminal()
+PID_FILE="prk_sys_srv_run.pid"
+LOG_DIR="logs"                                                       # <stage>.log of every stage
+SUPERVISOR_LOG="$LOG_DIR/prk_sys_srv_run.log"
+START_TIMEOUT=20                                                     # Seconds to wait for every stage to be ready
+
+
+# Whether the supervisor of PID_FILE runs
+is_running()
 {
-    program="$1"
-    gnome-terminal -- bash -c "./$program; exec bash"
+    [ -f "$PID_FILE" ] && kill -0 "$(cat "$PID_FILE")" 2>/dev/null
 }
 
-# Start the out_prk_sys_srv_run program
-echo "Starting out_prk_sys_srv_run..."
-run_in_terminal "out_prk_sys_srv_run"
-
-# Function to detect data activity in the FIFO from out_giis
-detect_data_activity()
+start()
 {
-    fifo_file="$1"
-    tail -f "$fifo_file" | while IFS= read -r line; do
-        if echo "$line" | grep -q "data"; then
-            break
+    if is_running
+    then
+        echo "Already running, pid $(cat "$PID_FILE")."
+        return 0
+    fi
+
+    mkdir -p giis "$LOG_DIR"
+    local lines=0
+    [ -f "$SUPERVISOR_LOG" ] && lines=$(wc -l < "$SUPERVISOR_LOG")
+    local from=$(( lines + 1 ))
+    nohup ./prk_sys_srv_run --log-dir "$LOG_DIR" >> "$SUPERVISOR_LOG" 2>&1 &
+    echo $! > "$PID_FILE"
+
+    # Wait for the supervisor to report every stage ready
+    local waited=0
+    until tail -n +"$from" "$SUPERVISOR_LOG" | grep -q "all stages ready"
+    do
+        if ! is_running || [ "$waited" -ge $(( START_TIMEOUT * 10 )) ]
+        then
+            tail -n +"$from" "$SUPERVISOR_LOG"
+            echo "Not started, see $LOG_DIR/."
+            return 1
         fi
+        sleep 0.1
+        waited=$(( waited + 1 ))
     done
+    tail -n +"$from" "$SUPERVISOR_LOG"
 }
 
-# Start out_insert_data_from_giis_shm when data activity from out_giis is detected
-echo "Waiting for data from out_giis..."
-detect_data_activity "giis/ipc_to_db"
-detect_data_activity "giis/ipc_transfer_giis"
+stop()
+{
+    if ! is_running
+    then
+        echo "Not running."
+        rm -f "$PID_FILE"
+        return 0
+    fi
 
-echo "Detected data from out_giis. Starting out_insert_data_from_giis_shm..."
-run_in_terminal "out_insert_data_from_giis_shm"
+    local pid=$(cat "$PID_FILE")
+    kill -TERM "$pid"
+    while kill -0 "$pid" 2>/dev/null
+    do
+        sleep 0.1
+    done
+    rm -f "$PID_FILE"
+    tail -n 20 "$SUPERVISOR_LOG" | sed -n '/stopping the stages/,$p'
+}
+
+status()
+{
+    if ! is_running
+    then
+        echo "Not running."
+        return 3
+    fi
+    echo "prk_sys_srv_run, pid $(cat "$PID_FILE"):"
+    ps --ppid "$(cat "$PID_FILE")" -o pid=,etime=,args=
+}
 
-echo "Control script finished."
 
+case "$1" in
+    start)  start ;;
+    stop)   stop ;;
+    status) status ;;
+    *)      echo "Usage: $0 start|stop|status"; exit 1 ;;
+esac
@@ -1,7 +1,8 @@
-/* gcc create_db_empty.c -o out_create_db_empty */
+/* gcc create_db_empty.c -o out_create_db_empty -lsqlite3 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sqlite3.h>
 
 int main()
 {
@@ -18,16 +19,15 @@ int main()
 	}   
 
 
-	// Construct the SQLite command to create an empty database
-	char command[256];
-	snprintf(command, sizeof(command), "sqlite %s \"\"", db_path);
-
-	// Execute the SQLite command
-	int result = system(command);
-	if (result != 0) {
-		fprintf(stderr, "Error executing SQLite command.\n");
+	// Create an empty database with the embedded SQLite library
+	sqlite3 *db = NULL;
+	if (sqlite3_open(db_path, &db) != SQLITE_OK) {
+		fprintf(stderr, "Error creating database: %s\n", sqlite3_errmsg(db));
+		sqlite3_close(db);
 		return 1;  // Exit with an error code
-	}   
+	}
+	sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+	sqlite3_close(db);
 
 	printf("Database created at: %s\n", db_path);
 
@@ -1,27 +1,25 @@
-/* gcc create_tables.c -o out_create_tables */
+/* gcc create_tables.c ../core/src/prk_db.c -o out_create_tables -lsqlite3 */
+#include "../core/inc/prk_db.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 int main()
 {
+    sqlite3 *db = prk_db_open("prksys_db.db");
+    if (!db)
+    {
+        return 1;
+    }
 
-    system("sqlite prksys_db.db \
-        \"CREATE TABLE Prices \
-            (id INTEGER PRIMARY KEY, \
-             location TEXT NOT NULL, \
-             price REAL NOT NULL);\"");
-
-    system("sqlite prksys_db.db \
-        \"CREATE TABLE Customer_Data \
-            (id INTEGER PRIMARY KEY, \
-             mac_address TEXT NOT NULL, \
-             status CHAR(1) NOT NULL, \
-             x REAL NOT NULL, \
-             y REAL NOT NULL, \
-             z REAL NOT NULL);\"");
+    /* Prices, Sensors and Customer_Data (readings reference Sensors by id) */
+    if (prk_db_create_schema(db) != 0)
+    {
+        prk_db_close(db);
+        return 1;
+    }
 
+    prk_db_close(db);
     printf("Tables created successfully in the database.\n");
 
     return 0;
 }
-
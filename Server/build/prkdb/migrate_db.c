@@ -0,0 +1,68 @@
+/* gcc migrate_db.c ../core/src/prk_db.c -o out_migrate_db -lsqlite3 */
+/*
+ * Bring an existing prksys_db.db to the current schema version.
+ *
+ * Usage:
+ *      ./out_migrate_db [db_path] [--status]
+ *
+ * Safe to run while the server programs are writing: tables are rebuilt in
+ * short transactions and only the final swap holds the write lock.
+ * --status prints the recorded version and the pending migrations only.
+ */
+#include "../core/inc/prk_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int main(int argc, char *argv[])
+{
+    const char *db_path = "prksys_db.db";
+    int         status  = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--status") == 0)
+        {
+            status = 1;
+        }
+        else
+        {
+            db_path = argv[i];
+        }
+    }
+
+    sqlite3 *db = prk_db_open(db_path);
+    if (!db)
+    {
+        return 1;
+    }
+
+    int version = prk_db_schema_version(db);
+    printf("%s: schema v%d, current v%d\n", db_path, version, PRK_DB_SCHEMA_VERSION);
+    for (int v = version + 1; v <= PRK_DB_SCHEMA_VERSION; v++)
+    {
+        printf("  pending v%d: %s\n", v, prk_db_migration_description(v));
+    }
+
+    if (status || version == PRK_DB_SCHEMA_VERSION)
+    {
+        prk_db_close(db);
+        return 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (prk_db_migrate(db, 1) != 0)
+    {
+        prk_db_close(db);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("Migrated to v%d in %.2f s.\n", prk_db_schema_version(db),
+           (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    prk_db_close(db);
+
+    return 0;
+}
@@ -0,0 +1,376 @@
+/* gcc rebuild_rollups.c ../core/src/occupancy_rollup.c ../core/src/zone_map.c ../core/src/point_in_polygon.c ../core/src/prk_db.c -o out_rebuild_rollups -lsqlite3 -lpthread -lm */
+/*
+ * Regenerate the occupancy rollups (Rollup_Minute/Hour/Day) from the raw
+ * readings in Customer_Data, e.g. after changing the Zones table.
+ *
+ * Usage:
+ *      ./out_rebuild_rollups [db_path] [--threads <n>]
+ *
+ * The readings are split into UTC days. Worker threads (one per CPU by
+ * default) take days from a shared counter, read them through their own
+ * connection and aggregate them in memory with the same code the inserter
+ * uses; a day never spans two workers, so their rows do not overlap. The
+ * rows of every day found are then replaced in one transaction.
+ *
+ * Stop the inserter first: upserts it makes while the workers run are
+ * overwritten by the rebuilt rows.
+ */
+#include "../core/inc/prk_db.h"
+#include "../core/inc/zone_map.h"
+#include "../core/inc/occupancy_rollup.h"
+#include "../core/inc/sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define DAY_MS          (24 * 60 * 60 * 1000LL)
+#define DRAIN_EVERY     65536                                        /* Readings between drains of a worker */
+
+
+/* One rebuilt cell */
+typedef struct
+{
+    rollup_level_t  level;
+    RollupCell      cell;
+} RollupRow;
+
+/* Days still to aggregate, shared by the workers */
+typedef struct
+{
+    pthread_mutex_t lock;
+    int64_t         next_day;                                        /* Start of the next unclaimed day */
+    int64_t         end_day;                                         /* Exclusive */
+} DayQueue;
+
+/* State of one worker thread */
+typedef struct
+{
+    pthread_t       thread;
+    const char      *db_path;
+    const ZoneMap   *zones;
+    DayQueue        *days;
+    RollupRow       *rows;                                           /* Cells drained so far */
+    size_t          count;
+    size_t          capacity;
+    long            readings;                                        /* Readings aggregated */
+    int             failed;
+} Worker;
+
+
+/*
+ * collect_row - rollup_emit_t that keeps the drained cell in the worker.
+ */
+static int collect_row(rollup_level_t level, const RollupCell *cell, void *ctx)
+{
+    Worker *worker = ctx;
+
+    if (worker->count == worker->capacity)
+    {
+        size_t      capacity = worker->capacity ? worker->capacity * 2 : 1024;
+        RollupRow   *rows    = realloc(worker->rows, capacity * sizeof(RollupRow));
+        if (!rows)
+        {
+            perror("realloc");
+            return -1;
+        }
+        worker->rows     = rows;
+        worker->capacity = capacity;
+    }
+
+    worker->rows[worker->count].level = level;
+    worker->rows[worker->count].cell  = *cell;
+    worker->count++;
+    return 0;
+}
+
+/*
+ * claim_day - Next day to aggregate, or -1 when all are taken.
+ */
+static int64_t claim_day(DayQueue *days)
+{
+    int64_t day = -1;
+
+    pthread_mutex_lock(&days->lock);
+    if (days->next_day < days->end_day)
+    {
+        day = days->next_day;
+        days->next_day += DAY_MS;
+    }
+    pthread_mutex_unlock(&days->lock);
+    return day;
+}
+
+/*
+ * aggregate_days - Worker thread: aggregate claimed days until none are left.
+ */
+static void *aggregate_days(void *arg)
+{
+    Worker          *worker = arg;
+    OccupancyRollup rollup;
+    sqlite3         *db     = prk_db_open(worker->db_path);
+    sqlite3_stmt    *stmt   = db ? prk_db_prepare(db, "SELECT sensor_id, recv_time, status, x, y FROM Customer_Data "
+                                                      "WHERE recv_time >= ?1 AND recv_time < ?2 "
+                                                      "ORDER BY recv_time;") : NULL;
+
+    if (!stmt || occupancy_rollup_init(&rollup, worker->zones) != 0)
+    {
+        sqlite3_finalize(stmt);
+        prk_db_close(db);
+        worker->failed = 1;
+        return NULL;
+    }
+
+    for (int64_t day = claim_day(worker->days); day >= 0 && !worker->failed; day = claim_day(worker->days))
+    {
+        sqlite3_bind_int64(stmt, 1, day);
+        sqlite3_bind_int64(stmt, 2, day + DAY_MS);
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            const unsigned char *status = sqlite3_column_text(stmt, 2);
+            if (occupancy_rollup_add(&rollup, sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1),
+                                     (int32_t)lround(sqlite3_column_double(stmt, 3) * COORD_SCALE),
+                                     (int32_t)lround(sqlite3_column_double(stmt, 4) * COORD_SCALE),
+                                     status ? (char)status[0] : '\0') != 0)
+            {
+                worker->failed = 1;
+                break;
+            }
+            if (++worker->readings % DRAIN_EVERY == 0 &&
+                (occupancy_rollup_drain(&rollup, 0, collect_row, worker) < 0 ||
+                 occupancy_rollup_batch_done(&rollup) != 0))
+            {
+                worker->failed = 1;
+                break;
+            }
+        }
+        if (rc != SQLITE_DONE && rc != SQLITE_ROW)
+        {
+            fprintf(stderr, "Reading day %lld failed: %s\n", (long long)day, sqlite3_errmsg(db));
+            worker->failed = 1;
+        }
+        sqlite3_reset(stmt);
+
+        /* Days are independent, close all of this one's buckets */
+        if (occupancy_rollup_drain(&rollup, 1, collect_row, worker) < 0 || occupancy_rollup_batch_done(&rollup) != 0)
+        {
+            worker->failed = 1;
+        }
+    }
+
+    occupancy_rollup_free(&rollup);
+    sqlite3_finalize(stmt);
+    prk_db_close(db);
+    return NULL;
+}
+
+/*
+ * reading_range - First and last receive time over all partitions.
+ *
+ * Each partition answers min/max from its recv_time index.
+ * Return: 1 if there are readings, 0 if not, -1 on failure.
+ */
+static int reading_range(sqlite3 *db, int64_t *first, int64_t *last)
+{
+    sqlite3_stmt *parts = prk_db_prepare(db, "SELECT name FROM Partitions;");
+    int          found  = 0;
+
+    if (!parts)
+    {
+        return -1;
+    }
+    while (sqlite3_step(parts) == SQLITE_ROW)
+    {
+        char            *sql  = sqlite3_mprintf("SELECT min(recv_time), max(recv_time) FROM \"%w\";",
+                                                (const char *)sqlite3_column_text(parts, 0));
+        sqlite3_stmt    *stmt = sql ? prk_db_prepare(db, sql) : NULL;
+
+        sqlite3_free(sql);
+        if (!stmt)
+        {
+            sqlite3_finalize(parts);
+            return -1;
+        }
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        {
+            int64_t lo = sqlite3_column_int64(stmt, 0);
+            int64_t hi = sqlite3_column_int64(stmt, 1);
+            *first = (!found || lo < *first) ? lo : *first;
+            *last  = (!found || hi > *last) ? hi : *last;
+            found  = 1;
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_finalize(parts);
+    return found;
+}
+
+/*
+ * write_rows - Replace the rollups of [@from, @to) with the workers' rows.
+ */
+static int write_rows(sqlite3 *db, const Worker *workers, int count, int64_t from, int64_t to)
+{
+    RollupWriter writer;
+
+    if (rollup_writer_init(&writer, db) != 0)
+    {
+        return -1;
+    }
+    if (prk_db_exec(db, "BEGIN IMMEDIATE;") != 0)
+    {
+        rollup_writer_free(&writer);
+        return -1;
+    }
+
+    int rc = rollup_writer_clear(&writer, from, to);
+    for (int w = 0; w < count && rc == 0; w++)
+    {
+        for (size_t i = 0; i < workers[w].count && rc == 0; i++)
+        {
+            rc = rollup_writer_emit(workers[w].rows[i].level, &workers[w].rows[i].cell, &writer);
+        }
+    }
+    rollup_writer_free(&writer);
+
+    return prk_db_exec(db, rc == 0 ? "COMMIT;" : "ROLLBACK;") == 0 && rc == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const char  *db_path = "prksys_db.db";
+    long        threads  = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = atol(argv[++i]);
+        }
+        else if (argv[i][0] != '-')
+        {
+            db_path = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [db_path] [--threads <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    sqlite3 *db = prk_db_open(db_path);
+    if (!db || prk_db_create_schema(db) != 0)
+    {
+        prk_db_close(db);
+        return 1;
+    }
+
+    ZoneMap zones;
+    if (zone_map_load(&zones, db) != 0)
+    {
+        prk_db_close(db);
+        return 1;
+    }
+    if (zones.count == 0)
+    {
+        printf("No zones defined in %s, nothing to roll up.\n", db_path);
+        prk_db_close(db);
+        return 0;
+    }
+
+    int64_t first, last;
+    int     found = reading_range(db, &first, &last);
+    if (found <= 0)
+    {
+        printf("%s\n", found == 0 ? "No readings, nothing to roll up." : "Reading the partitions failed.");
+        zone_map_free(&zones);
+        prk_db_close(db);
+        return found == 0 ? 0 : 1;
+    }
+
+    /* Whole UTC days, so no bucket is split between workers */
+    DayQueue days;
+    pthread_mutex_init(&days.lock, NULL);
+    days.next_day = first - ((first % DAY_MS) + DAY_MS) % DAY_MS;
+    days.end_day  = last - ((last % DAY_MS) + DAY_MS) % DAY_MS + DAY_MS;
+    int64_t from  = days.next_day;
+    int64_t to    = days.end_day;
+
+    long day_count = (long)((to - from) / DAY_MS);
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    if (threads > day_count)
+    {
+        threads = day_count;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Worker *workers = calloc((size_t)threads, sizeof(Worker));
+    if (!workers)
+    {
+        perror("calloc");
+        zone_map_free(&zones);
+        prk_db_close(db);
+        return 1;
+    }
+    for (long w = 0; w < threads; w++)
+    {
+        workers[w].db_path = db_path;
+        workers[w].zones   = &zones;
+        workers[w].days    = &days;
+        if (pthread_create(&workers[w].thread, NULL, aggregate_days, &workers[w]) != 0)
+        {
+            perror("pthread_create");
+            threads = w;
+            workers[0].failed = 1;
+            break;
+        }
+    }
+
+    int     failed   = 0;
+    long    readings = 0;
+    size_t  rows     = 0;
+    for (long w = 0; w < threads; w++)
+    {
+        pthread_join(workers[w].thread, NULL);
+        failed   |= workers[w].failed;
+        readings += workers[w].readings;
+        rows     += workers[w].count;
+    }
+
+    if (!failed && write_rows(db, workers, (int)threads, from, to) != 0)
+    {
+        failed = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (failed)
+    {
+        fprintf(stderr, "Rebuild failed, rollups left unchanged.\n");
+    }
+    else
+    {
+        printf("Rebuilt %zu rollup cell(s) from %ld reading(s) over %ld day(s) with %ld thread(s) in %.2f s.\n",
+               rows, readings, day_count, threads,
+               (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    }
+
+    for (long w = 0; w < threads; w++)
+    {
+        free(workers[w].rows);
+    }
+    free(workers);
+    pthread_mutex_destroy(&days.lock);
+    zone_map_free(&zones);
+    prk_db_close(db);
+
+    return failed;
+}
@@ -3,17 +3,22 @@
 
 #include <stdio.h>
 #include <stdint.h>                         /* for uint16_t */
+#include <stdatomic.h>
+#include "prk_trace.h"
 
 /* Define constants for data handling */
 #define MAX_DATA_LENGTH 50
 #define SHM_KEY 1234
-#define SHM_SIZE sizeof(DataPacket)
+#define SHM_SIZE sizeof(SharedPacket)
+#define PACKET_MAGIC 0xA5                   /* First byte of a versioned packet, never an op_code */
+#define PACKET_VERSION 1                    /* PacketHeader, then a TickedPacket */
 
 
 /**
  * DataPacket
  * This structure represents a data packet with an operation code and
- * three coordinate values (x, y, z).
+ * three coordinate values (x, y, z). It is all that the first firmware
+ * sends, and is kept as it was so that the gateway still reads it.
  */
 #pragma pack(push, 1)
 struct __attribute__((packed)) DataPacket
@@ -23,8 +28,51 @@ struct __attribute__((packed)) DataPacket
     uint16_t y;     /* Y coordinate */
     uint16_t z;     /* Z coordinate */
 };
+
+
+/**
+ * PacketHeader
+ * Precedes the packets of firmware that sends more than a DataPacket. Its
+ * magic tells it from the op_code of a bare DataPacket, and the length
+ * lets the gateway skip fields added by a later version.
+ */
+struct __attribute__((packed)) PacketHeader
+{
+    uint8_t magic;      /* PACKET_MAGIC */
+    uint8_t version;    /* PACKET_VERSION of the sender */
+    uint8_t length;     /* Bytes that follow the header */
+};
+
+
+/**
+ * TickedPacket
+ * Body of a version 1 packet: the DataPacket and the STM32 tick, from
+ * which the gateway estimates when it was sent.
+ */
+struct __attribute__((packed)) TickedPacket
+{
+    struct DataPacket packet;
+    uint32_t tick_ms;   /* STM32 HAL_GetTick() when sent */
+};
 #pragma pack(pop)
 #define DataPacket struct DataPacket
+#define PacketHeader struct PacketHeader
+#define TickedPacket struct TickedPacket
+
+
+/**
+ * SharedPacket
+ * Content of the shared memory segment: the last packet received and its
+ * trace. The trace is guarded by a sequence counter, odd while it is
+ * being written. A segment left by an older build, which held a bare
+ * DataPacket, is too small: get_traced_data() replaces it.
+ */
+typedef struct
+{
+    DataPacket          packet;
+    _Atomic uint32_t    trace_version;
+    PrkTrace            trace;
+} SharedPacket;
 
 
 /**
@@ -44,7 +92,9 @@ void format_data_struct(DataPacket *packet);
   * get_formatted_data
   *
   * Copies the given DataPacket into shared memory and returns the most
-  * recently formatted data as a string.
+  * recently formatted data as a string. The segment is created and
+  * attached on the first call; one of an older, smaller layout is removed
+  * and created again.
   *
   * Parameters:
   *   @packet: Pointer to a DataPacket structure.
@@ -54,6 +104,34 @@ void format_data_struct(DataPacket *packet);
 const char *get_formatted_data(DataPacket *packet);
 
 
+/**
+  * get_traced_data
+  *
+  * As get_formatted_data(), and publishes the trace of the packet with it.
+  *
+  * Parameters:
+  *   @packet: Pointer to a DataPacket structure.
+  *   @trace:  Its trace.
+  *
+  * Return: A pointer to the formatted string.
+  */
+const char *get_traced_data(DataPacket *packet, const PrkTrace *trace);
+
+
+/**
+  * get_shared_trace
+  *
+  * Copies the trace of the packet in shared memory.
+  *
+  * Parameters:
+  *   @shared: Attached shared memory segment.
+  *   @trace:  Receives the trace.
+  *
+  * Return: 0 on success, -1 if there is none or it was being written.
+  */
+int get_shared_trace(SharedPacket *shared, PrkTrace *trace);
+
+
 /**
  * remove_shared_memory
  *
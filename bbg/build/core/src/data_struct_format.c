@@ -14,12 +14,14 @@
  *      DataPacket packet = { 'D', 100, 200, 300 };
  *      const char* formatted_data = get_formatted_data(&packet);
  *
- * Version: v1.0
- * Date:    01-09-2024
+ * Version: v1.2
+ * Date:    19-10-2026
  * Author:  Morris
  *
  * Date:            Name:               Version:        Modification:
  *   01-09-2024       Morris              v1.0            created
+ *   19-10-2026       Morris              v1.1            trace shared with the packet
+ *   19-10-2026       Morris              v1.2            segment attached once, older layout replaced
  */
 
 #include "data_struct_format.h"
@@ -32,10 +34,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
 
 /* Global variables for shared memory */
 int shm_id;   /* Shared memory ID */
-DataPacket *shm_data;  /* Pointer to shared memory */
+SharedPacket *shm_data;  /* Pointer to shared memory, NULL until attached */
 
 /* Static buffer to hold formatted data */
 static char formatted_data[MAX_DATA_LENGTH];
@@ -60,19 +63,33 @@ void format_data_struct(DataPacket *packet)
 
 
 /**
- * get_formatted_data - Copies data into shared memory and returns formatted string.
+ * attach_segment - Creates the shared memory segment if needed and attaches it.
  *
- * @packet: Pointer to the DataPacket structure to be copied into shared memory.
+ * shmget() fails with EINVAL on a segment smaller than SHM_SIZE, as left
+ * by a build whose segment held a bare DataPacket. That segment is removed
+ * and created again at the current size; processes still attached to the
+ * old one keep it until they restart.
  *
- * This function attaches to the shared memory, copies the `DataPacket` data
- * into it, and then returns a formatted string based on the data.
- *
- * Return: A pointer to the formatted string.
+ * Return: the attached segment.
  */
-const char *get_formatted_data(DataPacket *packet)
+static SharedPacket *attach_segment(void)
 {
+    if (shm_data)
+    {
+        return shm_data;
+    }
+
     /* Create the segment of the shared memory segment */
     shm_id = shmget(SHM_KEY, SHM_SIZE, 0666 | IPC_CREAT);
+    if (shm_id == -1 && errno == EINVAL)
+    {
+        int old_id = shmget(SHM_KEY, 0, 0666);
+        if (old_id != -1 && shmctl(old_id, IPC_RMID, NULL) == 0)
+        {
+            fprintf(stderr, "Replaced the shared memory segment of an older layout\n");
+            shm_id = shmget(SHM_KEY, SHM_SIZE, 0666 | IPC_CREAT);
+        }
+    }
     if (shm_id == -1)
     {
         perror("shmget failed");
@@ -80,15 +97,63 @@ const char *get_formatted_data(DataPacket *packet)
     }
 
     /* Attach to the shared memory segment */
-    shm_data = (DataPacket *)shmat(shm_id, NULL, 0);
-    if (shm_data == (DataPacket *)-1)
+    SharedPacket *shared = (SharedPacket *)shmat(shm_id, NULL, 0);
+    if (shared == (SharedPacket *)-1)
     {
         perror("shmat failed");
         exit(EXIT_FAILURE);
     }
+    shm_data = shared;
+    return shm_data;
+}
+
+
+/**
+ * get_formatted_data - Copies data into shared memory and returns formatted string.
+ *
+ * @packet: Pointer to the DataPacket structure to be copied into shared memory.
+ *
+ * This function attaches to the shared memory, copies the `DataPacket` data
+ * into it, and then returns a formatted string based on the data.
+ *
+ * Return: A pointer to the formatted string.
+ */
+const char *get_formatted_data(DataPacket *packet)
+{
+    return get_traced_data(packet, NULL);
+}
+
+
+/**
+ * get_traced_data - Copies data and its trace into shared memory.
+ *
+ * @packet: Pointer to the DataPacket structure to be copied into shared memory.
+ * @trace:  Its trace, or NULL to leave the shared trace as it is.
+ *
+ * The trace is written first, under the sequence counter, so that a reader
+ * seeing the new packet also sees its trace.
+ *
+ * Return: A pointer to the formatted string.
+ */
+const char *get_traced_data(DataPacket *packet, const PrkTrace *trace)
+{
+    attach_segment();
+
+    /* Publish the trace: the counter is odd while it is written */
+    if (trace)
+    {
+        uint32_t version = atomic_load_explicit(&shm_data->trace_version, memory_order_relaxed);
+        atomic_store_explicit(&shm_data->trace_version, version + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        memcpy(&shm_data->trace, trace, sizeof(PrkTrace));
+        atomic_store_explicit(&shm_data->trace_version, version + 2, memory_order_release);
+    }
 
     /* Copy packet data into shared memory */
-    memcpy(shm_data, packet, sizeof(DataPacket));
+    if (&shm_data->packet != packet)
+    {
+        memcpy(&shm_data->packet, packet, sizeof(DataPacket));
+    }
     /* Initialize the shared memory to zero */
     //memset(shm_data, packet, sizeof(DataPacket));
     //memset(shm_data, 0, sizeof(DataPacket));
@@ -109,6 +174,31 @@ const char *get_formatted_data(DataPacket *packet)
 }
 
 
+/**
+ * get_shared_trace - Copies the trace of the packet in shared memory.
+ *
+ * @shared: Attached shared memory segment.
+ * @trace:  Receives the trace.
+ *
+ * Return: 0 on success, -1 if there is none or it was being written.
+ */
+int get_shared_trace(SharedPacket *shared, PrkTrace *trace)
+{
+    uint32_t version = atomic_load_explicit(&shared->trace_version, memory_order_acquire);
+    if (version & 1u)
+    {
+        return -1;
+    }
+    memcpy(trace, &shared->trace, sizeof(PrkTrace));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&shared->trace_version, memory_order_relaxed) != version || trace->id == 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+
 /**
  * remove_shared_memory - Removes the shared memory segment.
  *
@@ -6,7 +6,7 @@
  * gracefully handle interruptions (e.g., Ctrl+C).
  *
  * Compilation:
- *      gcc ipc_sender.c -o out_ipc_sender -lrt
+ *      gcc ipc_sender.c data_struct_format.c prk_metrics.c prk_trace.c prk_tracepoint.c -o out_ipc_sender -lrt -lpthread
  *
  * Usage:
  *      ./out_ipc_sender
@@ -16,8 +16,13 @@
  * - Writes data to a FIFO defined by FIFO_PATH.
  * - Handles SIGINT (Ctrl+C) to allow graceful shutdown.
  * - Uses the get_formatted_data() function to format data before writing.
+ * - Counts records written and full FIFO retries in the shared memory
+ *   metrics page "ipc_sender" (see prk_metrics.h).
+ * - Stamps the trace of a new packet and appends it to its record, the
+ *   first time the record is written (see prk_trace.h).
+ * - A tracepoint (prk_tracepoint.h) per record written, with TRACEPOINTS=1.
  *
- * Version: v3.0
+ * Version: v3.5
  * Date:    01-09-2024
  * Author:  Morris
  *
@@ -27,10 +32,18 @@
  *                                                        optimized flags for compilation
  *   01-09-2024       Morris              v2.0            added inotify mechanism for monitoring file changes
  *   01-09-2024       Morris              v3.0            replaced inotify with shared memory mechanism
+ *   19-10-2026       Morris              v3.1            newline terminated records on the FIFO
+ *   19-10-2026       Morris              v3.2            records and full FIFO counters
+ *   19-10-2026       Morris              v3.3            trace of new packets appended to their record
+ *   19-10-2026       Morris              v3.4            segment of an older layout reported
+ *   19-10-2026       Morris              v3.5            tracepoints
  *
  */
 
 #include "data_struct_format.h"
+#include "prk_metrics.h"
+#include "prk_trace.h"
+#include "prk_tracepoint.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,7 +59,7 @@
 
 #define SHM_KEY 1234                                                 /* Key for shared memory segment */
 #define FIFO_PATH "tmp/gps_pipe"                                     /* Path to the named pipe (FIFO) */
-#define BUFFER_SIZE 256                                              /* Buffer size for reading/writing data */
+#define BUFFER_SIZE 512                                              /* Buffer size for reading/writing data, trace included */
 
 volatile sig_atomic_t running = 1;                                   /* Flag to control program execution */
 
@@ -69,19 +82,33 @@ int main()
     char        buffer[BUFFER_SIZE];                                 /* Buffer to hold data */
     ssize_t     bwr;                                                 /* Number of bytes written */
     int         shm_id;                                              /* Shared memory ID */
-    DataPacket  *shm_data;                                           /* Pointer to shared memory data */
+    SharedPacket *shm_data;                                          /* Pointer to shared memory data */
+    PrkTrace    trace;                                               /* Trace of the packet in shared memory */
+    uint64_t    last_trace = 0;                                      /* Id of the last trace written */
+
+    prk_metrics_open("ipc_sender");
+    PRK_TP_OPEN("ipc_sender");
+    PrkCounter records   = prk_counter("prk_ipc_sender_records_total", "Records written to the FIFO.");
+    PrkCounter fifo_full = prk_counter("prk_ipc_sender_fifo_full_total", "Writes retried because the FIFO was full.");
 
     /* Get the shared memory segment ID */
-    shm_id = shmget(SHM_KEY, sizeof(DataPacket), 0666);
+    shm_id = shmget(SHM_KEY, SHM_SIZE, 0666);
     if (shm_id == -1)
     {
-        perror("shmget failed");                                     /* Handle error if shmget fails */
+        if (errno == EINVAL)                                         /* Smaller: left by an older sys_com_controller */
+        {
+            fprintf(stderr, "Shared memory segment of an older layout, start sys_com_controller first\n");
+        }
+        else
+        {
+            perror("shmget failed");                                 /* Handle error if shmget fails */
+        }
         exit(EXIT_FAILURE);
     }
 
     /* Attach to the shared memory */
-    shm_data = (DataPacket *)shmat(shm_id, NULL, 0);
-    if (shm_data == (DataPacket *)-1)
+    shm_data = (SharedPacket *)shmat(shm_id, NULL, 0);
+    if (shm_data == (SharedPacket *)-1)
     {
         perror("shmat failed");                                      /* Handle error if shmat fails */
         exit(EXIT_FAILURE);
@@ -117,16 +144,32 @@ int main()
     /* Main loop: read from shared memory and write to FIFO */
     while (running)
     {
-        const char* formatted_data = get_formatted_data(shm_data);   /* Format shared memory data */
-        strncpy(buffer, formatted_data, BUFFER_SIZE);                /* Copy formatted data to buffer */
-        buffer[BUFFER_SIZE - 1] = '\0';                              /* Ensure the buffer is null-terminated */
+        PRK_TP_BEGIN(PRK_TP_IPC_WRITE, 0, 0);
+        int traced = get_shared_trace(shm_data, &trace) == 0 && trace.id != last_trace;
+        const char* formatted_data = get_formatted_data(&shm_data->packet);  /* Format shared memory data */
+        int len = snprintf(buffer, BUFFER_SIZE - 1, "%s", formatted_data);
+
+        /* A new packet carries its trace, a packet written again does not */
+        if (traced)
+        {
+            prk_trace_stamp(&trace, PRK_TRACE_IPC);
+            int trace_len = prk_trace_format(&trace, buffer + len, BUFFER_SIZE - 1 - (size_t)len);
+            if (trace_len > 0)
+            {
+                len += trace_len;
+            }
+        }
+        buffer[len++] = '\n';                                        /* One newline terminated record */
+        buffer[len]   = '\0';
 
-        bwr = write(fifo_fd, buffer, strlen(buffer));                /* Write to FIFO */
+        bwr = write(fifo_fd, buffer, (size_t)len);                   /* Write to FIFO */
+        PRK_TP_END(PRK_TP_IPC_WRITE, len, traced);
         if (bwr == -1)
         {
             if (errno == EAGAIN)
             {
                 /* FIFO full, try again later */
+                prk_counter_inc(fifo_full);
                 usleep(100);                                       /* Wait for 10 milliseconds */
                 continue;
             }
@@ -137,6 +180,11 @@ int main()
                 exit(EXIT_FAILURE);
             }
         }
+        if (traced)
+        {
+            last_trace = trace.id;
+        }
+        prk_counter_inc(records);
         usleep(100);                                               /* Wait for 10 milliseconds if no data is available */
         sleep(1);
     }
@@ -150,6 +198,8 @@ int main()
 
     /* Cleanup: close the FIFO */
     close(fifo_fd);
+    PRK_TP_CLOSE();
+    prk_metrics_close();
 
     return 0;
 }
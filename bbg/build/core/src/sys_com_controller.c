@@ -15,34 +15,199 @@
  * Features:
  * - Initializes GPIO pins for TX (pin 15) and RX (pin 14).
  * - Sets up UART on /dev/ttyS1 with 9600 baud rate.
- * - Reads data from UART and processes it as a DataPacket structure.
+ * - Reads data from UART and processes it as a DataPacket structure: a bare
+ *   one from older firmware, or one after a PacketHeader with its tick.
  * - Formats and prints the received data in hexadecimal and human-readable format.
  * - Implements basic error handling for UART and GPIO initialization.
+ * - Counts complete packets and skipped bytes in the shared memory metrics
+ *   page "sys_com_controller" (see prk_metrics.h).
+ * - Begins the trace of each packet (see prk_trace.h): an estimate of when
+ *   the STM32 sent it, from its tick, and when it was received here.
+ * - A tracepoint (prk_tracepoint.h) per packet, with TRACEPOINTS=1.
  *
- * Version: v1.0
+ * Version: v1.4
  * Date:    01-10-2024
  * Author:  Morris
  *
  * Date:            Name:               Version:        Modification:
  *   01-10-2024     Morris              v1.0            created
+ *   19-10-2026     Morris              v1.1            packet counters
+ *   19-10-2026     Morris              v1.2            packet traces
+ *   19-10-2026     Morris              v1.3            versioned packets, bare DataPackets still read
+ *   19-10-2026     Morris              v1.4            tracepoints
  *
  */
 
 #include "gpio.h"
 #include "uart.h"
 #include "data_struct_format.h"
+#include "prk_metrics.h"
+#include "prk_trace.h"
+#include "prk_tracepoint.h"
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <ctype.h>
 
 
-#define MESSAGE_LENGTH sizeof(DataPacket)   /* Length of the expected data packet */
+#define MESSAGE_LENGTH (sizeof(PacketHeader) + sizeof(TickedPacket))  /* Length of a version 1 packet */
+#define UART_BAUD_RATE 9600
+#define PACKET_WIRE_US ((int64_t)MESSAGE_LENGTH * 10 * 1000000 / UART_BAUD_RATE)  /* 8N1: 10 bits a byte */
+#define TICK_WINDOW 64                      /* Packets over which the tick offset is estimated */
+
+
+/**
+ * estimate_sent_us - Monotonic time at which the STM32 sent a packet.
+ *
+ * @tick_ms:     HAL_GetTick() of the STM32 in the packet.
+ * @received_us: Monotonic time at which it was received here.
+ *
+ * The STM32 has no clock in common with this host, only its tick. Over a
+ * window of packets, the smallest (received - wire time - tick) is taken
+ * as the offset between the two: the packet that waited least in the
+ * UART buffer. Packets that waited longer show it in the mcu-ctl hop. The
+ * previous window is kept as well so that the estimate does not jump at
+ * each new window; a tick that went back (the STM32 restarted) restarts
+ * the estimate.
+ *
+ * Return: the estimate, at most @received_us - PACKET_WIRE_US.
+ */
+static int64_t estimate_sent_us(uint32_t tick_ms, int64_t received_us)
+{
+    static int64_t  current_min  = INT64_MAX;
+    static int64_t  previous_min = INT64_MAX;
+    static int      in_window    = 0;
+    static uint32_t last_tick    = 0;
+
+    int64_t tick_us = (int64_t)tick_ms * 1000;
+    int64_t offset  = received_us - PACKET_WIRE_US - tick_us;
+
+    if (tick_ms < last_tick)
+    {
+        current_min  = INT64_MAX;
+        previous_min = INT64_MAX;
+        in_window    = 0;
+    }
+    last_tick = tick_ms;
+
+    if (offset < current_min)
+    {
+        current_min = offset;
+    }
+    if (++in_window == TICK_WINDOW)
+    {
+        previous_min = current_min;
+        current_min  = INT64_MAX;
+        in_window    = 0;
+    }
+
+    int64_t best = current_min < previous_min ? current_min : previous_min;
+    return tick_us + best;
+}
+
+/**
+ * read_exact - Read @len bytes from the UART, waiting for them to arrive.
+ *
+ * Return: 0 on success, -1 if the UART was closed or failed (reported).
+ */
+static int read_exact(uart_t *uart, char *buf, size_t len)
+{
+    size_t got = 0;
+
+    while (got < len)
+    {
+        ssize_t result = uart_read_data(uart, buf + got, (uint32_t)(len - got));
+        if (result > 0)
+        {
+            /* Successfully read data, accumulate the total bytes received. */
+            got += (size_t)result;
+        }
+        else if (result == -1 && errno == EAGAIN)
+        {
+            /* Non-blocking read operation, wait and retry if data is not yet available. */
+            usleep(100);
+        }
+        else if (result == 0)
+        {
+            /* Connection closed by the sender. */
+            printf("Connection closed.\n");
+            return -1;
+        }
+        else
+        {
+            /* Handle any other errors during UART read. */
+            perror("Error receiving data from UART");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * read_packet - Read the next packet from the UART.
+ *
+ * Its first byte tells a versioned packet (PACKET_MAGIC) from the op_code
+ * of a bare DataPacket, as older firmware sends. A versioned packet is
+ * read to its length, so fields of a later version are skipped.
+ *
+ * @received: Receives the packet; tick_ms only if *ticked.
+ * @ticked:   Set when the packet carried the STM32 tick.
+ *
+ * Return: bytes read, 0 if they were not a packet (skipped), -1 if the
+ * UART was closed or failed.
+ */
+static ssize_t read_packet(uart_t *uart, TickedPacket *received, int *ticked)
+{
+    char first;
+
+    *ticked = 0;
+    if (read_exact(uart, &first, 1) != 0)
+    {
+        return -1;
+    }
+
+    if ((uint8_t)first == PACKET_MAGIC)
+    {
+        PacketHeader    header = { .magic = PACKET_MAGIC };
+        char            body[UINT8_MAX];
+        if (read_exact(uart, (char *)&header + 1, sizeof(header) - 1) != 0 ||
+            read_exact(uart, body, header.length) != 0)
+        {
+            return -1;
+        }
+        if (header.version < 1 || header.length < sizeof(TickedPacket))
+        {
+            printf("Unknown packet version %u, %u bytes.\n", header.version, header.length);
+            return 0;
+        }
+        memcpy(received, body, sizeof(TickedPacket));               /* Later versions only append fields */
+        *ticked = 1;
+        return (ssize_t)(sizeof(header) + header.length);
+    }
+
+    if (!isalpha((unsigned char)first))
+    {
+        return 0;                                                    /* Out of step: resynchronize on the next byte */
+    }
+    received->packet.op_code = first;
+    if (read_exact(uart, (char *)&received->packet + 1, sizeof(DataPacket) - 1) != 0)
+    {
+        return -1;
+    }
+    return (ssize_t)sizeof(DataPacket);
+}
 
 int main()
 {
     gpio_t gpio_tx, gpio_rx;                /* GPIO structures for TX and RX pins */
 
+    prk_metrics_open("sys_com_controller");
+    PRK_TP_OPEN("sys_com_controller");
+    PrkCounter packets    = prk_counter("prk_sys_com_controller_packets_total", "Complete packets received over UART.");
+    PrkCounter incomplete = prk_counter("prk_sys_com_controller_incomplete_packets_total",
+                                        "Bytes skipped out of step, and packets of an unknown version.");
+
     /* Initialize GPIO pin 15 for TX (transmitting) and set its direction to output. */
     gpio_init(&gpio_tx, 15);
     gpio_set_direction(&gpio_tx, "out");
@@ -62,60 +227,35 @@ int main()
         return -1;
     }
 
-    /* Buffer to accumulate incoming data from UART. It's sized to fit a full DataPacket. */
-    char buffer[MESSAGE_LENGTH];
-    ssize_t bytes_received;                         /* Variable to track the number of bytes received */
-
-    printf("Struct length: %u\n", MESSAGE_LENGTH);
+    printf("Struct length: %zu, %zu with its header and tick\n", sizeof(DataPacket), MESSAGE_LENGTH);
     puts("=======================");
 
     /* Main loop to continuously read data from UART and process it. */
     while (1)
     {
-        bytes_received = 0;
-
-        /* Continue reading data until the full message (DataPacket) is received. */
-        if (bytes_received < MESSAGE_LENGTH)
+        TickedPacket    received;
+        int             ticked;
+        ssize_t         bytes_received = read_packet(&uart1, &received, &ticked);
+        if (bytes_received < 0)
         {
-            ssize_t result = uart_read_data(&uart1, buffer + bytes_received, MESSAGE_LENGTH - bytes_received);
-            if (result > 0)
-            {
-                /* Successfully read data, accumulate the total bytes received. */
-                bytes_received += result;
-            }
-            else if (result == -1 && errno == EAGAIN)
-            {
-                /* Non-blocking read operation, wait and retry if data is not yet available. */
-                usleep(100);  /* Brief pause before retrying */
-                continue;
-            }
-            else if (result == 0)
-            {
-                /* Connection closed by the sender, exit the loop. */
-                printf("Connection closed.\n");
-                break;
-            }
-            else
-            {
-                /* Handle any other errors during UART read. */
-                perror("Error receiving data from UART");
-                break;
-            }
+            break;
         }
 
         /* The full message is received, process the data.  */
-        if (bytes_received == MESSAGE_LENGTH)
+        if (bytes_received > 0)
         {
+            PRK_TP_SCOPE(PRK_TP_CTL_PACKET, bytes_received, 0);
+            int64_t received_us = (int64_t)(prk_metrics_now_ns() / 1000);
+            prk_counter_inc(packets);
             printf("Received bytes:\n");
-            for (int i = 0; i < MESSAGE_LENGTH; ++i)
+            for (size_t i = 0; i < (ticked ? sizeof(TickedPacket) : sizeof(DataPacket)); ++i)
             {
                 /* Print each byte as a hexadecimal value */
-                printf("%02X ", (unsigned char)buffer[i]);
+                printf("%02X ", ((unsigned char *)&received)[i]);
             }
             printf("\n");
 
-            /* Cast the buffer to a DataPacket structure and extract the information. */
-            DataPacket *received_packet = (DataPacket *)buffer;
+            DataPacket *received_packet = &received.packet;
 
             /* Print out the contents of the received packet in a readable format. */
             printf("Received DataPacket:\n");
@@ -124,13 +264,25 @@ int main()
             printf("y = %u\n", received_packet->y);
             printf("z = %u\n", received_packet->z);
 
+            /* The trace of the packet: sent by the STM32 if it told its tick, received here */
+            PrkTrace trace;
+            prk_trace_begin(&trace);
+            if (ticked)
+            {
+                printf("tick_ms = %u\n", received.tick_ms);
+                prk_trace_stamp_at(&trace, PRK_TRACE_MCU, estimate_sent_us(received.tick_ms, received_us));
+            }
+            prk_trace_stamp_at(&trace, PRK_TRACE_CTL, received_us);
+
             /* Format and display the structured data */
             format_data_struct(received_packet);
-            printf("Formatted Data: %s\n", get_formatted_data(received_packet));
+            printf("Formatted Data: %s\n", get_traced_data(received_packet, &trace));
         }
         else
         {
+            prk_counter_inc(incomplete);
             printf("Incomplete packet received.\n");
+            continue;                                                /* Look for the next packet at once */
         }
         puts("");
 
@@ -142,6 +294,8 @@ int main()
     uart_deinit(&uart1);
     gpio_deinit(&gpio_tx);
     gpio_deinit(&gpio_rx);
+    PRK_TP_CLOSE();
+    prk_metrics_close();
 
     return 0;
 }
@@ -7,7 +7,7 @@
  * identification purposes.
  *
  * Compilation:
- *      gcc tcp_client.c -o out_tcp_client
+ *      gcc tcp_client.c prk_metrics.c prk_trace.c prk_tracepoint.c -o out_tcp_client -lrt -lpthread
  *
  * Usage:
  *      ./out_tcp_client
@@ -17,8 +17,18 @@
  * - Connects to a TCP server defined by SERVER_IP and SERVER_PORT.
  * - Retrieves and displays the client's IP and MAC addresses.
  * - Reads data from the FIFO, prepends the MAC address, and sends it to the server.
+ * - Sends one newline terminated record per FIFO line, tagged with a per-sensor
+ *   sequence number ("... seq <n>").
+ * - Reconnects with backoff when the connection drops and replays the last
+ *   RESEND_WINDOW records; the server drops the duplicates.
+ * - Counts records, bytes, reconnects and replays, and times each send, in
+ *   the shared memory metrics page "tcp_client" (see prk_metrics.h).
+ * - Keeps the trace of a traced line after the sequence number and stamps
+ *   it with the time of sending (see prk_trace.h).
+ * - Tracepoints (prk_tracepoint.h) per FIFO read and record sent, with
+ *   TRACEPOINTS=1.
  * 
- * Version: v1.0
+ * Version: v1.4
  * Date:    26-03-2024
  * Author:  Morris
  *
@@ -32,7 +42,12 @@
  *                                                          ip_buffer[buffer_size - 1] = '\0';
  *                                                        get_mac_address:
  *                                                          ifr.ifr_name[IFNAMSIZ - 1] = '\0';
- *
+ *   19-10-2026       morris              v1.1            newline framed records with sequence numbers,
+ *                                                        reconnect with backoff and replay of the last
+ *                                                        RESEND_WINDOW records
+ *   19-10-2026       morris              v1.2            send, reconnect and replay metrics
+ *   19-10-2026       morris              v1.3            trace stamp of traced records
+ *   19-10-2026       morris              v1.4            tracepoints
  *
  */
 
@@ -52,6 +67,11 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <arpa/inet.h>
+#include <time.h>
+
+#include "prk_metrics.h"
+#include "prk_trace.h"
+#include "prk_tracepoint.h"
 
 #define FIFO_PATH   "tmp/gps_pipe"                                   /* Path to the FIFO file */
 #define SERVER_PORT 12345                                            /* Server port number */
@@ -63,6 +83,11 @@
 #define INTERFACE_PREFIX "usb"                                       /* Adjust based on BBG interfaces */
 #define MAX_INTERFACE_NUMBER 40
 
+#define RECORD_SIZE         (BUFFER_SIZE + 64 + PRK_TRACE_STAMP_MAX) /* MAC, line, sequence number, stamp */
+#define RESEND_WINDOW       64                                       /* Records replayed after a reconnect */
+#define RECONNECT_MIN_MS    100                                      /* First reconnect delay */
+#define RECONNECT_MAX_MS    5000                                     /* Upper bound for the reconnect delay */
+
 
 /**
  * get_ip_address - Retrieves the IP address of the first active network interface
@@ -210,15 +235,135 @@ int get_mac_address(char *mac_buffer, size_t buffer_size)
 }
 
 
+/**
+ * next_sequence_number - Returns the next per-sensor sequence number.
+ *
+ * Numbers start at the wall clock time in microseconds when the client
+ * starts and then increase by one per record, so they keep growing across
+ * restarts of the client. The server uses them to drop readings it has
+ * already stored, e.g. records resent after a reconnect.
+ *
+ * Return: the next sequence number (never 0).
+ */
+unsigned long long next_sequence_number(void)
+{
+    static unsigned long long seq = 0;
+
+    if (seq == 0)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        seq = (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+    }
+
+    return seq++;
+}
+
+
+/**
+ * connect_to_server - Connects a new TCP socket to SERVER_IP:SERVER_PORT.
+ *
+ * Retries with exponential backoff (RECONNECT_MIN_MS up to RECONNECT_MAX_MS)
+ * until the server accepts the connection.
+ *
+ * Return: connected socket descriptor, or -1 if the address is invalid.
+ */
+int connect_to_server(void)
+{
+    struct sockaddr_in  saddr;                                       /* Structure to store server address */
+    unsigned int        backoff_ms = RECONNECT_MIN_MS;
+
+    /* Initialize the server address structure */
+    memset(&saddr, 0, sizeof(saddr));
+    saddr.sin_family = AF_INET;                                      /* Use IPv4 address family */
+    saddr.sin_port   = htons(SERVER_PORT);                           /* Set server port, converting to
+                                                                        network byte order */
+
+    /* Convert the server's IP address from text to binary form and store it in saddr.sin_addr */
+    if (inet_pton(AF_INET, SERVER_IP, &saddr.sin_addr) <= 0)
+    {
+        perror("inet_pton");
+        return -1;
+    }
+
+    while (1)
+    {
+        /* Create a TCP socket */
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0)
+        {
+            perror("socket");
+            return -1;
+        }
+
+        /* Connect to the server */
+        if (connect(sock, (struct sockaddr *)&saddr, sizeof(saddr)) == 0)
+        {
+            return sock;
+        }
+
+        perror("connect");
+        close(sock);
+
+        usleep(backoff_ms * 1000);
+        backoff_ms = (backoff_ms * 2 > RECONNECT_MAX_MS) ? RECONNECT_MAX_MS : backoff_ms * 2;
+    }
+}
+
+
+/**
+ * send_all - Sends the whole buffer, looping over partial sends.
+ *
+ * @sock: Connected socket.
+ * @data: Bytes to send.
+ * @len:  Number of bytes.
+ *
+ * Return: 0 on success, -1 if the connection failed.
+ */
+int send_all(int sock, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t sent = send(sock, data, len, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("send");
+            return -1;
+        }
+        data += sent;
+        len  -= (size_t)sent;
+    }
+
+    return 0;
+}
+
+
 int main()
 {
     int                 fifo_fd;                                     /* Descriptor for FIFO file */
     int                 sock;                                        /* Descriptor for the socket */
-    struct sockaddr_in  saddr;                                       /* Structure to store server address */
     char                buffer[BUFFER_SIZE];                         /* Buffer to hold data */
+    size_t              pending = 0;                                 /* Bytes of an incomplete line in buffer */
     ssize_t             brd;                                         /* Number of bytes read */
+    char                resend[RESEND_WINDOW][RECORD_SIZE];          /* Last records sent, replayed on reconnect */
+    size_t              resend_len[RESEND_WINDOW] = { 0 };
+    unsigned long long  sent_records = 0;                            /* Records sent so far */
     /* char server_ip[INET_ADDRSTRLEN]; */                           /* Buffer to hold the server IP address */
 
+    prk_metrics_open("tcp_client");
+    PRK_TP_OPEN("tcp_client");
+    PrkCounter   records    = prk_counter("prk_tcp_client_records_total", "Records sent to the server.");
+    PrkCounter   sent_bytes = prk_counter("prk_tcp_client_sent_bytes_total", "Bytes of records sent, replays included.");
+    PrkCounter   reconnects = prk_counter("prk_tcp_client_reconnects_total", "Connections made again after a failed send.");
+    PrkCounter   replayed   = prk_counter("prk_tcp_client_replayed_total", "Records sent again after a reconnect.");
+    PrkHistogram send_time  = prk_histogram("prk_tcp_client_send_seconds", "Time to send one record, reconnects included.",
+                                            PRK_SCALE_NS);
+    PrkGauge     connected  = prk_gauge("prk_tcp_client_connected", "1 while connected to the server.");
+
     /* Get the client IP address at runtime */
     char ip_address[INET_ADDRSTRLEN];                                /* Buffer to store the IP address
                                                                         in xxx.xxx.xxx.xxx format */  
@@ -244,55 +389,99 @@ int main()
         exit(EXIT_FAILURE);
     }
 
-    /* Create a TCP socket */
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-    {
-        perror("socket");
-        exit(EXIT_FAILURE);
-    }
-
-    /* Initialize the server address structure */
-    saddr.sin_family = AF_INET;                                      /* Use IPv4 address family */
-    saddr.sin_port   = htons(SERVER_PORT);                           /* Set server port, converting to
-                                                                        network byte order */
-
-    /* Convert the server's IP address from text to binary form and store it in saddr.sin_addr */
-    if (inet_pton(AF_INET, SERVER_IP, &saddr.sin_addr) <= 0)
-    {
-        perror("inet_pton");
-        exit(EXIT_FAILURE);
-    }
-
     /* Connect to the server */
-    if (connect(sock, (struct sockaddr *)&saddr, sizeof(saddr)) < 0)
+    if ((sock = connect_to_server()) < 0)
     {
-        perror("connect");
         exit(EXIT_FAILURE);
     }
+    prk_gauge_set(connected, 1);
 
     /* Read from the FIFO and send data to the server */
     while (1)
     {
-        brd = read(fifo_fd, buffer, sizeof(buffer) - 1);             /* Leave space for null-terminator */
+        brd = read(fifo_fd, buffer + pending, sizeof(buffer) - 1 - pending);   /* Leave space for null-terminator */
         if (brd > 0)
         {
-            buffer[brd] = '\0';                                      /* Null-terminate the string */
-            printf("Read from FIFO: %s\n", buffer);                    /* Print the read data */
-            fflush(stdout);                                          /* Flush the output buffer */
+            PRK_TP_SCOPE(PRK_TP_TCP_READ, brd, 0);
+            size_t  filled = pending + (size_t)brd;
+            char    *line  = buffer;
+            char    *nl;
 
-            /* Create a new buffer to hold MAC address and the data */
-            char combined_buffer[BUFFER_SIZE + 20];                  /* Additional space for MAC address */
-            snprintf(combined_buffer, sizeof(combined_buffer), "%s: %s", mac_address, buffer);
+            buffer[filled] = '\0';                                   /* Null-terminate the string */
 
-            /* Send data to the server */
-            if (send(sock, combined_buffer, strlen(combined_buffer), 0) < 0)
+            /* Send every complete line as one record: "<mac>: <line> seq <n>\n",
+               with the trace of a traced line after the sequence number */
+            while ((nl = memchr(line, '\n', filled - (size_t)(line - buffer))) != NULL)
             {
-                perror("send");
-                exit(EXIT_FAILURE);
+                *nl = '\0';
+                if (nl > line)
+                {
+                    size_t      slot  = sent_records % RESEND_WINDOW;
+                    const char  *tail = prk_trace_find(line, (size_t)(nl - line));
+                    char        stamp[PRK_TRACE_STAMP_MAX] = "";
+                    if (tail)
+                    {
+                        prk_trace_format_stamp(PRK_TRACE_TCP, stamp, sizeof(stamp));
+                    }
+                    int     len  = snprintf(resend[slot], RECORD_SIZE, "%s: %.*s seq %llu%s%s\n",
+                                            mac_address, tail ? (int)(tail - line) : (int)(nl - line), line,
+                                            next_sequence_number(), tail ? tail : "", stamp);
+                    if (len >= RECORD_SIZE)
+                    {
+                        len = RECORD_SIZE - 1;
+                        resend[slot][len - 1] = '\n';
+                    }
+                    resend_len[slot] = (size_t)len;
+                    sent_records++;
+
+                    printf("Read from FIFO: %s\n", line);           /* Print the read data */
+                    fflush(stdout);                                  /* Flush the output buffer */
+
+                    /* Send data to the server; on failure reconnect and replay the
+                       last RESEND_WINDOW records, the server drops the duplicates */
+                    uint64_t started = prk_metrics_now_ns();
+                    PRK_TP_BEGIN(PRK_TP_TCP_SEND, resend_len[slot], sent_records);
+                    while (send_all(sock, resend[slot], resend_len[slot]) < 0)
+                    {
+                        close(sock);
+                        prk_gauge_set(connected, 0);
+                        if ((sock = connect_to_server()) < 0)
+                        {
+                            exit(EXIT_FAILURE);
+                        }
+                        prk_gauge_set(connected, 1);
+                        prk_counter_inc(reconnects);
+
+                        unsigned long long first = sent_records > RESEND_WINDOW ? sent_records - RESEND_WINDOW : 0;
+                        for (unsigned long long r = first; r + 1 < sent_records; r++)
+                        {
+                            size_t old = r % RESEND_WINDOW;
+                            if (send_all(sock, resend[old], resend_len[old]) < 0)
+                            {
+                                break;
+                            }
+                            prk_counter_inc(replayed);
+                            prk_counter_add(sent_bytes, resend_len[old]);
+                        }
+                    }
+                    PRK_TP_END(PRK_TP_TCP_SEND, 0, 0);
+                    prk_histogram_observe(send_time, prk_metrics_now_ns() - started);
+                    prk_counter_inc(records);
+                    prk_counter_add(sent_bytes, resend_len[slot]);
+
+                    printf("Sent to server: %s", resend[slot]);      /* Print the sent data */
+                }
+                line = nl + 1;
             }
 
-            //printf("Sent to server: %s", buffer);                    /* Print the sent data */
-            printf("Sent to server: %s\n", buffer);                    /* Print the sent data */
+            /* Keep an incomplete line for the next read; drop it if it can never fit */
+            pending = filled - (size_t)(line - buffer);
+            if (pending >= sizeof(buffer) - 1)
+            {
+                fprintf(stderr, "Record too long, dropped\n");
+                pending = 0;
+            }
+            memmove(buffer, line, pending);
         }
         else if (brd == 0)
         {
@@ -308,7 +497,8 @@ int main()
     /* Close the FIFO and socket */
     close(fifo_fd);
     close(sock);
+    PRK_TP_CLOSE();
+    prk_metrics_close();
 
     return 0;
 }
-
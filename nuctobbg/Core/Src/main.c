@@ -98,13 +98,20 @@ static void MX_UART5_Init(void);
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+#define PACKET_MAGIC 0xA5	/* A header, not the op_code of a bare packet, comes first */
+#define PACKET_VERSION 1	/* The gateway's PacketHeader and TickedPacket (bbg data_struct_format.h) */
+
 #pragma pack(push, 1)
 struct __attribute__((packed)) DataPacket
 {
+	uint8_t magic;		/* PACKET_MAGIC */
+	uint8_t version;	/* PACKET_VERSION */
+	uint8_t length;		/* Bytes after these three */
 	char op_code;		/* 'D' or 'S' */
 	uint16_t x;
 	uint16_t y;
 	uint16_t z;
+	uint32_t tick_ms;	/* HAL_GetTick() when sent, for the gateway's trace */
 };
 #pragma pack(pop)
 #define DataPacket struct DataPacket
@@ -170,6 +177,8 @@ int main(void)
   while (1)
   {
 	  packet.op_code = 'D';	  packet.x = j;	  packet.y = j;	  packet.z = j;
+	  packet.magic = PACKET_MAGIC;	  packet.version = PACKET_VERSION;	  packet.length = sizeof(packet) - 3;
+	  packet.tick_ms = HAL_GetTick();
 
 	  status = HAL_UART_Transmit(&huart4, (uint8_t*)&packet, sizeof(packet), 1000);
 	  if (status != HAL_OK)